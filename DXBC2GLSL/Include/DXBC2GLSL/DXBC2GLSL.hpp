@@ -44,13 +44,24 @@
 #include <DXBC2GLSL/Shader.hpp>
 #include <DXBC2GLSL/GLSLGen.hpp>
 
+#include <boost/noncopyable.hpp>
+
 namespace DXBC2GLSL
 {
-	class DXBC2GLSL
+	// Not copyable, since the semantic names of the params point into semantic_names_
+	class DXBC2GLSL : boost::noncopyable
 	{
 	public:
+		DXBC2GLSL();
+
 		static uint32_t DefaultRules(GLSLVersion version);
 
+		// Runs ShaderOptimize on the parsed program before generating GLSL. Off by default,
+		// until its output is checked against the unoptimized translation on real shaders.
+		void Optimize(bool opt);
+		ShaderOptimizeStats const & OptimizeStats() const;
+
+		// Translations are looked up in DXBC2GLSLCache first when it's enabled
 		void FeedDXBC(void const * dxbc_data,
 			bool has_gs, ShaderTessellatorPartitioning ds_partitioning, ShaderTessellatorOutputPrimitive ds_output_primitive,
 			GLSLVersion version);
@@ -58,6 +69,10 @@ namespace DXBC2GLSL
 			bool has_gs, ShaderTessellatorPartitioning ds_partitioning, ShaderTessellatorOutputPrimitive ds_output_primitive,
 			GLSLVersion version, uint32_t glsl_rules);
 
+		// The GLSL and the reflection, without the DXBC they come from
+		void Save(std::ostream& os) const;
+		bool Load(std::istream& is);
+
 		std::string const & GLSLString() const;
 
 		uint32_t NumInputParams() const;
@@ -88,9 +103,42 @@ namespace DXBC2GLSL
 		ShaderTessellatorOutputPrimitive DSOutputPrimitive() const;
 
 	private:
-		std::shared_ptr<DXBCContainer> dxbc_;
-		std::shared_ptr<ShaderProgram> shader_;
+		void Reflect(ShaderProgram const & program);
+		void UpdateSemanticNames();
+
+	private:
+		struct CBufferVariable
+		{
+			std::string name;
+			bool used;
+		};
+
+		struct Resource
+		{
+			std::string name;
+			uint32_t bind_point;
+			ShaderInputType type;
+			ShaderSRVDimension dimension;
+			bool used;
+		};
+
 		std::string glsl_;
+
+		std::vector<DXBCSignatureParamDesc> params_in_;
+		std::vector<DXBCSignatureParamDesc> params_out_;
+		std::vector<std::string> semantic_names_;
+		std::vector<std::vector<CBufferVariable>> cbuffers_;
+		std::vector<Resource> resources_;
+
+		ShaderPrimitive gs_input_primitive_;
+		std::vector<ShaderPrimitiveTopology> gs_output_topology_;
+		uint32_t max_gs_output_vertex_;
+		uint32_t gs_instance_count_;
+		ShaderTessellatorPartitioning ds_partitioning_;
+		ShaderTessellatorOutputPrimitive ds_output_primitive_;
+
+		bool optimize_;
+		ShaderOptimizeStats optimize_stats_;
 	};
 }
 
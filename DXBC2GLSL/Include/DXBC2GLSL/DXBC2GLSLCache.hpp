@@ -0,0 +1,96 @@
+/**
+ * @file DXBC2GLSLCache.hpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#ifndef _DXBC2GLSL_CACHE_HPP
+#define _DXBC2GLSL_CACHE_HPP
+
+#pragma once
+
+#include <DXBC2GLSL/DXBC2GLSL.hpp>
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace DXBC2GLSL
+{
+	// Translation results keyed by the DXBC blob and the conversion settings. They are kept in memory, and in files
+	//  when a directory is set, so identical bytecode is translated once across effects and runs. The key is only a
+	//  hash, so every entry also keeps its source, and a lookup hits only when the sources are identical.
+	class DXBC2GLSLCache
+	{
+	public:
+		static DXBC2GLSLCache& Instance();
+
+		void Enabled(bool enabled);
+		bool Enabled() const;
+
+		// An existing, writable directory. Empty means memory only.
+		void Directory(std::string const & dir);
+		std::string Directory() const;
+
+		// The DXBC blob and the conversion settings as one string. Empty if dxbc_data isn't DXBC.
+		static std::string Source(void const * dxbc_data,
+			bool has_gs, ShaderTessellatorPartitioning ds_partitioning, ShaderTessellatorOutputPrimitive ds_output_primitive,
+			GLSLVersion version, uint32_t glsl_rules, bool optimize);
+
+		bool Find(std::string const & source, DXBC2GLSL& translation);
+		void Add(std::string const & source, DXBC2GLSL const & translation);
+		void Clear();
+
+		uint32_t NumHits() const;
+		uint32_t NumMisses() const;
+
+	private:
+		struct Entry
+		{
+			std::string source;
+			std::string translation;
+		};
+
+	private:
+		DXBC2GLSLCache();
+
+		static uint64_t Key(std::string const & source);
+		std::string FileName(std::string const & dir, uint64_t key) const;
+
+	private:
+		mutable std::mutex mutex_;
+
+		bool enabled_;
+		std::string dir_;
+		std::unordered_map<uint64_t, std::shared_ptr<Entry const>> entries_;
+
+		uint32_t num_hits_;
+		uint32_t num_misses_;
+	};
+}
+
+#endif		// _DXBC2GLSL_CACHE_HPP
@@ -403,6 +403,27 @@ struct ShaderProgram
 
 std::shared_ptr<ShaderProgram> ShaderParse(DXBCContainer const & dxbc);
 
+struct ShaderOptimizeStats
+{
+	uint32_t num_insns_before;
+	uint32_t num_insns_after;
+	uint32_t num_temps_before;
+	uint32_t num_temps_after;
+	uint32_t num_copies_propagated;
+	uint32_t num_constants_folded;
+	uint32_t num_dead_insns_removed;
+
+	ShaderOptimizeStats()
+		: num_insns_before(0), num_insns_after(0),
+			num_temps_before(0), num_temps_after(0),
+			num_copies_propagated(0), num_constants_folded(0), num_dead_insns_removed(0)
+	{
+	}
+};
+
+// Copy propagation, constant folding and dead code elimination on temp registers, in place
+ShaderOptimizeStats ShaderOptimize(ShaderProgram& program);
+
 // Return the opcode's input type
 inline ShaderImmType GetOpInType(uint32_t opcode)
 {
@@ -29,17 +29,150 @@
  */
 
 #include <DXBC2GLSL/DXBC2GLSL.hpp>
+#include <DXBC2GLSL/DXBC2GLSLCache.hpp>
 #include <DXBC2GLSL/DXBC.hpp>
 #include <DXBC2GLSL/GLSLGen.hpp>
+#include <KFL/Util.hpp>
 #include <sstream>
 
+namespace
+{
+	void WriteUInt32(std::ostream& os, uint32_t v)
+	{
+		v = KlayGE::Native2LE(v);
+		os.write(reinterpret_cast<char const *>(&v), sizeof(v));
+	}
+
+	void WriteString(std::ostream& os, std::string const & str)
+	{
+		WriteUInt32(os, static_cast<uint32_t>(str.size()));
+		os.write(str.data(), str.size());
+	}
+
+	// A stream with the number of bytes left in it. Sizes and counts are checked against that before anything is
+	//  allocated, so a truncated or corrupted blob fails the load instead of asking for gigabytes.
+	struct BoundedStream
+	{
+		std::istream& is;
+		uint64_t remaining;
+
+		bool Consume(uint64_t size)
+		{
+			if (is && (size <= remaining))
+			{
+				remaining -= size;
+				return true;
+			}
+			else
+			{
+				is.setstate(std::ios_base::failbit);
+				remaining = 0;
+				return false;
+			}
+		}
+	};
+
+	uint32_t ReadUInt32(BoundedStream& bs)
+	{
+		uint32_t v = 0;
+		if (bs.Consume(sizeof(v)))
+		{
+			bs.is.read(reinterpret_cast<char*>(&v), sizeof(v));
+		}
+		return KlayGE::LE2Native(v);
+	}
+
+	std::string ReadString(BoundedStream& bs)
+	{
+		uint32_t const len = ReadUInt32(bs);
+		std::string str;
+		if (bs.Consume(len))
+		{
+			str.resize(len);
+			bs.is.read(&str[0], len);
+		}
+		return str;
+	}
+
+	// Fails if the stream is too short to hold that many items of at least min_item_size bytes each
+	uint32_t ReadCount(BoundedStream& bs, uint32_t min_item_size)
+	{
+		uint32_t const num = ReadUInt32(bs);
+		if (bs.is && (num <= bs.remaining / min_item_size))
+		{
+			return num;
+		}
+		else
+		{
+			bs.is.setstate(std::ios_base::failbit);
+			bs.remaining = 0;
+			return 0;
+		}
+	}
+
+	void WriteParams(std::ostream& os, std::vector<DXBCSignatureParamDesc> const & params)
+	{
+		WriteUInt32(os, static_cast<uint32_t>(params.size()));
+		for (auto const & param : params)
+		{
+			WriteString(os, param.semantic_name);
+			WriteUInt32(os, param.semantic_index);
+			WriteUInt32(os, param.register_index);
+			WriteUInt32(os, param.system_value_type);
+			WriteUInt32(os, param.component_type);
+			WriteUInt32(os, param.mask);
+			WriteUInt32(os, param.read_write_mask);
+			WriteUInt32(os, param.stream);
+			WriteUInt32(os, param.min_precision);
+		}
+	}
+
+	void ReadParams(BoundedStream& bs, std::vector<DXBCSignatureParamDesc>& params, std::vector<std::string>& names)
+	{
+		// The name length and 8 fields
+		uint32_t const num = ReadCount(bs, 9 * sizeof(uint32_t));
+		for (uint32_t i = 0; (i < num) && bs.is; ++ i)
+		{
+			DXBCSignatureParamDesc param;
+			names.push_back(ReadString(bs));
+			param.semantic_name = nullptr;
+			param.semantic_index = ReadUInt32(bs);
+			param.register_index = ReadUInt32(bs);
+			param.system_value_type = static_cast<ShaderName>(ReadUInt32(bs));
+			param.component_type = static_cast<ShaderRegisterComponentType>(ReadUInt32(bs));
+			param.mask = static_cast<uint8_t>(ReadUInt32(bs));
+			param.read_write_mask = static_cast<uint8_t>(ReadUInt32(bs));
+			param.stream = ReadUInt32(bs);
+			param.min_precision = ReadUInt32(bs);
+			params.push_back(param);
+		}
+	}
+}
+
 namespace DXBC2GLSL
 {
+	DXBC2GLSL::DXBC2GLSL()
+		: gs_input_primitive_(SP_Undefined), max_gs_output_vertex_(0), gs_instance_count_(0),
+			ds_partitioning_(STP_Undefined), ds_output_primitive_(STOP_Undefined),
+			optimize_(false)
+	{
+	}
+
 	uint32_t DXBC2GLSL::DefaultRules(GLSLVersion version)
 	{
 		return GLSLGen::DefaultRules(version);
 	}
 
+	void DXBC2GLSL::Optimize(bool opt)
+	{
+		optimize_ = opt;
+	}
+
+	ShaderOptimizeStats const & DXBC2GLSL::OptimizeStats() const
+	{
+		return optimize_stats_;
+	}
+
 	void DXBC2GLSL::FeedDXBC(void const * dxbc_data,
 			bool has_gs, ShaderTessellatorPartitioning ds_partitioning, ShaderTessellatorOutputPrimitive ds_output_primitive,
 			GLSLVersion version)
@@ -51,24 +184,212 @@ namespace DXBC2GLSL
 			bool has_gs, ShaderTessellatorPartitioning ds_partitioning, ShaderTessellatorOutputPrimitive ds_output_primitive, 
 			GLSLVersion version, uint32_t glsl_rules)
 	{
-		dxbc_ = DXBCParse(dxbc_data);
-		if (dxbc_)
+		optimize_stats_ = ShaderOptimizeStats();
+
+		DXBC2GLSLCache& cache = DXBC2GLSLCache::Instance();
+		std::string source;
+		if (cache.Enabled())
 		{
-			if (dxbc_->shader_chunk)
+			source = DXBC2GLSLCache::Source(dxbc_data, has_gs, ds_partitioning, ds_output_primitive, version, glsl_rules,
+				optimize_);
+			if (cache.Find(source, *this))
 			{
-				shader_ = ShaderParse(*dxbc_);
+				return;
+			}
+		}
+
+		std::shared_ptr<DXBCContainer> dxbc = DXBCParse(dxbc_data);
+		if (dxbc)
+		{
+			if (dxbc->shader_chunk)
+			{
+				std::shared_ptr<ShaderProgram> shader = ShaderParse(*dxbc);
+				if (optimize_)
+				{
+					optimize_stats_ = ShaderOptimize(*shader);
+				}
 
 				std::stringstream ss;
 
 				GLSLGen converter;
-				converter.FeedDXBC(shader_, has_gs, ds_partitioning, ds_output_primitive, version, glsl_rules);
+				converter.FeedDXBC(shader, has_gs, ds_partitioning, ds_output_primitive, version, glsl_rules);
 				converter.ToGLSL(ss);
 
 				glsl_ = ss.str();
+				this->Reflect(*shader);
+
+				if (cache.Enabled())
+				{
+					cache.Add(source, *this);
+				}
 			}
 		}
 	}
 
+	void DXBC2GLSL::Reflect(ShaderProgram const & program)
+	{
+		params_in_ = program.params_in;
+		params_out_ = program.params_out;
+		semantic_names_.clear();
+		for (auto const & param : params_in_)
+		{
+			semantic_names_.push_back(param.semantic_name);
+		}
+		for (auto const & param : params_out_)
+		{
+			semantic_names_.push_back(param.semantic_name);
+		}
+		this->UpdateSemanticNames();
+
+		cbuffers_.resize(program.cbuffers.size());
+		for (size_t i = 0; i < program.cbuffers.size(); ++ i)
+		{
+			auto const & vars = program.cbuffers[i].vars;
+			cbuffers_[i].resize(vars.size());
+			for (size_t j = 0; j < vars.size(); ++ j)
+			{
+				cbuffers_[i][j].name = vars[j].var_desc.name;
+				cbuffers_[i][j].used = vars[j].var_desc.flags ? true : false;
+			}
+		}
+
+		resources_.resize(program.resource_bindings.size());
+		for (size_t i = 0; i < program.resource_bindings.size(); ++ i)
+		{
+			auto const & binding = program.resource_bindings[i];
+			resources_[i].name = binding.name;
+			resources_[i].bind_point = binding.bind_point;
+			resources_[i].type = binding.type;
+			resources_[i].dimension = binding.dimension;
+			resources_[i].used = !(binding.flags & DSIF_Unused);
+		}
+
+		gs_input_primitive_ = program.gs_input_primitive;
+		gs_output_topology_ = program.gs_output_topology;
+		max_gs_output_vertex_ = program.max_gs_output_vertex;
+		gs_instance_count_ = program.gs_instance_count;
+		ds_partitioning_ = program.ds_tessellator_partitioning;
+		ds_output_primitive_ = program.ds_tessellator_output_primitive;
+	}
+
+	// The semantic names of params_in_ and params_out_ point into semantic_names_, in that order
+	void DXBC2GLSL::UpdateSemanticNames()
+	{
+		BOOST_ASSERT(semantic_names_.size() == params_in_.size() + params_out_.size());
+
+		size_t index = 0;
+		for (auto& param : params_in_)
+		{
+			param.semantic_name = semantic_names_[index].c_str();
+			++ index;
+		}
+		for (auto& param : params_out_)
+		{
+			param.semantic_name = semantic_names_[index].c_str();
+			++ index;
+		}
+	}
+
+	void DXBC2GLSL::Save(std::ostream& os) const
+	{
+		WriteString(os, glsl_);
+
+		WriteParams(os, params_in_);
+		WriteParams(os, params_out_);
+
+		WriteUInt32(os, static_cast<uint32_t>(cbuffers_.size()));
+		for (auto const & vars : cbuffers_)
+		{
+			WriteUInt32(os, static_cast<uint32_t>(vars.size()));
+			for (auto const & var : vars)
+			{
+				WriteString(os, var.name);
+				WriteUInt32(os, var.used);
+			}
+		}
+
+		WriteUInt32(os, static_cast<uint32_t>(resources_.size()));
+		for (auto const & res : resources_)
+		{
+			WriteString(os, res.name);
+			WriteUInt32(os, res.bind_point);
+			WriteUInt32(os, res.type);
+			WriteUInt32(os, res.dimension);
+			WriteUInt32(os, res.used);
+		}
+
+		WriteUInt32(os, gs_input_primitive_);
+		WriteUInt32(os, static_cast<uint32_t>(gs_output_topology_.size()));
+		for (auto topology : gs_output_topology_)
+		{
+			WriteUInt32(os, topology);
+		}
+		WriteUInt32(os, max_gs_output_vertex_);
+		WriteUInt32(os, gs_instance_count_);
+		WriteUInt32(os, ds_partitioning_);
+		WriteUInt32(os, ds_output_primitive_);
+	}
+
+	bool DXBC2GLSL::Load(std::istream& is)
+	{
+		std::istream::pos_type const begin = is.tellg();
+		is.seekg(0, std::ios_base::end);
+		std::istream::pos_type const end = is.tellg();
+		is.seekg(begin);
+		if (!is || (begin == std::istream::pos_type(-1)) || (end < begin))
+		{
+			return false;
+		}
+		BoundedStream bs = { is, static_cast<uint64_t>(end - begin) };
+
+		glsl_ = ReadString(bs);
+
+		params_in_.clear();
+		params_out_.clear();
+		semantic_names_.clear();
+		ReadParams(bs, params_in_, semantic_names_);
+		ReadParams(bs, params_out_, semantic_names_);
+		if (!is)
+		{
+			return false;
+		}
+		this->UpdateSemanticNames();
+
+		cbuffers_.resize(ReadCount(bs, sizeof(uint32_t)));
+		for (auto& vars : cbuffers_)
+		{
+			vars.resize(ReadCount(bs, 2 * sizeof(uint32_t)));
+			for (auto& var : vars)
+			{
+				var.name = ReadString(bs);
+				var.used = ReadUInt32(bs) ? true : false;
+			}
+		}
+
+		resources_.resize(ReadCount(bs, 5 * sizeof(uint32_t)));
+		for (auto& res : resources_)
+		{
+			res.name = ReadString(bs);
+			res.bind_point = ReadUInt32(bs);
+			res.type = static_cast<ShaderInputType>(ReadUInt32(bs));
+			res.dimension = static_cast<ShaderSRVDimension>(ReadUInt32(bs));
+			res.used = ReadUInt32(bs) ? true : false;
+		}
+
+		gs_input_primitive_ = static_cast<ShaderPrimitive>(ReadUInt32(bs));
+		gs_output_topology_.resize(ReadCount(bs, sizeof(uint32_t)));
+		for (auto& topology : gs_output_topology_)
+		{
+			topology = static_cast<ShaderPrimitiveTopology>(ReadUInt32(bs));
+		}
+		max_gs_output_vertex_ = ReadUInt32(bs);
+		gs_instance_count_ = ReadUInt32(bs);
+		ds_partitioning_ = static_cast<ShaderTessellatorPartitioning>(ReadUInt32(bs));
+		ds_output_primitive_ = static_cast<ShaderTessellatorOutputPrimitive>(ReadUInt32(bs));
+
+		return !is.fail();
+	}
+
 	std::string const & DXBC2GLSL::GLSLString() const
 	{
 		return glsl_;
@@ -76,119 +397,119 @@ namespace DXBC2GLSL
 
 	uint32_t DXBC2GLSL::NumInputParams() const
 	{
-		return static_cast<uint32_t>(shader_->params_in.size());
+		return static_cast<uint32_t>(params_in_.size());
 	}
 
 	DXBCSignatureParamDesc const & DXBC2GLSL::InputParam(uint32_t index) const
 	{
-		BOOST_ASSERT(index < shader_->params_in.size());
-		return shader_->params_in[index];
+		BOOST_ASSERT(index < params_in_.size());
+		return params_in_[index];
 	}
 
 	uint32_t DXBC2GLSL::NumOutputParams() const
 	{
-		return static_cast<uint32_t>(shader_->params_out.size());
+		return static_cast<uint32_t>(params_out_.size());
 	}
 
 	DXBCSignatureParamDesc const & DXBC2GLSL::OutputParam(uint32_t index) const
 	{
-		BOOST_ASSERT(index < shader_->params_out.size());
-		return shader_->params_out[index];
+		BOOST_ASSERT(index < params_out_.size());
+		return params_out_[index];
 	}
 
 	uint32_t DXBC2GLSL::NumCBuffers() const
 	{
-		return static_cast<uint32_t>(shader_->cbuffers.size());
+		return static_cast<uint32_t>(cbuffers_.size());
 	}
 
 	uint32_t DXBC2GLSL::NumVariables(uint32_t cb_index) const
 	{
-		BOOST_ASSERT(cb_index < shader_->cbuffers.size());
-		return static_cast<uint32_t>(shader_->cbuffers[cb_index].vars.size());
+		BOOST_ASSERT(cb_index < cbuffers_.size());
+		return static_cast<uint32_t>(cbuffers_[cb_index].size());
 	}
 
 	char const * DXBC2GLSL::VariableName(uint32_t cb_index, uint32_t var_index) const
 	{
-		BOOST_ASSERT(cb_index < shader_->cbuffers.size());
-		BOOST_ASSERT(var_index < shader_->cbuffers[cb_index].vars.size());
-		return shader_->cbuffers[cb_index].vars[var_index].var_desc.name;
+		BOOST_ASSERT(cb_index < cbuffers_.size());
+		BOOST_ASSERT(var_index < cbuffers_[cb_index].size());
+		return cbuffers_[cb_index][var_index].name.c_str();
 	}
 
 	bool DXBC2GLSL::VariableUsed(uint32_t cb_index, uint32_t var_index) const
 	{
-		BOOST_ASSERT(cb_index < shader_->cbuffers.size());
-		BOOST_ASSERT(var_index < shader_->cbuffers[cb_index].vars.size());
-		return shader_->cbuffers[cb_index].vars[var_index].var_desc.flags ? true : false;
+		BOOST_ASSERT(cb_index < cbuffers_.size());
+		BOOST_ASSERT(var_index < cbuffers_[cb_index].size());
+		return cbuffers_[cb_index][var_index].used;
 	}
 
 	uint32_t DXBC2GLSL::NumResources() const
 	{
-		return static_cast<uint32_t>(shader_->resource_bindings.size());
+		return static_cast<uint32_t>(resources_.size());
 	}
 
 	char const * DXBC2GLSL::ResourceName(uint32_t index) const
 	{
-		BOOST_ASSERT(index < shader_->resource_bindings.size());
-		return shader_->resource_bindings[index].name;
+		BOOST_ASSERT(index < resources_.size());
+		return resources_[index].name.c_str();
 	}
 
 	uint32_t DXBC2GLSL::ResourceBindPoint(uint32_t index) const
 	{
-		BOOST_ASSERT(index < shader_->resource_bindings.size());
-		return shader_->resource_bindings[index].bind_point;
+		BOOST_ASSERT(index < resources_.size());
+		return resources_[index].bind_point;
 	}
 
 	ShaderInputType DXBC2GLSL::ResourceType(uint32_t index) const
 	{
-		BOOST_ASSERT(index < shader_->resource_bindings.size());
-		return shader_->resource_bindings[index].type;
+		BOOST_ASSERT(index < resources_.size());
+		return resources_[index].type;
 	}
 
 	ShaderSRVDimension DXBC2GLSL::ResourceDimension(uint32_t index) const
 	{
-		BOOST_ASSERT(index < shader_->resource_bindings.size());
-		return shader_->resource_bindings[index].dimension;
+		BOOST_ASSERT(index < resources_.size());
+		return resources_[index].dimension;
 	}
 
 	bool DXBC2GLSL::ResourceUsed(uint32_t index) const
 	{
-		BOOST_ASSERT(index < shader_->resource_bindings.size());
-		return !(shader_->resource_bindings[index].flags & DSIF_Unused);
+		BOOST_ASSERT(index < resources_.size());
+		return resources_[index].used;
 	}
 
 	ShaderPrimitive DXBC2GLSL::GSInputPrimitive() const
 	{
-		return shader_->gs_input_primitive;
+		return gs_input_primitive_;
 	}
 
 	uint32_t DXBC2GLSL::NumGSOutputTopology() const
 	{
-		return static_cast<uint32_t>(shader_->gs_output_topology.size());
+		return static_cast<uint32_t>(gs_output_topology_.size());
 	}
 
 	ShaderPrimitiveTopology DXBC2GLSL::GSOutputTopology(uint32_t index) const
 	{
-		BOOST_ASSERT(index < shader_->gs_output_topology.size());
-		return shader_->gs_output_topology[index];
+		BOOST_ASSERT(index < gs_output_topology_.size());
+		return gs_output_topology_[index];
 	}
 
 	uint32_t DXBC2GLSL::MaxGSOutputVertex() const
 	{
-		return shader_->max_gs_output_vertex;
+		return max_gs_output_vertex_;
 	}
 
 	uint32_t DXBC2GLSL::GSInstanceCount() const
 	{
-		return shader_->gs_instance_count;
+		return gs_instance_count_;
 	}
 
 	ShaderTessellatorPartitioning DXBC2GLSL::DSPartitioning() const
 	{
-		return shader_->ds_tessellator_partitioning;
+		return ds_partitioning_;
 	}
 
 	ShaderTessellatorOutputPrimitive DXBC2GLSL::DSOutputPrimitive() const
 	{
-		return shader_->ds_tessellator_output_primitive;
+		return ds_output_primitive_;
 	}
 }
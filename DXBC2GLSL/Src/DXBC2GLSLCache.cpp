@@ -0,0 +1,306 @@
+/**
+ * @file DXBC2GLSLCache.cpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#include <DXBC2GLSL/DXBC2GLSLCache.hpp>
+#include <DXBC2GLSL/DXBC.hpp>
+#include <KFL/Util.hpp>
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+namespace
+{
+	uint32_t const CACHE_FOURCC = KlayGE::MakeFourCC<'D', 'X', 'G', 'L'>::value;
+
+	// Bump it whenever the generated GLSL or the reflection changes, so that stale files are ignored
+	uint32_t const CACHE_VERSION = 2;
+
+	uint64_t const FNV_OFFSET_BASIS = 0xCBF29CE484222325ULL;
+	uint64_t const FNV_PRIME = 0x100000001B3ULL;
+
+	void FNVHash(uint64_t& hash, void const * data, size_t size)
+	{
+		uint8_t const * p = static_cast<uint8_t const *>(data);
+		for (size_t i = 0; i < size; ++ i)
+		{
+			hash ^= p[i];
+			hash *= FNV_PRIME;
+		}
+	}
+
+	void FNVHash(uint64_t& hash, uint32_t v)
+	{
+		v = KlayGE::Native2LE(v);
+		FNVHash(hash, &v, sizeof(v));
+	}
+
+	void WriteUInt32(std::ostream& os, uint32_t v)
+	{
+		v = KlayGE::Native2LE(v);
+		os.write(reinterpret_cast<char const *>(&v), sizeof(v));
+	}
+
+	uint32_t ReadUInt32(std::istream& is)
+	{
+		uint32_t v = 0;
+		is.read(reinterpret_cast<char*>(&v), sizeof(v));
+		return KlayGE::LE2Native(v);
+	}
+}
+
+namespace DXBC2GLSL
+{
+	DXBC2GLSLCache::DXBC2GLSLCache()
+		: enabled_(true), num_hits_(0), num_misses_(0)
+	{
+	}
+
+	DXBC2GLSLCache& DXBC2GLSLCache::Instance()
+	{
+		static DXBC2GLSLCache cache;
+		return cache;
+	}
+
+	void DXBC2GLSLCache::Enabled(bool enabled)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		enabled_ = enabled;
+	}
+
+	bool DXBC2GLSLCache::Enabled() const
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		return enabled_;
+	}
+
+	void DXBC2GLSLCache::Directory(std::string const & dir)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		dir_ = dir;
+		if (!dir_.empty() && (dir_.back() != '/') && (dir_.back() != '\\'))
+		{
+			dir_ += '/';
+		}
+	}
+
+	std::string DXBC2GLSLCache::Directory() const
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		return dir_;
+	}
+
+	std::string DXBC2GLSLCache::Source(void const * dxbc_data,
+			bool has_gs, ShaderTessellatorPartitioning ds_partitioning, ShaderTessellatorOutputPrimitive ds_output_primitive,
+			GLSLVersion version, uint32_t glsl_rules, bool optimize)
+	{
+		DXBCContainerHeader const * header = static_cast<DXBCContainerHeader const *>(dxbc_data);
+		if (KlayGE::LE2Native(header->fourcc) != KlayGE::MakeFourCC<'D', 'X', 'B', 'C'>::value)
+		{
+			return std::string();
+		}
+
+		std::ostringstream ss;
+		WriteUInt32(ss, has_gs);
+		WriteUInt32(ss, ds_partitioning);
+		WriteUInt32(ss, ds_output_primitive);
+		WriteUInt32(ss, version);
+		WriteUInt32(ss, glsl_rules);
+		WriteUInt32(ss, optimize);
+		ss.write(static_cast<char const *>(dxbc_data), KlayGE::LE2Native(header->total_size));
+		return ss.str();
+	}
+
+	uint64_t DXBC2GLSLCache::Key(std::string const & source)
+	{
+		uint64_t hash = FNV_OFFSET_BASIS;
+		FNVHash(hash, CACHE_VERSION);
+		FNVHash(hash, source.data(), source.size());
+		return hash;
+	}
+
+	bool DXBC2GLSLCache::Find(std::string const & source, DXBC2GLSL& translation)
+	{
+		if (source.empty())
+		{
+			return false;
+		}
+
+		uint64_t const key = Key(source);
+
+		std::shared_ptr<Entry const> entry;
+		std::string dir;
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			auto iter = entries_.find(key);
+			if ((iter != entries_.end()) && (iter->second->source == source))
+			{
+				entry = iter->second;
+			}
+			dir = dir_;
+		}
+
+		if (!entry && !dir.empty())
+		{
+			std::ifstream file(this->FileName(dir, key).c_str(), std::ios_base::binary);
+			if (file)
+			{
+				uint32_t const fourcc = ReadUInt32(file);
+				uint32_t const ver = ReadUInt32(file);
+				uint32_t const source_size = ReadUInt32(file);
+				if (file && (CACHE_FOURCC == fourcc) && (CACHE_VERSION == ver) && (source_size == source.size()))
+				{
+					// Sources with the same hash are told apart here
+					std::string file_source(source_size, '\0');
+					file.read(&file_source[0], source_size);
+					uint32_t const size = ReadUInt32(file);
+
+					// The payload must be exactly the rest of the file. Checked before allocating, so that a corrupted
+					//  size is a miss.
+					std::ifstream::pos_type const payload_begin = file.tellg();
+					file.seekg(0, std::ios_base::end);
+					std::ifstream::pos_type const file_end = file.tellg();
+					file.seekg(payload_begin);
+					if (file && (file_source == source) && (file_end - payload_begin == static_cast<std::streamoff>(size)))
+					{
+						std::string payload(size, '\0');
+						file.read(&payload[0], size);
+						if (file.gcount() == static_cast<std::streamsize>(size))
+						{
+							auto new_entry = std::make_shared<Entry>();
+							new_entry->source = source;
+							new_entry->translation = std::move(payload);
+							entry = new_entry;
+
+							std::lock_guard<std::mutex> lock(mutex_);
+							entries_[key] = entry;
+						}
+					}
+				}
+			}
+		}
+
+		bool found = false;
+		if (entry)
+		{
+			std::istringstream ss(entry->translation);
+			found = translation.Load(ss);
+		}
+
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (found)
+		{
+			++ num_hits_;
+		}
+		else
+		{
+			++ num_misses_;
+		}
+		return found;
+	}
+
+	void DXBC2GLSLCache::Add(std::string const & source, DXBC2GLSL const & translation)
+	{
+		if (source.empty())
+		{
+			return;
+		}
+
+		uint64_t const key = Key(source);
+
+		std::ostringstream ss;
+		translation.Save(ss);
+		auto new_entry = std::make_shared<Entry>();
+		new_entry->source = source;
+		new_entry->translation = ss.str();
+		std::shared_ptr<Entry const> entry = new_entry;
+
+		std::string dir;
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			entries_[key] = entry;
+			dir = dir_;
+		}
+
+		if (!dir.empty())
+		{
+			// Writes to a temporary file first, so that a reader in another process never sees a partial file
+			std::string const file_name = this->FileName(dir, key);
+			std::ostringstream tmp_ss;
+			tmp_ss << file_name << '.' << std::hash<std::thread::id>()(std::this_thread::get_id()) << ".tmp";
+			std::string const tmp_name = tmp_ss.str();
+			{
+				std::ofstream file(tmp_name.c_str(), std::ios_base::binary);
+				if (!file)
+				{
+					return;
+				}
+				WriteUInt32(file, CACHE_FOURCC);
+				WriteUInt32(file, CACHE_VERSION);
+				WriteUInt32(file, static_cast<uint32_t>(entry->source.size()));
+				file.write(entry->source.data(), entry->source.size());
+				WriteUInt32(file, static_cast<uint32_t>(entry->translation.size()));
+				file.write(entry->translation.data(), entry->translation.size());
+			}
+			if (std::rename(tmp_name.c_str(), file_name.c_str()) != 0)
+			{
+				std::remove(tmp_name.c_str());
+			}
+		}
+	}
+
+	void DXBC2GLSLCache::Clear()
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		entries_.clear();
+		num_hits_ = 0;
+		num_misses_ = 0;
+	}
+
+	uint32_t DXBC2GLSLCache::NumHits() const
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		return num_hits_;
+	}
+
+	uint32_t DXBC2GLSLCache::NumMisses() const
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		return num_misses_;
+	}
+
+	std::string DXBC2GLSLCache::FileName(std::string const & dir, uint64_t key) const
+	{
+		char buf[17];
+		std::snprintf(buf, sizeof(buf), "%08X%08X", static_cast<uint32_t>(key >> 32), static_cast<uint32_t>(key & 0xFFFFFFFF));
+		return dir + buf + ".dxgl";
+	}
+}
@@ -0,0 +1,1072 @@
+/**
+ * @file ShaderOptimize.cpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#include <DXBC2GLSL/Shader.hpp>
+#include <DXBC2GLSL/Utils.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <set>
+#include <sstream>
+
+namespace
+{
+	uint32_t const MAX_DCE_ITERATIONS = 8;
+
+	// Control flow, subroutines and phases. Nothing is known about registers across them.
+	bool IsBlockBoundary(uint32_t opcode)
+	{
+		switch (opcode)
+		{
+		case SO_IF:
+		case SO_ELSE:
+		case SO_ENDIF:
+		case SO_LOOP:
+		case SO_ENDLOOP:
+		case SO_BREAK:
+		case SO_BREAKC:
+		case SO_CONTINUE:
+		case SO_CONTINUEC:
+		case SO_SWITCH:
+		case SO_CASE:
+		case SO_DEFAULT:
+		case SO_ENDSWITCH:
+		case SO_RET:
+		case SO_RETC:
+		case SO_CALL:
+		case SO_CALLC:
+		case SO_INTERFACE_CALL:
+		case SO_LABEL:
+		case SO_HS_DECLS:
+		case SO_HS_CONTROL_POINT_PHASE:
+		case SO_HS_FORK_PHASE:
+		case SO_HS_JOIN_PHASE:
+			return true;
+
+		default:
+			return false;
+		}
+	}
+
+	// Instructions that write ops[0] only, and have no other side effect. They can be removed when ops[0] is dead.
+	bool IsPure(uint32_t opcode)
+	{
+		switch (opcode)
+		{
+		case SO_MOV:
+		case SO_MOVC:
+		case SO_ADD:
+		case SO_MUL:
+		case SO_MAD:
+		case SO_DIV:
+		case SO_MIN:
+		case SO_MAX:
+		case SO_DP2:
+		case SO_DP3:
+		case SO_DP4:
+		case SO_FRC:
+		case SO_ROUND_NE:
+		case SO_ROUND_NI:
+		case SO_ROUND_PI:
+		case SO_ROUND_Z:
+		case SO_EXP:
+		case SO_LOG:
+		case SO_SQRT:
+		case SO_RSQ:
+		case SO_RCP:
+		case SO_EQ:
+		case SO_NE:
+		case SO_LT:
+		case SO_GE:
+		case SO_IADD:
+		case SO_IMAD:
+		case SO_IMAX:
+		case SO_IMIN:
+		case SO_IEQ:
+		case SO_INE:
+		case SO_ILT:
+		case SO_IGE:
+		case SO_INEG:
+		case SO_ISHL:
+		case SO_ISHR:
+		case SO_ULT:
+		case SO_UGE:
+		case SO_UMAD:
+		case SO_UMAX:
+		case SO_UMIN:
+		case SO_USHR:
+		case SO_AND:
+		case SO_OR:
+		case SO_XOR:
+		case SO_NOT:
+		case SO_FTOI:
+		case SO_FTOU:
+		case SO_ITOF:
+		case SO_UTOF:
+		case SO_F16TOF32:
+		case SO_F32TOF16:
+		case SO_COUNTBITS:
+		case SO_BFREV:
+		case SO_FIRSTBIT_HI:
+		case SO_FIRSTBIT_LO:
+		case SO_FIRSTBIT_SHI:
+		case SO_IBFE:
+		case SO_UBFE:
+		case SO_BFI:
+		case SO_DERIV_RTX:
+		case SO_DERIV_RTY:
+		case SO_DERIV_RTX_COARSE:
+		case SO_DERIV_RTX_FINE:
+		case SO_DERIV_RTY_COARSE:
+		case SO_DERIV_RTY_FINE:
+		case SO_SAMPLE:
+		case SO_SAMPLE_C:
+		case SO_SAMPLE_C_LZ:
+		case SO_SAMPLE_L:
+		case SO_SAMPLE_D:
+		case SO_SAMPLE_B:
+		case SO_LD:
+		case SO_LD_MS:
+		case SO_LOD:
+		case SO_GATHER4:
+		case SO_GATHER4_C:
+		case SO_GATHER4_PO:
+		case SO_GATHER4_PO_C:
+		case SO_RESINFO:
+		case SO_SAMPLE_INFO:
+		case SO_SAMPLE_POS:
+		case SO_BUFINFO:
+			return true;
+
+		default:
+			return false;
+		}
+	}
+
+	// Instructions whose sources GLSLGen emits as plain vectors, so that a temp can be replaced by an immediate
+	bool AcceptsImmediateSources(uint32_t opcode)
+	{
+		switch (opcode)
+		{
+		case SO_ADD:
+		case SO_MUL:
+		case SO_MAD:
+		case SO_DIV:
+		case SO_MIN:
+		case SO_MAX:
+		case SO_DP2:
+		case SO_DP3:
+		case SO_DP4:
+		case SO_EQ:
+		case SO_NE:
+		case SO_LT:
+		case SO_GE:
+		case SO_IADD:
+		case SO_IMAD:
+		case SO_IMAX:
+		case SO_IMIN:
+		case SO_IEQ:
+		case SO_INE:
+		case SO_ILT:
+		case SO_IGE:
+		case SO_ISHL:
+		case SO_ISHR:
+		case SO_ULT:
+		case SO_UGE:
+		case SO_UMAX:
+		case SO_UMIN:
+		case SO_USHR:
+		case SO_OR:
+		case SO_XOR:
+			return true;
+
+		default:
+			return false;
+		}
+	}
+
+	bool IsTemp(ShaderOperand const & op)
+	{
+		return (SOT_TEMP == op.type) && op.HasSimpleIndex();
+	}
+
+	uint32_t TempIndex(ShaderOperand const & op)
+	{
+		return static_cast<uint32_t>(op.indices[0].disp);
+	}
+
+	uint32_t DestMask(ShaderOperand const & op)
+	{
+		return ((4 == op.comps) && (SOSM_MASK == op.mode)) ? (op.mask & 0xF) : 0xF;
+	}
+
+	// The components of a source operand that are read
+	uint32_t ReadMask(ShaderOperand const & op)
+	{
+		if (4 == op.comps)
+		{
+			switch (op.mode)
+			{
+			case SOSM_MASK:
+				return op.mask & 0xF;
+
+			case SOSM_SWIZZLE:
+				return (1UL << op.swizzle[0]) | (1UL << op.swizzle[1]) | (1UL << op.swizzle[2]) | (1UL << op.swizzle[3]);
+
+			case SOSM_SCALAR:
+				return 1UL << op.swizzle[0];
+
+			default:
+				break;
+			}
+		}
+		return 0xF;
+	}
+
+	// The register component feeding the component comp of a per-component instruction
+	uint32_t SourceComponent(ShaderOperand const & op, uint32_t comp)
+	{
+		if (4 == op.comps)
+		{
+			switch (op.mode)
+			{
+			case SOSM_SWIZZLE:
+				return op.swizzle[comp];
+
+			case SOSM_SCALAR:
+				return op.swizzle[0];
+
+			default:
+				return comp;
+			}
+		}
+		return 0;
+	}
+
+	uint32_t ImmComponent(ShaderOperand const & op, uint32_t comp)
+	{
+		return static_cast<uint32_t>(op.imm_values[(1 == op.comps) ? 0 : comp].i32);
+	}
+
+	void SetImmComponent(ShaderOperand& op, uint32_t comp, uint32_t value)
+	{
+		op.imm_values[comp].u64 = 0;
+		op.imm_values[comp].i32 = static_cast<int32_t>(value);
+	}
+
+	float AsFloat(uint32_t value)
+	{
+		union FNUI
+		{
+			float f;
+			uint32_t ui;
+		} fnui;
+		fnui.ui = value;
+		return fnui.f;
+	}
+
+	uint32_t AsUInt(float value)
+	{
+		union FNUI
+		{
+			float f;
+			uint32_t ui;
+		} fnui;
+		fnui.f = value;
+		return fnui.ui;
+	}
+
+	// GLSLGen prints float immediates with the default stream precision
+	bool PrintsExactly(uint32_t value)
+	{
+		std::ostringstream ss;
+		ss.setf(std::ios::showpoint);
+		ss << AsFloat(value);
+		return AsUInt(static_cast<float>(std::strtod(ss.str().c_str(), nullptr))) == value;
+	}
+
+	template <typename F>
+	void ForEachIndexRead(ShaderOperand const & op, F const & f)
+	{
+		for (uint32_t i = 0; i < op.num_indices; ++ i)
+		{
+			if (op.indices[i].reg)
+			{
+				ShaderOperand const & reg = *op.indices[i].reg;
+				if (SOT_TEMP == reg.type)
+				{
+					f(TempIndex(reg), ReadMask(reg));
+				}
+				ForEachIndexRead(reg, f);
+			}
+		}
+	}
+
+	// Calls f(temp, mask) for every temp the instruction may read. ops[0] of impure instructions is treated as read,
+	//  since it can't be told apart from a source without knowing the opcode.
+	template <typename F>
+	void ForEachTempRead(ShaderInstruction const & insn, F const & f)
+	{
+		bool const pure = IsPure(insn.opcode);
+		for (uint32_t i = 0; i < insn.num_ops; ++ i)
+		{
+			ShaderOperand const & op = *insn.ops[i];
+			ForEachIndexRead(op, f);
+			if ((SOT_TEMP == op.type) && !(pure && (0 == i)))
+			{
+				f(TempIndex(op), ReadMask(op));
+			}
+		}
+	}
+
+	bool WritesTemp(ShaderInstruction const & insn)
+	{
+		return IsPure(insn.opcode) && (insn.num_ops > 0) && IsTemp(*insn.ops[0]);
+	}
+
+	class ShaderOptimizer
+	{
+	public:
+		ShaderOptimizer(ShaderProgram& program, ShaderOptimizeStats& stats)
+			: program_(program), stats_(stats), num_temps_(0)
+		{
+		}
+
+		bool Prepare()
+		{
+			// Only r# with immediate indices are handled
+			for (auto const & insn : program_.insns)
+			{
+				for (uint32_t i = 0; i < insn->num_ops; ++ i)
+				{
+					if (!this->CollectTemps(*insn->ops[i]))
+					{
+						return false;
+					}
+				}
+			}
+			return true;
+		}
+
+		void PropagateAndFold()
+		{
+			copies_.assign(num_temps_ * 4, CopyEntry());
+
+			for (auto const & insn : program_.insns)
+			{
+				if (IsBlockBoundary(insn->opcode))
+				{
+					std::fill(copies_.begin(), copies_.end(), CopyEntry());
+					continue;
+				}
+
+				bool const pure = IsPure(insn->opcode);
+				if (pure)
+				{
+					for (uint32_t i = 1; i < insn->num_ops; ++ i)
+					{
+						this->Propagate(*insn, i);
+					}
+					if (WritesTemp(*insn) && this->Fold(*insn))
+					{
+						++ stats_.num_constants_folded;
+					}
+				}
+
+				if (pure)
+				{
+					if (WritesTemp(*insn))
+					{
+						this->RecordDefinition(*insn);
+					}
+				}
+				else
+				{
+					for (uint32_t i = 0; i < insn->num_ops; ++ i)
+					{
+						if (IsTemp(*insn->ops[i]))
+						{
+							this->Invalidate(TempIndex(*insn->ops[i]), 0xF);
+						}
+					}
+				}
+			}
+		}
+
+		void EliminateDeadCode()
+		{
+			for (uint32_t iter = 0; iter < MAX_DCE_ITERATIONS; ++ iter)
+			{
+				uint32_t const removed = this->RemoveNeverRead() + this->RemoveOverwritten();
+				if (0 == removed)
+				{
+					break;
+				}
+				stats_.num_dead_insns_removed += removed;
+			}
+		}
+
+		void PruneDeclarations()
+		{
+			std::set<ShaderOperand*> temp_ops;
+			std::set<int64_t> indexable_temps;
+			for (auto const & insn : program_.insns)
+			{
+				for (uint32_t i = 0; i < insn->num_ops; ++ i)
+				{
+					this->CollectOperands(*insn->ops[i], temp_ops, indexable_temps);
+				}
+			}
+
+			// Renumbers the temps that are still referenced densely
+			std::vector<uint32_t> remap(num_temps_, 0xFFFFFFFF);
+			for (auto op : temp_ops)
+			{
+				remap[TempIndex(*op)] = 0;
+			}
+			uint32_t num_used_temps = 0;
+			for (auto& index : remap)
+			{
+				if (index != 0xFFFFFFFF)
+				{
+					index = num_used_temps;
+					++ num_used_temps;
+				}
+			}
+			for (auto op : temp_ops)
+			{
+				op->indices[0].disp = remap[TempIndex(*op)];
+			}
+
+			for (auto iter = program_.dcls.begin(); iter != program_.dcls.end();)
+			{
+				if (SO_DCL_TEMPS == (*iter)->opcode)
+				{
+					(*iter)->num = std::min((*iter)->num, num_used_temps);
+				}
+				else if ((SO_DCL_INDEXABLE_TEMP == (*iter)->opcode)
+					&& (indexable_temps.find((*iter)->op->indices[0].disp) == indexable_temps.end()))
+				{
+					iter = program_.dcls.erase(iter);
+					continue;
+				}
+				++ iter;
+			}
+
+			stats_.num_temps_after = num_used_temps;
+		}
+
+		uint32_t NumTemps() const
+		{
+			return num_temps_;
+		}
+
+	private:
+		struct CopyEntry
+		{
+			bool valid;
+			bool is_imm;
+			uint32_t reg;
+			uint32_t comp;
+			uint32_t imm;
+
+			CopyEntry()
+				: valid(false), is_imm(false), reg(0), comp(0), imm(0)
+			{
+			}
+		};
+
+		bool CollectTemps(ShaderOperand const & op)
+		{
+			if (SOT_TEMP == op.type)
+			{
+				if (!op.HasSimpleIndex())
+				{
+					return false;
+				}
+				num_temps_ = std::max(num_temps_, TempIndex(op) + 1);
+			}
+			for (uint32_t i = 0; i < op.num_indices; ++ i)
+			{
+				if (op.indices[i].reg && !this->CollectTemps(*op.indices[i].reg))
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+
+		void CollectOperands(ShaderOperand& op, std::set<ShaderOperand*>& temp_ops, std::set<int64_t>& indexable_temps)
+		{
+			if (SOT_TEMP == op.type)
+			{
+				temp_ops.insert(&op);
+			}
+			else if (SOT_INDEXABLE_TEMP == op.type)
+			{
+				indexable_temps.insert(op.indices[0].disp);
+			}
+			for (uint32_t i = 0; i < op.num_indices; ++ i)
+			{
+				if (op.indices[i].reg)
+				{
+					this->CollectOperands(*op.indices[i].reg, temp_ops, indexable_temps);
+				}
+			}
+		}
+
+		void Invalidate(uint32_t reg, uint32_t mask)
+		{
+			for (uint32_t c = 0; c < 4; ++ c)
+			{
+				if (mask & (1UL << c))
+				{
+					copies_[reg * 4 + c].valid = false;
+				}
+			}
+			for (auto& entry : copies_)
+			{
+				if (entry.valid && !entry.is_imm && (entry.reg == reg) && (mask & (1UL << entry.comp)))
+				{
+					entry.valid = false;
+				}
+			}
+		}
+
+		void RecordDefinition(ShaderInstruction const & insn)
+		{
+			ShaderOperand const & dst = *insn.ops[0];
+			uint32_t const reg = TempIndex(dst);
+			uint32_t const mask = DestMask(dst);
+
+			CopyEntry new_entries[4];
+			if ((SO_MOV == insn.opcode) && !insn.insn.sat && !insn.ops[1]->neg && !insn.ops[1]->abs
+				&& (0 == insn.ops[1]->num_indices || IsTemp(*insn.ops[1])))
+			{
+				ShaderOperand const & src = *insn.ops[1];
+				for (uint32_t c = 0; c < 4; ++ c)
+				{
+					if (mask & (1UL << c))
+					{
+						if (SOT_IMMEDIATE32 == src.type)
+						{
+							new_entries[c].valid = true;
+							new_entries[c].is_imm = true;
+							new_entries[c].imm = ImmComponent(src, c);
+						}
+						else if (IsTemp(src) && (TempIndex(src) != reg))
+						{
+							new_entries[c].valid = true;
+							new_entries[c].reg = TempIndex(src);
+							new_entries[c].comp = SourceComponent(src, c);
+						}
+					}
+				}
+			}
+
+			this->Invalidate(reg, mask);
+			for (uint32_t c = 0; c < 4; ++ c)
+			{
+				if (new_entries[c].valid)
+				{
+					copies_[reg * 4 + c] = new_entries[c];
+				}
+			}
+		}
+
+		// Replaces a temp source with the register or the immediate it was copied from
+		void Propagate(ShaderInstruction& insn, uint32_t op_index)
+		{
+			ShaderOperand const & op = *insn.ops[op_index];
+			if (!IsTemp(op) || (op.comps != 4) || (SOSM_MASK == op.mode))
+			{
+				return;
+			}
+
+			uint32_t const reg = TempIndex(op);
+			uint32_t const num_comps = (SOSM_SCALAR == op.mode) ? 1 : 4;
+			CopyEntry const * entries[4];
+			for (uint32_t i = 0; i < num_comps; ++ i)
+			{
+				entries[i] = &copies_[reg * 4 + op.swizzle[i]];
+				if (!entries[i]->valid || (entries[i]->is_imm != entries[0]->is_imm)
+					|| (!entries[i]->is_imm && (entries[i]->reg != entries[0]->reg)))
+				{
+					return;
+				}
+			}
+
+			auto new_op = KlayGE::MakeSharedPtr<ShaderOperand>(op);
+			if (entries[0]->is_imm)
+			{
+				if (!AcceptsImmediateSources(insn.opcode))
+				{
+					return;
+				}
+
+				ShaderImmType const in_type = GetOpInType(insn.opcode);
+				for (uint32_t i = 0; i < num_comps; ++ i)
+				{
+					uint32_t const value = entries[i]->imm;
+					if (((SIT_Float == in_type) && !(ValidFloat(AsFloat(value)) && PrintsExactly(value)))
+						|| ((SIT_UInt == in_type) && ((0xC0490FDB == value) || (0x3F800000 == value))))
+					{
+						return;
+					}
+				}
+
+				new_op->type = SOT_IMMEDIATE32;
+				new_op->mode = SOSM_MASK;
+				new_op->mask = 0xF;
+				new_op->comps = static_cast<uint8_t>(num_comps);
+				new_op->num_indices = 0;
+				new_op->indices[0].disp = 0;
+				for (uint32_t i = 0; i < num_comps; ++ i)
+				{
+					SetImmComponent(*new_op, i, entries[i]->imm);
+				}
+			}
+			else
+			{
+				new_op->indices[0].disp = entries[0]->reg;
+				for (uint32_t i = 0; i < num_comps; ++ i)
+				{
+					new_op->swizzle[i] = static_cast<uint8_t>(entries[i]->comp);
+				}
+				if (1 == num_comps)
+				{
+					new_op->swizzle[1] = new_op->swizzle[2] = new_op->swizzle[3] = new_op->swizzle[0];
+				}
+			}
+
+			insn.ops[op_index] = new_op;
+			++ stats_.num_copies_propagated;
+		}
+
+		// Evaluates instructions whose sources are all immediates, and turns them into a mov of the result
+		bool Fold(ShaderInstruction& insn)
+		{
+			if ((insn.num_ops < 2) || (insn.num_ops > 4))
+			{
+				return false;
+			}
+			for (uint32_t i = 1; i < insn.num_ops; ++ i)
+			{
+				if (insn.ops[i]->type != SOT_IMMEDIATE32)
+				{
+					return false;
+				}
+			}
+
+			ShaderImmType const in_type = GetOpInType(insn.opcode);
+			ShaderImmType const out_type = GetOpOutType(insn.opcode);
+			uint32_t const mask = DestMask(*insn.ops[0]);
+
+			uint32_t results[4] = { 0, 0, 0, 0 };
+			int first_comp = -1;
+			for (uint32_t c = 0; c < 4; ++ c)
+			{
+				if (!(mask & (1UL << c)))
+				{
+					continue;
+				}
+
+				uint32_t srcs[3] = { 0, 0, 0 };
+				for (uint32_t i = 1; i < insn.num_ops; ++ i)
+				{
+					ShaderOperand const & src = *insn.ops[i];
+					uint32_t value = ImmComponent(src, c);
+					if (SIT_Float == in_type)
+					{
+						float f = AsFloat(value);
+						if (src.abs)
+						{
+							f = std::abs(f);
+						}
+						if (src.neg)
+						{
+							f = -f;
+						}
+						value = AsUInt(f);
+					}
+					else
+					{
+						if (src.abs)
+						{
+							return false;
+						}
+						if (src.neg)
+						{
+							value = 0 - value;
+						}
+					}
+					srcs[i - 1] = value;
+				}
+
+				if (!this->Evaluate(insn.opcode, srcs, results[c]))
+				{
+					return false;
+				}
+				if (SIT_Float == out_type)
+				{
+					float const f = AsFloat(results[c]);
+					if (!std::isfinite(f))
+					{
+						return false;
+					}
+					if (insn.insn.sat)
+					{
+						results[c] = AsUInt(std::min(std::max(f, 0.0f), 1.0f));
+					}
+				}
+
+				if (first_comp < 0)
+				{
+					first_comp = c;
+				}
+			}
+			if (first_comp < 0)
+			{
+				return false;
+			}
+
+			// GLSLGen types an immediate mov as float only if every component looks like a float. Mixed vectors would
+			//  be converted by value, so they are left alone.
+			bool any_float = false;
+			bool any_int = false;
+			for (uint32_t c = 0; c < 4; ++ c)
+			{
+				if (!(mask & (1UL << c)))
+				{
+					results[c] = results[first_comp];
+				}
+				if (ValidFloat(AsFloat(results[c])))
+				{
+					if (!PrintsExactly(results[c]))
+					{
+						return false;
+					}
+					any_float = true;
+				}
+				else
+				{
+					any_int = true;
+				}
+			}
+			if (any_float && any_int)
+			{
+				return false;
+			}
+
+			auto imm = KlayGE::MakeSharedPtr<ShaderOperand>();
+			imm->type = SOT_IMMEDIATE32;
+			imm->mode = SOSM_MASK;
+			imm->mask = 0xF;
+			imm->comps = 4;
+			for (uint32_t c = 0; c < 4; ++ c)
+			{
+				SetImmComponent(*imm, c, results[c]);
+			}
+
+			insn.opcode = SO_MOV;
+			insn.insn.sat = 0;
+			insn.num_ops = 2;
+			insn.ops[1] = imm;
+			for (uint32_t i = 2; i < SM_MAX_OPS; ++ i)
+			{
+				insn.ops[i].reset();
+			}
+			return true;
+		}
+
+		bool Evaluate(uint32_t opcode, uint32_t const srcs[3], uint32_t& result) const
+		{
+			float const fa = AsFloat(srcs[0]);
+			float const fb = AsFloat(srcs[1]);
+			float const fc = AsFloat(srcs[2]);
+			int32_t const ia = static_cast<int32_t>(srcs[0]);
+			int32_t const ib = static_cast<int32_t>(srcs[1]);
+			uint32_t const ua = srcs[0];
+			uint32_t const ub = srcs[1];
+			uint32_t const uc = srcs[2];
+
+			switch (opcode)
+			{
+			case SO_ADD:
+				result = AsUInt(fa + fb);
+				break;
+
+			case SO_MUL:
+				result = AsUInt(fa * fb);
+				break;
+
+			case SO_MAD:
+				result = AsUInt(fa * fb + fc);
+				break;
+
+			case SO_DIV:
+				result = AsUInt(fa / fb);
+				break;
+
+			case SO_MIN:
+				result = AsUInt(std::min(fa, fb));
+				break;
+
+			case SO_MAX:
+				result = AsUInt(std::max(fa, fb));
+				break;
+
+			case SO_EQ:
+				result = (fa == fb) ? 0xFFFFFFFF : 0;
+				break;
+
+			case SO_NE:
+				result = (fa != fb) ? 0xFFFFFFFF : 0;
+				break;
+
+			case SO_LT:
+				result = (fa < fb) ? 0xFFFFFFFF : 0;
+				break;
+
+			case SO_GE:
+				result = (fa >= fb) ? 0xFFFFFFFF : 0;
+				break;
+
+			case SO_IADD:
+				result = ua + ub;
+				break;
+
+			case SO_IMAD:
+				result = ua * ub + uc;
+				break;
+
+			case SO_IMAX:
+				result = static_cast<uint32_t>(std::max(ia, ib));
+				break;
+
+			case SO_IMIN:
+				result = static_cast<uint32_t>(std::min(ia, ib));
+				break;
+
+			case SO_UMAX:
+				result = std::max(ua, ub);
+				break;
+
+			case SO_UMIN:
+				result = std::min(ua, ub);
+				break;
+
+			case SO_IEQ:
+				result = (ua == ub) ? 0xFFFFFFFF : 0;
+				break;
+
+			case SO_INE:
+				result = (ua != ub) ? 0xFFFFFFFF : 0;
+				break;
+
+			case SO_ILT:
+				result = (ia < ib) ? 0xFFFFFFFF : 0;
+				break;
+
+			case SO_IGE:
+				result = (ia >= ib) ? 0xFFFFFFFF : 0;
+				break;
+
+			case SO_ULT:
+				result = (ua < ub) ? 0xFFFFFFFF : 0;
+				break;
+
+			case SO_UGE:
+				result = (ua >= ub) ? 0xFFFFFFFF : 0;
+				break;
+
+			case SO_INEG:
+				result = 0 - ua;
+				break;
+
+			case SO_AND:
+				result = ua & ub;
+				break;
+
+			case SO_OR:
+				result = ua | ub;
+				break;
+
+			case SO_XOR:
+				result = ua ^ ub;
+				break;
+
+			case SO_NOT:
+				result = ~ua;
+				break;
+
+			case SO_ISHL:
+				result = ua << (ub & 31);
+				break;
+
+			case SO_ISHR:
+				result = static_cast<uint32_t>(ia >> (ub & 31));
+				break;
+
+			case SO_USHR:
+				result = ua >> (ub & 31);
+				break;
+
+			case SO_ITOF:
+				result = AsUInt(static_cast<float>(ia));
+				break;
+
+			case SO_UTOF:
+				result = AsUInt(static_cast<float>(ua));
+				break;
+
+			case SO_FTOI:
+				if (!((fa > -2147483648.0f) && (fa < 2147483648.0f)))
+				{
+					return false;
+				}
+				result = static_cast<uint32_t>(static_cast<int32_t>(fa));
+				break;
+
+			case SO_FTOU:
+				if (!((fa >= 0) && (fa < 4294967296.0f)))
+				{
+					return false;
+				}
+				result = static_cast<uint32_t>(fa);
+				break;
+
+			default:
+				return false;
+			}
+
+			return true;
+		}
+
+		// Removes pure instructions writing components that no instruction ever reads
+		uint32_t RemoveNeverRead()
+		{
+			std::vector<uint8_t> read(num_temps_, 0);
+			for (auto const & insn : program_.insns)
+			{
+				ForEachTempRead(*insn, [&read](uint32_t reg, uint32_t mask)
+					{
+						read[reg] |= static_cast<uint8_t>(mask);
+					});
+			}
+
+			uint32_t const num_insns = static_cast<uint32_t>(program_.insns.size());
+			program_.insns.erase(std::remove_if(program_.insns.begin(), program_.insns.end(),
+				[&read](std::shared_ptr<ShaderInstruction> const & insn)
+				{
+					return WritesTemp(*insn) && !(read[TempIndex(*insn->ops[0])] & DestMask(*insn->ops[0]));
+				}), program_.insns.end());
+			return num_insns - static_cast<uint32_t>(program_.insns.size());
+		}
+
+		// Removes pure instructions whose result is overwritten in the same block before being read
+		uint32_t RemoveOverwritten()
+		{
+			std::vector<uint8_t> live(num_temps_, 0xF);
+			std::vector<bool> dead(program_.insns.size(), false);
+			uint32_t num_dead = 0;
+			for (size_t i = program_.insns.size(); i > 0; -- i)
+			{
+				ShaderInstruction const & insn = *program_.insns[i - 1];
+				if (IsBlockBoundary(insn.opcode))
+				{
+					std::fill(live.begin(), live.end(), static_cast<uint8_t>(0xF));
+					continue;
+				}
+
+				if (WritesTemp(insn))
+				{
+					uint32_t const reg = TempIndex(*insn.ops[0]);
+					uint32_t const mask = DestMask(*insn.ops[0]);
+					if (!(live[reg] & mask))
+					{
+						dead[i - 1] = true;
+						++ num_dead;
+						continue;
+					}
+					live[reg] &= ~mask;
+				}
+
+				ForEachTempRead(insn, [&live](uint32_t reg, uint32_t mask)
+					{
+						live[reg] |= static_cast<uint8_t>(mask);
+					});
+			}
+
+			if (num_dead > 0)
+			{
+				size_t j = 0;
+				for (size_t i = 0; i < program_.insns.size(); ++ i)
+				{
+					if (!dead[i])
+					{
+						program_.insns[j] = program_.insns[i];
+						++ j;
+					}
+				}
+				program_.insns.resize(j);
+			}
+			return num_dead;
+		}
+
+	private:
+		ShaderProgram& program_;
+		ShaderOptimizeStats& stats_;
+		uint32_t num_temps_;
+		std::vector<CopyEntry> copies_;
+	};
+}
+
+ShaderOptimizeStats ShaderOptimize(ShaderProgram& program)
+{
+	ShaderOptimizeStats stats;
+	stats.num_insns_before = static_cast<uint32_t>(program.insns.size());
+
+	ShaderOptimizer optimizer(program, stats);
+	bool const can_optimize = optimizer.Prepare();
+	stats.num_temps_before = optimizer.NumTemps();
+	stats.num_temps_after = stats.num_temps_before;
+
+	// Hull shaders are split into phases by GLSLGen, with their own copies of the instructions. They are left as is.
+	if (can_optimize && (program.version.type != ST_HS))
+	{
+		optimizer.PropagateAndFold();
+		optimizer.EliminateDeadCode();
+		optimizer.PruneDeclarations();
+	}
+
+	stats.num_insns_after = static_cast<uint32_t>(program.insns.size());
+	return stats;
+}
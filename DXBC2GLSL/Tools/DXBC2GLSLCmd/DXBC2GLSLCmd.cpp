@@ -40,12 +40,21 @@ void usage()
 	std::cerr << "Not affiliated with or endorsed by Microsoft in any way\n";
 	std::cerr << "Latest version available from http://www.klayge.org/\n";
 	std::cerr << "\n";
-	std::cerr << "Usage: DXBC2GLSLCmd FILE [OUTPUT]\n";
+	std::cerr << "Usage: DXBC2GLSLCmd [-O] FILE [OUTPUT]\n";
+	std::cerr << "\t-O\tEnable the IR optimizations\n";
 	std::cerr << std::endl;
 }
 
 int main(int argc, char** argv)
 {
+	bool optimize = false;
+	if ((argc >= 2) && (std::string("-O") == argv[1]))
+	{
+		optimize = true;
+		-- argc;
+		++ argv;
+	}
+
 	if (argc < 2)
 	{
 		usage();
@@ -76,6 +85,7 @@ int main(int argc, char** argv)
 	try
 	{
 		DXBC2GLSL::DXBC2GLSL dxbc2glsl;
+		dxbc2glsl.Optimize(optimize);
 		dxbc2glsl.FeedDXBC(&data[0], true, STP_Fractional_Odd, STOP_Triangle_CW, GSV_430);
 		std::string glsl = dxbc2glsl.GLSLString();
 		if (!screen_only)
@@ -130,6 +140,18 @@ int main(int argc, char** argv)
 			std::cout << std::endl;
 		}
 
+		if (optimize)
+		{
+			ShaderOptimizeStats const & stats = dxbc2glsl.OptimizeStats();
+			std::cout << "Optimization:" << std::endl;
+			std::cout << "\tInstructions: " << stats.num_insns_before << " -> " << stats.num_insns_after << std::endl;
+			std::cout << "\tTemps: " << stats.num_temps_before << " -> " << stats.num_temps_after << std::endl;
+			std::cout << "\tCopies propagated: " << stats.num_copies_propagated << std::endl;
+			std::cout << "\tConstants folded: " << stats.num_constants_folded << std::endl;
+			std::cout << "\tDead instructions removed: " << stats.num_dead_insns_removed << std::endl;
+			std::cout << std::endl;
+		}
+
 		if (dxbc2glsl.GSInputPrimitive() != SP_Undefined)
 		{
 			std::cout << "GS input primitive: " << ShaderPrimitiveName(dxbc2glsl.GSInputPrimitive()) << std::endl;
@@ -132,6 +132,7 @@
 
 			#define KLAYGE_TS_LIBRARY_ANY_SUPPORT
 			#define KLAYGE_TS_LIBRARY_OPTIONAL_SUPPORT
+			#define KLAYGE_TS_LIBRARY_STRING_VIEW_SUPPORT
 		#endif
 
 		#define KLAYGE_SYMBOL_EXPORT __declspec(dllexport)
@@ -144,6 +145,7 @@
 		#endif
 
 		#define KLAYGE_TS_LIBRARY_OPTIONAL_SUPPORT
+		#define KLAYGE_TS_LIBRARY_STRING_VIEW_SUPPORT
 
 		#define KLAYGE_SYMBOL_EXPORT __attribute__((__visibility__("default")))
 		#define KLAYGE_SYMBOL_IMPORT
@@ -182,6 +184,7 @@
 	#define KLAYGE_CXX11_CORE_NOEXCEPT_SUPPORT
 	#define KLAYGE_TS_LIBRARY_ANY_SUPPORT
 	#define KLAYGE_TS_LIBRARY_OPTIONAL_SUPPORT
+	#define KLAYGE_TS_LIBRARY_STRING_VIEW_SUPPORT
 	#if KLAYGE_COMPILER_VERSION >= 61
 		#define KLAYGE_TS_LIBRARY_FILESYSTEM_V3_SUPPORT
 	#endif
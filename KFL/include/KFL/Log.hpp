@@ -33,11 +33,66 @@
 
 #pragma once
 
+#include <KFL/Types.hpp>
+
+// Records below this level, or out of this category mask, are removed at compile time when logged by KLAYGE_LOG
+#ifndef KLAYGE_LOG_MIN_LEVEL
+	#define KLAYGE_LOG_MIN_LEVEL 0
+#endif
+#ifndef KLAYGE_LOG_CATEGORY_MASK
+	#define KLAYGE_LOG_CATEGORY_MASK 0xFFFFFFFFU
+#endif
+
+#define KLAYGE_LOG(level, category, ...) \
+	do \
+	{ \
+		if ((static_cast<int>(level) >= KLAYGE_LOG_MIN_LEVEL) \
+			&& ((1U << static_cast<int>(category)) & KLAYGE_LOG_CATEGORY_MASK) \
+			&& KlayGE::LogEnabled(level, category)) \
+		{ \
+			KlayGE::Log(level, category, __VA_ARGS__); \
+		} \
+	} while (false)
+
 namespace KlayGE
 {
+	enum LogLevel
+	{
+		LL_Info = 0,
+		LL_Warn,
+		LL_Error
+	};
+
+	enum LogCategory
+	{
+		LC_General = 0,
+		LC_Render,
+		LC_Audio,
+		LC_Input,
+		LC_Resource,
+		LC_Script,
+		LC_Network,
+
+		LC_NumCategories
+	};
+
+	// Records are formatted on the calling thread and queued. A background thread writes them out, so logging never
+	//  blocks or flushes on the caller. When the queue is full, records are dropped and counted.
+	// LL_Error records are the exception. They are written and flushed before the call returns, after the records
+	//  queued before them, so they aren't lost if the process aborts right after.
+	void Log(LogLevel level, LogCategory category, char const * fmt, ...);
 	void LogInfo(char const * fmt, ...);
 	void LogWarn(char const * fmt, ...);
 	void LogError(char const * fmt, ...);
+
+	// Runtime filters. All categories are enabled at LL_Info by default.
+	void LogMinLevel(LogLevel level);
+	LogLevel LogMinLevel();
+	void LogCategoryEnabled(LogCategory category, bool enabled);
+	bool LogEnabled(LogLevel level, LogCategory category);
+
+	// Blocks until all queued records are written
+	void LogFlush();
 }
 
 #endif		// _KFL_LOG_HPP
@@ -67,9 +67,49 @@ namespace KlayGE
 			T tileable_turbulence(T x, T y, T z,
 				T w, T h, T d, int octaves, T lacunarity = T(2), T gain = T(0.5)) KLAYGE_NOEXCEPT;
 
+			// Batch versions. Evaluate n points, 4 at a time with SSE. The results are within 1e-5 of the functions above,
+			//  and identical unless the compiler contracts the scalar math into FMAs. They don't share state, so different
+			//  threads can work on different ranges.
+			void noise(T const * x, T const * y, T* ret, size_t n) KLAYGE_NOEXCEPT;
+			void noise(T const * x, T const * y, T const * z, T* ret, size_t n) KLAYGE_NOEXCEPT;
+
+			void fBm(T const * x, T const * y, T* ret, size_t n,
+				int octaves, T lacunarity = T(2), T gain = T(0.5)) KLAYGE_NOEXCEPT;
+			void fBm(T const * x, T const * y, T const * z, T* ret, size_t n,
+				int octaves, T lacunarity = T(2), T gain = T(0.5)) KLAYGE_NOEXCEPT;
+
+			void turbulence(T const * x, T const * y, T* ret, size_t n,
+				int octaves, T lacunarity = T(2), T gain = T(0.5)) KLAYGE_NOEXCEPT;
+			void turbulence(T const * x, T const * y, T const * z, T* ret, size_t n,
+				int octaves, T lacunarity = T(2), T gain = T(0.5)) KLAYGE_NOEXCEPT;
+
+			void tileable_noise(T const * x, T const * y, T* ret, size_t n, T w, T h) KLAYGE_NOEXCEPT;
+			void tileable_noise(T const * x, T const * y, T const * z, T* ret, size_t n, T w, T h, T d) KLAYGE_NOEXCEPT;
+
+			void tileable_fBm(T const * x, T const * y, T* ret, size_t n, T w, T h,
+				int octaves, T lacunarity = T(2), T gain = T(0.5)) KLAYGE_NOEXCEPT;
+			void tileable_fBm(T const * x, T const * y, T const * z, T* ret, size_t n, T w, T h, T d,
+				int octaves, T lacunarity = T(2), T gain = T(0.5)) KLAYGE_NOEXCEPT;
+
+			void tileable_turbulence(T const * x, T const * y, T* ret, size_t n, T w, T h,
+				int octaves, T lacunarity = T(2), T gain = T(0.5)) KLAYGE_NOEXCEPT;
+			void tileable_turbulence(T const * x, T const * y, T const * z, T* ret, size_t n, T w, T h, T d,
+				int octaves, T lacunarity = T(2), T gain = T(0.5)) KLAYGE_NOEXCEPT;
+
 		private:
 			SimplexNoise() KLAYGE_NOEXCEPT;
 
+			// Octaves of the batch functions. The points are processed in chunks of BATCH_CHUNK.
+			template <bool ABS, bool TILEABLE>
+			void octaves2(T const * x, T const * y, T* ret, size_t n, T w, T h,
+				int octaves, T lacunarity, T gain) KLAYGE_NOEXCEPT;
+			template <bool ABS, bool TILEABLE>
+			void octaves3(T const * x, T const * y, T const * z, T* ret, size_t n, T w, T h, T d,
+				int octaves, T lacunarity, T gain) KLAYGE_NOEXCEPT;
+
+		private:
+			static size_t const BATCH_CHUNK = 256;
+
 		private:
 			int p_[512];
 			Vector_T<T, 3> g_[12];
@@ -256,6 +256,21 @@ namespace KlayGE
 		///////////////////////////////////////////////////////////////////////////////
 		SIMDVectorF4 NegativeColor(SIMDVectorF4 const & rhs);
 		SIMDVectorF4 ModulateColor(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs);
+
+
+		// Batch
+		///////////////////////////////////////////////////////////////////////////////
+		// Arrays of any length, with the kernel picked once from the CPU features: AVX2, SSE or NEON. Positions are
+		//  SoA streams. Outputs may alias inputs. The results match transform_coord, mul and transform_aabb of MathLib,
+		//  except that boxes are transformed by the affine part of mat.
+		void TransformCoordBatch(float* out_x, float* out_y, float* out_z,
+			float const * x, float const * y, float const * z, size_t num, float4x4 const & mat);
+		// The z of transform_coord, such as the view space depths of particles
+		void TransformDepthBatch(float* depth, float const * x, float const * y, float const * z, size_t num,
+			float4x4 const & mat);
+		void TransformAABBBatch(AABBox* out, AABBox const * in, size_t num, float4x4 const & mat);
+		// out[i] = lhs[i] * rhs
+		void MultiplyBatch(float4x4* out, float4x4 const * lhs, size_t num, float4x4 const & rhs);
 	}
 }
 
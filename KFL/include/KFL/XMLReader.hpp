@@ -0,0 +1,169 @@
+/**
+ * @file XMLReader.hpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KFL, a subproject of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#ifndef _KFL_XMLREADER_HPP
+#define _KFL_XMLREADER_HPP
+
+#pragma once
+
+#include <KFL/CXX17/string_view.hpp>
+
+#include <string>
+#include <vector>
+
+namespace KlayGE
+{
+	enum XMLReaderEvent
+	{
+		XRE_StartElement,
+		XRE_EndElement,
+		XRE_Text,
+		XRE_EndOfDocument
+	};
+
+	// A forward-only pull parser. The source is read through a sliding window, so memory stays bounded by the
+	//  largest single tag instead of the document size, and no node objects are allocated. Names, values and text
+	//  are views into the window. They are valid until the next call to Next(), SkipElement() or ReadElementXML().
+	class XMLReader
+	{
+	public:
+		explicit XMLReader(ResIdentifierPtr const & source, size_t window_size = 64 * 1024);
+
+		// Moves to the next start tag, end tag or non-blank text. Declarations, comments, PIs and DOCTYPEs are
+		//  skipped. An empty element <a/> is reported as a start followed by an end. Throws on an end tag that
+		//  doesn't match the open element.
+		XMLReaderEvent Next();
+		// Moves to the next start tag of a child of the element enclosing the cursor. Returns false after consuming
+		//  the end tag of that element.
+		bool NextChildElement(uint32_t parent_depth);
+		// When on a start tag, consumes everything up to and including the matching end tag.
+		void SkipElement();
+		// When on a start tag, consumes the element like SkipElement and returns its unparsed XML, so small
+		//  subtrees can still be handed to XMLDocument.
+		std::string ReadElementXML();
+
+		XMLReaderEvent Event() const
+		{
+			return event_;
+		}
+		// Number of open elements, including the current one on a start tag.
+		uint32_t Depth() const
+		{
+			return depth_;
+		}
+		bool IsEmptyElement() const
+		{
+			return empty_element_;
+		}
+
+		std::string_view Name() const
+		{
+			return name_;
+		}
+		// Raw text, entities are not decoded.
+		std::string_view Value() const
+		{
+			return value_;
+		}
+		// The text with entities decoded. The content of a CDATA section is returned verbatim.
+		std::string ValueString() const;
+
+		uint32_t NumAttribs() const
+		{
+			return static_cast<uint32_t>(attrs_.size());
+		}
+		std::string_view AttribName(uint32_t index) const
+		{
+			return attrs_[index].name;
+		}
+		// Raw value, entities are not decoded.
+		std::string_view AttribValue(uint32_t index) const
+		{
+			return attrs_[index].value;
+		}
+		bool HasAttrib(std::string_view name) const;
+
+		bool TryConvertAttrib(std::string_view name, int32_t& val, int32_t default_val) const;
+		bool TryConvertAttrib(std::string_view name, uint32_t& val, uint32_t default_val) const;
+		bool TryConvertAttrib(std::string_view name, float& val, float default_val) const;
+
+		int32_t AttribInt(std::string_view name, int32_t default_val) const;
+		uint32_t AttribUInt(std::string_view name, uint32_t default_val) const;
+		float AttribFloat(std::string_view name, float default_val) const;
+		std::string AttribString(std::string_view name, std::string const & default_val) const;
+
+		// Parses up to max_count space separated numbers. Returns how many were parsed, 0 if the attribute is missing.
+		uint32_t AttribFloats(std::string_view name, float* vals, uint32_t max_count) const;
+		uint32_t AttribUInts(std::string_view name, uint32_t* vals, uint32_t max_count) const;
+
+		// Locale independent conversions of a whole string. Floats are rounded correctly.
+		static bool ParseInt(std::string_view str, int32_t& val);
+		static bool ParseUInt(std::string_view str, uint32_t& val);
+		static bool ParseFloat(std::string_view str, float& val);
+
+	private:
+		struct Attrib
+		{
+			std::string_view name;
+			std::string_view value;
+		};
+
+		bool Refill();
+		char PeekChar(size_t offset);
+		size_t FindSequence(size_t offset, char const * seq, size_t len);
+		void ParseTag(size_t len);
+		std::string_view const * FindAttrib(std::string_view name) const;
+
+	private:
+		ResIdentifierPtr source_;
+
+		std::vector<char> window_;
+		size_t pos_;
+		size_t end_;
+		bool eof_;
+
+		bool capturing_;
+		size_t capture_pos_;
+		std::string capture_;
+
+		XMLReaderEvent event_;
+		uint32_t depth_;
+		bool empty_element_;
+		bool pending_end_;
+		size_t tag_pos_;
+		std::string_view name_;
+		std::string_view value_;
+		bool cdata_;
+		std::vector<Attrib> attrs_;
+		std::vector<std::string> open_names_;
+	};
+}
+
+#endif		// _KFL_XMLREADER_HPP
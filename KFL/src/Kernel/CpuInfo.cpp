@@ -42,6 +42,7 @@
 #include <intrin.h>
 #endif
 #endif
+#include <cstring>
 #include <vector>
 #include <boost/assert.hpp>
 
@@ -293,6 +294,8 @@ namespace
 		void Call(uint32_t fn)
 		{
 			eax_ = fn;
+			// Sub-leaf 0. Leaf 7 reports AVX2 only in sub-leaf 0.
+			ecx_ = 0;
 			get_cpuid(&eax_, &ebx_, &ecx_, &edx_);
 		}
 
@@ -346,12 +349,12 @@ namespace KlayGE
 			feature_mask_ |= cpuid.Ecx() & CFM_SSSE3 ? CF_SSSE3 : 0;
 			feature_mask_ |= cpuid.Ecx() & CFM_SSE41 ? CF_SSE41 : 0;
 			feature_mask_ |= cpuid.Ecx() & CFM_SSE42 ? CF_SSE42 : 0;
-			feature_mask_ |= (cpuid.Ecx() & CFM_OSXSAVE) && (cpuid.Ecx() & CFM_FMA3 ? CF_FMA3 : 0);
+			feature_mask_ |= ((cpuid.Ecx() & CFM_OSXSAVE) && (cpuid.Ecx() & CFM_FMA3)) ? CF_FMA3 : 0;
 			feature_mask_ |= cpuid.Ecx() & CFM_MOVBE ? CF_MOVBE : 0;
 			feature_mask_ |= cpuid.Ecx() & CFM_POPCNT ? CF_POPCNT : 0;
 			feature_mask_ |= cpuid.Ecx() & CFM_AES ? CF_AES : 0;
 			feature_mask_ |= (cpuid.Ecx() & CFM_OSXSAVE) && (cpuid.Ecx() & CFM_AVX) ? CF_AVX : 0;
-			feature_mask_ |= (cpuid.Ecx() & CFM_OSXSAVE) && (cpuid.Ecx() & CFM_F16C ? CF_F16C : 0);
+			feature_mask_ |= ((cpuid.Ecx() & CFM_OSXSAVE) && (cpuid.Ecx() & CFM_F16C)) ? CF_F16C : 0;
 
 			if (max_std_fn >= 7)
 			{
@@ -375,7 +378,7 @@ namespace KlayGE
 					feature_mask_ |= cpuid.Ecx() & CFM_MisalignedSSE_AMD ? CF_MisalignedSSE : 0;
 				}
 				feature_mask_ |= cpuid.Edx() & CFM_X64 ? CF_X64 : 0;
-				feature_mask_ |= (cpuid.Ecx() & CFM_OSXSAVE) && (cpuid.Ecx() & CFM_FMA4 ? CF_FMA4 : 0);
+				feature_mask_ |= ((cpuid.Ecx() & CFM_OSXSAVE) && (cpuid.Ecx() & CFM_FMA4)) ? CF_FMA4 : 0;
 			}
 
 			if (max_ext_fn >= 0x80000004)
@@ -30,8 +30,15 @@
 
 #include <KFL/KFL.hpp>
 
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <cstdarg>
 #include <cstdio>
+#include <memory>
+#include <mutex>
+#include <thread>
 
 #ifdef KLAYGE_PLATFORM_ANDROID
 #include <android/log.h>
@@ -42,74 +49,344 @@
 
 #include <KFL/Log.hpp>
 
-#ifdef KLAYGE_DEBUG
-#ifndef KLAYGE_PLATFORM_ANDROID
 namespace
 {
-	std::ofstream log_file("KlayGE.log");
-}
-#endif
-#endif
+	using namespace KlayGE;
 
-namespace KlayGE
-{
-	void LogInfo(char const * fmt, ...)
+	uint32_t const QUEUE_SIZE = 512;
+	static_assert((QUEUE_SIZE & (QUEUE_SIZE - 1)) == 0, "QUEUE_SIZE must be a power of 2.");
+
+	char const * level_names[] = { "INFO", "WARN", "ERROR" };
+	char const * category_names[] = { "KlayGE", "KlayGE.Render", "KlayGE.Audio", "KlayGE.Input", "KlayGE.Resource",
+		"KlayGE.Script", "KlayGE.Network" };
+	static_assert(sizeof(category_names) / sizeof(category_names[0]) == LC_NumCategories,
+		"category_names doesn't match LogCategory.");
+
+	struct LogRecord
 	{
-		va_list args;
-		va_start(args, fmt);
+		std::atomic<uint32_t> sequence;
+		LogLevel level;
+		LogCategory category;
+		std::array<char, 1024> text;
+	};
 
-#ifdef KLAYGE_PLATFORM_ANDROID
-		__android_log_vprint(ANDROID_LOG_INFO, "KlayGE", fmt, args);
-#else
-		std::array<char, 1024> buffer;
-		vsprintf(&buffer[0], fmt, args);
+	// A bounded multi-producer queue of records (Dmitry Vyukov's algorithm), drained by a background thread. Producers
+	//  format straight into the slot they claim, and never wait on each other or on the writer.
+	class Logger
+	{
+	public:
+		static Logger& Instance()
+		{
+			// Never destroyed, since logging may still happen during static destruction
+			static Logger* logger = new Logger;
+			return *logger;
+		}
+
+		bool Enabled(LogLevel level, LogCategory category) const
+		{
+			return (level >= min_level_.load(std::memory_order_relaxed))
+				&& ((category_mask_.load(std::memory_order_relaxed) & (1U << category)) != 0);
+		}
+
+		void MinLevel(LogLevel level)
+		{
+			min_level_.store(level, std::memory_order_relaxed);
+		}
+
+		LogLevel MinLevel() const
+		{
+			return static_cast<LogLevel>(min_level_.load(std::memory_order_relaxed));
+		}
+
+		void CategoryEnabled(LogCategory category, bool enabled)
+		{
+			if (enabled)
+			{
+				category_mask_.fetch_or(1U << category, std::memory_order_relaxed);
+			}
+			else
+			{
+				category_mask_.fetch_and(~(1U << category), std::memory_order_relaxed);
+			}
+		}
+
+		void Push(LogLevel level, LogCategory category, char const * fmt, va_list args)
+		{
+			uint32_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+			for (;;)
+			{
+				LogRecord& record = records_[pos & (QUEUE_SIZE - 1)];
+				uint32_t const seq = record.sequence.load(std::memory_order_acquire);
+				int32_t const diff = static_cast<int32_t>(seq - pos);
+				if (0 == diff)
+				{
+					if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					{
+						record.level = level;
+						record.category = category;
+						vsnprintf(&record.text[0], record.text.size(), fmt, args);
+						record.sequence.store(pos + 1, std::memory_order_release);
+
+						// Wakes the writer early when the queue is filling up, instead of waiting for its next poll
+						if (pos + 1 - dequeue_pos_.load(std::memory_order_relaxed) >= QUEUE_SIZE / 2)
+						{
+							wake_cv_.notify_one();
+						}
+						break;
+					}
+				}
+				else if (diff < 0)
+				{
+					// Full
+					dropped_.fetch_add(1, std::memory_order_relaxed);
+					break;
+				}
+				else
+				{
+					pos = enqueue_pos_.load(std::memory_order_relaxed);
+				}
+			}
+		}
+
+		void Flush()
+		{
+			std::lock_guard<std::mutex> lock(output_mutex_);
+			this->Drain();
+		}
 
-		std::clog << "(INFO) KlayGE: " << &buffer[0] << std::endl;
+		// Writes the record on the calling thread, after everything already queued
+		void WriteNow(LogLevel level, LogCategory category, char const * fmt, va_list args)
+		{
+			std::array<char, 1024> text;
+			vsnprintf(&text[0], text.size(), fmt, args);
+
+			std::lock_guard<std::mutex> lock(output_mutex_);
+			this->Drain();
+			this->Write(level, category, &text[0]);
+			this->FlushOutput();
+		}
+
+	private:
+		Logger()
+			: records_(new LogRecord[QUEUE_SIZE]),
+				enqueue_pos_(0), dequeue_pos_(0), dropped_(0),
+				min_level_(LL_Info), category_mask_((1U << LC_NumCategories) - 1)
 #ifdef KLAYGE_DEBUG
-		log_file << "(INFO) KlayGE: " << &buffer[0] << std::endl;
+#ifndef KLAYGE_PLATFORM_ANDROID
+				, log_file_("KlayGE.log")
 #endif
 #endif
+		{
+			for (uint32_t i = 0; i < QUEUE_SIZE; ++ i)
+			{
+				records_[i].sequence.store(i, std::memory_order_relaxed);
+			}
 
-		va_end(args);
-	}
+			std::thread(&Logger::WriterFunc, this).detach();
+			std::atexit(&Logger::AtExit);
+		}
 
-	void LogWarn(char const * fmt, ...)
-	{
-		va_list args;
-		va_start(args, fmt);
+		static void AtExit()
+		{
+			// On some platforms the writer is already gone at this point, maybe with the lock held. Wait for it
+			//  only for a while.
+			Logger& logger = Logger::Instance();
+			std::unique_lock<std::mutex> lock(logger.output_mutex_, std::defer_lock);
+			for (int i = 0; (i < 100) && !lock.try_lock(); ++ i)
+			{
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+			if (lock.owns_lock())
+			{
+				logger.Drain();
+			}
+		}
+
+		void WriterFunc()
+		{
+			for (;;)
+			{
+				uint32_t num_written;
+				{
+					std::lock_guard<std::mutex> lock(output_mutex_);
+					num_written = this->Drain();
+				}
+				if (0 == num_written)
+				{
+					std::unique_lock<std::mutex> lock(wake_mutex_);
+					wake_cv_.wait_for(lock, std::chrono::milliseconds(10));
+				}
+			}
+		}
+
+		// Must be called with output_mutex_ held
+		uint32_t Drain()
+		{
+			uint32_t num_written = 0;
 
+			uint32_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+			for (;;)
+			{
+				LogRecord& record = records_[pos & (QUEUE_SIZE - 1)];
+				uint32_t const seq = record.sequence.load(std::memory_order_acquire);
+				int32_t const diff = static_cast<int32_t>(seq - (pos + 1));
+				if (0 == diff)
+				{
+					dequeue_pos_.store(pos + 1, std::memory_order_relaxed);
+					this->Write(record.level, record.category, &record.text[0]);
+					record.sequence.store(pos + QUEUE_SIZE, std::memory_order_release);
+					++ pos;
+					++ num_written;
+				}
+				else
+				{
+					// Empty, or the next record is still being formatted
+					break;
+				}
+			}
+
+			uint32_t const dropped = dropped_.exchange(0, std::memory_order_relaxed);
+			if (dropped > 0)
+			{
+				std::array<char, 64> buffer;
+				snprintf(&buffer[0], buffer.size(), "%u log records dropped", dropped);
+				this->Write(LL_Warn, LC_General, &buffer[0]);
+				++ num_written;
+			}
+
+			if (num_written > 0)
+			{
+				this->FlushOutput();
+			}
+
+			return num_written;
+		}
+
+		void FlushOutput()
+		{
+#ifndef KLAYGE_PLATFORM_ANDROID
+			std::clog.flush();
+#ifdef KLAYGE_DEBUG
+			log_file_.flush();
+#endif
+#endif
+		}
+
+		void Write(LogLevel level, LogCategory category, char const * text)
+		{
 #ifdef KLAYGE_PLATFORM_ANDROID
-		__android_log_vprint(ANDROID_LOG_WARN, "KlayGE", fmt, args);
+			static int const priorities[] = { ANDROID_LOG_INFO, ANDROID_LOG_WARN, ANDROID_LOG_ERROR };
+			__android_log_write(priorities[level], category_names[category], text);
 #else
-		std::array<char, 1024> buffer;
-		vsprintf(&buffer[0], fmt, args);
+			std::clog << '(' << level_names[level] << ") " << category_names[category] << ": " << text << '\n';
+#ifdef KLAYGE_DEBUG
+			log_file_ << '(' << level_names[level] << ") " << category_names[category] << ": " << text << '\n';
+#endif
+#endif
+		}
+
+	private:
+		std::unique_ptr<LogRecord[]> records_;
+		std::atomic<uint32_t> enqueue_pos_;
+		// Only advanced with output_mutex_ held, so there is a single consumer at a time
+		std::atomic<uint32_t> dequeue_pos_;
+		std::atomic<uint32_t> dropped_;
 
-		std::clog << "(WARN) KlayGE: " << &buffer[0] << std::endl;
+		std::atomic<int> min_level_;
+		std::atomic<uint32_t> category_mask_;
+
+		std::mutex output_mutex_;
+		std::mutex wake_mutex_;
+		std::condition_variable wake_cv_;
 #ifdef KLAYGE_DEBUG
-		log_file << "(WARN) KlayGE: " << &buffer[0] << std::endl;
+#ifndef KLAYGE_PLATFORM_ANDROID
+		std::ofstream log_file_;
 #endif
 #endif
+	};
 
-		va_end(args);
+	void LogV(LogLevel level, LogCategory category, char const * fmt, va_list args)
+	{
+		Logger& logger = Logger::Instance();
+		if (logger.Enabled(level, category))
+		{
+			if (level >= LL_Error)
+			{
+				logger.WriteNow(level, category, fmt, args);
+			}
+			else
+			{
+				logger.Push(level, category, fmt, args);
+			}
+		}
 	}
+}
 
-	void LogError(char const * fmt, ...)
+namespace KlayGE
+{
+	void Log(LogLevel level, LogCategory category, char const * fmt, ...)
 	{
 		va_list args;
 		va_start(args, fmt);
+		LogV(level, category, fmt, args);
+		va_end(args);
+	}
 
-#ifdef KLAYGE_PLATFORM_ANDROID
-		__android_log_vprint(ANDROID_LOG_ERROR, "KlayGE", fmt, args);
-#else
-		std::array<char, 1024> buffer;
-		vsprintf(&buffer[0], fmt, args);
+	void LogInfo(char const * fmt, ...)
+	{
+		if (LL_Info >= KLAYGE_LOG_MIN_LEVEL)
+		{
+			va_list args;
+			va_start(args, fmt);
+			LogV(LL_Info, LC_General, fmt, args);
+			va_end(args);
+		}
+	}
 
-		std::clog << "(ERROR) KlayGE: " << &buffer[0] << std::endl;
-#ifdef KLAYGE_DEBUG
-		log_file << "(ERROR) KlayGE: " << &buffer[0] << std::endl;
-#endif
-#endif
+	void LogWarn(char const * fmt, ...)
+	{
+		if (LL_Warn >= KLAYGE_LOG_MIN_LEVEL)
+		{
+			va_list args;
+			va_start(args, fmt);
+			LogV(LL_Warn, LC_General, fmt, args);
+			va_end(args);
+		}
+	}
 
-		va_end(args);
+	void LogError(char const * fmt, ...)
+	{
+		if (LL_Error >= KLAYGE_LOG_MIN_LEVEL)
+		{
+			va_list args;
+			va_start(args, fmt);
+			LogV(LL_Error, LC_General, fmt, args);
+			va_end(args);
+		}
+	}
+
+	void LogMinLevel(LogLevel level)
+	{
+		Logger::Instance().MinLevel(level);
+	}
+
+	LogLevel LogMinLevel()
+	{
+		return Logger::Instance().MinLevel();
+	}
+
+	void LogCategoryEnabled(LogCategory category, bool enabled)
+	{
+		Logger::Instance().CategoryEnabled(category, enabled);
+	}
+
+	bool LogEnabled(LogLevel level, LogCategory category)
+	{
+		return Logger::Instance().Enabled(level, category);
+	}
+
+	void LogFlush()
+	{
+		Logger::Instance().Flush();
 	}
 }
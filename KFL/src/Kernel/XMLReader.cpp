@@ -0,0 +1,863 @@
+/**
+ * @file XMLReader.cpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KFL, a subproject of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#include <KFL/KFL.hpp>
+#include <KFL/ResIdentifier.hpp>
+#include <KFL/ThrowErr.hpp>
+
+#include <algorithm>
+#include <clocale>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#if defined(KLAYGE_PLATFORM_DARWIN) || defined(KLAYGE_PLATFORM_IOS)
+#include <xlocale.h>
+#endif
+
+#include <KFL/XMLReader.hpp>
+
+namespace
+{
+	using namespace KlayGE;
+
+	bool IsSpace(char c)
+	{
+		return (' ' == c) || ('\t' == c) || ('\r' == c) || ('\n' == c);
+	}
+
+	bool IsDigit(char c)
+	{
+		return (c >= '0') && (c <= '9');
+	}
+
+	std::string_view Trim(std::string_view str)
+	{
+		size_t first = 0;
+		size_t last = str.size();
+		while ((first < last) && IsSpace(str[first]))
+		{
+			++ first;
+		}
+		while ((last > first) && IsSpace(str[last - 1]))
+		{
+			-- last;
+		}
+		return str.substr(first, last - first);
+	}
+
+	void AppendUTF8(std::string& str, uint32_t code)
+	{
+		if (code < 0x80)
+		{
+			str.push_back(static_cast<char>(code));
+		}
+		else if (code < 0x800)
+		{
+			str.push_back(static_cast<char>(0xC0 | (code >> 6)));
+			str.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+		}
+		else if (code < 0x10000)
+		{
+			str.push_back(static_cast<char>(0xE0 | (code >> 12)));
+			str.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+			str.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+		}
+		else
+		{
+			str.push_back(static_cast<char>(0xF0 | (code >> 18)));
+			str.push_back(static_cast<char>(0x80 | ((code >> 12) & 0x3F)));
+			str.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+			str.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+		}
+	}
+
+	std::string DecodeEntities(std::string_view str)
+	{
+		std::string ret;
+		ret.reserve(str.size());
+		for (size_t i = 0; i < str.size(); ++ i)
+		{
+			if (str[i] != '&')
+			{
+				ret.push_back(str[i]);
+				continue;
+			}
+
+			size_t const semicolon = str.find(';', i);
+			if (semicolon == std::string_view::npos)
+			{
+				ret.push_back(str[i]);
+				continue;
+			}
+
+			std::string_view const entity = str.substr(i + 1, semicolon - i - 1);
+			if (entity == "lt")
+			{
+				ret.push_back('<');
+			}
+			else if (entity == "gt")
+			{
+				ret.push_back('>');
+			}
+			else if (entity == "amp")
+			{
+				ret.push_back('&');
+			}
+			else if (entity == "quot")
+			{
+				ret.push_back('"');
+			}
+			else if (entity == "apos")
+			{
+				ret.push_back('\'');
+			}
+			else if ((entity.size() > 1) && ('#' == entity[0]))
+			{
+				uint32_t code = 0;
+				if (('x' == entity[1]) || ('X' == entity[1]))
+				{
+					for (size_t j = 2; j < entity.size(); ++ j)
+					{
+						char const c = entity[j];
+						uint32_t const digit = IsDigit(c) ? c - '0' : ((c | 0x20) - 'a' + 10);
+						code = code * 16 + digit;
+					}
+				}
+				else
+				{
+					for (size_t j = 1; j < entity.size(); ++ j)
+					{
+						code = code * 10 + (entity[j] - '0');
+					}
+				}
+				AppendUTF8(ret, code);
+			}
+			else
+			{
+				ret.append(str.data() + i, semicolon - i + 1);
+			}
+			i = semicolon;
+		}
+		return ret;
+	}
+
+	// strtof in the "C" locale, so that a decimal comma set by the application doesn't change the result
+	float StrToFloatC(char const * str, char** end)
+	{
+#if defined(KLAYGE_PLATFORM_WINDOWS)
+		static _locale_t const c_locale = _create_locale(LC_NUMERIC, "C");
+		return _strtof_l(str, end, c_locale);
+#elif defined(KLAYGE_PLATFORM_ANDROID)
+		// Bionic always converts in the "C" locale
+		return std::strtof(str, end);
+#else
+		static locale_t const c_locale = newlocale(LC_NUMERIC_MASK, "C", static_cast<locale_t>(0));
+		return strtof_l(str, end, c_locale);
+#endif
+	}
+
+	// Parses a float out of [first, last), returns the end of the number or nullptr.
+	char const * ParseFloatToken(char const * first, char const * last, float& val)
+	{
+		static double const POW10[] =
+		{
+			1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+			1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+		};
+
+		char const * p = first;
+		bool neg = false;
+		if ((p != last) && (('-' == *p) || ('+' == *p)))
+		{
+			neg = ('-' == *p);
+			++ p;
+		}
+
+		uint64_t mantissa = 0;
+		int32_t exp10 = 0;
+		bool any_digit = false;
+		bool truncated = false;
+		for (; (p != last) && IsDigit(*p); ++ p)
+		{
+			any_digit = true;
+			if (mantissa < 100000000000000000ULL)
+			{
+				mantissa = mantissa * 10 + (*p - '0');
+			}
+			else
+			{
+				++ exp10;
+				truncated |= (*p != '0');
+			}
+		}
+		if ((p != last) && ('.' == *p))
+		{
+			++ p;
+			for (; (p != last) && IsDigit(*p); ++ p)
+			{
+				any_digit = true;
+				if (mantissa < 100000000000000000ULL)
+				{
+					mantissa = mantissa * 10 + (*p - '0');
+					-- exp10;
+				}
+				else
+				{
+					truncated |= (*p != '0');
+				}
+			}
+		}
+
+		bool fast = any_digit && !truncated;
+		if (any_digit && (p != last) && (('e' == *p) || ('E' == *p)))
+		{
+			char const * q = p + 1;
+			bool exp_neg = false;
+			if ((q != last) && (('-' == *q) || ('+' == *q)))
+			{
+				exp_neg = ('-' == *q);
+				++ q;
+			}
+			if ((q != last) && IsDigit(*q))
+			{
+				int32_t e = 0;
+				for (; (q != last) && IsDigit(*q); ++ q)
+				{
+					if (e < 10000)
+					{
+						e = e * 10 + (*q - '0');
+					}
+				}
+				exp10 += exp_neg ? -e : e;
+				p = q;
+			}
+		}
+
+		if (fast && (mantissa <= (1ULL << 53)) && (exp10 >= -22) && (exp10 <= 22))
+		{
+			// Both operands are exact, so the double is correctly rounded. Narrowing it again is only wrong when
+			//  it lands exactly between two floats.
+			double const d = (exp10 < 0) ? mantissa / POW10[-exp10] : mantissa * POW10[exp10];
+			float const f = static_cast<float>(d);
+			bool tie = false;
+			if (static_cast<double>(f) != d)
+			{
+				float const g = std::nextafter(f, (d > f) ? std::numeric_limits<float>::infinity()
+					: -std::numeric_limits<float>::infinity());
+				tie = ((static_cast<double>(f) + static_cast<double>(g)) * 0.5 == d);
+			}
+			if (!tie)
+			{
+				val = neg ? -f : f;
+				return p;
+			}
+		}
+
+		// Rare inputs: long mantissas, big exponents, inf/nan and exact ties.
+		char buf[128];
+		size_t const len = std::min(static_cast<size_t>(last - first), sizeof(buf) - 1);
+		std::memcpy(buf, first, len);
+		buf[len] = 0;
+		char* end;
+		float const f = StrToFloatC(buf, &end);
+		if (end == buf)
+		{
+			return nullptr;
+		}
+		val = f;
+		return first + (end - buf);
+	}
+
+	char const * ParseUIntToken(char const * first, char const * last, uint32_t& val)
+	{
+		char const * p = first;
+		if ((p != last) && ('+' == *p))
+		{
+			++ p;
+		}
+		if ((p == last) || !IsDigit(*p))
+		{
+			return nullptr;
+		}
+
+		uint64_t v = 0;
+		for (; (p != last) && IsDigit(*p); ++ p)
+		{
+			v = v * 10 + (*p - '0');
+			if (v > 0xFFFFFFFFULL)
+			{
+				return nullptr;
+			}
+		}
+		val = static_cast<uint32_t>(v);
+		return p;
+	}
+
+	char const * ParseIntToken(char const * first, char const * last, int32_t& val)
+	{
+		char const * p = first;
+		bool neg = false;
+		if ((p != last) && ('-' == *p))
+		{
+			neg = true;
+			++ p;
+		}
+
+		uint32_t v;
+		p = ParseUIntToken(p, last, v);
+		if (!p || (v > (neg ? 0x80000000U : 0x7FFFFFFFU)))
+		{
+			return nullptr;
+		}
+		val = neg ? static_cast<int32_t>(0U - v) : static_cast<int32_t>(v);
+		return p;
+	}
+
+	template <typename T, typename Parser>
+	bool ParseWhole(std::string_view str, T& val, Parser parser)
+	{
+		str = Trim(str);
+		char const * last = str.data() + str.size();
+		T v;
+		char const * p = parser(str.data(), last, v);
+		if (p == last)
+		{
+			val = v;
+			return true;
+		}
+		return false;
+	}
+
+	template <typename T, typename Parser>
+	uint32_t ParseList(std::string_view str, T* vals, uint32_t max_count, Parser parser)
+	{
+		char const * p = str.data();
+		char const * last = p + str.size();
+		uint32_t count = 0;
+		while (count < max_count)
+		{
+			while ((p != last) && IsSpace(*p))
+			{
+				++ p;
+			}
+			if (p == last)
+			{
+				break;
+			}
+			p = parser(p, last, vals[count]);
+			if (!p || ((p != last) && !IsSpace(*p)))
+			{
+				break;
+			}
+			++ count;
+		}
+		return count;
+	}
+}
+
+namespace KlayGE
+{
+	XMLReader::XMLReader(ResIdentifierPtr const & source, size_t window_size)
+		: source_(source),
+			window_(std::max(window_size, static_cast<size_t>(256))), pos_(0), end_(0), eof_(false),
+			capturing_(false), capture_pos_(0),
+			event_(XRE_EndOfDocument), depth_(0), empty_element_(false), pending_end_(false), tag_pos_(0),
+			cdata_(false)
+	{
+		attrs_.reserve(16);
+	}
+
+	XMLReaderEvent XMLReader::Next()
+	{
+		if (XRE_EndElement == event_)
+		{
+			-- depth_;
+		}
+
+		attrs_.clear();
+		value_ = std::string_view();
+		cdata_ = false;
+
+		if (pending_end_)
+		{
+			pending_end_ = false;
+			empty_element_ = false;
+			event_ = XRE_EndElement;
+			return event_;
+		}
+		empty_element_ = false;
+
+		for (;;)
+		{
+			size_t len = 0;
+			char c;
+			while (((c = this->PeekChar(len)) != '<') && (c != 0))
+			{
+				++ len;
+			}
+			if (len > 0)
+			{
+				std::string_view const text(&window_[pos_], len);
+				pos_ += len;
+				if (!Trim(text).empty())
+				{
+					value_ = text;
+					event_ = XRE_Text;
+					return event_;
+				}
+			}
+
+			if (0 == c)
+			{
+				if (depth_ != 0)
+				{
+					THR(std::errc::invalid_argument);
+				}
+				event_ = XRE_EndOfDocument;
+				return event_;
+			}
+
+			char const c1 = this->PeekChar(1);
+			if ('?' == c1)
+			{
+				pos_ += this->FindSequence(2, "?>", 2) + 2;
+			}
+			else if ('!' == c1)
+			{
+				if (('-' == this->PeekChar(2)) && ('-' == this->PeekChar(3)))
+				{
+					pos_ += this->FindSequence(4, "-->", 3) + 3;
+				}
+				else if (('[' == this->PeekChar(2)) && ('C' == this->PeekChar(3)))
+				{
+					size_t const close = this->FindSequence(9, "]]>", 3);
+					value_ = std::string_view(&window_[pos_ + 9], close - 9);
+					cdata_ = true;
+					pos_ += close + 3;
+					event_ = XRE_Text;
+					return event_;
+				}
+				else
+				{
+					// DOCTYPE, possibly with an internal subset in brackets
+					uint32_t brackets = 0;
+					for (len = 2;; ++ len)
+					{
+						c = this->PeekChar(len);
+						if (0 == c)
+						{
+							THR(std::errc::invalid_argument);
+						}
+						else if ('[' == c)
+						{
+							++ brackets;
+						}
+						else if (']' == c)
+						{
+							-- brackets;
+						}
+						else if (('>' == c) && (0 == brackets))
+						{
+							break;
+						}
+					}
+					pos_ += len + 1;
+				}
+			}
+			else if ('/' == c1)
+			{
+				if (0 == depth_)
+				{
+					THR(std::errc::invalid_argument);
+				}
+
+				len = this->FindSequence(2, ">", 1);
+				name_ = Trim(std::string_view(&window_[pos_ + 2], len - 2));
+				if (name_ != open_names_[depth_ - 1])
+				{
+					THR(std::errc::invalid_argument);
+				}
+				pos_ += len + 1;
+				event_ = XRE_EndElement;
+				return event_;
+			}
+			else
+			{
+				char quote = 0;
+				for (len = 1;; ++ len)
+				{
+					c = this->PeekChar(len);
+					if (0 == c)
+					{
+						THR(std::errc::invalid_argument);
+					}
+					else if (quote)
+					{
+						if (c == quote)
+						{
+							quote = 0;
+						}
+					}
+					else if (('"' == c) || ('\'' == c))
+					{
+						quote = c;
+					}
+					else if ('>' == c)
+					{
+						break;
+					}
+				}
+				++ len;
+
+				this->ParseTag(len);
+				tag_pos_ = pos_;
+				pos_ += len;
+
+				// The strings are reused between elements at the same depth, so this doesn't allocate once warm
+				if (open_names_.size() <= depth_)
+				{
+					open_names_.resize(depth_ + 1);
+				}
+				open_names_[depth_].assign(name_.data(), name_.size());
+				++ depth_;
+				pending_end_ = empty_element_;
+				event_ = XRE_StartElement;
+				return event_;
+			}
+		}
+	}
+
+	bool XMLReader::NextChildElement(uint32_t parent_depth)
+	{
+		for (;;)
+		{
+			switch (this->Next())
+			{
+			case XRE_StartElement:
+				if (depth_ == parent_depth + 1)
+				{
+					return true;
+				}
+				this->SkipElement();
+				break;
+
+			case XRE_EndElement:
+				if (depth_ == parent_depth)
+				{
+					return false;
+				}
+				break;
+
+			case XRE_Text:
+				break;
+
+			case XRE_EndOfDocument:
+			default:
+				THR(std::errc::invalid_argument);
+			}
+		}
+	}
+
+	void XMLReader::SkipElement()
+	{
+		if (event_ != XRE_StartElement)
+		{
+			return;
+		}
+
+		uint32_t const depth = depth_;
+		while ((this->Next() != XRE_EndElement) || (depth_ != depth))
+		{
+		}
+	}
+
+	std::string XMLReader::ReadElementXML()
+	{
+		std::string ret;
+		if (event_ == XRE_StartElement)
+		{
+			capture_.clear();
+			capture_pos_ = tag_pos_;
+			capturing_ = true;
+			this->SkipElement();
+			capturing_ = false;
+			capture_.append(&window_[capture_pos_], pos_ - capture_pos_);
+			ret.swap(capture_);
+		}
+		return ret;
+	}
+
+	std::string XMLReader::ValueString() const
+	{
+		return cdata_ ? std::string(value_.data(), value_.size()) : DecodeEntities(value_);
+	}
+
+	bool XMLReader::HasAttrib(std::string_view name) const
+	{
+		return this->FindAttrib(name) != nullptr;
+	}
+
+	bool XMLReader::TryConvertAttrib(std::string_view name, int32_t& val, int32_t default_val) const
+	{
+		val = default_val;
+		std::string_view const * value = this->FindAttrib(name);
+		return value && ParseInt(*value, val);
+	}
+
+	bool XMLReader::TryConvertAttrib(std::string_view name, uint32_t& val, uint32_t default_val) const
+	{
+		val = default_val;
+		std::string_view const * value = this->FindAttrib(name);
+		return value && ParseUInt(*value, val);
+	}
+
+	bool XMLReader::TryConvertAttrib(std::string_view name, float& val, float default_val) const
+	{
+		val = default_val;
+		std::string_view const * value = this->FindAttrib(name);
+		return value && ParseFloat(*value, val);
+	}
+
+	int32_t XMLReader::AttribInt(std::string_view name, int32_t default_val) const
+	{
+		int32_t ret;
+		this->TryConvertAttrib(name, ret, default_val);
+		return ret;
+	}
+
+	uint32_t XMLReader::AttribUInt(std::string_view name, uint32_t default_val) const
+	{
+		uint32_t ret;
+		this->TryConvertAttrib(name, ret, default_val);
+		return ret;
+	}
+
+	float XMLReader::AttribFloat(std::string_view name, float default_val) const
+	{
+		float ret;
+		this->TryConvertAttrib(name, ret, default_val);
+		return ret;
+	}
+
+	std::string XMLReader::AttribString(std::string_view name, std::string const & default_val) const
+	{
+		std::string_view const * value = this->FindAttrib(name);
+		return value ? DecodeEntities(*value) : default_val;
+	}
+
+	uint32_t XMLReader::AttribFloats(std::string_view name, float* vals, uint32_t max_count) const
+	{
+		std::string_view const * value = this->FindAttrib(name);
+		return value ? ParseList(*value, vals, max_count, ParseFloatToken) : 0;
+	}
+
+	uint32_t XMLReader::AttribUInts(std::string_view name, uint32_t* vals, uint32_t max_count) const
+	{
+		std::string_view const * value = this->FindAttrib(name);
+		return value ? ParseList(*value, vals, max_count, ParseUIntToken) : 0;
+	}
+
+	bool XMLReader::ParseInt(std::string_view str, int32_t& val)
+	{
+		return ParseWhole(str, val, ParseIntToken);
+	}
+
+	bool XMLReader::ParseUInt(std::string_view str, uint32_t& val)
+	{
+		return ParseWhole(str, val, ParseUIntToken);
+	}
+
+	bool XMLReader::ParseFloat(std::string_view str, float& val)
+	{
+		return ParseWhole(str, val, ParseFloatToken);
+	}
+
+	// Moves the unconsumed tail to the front of the window, growing it when a single token fills it, and reads
+	//  more of the source behind it.
+	bool XMLReader::Refill()
+	{
+		if (eof_)
+		{
+			return false;
+		}
+
+		if (capturing_)
+		{
+			capture_.append(&window_[capture_pos_], pos_ - capture_pos_);
+			capture_pos_ = 0;
+		}
+		if (pos_ > 0)
+		{
+			std::memmove(&window_[0], &window_[pos_], end_ - pos_);
+			end_ -= pos_;
+			pos_ = 0;
+		}
+		if (end_ == window_.size())
+		{
+			window_.resize(window_.size() * 2);
+		}
+
+		source_->read(&window_[end_], window_.size() - end_);
+		size_t const len = static_cast<size_t>(source_->gcount());
+		end_ += len;
+		if (0 == len)
+		{
+			eof_ = true;
+			return false;
+		}
+		return true;
+	}
+
+	// Returns 0 at the end of the source. The window may move, so offsets are relative to pos_.
+	char XMLReader::PeekChar(size_t offset)
+	{
+		while (pos_ + offset >= end_)
+		{
+			if (!this->Refill())
+			{
+				return 0;
+			}
+		}
+		return window_[pos_ + offset];
+	}
+
+	size_t XMLReader::FindSequence(size_t offset, char const * seq, size_t len)
+	{
+		for (;; ++ offset)
+		{
+			size_t i = 0;
+			for (; i < len; ++ i)
+			{
+				char const c = this->PeekChar(offset + i);
+				if (0 == c)
+				{
+					THR(std::errc::invalid_argument);
+				}
+				if (c != seq[i])
+				{
+					break;
+				}
+			}
+			if (i == len)
+			{
+				return offset;
+			}
+		}
+	}
+
+	// The whole tag, from '<' to '>', is in the window when this is called.
+	void XMLReader::ParseTag(size_t len)
+	{
+		char const * p = &window_[pos_ + 1];
+		char const * last = &window_[pos_ + len - 1];
+		if ('/' == last[-1])
+		{
+			empty_element_ = true;
+			-- last;
+		}
+
+		char const * name = p;
+		while ((p != last) && !IsSpace(*p))
+		{
+			++ p;
+		}
+		name_ = std::string_view(name, p - name);
+		if (name_.empty())
+		{
+			THR(std::errc::invalid_argument);
+		}
+
+		for (;;)
+		{
+			while ((p != last) && IsSpace(*p))
+			{
+				++ p;
+			}
+			if (p == last)
+			{
+				break;
+			}
+
+			char const * attr_name = p;
+			while ((p != last) && (*p != '=') && !IsSpace(*p))
+			{
+				++ p;
+			}
+			char const * attr_name_end = p;
+			while ((p != last) && IsSpace(*p))
+			{
+				++ p;
+			}
+			if ((p == last) || (*p != '='))
+			{
+				THR(std::errc::invalid_argument);
+			}
+			++ p;
+			while ((p != last) && IsSpace(*p))
+			{
+				++ p;
+			}
+			if ((p == last) || ((*p != '"') && (*p != '\'')))
+			{
+				THR(std::errc::invalid_argument);
+			}
+			char const quote = *p;
+			++ p;
+			char const * value = p;
+			while ((p != last) && (*p != quote))
+			{
+				++ p;
+			}
+			if (p == last)
+			{
+				THR(std::errc::invalid_argument);
+			}
+
+			Attrib attr;
+			attr.name = std::string_view(attr_name, attr_name_end - attr_name);
+			attr.value = std::string_view(value, p - value);
+			attrs_.push_back(attr);
+			++ p;
+		}
+	}
+
+	std::string_view const * XMLReader::FindAttrib(std::string_view name) const
+	{
+		for (auto const & attr : attrs_)
+		{
+			if (attr.name == name)
+			{
+				return &attr.value;
+			}
+		}
+		return nullptr;
+	}
+}
@@ -30,8 +30,278 @@
 
 #include <KFL/KFL.hpp>
 
+#include <KFL/SIMDMath.hpp>
+
+#include <algorithm>
+
 #include <KFL/Noise.hpp>
 
+#if defined(SIMD_MATH_SSE) && defined(KLAYGE_SSE2_SUPPORT)
+	#define NOISE_BATCH_SSE
+	#include <emmintrin.h>
+#endif
+
+namespace
+{
+	using namespace KlayGE;
+
+	// Only float has a SIMD version. The others fall back to the scalar functions.
+	template <typename T>
+	bool NoiseBatch(int const * p, Vector_T<T, 3> const * g, T const * x, T const * y, T* ret, size_t n) KLAYGE_NOEXCEPT
+	{
+		KFL_UNUSED(p);
+		KFL_UNUSED(g);
+		KFL_UNUSED(x);
+		KFL_UNUSED(y);
+		KFL_UNUSED(ret);
+		KFL_UNUSED(n);
+		return false;
+	}
+
+	template <typename T>
+	bool NoiseBatch(int const * p, Vector_T<T, 3> const * g, T const * x, T const * y, T const * z, T* ret, size_t n) KLAYGE_NOEXCEPT
+	{
+		KFL_UNUSED(p);
+		KFL_UNUSED(g);
+		KFL_UNUSED(x);
+		KFL_UNUSED(y);
+		KFL_UNUSED(z);
+		KFL_UNUSED(ret);
+		KFL_UNUSED(n);
+		return false;
+	}
+
+#if defined(NOISE_BATCH_SSE)
+	// Same as static_cast<int>(MathLib::floor(v)) used by the scalar version, which truncates v - 1 for v <= 0. That
+	//  gives v - 1 on negative integers, so a true floor would pick different cells on those boundaries.
+	__m128i FloorToInt(__m128 v) KLAYGE_NOEXCEPT
+	{
+		__m128 const positive = _mm_cmpgt_ps(v, _mm_setzero_ps());
+		__m128 const v_minus_1 = _mm_sub_ps(v, _mm_set1_ps(1.0f));
+		return _mm_cvttps_epi32(_mm_or_ps(_mm_and_ps(positive, v), _mm_andnot_ps(positive, v_minus_1)));
+	}
+
+	void LoadLanes(__m128& v, float const * src, size_t num) KLAYGE_NOEXCEPT
+	{
+		if (4 == num)
+		{
+			v = _mm_loadu_ps(src);
+		}
+		else
+		{
+			float lanes[4] = { 0, 0, 0, 0 };
+			for (size_t l = 0; l < num; ++ l)
+			{
+				lanes[l] = src[l];
+			}
+			v = _mm_loadu_ps(lanes);
+		}
+	}
+
+	void StoreLanes(float* dst, __m128 v, size_t num) KLAYGE_NOEXCEPT
+	{
+		if (4 == num)
+		{
+			_mm_storeu_ps(dst, v);
+		}
+		else
+		{
+			float lanes[4];
+			_mm_storeu_ps(lanes, v);
+			for (size_t l = 0; l < num; ++ l)
+			{
+				dst[l] = lanes[l];
+			}
+		}
+	}
+
+	// Contribution of one corner. Same operations in the same order as the scalar version, skipped corners add 0. The dot
+	//  product is gx * x + (gy * y + gz * z), the order MathLib::dot adds in.
+	__m128 Corner(__m128 radius, __m128 x, __m128 y, __m128 z, __m128 gx, __m128 gy, __m128 gz) KLAYGE_NOEXCEPT
+	{
+		__m128 t = _mm_sub_ps(_mm_sub_ps(_mm_sub_ps(radius, _mm_mul_ps(x, x)), _mm_mul_ps(y, y)), _mm_mul_ps(z, z));
+		__m128 const mask = _mm_cmpgt_ps(t, _mm_setzero_ps());
+		t = _mm_mul_ps(t, t);
+		__m128 const d = _mm_add_ps(_mm_mul_ps(gx, x), _mm_add_ps(_mm_mul_ps(gy, y), _mm_mul_ps(gz, z)));
+		return _mm_and_ps(mask, _mm_mul_ps(_mm_mul_ps(t, t), d));
+	}
+
+	bool NoiseBatch(int const * p, float3 const * g, float const * x, float const * y, float* ret, size_t n) KLAYGE_NOEXCEPT
+	{
+		float const F2 = static_cast<float>(0.366025403784);
+		float const G2 = static_cast<float>(0.211324865405);
+
+		__m128 const f2 = _mm_set1_ps(F2);
+		__m128 const g2 = _mm_set1_ps(G2);
+		__m128 const g2_2 = _mm_set1_ps(2 * G2);
+		__m128 const one = _mm_set1_ps(1.0f);
+		__m128 const radius = _mm_set1_ps(0.5f);
+		__m128 const zero = _mm_setzero_ps();
+		__m128i const mask_255 = _mm_set1_epi32(255);
+
+		for (size_t base = 0; base < n; base += 4)
+		{
+			size_t const num = std::min<size_t>(4, n - base);
+
+			__m128 vx, vy;
+			LoadLanes(vx, x + base, num);
+			LoadLanes(vy, y + base, num);
+
+			__m128 const s = _mm_mul_ps(_mm_add_ps(vx, vy), f2);
+			__m128i const i = FloorToInt(_mm_add_ps(vx, s));
+			__m128i const j = FloorToInt(_mm_add_ps(vy, s));
+			__m128 const t = _mm_mul_ps(_mm_cvtepi32_ps(_mm_add_epi32(i, j)), g2);
+			__m128 const x0 = _mm_sub_ps(vx, _mm_sub_ps(_mm_cvtepi32_ps(i), t));
+			__m128 const y0 = _mm_sub_ps(vy, _mm_sub_ps(_mm_cvtepi32_ps(j), t));
+
+			__m128 const x_gt_y = _mm_cmpgt_ps(x0, y0);
+			__m128 const x1 = _mm_add_ps(_mm_sub_ps(x0, _mm_and_ps(x_gt_y, one)), g2);
+			__m128 const y1 = _mm_add_ps(_mm_sub_ps(y0, _mm_andnot_ps(x_gt_y, one)), g2);
+			__m128 const x2 = _mm_add_ps(_mm_sub_ps(x0, one), g2_2);
+			__m128 const y2 = _mm_add_ps(_mm_sub_ps(y0, one), g2_2);
+
+			// Permutation lookups can't be vectorized with SSE
+			int ii[4];
+			int jj[4];
+			int i1[4];
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(ii), _mm_and_si128(i, mask_255));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(jj), _mm_and_si128(j, mask_255));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(i1), _mm_castps_si128(x_gt_y));
+			float gx[3][4];
+			float gy[3][4];
+			float gz[3][4];
+			for (int l = 0; l < 4; ++ l)
+			{
+				int const i1l = i1[l] & 1;
+				int const j1l = 1 - i1l;
+				int const gi[] =
+				{
+					p[ii[l] + p[jj[l]]] % 12,
+					p[ii[l] + i1l + p[jj[l] + j1l]] % 12,
+					p[ii[l] + 1 + p[jj[l] + 1]] % 12
+				};
+				for (int c = 0; c < 3; ++ c)
+				{
+					gx[c][l] = g[gi[c]].x();
+					gy[c][l] = g[gi[c]].y();
+					gz[c][l] = g[gi[c]].z();
+				}
+			}
+
+			__m128 sum = Corner(radius, x0, y0, zero, _mm_loadu_ps(gx[0]), _mm_loadu_ps(gy[0]), _mm_loadu_ps(gz[0]));
+			sum = _mm_add_ps(sum, Corner(radius, x1, y1, zero, _mm_loadu_ps(gx[1]), _mm_loadu_ps(gy[1]), _mm_loadu_ps(gz[1])));
+			sum = _mm_add_ps(sum, Corner(radius, x2, y2, zero, _mm_loadu_ps(gx[2]), _mm_loadu_ps(gy[2]), _mm_loadu_ps(gz[2])));
+
+			StoreLanes(ret + base, _mm_mul_ps(_mm_set1_ps(70.0f), sum), num);
+		}
+
+		return true;
+	}
+
+	bool NoiseBatch(int const * p, float3 const * g, float const * x, float const * y, float const * z, float* ret, size_t n) KLAYGE_NOEXCEPT
+	{
+		float const F3 = 1 / 3.0f;
+		float const G3 = 1 / 6.0f;
+
+		__m128 const f3 = _mm_set1_ps(F3);
+		__m128 const g3 = _mm_set1_ps(G3);
+		__m128 const g3_2 = _mm_set1_ps(2 * G3);
+		__m128 const g3_3 = _mm_set1_ps(3 * G3);
+		__m128 const one = _mm_set1_ps(1.0f);
+		__m128 const radius = _mm_set1_ps(static_cast<float>(0.6));
+		__m128i const mask_255 = _mm_set1_epi32(255);
+
+		for (size_t base = 0; base < n; base += 4)
+		{
+			size_t const num = std::min<size_t>(4, n - base);
+
+			__m128 vx, vy, vz;
+			LoadLanes(vx, x + base, num);
+			LoadLanes(vy, y + base, num);
+			LoadLanes(vz, z + base, num);
+
+			__m128 const s = _mm_mul_ps(_mm_add_ps(_mm_add_ps(vx, vy), vz), f3);
+			__m128i const i = FloorToInt(_mm_add_ps(vx, s));
+			__m128i const j = FloorToInt(_mm_add_ps(vy, s));
+			__m128i const k = FloorToInt(_mm_add_ps(vz, s));
+			__m128 const t = _mm_mul_ps(_mm_cvtepi32_ps(_mm_add_epi32(_mm_add_epi32(i, j), k)), g3);
+			__m128 const x0 = _mm_sub_ps(vx, _mm_sub_ps(_mm_cvtepi32_ps(i), t));
+			__m128 const y0 = _mm_sub_ps(vy, _mm_sub_ps(_mm_cvtepi32_ps(j), t));
+			__m128 const z0 = _mm_sub_ps(vz, _mm_sub_ps(_mm_cvtepi32_ps(k), t));
+
+			// The branches of the scalar version, as masks
+			__m128 const x_ge_y = _mm_cmpge_ps(x0, y0);
+			__m128 const y_ge_z = _mm_cmpge_ps(y0, z0);
+			__m128 const x_ge_z = _mm_cmpge_ps(x0, z0);
+			__m128 const i1 = _mm_and_ps(x_ge_y, x_ge_z);
+			__m128 const j1 = _mm_andnot_ps(x_ge_y, y_ge_z);
+			__m128 const k1 = _mm_andnot_ps(_mm_or_ps(y_ge_z, x_ge_z), _mm_castsi128_ps(_mm_set1_epi32(-1)));
+			__m128 const i2 = _mm_or_ps(x_ge_y, x_ge_z);
+			__m128 const j2 = _mm_or_ps(_mm_andnot_ps(x_ge_y, _mm_castsi128_ps(_mm_set1_epi32(-1))), y_ge_z);
+			__m128 const k2 = _mm_andnot_ps(_mm_and_ps(y_ge_z, x_ge_z), _mm_castsi128_ps(_mm_set1_epi32(-1)));
+
+			__m128 const x1 = _mm_add_ps(_mm_sub_ps(x0, _mm_and_ps(i1, one)), g3);
+			__m128 const y1 = _mm_add_ps(_mm_sub_ps(y0, _mm_and_ps(j1, one)), g3);
+			__m128 const z1 = _mm_add_ps(_mm_sub_ps(z0, _mm_and_ps(k1, one)), g3);
+			__m128 const x2 = _mm_add_ps(_mm_sub_ps(x0, _mm_and_ps(i2, one)), g3_2);
+			__m128 const y2 = _mm_add_ps(_mm_sub_ps(y0, _mm_and_ps(j2, one)), g3_2);
+			__m128 const z2 = _mm_add_ps(_mm_sub_ps(z0, _mm_and_ps(k2, one)), g3_2);
+			__m128 const x3 = _mm_add_ps(_mm_sub_ps(x0, one), g3_3);
+			__m128 const y3 = _mm_add_ps(_mm_sub_ps(y0, one), g3_3);
+			__m128 const z3 = _mm_add_ps(_mm_sub_ps(z0, one), g3_3);
+
+			int ii[4];
+			int jj[4];
+			int kk[4];
+			int offsets[6][4];
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(ii), _mm_and_si128(i, mask_255));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(jj), _mm_and_si128(j, mask_255));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(kk), _mm_and_si128(k, mask_255));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(offsets[0]), _mm_castps_si128(i1));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(offsets[1]), _mm_castps_si128(j1));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(offsets[2]), _mm_castps_si128(k1));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(offsets[3]), _mm_castps_si128(i2));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(offsets[4]), _mm_castps_si128(j2));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(offsets[5]), _mm_castps_si128(k2));
+			float gx[4][4];
+			float gy[4][4];
+			float gz[4][4];
+			for (int l = 0; l < 4; ++ l)
+			{
+				int const i1l = offsets[0][l] & 1;
+				int const j1l = offsets[1][l] & 1;
+				int const k1l = offsets[2][l] & 1;
+				int const i2l = offsets[3][l] & 1;
+				int const j2l = offsets[4][l] & 1;
+				int const k2l = offsets[5][l] & 1;
+				int const gi[] =
+				{
+					p[ii[l] + p[jj[l] + p[kk[l]]]] % 12,
+					p[ii[l] + i1l + p[jj[l] + j1l + p[kk[l] + k1l]]] % 12,
+					p[ii[l] + i2l + p[jj[l] + j2l + p[kk[l] + k2l]]] % 12,
+					p[ii[l] + 1 + p[jj[l] + 1 + p[kk[l] + 1]]] % 12
+				};
+				for (int c = 0; c < 4; ++ c)
+				{
+					gx[c][l] = g[gi[c]].x();
+					gy[c][l] = g[gi[c]].y();
+					gz[c][l] = g[gi[c]].z();
+				}
+			}
+
+			__m128 sum = Corner(radius, x0, y0, z0, _mm_loadu_ps(gx[0]), _mm_loadu_ps(gy[0]), _mm_loadu_ps(gz[0]));
+			sum = _mm_add_ps(sum, Corner(radius, x1, y1, z1, _mm_loadu_ps(gx[1]), _mm_loadu_ps(gy[1]), _mm_loadu_ps(gz[1])));
+			sum = _mm_add_ps(sum, Corner(radius, x2, y2, z2, _mm_loadu_ps(gx[2]), _mm_loadu_ps(gy[2]), _mm_loadu_ps(gz[2])));
+			sum = _mm_add_ps(sum, Corner(radius, x3, y3, z3, _mm_loadu_ps(gx[3]), _mm_loadu_ps(gy[3]), _mm_loadu_ps(gz[3])));
+
+			StoreLanes(ret + base, _mm_mul_ps(_mm_set1_ps(32.0f), sum), num);
+		}
+
+		return true;
+	}
+#endif
+}
+
 namespace KlayGE
 {
 	namespace MathLib
@@ -56,6 +326,28 @@ namespace KlayGE
 				float w, float h, int octaves, float lacunarity, float gain) KLAYGE_NOEXCEPT;
 		template float SimplexNoise<float>::tileable_turbulence(float x, float y, float z,
 				float w, float h, float d, int octaves, float lacunarity, float gain) KLAYGE_NOEXCEPT;
+		template void SimplexNoise<float>::noise(float const * x, float const * y, float* ret, size_t n) KLAYGE_NOEXCEPT;
+		template void SimplexNoise<float>::noise(float const * x, float const * y, float const * z, float* ret, size_t n) KLAYGE_NOEXCEPT;
+		template void SimplexNoise<float>::fBm(float const * x, float const * y, float* ret, size_t n,
+				int octaves, float lacunarity, float gain) KLAYGE_NOEXCEPT;
+		template void SimplexNoise<float>::fBm(float const * x, float const * y, float const * z, float* ret, size_t n,
+				int octaves, float lacunarity, float gain) KLAYGE_NOEXCEPT;
+		template void SimplexNoise<float>::turbulence(float const * x, float const * y, float* ret, size_t n,
+				int octaves, float lacunarity, float gain) KLAYGE_NOEXCEPT;
+		template void SimplexNoise<float>::turbulence(float const * x, float const * y, float const * z, float* ret, size_t n,
+				int octaves, float lacunarity, float gain) KLAYGE_NOEXCEPT;
+		template void SimplexNoise<float>::tileable_noise(float const * x, float const * y, float* ret, size_t n,
+				float w, float h) KLAYGE_NOEXCEPT;
+		template void SimplexNoise<float>::tileable_noise(float const * x, float const * y, float const * z, float* ret, size_t n,
+				float w, float h, float d) KLAYGE_NOEXCEPT;
+		template void SimplexNoise<float>::tileable_fBm(float const * x, float const * y, float* ret, size_t n,
+				float w, float h, int octaves, float lacunarity, float gain) KLAYGE_NOEXCEPT;
+		template void SimplexNoise<float>::tileable_fBm(float const * x, float const * y, float const * z, float* ret, size_t n,
+				float w, float h, float d, int octaves, float lacunarity, float gain) KLAYGE_NOEXCEPT;
+		template void SimplexNoise<float>::tileable_turbulence(float const * x, float const * y, float* ret, size_t n,
+				float w, float h, int octaves, float lacunarity, float gain) KLAYGE_NOEXCEPT;
+		template void SimplexNoise<float>::tileable_turbulence(float const * x, float const * y, float const * z, float* ret, size_t n,
+				float w, float h, float d, int octaves, float lacunarity, float gain) KLAYGE_NOEXCEPT;
 
 
 		template <typename T>
@@ -468,5 +760,270 @@ namespace KlayGE
 			}
 			return sum / amp_sum;
 		}
+
+		template <typename T>
+		void SimplexNoise<T>::noise(T const * x, T const * y, T* ret, size_t n) KLAYGE_NOEXCEPT
+		{
+			if (!NoiseBatch(p_, g_, x, y, ret, n))
+			{
+				for (size_t i = 0; i < n; ++ i)
+				{
+					ret[i] = this->noise(x[i], y[i]);
+				}
+			}
+		}
+
+		template <typename T>
+		void SimplexNoise<T>::noise(T const * x, T const * y, T const * z, T* ret, size_t n) KLAYGE_NOEXCEPT
+		{
+			if (!NoiseBatch(p_, g_, x, y, z, ret, n))
+			{
+				for (size_t i = 0; i < n; ++ i)
+				{
+					ret[i] = this->noise(x[i], y[i], z[i]);
+				}
+			}
+		}
+
+		template <typename T>
+		void SimplexNoise<T>::fBm(T const * x, T const * y, T* ret, size_t n,
+			int octaves, T lacunarity, T gain) KLAYGE_NOEXCEPT
+		{
+			this->octaves2<false, false>(x, y, ret, n, T(0), T(0), octaves, lacunarity, gain);
+		}
+
+		template <typename T>
+		void SimplexNoise<T>::fBm(T const * x, T const * y, T const * z, T* ret, size_t n,
+			int octaves, T lacunarity, T gain) KLAYGE_NOEXCEPT
+		{
+			this->octaves3<false, false>(x, y, z, ret, n, T(0), T(0), T(0), octaves, lacunarity, gain);
+		}
+
+		template <typename T>
+		void SimplexNoise<T>::turbulence(T const * x, T const * y, T* ret, size_t n,
+			int octaves, T lacunarity, T gain) KLAYGE_NOEXCEPT
+		{
+			this->octaves2<true, false>(x, y, ret, n, T(0), T(0), octaves, lacunarity, gain);
+		}
+
+		template <typename T>
+		void SimplexNoise<T>::turbulence(T const * x, T const * y, T const * z, T* ret, size_t n,
+			int octaves, T lacunarity, T gain) KLAYGE_NOEXCEPT
+		{
+			this->octaves3<true, false>(x, y, z, ret, n, T(0), T(0), T(0), octaves, lacunarity, gain);
+		}
+
+		template <typename T>
+		void SimplexNoise<T>::tileable_noise(T const * x, T const * y, T* ret, size_t n, T w, T h) KLAYGE_NOEXCEPT
+		{
+			T sx[BATCH_CHUNK];
+			T sy[BATCH_CHUNK];
+			T v[4][BATCH_CHUNK];
+			for (size_t base = 0; base < n; base += BATCH_CHUNK)
+			{
+				size_t const num = (n - base < BATCH_CHUNK) ? n - base : BATCH_CHUNK;
+				T const * cx = x + base;
+				T const * cy = y + base;
+				for (size_t i = 0; i < num; ++ i)
+				{
+					sx[i] = cx[i] - w;
+					sy[i] = cy[i] - h;
+				}
+
+				this->noise(cx, cy, v[0], num);
+				this->noise(sx, cy, v[1], num);
+				this->noise(cx, sy, v[2], num);
+				this->noise(sx, sy, v[3], num);
+
+				for (size_t i = 0; i < num; ++ i)
+				{
+					ret[base + i] = (v[0][i] * (w - cx[i]) * (h - cy[i])
+						+ v[1][i] * (0 + cx[i]) * (h - cy[i])
+						+ v[2][i] * (w - cx[i]) * (0 + cy[i])
+						+ v[3][i] * (0 + cx[i]) * (0 + cy[i])) / (w * h);
+				}
+			}
+		}
+
+		template <typename T>
+		void SimplexNoise<T>::tileable_noise(T const * x, T const * y, T const * z, T* ret, size_t n,
+			T w, T h, T d) KLAYGE_NOEXCEPT
+		{
+			T sx[BATCH_CHUNK];
+			T sy[BATCH_CHUNK];
+			T sz[BATCH_CHUNK];
+			T v[8][BATCH_CHUNK];
+			for (size_t base = 0; base < n; base += BATCH_CHUNK)
+			{
+				size_t const num = (n - base < BATCH_CHUNK) ? n - base : BATCH_CHUNK;
+				T const * cx = x + base;
+				T const * cy = y + base;
+				T const * cz = z + base;
+				for (size_t i = 0; i < num; ++ i)
+				{
+					sx[i] = cx[i] - w;
+					sy[i] = cy[i] - h;
+					sz[i] = cz[i] - d;
+				}
+
+				this->noise(cx, cy, cz, v[0], num);
+				this->noise(sx, cy, cz, v[1], num);
+				this->noise(cx, sy, cz, v[2], num);
+				this->noise(sx, sy, cz, v[3], num);
+				this->noise(cx, cy, sz, v[4], num);
+				this->noise(sx, cy, sz, v[5], num);
+				this->noise(cx, sy, sz, v[6], num);
+				this->noise(sx, sy, sz, v[7], num);
+
+				for (size_t i = 0; i < num; ++ i)
+				{
+					ret[base + i] = (v[0][i] * (w - cx[i]) * (h - cy[i]) * (d - cz[i])
+						+ v[1][i] * (0 + cx[i]) * (h - cy[i]) * (d - cz[i])
+						+ v[2][i] * (w - cx[i]) * (0 + cy[i]) * (d - cz[i])
+						+ v[3][i] * (0 + cx[i]) * (0 + cy[i]) * (d - cz[i])
+						+ v[4][i] * (w - cx[i]) * (h - cy[i]) * (0 + cz[i])
+						+ v[5][i] * (0 + cx[i]) * (h - cy[i]) * (0 + cz[i])
+						+ v[6][i] * (w - cx[i]) * (0 + cy[i]) * (0 + cz[i])
+						+ v[7][i] * (0 + cx[i]) * (0 + cy[i]) * (0 + cz[i])) / (w * h * d);
+				}
+			}
+		}
+
+		template <typename T>
+		void SimplexNoise<T>::tileable_fBm(T const * x, T const * y, T* ret, size_t n, T w, T h,
+			int octaves, T lacunarity, T gain) KLAYGE_NOEXCEPT
+		{
+			this->octaves2<false, true>(x, y, ret, n, w, h, octaves, lacunarity, gain);
+		}
+
+		template <typename T>
+		void SimplexNoise<T>::tileable_fBm(T const * x, T const * y, T const * z, T* ret, size_t n, T w, T h, T d,
+			int octaves, T lacunarity, T gain) KLAYGE_NOEXCEPT
+		{
+			this->octaves3<false, true>(x, y, z, ret, n, w, h, d, octaves, lacunarity, gain);
+		}
+
+		template <typename T>
+		void SimplexNoise<T>::tileable_turbulence(T const * x, T const * y, T* ret, size_t n, T w, T h,
+			int octaves, T lacunarity, T gain) KLAYGE_NOEXCEPT
+		{
+			this->octaves2<true, true>(x, y, ret, n, w, h, octaves, lacunarity, gain);
+		}
+
+		template <typename T>
+		void SimplexNoise<T>::tileable_turbulence(T const * x, T const * y, T const * z, T* ret, size_t n, T w, T h, T d,
+			int octaves, T lacunarity, T gain) KLAYGE_NOEXCEPT
+		{
+			this->octaves3<true, true>(x, y, z, ret, n, w, h, d, octaves, lacunarity, gain);
+		}
+
+		template <typename T>
+		template <bool ABS, bool TILEABLE>
+		void SimplexNoise<T>::octaves2(T const * x, T const * y, T* ret, size_t n, T w, T h,
+			int octaves, T lacunarity, T gain) KLAYGE_NOEXCEPT
+		{
+			T px[BATCH_CHUNK];
+			T py[BATCH_CHUNK];
+			T sum[BATCH_CHUNK];
+			T v[BATCH_CHUNK];
+			for (size_t base = 0; base < n; base += BATCH_CHUNK)
+			{
+				size_t const num = (n - base < BATCH_CHUNK) ? n - base : BATCH_CHUNK;
+				for (size_t i = 0; i < num; ++ i)
+				{
+					px[i] = x[base + i];
+					py[i] = y[base + i];
+					sum[i] = 0;
+				}
+
+				T ow = w;
+				T oh = h;
+				T amp = 1;
+				T amp_sum = 0;
+				for (int o = 0; o < octaves; ++ o)
+				{
+					if (TILEABLE)
+					{
+						this->tileable_noise(px, py, v, num, ow, oh);
+					}
+					else
+					{
+						this->noise(px, py, v, num);
+					}
+					for (size_t i = 0; i < num; ++ i)
+					{
+						sum[i] += (ABS ? MathLib::abs(v[i]) : v[i]) * amp;
+						px[i] *= lacunarity;
+						py[i] *= lacunarity;
+					}
+					amp_sum += amp;
+					ow *= lacunarity;
+					oh *= lacunarity;
+					amp *= gain;
+				}
+
+				for (size_t i = 0; i < num; ++ i)
+				{
+					ret[base + i] = sum[i] / amp_sum;
+				}
+			}
+		}
+
+		template <typename T>
+		template <bool ABS, bool TILEABLE>
+		void SimplexNoise<T>::octaves3(T const * x, T const * y, T const * z, T* ret, size_t n, T w, T h, T d,
+			int octaves, T lacunarity, T gain) KLAYGE_NOEXCEPT
+		{
+			T px[BATCH_CHUNK];
+			T py[BATCH_CHUNK];
+			T pz[BATCH_CHUNK];
+			T sum[BATCH_CHUNK];
+			T v[BATCH_CHUNK];
+			for (size_t base = 0; base < n; base += BATCH_CHUNK)
+			{
+				size_t const num = (n - base < BATCH_CHUNK) ? n - base : BATCH_CHUNK;
+				for (size_t i = 0; i < num; ++ i)
+				{
+					px[i] = x[base + i];
+					py[i] = y[base + i];
+					pz[i] = z[base + i];
+					sum[i] = 0;
+				}
+
+				T ow = w;
+				T oh = h;
+				T od = d;
+				T amp = 1;
+				T amp_sum = 0;
+				for (int o = 0; o < octaves; ++ o)
+				{
+					if (TILEABLE)
+					{
+						this->tileable_noise(px, py, pz, v, num, ow, oh, od);
+					}
+					else
+					{
+						this->noise(px, py, pz, v, num);
+					}
+					for (size_t i = 0; i < num; ++ i)
+					{
+						sum[i] += (ABS ? MathLib::abs(v[i]) : v[i]) * amp;
+						px[i] *= lacunarity;
+						py[i] *= lacunarity;
+						pz[i] *= lacunarity;
+					}
+					amp_sum += amp;
+					ow *= lacunarity;
+					oh *= lacunarity;
+					od *= lacunarity;
+					amp *= gain;
+				}
+
+				for (size_t i = 0; i < num; ++ i)
+				{
+					ret[base + i] = sum[i] / amp_sum;
+				}
+			}
+		}
 	}
 }
@@ -0,0 +1,497 @@
+/**
+ * @file SIMDMathBatch.cpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KFL, a subproject of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#include <KFL/KFL.hpp>
+#include <KFL/CpuInfo.hpp>
+#include <KFL/Math.hpp>
+#include <KFL/SIMDMath.hpp>
+
+#include <limits>
+
+#if defined(KLAYGE_NEON_SUPPORT) && !defined(SIMD_MATH_SSE)
+	#define SIMD_MATH_NEON
+	#include <arm_neon.h>
+#endif
+#if defined(SIMD_MATH_SSE) && defined(KLAYGE_COMPILER_MSVC)
+	#include <immintrin.h>
+#endif
+
+#include "SIMDMathBatch.hpp"
+
+// The batch kernels take positions as SoA streams, so 4 (SSE, NEON) or 8 (AVX2) points go through one matrix with
+//  every lane doing useful work. The tail of a batch is done by the general kernels.
+
+namespace
+{
+	using namespace KlayGE;
+
+	// General kernels, the same math as the scalar MathLib functions
+	///////////////////////////////////////////////////////////////////////////////
+	void TransformCoordBatchGeneral(float* out_x, float* out_y, float* out_z,
+		float const * x, float const * y, float const * z, size_t num, float4x4 const & mat)
+	{
+		for (size_t i = 0; i < num; ++ i)
+		{
+			float const vx = x[i];
+			float const vy = y[i];
+			float const vz = z[i];
+			float const w = vx * mat(0, 3) + vy * mat(1, 3) + vz * mat(2, 3) + mat(3, 3);
+			float const inv_w = MathLib::equal(w, 0.0f) ? 0.0f : 1 / w;
+			out_x[i] = (vx * mat(0, 0) + vy * mat(1, 0) + vz * mat(2, 0) + mat(3, 0)) * inv_w;
+			out_y[i] = (vx * mat(0, 1) + vy * mat(1, 1) + vz * mat(2, 1) + mat(3, 1)) * inv_w;
+			out_z[i] = (vx * mat(0, 2) + vy * mat(1, 2) + vz * mat(2, 2) + mat(3, 2)) * inv_w;
+		}
+	}
+
+	void TransformDepthBatchGeneral(float* depth, float const * x, float const * y, float const * z, size_t num,
+		float4x4 const & mat)
+	{
+		for (size_t i = 0; i < num; ++ i)
+		{
+			float const vx = x[i];
+			float const vy = y[i];
+			float const vz = z[i];
+			float const w = vx * mat(0, 3) + vy * mat(1, 3) + vz * mat(2, 3) + mat(3, 3);
+			depth[i] = MathLib::equal(w, 0.0f) ? 0.0f
+				: (vx * mat(0, 2) + vy * mat(1, 2) + vz * mat(2, 2) + mat(3, 2)) / w;
+		}
+	}
+
+	// Each axis of the result is the sum of the extremes the input axes contribute to it, which gives the same box
+	//  as transforming the 8 corners, with 18 multiplies instead of 72.
+	void TransformAABBBatchGeneral(AABBox* out, AABBox const * in, size_t num, float4x4 const & mat)
+	{
+		for (size_t i = 0; i < num; ++ i)
+		{
+			float3 const & src_min = in[i].Min();
+			float3 const & src_max = in[i].Max();
+			float3 dst_min(mat(3, 0), mat(3, 1), mat(3, 2));
+			float3 dst_max = dst_min;
+			for (int r = 0; r < 3; ++ r)
+			{
+				for (int c = 0; c < 3; ++ c)
+				{
+					float const a = mat(r, c) * src_min[r];
+					float const b = mat(r, c) * src_max[r];
+					dst_min[c] += std::min(a, b);
+					dst_max[c] += std::max(a, b);
+				}
+			}
+			out[i] = AABBox(dst_min, dst_max);
+		}
+	}
+
+	void MultiplyBatchGeneral(float4x4* out, float4x4 const * lhs, size_t num, float4x4 const & rhs)
+	{
+		float4x4 const tmp = rhs;
+		for (size_t i = 0; i < num; ++ i)
+		{
+			out[i] = MathLib::mul(lhs[i], tmp);
+		}
+	}
+
+#if defined(SIMD_MATH_SSE)
+	// SSE kernels
+	///////////////////////////////////////////////////////////////////////////////
+	__m128 ProjectSSE(__m128 v, __m128 w)
+	{
+		__m128 const abs_w = _mm_max_ps(w, _mm_sub_ps(_mm_setzero_ps(), w));
+		__m128 const zero_w = _mm_cmple_ps(abs_w, _mm_set1_ps(std::numeric_limits<float>::epsilon()));
+		return _mm_andnot_ps(zero_w, _mm_div_ps(v, w));
+	}
+
+	void TransformCoordBatchSSE(float* out_x, float* out_y, float* out_z,
+		float const * x, float const * y, float const * z, size_t num, float4x4 const & mat)
+	{
+		__m128 m[4][4];
+		for (int r = 0; r < 4; ++ r)
+		{
+			for (int c = 0; c < 4; ++ c)
+			{
+				m[r][c] = _mm_set1_ps(mat(r, c));
+			}
+		}
+
+		size_t const num_simd = num & ~size_t(3);
+		for (size_t i = 0; i < num_simd; i += 4)
+		{
+			__m128 const vx = _mm_loadu_ps(x + i);
+			__m128 const vy = _mm_loadu_ps(y + i);
+			__m128 const vz = _mm_loadu_ps(z + i);
+
+			__m128 res[4];
+			for (int c = 0; c < 4; ++ c)
+			{
+				res[c] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, m[0][c]), _mm_mul_ps(vy, m[1][c])),
+					_mm_add_ps(_mm_mul_ps(vz, m[2][c]), m[3][c]));
+			}
+
+			_mm_storeu_ps(out_x + i, ProjectSSE(res[0], res[3]));
+			_mm_storeu_ps(out_y + i, ProjectSSE(res[1], res[3]));
+			_mm_storeu_ps(out_z + i, ProjectSSE(res[2], res[3]));
+		}
+
+		TransformCoordBatchGeneral(out_x + num_simd, out_y + num_simd, out_z + num_simd,
+			x + num_simd, y + num_simd, z + num_simd, num - num_simd, mat);
+	}
+
+	void TransformDepthBatchSSE(float* depth, float const * x, float const * y, float const * z, size_t num,
+		float4x4 const & mat)
+	{
+		__m128 const m02 = _mm_set1_ps(mat(0, 2));
+		__m128 const m12 = _mm_set1_ps(mat(1, 2));
+		__m128 const m22 = _mm_set1_ps(mat(2, 2));
+		__m128 const m32 = _mm_set1_ps(mat(3, 2));
+		__m128 const m03 = _mm_set1_ps(mat(0, 3));
+		__m128 const m13 = _mm_set1_ps(mat(1, 3));
+		__m128 const m23 = _mm_set1_ps(mat(2, 3));
+		__m128 const m33 = _mm_set1_ps(mat(3, 3));
+
+		size_t const num_simd = num & ~size_t(3);
+		for (size_t i = 0; i < num_simd; i += 4)
+		{
+			__m128 const vx = _mm_loadu_ps(x + i);
+			__m128 const vy = _mm_loadu_ps(y + i);
+			__m128 const vz = _mm_loadu_ps(z + i);
+			__m128 const vz_out = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, m02), _mm_mul_ps(vy, m12)),
+				_mm_add_ps(_mm_mul_ps(vz, m22), m32));
+			__m128 const vw_out = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, m03), _mm_mul_ps(vy, m13)),
+				_mm_add_ps(_mm_mul_ps(vz, m23), m33));
+			_mm_storeu_ps(depth + i, ProjectSSE(vz_out, vw_out));
+		}
+
+		TransformDepthBatchGeneral(depth + num_simd, x + num_simd, y + num_simd, z + num_simd, num - num_simd, mat);
+	}
+
+	// A box is too small to fill the lanes in SoA form, so the 3 output axes go in one register instead.
+	void TransformAABBBatchSSE(AABBox* out, AABBox const * in, size_t num, float4x4 const & mat)
+	{
+		__m128 const r0 = _mm_loadu_ps(&mat(0, 0));
+		__m128 const r1 = _mm_loadu_ps(&mat(1, 0));
+		__m128 const r2 = _mm_loadu_ps(&mat(2, 0));
+		__m128 const r3 = _mm_loadu_ps(&mat(3, 0));
+
+		for (size_t i = 0; i < num; ++ i)
+		{
+			float3 const & src_min = in[i].Min();
+			float3 const & src_max = in[i].Max();
+
+			__m128 a = _mm_mul_ps(r0, _mm_set1_ps(src_min.x()));
+			__m128 b = _mm_mul_ps(r0, _mm_set1_ps(src_max.x()));
+			__m128 dst_min = _mm_add_ps(r3, _mm_min_ps(a, b));
+			__m128 dst_max = _mm_add_ps(r3, _mm_max_ps(a, b));
+
+			a = _mm_mul_ps(r1, _mm_set1_ps(src_min.y()));
+			b = _mm_mul_ps(r1, _mm_set1_ps(src_max.y()));
+			dst_min = _mm_add_ps(dst_min, _mm_min_ps(a, b));
+			dst_max = _mm_add_ps(dst_max, _mm_max_ps(a, b));
+
+			a = _mm_mul_ps(r2, _mm_set1_ps(src_min.z()));
+			b = _mm_mul_ps(r2, _mm_set1_ps(src_max.z()));
+			dst_min = _mm_add_ps(dst_min, _mm_min_ps(a, b));
+			dst_max = _mm_add_ps(dst_max, _mm_max_ps(a, b));
+
+			float4 min4, max4;
+			_mm_storeu_ps(&min4[0], dst_min);
+			_mm_storeu_ps(&max4[0], dst_max);
+			out[i] = AABBox(float3(min4.x(), min4.y(), min4.z()), float3(max4.x(), max4.y(), max4.z()));
+		}
+	}
+
+	void MultiplyBatchSSE(float4x4* out, float4x4 const * lhs, size_t num, float4x4 const & rhs)
+	{
+		__m128 const r0 = _mm_loadu_ps(&rhs(0, 0));
+		__m128 const r1 = _mm_loadu_ps(&rhs(1, 0));
+		__m128 const r2 = _mm_loadu_ps(&rhs(2, 0));
+		__m128 const r3 = _mm_loadu_ps(&rhs(3, 0));
+
+		for (size_t i = 0; i < num; ++ i)
+		{
+			for (int r = 0; r < 4; ++ r)
+			{
+				__m128 const l = _mm_loadu_ps(&lhs[i](r, 0));
+				__m128 const res = _mm_add_ps(
+					_mm_add_ps(_mm_mul_ps(_mm_shuffle_ps(l, l, _MM_SHUFFLE(0, 0, 0, 0)), r0),
+						_mm_mul_ps(_mm_shuffle_ps(l, l, _MM_SHUFFLE(1, 1, 1, 1)), r1)),
+					_mm_add_ps(_mm_mul_ps(_mm_shuffle_ps(l, l, _MM_SHUFFLE(2, 2, 2, 2)), r2),
+						_mm_mul_ps(_mm_shuffle_ps(l, l, _MM_SHUFFLE(3, 3, 3, 3)), r3)));
+				_mm_storeu_ps(&out[i](r, 0), res);
+			}
+		}
+	}
+#elif defined(SIMD_MATH_NEON)
+	// NEON kernels
+	///////////////////////////////////////////////////////////////////////////////
+	float32x4_t ProjectNEON(float32x4_t v, float32x4_t w)
+	{
+		// ARMv7 NEON has no divide. Two Newton-Raphson steps bring the estimate to full precision.
+		float32x4_t inv_w = vrecpeq_f32(w);
+		inv_w = vmulq_f32(vrecpsq_f32(w, inv_w), inv_w);
+		inv_w = vmulq_f32(vrecpsq_f32(w, inv_w), inv_w);
+		uint32x4_t const zero_w = vcaleq_f32(w, vdupq_n_f32(std::numeric_limits<float>::epsilon()));
+		return vreinterpretq_f32_u32(vbicq_u32(vreinterpretq_u32_f32(vmulq_f32(v, inv_w)), zero_w));
+	}
+
+	void TransformCoordBatchNEON(float* out_x, float* out_y, float* out_z,
+		float const * x, float const * y, float const * z, size_t num, float4x4 const & mat)
+	{
+		float32x4_t m[4][4];
+		for (int r = 0; r < 4; ++ r)
+		{
+			for (int c = 0; c < 4; ++ c)
+			{
+				m[r][c] = vdupq_n_f32(mat(r, c));
+			}
+		}
+
+		size_t const num_simd = num & ~size_t(3);
+		for (size_t i = 0; i < num_simd; i += 4)
+		{
+			float32x4_t const vx = vld1q_f32(x + i);
+			float32x4_t const vy = vld1q_f32(y + i);
+			float32x4_t const vz = vld1q_f32(z + i);
+
+			float32x4_t res[4];
+			for (int c = 0; c < 4; ++ c)
+			{
+				res[c] = vmlaq_f32(vmlaq_f32(vmlaq_f32(m[3][c], vz, m[2][c]), vy, m[1][c]), vx, m[0][c]);
+			}
+
+			vst1q_f32(out_x + i, ProjectNEON(res[0], res[3]));
+			vst1q_f32(out_y + i, ProjectNEON(res[1], res[3]));
+			vst1q_f32(out_z + i, ProjectNEON(res[2], res[3]));
+		}
+
+		TransformCoordBatchGeneral(out_x + num_simd, out_y + num_simd, out_z + num_simd,
+			x + num_simd, y + num_simd, z + num_simd, num - num_simd, mat);
+	}
+
+	void TransformDepthBatchNEON(float* depth, float const * x, float const * y, float const * z, size_t num,
+		float4x4 const & mat)
+	{
+		float32x4_t const m02 = vdupq_n_f32(mat(0, 2));
+		float32x4_t const m12 = vdupq_n_f32(mat(1, 2));
+		float32x4_t const m22 = vdupq_n_f32(mat(2, 2));
+		float32x4_t const m32 = vdupq_n_f32(mat(3, 2));
+		float32x4_t const m03 = vdupq_n_f32(mat(0, 3));
+		float32x4_t const m13 = vdupq_n_f32(mat(1, 3));
+		float32x4_t const m23 = vdupq_n_f32(mat(2, 3));
+		float32x4_t const m33 = vdupq_n_f32(mat(3, 3));
+
+		size_t const num_simd = num & ~size_t(3);
+		for (size_t i = 0; i < num_simd; i += 4)
+		{
+			float32x4_t const vx = vld1q_f32(x + i);
+			float32x4_t const vy = vld1q_f32(y + i);
+			float32x4_t const vz = vld1q_f32(z + i);
+			float32x4_t const vz_out = vmlaq_f32(vmlaq_f32(vmlaq_f32(m32, vz, m22), vy, m12), vx, m02);
+			float32x4_t const vw_out = vmlaq_f32(vmlaq_f32(vmlaq_f32(m33, vz, m23), vy, m13), vx, m03);
+			vst1q_f32(depth + i, ProjectNEON(vz_out, vw_out));
+		}
+
+		TransformDepthBatchGeneral(depth + num_simd, x + num_simd, y + num_simd, z + num_simd, num - num_simd, mat);
+	}
+
+	void TransformAABBBatchNEON(AABBox* out, AABBox const * in, size_t num, float4x4 const & mat)
+	{
+		float32x4_t const r0 = vld1q_f32(&mat(0, 0));
+		float32x4_t const r1 = vld1q_f32(&mat(1, 0));
+		float32x4_t const r2 = vld1q_f32(&mat(2, 0));
+		float32x4_t const r3 = vld1q_f32(&mat(3, 0));
+
+		for (size_t i = 0; i < num; ++ i)
+		{
+			float3 const & src_min = in[i].Min();
+			float3 const & src_max = in[i].Max();
+
+			float32x4_t a = vmulq_n_f32(r0, src_min.x());
+			float32x4_t b = vmulq_n_f32(r0, src_max.x());
+			float32x4_t dst_min = vaddq_f32(r3, vminq_f32(a, b));
+			float32x4_t dst_max = vaddq_f32(r3, vmaxq_f32(a, b));
+
+			a = vmulq_n_f32(r1, src_min.y());
+			b = vmulq_n_f32(r1, src_max.y());
+			dst_min = vaddq_f32(dst_min, vminq_f32(a, b));
+			dst_max = vaddq_f32(dst_max, vmaxq_f32(a, b));
+
+			a = vmulq_n_f32(r2, src_min.z());
+			b = vmulq_n_f32(r2, src_max.z());
+			dst_min = vaddq_f32(dst_min, vminq_f32(a, b));
+			dst_max = vaddq_f32(dst_max, vmaxq_f32(a, b));
+
+			float4 min4, max4;
+			vst1q_f32(&min4[0], dst_min);
+			vst1q_f32(&max4[0], dst_max);
+			out[i] = AABBox(float3(min4.x(), min4.y(), min4.z()), float3(max4.x(), max4.y(), max4.z()));
+		}
+	}
+
+	void MultiplyBatchNEON(float4x4* out, float4x4 const * lhs, size_t num, float4x4 const & rhs)
+	{
+		float32x4_t const r0 = vld1q_f32(&rhs(0, 0));
+		float32x4_t const r1 = vld1q_f32(&rhs(1, 0));
+		float32x4_t const r2 = vld1q_f32(&rhs(2, 0));
+		float32x4_t const r3 = vld1q_f32(&rhs(3, 0));
+
+		for (size_t i = 0; i < num; ++ i)
+		{
+			for (int r = 0; r < 4; ++ r)
+			{
+				float32x4_t const l = vld1q_f32(&lhs[i](r, 0));
+				float32x2_t const l_lo = vget_low_f32(l);
+				float32x2_t const l_hi = vget_high_f32(l);
+				float32x4_t res = vmulq_lane_f32(r0, l_lo, 0);
+				res = vmlaq_lane_f32(res, r1, l_lo, 1);
+				res = vmlaq_lane_f32(res, r2, l_hi, 0);
+				res = vmlaq_lane_f32(res, r3, l_hi, 1);
+				vst1q_f32(&out[i](r, 0), res);
+			}
+		}
+	}
+#endif
+
+#if defined(SIMD_MATH_SSE)
+	// CPUInfo's AVX flags only say that the OS uses XSAVE. Bits 1 and 2 of XCR0 say that it also saves the XMM and YMM
+	//  registers on context switches. Only valid to call when CPUID reports OSXSAVE.
+	bool OSSupportsAVX()
+	{
+		uint32_t xcr0;
+#if defined(KLAYGE_COMPILER_MSVC)
+		xcr0 = static_cast<uint32_t>(_xgetbv(0));
+#elif defined(KLAYGE_COMPILER_GCC) || defined(KLAYGE_COMPILER_CLANG)
+		uint32_t edx;
+		// The bytes of xgetbv, for assemblers that don't know it
+		__asm__
+		(
+			".byte 0x0F, 0x01, 0xD0"
+			: "=a" (xcr0), "=d" (edx)
+			: "c" (0)
+		);
+		KFL_UNUSED(edx);
+#else
+		xcr0 = 0;
+#endif
+		return (xcr0 & 0x6) == 0x6;
+	}
+#endif
+
+	SIMDMathLib::Detail::BatchKernels SelectBatchKernels()
+	{
+#if defined(SIMD_MATH_SSE)
+		SIMDMathLib::Detail::BatchKernels kernels =
+		{
+			TransformCoordBatchSSE,
+			TransformDepthBatchSSE,
+			TransformAABBBatchSSE,
+			MultiplyBatchSSE
+		};
+
+		SIMDMathLib::Detail::BatchKernels const * avx2_kernels = SIMDMathLib::Detail::BatchKernelsAVX2();
+		if (avx2_kernels != nullptr)
+		{
+			CPUInfo cpu;
+			if (cpu.IsFeatureSupport(CPUInfo::CF_AVX) && cpu.IsFeatureSupport(CPUInfo::CF_AVX2)
+				&& cpu.IsFeatureSupport(CPUInfo::CF_FMA3) && OSSupportsAVX())
+			{
+				if (avx2_kernels->transform_coord)
+				{
+					kernels.transform_coord = avx2_kernels->transform_coord;
+				}
+				if (avx2_kernels->transform_depth)
+				{
+					kernels.transform_depth = avx2_kernels->transform_depth;
+				}
+				if (avx2_kernels->transform_aabb)
+				{
+					kernels.transform_aabb = avx2_kernels->transform_aabb;
+				}
+				if (avx2_kernels->multiply)
+				{
+					kernels.multiply = avx2_kernels->multiply;
+				}
+			}
+		}
+#elif defined(SIMD_MATH_NEON)
+		SIMDMathLib::Detail::BatchKernels const kernels =
+		{
+			TransformCoordBatchNEON,
+			TransformDepthBatchNEON,
+			TransformAABBBatchNEON,
+			MultiplyBatchNEON
+		};
+#else
+		SIMDMathLib::Detail::BatchKernels const kernels =
+		{
+			TransformCoordBatchGeneral,
+			TransformDepthBatchGeneral,
+			TransformAABBBatchGeneral,
+			MultiplyBatchGeneral
+		};
+#endif
+
+		return kernels;
+	}
+
+	SIMDMathLib::Detail::BatchKernels const & ActiveBatchKernels()
+	{
+		static SIMDMathLib::Detail::BatchKernels const kernels = SelectBatchKernels();
+		return kernels;
+	}
+}
+
+namespace KlayGE
+{
+	namespace SIMDMathLib
+	{
+		// Batch
+		///////////////////////////////////////////////////////////////////////////////
+		void TransformCoordBatch(float* out_x, float* out_y, float* out_z,
+			float const * x, float const * y, float const * z, size_t num, float4x4 const & mat)
+		{
+			ActiveBatchKernels().transform_coord(out_x, out_y, out_z, x, y, z, num, mat);
+		}
+
+		void TransformDepthBatch(float* depth, float const * x, float const * y, float const * z, size_t num,
+			float4x4 const & mat)
+		{
+			ActiveBatchKernels().transform_depth(depth, x, y, z, num, mat);
+		}
+
+		void TransformAABBBatch(AABBox* out, AABBox const * in, size_t num, float4x4 const & mat)
+		{
+			ActiveBatchKernels().transform_aabb(out, in, num, mat);
+		}
+
+		void MultiplyBatch(float4x4* out, float4x4 const * lhs, size_t num, float4x4 const & rhs)
+		{
+			ActiveBatchKernels().multiply(out, lhs, num, rhs);
+		}
+	}
+}
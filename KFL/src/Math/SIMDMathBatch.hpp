@@ -0,0 +1,62 @@
+/**
+ * @file SIMDMathBatch.hpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KFL, a subproject of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#ifndef _KFL_SIMDMATHBATCH_HPP
+#define _KFL_SIMDMATHBATCH_HPP
+
+#pragma once
+
+#include <KFL/PreDeclare.hpp>
+
+namespace KlayGE
+{
+	namespace SIMDMathLib
+	{
+		namespace Detail
+		{
+			// One set of batch kernels. A null entry in a set means the kernel of the baseline set is used.
+			struct BatchKernels
+			{
+				void (*transform_coord)(float* out_x, float* out_y, float* out_z,
+					float const * x, float const * y, float const * z, size_t num, float4x4 const & mat);
+				void (*transform_depth)(float* depth, float const * x, float const * y, float const * z, size_t num,
+					float4x4 const & mat);
+				void (*transform_aabb)(AABBox* out, AABBox const * in, size_t num, float4x4 const & mat);
+				void (*multiply)(float4x4* out, float4x4 const * lhs, size_t num, float4x4 const & rhs);
+			};
+
+			// In SIMDMathBatchAVX2.cpp, the only file built with AVX2 and FMA code generation. Returns nullptr if the
+			//  compiler can't target AVX2.
+			BatchKernels const * BatchKernelsAVX2();
+		}
+	}
+}
+
+#endif		// _KFL_SIMDMATHBATCH_HPP
@@ -0,0 +1,198 @@
+/**
+ * @file SIMDMathBatchAVX2.cpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KFL, a subproject of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+// This file is built with AVX2 and FMA code generation, and its kernels only run after CPUInfo has found both. So
+//  it must not instantiate any inline function shared with other files, or the linker could pick the AVX2 copy
+//  for callers on older CPUs. Matrices are read through raw pointers for that reason.
+
+#include <KFL/Config.hpp>
+#include <KFL/Types.hpp>
+#include <KFL/PreDeclare.hpp>
+
+#include <cfloat>
+#include <cstddef>
+
+#if defined(KLAYGE_AVX2_SUPPORT)
+	#include <immintrin.h>
+#endif
+
+#include "SIMDMathBatch.hpp"
+
+#if defined(KLAYGE_AVX2_SUPPORT)
+namespace
+{
+	using namespace KlayGE;
+
+	float const * MatrixData(float4x4 const & mat)
+	{
+		return reinterpret_cast<float const *>(&mat);
+	}
+
+	// All lanes before the remaining count
+	__m256i TailMask(size_t num_remain)
+	{
+		return _mm256_cmpgt_epi32(_mm256_set1_epi32(static_cast<int>(num_remain)),
+			_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+	}
+
+	__m256 ProjectAVX2(__m256 v, __m256 w)
+	{
+		__m256 const abs_w = _mm256_max_ps(w, _mm256_sub_ps(_mm256_setzero_ps(), w));
+		__m256 const zero_w = _mm256_cmp_ps(abs_w, _mm256_set1_ps(FLT_EPSILON), _CMP_LE_OQ);
+		return _mm256_andnot_ps(zero_w, _mm256_div_ps(v, w));
+	}
+
+	__m256 TransformAxisAVX2(__m256 x, __m256 y, __m256 z, __m256 const * col)
+	{
+		return _mm256_fmadd_ps(x, col[0], _mm256_fmadd_ps(y, col[1], _mm256_fmadd_ps(z, col[2], col[3])));
+	}
+
+	void TransformCoordBatchAVX2(float* out_x, float* out_y, float* out_z,
+		float const * x, float const * y, float const * z, size_t num, float4x4 const & mat)
+	{
+		float const * m = MatrixData(mat);
+		__m256 cols[4][4];
+		for (int c = 0; c < 4; ++ c)
+		{
+			for (int r = 0; r < 4; ++ r)
+			{
+				cols[c][r] = _mm256_set1_ps(m[r * 4 + c]);
+			}
+		}
+
+		size_t i = 0;
+		for (; i + 8 <= num; i += 8)
+		{
+			__m256 const vx = _mm256_loadu_ps(x + i);
+			__m256 const vy = _mm256_loadu_ps(y + i);
+			__m256 const vz = _mm256_loadu_ps(z + i);
+			__m256 const vw = TransformAxisAVX2(vx, vy, vz, cols[3]);
+			_mm256_storeu_ps(out_x + i, ProjectAVX2(TransformAxisAVX2(vx, vy, vz, cols[0]), vw));
+			_mm256_storeu_ps(out_y + i, ProjectAVX2(TransformAxisAVX2(vx, vy, vz, cols[1]), vw));
+			_mm256_storeu_ps(out_z + i, ProjectAVX2(TransformAxisAVX2(vx, vy, vz, cols[2]), vw));
+		}
+		if (i < num)
+		{
+			__m256i const mask = TailMask(num - i);
+			__m256 const vx = _mm256_maskload_ps(x + i, mask);
+			__m256 const vy = _mm256_maskload_ps(y + i, mask);
+			__m256 const vz = _mm256_maskload_ps(z + i, mask);
+			__m256 const vw = TransformAxisAVX2(vx, vy, vz, cols[3]);
+			_mm256_maskstore_ps(out_x + i, mask, ProjectAVX2(TransformAxisAVX2(vx, vy, vz, cols[0]), vw));
+			_mm256_maskstore_ps(out_y + i, mask, ProjectAVX2(TransformAxisAVX2(vx, vy, vz, cols[1]), vw));
+			_mm256_maskstore_ps(out_z + i, mask, ProjectAVX2(TransformAxisAVX2(vx, vy, vz, cols[2]), vw));
+		}
+	}
+
+	void TransformDepthBatchAVX2(float* depth, float const * x, float const * y, float const * z, size_t num,
+		float4x4 const & mat)
+	{
+		float const * m = MatrixData(mat);
+		__m256 col_z[4];
+		__m256 col_w[4];
+		for (int r = 0; r < 4; ++ r)
+		{
+			col_z[r] = _mm256_set1_ps(m[r * 4 + 2]);
+			col_w[r] = _mm256_set1_ps(m[r * 4 + 3]);
+		}
+
+		size_t i = 0;
+		for (; i + 8 <= num; i += 8)
+		{
+			__m256 const vx = _mm256_loadu_ps(x + i);
+			__m256 const vy = _mm256_loadu_ps(y + i);
+			__m256 const vz = _mm256_loadu_ps(z + i);
+			_mm256_storeu_ps(depth + i, ProjectAVX2(TransformAxisAVX2(vx, vy, vz, col_z),
+				TransformAxisAVX2(vx, vy, vz, col_w)));
+		}
+		if (i < num)
+		{
+			__m256i const mask = TailMask(num - i);
+			__m256 const vx = _mm256_maskload_ps(x + i, mask);
+			__m256 const vy = _mm256_maskload_ps(y + i, mask);
+			__m256 const vz = _mm256_maskload_ps(z + i, mask);
+			_mm256_maskstore_ps(depth + i, mask, ProjectAVX2(TransformAxisAVX2(vx, vy, vz, col_z),
+				TransformAxisAVX2(vx, vy, vz, col_w)));
+		}
+	}
+
+	// Two rows of a product at a time, with each row of rhs in both 128-bit lanes
+	void MultiplyBatchAVX2(float4x4* out, float4x4 const * lhs, size_t num, float4x4 const & rhs)
+	{
+		float const * m = MatrixData(rhs);
+		__m256 const r0 = _mm256_broadcast_ps(reinterpret_cast<__m128 const *>(m + 0));
+		__m256 const r1 = _mm256_broadcast_ps(reinterpret_cast<__m128 const *>(m + 4));
+		__m256 const r2 = _mm256_broadcast_ps(reinterpret_cast<__m128 const *>(m + 8));
+		__m256 const r3 = _mm256_broadcast_ps(reinterpret_cast<__m128 const *>(m + 12));
+
+		// float4x4 is incomplete here. It's 16 packed floats.
+		float const * l = reinterpret_cast<float const *>(lhs);
+		float* o = reinterpret_cast<float*>(out);
+		for (size_t i = 0; i < num; ++ i, l += 16, o += 16)
+		{
+			for (int r = 0; r < 4; r += 2)
+			{
+				__m256 const l2 = _mm256_loadu_ps(l + r * 4);
+				__m256 res = _mm256_mul_ps(_mm256_permute_ps(l2, 0x00), r0);
+				res = _mm256_fmadd_ps(_mm256_permute_ps(l2, 0x55), r1, res);
+				res = _mm256_fmadd_ps(_mm256_permute_ps(l2, 0xAA), r2, res);
+				res = _mm256_fmadd_ps(_mm256_permute_ps(l2, 0xFF), r3, res);
+				_mm256_storeu_ps(o + r * 4, res);
+			}
+		}
+	}
+}
+#endif
+
+namespace KlayGE
+{
+	namespace SIMDMathLib
+	{
+		namespace Detail
+		{
+			BatchKernels const * BatchKernelsAVX2()
+			{
+#if defined(KLAYGE_AVX2_SUPPORT)
+				// A box is done in one 128-bit register, so the SSE kernel is as fast for AABBs.
+				static BatchKernels const kernels =
+				{
+					TransformCoordBatchAVX2,
+					TransformDepthBatchAVX2,
+					nullptr,
+					MultiplyBatchAVX2
+				};
+				return &kernels;
+#else
+				return nullptr;
+#endif
+			}
+		}
+	}
+}
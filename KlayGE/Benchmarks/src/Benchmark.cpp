@@ -0,0 +1,580 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Math.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <locale>
+#include <map>
+#include <sstream>
+#include <thread>
+
+#include "Benchmark.hpp"
+
+namespace
+{
+	using namespace KlayGE;
+
+#if defined(KLAYGE_COMPILER_MSVC)
+	char const * const COMPILER_NAME = "vc";
+#elif defined(KLAYGE_COMPILER_CLANG)
+	char const * const COMPILER_NAME = "clang";
+#elif defined(KLAYGE_COMPILER_GCC)
+	char const * const COMPILER_NAME = "gcc";
+#else
+	char const * const COMPILER_NAME = "unknown";
+#endif
+
+	// Caps the calibration, so that an empty loop body can't run forever.
+	uint64_t const MAX_ITERATIONS = 1ULL << 30;
+
+	std::map<std::string, BenchmarkFunc>& Registry()
+	{
+		static std::map<std::string, BenchmarkFunc> registry;
+		return registry;
+	}
+
+	void WriteJsonString(std::ostream& os, std::string const & str)
+	{
+		os << '"';
+		for (char const ch : str)
+		{
+			if (('"' == ch) || ('\\' == ch))
+			{
+				os << '\\' << ch;
+			}
+			else if (static_cast<unsigned char>(ch) < 0x20)
+			{
+				os << ' ';
+			}
+			else
+			{
+				os << ch;
+			}
+		}
+		os << '"';
+	}
+
+	// Just enough JSON to read back a result file as the baseline.
+	struct JsonValue
+	{
+		enum JsonType
+		{
+			JT_Null,
+			JT_Bool,
+			JT_Number,
+			JT_String,
+			JT_Array,
+			JT_Object
+		};
+
+		JsonType type = JT_Null;
+		bool boolean = false;
+		double number = 0;
+		std::string str;
+		std::vector<std::string> keys;
+		// Elements of an array, or values of an object in the order of keys.
+		std::vector<JsonValue> values;
+
+		JsonValue const * Member(std::string const & key) const
+		{
+			for (size_t i = 0; i < keys.size(); ++ i)
+			{
+				if (keys[i] == key)
+				{
+					return &values[i];
+				}
+			}
+			return nullptr;
+		}
+	};
+
+	class JsonParser
+	{
+	public:
+		explicit JsonParser(std::string const & text)
+			: text_(text), pos_(0)
+		{
+		}
+
+		bool Parse(JsonValue& value)
+		{
+			if (!this->ParseValue(value))
+			{
+				return false;
+			}
+			this->SkipSpaces();
+			return pos_ == text_.size();
+		}
+
+		size_t Position() const
+		{
+			return pos_;
+		}
+
+	private:
+		void SkipSpaces()
+		{
+			while ((pos_ < text_.size())
+				&& ((' ' == text_[pos_]) || ('\t' == text_[pos_]) || ('\r' == text_[pos_]) || ('\n' == text_[pos_])))
+			{
+				++ pos_;
+			}
+		}
+
+		bool Expect(char ch)
+		{
+			this->SkipSpaces();
+			if ((pos_ < text_.size()) && (text_[pos_] == ch))
+			{
+				++ pos_;
+				return true;
+			}
+			return false;
+		}
+
+		bool ParseLiteral(char const * literal)
+		{
+			size_t const len = strlen(literal);
+			if (text_.compare(pos_, len, literal) == 0)
+			{
+				pos_ += len;
+				return true;
+			}
+			return false;
+		}
+
+		bool ParseString(std::string& str)
+		{
+			if (!this->Expect('"'))
+			{
+				return false;
+			}
+
+			str.clear();
+			while (pos_ < text_.size())
+			{
+				char ch = text_[pos_];
+				++ pos_;
+				if ('"' == ch)
+				{
+					return true;
+				}
+				if ('\\' == ch)
+				{
+					if (pos_ == text_.size())
+					{
+						return false;
+					}
+					ch = text_[pos_];
+					++ pos_;
+					switch (ch)
+					{
+					case 'n':
+						ch = '\n';
+						break;
+
+					case 't':
+						ch = '\t';
+						break;
+
+					case 'r':
+						ch = '\r';
+						break;
+
+					case 'u':
+						// Names are ASCII, so escaped code points are not expected. Keep them as a placeholder.
+						pos_ = std::min(pos_ + 4, text_.size());
+						ch = '?';
+						break;
+
+					default:
+						break;
+					}
+				}
+				str.push_back(ch);
+			}
+			return false;
+		}
+
+		bool ParseValue(JsonValue& value)
+		{
+			this->SkipSpaces();
+			if (pos_ == text_.size())
+			{
+				return false;
+			}
+
+			char const ch = text_[pos_];
+			if ('{' == ch)
+			{
+				value.type = JsonValue::JT_Object;
+				++ pos_;
+				if (this->Expect('}'))
+				{
+					return true;
+				}
+				do
+				{
+					value.keys.emplace_back();
+					value.values.emplace_back();
+					if (!this->ParseString(value.keys.back()) || !this->Expect(':')
+						|| !this->ParseValue(value.values.back()))
+					{
+						return false;
+					}
+				} while (this->Expect(','));
+				return this->Expect('}');
+			}
+			else if ('[' == ch)
+			{
+				value.type = JsonValue::JT_Array;
+				++ pos_;
+				if (this->Expect(']'))
+				{
+					return true;
+				}
+				do
+				{
+					value.values.emplace_back();
+					if (!this->ParseValue(value.values.back()))
+					{
+						return false;
+					}
+				} while (this->Expect(','));
+				return this->Expect(']');
+			}
+			else if ('"' == ch)
+			{
+				value.type = JsonValue::JT_String;
+				return this->ParseString(value.str);
+			}
+			else if ('t' == ch)
+			{
+				value.type = JsonValue::JT_Bool;
+				value.boolean = true;
+				return this->ParseLiteral("true");
+			}
+			else if ('f' == ch)
+			{
+				value.type = JsonValue::JT_Bool;
+				value.boolean = false;
+				return this->ParseLiteral("false");
+			}
+			else if ('n' == ch)
+			{
+				value.type = JsonValue::JT_Null;
+				return this->ParseLiteral("null");
+			}
+			else
+			{
+				size_t const start = pos_;
+				while ((pos_ < text_.size()) && (strchr("+-.0123456789eE", text_[pos_]) != nullptr))
+				{
+					++ pos_;
+				}
+
+				std::istringstream iss(text_.substr(start, pos_ - start));
+				iss.imbue(std::locale::classic());
+				value.type = JsonValue::JT_Number;
+				iss >> value.number;
+				return (pos_ > start) && !iss.fail();
+			}
+		}
+
+	private:
+		std::string const & text_;
+		size_t pos_;
+	};
+
+	BenchmarkState RunSample(BenchmarkFunc const & func, uint64_t iterations)
+	{
+		BenchmarkState state(iterations);
+		func(state);
+		return state;
+	}
+}
+
+namespace KlayGE
+{
+	BenchmarkState::BenchmarkState(uint64_t iterations)
+		: iterations_(iterations), done_(0), elapsed_(-1), pause_start_(0), paused_(0), items_per_iteration_(0)
+	{
+	}
+
+	std::string& BenchmarkPackage()
+	{
+		static std::string package;
+		return package;
+	}
+
+	void RegisterBenchmark(std::string const & name, BenchmarkFunc const & func)
+	{
+		BOOST_ASSERT(Registry().find(name) == Registry().end());
+		Registry()[name] = func;
+	}
+
+	void KeepAliveAddress(void const * p)
+	{
+		static void const * volatile sink;
+		sink = p;
+		KFL_UNUSED(sink);
+	}
+
+	std::vector<std::string> BenchmarkNames()
+	{
+		std::vector<std::string> names;
+		for (auto const & entry : Registry())
+		{
+			names.push_back(entry.first);
+		}
+		return names;
+	}
+
+	std::vector<BenchmarkResult> RunBenchmarks(BenchmarkOptions const & options, std::ostream& log)
+	{
+		std::vector<BenchmarkResult> results;
+		for (auto const & entry : Registry())
+		{
+			if (!options.filter.empty() && (entry.first.find(options.filter) == std::string::npos))
+			{
+				continue;
+			}
+
+			BenchmarkResult result;
+			result.name = entry.first;
+			result.iterations = 0;
+			result.repetitions = 0;
+			result.median_ns = result.min_ns = result.mean_ns = result.stddev_ns = 0;
+			result.items_per_second = 0;
+
+			log << std::left << std::setw(48) << entry.first << std::flush;
+
+			// Grows the iteration count until a sample lasts min_sample_time. The calibration runs double as warm up.
+			uint64_t iterations = 1;
+			uint64_t items_per_iteration = 0;
+			for (;;)
+			{
+				BenchmarkState state = RunSample(entry.second, iterations);
+				if (!state.SkipReason().empty() || (state.Elapsed() < 0))
+				{
+					result.skip_reason = state.SkipReason().empty() ? "No timed loop" : state.SkipReason();
+					break;
+				}
+				items_per_iteration = state.ItemsPerIteration();
+
+				double const elapsed = state.Elapsed();
+				if ((elapsed >= options.min_sample_time) || (iterations >= MAX_ITERATIONS))
+				{
+					break;
+				}
+
+				double const scale = options.min_sample_time * 1.2 / std::max(elapsed, 1e-9);
+				uint64_t const next = static_cast<uint64_t>(iterations * std::min(scale, 10.0)) + 1;
+				iterations = std::min(std::max(next, iterations * 2), MAX_ITERATIONS);
+			}
+
+			if (!result.skip_reason.empty())
+			{
+				log << "skipped: " << result.skip_reason << std::endl;
+				results.push_back(result);
+				continue;
+			}
+
+			std::vector<double> samples;
+			for (uint32_t i = 0; i < options.repetitions; ++ i)
+			{
+				BenchmarkState state = RunSample(entry.second, iterations);
+				samples.push_back(state.Elapsed() * 1e9 / iterations);
+			}
+			std::sort(samples.begin(), samples.end());
+
+			double sum = 0;
+			for (double const s : samples)
+			{
+				sum += s;
+			}
+			double const mean = sum / samples.size();
+			double var = 0;
+			for (double const s : samples)
+			{
+				var += (s - mean) * (s - mean);
+			}
+
+			size_t const half = samples.size() / 2;
+			result.iterations = iterations;
+			result.repetitions = static_cast<uint32_t>(samples.size());
+			result.median_ns = (samples.size() & 1) ? samples[half] : (samples[half - 1] + samples[half]) / 2;
+			result.min_ns = samples.front();
+			result.mean_ns = mean;
+			result.stddev_ns = std::sqrt(var / samples.size());
+			if ((items_per_iteration > 0) && (result.median_ns > 0))
+			{
+				result.items_per_second = items_per_iteration * 1e9 / result.median_ns;
+			}
+
+			log << std::right << std::fixed << std::setprecision(1) << std::setw(14) << result.median_ns << " ns"
+				<< std::setw(8) << (result.median_ns > 0 ? result.stddev_ns * 100 / result.median_ns : 0.0) << "%";
+			if (result.items_per_second > 0)
+			{
+				log << std::setw(14) << result.items_per_second / 1e6 << " M items/s";
+			}
+			log << std::defaultfloat << std::setprecision(6) << std::endl;
+
+			results.push_back(result);
+		}
+
+		return results;
+	}
+
+	void WriteBenchmarkResults(std::string const & file_name, BenchmarkOptions const & options,
+		std::vector<BenchmarkResult> const & results)
+	{
+		std::ofstream ofs(file_name.c_str());
+		if (!ofs)
+		{
+			LogError("Could not open %s for writing.", file_name.c_str());
+			return;
+		}
+		ofs.imbue(std::locale::classic());
+		ofs << std::setprecision(9);
+
+		ofs << "{" << std::endl;
+		ofs << "\t\"context\": {" << std::endl;
+		ofs << "\t\t\"compiler\": \"" << COMPILER_NAME << KFL_STRINGIZE(KLAYGE_COMPILER_VERSION) "\"," << std::endl;
+#ifdef KLAYGE_DEBUG
+		ofs << "\t\t\"debug\": true," << std::endl;
+#else
+		ofs << "\t\t\"debug\": false," << std::endl;
+#endif
+		ofs << "\t\t\"hardware_threads\": " << std::thread::hardware_concurrency() << "," << std::endl;
+		ofs << "\t\t\"min_sample_time\": " << options.min_sample_time << "," << std::endl;
+		ofs << "\t\t\"repetitions\": " << options.repetitions << std::endl;
+		ofs << "\t}," << std::endl;
+
+		ofs << "\t\"benchmarks\": [" << std::endl;
+		for (size_t i = 0; i < results.size(); ++ i)
+		{
+			BenchmarkResult const & result = results[i];
+
+			ofs << "\t\t{ \"name\": ";
+			WriteJsonString(ofs, result.name);
+			if (result.skip_reason.empty())
+			{
+				ofs << ", \"iterations\": " << result.iterations
+					<< ", \"repetitions\": " << result.repetitions
+					<< ", \"median_ns\": " << result.median_ns
+					<< ", \"min_ns\": " << result.min_ns
+					<< ", \"mean_ns\": " << result.mean_ns
+					<< ", \"stddev_ns\": " << result.stddev_ns;
+				if (result.items_per_second > 0)
+				{
+					ofs << ", \"items_per_second\": " << result.items_per_second;
+				}
+			}
+			else
+			{
+				ofs << ", \"skipped\": ";
+				WriteJsonString(ofs, result.skip_reason);
+			}
+			ofs << " }" << ((i + 1 < results.size()) ? "," : "") << std::endl;
+		}
+		ofs << "\t]" << std::endl;
+		ofs << "}" << std::endl;
+	}
+
+	int CheckBenchmarkRegressions(std::string const & baseline_name, float default_threshold,
+		std::vector<BenchmarkResult> const & results, std::ostream& log)
+	{
+		std::ifstream ifs(baseline_name.c_str());
+		if (!ifs)
+		{
+			log << "Could not open the baseline " << baseline_name << "." << std::endl;
+			return -1;
+		}
+		std::string const text((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+
+		JsonValue root;
+		JsonParser parser(text);
+		JsonValue const * benchmarks = nullptr;
+		if (parser.Parse(root))
+		{
+			benchmarks = root.Member("benchmarks");
+		}
+		if ((nullptr == benchmarks) || (benchmarks->type != JsonValue::JT_Array))
+		{
+			log << "The baseline " << baseline_name << " is not a benchmark result file (near offset "
+				<< parser.Position() << ")." << std::endl;
+			return -1;
+		}
+
+		uint32_t num_regressions = 0;
+		uint32_t num_improvements = 0;
+		uint32_t num_compared = 0;
+		for (auto const & result : results)
+		{
+			if (!result.skip_reason.empty())
+			{
+				continue;
+			}
+
+			JsonValue const * base = nullptr;
+			for (auto const & entry : benchmarks->values)
+			{
+				JsonValue const * name = entry.Member("name");
+				if (name && (name->str == result.name))
+				{
+					base = &entry;
+					break;
+				}
+			}
+			JsonValue const * base_median = base ? base->Member("median_ns") : nullptr;
+			if ((nullptr == base_median) || (base_median->type != JsonValue::JT_Number) || (base_median->number <= 0))
+			{
+				log << "NEW         " << result.name << std::endl;
+				continue;
+			}
+
+			float threshold = default_threshold;
+			JsonValue const * base_threshold = base->Member("threshold");
+			if (base_threshold && (JsonValue::JT_Number == base_threshold->type))
+			{
+				threshold = static_cast<float>(base_threshold->number);
+			}
+
+			++ num_compared;
+			double const ratio = result.median_ns / base_median->number;
+			char const * tag;
+			if (ratio > 1 + threshold)
+			{
+				++ num_regressions;
+				tag = "REGRESSION  ";
+			}
+			else if (ratio < 1 / (1 + threshold))
+			{
+				++ num_improvements;
+				tag = "IMPROVEMENT ";
+			}
+			else
+			{
+				tag = nullptr;
+			}
+
+			if (tag)
+			{
+				log << tag << result.name << std::fixed << std::setprecision(1) << ": " << base_median->number
+					<< " ns -> " << result.median_ns << " ns (" << std::showpos << (ratio - 1) * 100 << std::noshowpos
+					<< "%, threshold " << threshold * 100 << "%)" << std::defaultfloat << std::setprecision(6)
+					<< std::endl;
+			}
+		}
+
+		log << num_compared << " compared with " << baseline_name << ", " << num_regressions << " regressed, "
+			<< num_improvements << " improved." << std::endl;
+
+		return static_cast<int>(num_regressions);
+	}
+}
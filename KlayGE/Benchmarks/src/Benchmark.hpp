@@ -0,0 +1,162 @@
+#ifndef _KLAYGE_BENCHMARK_HPP
+#define _KLAYGE_BENCHMARK_HPP
+
+#pragma once
+
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Timer.hpp>
+
+#include <functional>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+namespace KlayGE
+{
+	// Handed to a benchmark function once per sample. The function does its setup, then loops while KeepRunning()
+	//  returns true. Only the loop is timed, minus the time between PauseTiming() and ResumeTiming().
+	class BenchmarkState
+	{
+	public:
+		explicit BenchmarkState(uint64_t iterations);
+
+		bool KeepRunning()
+		{
+			if (done_ < iterations_)
+			{
+				if (0 == done_)
+				{
+					timer_.restart();
+				}
+				++ done_;
+				return true;
+			}
+			else
+			{
+				if (elapsed_ < 0)
+				{
+					elapsed_ = timer_.elapsed() - paused_;
+				}
+				return false;
+			}
+		}
+
+		void PauseTiming()
+		{
+			pause_start_ = timer_.elapsed();
+		}
+		void ResumeTiming()
+		{
+			paused_ += timer_.elapsed() - pause_start_;
+		}
+
+		uint64_t Iterations() const
+		{
+			return iterations_;
+		}
+		// Seconds spent in the timed loop.
+		double Elapsed() const
+		{
+			return elapsed_;
+		}
+
+		// Items handled by one iteration, for the throughput in the report. Texels, objects, particles...
+		void ItemsPerIteration(uint64_t items)
+		{
+			items_per_iteration_ = items;
+		}
+		uint64_t ItemsPerIteration() const
+		{
+			return items_per_iteration_;
+		}
+
+		// Marks the benchmark as skipped, usually because its media is missing. Return without looping after this.
+		void Skip(std::string const & reason)
+		{
+			skip_reason_ = reason;
+		}
+		std::string const & SkipReason() const
+		{
+			return skip_reason_;
+		}
+
+	private:
+		uint64_t iterations_;
+		uint64_t done_;
+		Timer timer_;
+		double elapsed_;
+		double pause_start_;
+		double paused_;
+		uint64_t items_per_iteration_;
+		std::string skip_reason_;
+	};
+
+	typedef std::function<void(BenchmarkState&)> BenchmarkFunc;
+
+	// Names are paths like "Math/float4x4_mul" or "Culling/Frustum/10000", so a filter can pick a group.
+	void RegisterBenchmark(std::string const & name, BenchmarkFunc const & func);
+
+	struct BenchmarkRegistrar
+	{
+		BenchmarkRegistrar(std::string const & name, BenchmarkFunc const & func)
+		{
+			RegisterBenchmark(name, func);
+		}
+	};
+
+#define KLAYGE_BENCHMARK(group, name) \
+	static void KlayGEBenchmark_##group##_##name(KlayGE::BenchmarkState& state); \
+	static KlayGE::BenchmarkRegistrar klayge_benchmark_registrar_##group##_##name(#group "/" #name, \
+		KlayGEBenchmark_##group##_##name); \
+	static void KlayGEBenchmark_##group##_##name(KlayGE::BenchmarkState& state)
+
+	// A 7z package given on the command line, for the loading benchmarks. Empty if there is none.
+	std::string& BenchmarkPackage();
+
+	// Keeps the compiler from dropping a computation whose result is never used. The address escapes to a function
+	//  out of sight, so the value has to be in memory when it's called.
+	void KeepAliveAddress(void const * p);
+
+	template <typename T>
+	inline void KeepAlive(T const & value)
+	{
+		KeepAliveAddress(&value);
+	}
+
+	struct BenchmarkOptions
+	{
+		// Runs the benchmarks whose name contains this. Empty runs all.
+		std::string filter;
+		// Each sample loops for at least this long.
+		double min_sample_time;
+		uint32_t repetitions;
+	};
+
+	struct BenchmarkResult
+	{
+		std::string name;
+		std::string skip_reason;
+
+		uint64_t iterations;
+		uint32_t repetitions;
+		double median_ns;
+		double min_ns;
+		double mean_ns;
+		double stddev_ns;
+		double items_per_second;
+	};
+
+	std::vector<std::string> BenchmarkNames();
+	std::vector<BenchmarkResult> RunBenchmarks(BenchmarkOptions const & options, std::ostream& log);
+
+	void WriteBenchmarkResults(std::string const & file_name, BenchmarkOptions const & options,
+		std::vector<BenchmarkResult> const & results);
+
+	// Compares the medians with a file written by WriteBenchmarkResults. A benchmark regresses when its median is
+	//  more than (1 + threshold) times the baseline. An entry in the baseline can have its own "threshold". Returns
+	//  the number of regressions, or -1 if the baseline can't be read.
+	int CheckBenchmarkRegressions(std::string const & baseline_name, float default_threshold,
+		std::vector<BenchmarkResult> const & results, std::ostream& log);
+}
+
+#endif		// _KLAYGE_BENCHMARK_HPP
@@ -0,0 +1,161 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KlayGE/Camera.hpp>
+#include <KlayGE/Context.hpp>
+#include <KlayGE/FrameBuffer.hpp>
+#include <KlayGE/OcclusionBuffer.hpp>
+#include <KlayGE/RenderableHelper.hpp>
+#include <KlayGE/RenderEngine.hpp>
+#include <KlayGE/RenderFactory.hpp>
+#include <KlayGE/SceneManager.hpp>
+#include <KlayGE/SceneObjectHelper.hpp>
+#include <KlayGE/Viewport.hpp>
+#include <KFL/Math.hpp>
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Benchmark.hpp"
+
+using namespace std;
+using namespace KlayGE;
+
+namespace
+{
+	uint32_t const OBJECT_COUNTS[] = { 1000, 10000, 100000 };
+	uint32_t const NUM_OCCLUDERS = 64;
+	// The small object threshold DeferredRenderingLayer sets for shadow map passes.
+	float const SMALL_OBJ_THRESHOLD = 0.002f;
+
+	float3 const EYE_POS(0, 20, -1000);
+	float3 const LOOK_AT(0, 0, 0);
+
+	// Nothing to draw, only a bound for the scene manager to test
+	class RenderableBox : public RenderableHelper
+	{
+	public:
+		explicit RenderableBox(AABBox const & box)
+			: RenderableHelper(L"Box")
+		{
+			pos_aabb_ = box;
+		}
+	};
+
+	// A city-like layout, small objects spread over a 2km square with a row of large blocks in front of the camera.
+	std::vector<AABBox> CullingObjects(uint32_t num_objects)
+	{
+		std::vector<AABBox> ret;
+
+		std::ranlux24_base gen(num_objects);
+		std::uniform_real_distribution<float> pos_dis(-1000, 1000);
+		std::uniform_real_distribution<float> size_dis(0.5f, 10);
+		for (uint32_t i = 0; i < num_objects; ++ i)
+		{
+			float3 const pos(pos_dis(gen), 0, pos_dis(gen));
+			float3 const size(size_dis(gen), size_dis(gen), size_dis(gen));
+			ret.emplace_back(pos, pos + size);
+		}
+
+		return ret;
+	}
+
+	std::vector<AABBox> CullingOccluders()
+	{
+		std::vector<AABBox> ret;
+		for (uint32_t i = 0; i < NUM_OCCLUDERS; ++ i)
+		{
+			float const x = (i % 16) * 60.0f - 480;
+			float const z = (i / 16) * 80.0f - 700;
+			ret.emplace_back(float3(x, 0, z), float3(x + 50, 40 + (i % 3) * 20.0f, z + 30));
+		}
+		return ret;
+	}
+
+	// Times SceneManager::ClipScene of the scene manager in KlayGE.cfg on the culling layout. There is no
+	//  application, so the camera is bound to the viewport of the null render window, where ClipScene reads it.
+	void ClipSceneBenchmark(BenchmarkState& state, uint32_t num_objects, bool occlusion)
+	{
+		RenderEngine& re = Context::Instance().RenderFactoryInstance().RenderEngineInstance();
+		CameraPtr const camera = MakeSharedPtr<Camera>();
+		camera->ViewParams(EYE_POS, LOOK_AT);
+		camera->ProjParams(PI / 4, 16.0f / 9, 1.0f, 3000.0f);
+		CameraPtr const old_camera = re.CurFrameBuffer()->GetViewport()->camera;
+		re.CurFrameBuffer()->GetViewport()->camera = camera;
+
+		SceneManager& sm = Context::Instance().SceneManagerInstance();
+		sm.ClearObject();
+		for (auto const & box : CullingObjects(num_objects))
+		{
+			sm.AddSceneObject(MakeSharedPtr<SceneObjectHelper>(MakeSharedPtr<RenderableBox>(box),
+				SceneObject::SOA_Cullable));
+		}
+		if (occlusion)
+		{
+			for (auto const & box : CullingOccluders())
+			{
+				sm.AddSceneObject(MakeSharedPtr<SceneObjectHelper>(MakeSharedPtr<RenderableBox>(box),
+					SceneObject::SOA_Cullable | SceneObject::SOA_Occluder));
+			}
+		}
+		sm.SmallObjectThreshold(SMALL_OBJ_THRESHOLD);
+		sm.OcclusionCulling(occlusion);
+
+		// Builds the scene manager's own structures, like the OCTree, outside of the timed loop
+		sm.ClipScene();
+
+		state.ItemsPerIteration(sm.NumSceneObjects());
+		while (state.KeepRunning())
+		{
+			sm.ClipScene();
+		}
+
+		sm.OcclusionCulling(false);
+		sm.SmallObjectThreshold(0);
+		sm.ClearObject();
+
+		re.CurFrameBuffer()->GetViewport()->camera = old_camera;
+	}
+
+	struct CullingBenchmarks
+	{
+		CullingBenchmarks()
+		{
+			for (uint32_t const num_objects : OBJECT_COUNTS)
+			{
+				std::string const suffix = "/" + std::to_string(num_objects);
+				RegisterBenchmark("Culling/Frustum" + suffix,
+					[num_objects](BenchmarkState& state)
+					{
+						ClipSceneBenchmark(state, num_objects, false);
+					});
+				RegisterBenchmark("Culling/FrustumOcclusion" + suffix,
+					[num_objects](BenchmarkState& state)
+					{
+						ClipSceneBenchmark(state, num_objects, true);
+					});
+			}
+
+			RegisterBenchmark("Culling/OcclusionRasterize",
+				[](BenchmarkState& state)
+				{
+					float4x4 const view_proj = MathLib::look_at_lh(EYE_POS, LOOK_AT)
+						* MathLib::perspective_fov_lh(PI / 4, 16.0f / 9, 1.0f, 3000.0f);
+					std::vector<AABBox> const occluders = CullingOccluders();
+					OcclusionBuffer occlusion_buffer(256, 128);
+					float4x4 const identity = float4x4::Identity();
+
+					state.ItemsPerIteration(NUM_OCCLUDERS);
+					while (state.KeepRunning())
+					{
+						occlusion_buffer.BeginFrame(view_proj);
+						for (auto const & box : occluders)
+						{
+							occlusion_buffer.AddOccluder(box, identity);
+						}
+						occlusion_buffer.Rasterize();
+						KeepAlive(occlusion_buffer.Depth()[0]);
+					}
+				});
+		}
+	} culling_benchmarks;
+}
@@ -0,0 +1,145 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KlayGE/Context.hpp>
+#include <KlayGE/RenderEngine.hpp>
+#include <KlayGE/RenderFactory.hpp>
+#include <KlayGE/ResLoader.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "Benchmark.hpp"
+
+using namespace std;
+using namespace KlayGE;
+
+namespace
+{
+	void PrintUsage()
+	{
+		cout << "Usage: Benchmarks [options]" << endl
+			<< "  --list                Prints the benchmark names and quits." << endl
+			<< "  --filter <text>       Runs only the benchmarks whose name contains <text>." << endl
+			<< "  --output <file>       Writes the results as JSON. Default is KlayGEBenchmarks.json." << endl
+			<< "  --baseline <file>     Compares with the results of an earlier run, and fails on regressions." << endl
+			<< "  --threshold <ratio>   Allowed slow down before failing. Default is 0.1 for 10%." << endl
+			<< "  --min-time <seconds>  Minimum length of a sample. Default is 0.05." << endl
+			<< "  --repetitions <n>     Samples per benchmark, the median is reported. Default is 7." << endl
+			<< "  --package <file.7z>   Also loads the benchmark textures from the root of this package." << endl
+			<< "Returns 1 if a benchmark regressed, 2 on bad arguments or an unreadable baseline." << endl;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	BenchmarkOptions options;
+	options.min_sample_time = 0.05;
+	options.repetitions = 7;
+	std::string output_name = "KlayGEBenchmarks.json";
+	std::string baseline_name;
+	float threshold = 0.1f;
+	bool list_only = false;
+
+	for (int i = 1; i < argc; ++ i)
+	{
+		std::string const arg = argv[i];
+		bool const has_value = (i + 1 < argc);
+		if ("--list" == arg)
+		{
+			list_only = true;
+		}
+		else if (("--filter" == arg) && has_value)
+		{
+			options.filter = argv[++ i];
+		}
+		else if (("--output" == arg) && has_value)
+		{
+			output_name = argv[++ i];
+		}
+		else if (("--baseline" == arg) && has_value)
+		{
+			baseline_name = argv[++ i];
+		}
+		else if (("--threshold" == arg) && has_value)
+		{
+			threshold = static_cast<float>(atof(argv[++ i]));
+		}
+		else if (("--min-time" == arg) && has_value)
+		{
+			options.min_sample_time = atof(argv[++ i]);
+		}
+		else if (("--repetitions" == arg) && has_value)
+		{
+			options.repetitions = std::max(atoi(argv[++ i]), 1);
+		}
+		else if (("--package" == arg) && has_value)
+		{
+			BenchmarkPackage() = argv[++ i];
+		}
+		else
+		{
+			PrintUsage();
+			return 2;
+		}
+	}
+
+	if (list_only)
+	{
+		for (auto const & name : BenchmarkNames())
+		{
+			cout << name << endl;
+		}
+		return 0;
+	}
+
+#ifdef KLAYGE_DEBUG
+	cout << "Warning: this is a debug build, the numbers are not comparable with release builds." << endl;
+#endif
+
+	ResLoader::Instance().AddPath("../../Tests/media");
+
+	// Everything runs on the null render engine without an application or a native window, so the numbers don't
+	//  depend on a GPU or a display, and the suite runs on build machines. The scene manager is the one in KlayGE.cfg,
+	//  without deferred rendering.
+	Context::Instance().LoadCfg("KlayGE.cfg");
+	ContextCfg cfg = Context::Instance().Config();
+	cfg.render_factory_name = "Null";
+	cfg.deferred_rendering = false;
+	cfg.graphics_cfg.hide_win = true;
+	cfg.graphics_cfg.full_screen = false;
+	cfg.graphics_cfg.width = 1280;
+	cfg.graphics_cfg.height = 720;
+	Context::Instance().Config(cfg);
+
+	RenderEngine& re = Context::Instance().RenderFactoryInstance().RenderEngineInstance();
+	re.CreateRenderWindow("KlayGEBenchmarks", cfg.graphics_cfg);
+
+	int ret = 0;
+	{
+		std::vector<BenchmarkResult> const results = RunBenchmarks(options, cout);
+
+		if (!output_name.empty())
+		{
+			WriteBenchmarkResults(output_name, options, results);
+		}
+
+		if (!baseline_name.empty())
+		{
+			int const num_regressions = CheckBenchmarkRegressions(baseline_name, threshold, results, cout);
+			if (num_regressions < 0)
+			{
+				ret = 2;
+			}
+			else if (num_regressions > 0)
+			{
+				ret = 1;
+			}
+		}
+	}
+
+	re.DestroyRenderWindow();
+	Context::Destroy();
+
+	return ret;
+}
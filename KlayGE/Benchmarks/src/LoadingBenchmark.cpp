@@ -0,0 +1,175 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KlayGE/Mesh.hpp>
+#include <KlayGE/RenderEffect.hpp>
+#include <KlayGE/ResLoader.hpp>
+#include <KlayGE/Texture.hpp>
+#include <KFL/ResIdentifier.hpp>
+
+#include <string>
+#include <vector>
+
+#include "Benchmark.hpp"
+
+using namespace std;
+using namespace KlayGE;
+
+namespace
+{
+	// Engine media, downloaded with the core. The loaded resource is released after each iteration, so every
+	//  iteration goes through the whole loading path instead of hitting the ResLoader cache.
+	char const * const TEXTURE_NAMES[] =
+	{
+		"klayge_logo.dds",
+		"noise_simplex.dds",
+		"color_grading.dds",
+		"uffizi_cross_filtered_c.dds"
+	};
+	char const * const MODEL_NAMES[] =
+	{
+		"point_light_proxy.meshml",
+		"camera_proxy.meshml"
+	};
+	char const * const EFFECT_NAMES[] =
+	{
+		"Copy.fxml",
+		"UI.fxml",
+		"GBuffer.fxml"
+	};
+
+	uint32_t const ACCESS_HINT = EAH_GPU_Read | EAH_Immutable;
+
+	// Names inside the package given by --package are looked up as "<package file>//<name>". Only textures and
+	//  raw reads are done from packages. Effects and models pull in other files by plain names, which a package on
+	//  its own can't resolve.
+	std::string PackagedName(std::string const & name)
+	{
+		std::string const & package = BenchmarkPackage();
+		if (package.empty())
+		{
+			return "";
+		}
+
+		static bool path_added = false;
+		std::string::size_type const slash = package.find_last_of("/\\");
+		if (!path_added)
+		{
+			ResLoader::Instance().AddPath((slash == std::string::npos) ? "" : package.substr(0, slash));
+			path_added = true;
+		}
+
+		std::string const packaged_name = package.substr((slash == std::string::npos) ? 0 : slash + 1) + "//" + name;
+		return ResLoader::Instance().Locate(packaged_name).empty() ? "" : packaged_name;
+	}
+
+	bool CheckResource(BenchmarkState& state, std::string const & name, std::string const & readable_name)
+	{
+		if (name.empty() || ResLoader::Instance().Locate(name).empty())
+		{
+			state.Skip(readable_name + " is not found");
+			return false;
+		}
+		return true;
+	}
+
+	void LoadTextureBenchmark(BenchmarkState& state, std::string const & name, std::string const & readable_name)
+	{
+		if (!CheckResource(state, name, readable_name))
+		{
+			return;
+		}
+
+		while (state.KeepRunning())
+		{
+			TexturePtr tex = SyncLoadTexture(name, ACCESS_HINT);
+			KeepAlive(tex);
+		}
+	}
+
+	void ReadFileBenchmark(BenchmarkState& state, std::string const & name, std::string const & readable_name)
+	{
+		if (!CheckResource(state, name, readable_name))
+		{
+			return;
+		}
+
+		std::vector<char> buf;
+		while (state.KeepRunning())
+		{
+			ResIdentifierPtr res = ResLoader::Instance().Open(name);
+			res->seekg(0, std::ios_base::end);
+			buf.resize(static_cast<size_t>(res->tellg()) + 1);
+			res->seekg(0, std::ios_base::beg);
+			res->read(&buf[0], buf.size() - 1);
+			KeepAlive(buf[0]);
+		}
+	}
+
+	struct LoadingBenchmarks
+	{
+		LoadingBenchmarks()
+		{
+			for (char const * name : TEXTURE_NAMES)
+			{
+				std::string const tex_name = name;
+				RegisterBenchmark("Load/Disk/Texture/" + tex_name,
+					[tex_name](BenchmarkState& state)
+					{
+						LoadTextureBenchmark(state, tex_name, tex_name);
+					});
+				RegisterBenchmark("Load/Disk/Read/" + tex_name,
+					[tex_name](BenchmarkState& state)
+					{
+						ReadFileBenchmark(state, tex_name, tex_name);
+					});
+				RegisterBenchmark("Load/Package/Texture/" + tex_name,
+					[tex_name](BenchmarkState& state)
+					{
+						LoadTextureBenchmark(state, PackagedName(tex_name), tex_name + " in the package");
+					});
+				RegisterBenchmark("Load/Package/Read/" + tex_name,
+					[tex_name](BenchmarkState& state)
+					{
+						ReadFileBenchmark(state, PackagedName(tex_name), tex_name + " in the package");
+					});
+			}
+
+			for (char const * name : MODEL_NAMES)
+			{
+				std::string const model_name = name;
+				RegisterBenchmark("Load/Disk/Model/" + model_name,
+					[model_name](BenchmarkState& state)
+					{
+						if (!CheckResource(state, model_name, model_name))
+						{
+							return;
+						}
+
+						while (state.KeepRunning())
+						{
+							RenderModelPtr model = SyncLoadModel(model_name, ACCESS_HINT);
+							KeepAlive(model);
+						}
+					});
+			}
+
+			for (char const * name : EFFECT_NAMES)
+			{
+				std::string const effect_name = name;
+				RegisterBenchmark("Load/Disk/Effect/" + effect_name,
+					[effect_name](BenchmarkState& state)
+					{
+						if (!CheckResource(state, effect_name, effect_name))
+						{
+							return;
+						}
+
+						while (state.KeepRunning())
+						{
+							RenderEffectPtr effect = SyncLoadRenderEffect(effect_name);
+							KeepAlive(effect);
+						}
+					});
+			}
+		}
+	} loading_benchmarks;
+}
@@ -0,0 +1,397 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/AlignedAllocator.hpp>
+#include <KFL/Math.hpp>
+#include <KFL/SIMDMath.hpp>
+#include <KFL/Noise.hpp>
+
+#include <random>
+#include <vector>
+
+#include "Benchmark.hpp"
+
+using namespace std;
+using namespace KlayGE;
+
+namespace
+{
+	uint32_t const NUM_ELEMENTS = 4096;
+
+	// The same pseudo-random inputs on every run and every machine.
+	std::vector<float> const & RandomFloats()
+	{
+		static std::vector<float> floats;
+		if (floats.empty())
+		{
+			std::ranlux24_base gen(0x4B4C4745);
+			std::uniform_real_distribution<float> dis(-1, 1);
+			floats.resize(NUM_ELEMENTS * 16);
+			for (auto& f : floats)
+			{
+				f = dis(gen);
+			}
+		}
+		return floats;
+	}
+
+	std::vector<float4x4> const & RandomMatrices()
+	{
+		static std::vector<float4x4> mats;
+		if (mats.empty())
+		{
+			std::vector<float> const & floats = RandomFloats();
+			for (uint32_t i = 0; i < NUM_ELEMENTS; ++ i)
+			{
+				float const * f = &floats[i * 16];
+				mats.push_back(MathLib::scaling(1 + f[0] * 0.5f, 1 + f[1] * 0.5f, 1 + f[2] * 0.5f)
+					* MathLib::to_matrix(MathLib::normalize(Quaternion(f[3], f[4], f[5], f[6] + 2)))
+					* MathLib::translation(f[7] * 100, f[8] * 100, f[9] * 100));
+			}
+		}
+		return mats;
+	}
+
+	std::vector<float3> const & RandomPoints()
+	{
+		static std::vector<float3> points;
+		if (points.empty())
+		{
+			std::vector<float> const & floats = RandomFloats();
+			for (uint32_t i = 0; i < NUM_ELEMENTS; ++ i)
+			{
+				points.emplace_back(floats[i * 3 + 0] * 100, floats[i * 3 + 1] * 100, floats[i * 3 + 2] * 100);
+			}
+		}
+		return points;
+	}
+
+	std::vector<Quaternion> const & RandomQuaternions()
+	{
+		static std::vector<Quaternion> quats;
+		if (quats.empty())
+		{
+			std::vector<float> const & floats = RandomFloats();
+			for (uint32_t i = 0; i < NUM_ELEMENTS; ++ i)
+			{
+				quats.push_back(MathLib::normalize(Quaternion(floats[i * 4 + 0], floats[i * 4 + 1],
+					floats[i * 4 + 2], floats[i * 4 + 3] + 2)));
+			}
+		}
+		return quats;
+	}
+}
+
+KLAYGE_BENCHMARK(Math, float4x4_mul)
+{
+	std::vector<float4x4> const & mats = RandomMatrices();
+	std::vector<float4x4> results(mats.size());
+
+	state.ItemsPerIteration(mats.size());
+	while (state.KeepRunning())
+	{
+		for (size_t i = 0; i < mats.size(); ++ i)
+		{
+			results[i] = mats[i] * mats[(i + 1) % mats.size()];
+		}
+		KeepAlive(results[0]);
+	}
+}
+
+KLAYGE_BENCHMARK(Math, float4x4_inverse)
+{
+	std::vector<float4x4> const & mats = RandomMatrices();
+	std::vector<float4x4> results(mats.size());
+
+	state.ItemsPerIteration(mats.size());
+	while (state.KeepRunning())
+	{
+		for (size_t i = 0; i < mats.size(); ++ i)
+		{
+			results[i] = MathLib::inverse(mats[i]);
+		}
+		KeepAlive(results[0]);
+	}
+}
+
+KLAYGE_BENCHMARK(Math, transform_coord)
+{
+	std::vector<float3> const & points = RandomPoints();
+	float4x4 const & mat = RandomMatrices()[0];
+	std::vector<float3> results(points.size());
+
+	state.ItemsPerIteration(points.size());
+	while (state.KeepRunning())
+	{
+		for (size_t i = 0; i < points.size(); ++ i)
+		{
+			results[i] = MathLib::transform_coord(points[i], mat);
+		}
+		KeepAlive(results[0]);
+	}
+}
+
+KLAYGE_BENCHMARK(Math, transform_aabb)
+{
+	std::vector<float3> const & points = RandomPoints();
+	std::vector<float4x4> const & mats = RandomMatrices();
+	std::vector<AABBox> results(points.size());
+
+	state.ItemsPerIteration(points.size());
+	while (state.KeepRunning())
+	{
+		for (size_t i = 0; i < points.size(); ++ i)
+		{
+			AABBox const box(points[i], points[i] + float3(1, 2, 3));
+			results[i] = MathLib::transform_aabb(box, mats[i]);
+		}
+		KeepAlive(results[0]);
+	}
+}
+
+KLAYGE_BENCHMARK(Math, quaternion_slerp)
+{
+	std::vector<Quaternion> const & quats = RandomQuaternions();
+	std::vector<Quaternion> results(quats.size());
+
+	state.ItemsPerIteration(quats.size());
+	while (state.KeepRunning())
+	{
+		for (size_t i = 0; i < quats.size(); ++ i)
+		{
+			results[i] = MathLib::slerp(quats[i], quats[(i + 1) % quats.size()], 0.3f);
+		}
+		KeepAlive(results[0]);
+	}
+}
+
+KLAYGE_BENCHMARK(Math, decompose)
+{
+	std::vector<float4x4> const & mats = RandomMatrices();
+	std::vector<Quaternion> results(mats.size());
+
+	state.ItemsPerIteration(mats.size());
+	while (state.KeepRunning())
+	{
+		for (size_t i = 0; i < mats.size(); ++ i)
+		{
+			float3 scale;
+			float3 trans;
+			MathLib::decompose(scale, results[i], trans, mats[i]);
+		}
+		KeepAlive(results[0]);
+	}
+}
+
+KLAYGE_BENCHMARK(Math, dual_quaternion_mul)
+{
+	std::vector<Quaternion> const & quats = RandomQuaternions();
+	std::vector<Quaternion> real_results(quats.size());
+	std::vector<Quaternion> dual_results(quats.size());
+
+	state.ItemsPerIteration(quats.size());
+	while (state.KeepRunning())
+	{
+		for (size_t i = 0; i < quats.size(); ++ i)
+		{
+			Quaternion const & lhs_real = quats[i];
+			Quaternion const & rhs_real = quats[(i + 1) % quats.size()];
+			Quaternion const & dual = quats[(i + 2) % quats.size()];
+			real_results[i] = MathLib::mul_real(lhs_real, rhs_real);
+			dual_results[i] = MathLib::mul_dual(lhs_real, dual, rhs_real, dual);
+		}
+		KeepAlive(real_results[0]);
+		KeepAlive(dual_results[0]);
+	}
+}
+
+KLAYGE_BENCHMARK(SIMDMath, Multiply)
+{
+	std::vector<float4x4> const & mats = RandomMatrices();
+	std::vector<SIMDMatrixF4, aligned_allocator<SIMDMatrixF4, 16>> simd_mats;
+	for (auto const & mat : mats)
+	{
+		simd_mats.emplace_back(&mat[0]);
+	}
+	std::vector<SIMDMatrixF4, aligned_allocator<SIMDMatrixF4, 16>> results(simd_mats.size());
+
+	state.ItemsPerIteration(simd_mats.size());
+	while (state.KeepRunning())
+	{
+		for (size_t i = 0; i < simd_mats.size(); ++ i)
+		{
+			results[i] = SIMDMathLib::Multiply(simd_mats[i], simd_mats[(i + 1) % simd_mats.size()]);
+		}
+		KeepAlive(results[0]);
+	}
+}
+
+KLAYGE_BENCHMARK(SIMDMath, Inverse)
+{
+	std::vector<float4x4> const & mats = RandomMatrices();
+	std::vector<SIMDMatrixF4, aligned_allocator<SIMDMatrixF4, 16>> simd_mats;
+	for (auto const & mat : mats)
+	{
+		simd_mats.emplace_back(&mat[0]);
+	}
+	std::vector<SIMDMatrixF4, aligned_allocator<SIMDMatrixF4, 16>> results(simd_mats.size());
+
+	state.ItemsPerIteration(simd_mats.size());
+	while (state.KeepRunning())
+	{
+		for (size_t i = 0; i < simd_mats.size(); ++ i)
+		{
+			results[i] = SIMDMathLib::Inverse(simd_mats[i]);
+		}
+		KeepAlive(results[0]);
+	}
+}
+
+KLAYGE_BENCHMARK(SIMDMath, TransformCoordVector3)
+{
+	std::vector<float3> const & points = RandomPoints();
+	std::vector<SIMDVectorF4, aligned_allocator<SIMDVectorF4, 16>> simd_points;
+	for (auto const & pt : points)
+	{
+		simd_points.push_back(SIMDMathLib::LoadVector3(pt));
+	}
+	SIMDMatrixF4 const mat(&RandomMatrices()[0][0]);
+	std::vector<SIMDVectorF4, aligned_allocator<SIMDVectorF4, 16>> results(simd_points.size());
+
+	state.ItemsPerIteration(simd_points.size());
+	while (state.KeepRunning())
+	{
+		for (size_t i = 0; i < simd_points.size(); ++ i)
+		{
+			results[i] = SIMDMathLib::TransformCoordVector3(simd_points[i], mat);
+		}
+		KeepAlive(results[0]);
+	}
+}
+
+KLAYGE_BENCHMARK(SIMDMath, NormalizeVector3)
+{
+	std::vector<float3> const & points = RandomPoints();
+	std::vector<SIMDVectorF4, aligned_allocator<SIMDVectorF4, 16>> simd_points;
+	for (auto const & pt : points)
+	{
+		simd_points.push_back(SIMDMathLib::LoadVector3(pt));
+	}
+	std::vector<SIMDVectorF4, aligned_allocator<SIMDVectorF4, 16>> results(simd_points.size());
+
+	state.ItemsPerIteration(simd_points.size());
+	while (state.KeepRunning())
+	{
+		for (size_t i = 0; i < simd_points.size(); ++ i)
+		{
+			results[i] = SIMDMathLib::NormalizeVector3(simd_points[i]);
+		}
+		KeepAlive(results[0]);
+	}
+}
+
+KLAYGE_BENCHMARK(SIMDMath, MultiplyBatch)
+{
+	std::vector<float4x4> const & mats = RandomMatrices();
+	std::vector<float4x4> results(mats.size());
+
+	state.ItemsPerIteration(mats.size());
+	while (state.KeepRunning())
+	{
+		SIMDMathLib::MultiplyBatch(&results[0], &mats[0], mats.size(), mats[1]);
+		KeepAlive(results[0]);
+	}
+}
+
+KLAYGE_BENCHMARK(SIMDMath, TransformCoordBatch)
+{
+	std::vector<float> const & floats = RandomFloats();
+	float const * x = &floats[0];
+	float const * y = &floats[NUM_ELEMENTS];
+	float const * z = &floats[NUM_ELEMENTS * 2];
+	float4x4 const & mat = RandomMatrices()[0];
+	std::vector<float> results(NUM_ELEMENTS * 3);
+
+	state.ItemsPerIteration(NUM_ELEMENTS);
+	while (state.KeepRunning())
+	{
+		SIMDMathLib::TransformCoordBatch(&results[0], &results[NUM_ELEMENTS], &results[NUM_ELEMENTS * 2],
+			x, y, z, NUM_ELEMENTS, mat);
+		KeepAlive(results[0]);
+	}
+}
+
+KLAYGE_BENCHMARK(SIMDMath, TransformDepthBatch)
+{
+	std::vector<float> const & floats = RandomFloats();
+	float const * x = &floats[0];
+	float const * y = &floats[NUM_ELEMENTS];
+	float const * z = &floats[NUM_ELEMENTS * 2];
+	float4x4 const & mat = RandomMatrices()[0];
+	std::vector<float> results(NUM_ELEMENTS);
+
+	state.ItemsPerIteration(NUM_ELEMENTS);
+	while (state.KeepRunning())
+	{
+		SIMDMathLib::TransformDepthBatch(&results[0], x, y, z, NUM_ELEMENTS, mat);
+		KeepAlive(results[0]);
+	}
+}
+
+KLAYGE_BENCHMARK(SIMDMath, TransformAABBBatch)
+{
+	std::vector<float3> const & points = RandomPoints();
+	std::vector<AABBox> boxes;
+	for (auto const & pt : points)
+	{
+		boxes.emplace_back(pt, pt + float3(1, 2, 3));
+	}
+	float4x4 const & mat = RandomMatrices()[0];
+	std::vector<AABBox> results(boxes.size());
+
+	state.ItemsPerIteration(boxes.size());
+	while (state.KeepRunning())
+	{
+		SIMDMathLib::TransformAABBBatch(&results[0], &boxes[0], boxes.size(), mat);
+		KeepAlive(results[0]);
+	}
+}
+
+KLAYGE_BENCHMARK(Noise, simplex_3d)
+{
+	std::vector<float> const & floats = RandomFloats();
+	float const * x = &floats[0];
+	float const * y = &floats[NUM_ELEMENTS];
+	float const * z = &floats[NUM_ELEMENTS * 2];
+	std::vector<float> results(NUM_ELEMENTS);
+
+	state.ItemsPerIteration(NUM_ELEMENTS);
+	while (state.KeepRunning())
+	{
+		for (uint32_t i = 0; i < NUM_ELEMENTS; ++ i)
+		{
+			results[i] = MathLib::SimplexNoise<float>::Instance().noise(x[i] * 8, y[i] * 8, z[i] * 8);
+		}
+		KeepAlive(results[0]);
+	}
+}
+
+KLAYGE_BENCHMARK(Noise, simplex_3d_batch)
+{
+	std::vector<float> const & floats = RandomFloats();
+	std::vector<float> x(NUM_ELEMENTS);
+	std::vector<float> y(NUM_ELEMENTS);
+	std::vector<float> z(NUM_ELEMENTS);
+	for (uint32_t i = 0; i < NUM_ELEMENTS; ++ i)
+	{
+		x[i] = floats[i] * 8;
+		y[i] = floats[NUM_ELEMENTS + i] * 8;
+		z[i] = floats[NUM_ELEMENTS * 2 + i] * 8;
+	}
+	std::vector<float> results(NUM_ELEMENTS);
+
+	state.ItemsPerIteration(NUM_ELEMENTS);
+	while (state.KeepRunning())
+	{
+		MathLib::SimplexNoise<float>::Instance().noise(&x[0], &y[0], &z[0], &results[0], NUM_ELEMENTS);
+		KeepAlive(results[0]);
+	}
+}
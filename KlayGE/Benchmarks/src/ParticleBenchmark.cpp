@@ -0,0 +1,117 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KlayGE/ParticleSystem.hpp>
+
+#include <string>
+#include <vector>
+
+#include "Benchmark.hpp"
+
+using namespace std;
+using namespace KlayGE;
+
+namespace
+{
+	uint32_t const PARTICLE_COUNTS[] = { 1000, 10000, 100000 };
+
+	// A fire-like system. Particles live long enough to stay alive through every iteration of a sample, so the
+	//  amount of work doesn't change while it runs.
+	struct ParticleSetup
+	{
+		ParticleSystemPtr ps;
+		std::shared_ptr<PointParticleEmitter> emitter;
+		std::shared_ptr<PolylineParticleUpdater> updater;
+		ParticleStore store;
+
+		explicit ParticleSetup(uint32_t num_particles)
+			: ps(MakeSharedPtr<ParticleSystem>(num_particles)), store(num_particles)
+		{
+			ps->Gravity(0.5f);
+			ps->MediaDensity(0.5f);
+			ps->Force(float3(0.1f, 0, 0));
+
+			emitter = MakeSharedPtr<PointParticleEmitter>(ps);
+			emitter->Frequency(1000);
+			emitter->EmitAngle(PI / 3);
+			emitter->MinPosition(float3(-0.1f, 0, -0.1f));
+			emitter->MaxPosition(float3(+0.1f, 0, +0.1f));
+			emitter->MinVelocity(1);
+			emitter->MaxVelocity(2);
+			emitter->MinLife(1e5f);
+			emitter->MaxLife(2e5f);
+			emitter->MinSpin(-1);
+			emitter->MaxSpin(+1);
+			emitter->MinSize(0.1f);
+			emitter->MaxSize(0.2f);
+
+			std::vector<float2> size_over_life;
+			size_over_life.emplace_back(0.0f, 1.0f);
+			size_over_life.emplace_back(0.3f, 2.0f);
+			size_over_life.emplace_back(1.0f, 0.5f);
+			std::vector<float2> mass_over_life;
+			mass_over_life.emplace_back(0.0f, 0.5f);
+			mass_over_life.emplace_back(1.0f, 0.1f);
+			std::vector<float2> opacity_over_life;
+			opacity_over_life.emplace_back(0.0f, 0.0f);
+			opacity_over_life.emplace_back(0.1f, 1.0f);
+			opacity_over_life.emplace_back(0.8f, 0.6f);
+			opacity_over_life.emplace_back(1.0f, 0.0f);
+
+			updater = MakeSharedPtr<PolylineParticleUpdater>(ps);
+			updater->SizeOverLife(size_over_life);
+			updater->MassOverLife(mass_over_life);
+			updater->OpacityOverLife(opacity_over_life);
+
+			ps->AddEmitter(emitter);
+			ps->AddUpdater(updater);
+		}
+	};
+
+	// The batch paths ParticleSystem::SubThreadUpdate runs. The system itself needs the active camera of an
+	//  application to sort, so the store is driven directly.
+	void EmitBenchmark(BenchmarkState& state, uint32_t num_particles)
+	{
+		ParticleSetup setup(num_particles);
+
+		state.ItemsPerIteration(num_particles);
+		while (state.KeepRunning())
+		{
+			setup.emitter->EmitBatch(setup.store, 0, num_particles);
+			KeepAlive(*setup.store.Data(ParticleStore::PA_PosX));
+		}
+	}
+
+	void UpdateBenchmark(BenchmarkState& state, uint32_t num_particles)
+	{
+		ParticleSetup setup(num_particles);
+		setup.emitter->EmitBatch(setup.store, 0, num_particles);
+		setup.updater->UpdateBatch(setup.store, 0, num_particles, 0);
+
+		state.ItemsPerIteration(num_particles);
+		while (state.KeepRunning())
+		{
+			setup.updater->UpdateBatch(setup.store, 0, num_particles, 1.0f / 60);
+			KeepAlive(*setup.store.Data(ParticleStore::PA_PosX));
+		}
+	}
+
+	struct ParticleBenchmarks
+	{
+		ParticleBenchmarks()
+		{
+			for (uint32_t const num_particles : PARTICLE_COUNTS)
+			{
+				std::string const suffix = "/" + std::to_string(num_particles);
+				RegisterBenchmark("Particles/Emit" + suffix,
+					[num_particles](BenchmarkState& state)
+					{
+						EmitBenchmark(state, num_particles);
+					});
+				RegisterBenchmark("Particles/Update" + suffix,
+					[num_particles](BenchmarkState& state)
+					{
+						UpdateBenchmark(state, num_particles);
+					});
+			}
+		}
+	} particle_benchmarks;
+}
@@ -0,0 +1,97 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KlayGE/Mesh.hpp>
+#include <KFL/Math.hpp>
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Benchmark.hpp"
+
+using namespace std;
+using namespace KlayGE;
+
+namespace
+{
+	uint32_t const JOINT_COUNTS[] = { 64, 256, 1024 };
+	uint32_t const NUM_FRAMES = 60;
+	uint32_t const KEY_INTERVAL = 5;
+
+	// A binary tree of joints with a key every KEY_INTERVAL frames. Joints only rotate and translate, the case the
+	//  exporters produce for almost every character.
+	SkinnedModelPtr MakeSkeleton(uint32_t num_joints)
+	{
+		std::ranlux24_base gen(num_joints);
+		std::uniform_real_distribution<float> dis(-1, 1);
+
+		std::vector<Joint> joints(num_joints);
+		auto kfs = MakeSharedPtr<KeyFramesType>(num_joints);
+		for (uint32_t i = 0; i < num_joints; ++ i)
+		{
+			Joint& joint = joints[i];
+			joint.name = "joint" + std::to_string(i);
+			joint.parent = (0 == i) ? -1 : static_cast<int16_t>((i - 1) / 2);
+
+			float3 const trans(dis(gen), dis(gen) + 1, dis(gen));
+			joint.bind_real = Quaternion::Identity();
+			joint.bind_dual = MathLib::quat_trans_to_udq(joint.bind_real, trans);
+			joint.bind_scale = 1;
+			std::pair<Quaternion, Quaternion> const inv_origin = MathLib::inverse(joint.bind_real, joint.bind_dual);
+			joint.inverse_origin_real = inv_origin.first;
+			joint.inverse_origin_dual = inv_origin.second;
+			joint.inverse_origin_scale = 1;
+
+			KeyFrames& kf = (*kfs)[i];
+			for (uint32_t f = 0; f <= NUM_FRAMES; f += KEY_INTERVAL)
+			{
+				Quaternion const rot = MathLib::normalize(Quaternion(dis(gen) * 0.3f, dis(gen) * 0.3f,
+					dis(gen) * 0.3f, 1));
+				kf.frame_id.push_back(f);
+				kf.bind_real.push_back(rot);
+				kf.bind_dual.push_back(MathLib::quat_trans_to_udq(rot, trans));
+				kf.bind_scale.push_back(1);
+			}
+		}
+
+		SkinnedModelPtr model = MakeSharedPtr<SkinnedModel>(L"Skeleton");
+		model->AssignJoints(joints.begin(), joints.end());
+		model->AttachKeyFrames(kfs);
+		model->NumFrames(NUM_FRAMES);
+		model->FrameRate(30);
+		return model;
+	}
+
+	// Everything the CPU does per frame for a skinned model. The vertices are skinned on the GPU.
+	void BuildBonesBenchmark(BenchmarkState& state, uint32_t num_joints)
+	{
+		SkinnedModelPtr const model = MakeSkeleton(num_joints);
+
+		float frame = 0;
+		state.ItemsPerIteration(num_joints);
+		while (state.KeepRunning())
+		{
+			frame += 0.37f;
+			if (frame >= NUM_FRAMES)
+			{
+				frame -= NUM_FRAMES;
+			}
+			model->SetFrame(frame);
+			KeepAlive(model->GetBindRealParts()[0]);
+		}
+	}
+
+	struct SkinningBenchmarks
+	{
+		SkinningBenchmarks()
+		{
+			for (uint32_t const num_joints : JOINT_COUNTS)
+			{
+				RegisterBenchmark("Skinning/BuildBones/" + std::to_string(num_joints),
+					[num_joints](BenchmarkState& state)
+					{
+						BuildBonesBenchmark(state, num_joints);
+					});
+			}
+		}
+	} skinning_benchmarks;
+}
@@ -0,0 +1,200 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KlayGE/ResLoader.hpp>
+#include <KlayGE/TexCompressionBC.hpp>
+#include <KlayGE/TexCompressionETC.hpp>
+#include <KlayGE/Texture.hpp>
+
+#include <cstring>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "Benchmark.hpp"
+
+using namespace std;
+using namespace KlayGE;
+
+namespace
+{
+	// Encoding a whole 512x512 image takes seconds with the slower codecs, so all of them work on the same crop.
+	uint32_t const CROP_SIZE = 256;
+
+	struct CodecDesc
+	{
+		char const * name;
+		char const * source;
+		std::function<TexCompressionPtr()> make;
+	};
+
+	struct SourceImage
+	{
+		uint32_t width;
+		uint32_t height;
+		ElementFormat format;
+		std::vector<uint8_t> pixels;
+	};
+
+	SourceImage const * LoadSource(std::string const & name)
+	{
+		static std::map<std::string, SourceImage> sources;
+
+		auto iter = sources.find(name);
+		if (iter == sources.end())
+		{
+			if (ResLoader::Instance().Locate(name).empty())
+			{
+				return nullptr;
+			}
+
+			Texture::TextureType type;
+			uint32_t width, height, depth, num_mipmaps, array_size;
+			ElementFormat format;
+			std::vector<ElementInitData> init_data;
+			std::vector<uint8_t> data_block;
+			LoadTexture(name, type, width, height, depth, num_mipmaps, array_size, format, init_data, data_block);
+
+			SourceImage image;
+			image.width = std::min(width, CROP_SIZE);
+			image.height = std::min(height, CROP_SIZE);
+			image.format = format;
+
+			uint32_t const pixel_size = NumFormatBytes(format);
+			image.pixels.resize(image.width * image.height * pixel_size);
+			uint8_t const * src = static_cast<uint8_t const *>(init_data[0].data);
+			for (uint32_t y = 0; y < image.height; ++ y)
+			{
+				memcpy(&image.pixels[y * image.width * pixel_size], src + y * init_data[0].row_pitch,
+					image.width * pixel_size);
+			}
+
+			iter = sources.emplace(name, std::move(image)).first;
+		}
+
+		return &iter->second;
+	}
+
+	// The source images are ARGB8 or ABGR16F. BC4 and BC5 take the first channels of an ARGB8 image.
+	std::vector<uint8_t> ConvertSource(SourceImage const & image, ElementFormat dst_format)
+	{
+		if (dst_format == image.format)
+		{
+			return image.pixels;
+		}
+
+		BOOST_ASSERT(EF_ARGB8 == image.format);
+
+		uint32_t const num_pixels = image.width * image.height;
+		uint32_t const dst_size = NumFormatBytes(dst_format);
+		std::vector<uint8_t> pixels(num_pixels * dst_size);
+		for (uint32_t i = 0; i < num_pixels; ++ i)
+		{
+			// Bytes of ARGB8 are B, G, R, A in memory. R8 and GR8 start from R.
+			for (uint32_t c = 0; c < dst_size; ++ c)
+			{
+				pixels[i * dst_size + c] = image.pixels[i * 4 + 2 - c];
+			}
+		}
+		return pixels;
+	}
+
+	void EncodeBenchmark(BenchmarkState& state, CodecDesc const & desc)
+	{
+		SourceImage const * image = LoadSource(desc.source);
+		if (nullptr == image)
+		{
+			state.Skip(std::string(desc.source) + " is not found");
+			return;
+		}
+
+		TexCompressionPtr const codec = desc.make();
+		std::vector<uint8_t> const input = ConvertSource(*image, codec->DecodedFormat());
+		uint32_t const in_row_pitch = image->width * NumFormatBytes(codec->DecodedFormat());
+
+		uint32_t const blocks_x = (image->width + codec->BlockWidth() - 1) / codec->BlockWidth();
+		uint32_t const blocks_y = (image->height + codec->BlockHeight() - 1) / codec->BlockHeight();
+		uint32_t const out_row_pitch = blocks_x * codec->BlockBytes();
+		std::vector<uint8_t> output(out_row_pitch * blocks_y);
+
+		state.ItemsPerIteration(image->width * image->height);
+		while (state.KeepRunning())
+		{
+			codec->EncodeMem(image->width, image->height, &output[0], out_row_pitch, out_row_pitch * blocks_y,
+				&input[0], in_row_pitch, in_row_pitch * image->height, TCM_Balanced);
+			KeepAlive(output[0]);
+		}
+	}
+
+	void DecodeBenchmark(BenchmarkState& state, CodecDesc const & desc)
+	{
+		SourceImage const * image = LoadSource(desc.source);
+		if (nullptr == image)
+		{
+			state.Skip(std::string(desc.source) + " is not found");
+			return;
+		}
+
+		TexCompressionPtr const codec = desc.make();
+		std::vector<uint8_t> const input = ConvertSource(*image, codec->DecodedFormat());
+		uint32_t const in_row_pitch = image->width * NumFormatBytes(codec->DecodedFormat());
+
+		uint32_t const blocks_x = (image->width + codec->BlockWidth() - 1) / codec->BlockWidth();
+		uint32_t const blocks_y = (image->height + codec->BlockHeight() - 1) / codec->BlockHeight();
+		uint32_t const block_row_pitch = blocks_x * codec->BlockBytes();
+		std::vector<uint8_t> blocks(block_row_pitch * blocks_y);
+		codec->EncodeMem(image->width, image->height, &blocks[0], block_row_pitch, block_row_pitch * blocks_y,
+			&input[0], in_row_pitch, in_row_pitch * image->height, TCM_Speed);
+
+		std::vector<uint8_t> output(input.size());
+
+		state.ItemsPerIteration(image->width * image->height);
+		while (state.KeepRunning())
+		{
+			codec->DecodeMem(image->width, image->height, &output[0], in_row_pitch, in_row_pitch * image->height,
+				&blocks[0], block_row_pitch, block_row_pitch * blocks_y);
+			KeepAlive(output[0]);
+		}
+	}
+
+	template <typename T>
+	TexCompressionPtr MakeCodec()
+	{
+		return MakeSharedPtr<T>();
+	}
+
+	struct TexCodecBenchmarks
+	{
+		TexCodecBenchmarks()
+		{
+			static CodecDesc const codecs[] =
+			{
+				{ "BC1", "Lenna.dds", MakeCodec<TexCompressionBC1> },
+				{ "BC2", "leaf_v3_green_tex.dds", MakeCodec<TexCompressionBC2> },
+				{ "BC3", "leaf_v3_green_tex.dds", MakeCodec<TexCompressionBC3> },
+				{ "BC4", "Lenna.dds", MakeCodec<TexCompressionBC4> },
+				{ "BC5", "Lenna.dds", MakeCodec<TexCompressionBC5> },
+				{ "BC6U", "memorial.dds", MakeCodec<TexCompressionBC6U> },
+				{ "BC6S", "uffizi_probe.dds", MakeCodec<TexCompressionBC6S> },
+				{ "BC7", "Lenna.dds", MakeCodec<TexCompressionBC7> },
+				{ "ETC1", "Lenna.dds", MakeCodec<TexCompressionETC1> },
+				{ "ETC2RGB8", "Lenna.dds", MakeCodec<TexCompressionETC2RGB8> },
+				{ "ETC2RGB8A1", "leaf_v3_green_tex.dds", MakeCodec<TexCompressionETC2RGB8A1> }
+			};
+
+			for (auto const & codec : codecs)
+			{
+				CodecDesc const * desc = &codec;
+				RegisterBenchmark(std::string("TexCodec/Encode/") + codec.name,
+					[desc](BenchmarkState& state)
+					{
+						EncodeBenchmark(state, *desc);
+					});
+				RegisterBenchmark(std::string("TexCodec/Decode/") + codec.name,
+					[desc](BenchmarkState& state)
+					{
+						DecodeBenchmark(state, *desc);
+					});
+			}
+		}
+	} tex_codec_benchmarks;
+}
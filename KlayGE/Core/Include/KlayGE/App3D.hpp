@@ -89,6 +89,7 @@ namespace KlayGE
 
 		WindowPtr MakeWindow(std::string const & name, RenderSettings const & settings);
 		WindowPtr MakeWindow(std::string const & name, RenderSettings const & settings, void* native_wnd);
+		// Null when the render factory is Null, which runs without a native window
 		WindowPtr const & MainWnd() const
 		{
 			return main_wnd_;
@@ -119,6 +120,9 @@ namespace KlayGE
 		void UpdateStats();
 
 	private:
+		static bool WindowLess(ContextCfg const & cfg);
+
+
 		virtual void OnCreate()
 		{
 		}
@@ -149,6 +153,7 @@ namespace KlayGE
 		float frame_time_;
 
 		WindowPtr main_wnd_;
+		bool quit_;
 
 #if defined KLAYGE_PLATFORM_WINDOWS_RUNTIME
 	public:
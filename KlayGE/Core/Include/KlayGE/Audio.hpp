@@ -21,7 +21,13 @@
 #include <KlayGE/PreDeclare.hpp>
 #include <KFL/Vector.hpp>
 
+#include <KFL/Thread.hpp>
+
+#include <chrono>
 #include <map>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
 
 #include <KlayGE/AudioDataSource.hpp>
 
@@ -93,13 +99,77 @@ namespace KlayGE
 
 		bool IsSound() const;
 
+		// Called by the streaming service. Feeds the device, and then decodes ahead. Returns false if the stream
+		//  has finished. next_service_ms is when the stream wants to be serviced again.
+		bool ServiceStream(uint32_t& next_service_ms);
+
 	protected:
 		virtual void DoReset() = 0;
 		virtual void DoPlay(bool loop) = 0;
 		virtual void DoStop() = 0;
 
+		// Moves decoded data to the device. Same return values as ServiceStream.
+		virtual bool FeedDevice(uint32_t& next_service_ms) = 0;
+
+		// Takes up to size bytes from the decode-ahead ring. Decodes in place if the ring runs short.
+		//  Returns 0 only at the end of a stream that doesn't loop.
+		size_t ReadDecoded(uint8_t* data, size_t size);
+		void DecodeAhead();
+		void ResetDecoder();
+
+		uint32_t BytesPerSecond() const;
+
+	protected:
+		AudioStreamingServicePtr streaming_service_;
+		bool loop_;
+
 		// ÿȡĴ
 		static uint32_t	PreSecond;
+
+	private:
+		size_t DecodeInto(uint8_t* data, size_t size);
+
+	private:
+		// Bytes [ring_read_, ring_read_ + ring_size_) of decode_ring_, wrapped around, are decoded and not consumed yet
+		std::vector<uint8_t> decode_ring_;
+		size_t ring_read_;
+		size_t ring_size_;
+		bool end_of_stream_;
+	};
+
+	// Services every playing music buffer from one thread. Each stream is serviced when its deadline comes, and then
+	//  tells when it needs to be serviced again.
+	class KLAYGE_CORE_API AudioStreamingService : boost::noncopyable
+	{
+	public:
+		AudioStreamingService();
+		~AudioStreamingService();
+
+		// Services the buffer as soon as possible
+		void Add(MusicBuffer* buffer);
+		// Blocks if the buffer is being serviced
+		void Remove(MusicBuffer* buffer);
+
+		size_t NumStreams() const;
+
+	private:
+		void ThreadFunc();
+
+	private:
+		struct Stream
+		{
+			MusicBuffer* buffer;
+			std::chrono::steady_clock::time_point deadline;
+		};
+
+		mutable std::mutex mutex_;
+		std::condition_variable wake_cond_;
+		std::condition_variable idle_cond_;
+		std::vector<Stream> streams_;
+		MusicBuffer* servicing_;
+		bool quit_;
+
+		std::unique_ptr<joiner<void>> thread_;
 	};
 
 	// Ƶ
@@ -131,6 +201,8 @@ namespace KlayGE
 		void  MusicVolume(float vol);
 		float MusicVolume() const;
 
+		AudioStreamingServicePtr const & StreamingService() const;
+
 		virtual float3 GetListenerPos() const = 0;
 		virtual void SetListenerPos(float3 const & v) = 0;
 		virtual float3 GetListenerVel() const = 0;
@@ -143,6 +215,7 @@ namespace KlayGE
 		virtual void DoResume() = 0;
 
 	protected:
+		AudioStreamingServicePtr streaming_service_;
 		std::map<size_t, AudioBufferPtr> audioBufs_;
 
 		float		soundVol_;
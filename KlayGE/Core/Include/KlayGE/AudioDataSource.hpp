@@ -45,6 +45,8 @@ namespace KlayGE
 
 		virtual size_t Read(void* data, size_t size) = 0;
 		virtual void Reset() = 0;
+		// The next Read starts from this frame
+		virtual void SeekFrame(uint64_t frame) = 0;
 
 		virtual ~AudioDataSource();
 
@@ -155,6 +155,8 @@ namespace KlayGE
 			DT_DiffuseLighting,
 			DT_SpecularLighting,
 #endif
+			// SceneManager's software occlusion buffer. Empty unless occlusion culling is on.
+			DT_OcclusionBuffer,
 			Num_DT
 		};
 
@@ -588,6 +590,7 @@ namespace KlayGE
 		bool force_line_mode_;
 
 		PostProcessPtr dr_debug_pp_;
+		PostProcessPtr occlusion_debug_pp_;
 		DisplayType display_type_;
 
 		uint32_t num_objects_rendered_;
@@ -72,6 +72,22 @@ namespace KlayGE
 			FA_Ver_Bottom	= 1UL << 5
 		};
 
+		struct GlyphCacheStats
+		{
+			uint64_t hits;
+			uint64_t misses;
+			uint64_t evictions;
+			uint64_t uploads;
+			uint32_t capacity;
+			uint32_t used;
+
+			float HitRate() const
+			{
+				uint64_t const total = hits + misses;
+				return total > 0 ? static_cast<float>(hits) / total : 1.0f;
+			}
+		};
+
 	public:
 		explicit Font(std::shared_ptr<FontRenderable> const & fr);
 		Font(std::shared_ptr<FontRenderable> const & fr, uint32_t flags);
@@ -85,6 +101,13 @@ namespace KlayGE
 			std::wstring const & text, float font_size, uint32_t align);
 		void RenderText(float4x4 const & mvp, Color const & clr, std::wstring const & text, float font_size);
 
+		// Warms the glyphs of text on worker threads, e.g. for the string table of a dialog that is about to show.
+		void Prefetch(std::wstring const & text);
+
+		// Statistics of the glyph cache texture. uploads counts the texture updates issued, after batching.
+		GlyphCacheStats const & CacheStats() const;
+		void ResetCacheStats();
+
 	private:
 		std::shared_ptr<FontRenderable> font_renderable_;
 		uint32_t		fso_attrib_;
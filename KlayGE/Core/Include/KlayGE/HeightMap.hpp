@@ -21,18 +21,48 @@
 
 #pragma once
 
+#include <KFL/AABBox.hpp>
+
+#include <functional>
 #include <vector>
 
 namespace KlayGE
 {
 	// ߶ͼ
 	/////////////////////////////////////////////////////////////////////////////////
+	struct HeightMapChunk
+	{
+		uint32_t chunk_x;
+		uint32_t chunk_y;
+		uint32_t lod;
+		AABBox aabb;
+
+		// The grid vertices, row by row, followed by the skirt vertices
+		std::vector<float3> vertices;
+		// Only one of them is filled. 16-bit indices are used if the chunk has no more than 65536 vertices.
+		std::vector<uint16_t> indices16;
+		std::vector<uint32_t> indices32;
+	};
+
 	class HeightMap
 	{
+	public:
+		// Evaluates the heights of num points at (xs[i], ys[i])
+		typedef std::function<void(float const * xs, float const * ys, float* heights, uint32_t num)> BatchHeightFunc;
+
 	public:
 		void BuildTerrain(float start_x, float start_y, float end_x, float end_y, float span_x, float span_y,
 			std::vector<float3>& vertices, std::vector<uint16_t>& indices,
 			std::function<float(float, float)> HeightFunc);
+
+		// Splits the terrain into chunks of chunk_quads x chunk_quads quads, each of them has num_lods LODs.
+		//  LOD l takes one vertex every 2^l, so chunk_quads should be a multiple of 2^(num_lods - 1). Every chunk
+		//  hangs a skirt of skirt_depth down from its border to hide the cracks between different LODs.
+		//  The heights are evaluated in batches of rows, and the chunks are built, on the thread pool.
+		//  chunks[(chunk_y * num_chunks_x + chunk_x) * num_lods + lod] is the output of a chunk in a LOD.
+		void BuildChunkedTerrain(float start_x, float start_y, float end_x, float end_y, float span_x, float span_y,
+			uint32_t chunk_quads, uint32_t num_lods, float skirt_depth,
+			std::vector<HeightMapChunk>& chunks, BatchHeightFunc const & height_func);
 	};
 }
 
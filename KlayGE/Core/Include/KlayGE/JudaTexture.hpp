@@ -20,10 +20,15 @@
 #include <KlayGE/RenderStateObject.hpp>
 #include <KlayGE/TexCompressionBC.hpp>
 
+#include <array>
 #include <vector>
 #include <deque>
+#include <list>
+#include <mutex>
 #include <unordered_map>
+#include <unordered_set>
 
+#include <KFL/Thread.hpp>
 #include <KlayGE/LZMACodec.hpp>
 
 namespace KlayGE
@@ -62,8 +67,15 @@ namespace KlayGE
 
 		static uint32_t const LEVEL_SHIFT = 28;
 
+		// Marks the index of a baked tile payload in the decoded block cache
+		static uint32_t const BAKED_BLOCK_FLAG = 1UL << 31;
+
+		static uint32_t const MAX_DECODED_BLOCKS = 64;
+		static uint32_t const MAX_DECODE_BATCH = 8;
+
 	public:
 		JudaTexture(uint32_t num_tiles, uint32_t tile_size, ElementFormat format);
+		~JudaTexture();
 
 		uint32_t EncodeTileID(uint32_t level, uint32_t tile_x, uint32_t tile_y) const;
 		void DecodeTileID(uint32_t& level, uint32_t& tile_x, uint32_t& tile_y, uint32_t tile_id) const;
@@ -80,6 +92,11 @@ namespace KlayGE
 		void CommitTiles(std::vector<std::vector<uint8_t>> const & data, std::vector<uint32_t> const & tile_ids, std::vector<uint32_t> const & tile_attrs);
 		void DecodeTiles(std::vector<std::vector<uint8_t>>& data, std::vector<uint32_t> const & tile_ids, uint32_t mipmaps);
 
+		// Bakes the tiles at the finest level, with borders and mipmaps, into a BC format when saving. UpdateCache uploads
+		//  them without decoding and compressing if the cache has the same format and border size. Call it after all
+		//  the tiles are committed.
+		void BakeCacheTiles(ElementFormat format, uint32_t border_size);
+
 		void CacheProperty(uint32_t pages, ElementFormat format, uint32_t border_size, uint32_t cache_tile_size = 0);
 
 		TexturePtr const & CacheTex() const;
@@ -88,12 +105,39 @@ namespace KlayGE
 
 		void SetParams(RenderEffect const & effect);
 
+		// Never waits for the data blocks. The blocks not decoded yet are requested from the streaming thread, and
+		//  the tiles are shown without their detail until the blocks arrive. At most UploadBudget tiles, new or refined,
+		//  are decoded and uploaded in a call. The rest show a coarser tile in the cache until a later call.
 		void UpdateCache(std::vector<uint32_t> const & tile_ids);
+		void UploadBudget(uint32_t tiles);
+		uint32_t UploadBudget() const;
+		size_t NumPendingBlocks() const;
 
 	private:
-		void DecodeATile(std::vector<uint8_t>* data, uint32_t shuff, uint32_t mipmaps);
+		void DecodeTiles(std::vector<std::vector<uint8_t>>& data, std::vector<uint32_t> const & tile_ids, uint32_t mipmaps,
+			std::vector<bool>* complete);
+		bool DecodeATile(std::vector<uint8_t>* data, uint32_t shuff, uint32_t mipmaps, bool wait);
 		uint32_t DecodeAAttr(uint32_t shuff);
 		uint8_t* RetriveATile(uint32_t data_index);
+		uint8_t* TryRetriveATile(uint32_t data_index);
+		std::shared_ptr<std::vector<uint8_t>> TryRetriveBakedTile(uint32_t tile_id);
+		bool TileBlocksReady(uint32_t shuff);
+		uint8_t* InsertDecodedBlock(uint32_t data_index, std::shared_ptr<std::vector<uint8_t>> const & data);
+		void ReadCompressedBlock(std::vector<uint8_t>& comed_data, uint32_t data_index);
+		uint32_t DecodedBlockBytes(uint32_t data_index) const;
+
+		void RequestBlock(uint32_t data_index);
+		void CollectStreamedBlocks();
+		void StreamThreadFunc();
+
+		uint32_t TileNeighbors(std::array<uint32_t, 9>& new_tile_id_with_neighbors, std::array<bool, 9>& new_in_same_image,
+			uint32_t tile_id, bool with_neighbors);
+		void BuildCacheTiles(std::vector<std::vector<uint8_t>>& levels, ElementFormat format, TexCompression* codec,
+			uint32_t mipmaps, std::vector<std::vector<uint8_t>> const & neighbor_data,
+			std::vector<uint32_t> const & index_with_neighbors, std::vector<bool> const & in_same_image,
+			std::vector<uint32_t> const & tile_attrs);
+		void CacheTileLevelPitch(uint32_t& row_pitch, uint32_t& slice_pitch, ElementFormat format, uint32_t size) const;
+		void BakeATile(std::vector<uint8_t>& payload, uint32_t tile_id);
 
 		uint32_t NumNonEmptySubNodes(quadtree_node_ptr const & node) const;
 		quadtree_node_ptr const & GetNode(uint32_t shuff);
@@ -168,20 +212,31 @@ namespace KlayGE
 	private:
 		// Input only
 		ResIdentifierPtr input_file_;
+		std::mutex file_mutex_;
 		uint32_t data_blocks_offset_;
 		LZMACodec lzma_dec_;
-		struct DecodedBlockInfo
-		{
-			std::shared_ptr<std::vector<uint8_t>> data;
-			uint64_t tick;
 
-			DecodedBlockInfo(std::shared_ptr<std::vector<uint8_t>> const & d, uint64_t t)
-				: data(d), tick(t)
-			{
-			}
-		};
-		std::unordered_map<uint32_t, DecodedBlockInfo> decoded_block_cache_;
-		uint64_t decode_tick_;
+		// Most recently used first
+		typedef std::list<std::pair<uint32_t, std::shared_ptr<std::vector<uint8_t>>>> DecodedBlockList;
+		DecodedBlockList decoded_block_lru_;
+		std::unordered_map<uint32_t, DecodedBlockList::iterator> decoded_block_cache_;
+
+		// Blocks are read and decoded on the streaming thread, and go to the cache in the next UpdateCache
+		mutable std::mutex stream_mutex_;
+		std::deque<uint32_t> requested_blocks_;
+		std::unordered_set<uint32_t> in_flight_blocks_;
+		std::vector<std::pair<uint32_t, std::shared_ptr<std::vector<uint8_t>>>> streamed_blocks_;
+		bool streaming_;
+		bool quit_streaming_;
+		std::unique_ptr<joiner<void>> stream_thread_;
+
+	private:
+		// Baked cache tiles
+		ElementFormat baked_format_;
+		uint32_t baked_border_size_;
+		std::vector<uint32_t> baked_tile_ids_;	// Sorted
+		uint64_t baked_offsets_offset_;			// Input only
+		uint32_t baked_tile_bytes_;				// Input only
 
 	private:
 		// Cache
@@ -197,10 +252,14 @@ namespace KlayGE
 			uint32_t x, y, z;
 			uint32_t attr;
 			uint64_t tick;
+			bool complete;
 		};
 		std::unordered_map<uint32_t, TileInfo> tile_info_map_;
 		std::deque<std::pair<uint32_t, uint32_t>> tile_free_list_;
 		uint64_t tile_tick_;
+		uint32_t upload_budget_;
+		bool has_root_tile_;
+		TileInfo root_tile_info_;
 	};
 }
 
@@ -18,9 +18,9 @@
 
 #pragma once
 
+#include <atomic>
 #include <vector>
-#include <list>
-#include <KlayGE/Socket.hpp>
+#include <KlayGE/NetTransport.hpp>
 
 #ifndef KLAYGE_PLATFORM_WINDOWS_RUNTIME
 
@@ -52,10 +52,7 @@ namespace KlayGE
 	{
 		std::string		name;
 		sockaddr_in		addr;
-
-		uint32_t		time;
-
-		std::list<std::vector<char>> msgs;
+		uint32_t		peer;
 	};
 
 	class KLAYGE_CORE_API Lobby
@@ -78,28 +75,27 @@ namespace KlayGE
 		void MaxPlayers(char maxPlayers);
 		char MaxPlayers() const;
 
-		int Receive(void* buf, int maxSize, sockaddr_in& from);
 		int Send(void const * buf, int maxSize, sockaddr_in const & to);
 
-		void TimeOut(uint32_t timeOut)
-			{ this->socket_.TimeOut(timeOut); }
-		uint32_t TimeOut()
-			{ return this->socket_.TimeOut(); }
-
 		sockaddr_in const & SockAddr() const
 			{ return this->sockAddr_; }
 
+		NetTransport::Stats Statistics() const
+			{ return this->transport_.Statistics(); }
+
 	private:
-		void OnJoin(char* revbuf, char* sendbuf, int& sendnum, sockaddr_in& From, Processor const & pro);
+		void OnMessage(uint32_t peer, uint8_t const * data, uint32_t size, Processor const & pro);
+
+		void OnJoin(char* revbuf, char* sendbuf, int& sendnum, uint32_t peer, sockaddr_in& From, Processor const & pro);
 		void OnQuit(PlayerAddrsIter iter, char* sendbuf, int& sendnum, Processor const & pro);
 
 		void OnGetLobbyInfo(char* sendbuf, int& sendnum, Processor const & pro);
-		void OnNop(PlayerAddrsIter iter);
 
-		PlayerAddrsIter ID(sockaddr_in const & Addr);
+		PlayerAddrsIter ID(uint32_t peer);
 
 	private:
-		Socket			socket_;
+		NetTransport	transport_;
+		std::atomic<bool>	running_;
 		PlayerAddrs		players_;
 
 		sockaddr_in		sockAddr_;
@@ -0,0 +1,51 @@
+/**
+ * @file MeshMLJIT.hpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#ifndef _KLAYGE_MESHMLJIT_HPP
+#define _KLAYGE_MESHMLJIT_HPP
+
+#pragma once
+
+#include <KlayGE/PreDeclare.hpp>
+
+#include <string>
+
+namespace KlayGE
+{
+#if KLAYGE_IS_DEV_PLATFORM
+	// Compiles a .meshml into a .model_bin in target_folder, or next to the input if it's empty. Meshes and texture
+	//  conversions are processed in parallel on the context's thread pool. Returns the output file name.
+	//  Throws on failure.
+	KLAYGE_CORE_API std::string MeshMLJIT(std::string const & input_name, std::string const & target_folder,
+		std::string const & platform);
+#endif
+}
+
+#endif		// _KLAYGE_MESHMLJIT_HPP
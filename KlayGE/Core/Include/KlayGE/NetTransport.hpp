@@ -0,0 +1,209 @@
+/**
+ * @file NetTransport.hpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#ifndef _KLAYGE_NETTRANSPORT_HPP
+#define _KLAYGE_NETTRANSPORT_HPP
+
+#pragma once
+
+#include <KlayGE/PreDeclare.hpp>
+#include <KlayGE/Socket.hpp>
+#include <KFL/Thread.hpp>
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+#ifndef KLAYGE_PLATFORM_WINDOWS_RUNTIME
+
+namespace KlayGE
+{
+	// Waits for sockets to become readable and calls their handlers. Uses epoll on Linux and Android, select() elsewhere.
+	class KLAYGE_CORE_API NetEventLoop : boost::noncopyable
+	{
+	public:
+		NetEventLoop();
+		~NetEventLoop();
+
+		void Add(Socket const & socket, std::function<void()> const & on_readable);
+		void Remove(Socket const & socket);
+
+		// Returns the number of handlers called.
+		uint32_t Poll(uint32_t timeout_ms);
+
+	private:
+#if defined(KLAYGE_PLATFORM_LINUX) || defined(KLAYGE_PLATFORM_ANDROID)
+		int epoll_fd_;
+#endif
+		std::unordered_map<SOCKET, std::function<void()>> handlers_;
+		std::vector<SOCKET> ready_;
+	};
+
+	// Message transport over one UDP socket. Every datagram carries a sequence number and a selective ack of the last 33
+	//  datagrams of the peer. Reliable messages are retransmitted until a datagram carrying them is acked, and delivered
+	//  in order. Messages queued to a peer are batched into datagrams of at most Settings::mtu bytes.
+	// Datagrams delayed by 1024 or more sequences are dropped as duplicates. Only a join datagram, which Connect sends until
+	//  the peer answers, creates a peer for an unknown address.
+	class KLAYGE_CORE_API NetTransport : boost::noncopyable
+	{
+	public:
+		static uint32_t const INVALID_PEER = 0;
+		// The size field of a message has 15 bits
+		static uint32_t const MAX_MESSAGE_SIZE = 0x7FFF;
+
+		struct KLAYGE_CORE_API Settings
+		{
+			uint32_t mtu;
+			uint32_t flush_interval_ms;
+			uint32_t min_resend_ms;
+			uint32_t max_resend_ms;
+			uint32_t keep_alive_ms;
+			uint32_t peer_timeout_ms;
+
+			Settings();
+		};
+
+		struct Stats
+		{
+			uint64_t datagrams_sent;
+			uint64_t datagrams_received;
+			uint64_t bytes_sent;
+			uint64_t bytes_received;
+			uint64_t messages_sent;
+			uint64_t messages_received;
+			uint64_t retransmits;
+			uint64_t duplicates;
+		};
+
+		// data points into the receive buffer of the transport, and is only valid during the call.
+		typedef std::function<void(uint32_t peer, uint8_t const * data, uint32_t size)> MessageHandler;
+		typedef std::function<void(uint32_t peer)> PeerHandler;
+
+	public:
+		NetTransport();
+		explicit NetTransport(Settings const & settings);
+		~NetTransport();
+
+		void Bind(uint16_t port);
+		uint16_t Port();
+		void Close();
+
+		uint32_t Connect(sockaddr_in const & addr);
+		// Drops the peer locally. OnPeerDisconnected is only called for peers that timed out.
+		void Disconnect(uint32_t peer);
+		uint32_t PeerByAddr(sockaddr_in const & addr) const;
+		bool PeerAddr(uint32_t peer, sockaddr_in& addr) const;
+		size_t NumPeers() const;
+
+		void OnMessage(MessageHandler const & handler);
+		void OnPeerConnected(PeerHandler const & handler);
+		void OnPeerDisconnected(PeerHandler const & handler);
+
+		// Can be called from any thread. The message goes out with the next flush of Update.
+		//  Returns false if the peer is unknown, or the message is larger than MAX_MESSAGE_SIZE or doesn't fit in one
+		//  datagram.
+		bool Send(uint32_t peer, void const * data, uint32_t size, bool reliable = true);
+		// Waits until every reliable message queued to the peer is acked. Runs Update itself if the transport isn't
+		//  started. Returns false on timeout or if the peer is gone.
+		bool Flush(uint32_t peer, uint32_t timeout_ms);
+
+		// Receives the pending datagrams, handles the timers and flushes the queued messages.
+		//  Waits at most min(timeout_ms, Settings::flush_interval_ms) for input.
+		void Update(uint32_t timeout_ms);
+
+		// Runs Update on a thread from the context thread pool until Stop is called. Stop flushes once more before returning.
+		void Start();
+		void Stop();
+
+		// A snapshot, the counters keep changing on the thread running Update.
+		Stats Statistics() const;
+
+	private:
+		struct Peer;
+
+		struct Delivery
+		{
+			uint32_t peer;
+			uint8_t const * data;
+			uint32_t size;
+		};
+
+		void ReceiveDatagrams();
+		void ProcessDatagram(sockaddr_in const & from, uint8_t const * data, uint32_t size, uint64_t now);
+		void ProcessAcks(Peer& peer, uint16_t ack, uint32_t ack_bits, uint64_t now);
+		void DeliverReliable(Peer& peer, uint16_t msg_id, uint8_t const * data, uint32_t size);
+		void UpdatePeers(uint64_t now);
+		void FlushPeer(Peer& peer, uint64_t now);
+		void DispatchEvents();
+
+		Peer* FindPeer(uint32_t peer) const;
+		Peer& AddPeer(sockaddr_in const & addr, uint64_t now);
+
+	private:
+		Settings settings_;
+
+		Socket socket_;
+		bool bound_;
+		NetEventLoop loop_;
+
+		mutable std::mutex mutex_;
+		std::unordered_map<uint32_t, std::unique_ptr<Peer>> peers_;
+		std::unordered_map<uint64_t, uint32_t> peer_by_addr_;
+		uint32_t next_peer_id_;
+
+		MessageHandler on_message_;
+		PeerHandler on_connected_;
+		PeerHandler on_disconnected_;
+
+		std::vector<uint8_t> recv_buffer_;
+		std::vector<uint8_t> send_buffer_;
+		std::vector<Delivery> deliveries_;
+		std::vector<std::vector<uint8_t>> delivered_copies_;
+		std::vector<uint32_t> connected_peers_;
+		std::vector<uint32_t> disconnected_peers_;
+		std::vector<uint32_t> dispatching_connected_;
+		std::vector<Delivery> dispatching_deliveries_;
+		std::vector<std::vector<uint8_t>> dispatching_copies_;
+		std::vector<uint32_t> dispatching_disconnected_;
+
+		Stats stats_;
+
+		std::atomic<bool> running_;
+		std::unique_ptr<joiner<void>> thread_;
+	};
+}
+
+#endif
+
+#endif			// _KLAYGE_NETTRANSPORT_HPP
@@ -0,0 +1,120 @@
+/**
+ * @file OcclusionBuffer.hpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#ifndef _KLAYGE_OCCLUSIONBUFFER_HPP
+#define _KLAYGE_OCCLUSIONBUFFER_HPP
+
+#pragma once
+
+#include <KlayGE/PreDeclare.hpp>
+#include <KFL/Math.hpp>
+
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+namespace KlayGE
+{
+	// A low resolution depth buffer rasterized on the CPU. Occluders are solid boxes. Each one is drawn as its convex
+	//  silhouette, only into pixels it fully covers, with the farthest depth of its front faces inside the pixel, so
+	//  the stored depth is never nearer than the real surface. Occludees are tested by their screen rectangle and
+	//  nearest depth, so a false "occluded" can't happen, only a missed one.
+	class KLAYGE_CORE_API OcclusionBuffer : boost::noncopyable
+	{
+	public:
+		// width is rounded up to a multiple of 4.
+		OcclusionBuffer(uint32_t width, uint32_t height);
+
+		uint32_t Width() const
+		{
+			return width_;
+		}
+		uint32_t Height() const
+		{
+			return height_;
+		}
+
+		// Clears the depth to far plane and drops the occluders of the last frame.
+		void BeginFrame(float4x4 const & view_proj);
+		// box is in model space. Occluders crossing the near plane are skipped.
+		void AddOccluder(AABBox const & box, float4x4 const & model);
+		// Rasterizes all the occluders. Bands of rows are done in parallel on the context's thread pool.
+		void Rasterize();
+
+		bool Occluded(AABBox const & box_ws) const;
+
+		uint32_t NumOccluders() const
+		{
+			return static_cast<uint32_t>(occluders_.size());
+		}
+
+		// Row by row from the top, 0 is the near plane and 1 the far plane.
+		float const * Depth() const
+		{
+			return depth_.empty() ? nullptr : &depth_[0];
+		}
+		// A grey scale view of the buffer for debugging, nearer is brighter. Updated on each call.
+		TexturePtr const & DebugTexture();
+
+	private:
+		// Silhouette edge functions and front face depth planes of a projected box, set up once and shared by all
+		//  the bands. The silhouette is the convex hull of the 8 corners, at most 8 edges. At most 3 faces are front.
+		struct Occluder
+		{
+			int32_t min_x, max_x;
+			int32_t min_y, max_y;
+
+			uint32_t num_edges;
+			float edge_a[8];
+			float edge_b[8];
+			float edge_c[8];
+
+			uint32_t num_planes;
+			float dz_dx[3];
+			float dz_dy[3];
+			float z_c[3];
+			float max_z;
+		};
+
+		void RasterizeRows(uint32_t row_begin, uint32_t row_end);
+
+	private:
+		uint32_t width_;
+		uint32_t height_;
+		float4x4 view_proj_;
+
+		std::vector<float> depth_;
+		std::vector<Occluder> occluders_;
+
+		TexturePtr debug_tex_;
+	};
+}
+
+#endif		// _KLAYGE_OCCLUSIONBUFFER_HPP
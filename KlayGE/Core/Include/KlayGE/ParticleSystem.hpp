@@ -36,8 +36,11 @@
 #include <KlayGE/PreDeclare.hpp>
 #include <KFL/Math.hpp>
 #include <KFL/Thread.hpp>
+#include <KFL/AlignedAllocator.hpp>
 #include <KlayGE/SceneObjectHelper.hpp>
 
+#include <array>
+#include <atomic>
 #include <vector>
 #include <random>
 
@@ -55,6 +58,59 @@ namespace KlayGE
 		float init_life;
 	};
 
+	// Structure-of-arrays storage of particles. Each attribute is a 16-byte aligned array with at least 3 elements of padding
+	//  after Capacity(), so batch updaters can process any range 4 particles at a time.
+	class KLAYGE_CORE_API ParticleStore
+	{
+	public:
+		enum ParticleAttrib
+		{
+			PA_PosX = 0,
+			PA_PosY,
+			PA_PosZ,
+			PA_VelX,
+			PA_VelY,
+			PA_VelZ,
+			PA_Life,
+			PA_Spin,
+			PA_Size,
+			PA_Alpha,
+			PA_InitLife,
+
+			PA_NumAttribs
+		};
+
+	public:
+		explicit ParticleStore(uint32_t capacity);
+
+		uint32_t Capacity() const
+		{
+			return capacity_;
+		}
+		uint32_t Stride() const
+		{
+			return stride_;
+		}
+
+		float* Data(ParticleAttrib attrib)
+		{
+			return &data_[attrib * stride_];
+		}
+		float const * Data(ParticleAttrib attrib) const
+		{
+			return &data_[attrib * stride_];
+		}
+
+		Particle Get(uint32_t i) const;
+		void Set(uint32_t i, Particle const & par);
+		void Move(uint32_t dst, uint32_t src);
+
+	private:
+		uint32_t capacity_;
+		uint32_t stride_;
+		std::vector<float, aligned_allocator<float, 16>> data_;
+	};
+
 	class KLAYGE_CORE_API ParticleEmitter
 	{
 	public:
@@ -180,6 +236,8 @@ namespace KlayGE
 
 		uint32_t Update(float elapsed_time);
 		virtual void Emit(Particle& par) = 0;
+		// Emits particles into [begin, end) of the store. The default implementation calls Emit per particle.
+		virtual void EmitBatch(ParticleStore& store, uint32_t begin, uint32_t end);
 
 	protected:
 		void DoClone(ParticleEmitterPtr const & rhs);
@@ -216,6 +274,9 @@ namespace KlayGE
 		virtual ParticleUpdaterPtr Clone() = 0;
 
 		virtual void Update(Particle& par, float elapse_time) = 0;
+		// Updates the live particles in [begin, end) of the store. Up to 3 particles after end may be written too.
+		//  The default implementation calls Update per particle.
+		virtual void UpdateBatch(ParticleStore& store, uint32_t begin, uint32_t end, float elapse_time);
 
 	protected:
 		void DoClone(ParticleUpdaterPtr const & rhs);
@@ -290,25 +351,30 @@ namespace KlayGE
 
 		uint32_t NumParticles() const
 		{
-			return static_cast<uint32_t>(particles_.size());
+			return particles_.Capacity();
 		}
 		uint32_t NumActiveParticles() const
 		{
-			return static_cast<uint32_t>(active_particles_.size());
+			return num_active_particles_;
 		}
+		// Active particles are sorted back to front. Indices are only valid in the update thread.
 		uint32_t GetActiveParticleIndex(uint32_t i) const
 		{
-			return active_particles_[i].first;
+			return active_particles_[i];
+		}
+		Particle GetParticle(uint32_t i) const
+		{
+			BOOST_ASSERT(i < particles_.Capacity());
+			return particles_.Get(i);
 		}
-		Particle const & GetParticle(uint32_t i) const
+		void SetParticle(uint32_t i, Particle const & par)
 		{
-			BOOST_ASSERT(i < particles_.size());
-			return particles_[i];
+			BOOST_ASSERT(i < particles_.Capacity());
+			particles_.Set(i, par);
 		}
-		Particle& GetParticle(uint32_t i)
+		ParticleStore const & Particles() const
 		{
-			BOOST_ASSERT(i < particles_.size());
-			return particles_[i];
+			return particles_;
 		}
 		void ClearParticles();
 
@@ -335,12 +401,41 @@ namespace KlayGE
 
 		void SceneDepthTexture(TexturePtr const & depth_tex);
 
+	private:
+		void KillDeadParticles(uint32_t begin);
+		void SortActiveParticles(float4x4 const & view_mat);
+		void FillInstanceData();
+
 	protected:
 		std::vector<ParticleEmitterPtr> emitters_;
 		std::vector<ParticleUpdaterPtr> updaters_;
 
-		std::vector<Particle> particles_;
-		std::vector<std::pair<uint32_t, float>> active_particles_;
+		// Particles [0, num_alive_) are alive, the rest of the store is free
+		ParticleStore particles_;
+		uint32_t num_alive_;
+		std::vector<uint32_t> active_particles_;
+
+		std::vector<float, aligned_allocator<float, 16>> depths_;
+		std::vector<uint32_t> sort_keys_;
+		std::vector<uint32_t> sort_tmp_keys_;
+		std::vector<uint32_t> sort_tmp_indices_;
+
+		// Instance data goes from SubThreadUpdate to MainThreadUpdate through a triple buffer. The update thread owns
+		//  snapshots_[write_snapshot_], the main thread owns snapshots_[read_snapshot_], and the third one is exchanged
+		//  atomically through ready_snapshot_ with SNAPSHOT_FRESH marking one that the main thread hasn't seen.
+		struct InstanceSnapshot
+		{
+			std::vector<uint8_t> data;
+			AABBox pos_bound;
+		};
+
+		static uint32_t const SNAPSHOT_FRESH = 4;
+
+		std::array<InstanceSnapshot, 3> snapshots_;
+		uint32_t write_snapshot_;
+		uint32_t read_snapshot_;
+		std::atomic<uint32_t> ready_snapshot_;
+		std::atomic<uint32_t> num_active_particles_;
 
 		float gravity_;
 		float3 force_;
@@ -352,8 +447,6 @@ namespace KlayGE
 		Color particle_color_to_;
 
 		bool gs_support_;
-
-		std::mutex update_mutex_;
 	};
 
 	KLAYGE_CORE_API ParticleSystemPtr SyncLoadParticleSystem(std::string const & psml_name);
@@ -392,6 +485,7 @@ namespace KlayGE
 		{
 			std::lock_guard<std::mutex> lock(update_mutex_);
 			size_over_life_ = size_over_life;
+			BuildRamps(size_ramps_, size_over_life_);
 		}
 		std::vector<float2> const & SizeOverLife() const
 		{
@@ -401,6 +495,7 @@ namespace KlayGE
 		{
 			std::lock_guard<std::mutex> lock(update_mutex_);
 			mass_over_life_ = mass_over_life;
+			BuildRamps(mass_ramps_, mass_over_life_);
 		}
 		std::vector<float2> const & MassOverLife() const
 		{
@@ -410,6 +505,7 @@ namespace KlayGE
 		{
 			std::lock_guard<std::mutex> lock(update_mutex_);
 			opacity_over_life_ = opacity_over_life;
+			BuildRamps(opacity_ramps_, opacity_over_life_);
 		}
 		std::vector<float2> const & OpacityOverLife() const
 		{
@@ -417,12 +513,30 @@ namespace KlayGE
 		}
 
 		virtual void Update(Particle& par, float elapse_time) override;
+		virtual void UpdateBatch(ParticleStore& store, uint32_t begin, uint32_t end, float elapse_time) override;
+
+	private:
+		// A polyline as a sum of clamped ramps, y0 + sum(dy * saturate((x - x_start) * inv_width)), to be evaluated
+		//  without searching for the segment.
+		struct PolylineRamps
+		{
+			float y0;
+			std::vector<float> x_start;
+			std::vector<float> inv_width;
+			std::vector<float> dy;
+		};
+
+		static void BuildRamps(PolylineRamps& ramps, std::vector<float2> const & polyline);
 
 	private:
 		std::mutex update_mutex_;
 		std::vector<float2> size_over_life_;
 		std::vector<float2> mass_over_life_;
 		std::vector<float2> opacity_over_life_;
+
+		PolylineRamps size_ramps_;
+		PolylineRamps mass_ramps_;
+		PolylineRamps opacity_ramps_;
 	};
 }
 
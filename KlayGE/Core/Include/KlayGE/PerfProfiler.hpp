@@ -36,16 +36,30 @@
 #include <KlayGE/PreDeclare.hpp>
 #include <KFL/Timer.hpp>
 
-#include <map>
+#include <atomic>
+#include <deque>
+#include <mutex>
 #include <string>
 #include <tuple>
 
+#include <boost/noncopyable.hpp>
+
+// Records a CPU zone from here to the end of the enclosing scope. The name must outlive the profiler, usually a
+//  string literal. Compiled out in shipping builds.
+#ifndef KLAYGE_SHIP
+	#define KLAYGE_PERF_ZONE_CONCAT_IMPL(a, b) a##b
+	#define KLAYGE_PERF_ZONE_CONCAT(a, b) KLAYGE_PERF_ZONE_CONCAT_IMPL(a, b)
+	#define KLAYGE_PERF_ZONE(name) KlayGE::PerfZone KLAYGE_PERF_ZONE_CONCAT(perf_zone_, __LINE__)(name)
+#else
+	#define KLAYGE_PERF_ZONE(name)
+#endif
+
 namespace KlayGE
 {
 	class KLAYGE_CORE_API PerfRange
 	{
 	public:
-		PerfRange();
+		explicit PerfRange(std::string const & name);
 
 		void Begin();
 		void End();
@@ -57,15 +71,36 @@ namespace KlayGE
 		bool Dirty() const;
 
 	private:
+		std::string name_;
+
 		Timer cpu_timer_;
+		uint64_t begin_timestamp_;
 		QueryPtr gpu_timer_query_;
 
 		double cpu_time_;
 		double gpu_time_;
 
 		bool dirty_;
+		// Whether the last Begin() started a zone and the query. The profiler can be toggled between Begin and End.
+		bool opened_;
+	};
+
+	struct PerfThreadZones;
+
+	class KLAYGE_CORE_API PerfZone : boost::noncopyable
+	{
+	public:
+		explicit PerfZone(char const * name);
+		~PerfZone();
+
+	private:
+		char const * name_;
+		uint64_t begin_timestamp_;
+		bool active_;
 	};
 
+	// Zones are recorded into a fixed size ring buffer per thread. Only the owning thread writes to its buffer, so
+	//  recording takes no lock. When a buffer is full, the oldest zones are overwritten.
 	class KLAYGE_CORE_API PerfProfiler
 	{
 	public:
@@ -77,16 +112,46 @@ namespace KlayGE
 		void Suspend();
 		void Resume();
 
+		bool Enabled() const
+		{
+			return enabled_.load(std::memory_order_relaxed);
+		}
+		void Enabled(bool enabled);
+
+		// Names the calling thread in exported timelines
+		void ThreadName(std::string const & name);
+
+		// CPU timestamp in ticks. Uses the time stamp counter where available.
+		static uint64_t Timestamp();
+		uint64_t BeginZone();
+		void EndZone(char const * name, uint64_t begin_timestamp);
+
 		PerfRangePtr CreatePerfRange(int category, std::string const & name);
 		void CollectData();
 
 		void ExportToCSV(std::string const & file_name) const;
+		// Writes the recorded zones of all threads in the Chrome trace event format, for chrome://tracing
+		void ExportToChromeTrace(std::string const & file_name) const;
+
+	private:
+		PerfThreadZones& CurrentThreadZones();
+		double TicksPerMicrosecond() const;
 
 	private:
 		static std::unique_ptr<PerfProfiler> perf_profiler_instance_;
 
+		std::atomic<bool> enabled_;
+		uint32_t generation_;
+
+		uint64_t start_timestamp_;
+		Timer start_timer_;
+
+		mutable std::mutex threads_mutex_;
+		std::vector<std::shared_ptr<PerfThreadZones>> threads_;
+
+		// Only the last MAX_HISTORY_FRAMES frames of each range are kept
 		std::vector<std::tuple<int, std::string, PerfRangePtr,
-			std::vector<std::tuple<uint32_t, double, double>>>> perf_ranges_;
+			std::deque<std::tuple<uint32_t, double, double>>>> perf_ranges_;
 		uint32_t frame_id_;
 	};
 }
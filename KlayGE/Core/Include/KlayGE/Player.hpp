@@ -18,11 +18,12 @@
 
 #pragma once
 
-#include <list>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
 #include <vector>
 
-#include <KFL/Thread.hpp>
-#include <KlayGE/Socket.hpp>
+#include <KlayGE/NetTransport.hpp>
 
 #ifndef KLAYGE_PLATFORM_WINDOWS_RUNTIME
 
@@ -54,18 +55,23 @@ namespace KlayGE
 		int Receive(void* buf, int maxSize, sockaddr_in& from);
 		int Send(void const * buf, int size);
 
-		void ReceiveFunc();
+	private:
+		void OnMessage(uint8_t const * data, uint32_t size);
+		bool WaitMessage(int type, std::vector<char>& msg, uint32_t timeout);
 
 	private:
-		Socket		socket_;
+		NetTransport	transport_;
+		uint32_t		lobby_;
+		sockaddr_in		lobbyAddr_;
 
 		char		playerID_;
 		std::string	name_;
 
-		joiner<void>	receiveThread_;
-		bool			receiveLoop_;
+		bool		joined_;
 
-		std::list<std::vector<char>> sendQueue_;
+		std::mutex				recvMutex_;
+		std::condition_variable	recvCond_;
+		std::deque<std::vector<char>> recvQueue_;
 	};
 }
 
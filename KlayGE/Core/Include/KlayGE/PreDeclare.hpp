@@ -46,6 +46,7 @@ namespace KlayGE
 	typedef std::shared_ptr<PerfProfiler> PerfProfilerPtr;
 
 	class SceneManager;
+	class OcclusionBuffer;
 	class SceneNode;
 	typedef std::shared_ptr<SceneNode> SceneNodePtr;
 	class SceneObject;
@@ -339,6 +340,8 @@ namespace KlayGE
 	typedef std::shared_ptr<UIProgressBar> UIProgressBarPtr;
 
 	class Socket;
+	class NetEventLoop;
+	class NetTransport;
 	class Lobby;
 	class Player;
 
@@ -347,6 +350,8 @@ namespace KlayGE
 	typedef std::shared_ptr<AudioBuffer> AudioBufferPtr;
 	class SoundBuffer;
 	class MusicBuffer;
+	class AudioStreamingService;
+	typedef std::shared_ptr<AudioStreamingService> AudioStreamingServicePtr;
 	class AudioDataSource;
 	typedef std::shared_ptr<AudioDataSource> AudioDataSourcePtr;
 	class AudioFactory;
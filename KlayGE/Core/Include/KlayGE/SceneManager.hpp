@@ -44,6 +44,11 @@ namespace KlayGE
 		void Resume();
 
 		void SmallObjectThreshold(float area);
+		// Rasterizes the biggest SOA_Occluder objects on screen into a CPU depth buffer, and drops cullable objects
+		//  hidden behind them.
+		void OcclusionCulling(bool enable);
+		bool OcclusionCulling() const;
+		OcclusionBuffer& GetOcclusionBuffer();
 		void SceneUpdateElapse(float elapse);
 		virtual void ClipScene();
 
@@ -88,6 +93,7 @@ namespace KlayGE
 		uint32_t NumVerticesRendered() const;
 		uint32_t NumDrawCalls() const;
 		uint32_t NumDispatchCalls() const;
+		uint32_t NumObjectsOccluded() const;
 
 	protected:
 		void Flush(uint32_t urt);
@@ -106,6 +112,9 @@ namespace KlayGE
 		BoundOverlap VisibleTestFromParent(SceneObject* obj, float3 const & view_dir, float3 const & eye_pos,
 			float4x4 const & view_proj);
 
+		void PrepareOcclusion(Camera const & camera, float4x4 const & view_proj);
+		BoundOverlap OcclusionTest(SceneObject const & obj, BoundOverlap visible);
+
 	protected:
 		std::vector<CameraPtr> cameras_;
 		Frustum const * frustum_;
@@ -118,6 +127,10 @@ namespace KlayGE
 		float small_obj_threshold_;
 		float update_elapse_;
 
+		bool occlusion_culling_;
+		bool occlusion_active_;
+		std::unique_ptr<OcclusionBuffer> occlusion_buffer_;
+
 	private:
 		void FlushScene();
 
@@ -132,9 +145,11 @@ namespace KlayGE
 		uint32_t num_vertices_rendered_;
 		uint32_t num_draw_calls_;
 		uint32_t num_dispatch_calls_;
+		uint32_t num_objects_occluded_;
 
 		std::mutex update_mutex_;
 		std::unique_ptr<joiner<void>> update_thread_;
+		std::vector<joiner<void>> parallel_update_joiners_;
 		volatile bool quit_;
 
 		bool deferred_mode_;
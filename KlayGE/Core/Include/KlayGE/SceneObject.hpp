@@ -35,7 +35,11 @@ namespace KlayGE
 			SOA_Moveable = 1UL << 2,
 			SOA_Invisible = 1UL << 3,
 			SOA_NotCastShadow = 1UL << 4,
-			SOA_SSS = 1UL << 5
+			SOA_SSS = 1UL << 5,
+			// SubThreadUpdate only touches the object itself, so it can run in parallel with other objects
+			SOA_ParallelUpdate = 1UL << 6,
+			// The bounds are treated as solid and may hide other objects when occlusion culling is on
+			SOA_Occluder = 1UL << 7
 		};
 
 	public:
@@ -95,6 +95,11 @@ namespace KlayGE
 		void TimeOut(uint32_t microSecs);
 		uint32_t TimeOut();
 
+		SOCKET NativeHandle() const
+		{
+			return socket_;
+		}
+
 	private:
 		SOCKET		socket_;
 	};
@@ -449,7 +449,9 @@ namespace KlayGE
 
 		std::array<std::vector<IRect >, UICT_Num_Control_Types> elem_texture_rcs_;
 
-		std::map<TexturePtr, RenderablePtr> rects_;
+		// All the quads of the dialogs, batched across dialogs and textures
+		RenderablePtr ui_batch_;
+		SceneObjectPtr ui_batch_obj_;
 
 		struct string_cache
 		{
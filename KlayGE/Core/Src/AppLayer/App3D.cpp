@@ -40,6 +40,7 @@
 #include <KlayGE/UI.hpp>
 #include <KlayGE/SceneManager.hpp>
 #include <KlayGE/DeferredRenderingLayer.hpp>
+#include <KlayGE/PerfProfiler.hpp>
 
 #include <boost/assert.hpp>
 
@@ -517,37 +518,45 @@ namespace KlayGE
 	App3DFramework::App3DFramework(std::string const & name)
 						: name_(name), total_num_frames_(0),
 							fps_(0), accumulate_time_(0), num_frames_(0),
-							app_time_(0), frame_time_(0)
+							app_time_(0), frame_time_(0),
+							quit_(false)
 	{
 		Context::Instance().AppInstance(*this);
 
 		ContextCfg cfg = Context::Instance().Config();
-		main_wnd_ = this->MakeWindow(name_, cfg.graphics_cfg);
+		if (!this->WindowLess(cfg))
+		{
+			main_wnd_ = this->MakeWindow(name_, cfg.graphics_cfg);
 #ifndef KLAYGE_PLATFORM_WINDOWS_RUNTIME
-		cfg.graphics_cfg.left = main_wnd_->Left();
-		cfg.graphics_cfg.top = main_wnd_->Top();
-		cfg.graphics_cfg.width = main_wnd_->Width();
-		cfg.graphics_cfg.height = main_wnd_->Height();
-		Context::Instance().Config(cfg);
+			cfg.graphics_cfg.left = main_wnd_->Left();
+			cfg.graphics_cfg.top = main_wnd_->Top();
+			cfg.graphics_cfg.width = main_wnd_->Width();
+			cfg.graphics_cfg.height = main_wnd_->Height();
+			Context::Instance().Config(cfg);
 #endif
+		}
 	}
 
 	App3DFramework::App3DFramework(std::string const & name, void* native_wnd)
 						: name_(name), total_num_frames_(0),
 							fps_(0), accumulate_time_(0), num_frames_(0),
-							app_time_(0), frame_time_(0)
+							app_time_(0), frame_time_(0),
+							quit_(false)
 	{
 		Context::Instance().AppInstance(*this);
 
 		ContextCfg cfg = Context::Instance().Config();
-		main_wnd_ = this->MakeWindow(name_, cfg.graphics_cfg, native_wnd);
+		if (!this->WindowLess(cfg))
+		{
+			main_wnd_ = this->MakeWindow(name_, cfg.graphics_cfg, native_wnd);
 #ifndef KLAYGE_PLATFORM_WINDOWS_RUNTIME
-		cfg.graphics_cfg.left = main_wnd_->Left();
-		cfg.graphics_cfg.top = main_wnd_->Top();
-		cfg.graphics_cfg.width = main_wnd_->Width();
-		cfg.graphics_cfg.height = main_wnd_->Height();
-		Context::Instance().Config(cfg);
+			cfg.graphics_cfg.left = main_wnd_->Left();
+			cfg.graphics_cfg.top = main_wnd_->Top();
+			cfg.graphics_cfg.width = main_wnd_->Width();
+			cfg.graphics_cfg.height = main_wnd_->Height();
+			Context::Instance().Config(cfg);
 #endif
+		}
 	}
 
 	App3DFramework::~App3DFramework()
@@ -568,6 +577,10 @@ namespace KlayGE
 	void App3DFramework::Create()
 	{
 #endif
+#ifndef KLAYGE_SHIP
+		PerfProfiler::Instance().ThreadName("Main");
+#endif
+
 		ContextCfg cfg = Context::Instance().Config();
 		Context::Instance().RenderFactoryInstance().RenderEngineInstance().CreateRenderWindow(name_,
 			cfg.graphics_cfg);
@@ -607,6 +620,12 @@ namespace KlayGE
 		Context::Instance().RenderFactoryInstance().RenderEngineInstance().Refresh();
 	}
 
+	bool App3DFramework::WindowLess(ContextCfg const & cfg)
+	{
+		// The null render engine never presents, so there is nothing to make a window for
+		return ("Null" == cfg.render_factory_name);
+	}
+
 	WindowPtr App3DFramework::MakeWindow(std::string const & name, RenderSettings const & settings)
 	{
 		return MakeSharedPtr<Window>(name, settings);
@@ -649,6 +668,18 @@ namespace KlayGE
 	{
 		RenderEngine& re = Context::Instance().RenderFactoryInstance().RenderEngineInstance();
 
+		if (!main_wnd_)
+		{
+			// No window, no messages to pump. Runs until Quit()
+			while (!quit_)
+			{
+				re.Refresh();
+			}
+
+			this->OnDestroy();
+			return;
+		}
+
 #if defined KLAYGE_PLATFORM_WINDOWS_DESKTOP
 		bool gotMsg;
 		MSG  msg;
@@ -805,6 +836,12 @@ namespace KlayGE
 	/////////////////////////////////////////////////////////////////////////////////
 	void App3DFramework::Quit()
 	{
+		if (!main_wnd_)
+		{
+			quit_ = true;
+			return;
+		}
+
 #ifdef KLAYGE_PLATFORM_WINDOWS
 #ifdef KLAYGE_PLATFORM_WINDOWS_DESKTOP
 		::PostQuitMessage(0);
@@ -818,6 +855,8 @@ namespace KlayGE
 	/////////////////////////////////////////////////////////////////////////////////
 	uint32_t App3DFramework::Update(uint32_t pass)
 	{
+		KLAYGE_PERF_ZONE("App3DFramework::Update");
+
 		if (0 == pass)
 		{
 			this->UpdateStats();
@@ -24,7 +24,8 @@ namespace KlayGE
 	// 캯
 	/////////////////////////////////////////////////////////////////////////////////
 	AudioEngine::AudioEngine()
-					: soundVol_(1),
+					: streaming_service_(MakeSharedPtr<AudioStreamingService>()),
+						soundVol_(1),
 						musicVol_(1)
 	{
 	}
@@ -158,4 +159,9 @@ namespace KlayGE
 	{
 		return musicVol_;
 	}
+
+	AudioStreamingServicePtr const & AudioEngine::StreamingService() const
+	{
+		return streaming_service_;
+	}
 }
@@ -0,0 +1,179 @@
+/**
+ * @file AudioStreamingService.cpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#include <KlayGE/KlayGE.hpp>
+#include <KlayGE/Context.hpp>
+
+#include <algorithm>
+
+#include <KlayGE/Audio.hpp>
+
+namespace
+{
+	// Safety net for streams that don't report a sooner deadline
+	uint32_t const MAX_SERVICE_INTERVAL_MS = 500;
+}
+
+namespace KlayGE
+{
+	AudioStreamingService::AudioStreamingService()
+		: servicing_(nullptr), quit_(false)
+	{
+	}
+
+	AudioStreamingService::~AudioStreamingService()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			quit_ = true;
+		}
+		wake_cond_.notify_one();
+
+		if (thread_)
+		{
+			(*thread_)();
+		}
+	}
+
+	void AudioStreamingService::Add(MusicBuffer* buffer)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+
+			auto const now = std::chrono::steady_clock::now();
+			auto iter = std::find_if(streams_.begin(), streams_.end(),
+				[buffer](Stream const & stream)
+				{
+					return stream.buffer == buffer;
+				});
+			if (iter != streams_.end())
+			{
+				iter->deadline = now;
+			}
+			else
+			{
+				Stream stream;
+				stream.buffer = buffer;
+				stream.deadline = now;
+				streams_.push_back(stream);
+			}
+
+			if (!thread_)
+			{
+				thread_ = MakeUniquePtr<joiner<void>>(Context::Instance().ThreadPool()(
+					[this]
+					{
+						this->ThreadFunc();
+					}));
+			}
+		}
+		wake_cond_.notify_one();
+	}
+
+	void AudioStreamingService::Remove(MusicBuffer* buffer)
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		while (servicing_ == buffer)
+		{
+			idle_cond_.wait(lock);
+		}
+
+		auto iter = std::find_if(streams_.begin(), streams_.end(),
+			[buffer](Stream const & stream)
+			{
+				return stream.buffer == buffer;
+			});
+		if (iter != streams_.end())
+		{
+			streams_.erase(iter);
+		}
+	}
+
+	size_t AudioStreamingService::NumStreams() const
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		return streams_.size();
+	}
+
+	void AudioStreamingService::ThreadFunc()
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		while (!quit_)
+		{
+			if (streams_.empty())
+			{
+				wake_cond_.wait(lock);
+				continue;
+			}
+
+			auto most_urgent = std::min_element(streams_.begin(), streams_.end(),
+				[](Stream const & lhs, Stream const & rhs)
+				{
+					return lhs.deadline < rhs.deadline;
+				});
+			if (most_urgent->deadline > std::chrono::steady_clock::now())
+			{
+				wake_cond_.wait_until(lock, most_urgent->deadline);
+				continue;
+			}
+
+			MusicBuffer* buffer = most_urgent->buffer;
+			servicing_ = buffer;
+			lock.unlock();
+
+			uint32_t next_service_ms = MAX_SERVICE_INTERVAL_MS;
+			bool const playing = buffer->ServiceStream(next_service_ms);
+
+			lock.lock();
+			servicing_ = nullptr;
+
+			// Other streams may be added or removed in the meantime
+			auto iter = std::find_if(streams_.begin(), streams_.end(),
+				[buffer](Stream const & stream)
+				{
+					return stream.buffer == buffer;
+				});
+			if (iter != streams_.end())
+			{
+				if (playing)
+				{
+					iter->deadline = std::chrono::steady_clock::now()
+						+ std::chrono::milliseconds(std::min(next_service_ms, MAX_SERVICE_INTERVAL_MS));
+				}
+				else
+				{
+					streams_.erase(iter);
+				}
+			}
+
+			idle_cond_.notify_all();
+		}
+	}
+}
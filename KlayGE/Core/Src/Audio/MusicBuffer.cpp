@@ -12,8 +12,13 @@
 
 #include <KlayGE/KlayGE.hpp>
 #include <KFL/ThrowErr.hpp>
+#include <KlayGE/Context.hpp>
+#include <KlayGE/AudioFactory.hpp>
 #include <KlayGE/AudioDataSource.hpp>
 
+#include <algorithm>
+#include <cstring>
+
 #include <boost/assert.hpp>
 
 #include <KlayGE/Audio.hpp>
@@ -25,8 +30,13 @@ namespace KlayGE
 	// 캯
 	/////////////////////////////////////////////////////////////////////////////////
 	MusicBuffer::MusicBuffer(AudioDataSourcePtr const & dataSource)
-					: AudioBuffer(dataSource)
+					: AudioBuffer(dataSource),
+						streaming_service_(Context::Instance().AudioFactoryInstance().AudioEngineInstance().StreamingService()),
+						loop_(false),
+						ring_read_(0), ring_size_(0), end_of_stream_(false)
 	{
+		// Decodes up to 1 second ahead
+		decode_ring_.resize(std::max(this->BytesPerSecond() & ~3U, 4U));
 	}
 
 	// 
@@ -63,10 +73,122 @@ namespace KlayGE
 	////////////////////////////////////////////////////////////////////////////////
 	void MusicBuffer::Stop()
 	{
+		streaming_service_->Remove(this);
 		if (this->IsPlaying())
 		{
 			this->DoStop();
-			dataSource_->Reset();
+			this->ResetDecoder();
+		}
+	}
+
+	bool MusicBuffer::ServiceStream(uint32_t& next_service_ms)
+	{
+		bool const playing = this->FeedDevice(next_service_ms);
+		if (playing)
+		{
+			this->DecodeAhead();
+		}
+		return playing;
+	}
+
+	size_t MusicBuffer::ReadDecoded(uint8_t* data, size_t size)
+	{
+		size_t read = 0;
+		while (read < size)
+		{
+			if (0 == ring_size_)
+			{
+				size_t const decoded = this->DecodeInto(data + read, size - read);
+				if (0 == decoded)
+				{
+					break;
+				}
+				read += decoded;
+			}
+			else
+			{
+				size_t const n = std::min(std::min(size - read, ring_size_), decode_ring_.size() - ring_read_);
+				std::memcpy(data + read, &decode_ring_[ring_read_], n);
+				ring_read_ = (ring_read_ + n) % decode_ring_.size();
+				ring_size_ -= n;
+				read += n;
+			}
 		}
+
+		return read;
+	}
+
+	void MusicBuffer::DecodeAhead()
+	{
+		while ((ring_size_ < decode_ring_.size()) && !end_of_stream_)
+		{
+			size_t const write = (ring_read_ + ring_size_) % decode_ring_.size();
+			size_t const n = std::min(decode_ring_.size() - ring_size_, decode_ring_.size() - write);
+			size_t const decoded = this->DecodeInto(&decode_ring_[write], n);
+			if (0 == decoded)
+			{
+				break;
+			}
+			ring_size_ += decoded;
+		}
+	}
+
+	void MusicBuffer::ResetDecoder()
+	{
+		dataSource_->Reset();
+		ring_read_ = 0;
+		ring_size_ = 0;
+		end_of_stream_ = false;
+	}
+
+	size_t MusicBuffer::DecodeInto(uint8_t* data, size_t size)
+	{
+		size_t decoded = 0;
+		bool rewound = false;
+		while ((decoded < size) && !end_of_stream_)
+		{
+			size_t const n = dataSource_->Read(data + decoded, size - decoded);
+			if (n > 0)
+			{
+				decoded += n;
+				rewound = false;
+			}
+			else if (loop_ && !rewound)
+			{
+				dataSource_->Reset();
+				rewound = true;
+			}
+			else
+			{
+				end_of_stream_ = true;
+			}
+		}
+
+		return decoded;
+	}
+
+	uint32_t MusicBuffer::BytesPerSecond() const
+	{
+		uint32_t bytes_per_frame;
+		switch (format_)
+		{
+		case AF_Mono8:
+			bytes_per_frame = 1;
+			break;
+
+		case AF_Mono16:
+		case AF_Stereo8:
+			bytes_per_frame = 2;
+			break;
+
+		case AF_Stereo16:
+			bytes_per_frame = 4;
+			break;
+
+		default:
+			THR(errc::function_not_supported);
+		}
+
+		return bytes_per_frame * freq_;
 	}
 }
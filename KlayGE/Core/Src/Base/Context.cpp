@@ -834,6 +834,10 @@ namespace KlayGE
 	{
 		cfg_ = cfg;
 
+#ifndef KLAYGE_SHIP
+		PerfProfiler::Instance().Enabled(cfg_.perf_profiler);
+#endif
+
 		if (this->RenderFactoryValid())
 		{
 			if (cfg_.deferred_rendering)
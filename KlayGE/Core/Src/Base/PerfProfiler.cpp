@@ -34,21 +34,93 @@
 #include <KlayGE/Query.hpp>
 #include <KFL/Thread.hpp>
 
+#include <algorithm>
+#include <chrono>
 #include <fstream>
 
+#if defined(KLAYGE_CPU_X86) || defined(KLAYGE_CPU_X64)
+	#if defined(KLAYGE_COMPILER_MSVC)
+		#include <intrin.h>
+	#else
+		#include <x86intrin.h>
+	#endif
+	#define KLAYGE_PERF_TSC_TIMESTAMP
+#endif
+
 #include <KlayGE/PerfProfiler.hpp>
 
 namespace
 {
+	using namespace KlayGE;
+
 	std::mutex singleton_mutex;
+
+	uint32_t const MAX_HISTORY_FRAMES = 1024;
+	uint32_t const ZONE_BUFFER_SIZE = 16384;
+	static_assert((ZONE_BUFFER_SIZE & (ZONE_BUFFER_SIZE - 1)) == 0, "ZONE_BUFFER_SIZE must be a power of 2.");
+
+	// Bumped for every profiler instance, so that threads register again after the profiler is recreated
+	std::atomic<uint32_t> profiler_generation(0);
+
+	struct ZoneRecord
+	{
+		char const * name;
+		uint64_t begin;
+		uint64_t end;
+		uint32_t depth;
+	};
+
+	void WriteJsonString(std::ostream& os, char const * str)
+	{
+		os << '"';
+		for (; *str; ++ str)
+		{
+			char const ch = *str;
+			if (('"' == ch) || ('\\' == ch))
+			{
+				os << '\\' << ch;
+			}
+			else if (static_cast<unsigned char>(ch) < 0x20)
+			{
+				os << ' ';
+			}
+			else
+			{
+				os << ch;
+			}
+		}
+		os << '"';
+	}
 }
 
 namespace KlayGE
 {
+	struct PerfThreadZones
+	{
+		uint32_t tid;
+		std::string name;
+
+		// Written by the owning thread only
+		uint32_t depth;
+		std::atomic<uint64_t> head;
+		std::vector<ZoneRecord> zones;
+	};
+
+	namespace
+	{
+		struct CurrentThreadZonesCache
+		{
+			std::shared_ptr<PerfThreadZones> zones;
+			uint32_t generation;
+		};
+
+		thread_local CurrentThreadZonesCache current_thread_zones;
+	}
+
 	std::unique_ptr<PerfProfiler> PerfProfiler::perf_profiler_instance_;
 
-	PerfRange::PerfRange()
-		: cpu_time_(0), gpu_time_(0), dirty_(false)
+	PerfRange::PerfRange(std::string const & name)
+		: name_(name), begin_timestamp_(0), cpu_time_(0), gpu_time_(0), dirty_(false), opened_(false)
 	{
 		RenderFactory& rf = Context::Instance().RenderFactoryInstance();
 		gpu_timer_query_ = rf.MakeTimerQuery();
@@ -56,10 +128,13 @@ namespace KlayGE
 
 	void PerfRange::Begin()
 	{
-		if (Context::Instance().Config().perf_profiler)
+		PerfProfiler& profiler = PerfProfiler::Instance();
+		if (profiler.Enabled())
 		{
 			dirty_ = true;
+			opened_ = true;
 			cpu_timer_.restart();
+			begin_timestamp_ = profiler.BeginZone();
 			if (gpu_timer_query_)
 			{
 				gpu_timer_query_->Begin();
@@ -69,9 +144,11 @@ namespace KlayGE
 
 	void PerfRange::End()
 	{
-		if (Context::Instance().Config().perf_profiler)
+		if (opened_)
 		{
+			opened_ = false;
 			cpu_time_ = cpu_timer_.elapsed();
+			PerfProfiler::Instance().EndZone(name_.c_str(), begin_timestamp_);
 			if (gpu_timer_query_)
 			{
 				gpu_timer_query_->End();
@@ -107,8 +184,31 @@ namespace KlayGE
 	}
 
 
+	PerfZone::PerfZone(char const * name)
+		: name_(name), begin_timestamp_(0)
+	{
+		PerfProfiler& profiler = PerfProfiler::Instance();
+		active_ = profiler.Enabled();
+		if (active_)
+		{
+			begin_timestamp_ = profiler.BeginZone();
+		}
+	}
+
+	PerfZone::~PerfZone()
+	{
+		if (active_)
+		{
+			PerfProfiler::Instance().EndZone(name_, begin_timestamp_);
+		}
+	}
+
+
 	PerfProfiler::PerfProfiler()
-		: frame_id_(0)
+		: enabled_(Context::Instance().Config().perf_profiler),
+			generation_(++ profiler_generation),
+			start_timestamp_(PerfProfiler::Timestamp()),
+			frame_id_(0)
 	{
 	}
 
@@ -139,9 +239,86 @@ namespace KlayGE
 	{
 	}
 
+	void PerfProfiler::Enabled(bool enabled)
+	{
+		enabled_.store(enabled, std::memory_order_relaxed);
+	}
+
+	void PerfProfiler::ThreadName(std::string const & name)
+	{
+		PerfThreadZones& zones = this->CurrentThreadZones();
+
+		std::lock_guard<std::mutex> lock(threads_mutex_);
+		zones.name = name;
+	}
+
+	uint64_t PerfProfiler::Timestamp()
+	{
+#ifdef KLAYGE_PERF_TSC_TIMESTAMP
+		// Assumes an invariant TSC, which is synchronized across cores on all recent x86 CPUs
+		return __rdtsc();
+#else
+		return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::high_resolution_clock::now().time_since_epoch()).count());
+#endif
+	}
+
+	uint64_t PerfProfiler::BeginZone()
+	{
+		++ this->CurrentThreadZones().depth;
+		return PerfProfiler::Timestamp();
+	}
+
+	void PerfProfiler::EndZone(char const * name, uint64_t begin_timestamp)
+	{
+		uint64_t const end_timestamp = PerfProfiler::Timestamp();
+
+		PerfThreadZones& zones = this->CurrentThreadZones();
+		BOOST_ASSERT(zones.depth > 0);
+		-- zones.depth;
+
+		uint64_t const head = zones.head.load(std::memory_order_relaxed);
+		ZoneRecord& record = zones.zones[head & (ZONE_BUFFER_SIZE - 1)];
+		record.name = name;
+		record.begin = begin_timestamp;
+		record.end = end_timestamp;
+		record.depth = zones.depth;
+		zones.head.store(head + 1, std::memory_order_release);
+	}
+
+	PerfThreadZones& PerfProfiler::CurrentThreadZones()
+	{
+		auto& cache = current_thread_zones;
+		if (!cache.zones || (cache.generation != generation_))
+		{
+			auto zones = MakeSharedPtr<PerfThreadZones>();
+			zones->depth = 0;
+			zones->head = 0;
+			zones->zones.resize(ZONE_BUFFER_SIZE);
+
+			{
+				std::lock_guard<std::mutex> lock(threads_mutex_);
+				zones->tid = static_cast<uint32_t>(threads_.size() + 1);
+				zones->name = "Thread " + std::to_string(zones->tid);
+				threads_.push_back(zones);
+			}
+
+			cache.zones = zones;
+			cache.generation = generation_;
+		}
+		return *cache.zones;
+	}
+
+	double PerfProfiler::TicksPerMicrosecond() const
+	{
+		double const elapsed_us = start_timer_.elapsed() * 1e6;
+		uint64_t const elapsed_ticks = PerfProfiler::Timestamp() - start_timestamp_;
+		return (elapsed_us > 0) ? std::max(elapsed_ticks / elapsed_us, 1e-6) : 1.0;
+	}
+
 	PerfRangePtr PerfProfiler::CreatePerfRange(int category, std::string const & name)
 	{
-		PerfRangePtr range = MakeSharedPtr<PerfRange>();
+		PerfRangePtr range = MakeSharedPtr<PerfRange>(name);
 		typedef std::remove_reference<decltype(std::get<3>(perf_ranges_[0]))>::type PerfDataType;
 		perf_ranges_.push_back(std::make_tuple(category, name, range, PerfDataType()));
 		return range;
@@ -149,7 +326,7 @@ namespace KlayGE
 
 	void PerfProfiler::CollectData()
 	{
-		if (Context::Instance().Config().perf_profiler)
+		if (this->Enabled())
 		{
 			RenderFactory& rf = Context::Instance().RenderFactoryInstance();
 			RenderEngine& re = rf.RenderEngineInstance();
@@ -160,7 +337,13 @@ namespace KlayGE
 				if (std::get<2>(range)->Dirty())
 				{
 					std::get<2>(range)->CollectData();
-					std::get<3>(range).push_back(std::make_tuple(frame_id_,
+
+					auto& history = std::get<3>(range);
+					if (history.size() >= MAX_HISTORY_FRAMES)
+					{
+						history.pop_front();
+					}
+					history.push_back(std::make_tuple(frame_id_,
 						std::get<2>(range)->CPUTime(), std::get<2>(range)->GPUTime()));
 				}
 			}
@@ -171,7 +354,7 @@ namespace KlayGE
 
 	void PerfProfiler::ExportToCSV(std::string const & file_name) const
 	{
-		if (Context::Instance().Config().perf_profiler)
+		if (this->Enabled())
 		{
 			std::ofstream ofs(file_name.c_str());
 			ofs << "Frame" << ',' << "Category" << ',' << "Name" << ','
@@ -194,4 +377,83 @@ namespace KlayGE
 			ofs << std::endl;
 		}
 	}
+
+	void PerfProfiler::ExportToChromeTrace(std::string const & file_name) const
+	{
+		double const ticks_per_us = this->TicksPerMicrosecond();
+
+		std::vector<std::pair<uint32_t, std::string>> thread_names;
+		std::vector<std::pair<uint32_t, std::vector<ZoneRecord>>> thread_zones;
+		{
+			std::lock_guard<std::mutex> lock(threads_mutex_);
+			for (auto const & zones : threads_)
+			{
+				thread_names.emplace_back(zones->tid, zones->name);
+
+				// Copies the valid part of the ring. Zones overwritten by the owner during the copy are dropped.
+				uint64_t const head = zones->head.load(std::memory_order_acquire);
+				uint64_t const first = (head > ZONE_BUFFER_SIZE) ? head - ZONE_BUFFER_SIZE : 0;
+				std::vector<ZoneRecord> records;
+				records.reserve(static_cast<size_t>(head - first));
+				for (uint64_t i = first; i < head; ++ i)
+				{
+					records.push_back(zones->zones[i & (ZONE_BUFFER_SIZE - 1)]);
+				}
+
+				// The owner may be writing zone new_head, whose slot is shared with zone new_head - ZONE_BUFFER_SIZE,
+				// so that one is dropped as well.
+				uint64_t const new_head = zones->head.load(std::memory_order_acquire);
+				uint64_t const new_first = (new_head >= ZONE_BUFFER_SIZE) ? new_head - ZONE_BUFFER_SIZE + 1 : 0;
+				if (new_first > first)
+				{
+					records.erase(records.begin(),
+						records.begin() + static_cast<size_t>(std::min(new_first - first, head - first)));
+				}
+
+				thread_zones.emplace_back(zones->tid, std::move(records));
+			}
+		}
+
+		std::ofstream ofs(file_name.c_str());
+		ofs.precision(3);
+		ofs << std::fixed;
+		ofs << "{\"traceEvents\":[" << std::endl;
+
+		bool first_event = true;
+		for (auto const & name : thread_names)
+		{
+			if (!first_event)
+			{
+				ofs << ',' << std::endl;
+			}
+			first_event = false;
+
+			ofs << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << name.first << ",\"args\":{\"name\":";
+			WriteJsonString(ofs, name.second.c_str());
+			ofs << "}}";
+		}
+
+		for (auto const & zones : thread_zones)
+		{
+			for (auto const & record : zones.second)
+			{
+				if (!first_event)
+				{
+					ofs << ',' << std::endl;
+				}
+				first_event = false;
+
+				int64_t const begin = static_cast<int64_t>(record.begin - start_timestamp_);
+				uint64_t const duration = (record.end > record.begin) ? record.end - record.begin : 0;
+
+				ofs << "{\"name\":";
+				WriteJsonString(ofs, record.name);
+				ofs << ",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":0,\"tid\":" << zones.first
+					<< ",\"ts\":" << begin / ticks_per_us << ",\"dur\":" << duration / ticks_per_us
+					<< ",\"args\":{\"depth\":" << record.depth << "}}";
+			}
+		}
+
+		ofs << std::endl << "],\"displayTimeUnit\":\"ms\"}" << std::endl;
+	}
 }
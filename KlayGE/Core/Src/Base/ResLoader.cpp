@@ -32,6 +32,7 @@
 #include <KFL/Util.hpp>
 #include <KlayGE/Extract7z.hpp>
 #include <KFL/CXX17/filesystem.hpp>
+#include <KlayGE/PerfProfiler.hpp>
 
 #include <fstream>
 #include <sstream>
@@ -715,6 +716,10 @@ namespace KlayGE
 
 	void ResLoader::LoadingThreadFunc()
 	{
+#ifndef KLAYGE_SHIP
+		PerfProfiler::Instance().ThreadName("Loading");
+#endif
+
 		while (!quit_)
 		{
 			std::pair<ResLoadingDescPtr, std::shared_ptr<volatile LoadingStatus>> res_pair;
@@ -722,6 +727,7 @@ namespace KlayGE
 			{
 				if (LS_Loading == *res_pair.second)
 				{
+					KLAYGE_PERF_ZONE("ResLoadingDesc::SubThreadStage");
 					res_pair.first->SubThreadStage();
 					*res_pair.second = LS_Complete;
 				}
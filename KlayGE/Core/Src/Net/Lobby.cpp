@@ -14,7 +14,6 @@
 #include <KlayGE/Player.hpp>
 
 #include <algorithm>
-#include <ctime>
 #include <cstring>
 
 #include <KlayGE/NetMsg.hpp>
@@ -27,8 +26,8 @@ namespace KlayGE
 	// 캯
 	/////////////////////////////////////////////////////////////////////////////////
 	Lobby::Lobby()
+		: running_(false)
 	{
-		this->socket_.Create(SOCK_DGRAM);
 	}
 
 	// 
@@ -38,11 +37,11 @@ namespace KlayGE
 		Close();
 	}
 
-	Lobby::PlayerAddrsIter Lobby::ID(sockaddr_in const & addr)
+	Lobby::PlayerAddrsIter Lobby::ID(uint32_t peer)
 	{
 		for (auto iter = players_.begin(); iter != players_.end(); ++ iter)
 		{
-			if (0 == std::memcmp(&addr, &(iter->second.addr), sizeof(addr)))
+			if ((iter->first != 0) && (iter->second.peer == peer))
 			{
 				return iter;
 			}
@@ -59,72 +58,78 @@ namespace KlayGE
 
 		this->MaxPlayers(maxPlayers);
 
-		this->socket_.Bind(TransAddr("", port));
+		sockAddr_ = TransAddr("", port);
+		transport_.Bind(port);
+
+		transport_.OnMessage([this, &pro](uint32_t peer, uint8_t const * data, uint32_t size)
+			{
+				this->OnMessage(peer, data, size, pro);
+			});
+		// Players silent longer than the peer timeout of the transport are dropped
+		transport_.OnPeerDisconnected([this, &pro](uint32_t peer)
+			{
+				char sendBuf[Max_Buffer];
+				int numSend = 0;
+				this->OnQuit(this->ID(peer), sendBuf, numSend, pro);
+			});
+
+		// Waits on the socket, not a busy loop. Close() from another thread stops it.
+		running_ = true;
+		while (running_)
+		{
+			transport_.Update(100);
+		}
+
+		transport_.Close();
+	}
+
+	void Lobby::OnMessage(uint32_t peer, uint8_t const * data, uint32_t size, Processor const & pro)
+	{
+		if (0 == size)
+		{
+			return;
+		}
 
 		sockaddr_in from;
+		transport_.PeerAddr(peer, from);
+
 		char revBuf[Max_Buffer];
+		std::fill_n(revBuf, sizeof(revBuf), 0);
+		std::memcpy(revBuf, data, std::min<uint32_t>(size, sizeof(revBuf)));
 		char sendBuf[Max_Buffer];
 		int numSend = 0;
-		for (;;)
-		{
-			this->Receive(revBuf, sizeof(revBuf), from);
 
-			// ÿϢǰ涼1ֽڵϢ
-			char* revPtr(&revBuf[1]);
-			char* sendPtr(&sendBuf[1]);
-			sendBuf[0] = revBuf[0];
+		// ÿϢǰ涼1ֽڵϢ
+		char* revPtr(&revBuf[1]);
+		char* sendPtr(&sendBuf[1]);
+		sendBuf[0] = revBuf[0];
 
-			switch (revBuf[0])
-			{
-			case MSG_JOIN:
-				this->OnJoin(revPtr, sendPtr, numSend, from, pro);
-				break;
+		switch (revBuf[0])
+		{
+		case MSG_JOIN:
+			this->OnJoin(revPtr, sendPtr, numSend, peer, from, pro);
+			break;
 
-			case MSG_QUIT:
-				this->OnQuit(this->ID(from), sendPtr, numSend, pro);
-				break;
+		case MSG_QUIT:
+			this->OnQuit(this->ID(peer), sendPtr, numSend, pro);
+			break;
 
-			case MSG_GETLOBBYINFO:
-				this->OnGetLobbyInfo(sendPtr, numSend, pro);
-				break;
+		case MSG_GETLOBBYINFO:
+			this->OnGetLobbyInfo(sendPtr, numSend, pro);
+			break;
 
-			case MSG_NOP:
-				this->OnNop(this->ID(from));
-				break;
+		case MSG_NOP:
+			// Keep-alive is handled by the transport
+			break;
 
-			default:
-				pro.OnDefault(revBuf, sizeof(revBuf), sendBuf, numSend, from);
-				break;
-			}
-
-			if (numSend != 0)
-			{
-				this->Send(sendBuf, numSend + 1, from);
-			}
-
-			// Ϣ
-			for (auto const & player : players_)
-			{
-				auto const & msgs = player.second.msgs;
-				for (auto const & msg : msgs)
-				{
-					socket_.SendTo(&msg[0], static_cast<int>(msg.size()), player.second.addr);
-				}
-			}
+		default:
+			pro.OnDefault(revBuf, sizeof(revBuf), sendBuf, numSend, from);
+			break;
+		}
 
-			// Ƿûʱ
-			for (auto iter = players_.begin(); iter != players_.end();)
-			{
-				// 20
-				if (std::time(nullptr) - iter->second.time >= 20 * 1000)
-				{
-					iter = players_.erase(iter);
-				}
-				else
-				{
-					++ iter;
-				}
-			}
+		if (numSend != 0)
+		{
+			transport_.Send(peer, sendBuf, numSend + 1);
 		}
 	}
 
@@ -175,6 +180,7 @@ namespace KlayGE
 		for (auto& player : players_)
 		{
 			player.first = 0;
+			player.second.peer = NetTransport::INVALID_PEER;
 		}
 	}
 
@@ -189,32 +195,33 @@ namespace KlayGE
 	/////////////////////////////////////////////////////////////////////////////////
 	void Lobby::Close()
 	{
-		this->socket_.Close();
+		running_ = false;
 	}
 
 	// 
 	/////////////////////////////////////////////////////////////////////////////////
-	int Lobby::Receive(void* buf, int maxSize, sockaddr_in& from)
-	{
-		return this->socket_.ReceiveFrom(buf, maxSize, from);
-	}
-
-	// 
-	/////////////////////////////////////////////////////////////////////////////////
 	int Lobby::Send(void const * buf, int maxSize, sockaddr_in const & to)
 	{
-		return this->socket_.SendTo(buf, maxSize, to);
+		return transport_.Send(transport_.PeerByAddr(to), buf, maxSize) ? maxSize : -1;
 	}
 
 
 	void Lobby::OnJoin(char* revBuf, char* sendBuf, int& numSend,
-							sockaddr_in& from, Processor const & pro)
+							uint32_t peer, sockaddr_in& from, Processor const & pro)
 	{
 		// ʽ:
 		//			Player		16 ֽ
 
+		auto iter = this->ID(peer);
+		if (iter != players_.end())
+		{
+			sendBuf[0] = static_cast<char>(iter->first);
+			numSend = 1;
+			return;
+		}
+
 		char id = 1;
-		auto iter = players_.begin();
+		iter = players_.begin();
 		for (; iter != this->players_.end(); ++ iter, ++ id)
 		{
 			if (0 == iter->first)
@@ -228,6 +235,7 @@ namespace KlayGE
 				iter->first			= id;
 				iter->second.name	= name;
 				iter->second.addr	= from;
+				iter->second.peer	= peer;
 
 				pro.OnJoin(iter->first);
 				break;
@@ -240,11 +248,11 @@ namespace KlayGE
 		// Ѿ
 		if (iter == players_.end())
 		{
-			sendBuf[0] = 1;
+			sendBuf[0] = 0;
 		}
 		else
 		{
-			sendBuf[0] = 0;
+			sendBuf[0] = static_cast<char>(iter->first);
 		}
 
 		numSend = 1;
@@ -280,14 +288,6 @@ namespace KlayGE
 		this->LobbyName().copy(&sendBuf[2], this->LobbyName().length());
 		numSend = 18;
 	}
-
-	void Lobby::OnNop(PlayerAddrsIter iter)
-	{
-		if (iter != this->players_.end())
-		{
-			iter->second.time = static_cast<uint32_t>(std::time(nullptr));
-		}
-	}
 }
 
 #endif
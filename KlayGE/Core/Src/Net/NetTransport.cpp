@@ -0,0 +1,997 @@
+/**
+ * @file NetTransport.cpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/ThrowErr.hpp>
+#include <KFL/Util.hpp>
+#include <KlayGE/Context.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <boost/assert.hpp>
+
+#if defined(KLAYGE_PLATFORM_LINUX) || defined(KLAYGE_PLATFORM_ANDROID)
+	#include <sys/epoll.h>
+	#include <unistd.h>
+#endif
+
+#include <KlayGE/NetTransport.hpp>
+
+#ifndef KLAYGE_PLATFORM_WINDOWS_RUNTIME
+
+namespace
+{
+	using namespace KlayGE;
+
+	// Datagram layout, all little endian:
+	//		protocol id		2 bytes, PROTOCOL_ID_JOIN until anything is received from the peer
+	//		sequence		2 bytes
+	//		ack				2 bytes, the latest sequence received from the peer
+	//		ack bits		4 bytes, bit i set if sequence (ack - 1 - i) is received
+	//		messages		each one is
+	//							size and flag	2 bytes, the highest bit marks a reliable message
+	//							message id		2 bytes, only for reliable messages
+	//							payload
+	uint16_t const PROTOCOL_ID = 0x4B47;
+	// Only datagrams with this id create peers, so stray traffic can't fill the peer table
+	uint16_t const PROTOCOL_ID_JOIN = 0x4B48;
+	uint32_t const PACKET_HEADER_SIZE = 10;
+	uint16_t const RELIABLE_FLAG = 0x8000;
+
+	// All sizes are powers of 2
+	uint32_t const SENT_PACKET_WINDOW = 1024;
+	uint32_t const RELIABLE_WINDOW = 1024;
+	// Datagrams older than this many sequences can't be told from duplicates and are dropped
+	uint32_t const RECV_HISTORY = 1024;
+	uint32_t const RECV_HISTORY_VALID = 0x10000;
+	uint32_t const MAX_RELIABLE_PER_PACKET = 64;
+
+	uint32_t const RECV_BATCH = 32;
+
+	bool SeqGreater(uint16_t lhs, uint16_t rhs)
+	{
+		return static_cast<int16_t>(lhs - rhs) > 0;
+	}
+
+	uint64_t NowMs()
+	{
+		return std::chrono::duration_cast<std::chrono::milliseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	uint64_t AddrKey(sockaddr_in const & addr)
+	{
+		return (static_cast<uint64_t>(addr.sin_addr.s_addr) << 16) | addr.sin_port;
+	}
+
+	void Write16(uint8_t* p, uint16_t v)
+	{
+		v = Native2LE(v);
+		std::memcpy(p, &v, sizeof(v));
+	}
+
+	void Write32(uint8_t* p, uint32_t v)
+	{
+		v = Native2LE(v);
+		std::memcpy(p, &v, sizeof(v));
+	}
+
+	uint16_t Read16(uint8_t const * p)
+	{
+		uint16_t v;
+		std::memcpy(&v, p, sizeof(v));
+		return LE2Native(v);
+	}
+
+	uint32_t Read32(uint8_t const * p)
+	{
+		uint32_t v;
+		std::memcpy(&v, p, sizeof(v));
+		return LE2Native(v);
+	}
+}
+
+namespace KlayGE
+{
+	NetEventLoop::NetEventLoop()
+	{
+#if defined(KLAYGE_PLATFORM_LINUX) || defined(KLAYGE_PLATFORM_ANDROID)
+		epoll_fd_ = epoll_create1(0);
+		Verify(epoll_fd_ != -1);
+#endif
+	}
+
+	NetEventLoop::~NetEventLoop()
+	{
+#if defined(KLAYGE_PLATFORM_LINUX) || defined(KLAYGE_PLATFORM_ANDROID)
+		close(epoll_fd_);
+#endif
+	}
+
+	void NetEventLoop::Add(Socket const & socket, std::function<void()> const & on_readable)
+	{
+		SOCKET const s = socket.NativeHandle();
+		BOOST_ASSERT(s != INVALID_SOCKET);
+
+#if defined(KLAYGE_PLATFORM_LINUX) || defined(KLAYGE_PLATFORM_ANDROID)
+		epoll_event ev;
+		std::memset(&ev, 0, sizeof(ev));
+		ev.events = EPOLLIN;
+		ev.data.fd = s;
+		Verify(epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, s, &ev) != -1);
+#endif
+
+		handlers_[s] = on_readable;
+	}
+
+	void NetEventLoop::Remove(Socket const & socket)
+	{
+		SOCKET const s = socket.NativeHandle();
+
+#if defined(KLAYGE_PLATFORM_LINUX) || defined(KLAYGE_PLATFORM_ANDROID)
+		epoll_event ev;
+		std::memset(&ev, 0, sizeof(ev));
+		epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, s, &ev);
+#endif
+
+		handlers_.erase(s);
+	}
+
+	uint32_t NetEventLoop::Poll(uint32_t timeout_ms)
+	{
+		ready_.clear();
+
+#if defined(KLAYGE_PLATFORM_LINUX) || defined(KLAYGE_PLATFORM_ANDROID)
+		epoll_event events[64];
+		int const n = epoll_wait(epoll_fd_, events, static_cast<int>(sizeof(events) / sizeof(events[0])), static_cast<int>(timeout_ms));
+		for (int i = 0; i < n; ++ i)
+		{
+			ready_.push_back(events[i].data.fd);
+		}
+#else
+		if (handlers_.empty())
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(timeout_ms));
+			return 0;
+		}
+
+		fd_set read_fds;
+		FD_ZERO(&read_fds);
+		SOCKET max_fd = 0;
+		for (auto const & handler : handlers_)
+		{
+			FD_SET(handler.first, &read_fds);
+			max_fd = std::max(max_fd, handler.first);
+		}
+
+		timeval tv;
+		tv.tv_sec = timeout_ms / 1000;
+		tv.tv_usec = (timeout_ms % 1000) * 1000;
+		if (select(static_cast<int>(max_fd + 1), &read_fds, nullptr, nullptr, &tv) > 0)
+		{
+			for (auto const & handler : handlers_)
+			{
+				if (FD_ISSET(handler.first, &read_fds))
+				{
+					ready_.push_back(handler.first);
+				}
+			}
+		}
+#endif
+
+		uint32_t num_called = 0;
+		for (auto const s : ready_)
+		{
+			// A handler can remove sockets, so look each one up again
+			auto iter = handlers_.find(s);
+			if (iter != handlers_.end())
+			{
+				iter->second();
+				++ num_called;
+			}
+		}
+
+		return num_called;
+	}
+
+
+	struct NetTransport::Peer
+	{
+		struct OutMessage
+		{
+			uint16_t id;
+			bool acked;
+			uint64_t last_send_time;
+			std::vector<uint8_t> data;
+		};
+
+		struct SentPacket
+		{
+			bool valid;
+			uint16_t seq;
+			uint64_t send_time;
+			uint32_t num_msgs;
+			uint16_t msg_ids[MAX_RELIABLE_PER_PACKET];
+		};
+
+		uint32_t id;
+		sockaddr_in addr;
+
+		uint16_t next_packet_seq;
+		uint16_t next_msg_id;
+		std::deque<OutMessage> reliable_out;
+		std::vector<uint8_t> unreliable_out;
+		std::vector<SentPacket> sent_packets;
+		float srtt;
+		uint32_t rto;
+		uint64_t last_send_time;
+
+		bool has_remote_seq;
+		uint16_t remote_seq;
+		uint32_t ack_bits;
+		std::vector<uint32_t> received_seqs;
+		bool ack_pending;
+		uint16_t next_recv_msg_id;
+		std::unordered_map<uint16_t, std::vector<uint8_t>> reorder_buffer;
+		uint64_t last_recv_time;
+	};
+
+
+	NetTransport::Settings::Settings()
+		: mtu(1200), flush_interval_ms(5), min_resend_ms(50), max_resend_ms(1000),
+			keep_alive_ms(1000), peer_timeout_ms(20 * 1000)
+	{
+	}
+
+
+	NetTransport::NetTransport()
+		: NetTransport(Settings())
+	{
+	}
+
+	NetTransport::NetTransport(Settings const & settings)
+		: settings_(settings), bound_(false), next_peer_id_(INVALID_PEER + 1), running_(false)
+	{
+		BOOST_ASSERT(settings_.mtu > PACKET_HEADER_SIZE + 4);
+
+		recv_buffer_.resize(RECV_BATCH * settings_.mtu);
+		send_buffer_.resize(settings_.mtu);
+		std::memset(&stats_, 0, sizeof(stats_));
+	}
+
+	NetTransport::~NetTransport()
+	{
+		this->Close();
+	}
+
+	void NetTransport::Bind(uint16_t port)
+	{
+		this->Close();
+
+		socket_.Create(SOCK_DGRAM);
+		socket_.Bind(TransAddr("", port));
+		socket_.NonBlock(true);
+		loop_.Add(socket_, [this]
+			{
+				this->ReceiveDatagrams();
+			});
+		bound_ = true;
+	}
+
+	uint16_t NetTransport::Port()
+	{
+		sockaddr_in addr;
+		socklen_t len = sizeof(addr);
+		socket_.SockName(addr, len);
+		return ntohs(addr.sin_port);
+	}
+
+	void NetTransport::Close()
+	{
+		this->Stop();
+
+		if (bound_)
+		{
+			loop_.Remove(socket_);
+			socket_.Close();
+			bound_ = false;
+		}
+
+		std::lock_guard<std::mutex> lock(mutex_);
+		peers_.clear();
+		peer_by_addr_.clear();
+	}
+
+	uint32_t NetTransport::Connect(sockaddr_in const & addr)
+	{
+		if (!bound_)
+		{
+			this->Bind(0);
+		}
+
+		std::lock_guard<std::mutex> lock(mutex_);
+		auto iter = peer_by_addr_.find(AddrKey(addr));
+		if (iter != peer_by_addr_.end())
+		{
+			return iter->second;
+		}
+		return this->AddPeer(addr, NowMs()).id;
+	}
+
+	void NetTransport::Disconnect(uint32_t peer)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		auto iter = peers_.find(peer);
+		if (iter != peers_.end())
+		{
+			peer_by_addr_.erase(AddrKey(iter->second->addr));
+			peers_.erase(iter);
+		}
+	}
+
+	uint32_t NetTransport::PeerByAddr(sockaddr_in const & addr) const
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		auto iter = peer_by_addr_.find(AddrKey(addr));
+		return (iter != peer_by_addr_.end()) ? iter->second : INVALID_PEER;
+	}
+
+	bool NetTransport::PeerAddr(uint32_t peer, sockaddr_in& addr) const
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		Peer const * p = this->FindPeer(peer);
+		if (p)
+		{
+			addr = p->addr;
+			return true;
+		}
+		return false;
+	}
+
+	size_t NetTransport::NumPeers() const
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		return peers_.size();
+	}
+
+	void NetTransport::OnMessage(MessageHandler const & handler)
+	{
+		on_message_ = handler;
+	}
+
+	void NetTransport::OnPeerConnected(PeerHandler const & handler)
+	{
+		on_connected_ = handler;
+	}
+
+	void NetTransport::OnPeerDisconnected(PeerHandler const & handler)
+	{
+		on_disconnected_ = handler;
+	}
+
+	bool NetTransport::Send(uint32_t peer, void const * data, uint32_t size, bool reliable)
+	{
+		if ((size > MAX_MESSAGE_SIZE) || (size + PACKET_HEADER_SIZE + 4 > settings_.mtu))
+		{
+			return false;
+		}
+
+		std::lock_guard<std::mutex> lock(mutex_);
+
+		Peer* p = this->FindPeer(peer);
+		if (!p)
+		{
+			return false;
+		}
+
+		uint8_t const * bytes = static_cast<uint8_t const *>(data);
+		if (reliable)
+		{
+			Peer::OutMessage msg;
+			msg.id = p->next_msg_id;
+			msg.acked = false;
+			msg.last_send_time = 0;
+			msg.data.assign(bytes, bytes + size);
+			p->reliable_out.push_back(std::move(msg));
+			++ p->next_msg_id;
+		}
+		else
+		{
+			size_t const offset = p->unreliable_out.size();
+			p->unreliable_out.resize(offset + 2 + size);
+			Write16(&p->unreliable_out[offset], static_cast<uint16_t>(size));
+			std::memcpy(&p->unreliable_out[offset + 2], bytes, size);
+		}
+
+		return true;
+	}
+
+	bool NetTransport::Flush(uint32_t peer, uint32_t timeout_ms)
+	{
+		uint64_t const deadline = NowMs() + timeout_ms;
+		for (;;)
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				Peer const * p = this->FindPeer(peer);
+				if (!p)
+				{
+					return false;
+				}
+				if (p->reliable_out.empty())
+				{
+					return true;
+				}
+			}
+
+			if (NowMs() >= deadline)
+			{
+				return false;
+			}
+
+			if (running_)
+			{
+				std::this_thread::sleep_for(std::chrono::milliseconds(settings_.flush_interval_ms));
+			}
+			else
+			{
+				this->Update(settings_.flush_interval_ms);
+			}
+		}
+	}
+
+	void NetTransport::Update(uint32_t timeout_ms)
+	{
+		if (!bound_)
+		{
+			return;
+		}
+
+		loop_.Poll(std::min(timeout_ms, settings_.flush_interval_ms));
+
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			this->UpdatePeers(NowMs());
+		}
+
+		this->DispatchEvents();
+	}
+
+	void NetTransport::Start()
+	{
+		if (!running_)
+		{
+			running_ = true;
+			thread_ = MakeUniquePtr<joiner<void>>(Context::Instance().ThreadPool()([this]
+				{
+					while (running_)
+					{
+						this->Update(settings_.flush_interval_ms);
+					}
+				}));
+		}
+	}
+
+	void NetTransport::Stop()
+	{
+		if (running_)
+		{
+			running_ = false;
+			(*thread_)();
+			thread_.reset();
+
+			this->Update(0);
+		}
+	}
+
+	NetTransport::Stats NetTransport::Statistics() const
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		return stats_;
+	}
+
+	void NetTransport::ReceiveDatagrams()
+	{
+		uint32_t const mtu = settings_.mtu;
+
+		for (;;)
+		{
+			sockaddr_in addrs[RECV_BATCH];
+			uint32_t sizes[RECV_BATCH];
+			uint32_t num_received = 0;
+
+#ifdef KLAYGE_PLATFORM_LINUX
+			mmsghdr msgs[RECV_BATCH];
+			iovec iovs[RECV_BATCH];
+			std::memset(msgs, 0, sizeof(msgs));
+			for (uint32_t i = 0; i < RECV_BATCH; ++ i)
+			{
+				iovs[i].iov_base = &recv_buffer_[i * mtu];
+				iovs[i].iov_len = mtu;
+				msgs[i].msg_hdr.msg_iov = &iovs[i];
+				msgs[i].msg_hdr.msg_iovlen = 1;
+				msgs[i].msg_hdr.msg_name = &addrs[i];
+				msgs[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+			}
+
+			int const n = recvmmsg(socket_.NativeHandle(), msgs, RECV_BATCH, MSG_DONTWAIT, nullptr);
+			if (n > 0)
+			{
+				num_received = n;
+				for (uint32_t i = 0; i < num_received; ++ i)
+				{
+					sizes[i] = msgs[i].msg_len;
+				}
+			}
+#else
+			while (num_received < RECV_BATCH)
+			{
+				int const n = socket_.ReceiveFrom(&recv_buffer_[num_received * mtu], mtu, addrs[num_received]);
+				if (n <= 0)
+				{
+					break;
+				}
+				sizes[num_received] = n;
+				++ num_received;
+			}
+#endif
+
+			if (0 == num_received)
+			{
+				break;
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				uint64_t const now = NowMs();
+				for (uint32_t i = 0; i < num_received; ++ i)
+				{
+					this->ProcessDatagram(addrs[i], &recv_buffer_[i * mtu], sizes[i], now);
+				}
+			}
+
+			// The messages point into recv_buffer_, hand them out before it's reused
+			this->DispatchEvents();
+
+			if (num_received < RECV_BATCH)
+			{
+				break;
+			}
+		}
+	}
+
+	void NetTransport::ProcessDatagram(sockaddr_in const & from, uint8_t const * data, uint32_t size, uint64_t now)
+	{
+		if (size < PACKET_HEADER_SIZE)
+		{
+			return;
+		}
+		uint16_t const protocol_id = Read16(data);
+		if ((protocol_id != PROTOCOL_ID) && (protocol_id != PROTOCOL_ID_JOIN))
+		{
+			return;
+		}
+
+		Peer* p;
+		auto iter = peer_by_addr_.find(AddrKey(from));
+		if (iter != peer_by_addr_.end())
+		{
+			p = peers_[iter->second].get();
+		}
+		else if (PROTOCOL_ID_JOIN == protocol_id)
+		{
+			p = &this->AddPeer(from, now);
+			connected_peers_.push_back(p->id);
+		}
+		else
+		{
+			return;
+		}
+
+		++ stats_.datagrams_received;
+		stats_.bytes_received += size;
+		Peer& peer = *p;
+		peer.last_recv_time = now;
+
+		uint16_t const seq = Read16(data + 2);
+		uint16_t const ack = Read16(data + 4);
+		uint32_t const ack_bits = Read32(data + 6);
+
+		bool duplicated = false;
+		if (!peer.has_remote_seq)
+		{
+			peer.has_remote_seq = true;
+			peer.remote_seq = seq;
+			peer.ack_bits = 0;
+		}
+		else if (SeqGreater(seq, peer.remote_seq))
+		{
+			uint32_t const shift = static_cast<uint16_t>(seq - peer.remote_seq);
+			peer.ack_bits = (shift < 32) ? (peer.ack_bits << shift) : 0;
+			if (shift <= 32)
+			{
+				peer.ack_bits |= 1U << (shift - 1);
+			}
+			peer.remote_seq = seq;
+		}
+		else
+		{
+			uint32_t const diff = static_cast<uint16_t>(peer.remote_seq - seq);
+			if ((diff > 0) && (diff <= 32))
+			{
+				peer.ack_bits |= 1U << (diff - 1);
+			}
+			if (diff >= RECV_HISTORY)
+			{
+				duplicated = true;
+			}
+		}
+
+		// ack_bits only covers 32 datagrams, the history catches duplicates delayed further than that
+		if (!duplicated)
+		{
+			uint32_t& received = peer.received_seqs[seq & (RECV_HISTORY - 1)];
+			duplicated = (received == (seq | RECV_HISTORY_VALID));
+			received = seq | RECV_HISTORY_VALID;
+		}
+
+		this->ProcessAcks(peer, ack, ack_bits, now);
+
+		if (duplicated)
+		{
+			++ stats_.duplicates;
+			return;
+		}
+
+		uint32_t pos = PACKET_HEADER_SIZE;
+		while (pos + 2 <= size)
+		{
+			uint16_t const size_flag = Read16(data + pos);
+			pos += 2;
+
+			bool const reliable = (size_flag & RELIABLE_FLAG) != 0;
+			uint32_t const msg_size = size_flag & ~RELIABLE_FLAG;
+			uint16_t msg_id = 0;
+			if (reliable)
+			{
+				if (pos + 2 > size)
+				{
+					break;
+				}
+				msg_id = Read16(data + pos);
+				pos += 2;
+			}
+			if (pos + msg_size > size)
+			{
+				break;
+			}
+
+			if (reliable)
+			{
+				this->DeliverReliable(peer, msg_id, data + pos, msg_size);
+			}
+			else
+			{
+				Delivery const delivery = { peer.id, data + pos, msg_size };
+				deliveries_.push_back(delivery);
+				++ stats_.messages_received;
+			}
+
+			peer.ack_pending = true;
+			pos += msg_size;
+		}
+	}
+
+	void NetTransport::ProcessAcks(Peer& peer, uint16_t ack, uint32_t ack_bits, uint64_t now)
+	{
+		for (uint32_t i = 0; i <= 32; ++ i)
+		{
+			if ((i > 0) && !(ack_bits & (1U << (i - 1))))
+			{
+				continue;
+			}
+
+			uint16_t const seq = static_cast<uint16_t>(ack - i);
+			Peer::SentPacket& sp = peer.sent_packets[seq & (SENT_PACKET_WINDOW - 1)];
+			if (sp.valid && (sp.seq == seq))
+			{
+				sp.valid = false;
+
+				float const rtt = static_cast<float>(now - sp.send_time);
+				peer.srtt = (peer.srtt < 0) ? rtt : (peer.srtt * 0.875f + rtt * 0.125f);
+				peer.rto = std::min(std::max(static_cast<uint32_t>(peer.srtt * 2), settings_.min_resend_ms),
+					settings_.max_resend_ms);
+
+				if (!peer.reliable_out.empty())
+				{
+					uint16_t const front_id = peer.reliable_out.front().id;
+					for (uint32_t m = 0; m < sp.num_msgs; ++ m)
+					{
+						uint16_t const index = static_cast<uint16_t>(sp.msg_ids[m] - front_id);
+						if (index < peer.reliable_out.size())
+						{
+							peer.reliable_out[index].acked = true;
+						}
+					}
+				}
+			}
+		}
+
+		while (!peer.reliable_out.empty() && peer.reliable_out.front().acked)
+		{
+			peer.reliable_out.pop_front();
+		}
+	}
+
+	void NetTransport::DeliverReliable(Peer& peer, uint16_t msg_id, uint8_t const * data, uint32_t size)
+	{
+		if (msg_id == peer.next_recv_msg_id)
+		{
+			Delivery const delivery = { peer.id, data, size };
+			deliveries_.push_back(delivery);
+			++ stats_.messages_received;
+			++ peer.next_recv_msg_id;
+
+			for (;;)
+			{
+				auto iter = peer.reorder_buffer.find(peer.next_recv_msg_id);
+				if (iter == peer.reorder_buffer.end())
+				{
+					break;
+				}
+
+				delivered_copies_.push_back(std::move(iter->second));
+				peer.reorder_buffer.erase(iter);
+
+				auto const & copy = delivered_copies_.back();
+				Delivery const buffered = { peer.id, copy.empty() ? nullptr : &copy[0], static_cast<uint32_t>(copy.size()) };
+				deliveries_.push_back(buffered);
+				++ stats_.messages_received;
+				++ peer.next_recv_msg_id;
+			}
+		}
+		else if (SeqGreater(msg_id, peer.next_recv_msg_id)
+			&& (static_cast<uint16_t>(msg_id - peer.next_recv_msg_id) < RELIABLE_WINDOW))
+		{
+			if (!peer.reorder_buffer.emplace(msg_id, std::vector<uint8_t>(data, data + size)).second)
+			{
+				++ stats_.duplicates;
+			}
+		}
+		else
+		{
+			// Already delivered, the ack of it was lost
+			++ stats_.duplicates;
+		}
+	}
+
+	void NetTransport::UpdatePeers(uint64_t now)
+	{
+		for (auto iter = peers_.begin(); iter != peers_.end();)
+		{
+			Peer& peer = *iter->second;
+			if (now - peer.last_recv_time >= settings_.peer_timeout_ms)
+			{
+				disconnected_peers_.push_back(peer.id);
+				peer_by_addr_.erase(AddrKey(peer.addr));
+				iter = peers_.erase(iter);
+			}
+			else
+			{
+				this->FlushPeer(peer, now);
+				++ iter;
+			}
+		}
+	}
+
+	void NetTransport::FlushPeer(Peer& peer, uint64_t now)
+	{
+		uint32_t const mtu = settings_.mtu;
+		uint8_t* buf = &send_buffer_[0];
+
+		uint32_t pos = PACKET_HEADER_SIZE;
+		uint16_t reliable_ids[MAX_RELIABLE_PER_PACKET];
+		uint32_t num_reliable = 0;
+
+		auto send_packet = [&]
+		{
+			uint16_t const seq = peer.next_packet_seq;
+			++ peer.next_packet_seq;
+
+			Write16(buf + 0, peer.has_remote_seq ? PROTOCOL_ID : PROTOCOL_ID_JOIN);
+			Write16(buf + 2, seq);
+			Write16(buf + 4, peer.remote_seq);
+			Write32(buf + 6, peer.ack_bits);
+
+			Peer::SentPacket& sp = peer.sent_packets[seq & (SENT_PACKET_WINDOW - 1)];
+			sp.valid = true;
+			sp.seq = seq;
+			sp.send_time = now;
+			sp.num_msgs = num_reliable;
+			std::copy(reliable_ids, reliable_ids + num_reliable, sp.msg_ids);
+
+			socket_.SendTo(buf, static_cast<int>(pos), peer.addr);
+
+			++ stats_.datagrams_sent;
+			stats_.bytes_sent += pos;
+
+			peer.ack_pending = false;
+			peer.last_send_time = now;
+
+			pos = PACKET_HEADER_SIZE;
+			num_reliable = 0;
+		};
+
+		// Receivers only buffer RELIABLE_WINDOW messages ahead, the rest waits for acks
+		size_t const num_in_window = std::min<size_t>(peer.reliable_out.size(), RELIABLE_WINDOW);
+		for (size_t i = 0; i < num_in_window; ++ i)
+		{
+			Peer::OutMessage& msg = peer.reliable_out[i];
+			if (msg.acked || ((msg.last_send_time != 0) && (now - msg.last_send_time < peer.rto)))
+			{
+				continue;
+			}
+
+			uint32_t const msg_size = static_cast<uint32_t>(msg.data.size());
+			if ((pos + 4 + msg_size > mtu) || (MAX_RELIABLE_PER_PACKET == num_reliable))
+			{
+				send_packet();
+			}
+
+			Write16(buf + pos, static_cast<uint16_t>(msg_size | RELIABLE_FLAG));
+			Write16(buf + pos + 2, msg.id);
+			if (msg_size > 0)
+			{
+				std::memcpy(buf + pos + 4, &msg.data[0], msg_size);
+			}
+			pos += 4 + msg_size;
+			reliable_ids[num_reliable] = msg.id;
+			++ num_reliable;
+
+			if (msg.last_send_time != 0)
+			{
+				++ stats_.retransmits;
+			}
+			else
+			{
+				++ stats_.messages_sent;
+			}
+			msg.last_send_time = now;
+		}
+
+		for (size_t offset = 0; offset < peer.unreliable_out.size();)
+		{
+			uint32_t const frame_size = 2 + Read16(&peer.unreliable_out[offset]);
+			if (pos + frame_size > mtu)
+			{
+				send_packet();
+			}
+
+			std::memcpy(buf + pos, &peer.unreliable_out[offset], frame_size);
+			pos += frame_size;
+			offset += frame_size;
+
+			++ stats_.messages_sent;
+		}
+		peer.unreliable_out.clear();
+
+		if ((pos > PACKET_HEADER_SIZE) || peer.ack_pending || (now - peer.last_send_time >= settings_.keep_alive_ms))
+		{
+			send_packet();
+		}
+	}
+
+	void NetTransport::DispatchEvents()
+	{
+		// Only the thread running Update gets here, so the dispatching vectors need no lock
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			dispatching_connected_.swap(connected_peers_);
+			dispatching_deliveries_.swap(deliveries_);
+			dispatching_copies_.swap(delivered_copies_);
+			dispatching_disconnected_.swap(disconnected_peers_);
+		}
+
+		// Handlers run without the lock, so they can call Send
+		if (on_connected_)
+		{
+			for (auto const peer : dispatching_connected_)
+			{
+				on_connected_(peer);
+			}
+		}
+		if (on_message_)
+		{
+			for (auto const & delivery : dispatching_deliveries_)
+			{
+				on_message_(delivery.peer, delivery.data, delivery.size);
+			}
+		}
+		if (on_disconnected_)
+		{
+			for (auto const peer : dispatching_disconnected_)
+			{
+				on_disconnected_(peer);
+			}
+		}
+
+		dispatching_connected_.clear();
+		dispatching_deliveries_.clear();
+		dispatching_copies_.clear();
+		dispatching_disconnected_.clear();
+	}
+
+	NetTransport::Peer* NetTransport::FindPeer(uint32_t peer) const
+	{
+		auto iter = peers_.find(peer);
+		return (iter != peers_.end()) ? iter->second.get() : nullptr;
+	}
+
+	NetTransport::Peer& NetTransport::AddPeer(sockaddr_in const & addr, uint64_t now)
+	{
+		auto peer = MakeUniquePtr<Peer>();
+		peer->id = next_peer_id_;
+		++ next_peer_id_;
+		if (INVALID_PEER == next_peer_id_)
+		{
+			++ next_peer_id_;
+		}
+		peer->addr = addr;
+
+		peer->next_packet_seq = 0;
+		peer->next_msg_id = 0;
+		peer->sent_packets.resize(SENT_PACKET_WINDOW);
+		for (auto& sp : peer->sent_packets)
+		{
+			sp.valid = false;
+		}
+		peer->srtt = -1;
+		peer->rto = settings_.min_resend_ms * 2;
+		peer->last_send_time = now;
+
+		// Until the first datagram arrives, ack a sequence this peer won't use for a long time
+		peer->has_remote_seq = false;
+		peer->remote_seq = 0xFFFF;
+		peer->ack_bits = 0;
+		peer->received_seqs.assign(RECV_HISTORY, 0);
+		peer->ack_pending = false;
+		peer->next_recv_msg_id = 0;
+		peer->last_recv_time = now;
+
+		Peer& ret = *peer;
+		peer_by_addr_[AddrKey(addr)] = ret.id;
+		peers_.emplace(ret.id, std::move(peer));
+		return ret;
+	}
+}
+
+#endif
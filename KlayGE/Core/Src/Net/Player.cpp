@@ -17,7 +17,7 @@
 #include <KlayGE/Lobby.hpp>
 
 #include <algorithm>
-#include <ctime>
+#include <chrono>
 #include <cstring>
 
 #include <KlayGE/NetMsg.hpp>
@@ -27,19 +27,7 @@
 
 namespace
 {
-	class ReceiveThreadFunc
-	{
-	public:
-		explicit ReceiveThreadFunc(KlayGE::Player* player)
-			: player_(player)
-			{ }
-
-		void operator()()
-			{ player_->ReceiveFunc(); }
-
-	private:
-		KlayGE::Player* player_;
-	};
+	uint32_t const REPLY_TIMEOUT = 2000;
 }
 
 namespace KlayGE
@@ -47,7 +35,14 @@ namespace KlayGE
 	// 캯
 	/////////////////////////////////////////////////////////////////////////////////
 	Player::Player()
+		: lobby_(NetTransport::INVALID_PEER), playerID_(0), joined_(false)
 	{
+		std::memset(&lobbyAddr_, 0, sizeof(lobbyAddr_));
+
+		transport_.OnMessage([this](uint32_t /*peer*/, uint8_t const * data, uint32_t size)
+			{
+				this->OnMessage(data, size);
+			});
 	}
 
 	// 
@@ -57,58 +52,40 @@ namespace KlayGE
 		this->Destroy();
 	}
 
-	// Ϣܺ
+	// Called on the transport thread. Resending and acking are done by NetTransport, only the payload is queued here.
 	/////////////////////////////////////////////////////////////////////////////////
-	void Player::ReceiveFunc()
+	void Player::OnMessage(uint8_t const * data, uint32_t size)
 	{
-		static time_t lastTime = std::time(nullptr);
+		if (size > 0)
+		{
+			std::lock_guard<std::mutex> lock(recvMutex_);
+			recvQueue_.emplace_back(data, data + size);
+		}
+		recvCond_.notify_all();
+	}
+
+	// Waits for a message with the given type. A negative type matches any message.
+	/////////////////////////////////////////////////////////////////////////////////
+	bool Player::WaitMessage(int type, std::vector<char>& msg, uint32_t timeout)
+	{
+		auto const deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
 
+		std::unique_lock<std::mutex> lock(recvMutex_);
 		for (;;)
 		{
-			if (std::time(nullptr) - lastTime >= 10 * 1000)
-			{
-				char msg(MSG_NOP);
-				socket_.Send(&msg, sizeof(msg));
-				lastTime = std::time(nullptr);
-			}
-
-			if (!sendQueue_.empty())
+			for (auto iter = recvQueue_.begin(); iter != recvQueue_.end(); ++ iter)
 			{
-				// ͶϢ
-				for (auto const & msg : sendQueue_)
+				if ((type < 0) || ((*iter)[0] == static_cast<char>(type)))
 				{
-					socket_.Send(&msg[0], static_cast<int>(msg.size()));
+					msg.swap(*iter);
+					recvQueue_.erase(iter);
+					return true;
 				}
 			}
 
-			char revBuf[Max_Buffer];
-			std::fill_n(revBuf, sizeof(revBuf), 0);
-			if (socket_.Receive(revBuf, sizeof(revBuf)) != -1)
+			if (std::cv_status::timeout == recvCond_.wait_until(lock, deadline))
 			{
-				uint32_t ID;
-				std::memcpy(&ID, &revBuf[1], 4);
-
-				// ɾѷ͵Ϣ
-				for (auto iter = sendQueue_.begin(); iter != sendQueue_.end();)
-				{
-					std::vector<char>& msg = *iter;
-
-					uint32_t sendID;
-					std::memcpy(&sendID, &msg[1], 4);
-					if (sendID == ID)
-					{
-						iter = sendQueue_.erase(iter);
-					}
-					else
-					{
-						++ iter;
-					}
-				}
-
-				if (MSG_QUIT == revBuf[0])
-				{
-					break;
-				}
+				return false;
 			}
 		}
 	}
@@ -117,11 +94,11 @@ namespace KlayGE
 	/////////////////////////////////////////////////////////////////////////////////
 	bool Player::Join(sockaddr_in const & lobbyAddr)
 	{
-		socket_.Close();
-		socket_.Create(SOCK_DGRAM);
-		socket_.Connect(lobbyAddr);
+		this->Destroy();
 
-		socket_.TimeOut(2000);
+		lobbyAddr_ = lobbyAddr;
+		lobby_ = transport_.Connect(lobbyAddr);
+		transport_.Start();
 
 		char buf[Max_Buffer];
 		std::fill_n(buf, sizeof(buf), 0);
@@ -129,16 +106,18 @@ namespace KlayGE
 		buf[0] = MSG_JOIN;
 		name_.copy(&buf[1], this->name_.length());
 
-		socket_.Send(buf, sizeof(buf));
+		transport_.Send(lobby_, buf, static_cast<uint32_t>(name_.length() + 2));
 
-		socket_.Receive(&playerID_, sizeof(playerID_));
-		if (0 == playerID_)
+		// Reply: MSG_JOIN, player ID (0 if the lobby is full)
+		std::vector<char> reply;
+		if (!this->WaitMessage(MSG_JOIN, reply, REPLY_TIMEOUT) || (reply.size() < 2) || (0 == reply[1]))
 		{
+			transport_.Close();
 			return false;
 		}
 
-		receiveLoop_ = true;
-		receiveThread_ = Context::Instance().ThreadPool()(ReceiveThreadFunc(this));
+		playerID_ = reply[1];
+		joined_ = true;
 
 		return true;
 	}
@@ -147,14 +126,17 @@ namespace KlayGE
 	/////////////////////////////////////////////////////////////////////////////////
 	void Player::Quit()
 	{
-		if (receiveLoop_)
+		if (joined_)
 		{
 			char msg(MSG_QUIT);
-			socket_.Send(&msg, sizeof(msg));
+			transport_.Send(lobby_, &msg, sizeof(msg));
+			// Stop would drop the message if its first datagram is lost
+			transport_.Flush(lobby_, REPLY_TIMEOUT);
 
-			receiveLoop_ = false;
-			receiveThread_();
+			joined_ = false;
 		}
+
+		transport_.Stop();
 	}
 
 	// 
@@ -162,7 +144,10 @@ namespace KlayGE
 	void Player::Destroy()
 	{
 		this->Quit();
-		socket_.Close();
+		transport_.Close();
+
+		std::lock_guard<std::mutex> lock(recvMutex_);
+		recvQueue_.clear();
 	}
 
 	LobbyDes Player::LobbyInfo()
@@ -170,18 +155,18 @@ namespace KlayGE
 		LobbyDes lobbydes;
 		lobbydes.numPlayer = 0;
 		lobbydes.maxPlayers = 0;
+		lobbydes.addr = lobbyAddr_;
 
 		char msg(MSG_GETLOBBYINFO);
-		socket_.Send(&msg, sizeof(msg));
+		transport_.Send(lobby_, &msg, sizeof(msg));
 
-		char buf[18];
-		socket_.Receive(buf, sizeof(buf));
-		if (MSG_GETLOBBYINFO == buf[0])
+		std::vector<char> buf;
+		if (this->WaitMessage(MSG_GETLOBBYINFO, buf, REPLY_TIMEOUT) && (buf.size() >= 3))
 		{
 			lobbydes.numPlayer = buf[1];
 			lobbydes.maxPlayers = buf[2];
 			size_t i(0);
-			while (buf[3 + i] != 0)
+			while ((3 + i < buf.size()) && (buf[3 + i] != 0))
 			{
 				++ i;
 			}
@@ -209,14 +194,23 @@ namespace KlayGE
 	/////////////////////////////////////////////////////////////////////////////////
 	int Player::Receive(void* buf, int maxSize, sockaddr_in& from)
 	{
-		return socket_.ReceiveFrom(buf, maxSize, from);
+		std::vector<char> msg;
+		if (!this->WaitMessage(-1, msg, REPLY_TIMEOUT))
+		{
+			return -1;
+		}
+
+		int const size = std::min(maxSize, static_cast<int>(msg.size()));
+		std::memcpy(buf, &msg[0], size);
+		from = lobbyAddr_;
+		return size;
 	}
 
 	// 
 	/////////////////////////////////////////////////////////////////////////////////
 	int Player::Send(void const * buf, int size)
 	{
-		return socket_.Send(buf, size);
+		return transport_.Send(lobby_, buf, size) ? size : -1;
 	}
 }
 
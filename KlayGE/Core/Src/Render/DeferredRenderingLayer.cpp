@@ -40,6 +40,7 @@
 #include <KlayGE/Context.hpp>
 #include <KlayGE/SceneObjectHelper.hpp>
 #include <KlayGE/SceneManager.hpp>
+#include <KlayGE/OcclusionBuffer.hpp>
 #include <KlayGE/RenderFactory.hpp>
 #include <KlayGE/App3D.hpp>
 #include <KlayGE/PostProcess.hpp>
@@ -1724,6 +1725,19 @@ namespace KlayGE
 						dr_debug_pp_->Apply();
 						urv |= App3DFramework::URV_SkipPostProcess;
 					}
+					else if (DT_OcclusionBuffer == display_type_)
+					{
+						if (!occlusion_debug_pp_)
+						{
+							occlusion_debug_pp_ = SyncLoadPostProcess("Copy.ppml", "copy");
+						}
+
+						re.BindFrameBuffer(FrameBufferPtr());
+						re.CurFrameBuffer()->Attached(FrameBuffer::ATT_DepthStencil)->ClearDepth(1.0f);
+						occlusion_debug_pp_->InputPin(0, scene_mgr.GetOcclusionBuffer().DebugTexture());
+						occlusion_debug_pp_->Apply();
+						urv |= App3DFramework::URV_SkipPostProcess;
+					}
 				}
 			}
 			break;
@@ -47,12 +47,16 @@
 #include <KlayGE/LZMACodec.hpp>
 #include <KlayGE/TransientBuffer.hpp>
 #include <KFL/Hash.hpp>
+#include <KFL/Thread.hpp>
 
 #include <algorithm>
+#include <functional>
+#include <mutex>
 #include <vector>
 #include <cstring>
 #include <fstream>
 #include <iostream>
+#include <list>
 #include <unordered_map>
 #include <tuple>
 #include <type_traits>
@@ -71,7 +75,9 @@ namespace KlayGE
 				: RenderableHelper(L"Font"),
 					three_dim_(false),
 					kfont_loader_(kfl),
-					tick_(0)
+					lru_head_(INVALID_SLOT), lru_tail_(INVALID_SLOT),
+					num_used_slots_(0),
+					prefetching_(false)
 		{
 			RenderFactory& rf = Context::Instance().RenderFactoryInstance();
 
@@ -93,9 +99,19 @@ namespace KlayGE
 			RenderDeviceCaps const & caps = renderEngine.DeviceCaps();
 			uint32_t size = std::min<uint32_t>(2048U, std::min<uint32_t>(caps.max_texture_width, caps.max_texture_height)) / kfont_char_size * kfont_char_size;
 			dist_texture_ = rf.MakeTexture2D(size, size, 1, 1, EF_R8, 1, 0, EAH_GPU_Read, nullptr);
-			a_char_data_.resize(kfont_char_size * kfont_char_size);
 
-			char_free_list_.emplace_back(0, size * size / kfont_char_size / kfont_char_size);
+			uint32_t const num_chars_a_row = size / kfont_char_size;
+			glyph_slots_.resize(num_chars_a_row * num_chars_a_row);
+			for (auto& gs : glyph_slots_)
+			{
+				gs.ch = 0;
+				gs.prev = INVALID_SLOT;
+				gs.next = INVALID_SLOT;
+				gs.pending = -1;
+			}
+
+			std::memset(&cache_stats_, 0, sizeof(cache_stats_));
+			cache_stats_.capacity = static_cast<uint32_t>(glyph_slots_.size());
 
 			effect_ = SyncLoadRenderEffect("Font.fxml");
 			*(effect_->ParameterByName("distance_tex")) = dist_texture_;
@@ -118,6 +134,14 @@ namespace KlayGE
 			tc_aabb_ = AABBox(float3(0, 0, 0), float3(0, 0, 0));
 		}
 
+		~FontRenderable()
+		{
+			if (prefetch_thread_)
+			{
+				(*prefetch_thread_)();
+			}
+		}
+
 		RenderTechnique* GetRenderTechnique() const override
 		{
 			if (three_dim_)
@@ -141,6 +165,8 @@ namespace KlayGE
 				*half_width_height_ep_ = float2(half_width, half_height);
 			}
 
+			this->FlushGlyphUploads();
+
 			tb_vb_->EnsureDataReady();
 			tb_ib_->EnsureDataReady();
 
@@ -524,21 +550,78 @@ namespace KlayGE
 			pos_aabb_ |= AABBox(float3(sx, sy, sz), float3(maxx, maxy, sz + 0.1f));
 		}
 
-		// ʹLRU㷨
+	public:
+		// Decompresses the glyphs of text that are not in the cache yet on the thread pool. UpdateTexture picks them up
+		//  later instead of decoding them on the calling thread.
+		void Prefetch(std::wstring const & text)
+		{
+			KFont const & kl = *kfont_loader_;
+
+			std::lock_guard<std::mutex> lock(prefetch_mutex_);
+
+			for (auto const & ch : text)
+			{
+				if ((kl.CharIndex(ch) != -1) && (char_info_map_.find(ch) == char_info_map_.end())
+					&& (prefetched_glyphs_.find(ch) == prefetched_glyphs_.end()))
+				{
+					// Holds at most as many glyphs as the cache. The oldest ones go first, they are the least likely
+					//  to be drawn soon.
+					if (!prefetch_order_.empty() && (prefetched_glyphs_.size() >= glyph_slots_.size()))
+					{
+						prefetched_glyphs_.erase(prefetch_order_.front());
+						prefetch_order_.pop_front();
+					}
+
+					prefetch_order_.push_back(ch);
+					PrefetchedGlyph& pg = prefetched_glyphs_[ch];
+					pg.order = std::prev(prefetch_order_.end());
+					prefetch_queue_.push_back(ch);
+				}
+			}
+
+			if (!prefetch_queue_.empty() && !prefetching_)
+			{
+				if (prefetch_thread_)
+				{
+					(*prefetch_thread_)();
+				}
+
+				prefetching_ = true;
+				prefetch_thread_ = MakeUniquePtr<joiner<void>>(Context::Instance().ThreadPool()(
+					std::bind(&FontRenderable::PrefetchThreadFunc, this)));
+			}
+		}
+
+		Font::GlyphCacheStats const & CacheStats() const
+		{
+			return cache_stats_;
+		}
+
+		void ResetCacheStats()
+		{
+			cache_stats_.hits = 0;
+			cache_stats_.misses = 0;
+			cache_stats_.evictions = 0;
+			cache_stats_.uploads = 0;
+		}
+
+	private:
+
+		// Glyph slots form an intrusive LRU list, so both a hit and an eviction are O(1).
+		// Newly rasterized glyphs are only copied to CPU memory here, and uploaded in a batch by FlushGlyphUploads.
 		/////////////////////////////////////////////////////////////////////////////////
 		void UpdateTexture(std::wstring const & text)
 		{
-			++ tick_;
-
 			uint32_t const tex_size = dist_texture_->Width(0);
 
 			KFont& kl = *kfont_loader_;
 			auto& cim = char_info_map_;
 
 			uint32_t const kfont_char_size = kl.CharSize();
+			uint32_t const glyph_bytes = kfont_char_size * kfont_char_size;
 
 			uint32_t const num_chars_a_row = tex_size / kfont_char_size;
-			uint32_t const num_total_chars = num_chars_a_row * num_chars_a_row;
+			uint32_t const num_total_chars = static_cast<uint32_t>(glyph_slots_.size());
 
 			for (auto const & ch : text)
 			{
@@ -548,123 +631,244 @@ namespace KlayGE
 					auto cmiter = cim.find(ch);
 					if (cmiter != cim.end())
 					{
-						// ҵ
+						uint32_t const slot = cmiter->second.slot;
+						if (slot != lru_head_)
+						{
+							this->LRUUnlink(slot);
+							this->LRUPushFront(slot);
+						}
 
-						cmiter->second.tick = tick_;
+						++ cache_stats_.hits;
 					}
 					else
 					{
-						// ҲԵ
-
-						KFont::font_info const & ci = kl.CharInfo(offset);
-
-						uint32_t width = ci.width;
-						uint32_t height = ci.height;
-
-						int2 char_pos;
-						CharInfo charInfo;
-						if (cim.size() < num_total_chars)
+						uint32_t slot;
+						if (num_used_slots_ < num_total_chars)
 						{
-							// пռ
+							slot = num_used_slots_;
+							++ num_used_slots_;
+						}
+						else
+						{
+							slot = lru_tail_;
+							this->LRUUnlink(slot);
+							cim.erase(glyph_slots_[slot].ch);
+
+							++ cache_stats_.evictions;
+						}
+						this->LRUPushFront(slot);
 
-							uint32_t const s = char_free_list_.front().first;
-						
-							char_pos.y() = s / num_chars_a_row;
-							char_pos.x() = s - char_pos.y() * num_chars_a_row;
+						GlyphSlot& gs = glyph_slots_[slot];
+						gs.ch = ch;
 
-							char_pos.x() *= kfont_char_size;
-							char_pos.y() *= kfont_char_size;
+						KFont::font_info const & ci = kl.CharInfo(offset);
 
-							charInfo.rc.left() = static_cast<float>(char_pos.x()) / tex_size;
-							charInfo.rc.top() = static_cast<float>(char_pos.y()) / tex_size;
+						CharInfo charInfo;
+						charInfo.rc.left() = static_cast<float>(slot % num_chars_a_row * kfont_char_size) / tex_size;
+						charInfo.rc.top() = static_cast<float>(slot / num_chars_a_row * kfont_char_size) / tex_size;
+						charInfo.rc.right() = charInfo.rc.left() + static_cast<float>(ci.width) / tex_size;
+						charInfo.rc.bottom() = charInfo.rc.top() + static_cast<float>(ci.height) / tex_size;
+						charInfo.slot = slot;
 
-							++ char_free_list_.front().first;
-							if (char_free_list_.front().first == char_free_list_.front().second)
-							{
-								char_free_list_.pop_front();
-							}
-						}
-						else
+						if (gs.pending < 0)
 						{
-							// ҵʹʱûʹõ
+							gs.pending = static_cast<int32_t>(pending_slots_.size());
+							pending_slots_.push_back(slot);
+							pending_glyph_data_.resize(pending_slots_.size() * glyph_bytes);
+						}
 
-							uint64_t min_tick = cim.begin()->second.tick;
-							auto min_chiter = cim.begin();
-							for (auto chiter = cim.begin(); chiter != cim.end(); ++ chiter)
+						uint8_t* glyph_data = &pending_glyph_data_[gs.pending * glyph_bytes];
+						bool prefetched = false;
+						{
+							std::lock_guard<std::mutex> lock(prefetch_mutex_);
+							auto iter = prefetched_glyphs_.find(ch);
+							if (iter != prefetched_glyphs_.end())
 							{
-								if (chiter->second.tick < min_tick)
+								if (!iter->second.data.empty())
 								{
-									min_tick = chiter->second.tick;
-									min_chiter = chiter;
+									std::memcpy(glyph_data, &iter->second.data[0], glyph_bytes);
+									prefetched = true;
 								}
+								prefetch_order_.erase(iter->second.order);
+								prefetched_glyphs_.erase(iter);
 							}
+						}
+						if (!prefetched)
+						{
+							kl.GetDistanceData(glyph_data, kfont_char_size, offset);
+						}
 
-							char_pos.x() = static_cast<int32_t>(min_chiter->second.rc.left() * tex_size);
-							char_pos.y() = static_cast<int32_t>(min_chiter->second.rc.top() * tex_size);
-							charInfo.rc.left() = min_chiter->second.rc.left();
-							charInfo.rc.top() = min_chiter->second.rc.top();
+						cim.emplace(ch, charInfo);
 
-							for (auto chiter = cim.begin(); chiter != cim.end(); ++ chiter)
-							{
-								if (chiter->second.tick == min_tick)
-								{
-									uint32_t const x = static_cast<int32_t>(chiter->second.rc.left() * tex_size);
-									uint32_t const y = static_cast<int32_t>(chiter->second.rc.top() * tex_size);
-									uint32_t const id = y * num_chars_a_row + x;
-									auto freeiter = char_free_list_.begin();
-									while ((freeiter != char_free_list_.end()) && (freeiter->second <= id))
-									{
-										++ freeiter;
-									}
-									char_free_list_.emplace(freeiter, id, id + 1);
-
-									cim.erase(chiter);
-									break;
-								}
-							}
-							for (auto freeiter = char_free_list_.begin(); freeiter != char_free_list_.end();)
-							{
-								auto nextiter = freeiter;
-								++ nextiter;
+						++ cache_stats_.misses;
+					}
+				}
+			}
 
-								if (nextiter != char_free_list_.end())
-								{
-									if (freeiter->second == nextiter->first)
-									{
-										freeiter->second = nextiter->second;
-										char_free_list_.erase(nextiter);
-									}
-									else
-									{
-										++ freeiter;
-									}
-								}
-								else
-								{
-									break;
-								}
-							}
+			cache_stats_.used = num_used_slots_;
+		}
+
+		// Uploads all glyphs rasterized since the last frame. Adjacent slots on a row are merged into one update.
+		void FlushGlyphUploads()
+		{
+			if (pending_slots_.empty())
+			{
+				return;
+			}
+
+			uint32_t const kfont_char_size = kfont_loader_->CharSize();
+			uint32_t const glyph_bytes = kfont_char_size * kfont_char_size;
+			uint32_t const num_chars_a_row = dist_texture_->Width(0) / kfont_char_size;
+
+			std::sort(pending_slots_.begin(), pending_slots_.end());
+
+			for (size_t i = 0; i < pending_slots_.size();)
+			{
+				uint32_t const first = pending_slots_[i];
+				uint32_t const row = first / num_chars_a_row;
+
+				size_t j = i + 1;
+				while ((j < pending_slots_.size()) && (pending_slots_[j] == first + j - i)
+					&& (pending_slots_[j] / num_chars_a_row == row))
+				{
+					++ j;
+				}
+
+				uint32_t const run = static_cast<uint32_t>(j - i);
+				uint32_t const x = first % num_chars_a_row * kfont_char_size;
+				uint32_t const y = row * kfont_char_size;
+				if (1 == run)
+				{
+					GlyphSlot& gs = glyph_slots_[first];
+					dist_texture_->UpdateSubresource2D(0, 0, x, y, kfont_char_size, kfont_char_size,
+						&pending_glyph_data_[gs.pending * glyph_bytes], kfont_char_size);
+					gs.pending = -1;
+				}
+				else
+				{
+					uint32_t const row_pitch = run * kfont_char_size;
+					upload_staging_.resize(row_pitch * kfont_char_size);
+					for (uint32_t k = 0; k < run; ++ k)
+					{
+						GlyphSlot& gs = glyph_slots_[first + k];
+						uint8_t const * src = &pending_glyph_data_[gs.pending * glyph_bytes];
+						for (uint32_t r = 0; r < kfont_char_size; ++ r)
+						{
+							std::memcpy(&upload_staging_[r * row_pitch + k * kfont_char_size], src + r * kfont_char_size,
+								kfont_char_size);
 						}
+						gs.pending = -1;
+					}
+					dist_texture_->UpdateSubresource2D(0, 0, x, y, row_pitch, kfont_char_size, &upload_staging_[0], row_pitch);
+				}
 
-						charInfo.rc.right()		= charInfo.rc.left() + static_cast<float>(width) / tex_size;
-						charInfo.rc.bottom()	= charInfo.rc.top() + static_cast<float>(height) / tex_size;
-						charInfo.tick			= tick_;
+				++ cache_stats_.uploads;
 
-						kl.GetDistanceData(&a_char_data_[0], kfont_char_size, offset);
-						dist_texture_->UpdateSubresource2D(0, 0, char_pos.x(), char_pos.y(), kfont_char_size, kfont_char_size,
-							&a_char_data_[0], kfont_char_size);
+				i = j;
+			}
 
-						cim.emplace(ch, charInfo);
+			pending_slots_.clear();
+			pending_glyph_data_.clear();
+		}
+
+		void PrefetchThreadFunc()
+		{
+			KFont const & kl = *kfont_loader_;
+			uint32_t const glyph_bytes = kl.CharSize() * kl.CharSize();
+
+			std::vector<wchar_t> chars;
+			std::vector<int32_t> indices;
+			std::vector<uint8_t> glyphs;
+			for (;;)
+			{
+				chars.clear();
+				{
+					std::lock_guard<std::mutex> lock(prefetch_mutex_);
+					chars.swap(prefetch_queue_);
+					if (chars.empty())
+					{
+						prefetching_ = false;
+						break;
+					}
+				}
+
+				indices.resize(chars.size());
+				for (size_t i = 0; i < chars.size(); ++ i)
+				{
+					indices[i] = kl.CharIndex(chars[i]);
+				}
+
+				glyphs.resize(chars.size() * glyph_bytes);
+				kl.GetDistanceData(&glyphs[0], &indices[0], static_cast<uint32_t>(indices.size()),
+					Context::Instance().ThreadPool());
+
+				std::lock_guard<std::mutex> lock(prefetch_mutex_);
+				for (size_t i = 0; i < chars.size(); ++ i)
+				{
+					// The glyph could be consumed by UpdateTexture while decoding. Only fill the entries still waiting.
+					auto iter = prefetched_glyphs_.find(chars[i]);
+					if (iter != prefetched_glyphs_.end())
+					{
+						iter->second.data.assign(glyphs.begin() + i * glyph_bytes, glyphs.begin() + (i + 1) * glyph_bytes);
 					}
 				}
 			}
 		}
 
+		void LRUUnlink(uint32_t slot)
+		{
+			GlyphSlot& gs = glyph_slots_[slot];
+			if (gs.prev != INVALID_SLOT)
+			{
+				glyph_slots_[gs.prev].next = gs.next;
+			}
+			else
+			{
+				lru_head_ = gs.next;
+			}
+			if (gs.next != INVALID_SLOT)
+			{
+				glyph_slots_[gs.next].prev = gs.prev;
+			}
+			else
+			{
+				lru_tail_ = gs.prev;
+			}
+			gs.prev = INVALID_SLOT;
+			gs.next = INVALID_SLOT;
+		}
+
+		void LRUPushFront(uint32_t slot)
+		{
+			GlyphSlot& gs = glyph_slots_[slot];
+			gs.prev = INVALID_SLOT;
+			gs.next = lru_head_;
+			if (lru_head_ != INVALID_SLOT)
+			{
+				glyph_slots_[lru_head_].prev = slot;
+			}
+			else
+			{
+				lru_tail_ = slot;
+			}
+			lru_head_ = slot;
+		}
+
 	private:
+		static uint32_t const INVALID_SLOT = 0xFFFFFFFF;
+
 		struct CharInfo
 		{
 			Rect rc;
-			uint64_t tick;
+			uint32_t slot;
+		};
+
+		struct GlyphSlot
+		{
+			wchar_t ch;
+			uint32_t prev;
+			uint32_t next;
+			int32_t pending;
 		};
 
 #ifdef KLAYGE_HAS_STRUCT_PACK
@@ -691,7 +895,28 @@ namespace KlayGE
 		bool restart_;
 
 		std::unordered_map<wchar_t, CharInfo> char_info_map_;
-		std::list<std::pair<uint32_t, uint32_t>> char_free_list_;
+		std::vector<GlyphSlot> glyph_slots_;
+		uint32_t lru_head_;
+		uint32_t lru_tail_;
+		uint32_t num_used_slots_;
+
+		std::vector<uint32_t> pending_slots_;
+		std::vector<uint8_t> pending_glyph_data_;
+		std::vector<uint8_t> upload_staging_;
+
+		Font::GlyphCacheStats cache_stats_;
+
+		std::mutex prefetch_mutex_;
+		std::vector<wchar_t> prefetch_queue_;
+		struct PrefetchedGlyph
+		{
+			std::vector<uint8_t> data;
+			std::list<wchar_t>::iterator order;
+		};
+		std::unordered_map<wchar_t, PrefetchedGlyph> prefetched_glyphs_;
+		std::list<wchar_t> prefetch_order_;
+		bool prefetching_;
+		std::unique_ptr<joiner<void>> prefetch_thread_;
 
 		bool three_dim_;
 
@@ -701,14 +926,11 @@ namespace KlayGE
 		std::vector<SubAlloc> tb_ib_sub_allocs_;
 
 		TexturePtr		dist_texture_;
-		std::vector<uint8_t> a_char_data_;
 
 		RenderEffectParameter* half_width_height_ep_;
 		RenderEffectParameter* mvp_ep_;
 
 		std::shared_ptr<KFont> kfont_loader_;
-
-		uint64_t tick_;
 	};
 }
 
@@ -899,6 +1121,25 @@ namespace KlayGE
 	}
 
 
+	Font::GlyphCacheStats const & Font::CacheStats() const
+	{
+		return font_renderable_->CacheStats();
+	}
+
+	void Font::ResetCacheStats()
+	{
+		font_renderable_->ResetCacheStats();
+	}
+
+	void Font::Prefetch(std::wstring const & text)
+	{
+		if (!text.empty())
+		{
+			font_renderable_->Prefetch(text);
+		}
+	}
+
+
 	FontPtr SyncLoadFont(std::string const & font_name, uint32_t flags)
 	{
 		return ResLoader::Instance().SyncQueryT<Font>(MakeSharedPtr<FontLoadingDesc>(font_name, flags));
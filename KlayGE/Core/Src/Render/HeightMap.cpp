@@ -15,9 +15,94 @@
 
 #include <KlayGE/KlayGE.hpp>
 #include <KFL/Vector.hpp>
+#include <KFL/Thread.hpp>
+#include <KlayGE/Context.hpp>
+
+#include <algorithm>
 
 #include <KlayGE/HeightMap.hpp>
 
+namespace
+{
+	using namespace KlayGE;
+
+	uint32_t const ROWS_PER_TASK = 16;
+
+	// Grid positions of a chunk's vertices in a LOD. The last one is always included, so the neighbor chunks share
+	//  their border positions even if the size is not a multiple of the step.
+	void ChunkSamples(std::vector<uint32_t>& samples, uint32_t begin, uint32_t end, uint32_t step)
+	{
+		samples.clear();
+		for (uint32_t q = begin; q < end; q += step)
+		{
+			samples.push_back(q);
+		}
+		samples.push_back(end);
+	}
+
+	// Border vertices of a nx x ny grid as a loop. Every skirt quad built on the loop faces outwards.
+	void ChunkPerimeter(std::vector<uint32_t>& perimeter, uint32_t nx, uint32_t ny)
+	{
+		perimeter.clear();
+		for (uint32_t y = 0; y < ny; ++ y)
+		{
+			perimeter.push_back(y * nx + 0);
+		}
+		for (uint32_t x = 1; x < nx; ++ x)
+		{
+			perimeter.push_back((ny - 1) * nx + x);
+		}
+		for (uint32_t y = ny - 1; y > 0; -- y)
+		{
+			perimeter.push_back((y - 1) * nx + (nx - 1));
+		}
+		for (uint32_t x = nx - 1; x > 1; -- x)
+		{
+			perimeter.push_back(0 * nx + (x - 1));
+		}
+	}
+
+	template <typename IndexType>
+	void ChunkIndices(std::vector<IndexType>& indices, uint32_t nx, uint32_t ny, std::vector<uint32_t> const & perimeter,
+		bool skirt)
+	{
+		indices.clear();
+		indices.reserve((nx - 1) * (ny - 1) * 6 + (skirt ? perimeter.size() * 6 : 0));
+
+		for (uint32_t y = 0; y < ny - 1; ++ y)
+		{
+			for (uint32_t x = 0; x < nx - 1; ++ x)
+			{
+				indices.push_back(static_cast<IndexType>((y + 0) * nx + (x + 0)));
+				indices.push_back(static_cast<IndexType>((y + 1) * nx + (x + 0)));
+				indices.push_back(static_cast<IndexType>((y + 1) * nx + (x + 1)));
+
+				indices.push_back(static_cast<IndexType>((y + 1) * nx + (x + 1)));
+				indices.push_back(static_cast<IndexType>((y + 0) * nx + (x + 1)));
+				indices.push_back(static_cast<IndexType>((y + 0) * nx + (x + 0)));
+			}
+		}
+
+		if (skirt)
+		{
+			uint32_t const base = nx * ny;
+			uint32_t const num = static_cast<uint32_t>(perimeter.size());
+			for (uint32_t k = 0; k < num; ++ k)
+			{
+				uint32_t const next = (k + 1) % num;
+
+				indices.push_back(static_cast<IndexType>(perimeter[k]));
+				indices.push_back(static_cast<IndexType>(base + k));
+				indices.push_back(static_cast<IndexType>(perimeter[next]));
+
+				indices.push_back(static_cast<IndexType>(perimeter[next]));
+				indices.push_back(static_cast<IndexType>(base + k));
+				indices.push_back(static_cast<IndexType>(base + next));
+			}
+		}
+	}
+}
+
 namespace KlayGE
 {
 	void HeightMap::BuildTerrain(float start_x, float start_y, float end_x, float end_y, float span_x, float span_y,
@@ -68,4 +153,142 @@ namespace KlayGE
 			}
 		}
 	}
+
+	void HeightMap::BuildChunkedTerrain(float start_x, float start_y, float end_x, float end_y, float span_x, float span_y,
+		uint32_t chunk_quads, uint32_t num_lods, float skirt_depth,
+		std::vector<HeightMapChunk>& chunks, BatchHeightFunc const & height_func)
+	{
+		chunks.clear();
+
+		if ((end_x - start_x) * span_x < 0)
+		{
+			span_x = -span_x;
+		}
+		if ((end_y - start_y) * span_y < 0)
+		{
+			span_y = -span_y;
+		}
+		chunk_quads = std::max(chunk_quads, 1U);
+		num_lods = std::max(num_lods, 1U);
+
+		uint32_t const num_quads_x = static_cast<uint32_t>((end_x - start_x) / span_x);
+		uint32_t const num_quads_y = static_cast<uint32_t>((end_y - start_y) / span_y);
+		if ((0 == num_quads_x) || (0 == num_quads_y))
+		{
+			return;
+		}
+
+		uint32_t const num_x = num_quads_x + 1;
+		uint32_t const num_y = num_quads_y + 1;
+
+		auto& tp = Context::Instance().ThreadPool();
+
+		// Heights of the whole grid, so the chunks and LODs share the border vertices exactly
+		std::vector<float> heights(num_x * num_y);
+		{
+			std::vector<joiner<void>> joiners;
+			for (uint32_t y_start = 0; y_start < num_y; y_start += ROWS_PER_TASK)
+			{
+				joiners.push_back(tp([&heights, &height_func, start_x, start_y, span_x, span_y, num_x, num_y, y_start]
+					{
+						std::vector<float> xs(num_x);
+						std::vector<float> ys(num_x);
+						for (uint32_t x = 0; x < num_x; ++ x)
+						{
+							xs[x] = start_x + x * span_x;
+						}
+
+						uint32_t const y_end = std::min(y_start + ROWS_PER_TASK, num_y);
+						for (uint32_t y = y_start; y < y_end; ++ y)
+						{
+							std::fill(ys.begin(), ys.end(), start_y + y * span_y);
+							height_func(&xs[0], &ys[0], &heights[y * num_x], num_x);
+						}
+					}));
+			}
+			for (auto& j : joiners)
+			{
+				j();
+			}
+		}
+
+		uint32_t const num_chunks_x = (num_quads_x + chunk_quads - 1) / chunk_quads;
+		uint32_t const num_chunks_y = (num_quads_y + chunk_quads - 1) / chunk_quads;
+		chunks.resize(num_chunks_x * num_chunks_y * num_lods);
+
+		std::vector<joiner<void>> joiners;
+		for (uint32_t cy = 0; cy < num_chunks_y; ++ cy)
+		{
+			for (uint32_t cx = 0; cx < num_chunks_x; ++ cx)
+			{
+				joiners.push_back(tp([&chunks, &heights, start_x, start_y, span_x, span_y, num_x, num_quads_x, num_quads_y,
+					num_chunks_x, chunk_quads, num_lods, skirt_depth, cx, cy]
+					{
+						uint32_t const qx0 = cx * chunk_quads;
+						uint32_t const qy0 = cy * chunk_quads;
+						uint32_t const qx1 = std::min(qx0 + chunk_quads, num_quads_x);
+						uint32_t const qy1 = std::min(qy0 + chunk_quads, num_quads_y);
+						bool const skirt = (skirt_depth > 0);
+
+						std::vector<uint32_t> samples_x;
+						std::vector<uint32_t> samples_y;
+						std::vector<uint32_t> perimeter;
+						for (uint32_t lod = 0; lod < num_lods; ++ lod)
+						{
+							HeightMapChunk& chunk = chunks[(cy * num_chunks_x + cx) * num_lods + lod];
+							chunk.chunk_x = cx;
+							chunk.chunk_y = cy;
+							chunk.lod = lod;
+
+							ChunkSamples(samples_x, qx0, qx1, 1U << lod);
+							ChunkSamples(samples_y, qy0, qy1, 1U << lod);
+							uint32_t const nx = static_cast<uint32_t>(samples_x.size());
+							uint32_t const ny = static_cast<uint32_t>(samples_y.size());
+							ChunkPerimeter(perimeter, nx, ny);
+
+							chunk.vertices.resize(nx * ny + (skirt ? perimeter.size() : 0));
+							float3 min_pos(+1e10f, +1e10f, +1e10f);
+							float3 max_pos(-1e10f, -1e10f, -1e10f);
+							for (uint32_t y = 0; y < ny; ++ y)
+							{
+								for (uint32_t x = 0; x < nx; ++ x)
+								{
+									float3 const pos(start_x + samples_x[x] * span_x,
+										heights[samples_y[y] * num_x + samples_x[x]], start_y + samples_y[y] * span_y);
+									chunk.vertices[y * nx + x] = pos;
+									min_pos = MathLib::minimize(min_pos, pos);
+									max_pos = MathLib::maximize(max_pos, pos);
+								}
+							}
+							if (skirt)
+							{
+								for (size_t k = 0; k < perimeter.size(); ++ k)
+								{
+									float3 pos = chunk.vertices[perimeter[k]];
+									pos.y() -= skirt_depth;
+									chunk.vertices[nx * ny + k] = pos;
+									min_pos.y() = std::min(min_pos.y(), pos.y());
+								}
+							}
+							chunk.aabb = AABBox(min_pos, max_pos);
+
+							chunk.indices16.clear();
+							chunk.indices32.clear();
+							if (chunk.vertices.size() <= 65536)
+							{
+								ChunkIndices(chunk.indices16, nx, ny, perimeter, skirt);
+							}
+							else
+							{
+								ChunkIndices(chunk.indices32, nx, ny, perimeter, skirt);
+							}
+						}
+					}));
+			}
+		}
+		for (auto& j : joiners)
+		{
+			j();
+		}
+	}
 }
@@ -17,7 +17,9 @@
 #include <KlayGE/RenderEngine.hpp>
 #include <KlayGE/RenderEffect.hpp>
 
+#include <algorithm>
 #include <fstream>
+#include <functional>
 #include <cstring>
 #include <boost/assert.hpp>
 #include <boost/lexical_cast.hpp>
@@ -28,7 +30,94 @@ namespace
 {
 	using namespace KlayGE;
 
-	uint32_t const JUDA_TEX_VERSION = 2;
+	uint32_t const JUDA_TEX_VERSION = 3;
+	// Version 2 files have no baked tiles, otherwise the same
+	uint32_t const JUDA_TEX_MIN_VERSION = 2;
+
+	std::unique_ptr<TexCompression> CreateCacheCodec(ElementFormat format)
+	{
+		std::unique_ptr<TexCompression> ret;
+		switch (format)
+		{
+		case EF_BC1:
+			ret = MakeUniquePtr<TexCompressionBC1>();
+			break;
+
+		case EF_BC2:
+			ret = MakeUniquePtr<TexCompressionBC2>();
+			break;
+
+		case EF_BC3:
+			ret = MakeUniquePtr<TexCompressionBC3>();
+			break;
+
+		default:
+			BOOST_ASSERT(false);
+			break;
+		}
+		return ret;
+	}
+
+	uint32_t NumCacheMipmaps(ElementFormat format, uint32_t border_size, uint32_t tile_with_border_size)
+	{
+		uint32_t mipmap = 0;
+		while (border_size > (1UL << mipmap))
+		{
+			++ mipmap;
+		}
+		if (IsCompressedFormat(format))
+		{
+			// BC format must be multiply of 4
+			while (((tile_with_border_size >> mipmap) & 0x3) != 0)
+			{
+				-- mipmap;
+			}
+		}
+		++ mipmap;
+		return mipmap;
+	}
+
+	// Fetches and compresses the blocks on the thread pool, and writes them in the order of index. offsets[0] is the
+	//  position of the first block. The end of block i goes to offsets[i + 1].
+	void WriteCompressedBlocks(std::ostream& os, size_t num_blocks,
+		std::function<std::vector<uint8_t> const &(std::vector<uint8_t>& scratch, size_t index)> const & fetch,
+		std::vector<uint64_t>& offsets)
+	{
+		size_t const BATCH_SIZE = 256;
+
+		BOOST_ASSERT(offsets.size() == num_blocks + 1);
+
+		std::vector<std::vector<uint8_t>> comed_data(std::min(BATCH_SIZE, num_blocks));
+		std::vector<joiner<void>> joiners;
+		for (size_t batch_start = 0; batch_start < num_blocks; batch_start += BATCH_SIZE)
+		{
+			size_t const batch_end = std::min(batch_start + BATCH_SIZE, num_blocks);
+
+			joiners.clear();
+			for (size_t i = batch_start; i < batch_end; ++ i)
+			{
+				joiners.push_back(Context::Instance().ThreadPool()(
+					[i, batch_start, &fetch, &comed_data]
+					{
+						std::vector<uint8_t> scratch;
+						std::vector<uint8_t> const & data = fetch(scratch, i);
+						LZMACodec lzma_enc;
+						lzma_enc.Encode(comed_data[i - batch_start], &data[0], data.size());
+					}));
+			}
+			for (auto& j : joiners)
+			{
+				j();
+			}
+
+			for (size_t i = batch_start; i < batch_end; ++ i)
+			{
+				std::vector<uint8_t> const & data = comed_data[i - batch_start];
+				offsets[i + 1] = offsets[i] + data.size();
+				os.write(reinterpret_cast<char const *>(&data[0]), data.size() * sizeof(data[0]));
+			}
+		}
+	}
 
 	void u8_copy_1(uint8_t* output, uint8_t const * rhs)
 	{
@@ -117,7 +206,10 @@ namespace KlayGE
 		: root_(MakeSharedPtr<quadtree_node>()),
 			num_tiles_(num_tiles), tile_size_(tile_size), format_(format),
 			texel_size_(NumFormatBytes(format)),
-			decode_tick_(0), tile_tick_(0)
+			streaming_(false), quit_streaming_(false),
+			baked_format_(EF_Unknown), baked_border_size_(0), baked_offsets_offset_(0), baked_tile_bytes_(0),
+			cache_tile_border_size_(0), cache_tile_size_(tile_size),
+			tile_tick_(0), upload_budget_(16), has_root_tile_(false)
 	{
 		BOOST_ASSERT(num_tiles_ <= MAX_NUM_TILES);
 		BOOST_ASSERT(tile_size_ <= MAX_TILE_SIZE);
@@ -179,6 +271,19 @@ namespace KlayGE
 		}
 	}
 
+	JudaTexture::~JudaTexture()
+	{
+		{
+			std::lock_guard<std::mutex> lock(stream_mutex_);
+			quit_streaming_ = true;
+			requested_blocks_.clear();
+		}
+		if (stream_thread_)
+		{
+			(*stream_thread_)();
+		}
+	}
+
 	uint32_t JudaTexture::EncodeTileID(uint32_t level, uint32_t tile_x, uint32_t tile_y) const
 	{
 		BOOST_ASSERT(level <= MAX_TREE_LEVEL);
@@ -311,7 +416,7 @@ namespace KlayGE
 				}
 				node->attr = 0xFFFFFFFF;
 				data_blocks_[node->data_index].resize(full_tile_bytes);
-				this->DecodeATile(&data_blocks_[node->data_index], shuff, 1);
+				this->DecodeATile(&data_blocks_[node->data_index], shuff, 1, true);
 			}
 
 			for (size_t i = 0; i < shuffs.size(); ++ i)
@@ -402,9 +507,22 @@ namespace KlayGE
 	}
 
 	void JudaTexture::DecodeTiles(std::vector<std::vector<uint8_t>>& data, std::vector<uint32_t> const & tile_ids, uint32_t mipmaps)
+	{
+		this->DecodeTiles(data, tile_ids, mipmaps, nullptr);
+	}
+
+	// Waits for all the data blocks if complete is null. Otherwise only uses the decoded blocks, and tells which tiles
+	//  have all their detail.
+	void JudaTexture::DecodeTiles(std::vector<std::vector<uint8_t>>& data, std::vector<uint32_t> const & tile_ids, uint32_t mipmaps,
+		std::vector<bool>* complete)
 	{
 		BOOST_ASSERT(mipmaps - 1 <= lower_levels_);
 
+		if (complete != nullptr)
+		{
+			complete->assign(tile_ids.size(), true);
+		}
+
 		data.resize(tile_ids.size() * mipmaps);
 		std::vector<std::pair<uint32_t, uint32_t>> shuffs(tile_ids.size());
 		for (size_t i = 0; i < tile_ids.size(); ++ i)
@@ -442,13 +560,18 @@ namespace KlayGE
 				s /= 4;
 			}
 
-			this->DecodeATile(&data[index * mipmaps], shuff, mipmaps);
+			bool const tile_complete = this->DecodeATile(&data[index * mipmaps], shuff, mipmaps, nullptr == complete);
+			if (complete != nullptr)
+			{
+				(*complete)[index] = tile_complete;
+			}
 		}
 	}
 
-	void JudaTexture::DecodeATile(std::vector<uint8_t>* data, uint32_t shuff, uint32_t mipmaps)
+	// A missing block is treated as no detail, so the tile looks like an upsampled coarser tile. Returns false in that case.
+	bool JudaTexture::DecodeATile(std::vector<uint8_t>* data, uint32_t shuff, uint32_t mipmaps, bool wait)
 	{
-		++ decode_tick_;
+		bool complete = true;
 
 		uint32_t const full_tile_bytes = cache_tile_size_ * cache_tile_size_ * texel_size_;
 		uint32_t target_level = this->ShuffLevel(shuff);
@@ -529,11 +652,20 @@ namespace KlayGE
 					{
 						node = node->children[branches[i]];
 				
+						uint8_t const * block = nullptr;
 						if (node && (node->data_index != EMPTY_DATA_INDEX))
+						{
+							block = wait ? this->RetriveATile(node->data_index) : this->TryRetriveATile(node->data_index);
+							if (nullptr == block)
+							{
+								complete = false;
+							}
+						}
+						if (block != nullptr)
 						{
 							uint32_t start_x = (start_sub_tile_x >> shift) * used_w * 2;
 							uint32_t start_y = (start_sub_tile_y >> shift) * used_h * 2;
-							uint8_t const * start_src = this->RetriveATile(node->data_index) + (start_y * tile_size_ + start_x) * texel_size_;
+							uint8_t const * start_src = block + (start_y * tile_size_ + start_x) * texel_size_;
 							uint8_t* dst = &temp[0];
 							for (size_t y = 0; y < used_h * 2; ++ y)
 							{
@@ -557,6 +689,8 @@ namespace KlayGE
 				}
 			}
 		}
+
+		return complete;
 	}
 
 	uint32_t JudaTexture::DecodeAAttr(uint32_t shuff)
@@ -614,63 +748,26 @@ namespace KlayGE
 	{
 		if (data_blocks_.empty())
 		{
-			auto iter = decoded_block_cache_.find(data_index);
-			if (iter != decoded_block_cache_.end())
-			{
-				iter->second.tick = decode_tick_;
-			}
-			else
+			uint8_t* ret = this->TryRetriveATile(data_index);
+			if (nullptr == ret)
 			{
-				if (decoded_block_cache_.size() >= 64)
-				{
-					auto min_iter = decoded_block_cache_.begin();
-					uint64_t min_tick = min_iter->second.tick;
-					for (auto dbiter = decoded_block_cache_.begin();
-						dbiter != decoded_block_cache_.end(); ++ dbiter)
-					{
-						if (dbiter->second.tick < min_tick)
-						{
-							min_tick = dbiter->second.tick;
-							min_iter = dbiter;
-						}
-					}
-
-					for (auto dbiter = decoded_block_cache_.begin();
-						dbiter != decoded_block_cache_.end();)
-					{
-						if (dbiter->second.tick == min_tick)
-						{
-							dbiter = decoded_block_cache_.erase(dbiter);
-						}
-						else
-						{
-							++ dbiter;
-						}
-					}
-				}
-
 				uint32_t const full_tile_bytes = tile_size_ * tile_size_ * texel_size_;
 				std::shared_ptr<std::vector<uint8_t>> data = MakeSharedPtr<std::vector<uint8_t>>(full_tile_bytes);
 				if (data_index != EMPTY_DATA_INDEX)
 				{
-					uint64_t offsets[2];
-					input_file_->seekg(data_blocks_offset_ + data_index * sizeof(uint64_t), std::ios_base::beg);
-					input_file_->read(offsets, sizeof(offsets));
-					uint32_t const comed_len = static_cast<uint32_t>(offsets[1] - offsets[0]);
-					std::vector<uint8_t> comed_data(comed_len);
-					input_file_->seekg(offsets[0], std::ios_base::beg);
-					input_file_->read(&comed_data[0], comed_len);
-					lzma_dec_.Decode(&(*data)[0], &comed_data[0], comed_len, full_tile_bytes);
+					std::vector<uint8_t> comed_data;
+					this->ReadCompressedBlock(comed_data, data_index);
+					lzma_dec_.Decode(&(*data)[0], &comed_data[0], comed_data.size(), full_tile_bytes);
 				}
 				else
 				{
 					memset(&(*data)[0], 0, full_tile_bytes);
 				}
 
-				iter = decoded_block_cache_.emplace(data_index, DecodedBlockInfo(data, decode_tick_)).first;
+				ret = this->InsertDecodedBlock(data_index, data);
 			}
 
-			return &(*iter->second.data)[0];
+			return ret;
 		}
 		else
 		{
@@ -678,6 +775,260 @@ namespace KlayGE
 		}
 	}
 
+	uint8_t* JudaTexture::TryRetriveATile(uint32_t data_index)
+	{
+		if (!data_blocks_.empty())
+		{
+			return &data_blocks_[data_index][0];
+		}
+
+		auto iter = decoded_block_cache_.find(data_index);
+		if (iter != decoded_block_cache_.end())
+		{
+			decoded_block_lru_.splice(decoded_block_lru_.begin(), decoded_block_lru_, iter->second);
+			return &(*iter->second->second)[0];
+		}
+		else
+		{
+			if (data_index != EMPTY_DATA_INDEX)
+			{
+				this->RequestBlock(data_index);
+			}
+			return nullptr;
+		}
+	}
+
+	bool JudaTexture::TileBlocksReady(uint32_t shuff)
+	{
+		if (!data_blocks_.empty())
+		{
+			return true;
+		}
+
+		// Touches all the blocks, so that the missing ones are all requested at once
+		bool ready = true;
+		uint32_t const target_level = this->ShuffLevel(shuff);
+		quadtree_node_ptr node = root_;
+		for (uint32_t i = 0; (i <= target_level) && node; ++ i)
+		{
+			if (i > 0)
+			{
+				node = node->children[this->GetLevelBranch(shuff, i)];
+			}
+			if (node && (node->data_index != EMPTY_DATA_INDEX))
+			{
+				if (decoded_block_cache_.find(node->data_index) == decoded_block_cache_.end())
+				{
+					this->RequestBlock(node->data_index);
+					ready = false;
+				}
+			}
+		}
+
+		return ready;
+	}
+
+	uint8_t* JudaTexture::InsertDecodedBlock(uint32_t data_index, std::shared_ptr<std::vector<uint8_t>> const & data)
+	{
+		auto iter = decoded_block_cache_.find(data_index);
+		if (iter != decoded_block_cache_.end())
+		{
+			decoded_block_lru_.splice(decoded_block_lru_.begin(), decoded_block_lru_, iter->second);
+			return &(*iter->second->second)[0];
+		}
+
+		decoded_block_lru_.emplace_front(data_index, data);
+		decoded_block_cache_.emplace(data_index, decoded_block_lru_.begin());
+		while (decoded_block_lru_.size() > MAX_DECODED_BLOCKS)
+		{
+			decoded_block_cache_.erase(decoded_block_lru_.back().first);
+			decoded_block_lru_.pop_back();
+		}
+
+		return &(*data)[0];
+	}
+
+	void JudaTexture::ReadCompressedBlock(std::vector<uint8_t>& comed_data, uint32_t data_index)
+	{
+		std::lock_guard<std::mutex> lock(file_mutex_);
+
+		uint64_t offsets[2];
+		if (data_index & BAKED_BLOCK_FLAG)
+		{
+			input_file_->seekg(baked_offsets_offset_ + (data_index & ~BAKED_BLOCK_FLAG) * sizeof(uint64_t), std::ios_base::beg);
+		}
+		else
+		{
+			input_file_->seekg(data_blocks_offset_ + data_index * sizeof(uint64_t), std::ios_base::beg);
+		}
+		input_file_->read(offsets, sizeof(offsets));
+		uint32_t const comed_len = static_cast<uint32_t>(offsets[1] - offsets[0]);
+		comed_data.resize(comed_len);
+		input_file_->seekg(offsets[0], std::ios_base::beg);
+		input_file_->read(&comed_data[0], comed_len);
+	}
+
+	void JudaTexture::RequestBlock(uint32_t data_index)
+	{
+		if (!input_file_ || (EMPTY_DATA_INDEX == data_index))
+		{
+			return;
+		}
+
+		std::lock_guard<std::mutex> lock(stream_mutex_);
+		if (quit_streaming_ || !in_flight_blocks_.insert(data_index).second)
+		{
+			return;
+		}
+
+		requested_blocks_.push_back(data_index);
+		if (!streaming_)
+		{
+			// The previous streaming thread has nothing left to do, so joining it doesn't block
+			if (stream_thread_)
+			{
+				(*stream_thread_)();
+			}
+
+			streaming_ = true;
+			stream_thread_ = MakeUniquePtr<joiner<void>>(Context::Instance().ThreadPool()(
+				[this]
+				{
+					this->StreamThreadFunc();
+				}));
+		}
+	}
+
+	void JudaTexture::CollectStreamedBlocks()
+	{
+		std::vector<std::pair<uint32_t, std::shared_ptr<std::vector<uint8_t>>>> blocks;
+		{
+			std::lock_guard<std::mutex> lock(stream_mutex_);
+			blocks.swap(streamed_blocks_);
+		}
+
+		for (auto const & block : blocks)
+		{
+			this->InsertDecodedBlock(block.first, block.second);
+		}
+	}
+
+	uint32_t JudaTexture::DecodedBlockBytes(uint32_t data_index) const
+	{
+		return (data_index & BAKED_BLOCK_FLAG) ? baked_tile_bytes_ : tile_size_ * tile_size_ * texel_size_;
+	}
+
+	std::shared_ptr<std::vector<uint8_t>> JudaTexture::TryRetriveBakedTile(uint32_t tile_id)
+	{
+		if (baked_tile_ids_.empty() || !input_file_)
+		{
+			return std::shared_ptr<std::vector<uint8_t>>();
+		}
+
+		// Only usable if the cache is exactly what the tiles are baked for
+		ElementFormat const cache_format = tex_cache_ ? tex_cache_->Format() : tex_cache_array_[0]->Format();
+		if ((baked_format_ != cache_format) || (baked_border_size_ != cache_tile_border_size_) || (cache_tile_size_ != tile_size_))
+		{
+			return std::shared_ptr<std::vector<uint8_t>>();
+		}
+
+		auto id_iter = std::lower_bound(baked_tile_ids_.begin(), baked_tile_ids_.end(), tile_id);
+		if ((id_iter == baked_tile_ids_.end()) || (*id_iter != tile_id))
+		{
+			return std::shared_ptr<std::vector<uint8_t>>();
+		}
+
+		uint32_t const data_index = BAKED_BLOCK_FLAG | static_cast<uint32_t>(id_iter - baked_tile_ids_.begin());
+		auto iter = decoded_block_cache_.find(data_index);
+		if (iter != decoded_block_cache_.end())
+		{
+			decoded_block_lru_.splice(decoded_block_lru_.begin(), decoded_block_lru_, iter->second);
+			return iter->second->second;
+		}
+		else
+		{
+			this->RequestBlock(data_index);
+			return std::shared_ptr<std::vector<uint8_t>>();
+		}
+	}
+
+	void JudaTexture::StreamThreadFunc()
+	{
+		std::vector<uint32_t> indices;
+		std::vector<std::vector<uint8_t>> comed_data;
+		std::vector<std::shared_ptr<std::vector<uint8_t>>> decoded;
+		std::vector<joiner<void>> joiners;
+		LZMACodec lzma_dec;
+		for (;;)
+		{
+			indices.clear();
+			{
+				std::lock_guard<std::mutex> lock(stream_mutex_);
+				while (!requested_blocks_.empty() && (indices.size() < MAX_DECODE_BATCH))
+				{
+					indices.push_back(requested_blocks_.front());
+					requested_blocks_.pop_front();
+				}
+				if (indices.empty())
+				{
+					// Has to be cleared under the lock, otherwise a new request could be missed
+					streaming_ = false;
+					return;
+				}
+			}
+
+			// The file is shared, so the reads are serialized. The decoding is parallel.
+			comed_data.resize(indices.size());
+			decoded.resize(indices.size());
+			for (size_t i = 0; i < indices.size(); ++ i)
+			{
+				this->ReadCompressedBlock(comed_data[i], indices[i]);
+				decoded[i] = MakeSharedPtr<std::vector<uint8_t>>(this->DecodedBlockBytes(indices[i]));
+			}
+
+			joiners.clear();
+			for (size_t i = 1; i < indices.size(); ++ i)
+			{
+				joiners.push_back(Context::Instance().ThreadPool()(
+					[i, &comed_data, &decoded]
+					{
+						LZMACodec dec;
+						dec.Decode(&(*decoded[i])[0], &comed_data[i][0], comed_data[i].size(), decoded[i]->size());
+					}));
+			}
+			lzma_dec.Decode(&(*decoded[0])[0], &comed_data[0][0], comed_data[0].size(), decoded[0]->size());
+			for (auto& j : joiners)
+			{
+				j();
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(stream_mutex_);
+				for (size_t i = 0; i < indices.size(); ++ i)
+				{
+					streamed_blocks_.emplace_back(indices[i], decoded[i]);
+					in_flight_blocks_.erase(indices[i]);
+				}
+			}
+		}
+	}
+
+	void JudaTexture::UploadBudget(uint32_t tiles)
+	{
+		upload_budget_ = tiles;
+	}
+
+	uint32_t JudaTexture::UploadBudget() const
+	{
+		return upload_budget_;
+	}
+
+	size_t JudaTexture::NumPendingBlocks() const
+	{
+		std::lock_guard<std::mutex> lock(stream_mutex_);
+		return in_flight_blocks_.size();
+	}
+
 	uint32_t JudaTexture::NumNonEmptySubNodes(quadtree_node_ptr const & node) const
 	{
 		uint32_t n = 0;
@@ -888,7 +1239,7 @@ namespace KlayGE
 
 		uint32_t version;
 		file->read(&version, sizeof(version));
-		Verify(JUDA_TEX_VERSION == version);
+		Verify((version >= JUDA_TEX_MIN_VERSION) && (version <= JUDA_TEX_VERSION));
 
 		file->read(&num_tiles, sizeof(num_tiles));
 		file->read(&tile_size, sizeof(tile_size));
@@ -920,6 +1271,18 @@ namespace KlayGE
 		uint32_t data_blocks_offset;
 		file->read(&data_blocks_offset, sizeof(data_blocks_offset));
 
+		ElementFormat baked_format = EF_Unknown;
+		uint32_t baked_border_size = 0;
+		uint32_t num_baked_tiles = 0;
+		uint64_t baked_section_offset = 0;
+		if (version >= 3)
+		{
+			file->read(&baked_format, sizeof(baked_format));
+			file->read(&baked_border_size, sizeof(baked_border_size));
+			file->read(&num_baked_tiles, sizeof(num_baked_tiles));
+			file->read(&baked_section_offset, sizeof(baked_section_offset));
+		}
+
 		JudaTexturePtr ret = MakeSharedPtr<JudaTexture>(num_tiles, tile_size, format);
 
 		uint32_t tree_levels = ret->TreeLevels();
@@ -997,13 +1360,35 @@ namespace KlayGE
 		ret->data_blocks_offset_ = data_blocks_offset - (non_empty_nodes + 1) * sizeof(uint64_t);
 		ret->image_entries_ = image_entries;
 
+		if (num_baked_tiles > 0)
+		{
+			ret->baked_format_ = baked_format;
+			ret->baked_border_size_ = baked_border_size;
+			ret->baked_tile_ids_.resize(num_baked_tiles);
+			file->seekg(baked_section_offset, std::ios_base::beg);
+			file->read(&ret->baked_tile_ids_[0], num_baked_tiles * sizeof(ret->baked_tile_ids_[0]));
+			ret->baked_offsets_offset_ = baked_section_offset + num_baked_tiles * sizeof(ret->baked_tile_ids_[0]);
+
+			uint32_t mip_tile_with_border_size = tile_size + baked_border_size * 2;
+			uint32_t const mipmaps = NumCacheMipmaps(baked_format, baked_border_size, mip_tile_with_border_size);
+			ret->baked_tile_bytes_ = 0;
+			for (uint32_t l = 0; l < mipmaps; ++ l)
+			{
+				uint32_t row_pitch, slice_pitch;
+				ret->CacheTileLevelPitch(row_pitch, slice_pitch, baked_format, mip_tile_with_border_size);
+				ret->baked_tile_bytes_ += slice_pitch;
+				mip_tile_with_border_size /= 2;
+			}
+		}
+
+		// Every tile needs the root block
+		ret->RequestBlock(ret->root_->data_index);
+
 		return ret;
 	}
 
 	void SaveJudaTexture(JudaTexturePtr const & juda_tex, std::string const & file_name)
 	{
-		LZMACodec lzma_enc;
-
 		std::vector<JudaTexture::quadtree_node_ptr> this_level;
 		std::vector<JudaTexture::quadtree_node_ptr> next_level;
 
@@ -1045,6 +1430,14 @@ namespace KlayGE
 		uint32_t data_blocks_offset = 0;
 		ofs->write(reinterpret_cast<char const *>(&data_blocks_offset), sizeof(data_blocks_offset));
 
+		uint32_t const num_baked_tiles = static_cast<uint32_t>(juda_tex->baked_tile_ids_.size());
+		ofs->write(reinterpret_cast<char const *>(&juda_tex->baked_format_), sizeof(juda_tex->baked_format_));
+		ofs->write(reinterpret_cast<char const *>(&juda_tex->baked_border_size_), sizeof(juda_tex->baked_border_size_));
+		ofs->write(reinterpret_cast<char const *>(&num_baked_tiles), sizeof(num_baked_tiles));
+		std::ostream::pos_type baked_section_offset_pos = ofs->tellp();
+		uint64_t baked_section_offset = 0;
+		ofs->write(reinterpret_cast<char const *>(&baked_section_offset), sizeof(baked_section_offset));
+
 		std::vector<uint32_t> non_empty_block_data_index;
 		non_empty_block_data_index.reserve(non_empty_nodes);
 
@@ -1112,17 +1505,38 @@ namespace KlayGE
 		ofs->write(reinterpret_cast<char const *>(&block_start_pos[0]), block_start_pos.size() * sizeof(block_start_pos[0]));
 
 		block_start_pos[0] = data_blocks_offset;
-		for (size_t i = 0; i < non_empty_block_data_index.size(); ++ i)
-		{
-			std::vector<uint8_t> const & data = juda_tex->data_blocks_[non_empty_block_data_index[i]];
+		WriteCompressedBlocks(*ofs, non_empty_block_data_index.size(),
+			[&juda_tex, &non_empty_block_data_index](std::vector<uint8_t>& /*scratch*/, size_t index) -> std::vector<uint8_t> const &
+			{
+				return juda_tex->data_blocks_[non_empty_block_data_index[index]];
+			},
+			block_start_pos);
 
-			std::vector<uint8_t> comed_data;
-			lzma_enc.Encode(comed_data, &data[0], data.size());
+		if (num_baked_tiles > 0)
+		{
+			baked_section_offset = ofs->tellp();
+			ofs->write(reinterpret_cast<char const *>(&juda_tex->baked_tile_ids_[0]),
+				num_baked_tiles * sizeof(juda_tex->baked_tile_ids_[0]));
+
+			std::ostream::pos_type baked_start_offset_pos = ofs->tellp();
+			std::vector<uint64_t> baked_start_pos(num_baked_tiles + 1);
+			ofs->write(reinterpret_cast<char const *>(&baked_start_pos[0]), baked_start_pos.size() * sizeof(baked_start_pos[0]));
+
+			// The payloads are baked on the fly, so that they don't have to be all in memory
+			baked_start_pos[0] = ofs->tellp();
+			WriteCompressedBlocks(*ofs, num_baked_tiles,
+				[&juda_tex](std::vector<uint8_t>& scratch, size_t index) -> std::vector<uint8_t> const &
+				{
+					juda_tex->BakeATile(scratch, juda_tex->baked_tile_ids_[index]);
+					return scratch;
+				},
+				baked_start_pos);
 
-			uint32_t comed_len = static_cast<uint32_t>(comed_data.size());
-			block_start_pos[i + 1] = block_start_pos[i] + comed_len;
+			ofs->seekp(baked_start_offset_pos, std::ios_base::beg);
+			ofs->write(reinterpret_cast<char const *>(&baked_start_pos[0]), baked_start_pos.size() * sizeof(baked_start_pos[0]));
 
-			ofs->write(reinterpret_cast<char const *>(&comed_data[0]), comed_data.size() * sizeof(comed_data[0]));
+			ofs->seekp(baked_section_offset_pos, std::ios_base::beg);
+			ofs->write(reinterpret_cast<char const *>(&baked_section_offset), sizeof(baked_section_offset));
 		}
 
 		ofs->seekp(data_blocks_offset_pos, std::ios_base::beg);
@@ -1150,39 +1564,11 @@ namespace KlayGE
 			RenderFactory& rf = Context::Instance().RenderFactoryInstance();
 
 			uint32_t tile_with_border_size = cache_tile_size_ + cache_tile_border_size_ * 2;
-			uint32_t mipmap = 0;
-			while (cache_tile_border_size_ > (1UL << mipmap))
-			{
-				++ mipmap;
-			}
+			uint32_t mipmap = NumCacheMipmaps(format, cache_tile_border_size_, tile_with_border_size);
 			if (IsCompressedFormat(format))
 			{
-				switch (format)
-				{
-				case EF_BC1:
-					tex_codec_ = MakeUniquePtr<TexCompressionBC1>();
-					break;
-
-				case EF_BC2:
-					tex_codec_ = MakeUniquePtr<TexCompressionBC2>();
-					break;
-
-				case EF_BC3:
-					tex_codec_ = MakeUniquePtr<TexCompressionBC3>();
-					break;
-
-				default:
-					BOOST_ASSERT(false);
-					break;
-				}
-
-				// BC format must be multiply of 4
-				while (((tile_with_border_size >> mipmap) & 0x3) != 0)
-				{
-					-- mipmap;
-				}
+				tex_codec_ = CreateCacheCodec(format);
 			}
-			++ mipmap;
 
 			RenderDeviceCaps const & caps = rf.RenderEngineInstance().DeviceCaps();
 
@@ -1248,244 +1634,207 @@ namespace KlayGE
 				static_cast<float>(cache_tile_border_size_));
 	}
 
-	void JudaTexture::UpdateCache(std::vector<uint32_t> const & tile_ids)
+	// Finds the 8 neighbors of a tile, and whether they are in the same image. Returns the attribute of the tile.
+	uint32_t JudaTexture::TileNeighbors(std::array<uint32_t, 9>& new_tile_id_with_neighbors, std::array<bool, 9>& new_in_same_image,
+		uint32_t tile_id, bool with_neighbors)
 	{
-		BOOST_ASSERT(tex_cache_ || !tex_cache_array_.empty());
+		uint32_t level, tile_x, tile_y;
+		this->DecodeTileID(level, tile_x, tile_y, tile_id);
 
-		++ tile_tick_;
+		new_tile_id_with_neighbors.fill(0xFFFFFFFF);
+		new_tile_id_with_neighbors[0] = tile_id;
 
-		uint32_t const tex_width = tex_cache_ ? tex_cache_->Width(0) : tex_cache_array_[0]->Width(0);
-		uint32_t const tex_height = tex_cache_ ? tex_cache_->Height(0) : tex_cache_array_[0]->Height(0);
-		uint32_t const tex_layer = tex_cache_ ? tex_cache_->ArraySize() : static_cast<uint32_t>(tex_cache_array_.size());
-		uint32_t const tile_with_border_size = cache_tile_size_ + cache_tile_border_size_ * 2;
+		new_in_same_image.fill(false);
+		new_in_same_image[0] = true;
 
-		uint32_t const num_cache_tiles_a_row = tex_width / tile_with_border_size;
-		uint32_t const num_cache_tiles_a_layer = num_cache_tiles_a_row * tex_height / tile_with_border_size;
-		uint32_t const num_cache_total_tiles = num_cache_tiles_a_layer * tex_layer;
+		uint32_t const attr = this->DecodeAAttr(this->Pos2Shuff(level, tile_x, tile_y));
+		if (with_neighbors && (attr != 0xFFFFFFFF))
+		{
+			std::array<int32_t, 9> new_tile_id_x;
+			std::array<int32_t, 9> new_tile_id_y;
 
-		std::unordered_map<uint32_t, uint32_t> neighbor_id_map;
-		std::vector<uint32_t> all_neighbor_ids;
-		std::vector<uint32_t> neighbor_ids;
-		std::vector<uint32_t> tile_attrs;
-		std::vector<bool> in_same_image;
-		auto& tim = tile_info_map_;
-		for (size_t i = 0; i < tile_ids.size(); ++ i)
-		{
-			auto tmiter = tim.find(tile_ids[i]);
-			if (tmiter != tim.end())
-			{
-				// Exists in cache
+			int32_t left = tile_x - 1;
+			int32_t right = tile_x + 1;
+			int32_t up = tile_y - 1;
+			int32_t down = tile_y + 1;
 
-				tmiter->second.tick = tile_tick_;
+			ImageEntry const & entry = image_entries_[attr];
+			if (TAM_Wrap == (entry.addr_u_v & 0xF))
+			{
+				left = entry.x + (left - entry.x + entry.w) % entry.w;
+				right = entry.x + (right - entry.x + entry.w) % entry.w;
 			}
-			else
+			if (TAM_Wrap == ((entry.addr_u_v >> 4) & 0xF))
 			{
-				uint32_t level, tile_x, tile_y;
-				this->DecodeTileID(level, tile_x, tile_y, tile_ids[i]);
-
-				std::array<uint32_t, 9> new_tile_id_with_neighbors;
-				new_tile_id_with_neighbors.fill(0xFFFFFFFF);
-				new_tile_id_with_neighbors[0] = tile_ids[i];
-
-				std::array<bool, 9> new_in_same_image;
-				new_in_same_image.fill(false);
-				new_in_same_image[0] = true;
+				up = entry.y + (up - entry.y + entry.h) % entry.h;
+				down = entry.y + (down - entry.y + entry.h) % entry.h;
+			}
 
-				uint32_t attr = this->DecodeAAttr(this->Pos2Shuff(level, tile_x, tile_y));
-				tile_attrs.push_back(attr);
-				if (attr != 0xFFFFFFFF)
+			new_tile_id_x[1] = left;
+			new_tile_id_y[1] = up;
+			new_tile_id_x[2] = tile_x;
+			new_tile_id_y[2] = up;
+			new_tile_id_x[3] = right;
+			new_tile_id_y[3] = up;
+
+			new_tile_id_x[4] = left;
+			new_tile_id_y[4] = tile_y;
+			new_tile_id_x[5] = right;
+			new_tile_id_y[5] = tile_y;
+
+			new_tile_id_x[6] = left;
+			new_tile_id_y[6] = down;
+			new_tile_id_x[7] = tile_x;
+			new_tile_id_y[7] = down;
+			new_tile_id_x[8] = right;
+			new_tile_id_y[8] = down;
+
+			for (int j = 1; j < 9; ++ j)
+			{
+				if ((new_tile_id_x[j] >= 0) && (new_tile_id_y[j] >= 0)
+					&& (new_tile_id_x[j] < static_cast<int32_t>(num_tiles_) - 1)
+					&& (new_tile_id_y[j] < static_cast<int32_t>(num_tiles_) - 1))
 				{
-					std::array<int32_t, 9> new_tile_id_x;
-					std::array<int32_t, 9> new_tile_id_y;
-
-					int32_t left = tile_x - 1;
-					int32_t right = tile_x + 1;
-					int32_t up = tile_y - 1;
-					int32_t down = tile_y + 1;
-
-					ImageEntry const & entry = image_entries_[attr];
-					if (TAM_Wrap == (entry.addr_u_v & 0xF))
-					{
-						left = entry.x + (left - entry.x + entry.w) % entry.w;
-						right = entry.x + (right - entry.x + entry.w) % entry.w;
-					}
-					if (TAM_Wrap == ((entry.addr_u_v >> 4) & 0xF))
-					{
-						up = entry.y + (up - entry.y + entry.h) % entry.h;
-						down = entry.y + (down - entry.y + entry.h) % entry.h;
-					}
-
-					new_tile_id_x[1] = left;
-					new_tile_id_y[1] = up;
-					new_tile_id_x[2] = tile_x;
-					new_tile_id_y[2] = up;
-					new_tile_id_x[3] = right;
-					new_tile_id_y[3] = up;
-
-					new_tile_id_x[4] = left;
-					new_tile_id_y[4] = tile_y;
-					new_tile_id_x[5] = right;
-					new_tile_id_y[5] = tile_y;
-
-					new_tile_id_x[6] = left;
-					new_tile_id_y[6] = down;
-					new_tile_id_x[7] = tile_x;
-					new_tile_id_y[7] = down;
-					new_tile_id_x[8] = right;
-					new_tile_id_y[8] = down;
-
-					for (int j = 1; j < 9; ++ j)
+					new_tile_id_with_neighbors[j] = this->EncodeTileID(level, new_tile_id_x[j], new_tile_id_y[j]);
+					if (new_tile_id_with_neighbors[j] != 0xFFFFFFFF)
 					{
-						if ((new_tile_id_x[j] >= 0) && (new_tile_id_y[j] >= 0)
-							&& (new_tile_id_x[j] < static_cast<int32_t>(num_tiles_) - 1)
-							&& (new_tile_id_y[j] < static_cast<int32_t>(num_tiles_) - 1))
-						{
-							new_tile_id_with_neighbors[j] = this->EncodeTileID(level, new_tile_id_x[j], new_tile_id_y[j]);
-							if (new_tile_id_with_neighbors[j] != 0xFFFFFFFF)
-							{
-								if (attr == this->DecodeAAttr(this->Pos2Shuff(level, new_tile_id_x[j], new_tile_id_y[j])))
-								{
-									new_in_same_image[j] = true;
-								}
-							}
-						}
-						else
+						if (attr == this->DecodeAAttr(this->Pos2Shuff(level, new_tile_id_x[j], new_tile_id_y[j])))
 						{
-							new_tile_id_with_neighbors[j] = 0xFFFFFFFF;
+							new_in_same_image[j] = true;
 						}
 					}
 				}
-
-				for (size_t j = 0; j < new_tile_id_with_neighbors.size(); ++ j)
+				else
 				{
-					if (new_tile_id_with_neighbors[j] != 0xFFFFFFFF)
-					{
-						if (neighbor_id_map.find(new_tile_id_with_neighbors[j]) == neighbor_id_map.end())
-						{
-							neighbor_id_map.emplace(new_tile_id_with_neighbors[j], static_cast<uint32_t>(neighbor_ids.size()));
-							neighbor_ids.push_back(new_tile_id_with_neighbors[j]);
-						}
-					}
-					all_neighbor_ids.push_back(new_tile_id_with_neighbors[j]);
-					in_same_image.push_back(new_in_same_image[j]);
+					new_tile_id_with_neighbors[j] = 0xFFFFFFFF;
 				}
 			}
 		}
 
-		uint32_t mipmaps = tex_cache_->NumMipMaps();
-		std::vector<std::vector<uint8_t>> neighbor_data;
-		this->DecodeTiles(neighbor_data, neighbor_ids, mipmaps);
+		return attr;
+	}
 
-		TileInfo tile_info;
-		tile_info.tick = tile_tick_;
-		for (size_t i = 0; i < all_neighbor_ids.size(); i += 9)
+	void JudaTexture::BakeCacheTiles(ElementFormat format, uint32_t border_size)
+	{
+		BOOST_ASSERT(IsCompressedFormat(format));
+
+		baked_format_ = format;
+		baked_border_size_ = border_size;
+		cache_tile_size_ = tile_size_;
+		cache_tile_border_size_ = border_size;
+
+		baked_tile_ids_.clear();
+		uint32_t const level = tree_levels_ - 1;
+		for (uint32_t attr = 0; attr < image_entries_.size(); ++ attr)
 		{
-			tile_info.attr = tile_attrs[i / 9];
-			uint8_t border_clr[4];
-			TexAddressingMode addr_u, addr_v;
-			if (tile_info.attr != 0xFFFFFFFF)
+			ImageEntry const & entry = image_entries_[attr];
+			for (uint32_t y = entry.y, y_end = std::min<uint32_t>(entry.y + entry.h, num_tiles_); y < y_end; ++ y)
 			{
-				ImageEntry const & entry = image_entries_[tile_info.attr];
-				addr_u = static_cast<TexAddressingMode>(entry.addr_u_v & 0xF);
-				addr_v = static_cast<TexAddressingMode>((entry.addr_u_v >> 4) & 0xF);
-				texel_op_.from_float4(border_clr, &entry.border_clr.r());
-			}
-			else
-			{
-				addr_u = TAM_Clamp;
-				addr_v = TAM_Clamp;
-				border_clr[0] = border_clr[1] = border_clr[2] = border_clr[3] = 0;
+				for (uint32_t x = entry.x, x_end = std::min<uint32_t>(entry.x + entry.w, num_tiles_); x < x_end; ++ x)
+				{
+					if (this->DecodeAAttr(this->Pos2Shuff(level, x, y)) == attr)
+					{
+						baked_tile_ids_.push_back(this->EncodeTileID(level, x, y));
+					}
+				}
 			}
+		}
+		std::sort(baked_tile_ids_.begin(), baked_tile_ids_.end());
+		baked_tile_ids_.erase(std::unique(baked_tile_ids_.begin(), baked_tile_ids_.end()), baked_tile_ids_.end());
+	}
 
-			if (tile_info_map_.size() < num_cache_total_tiles)
-			{
-				// Still has space in cache
-
-				uint32_t const s = tile_free_list_.front().first;
-				tile_info.z = s / num_cache_tiles_a_layer;
-				tile_info.y = (s - tile_info.z * num_cache_tiles_a_layer) / num_cache_tiles_a_row;
-				tile_info.x = s - tile_info.z * num_cache_tiles_a_layer - tile_info.y * num_cache_tiles_a_row;
+	// Produces exactly what UpdateCache uploads for the tile. Called from many threads when saving.
+	void JudaTexture::BakeATile(std::vector<uint8_t>& payload, uint32_t tile_id)
+	{
+		std::array<uint32_t, 9> neighbor_ids;
+		std::array<bool, 9> same_image;
+		uint32_t const attr = this->TileNeighbors(neighbor_ids, same_image, tile_id, true);
 
-				++ tile_free_list_.front().first;
-				if (tile_free_list_.front().first == tile_free_list_.front().second)
+		std::vector<uint32_t> decode_ids;
+		std::vector<uint32_t> index_with_neighbors(neighbor_ids.size());
+		for (size_t j = 0; j < neighbor_ids.size(); ++ j)
+		{
+			if (neighbor_ids[j] != 0xFFFFFFFF)
+			{
+				auto iter = std::find(decode_ids.begin(), decode_ids.end(), neighbor_ids[j]);
+				index_with_neighbors[j] = static_cast<uint32_t>(iter - decode_ids.begin());
+				if (iter == decode_ids.end())
 				{
-					tile_free_list_.pop_front();
+					decode_ids.push_back(neighbor_ids[j]);
 				}
 			}
 			else
 			{
-				// Find tiles that are not used for the longest time
+				index_with_neighbors[j] = 0xFFFFFFFF;
+			}
+		}
 
-				uint64_t min_tick = tim.begin()->second.tick;
-				auto min_tileiter = tim.begin();
-				for (auto tileiter = tim.begin(); tileiter != tim.end(); ++ tileiter)
-				{
-					if (tileiter->second.tick < min_tick)
-					{
-						min_tick = tileiter->second.tick;
-						min_tileiter = tileiter;
-					}
-				}
+		uint32_t const mipmaps = NumCacheMipmaps(baked_format_, baked_border_size_, tile_size_ + baked_border_size_ * 2);
+		std::vector<std::vector<uint8_t>> neighbor_data;
+		this->DecodeTiles(neighbor_data, decode_ids, mipmaps);
 
-				tile_info.x = min_tileiter->second.x;
-				tile_info.y = min_tileiter->second.y;
-				tile_info.z = min_tileiter->second.z;
+		std::unique_ptr<TexCompression> codec = CreateCacheCodec(baked_format_);
+		std::vector<std::vector<uint8_t>> levels;
+		this->BuildCacheTiles(levels, baked_format_, codec.get(), mipmaps, neighbor_data, index_with_neighbors,
+			std::vector<bool>(same_image.begin(), same_image.end()), std::vector<uint32_t>(1, attr));
 
-				for (auto tileiter = tim.begin(); tileiter != tim.end();)
-				{
-					if (tileiter->second.tick == min_tick)
-					{
-						uint32_t const id = tileiter->second.z * num_cache_tiles_a_layer + tileiter->second.y * num_cache_tiles_a_row + tileiter->second.x;
-						auto freeiter = tile_free_list_.begin();
-						while ((freeiter != tile_free_list_.end()) && (freeiter->second <= id))
-						{
-							++ freeiter;
-						}
-						tile_free_list_.emplace(freeiter, id, id + 1);
+		payload.clear();
+		for (auto const & level : levels)
+		{
+			payload.insert(payload.end(), level.begin(), level.end());
+		}
+	}
 
-						tileiter = tim.erase(tileiter);
-					}
-					else
-					{
-						 ++ tileiter;
-					}
-				}
-				for (auto freeiter = tile_free_list_.begin(); freeiter != tile_free_list_.end() - 1;)
-				{
-					auto nextiter = freeiter;
-					++ nextiter;
+	void JudaTexture::CacheTileLevelPitch(uint32_t& row_pitch, uint32_t& slice_pitch, ElementFormat format, uint32_t size) const
+	{
+		if (IsCompressedFormat(format))
+		{
+			uint32_t const block_bytes = NumFormatBytes(format) * 4;
+			row_pitch = (size + 3) / 4 * block_bytes;
+			slice_pitch = (size + 3) / 4 * row_pitch;
+		}
+		else
+		{
+			row_pitch = size * texel_size_;
+			slice_pitch = size * row_pitch;
+		}
+	}
 
-					if (freeiter->second == nextiter->first)
-					{
-						freeiter->second = nextiter->second;
-						freeiter = tile_free_list_.erase(nextiter);
-						-- freeiter;
-					}
-					else
-					{
-						++ freeiter;
-					}
-				}
+	// Builds the tiles with their borders in all the cache mipmaps. Each tile has 9 entries in index_with_neighbors and
+	//  in_same_image, and tiles with 0xFFFFFFFF as the first index are skipped. Level l of the n-th tile goes to
+	//  levels[n * mipmaps + l], encoded if format is a BC format.
+	void JudaTexture::BuildCacheTiles(std::vector<std::vector<uint8_t>>& levels, ElementFormat format, TexCompression* codec,
+		uint32_t mipmaps, std::vector<std::vector<uint8_t>> const & neighbor_data,
+		std::vector<uint32_t> const & index_with_neighbors, std::vector<bool> const & in_same_image,
+		std::vector<uint32_t> const & tile_attrs)
+	{
+		levels.resize(tile_attrs.size() * mipmaps);
+		for (size_t i = 0; i < index_with_neighbors.size(); i += 9)
+		{
+			if (0xFFFFFFFF == index_with_neighbors[i])
+			{
+				continue;
 			}
 
-			std::array<uint32_t, 9> index_with_neighbors = { { 0 } };
-			for (size_t j = 0; j < index_with_neighbors.size(); ++ j)
+			uint32_t const attr = tile_attrs[i / 9];
+			uint8_t border_clr[4];
+			TexAddressingMode addr_u, addr_v;
+			if (attr != 0xFFFFFFFF)
 			{
-				if (all_neighbor_ids[i + j] != 0xFFFFFFFF)
-				{
-					BOOST_ASSERT(neighbor_id_map.find(all_neighbor_ids[i + j]) != neighbor_id_map.end());
-
-					index_with_neighbors[j] = neighbor_id_map[all_neighbor_ids[i + j]];
-				}
-				else
-				{
-					index_with_neighbors[j] = 0xFFFFFFFF;
-				}
+				ImageEntry const & entry = image_entries_[attr];
+				addr_u = static_cast<TexAddressingMode>(entry.addr_u_v & 0xF);
+				addr_v = static_cast<TexAddressingMode>((entry.addr_u_v >> 4) & 0xF);
+				texel_op_.from_float4(border_clr, &entry.border_clr.r());
+			}
+			else
+			{
+				addr_u = TAM_Clamp;
+				addr_v = TAM_Clamp;
+				border_clr[0] = border_clr[1] = border_clr[2] = border_clr[3] = 0;
 			}
-			BOOST_ASSERT(index_with_neighbors[0] != 0xFFFFFFFF);
 
 			uint32_t mip_tile_size = cache_tile_size_;
-			uint32_t mip_tile_with_border_size = tile_with_border_size;
+			uint32_t mip_tile_with_border_size = cache_tile_size_ + cache_tile_border_size_ * 2;
 			uint32_t mip_border_size = cache_tile_border_size_;
 			for (uint32_t l = 0; l < mipmaps; ++ l)
 			{
@@ -1496,9 +1845,9 @@ namespace KlayGE
 #endif
 				for (uint32_t j = 0; j < neighbor_data_ptr.size(); ++ j)
 				{
-					if (index_with_neighbors[j] != 0xFFFFFFFF)
+					if (index_with_neighbors[i + j] != 0xFFFFFFFF)
 					{
-						neighbor_data_ptr[j] = &neighbor_data[index_with_neighbors[j] * mipmaps + l][0];
+						neighbor_data_ptr[j] = &neighbor_data[index_with_neighbors[i + j] * mipmaps + l][0];
 					}
 					else
 					{
@@ -1510,7 +1859,7 @@ namespace KlayGE
 				{
 					uint8_t* data_with_border = &tex_a_tile_data[0];
 					uint32_t const data_pitch = mip_tile_with_border_size * texel_size_;
-				
+			
 					for (uint32_t y = 0; y < mip_tile_size; ++ y)
 					{
 						texel_op_.copy_array(data_with_border + (y + mip_border_size) * data_pitch + mip_border_size * texel_size_,
@@ -1528,7 +1877,7 @@ namespace KlayGE
 					}
 					else
 					{
-						if (tile_info.attr != 0xFFFFFFFF)
+						if (attr != 0xFFFFFFFF)
 						{
 							std::vector<int32_t> border_coords_x(mip_border_size * mip_border_size);
 							std::vector<int32_t> border_coords_y(mip_border_size * mip_border_size);
@@ -1643,7 +1992,7 @@ namespace KlayGE
 					}
 					else
 					{
-						if (tile_info.attr != 0xFFFFFFFF)
+						if (attr != 0xFFFFFFFF)
 						{
 							std::vector<int32_t> border_coords_x(mip_tile_size * mip_border_size);
 							std::vector<int32_t> border_coords_y(mip_tile_size * mip_border_size);
@@ -1755,7 +2104,7 @@ namespace KlayGE
 					}
 					else
 					{
-						if (tile_info.attr != 0xFFFFFFFF)
+						if (attr != 0xFFFFFFFF)
 						{
 							std::vector<int32_t> border_coords_x(mip_border_size * mip_border_size);
 							std::vector<int32_t> border_coords_y(mip_border_size * mip_border_size);
@@ -1871,7 +2220,7 @@ namespace KlayGE
 					}
 					else
 					{
-						if (tile_info.attr != 0xFFFFFFFF)
+						if (attr != 0xFFFFFFFF)
 						{
 							std::vector<int32_t> border_coords_x(mip_border_size * mip_tile_size);
 							std::vector<int32_t> border_coords_y(mip_border_size * mip_tile_size);
@@ -1986,7 +2335,7 @@ namespace KlayGE
 					}
 					else
 					{
-						if (tile_info.attr != 0xFFFFFFFF)
+						if (attr != 0xFFFFFFFF)
 						{
 							std::vector<int32_t> border_coords_x(mip_border_size * mip_tile_size);
 							std::vector<int32_t> border_coords_y(mip_border_size * mip_tile_size);
@@ -2102,7 +2451,7 @@ namespace KlayGE
 					}
 					else
 					{
-						if (tile_info.attr != 0xFFFFFFFF)
+						if (attr != 0xFFFFFFFF)
 						{
 							std::vector<int32_t> border_coords_x(mip_border_size * mip_border_size);
 							std::vector<int32_t> border_coords_y(mip_border_size * mip_border_size);
@@ -2217,7 +2566,7 @@ namespace KlayGE
 					}
 					else
 					{
-						if (tile_info.attr != 0xFFFFFFFF)
+						if (attr != 0xFFFFFFFF)
 						{
 							std::vector<int32_t> border_coords_x(mip_tile_size * mip_border_size);
 							std::vector<int32_t> border_coords_y(mip_tile_size * mip_border_size);
@@ -2329,7 +2678,7 @@ namespace KlayGE
 					}
 					else
 					{
-						if (tile_info.attr != 0xFFFFFFFF)
+						if (attr != 0xFFFFFFFF)
 						{
 							std::vector<int32_t> border_coords_x(mip_border_size * mip_border_size);
 							std::vector<int32_t> border_coords_y(mip_border_size * mip_border_size);
@@ -2436,33 +2785,11 @@ namespace KlayGE
 					}
 				}
 
-				ElementFormat format;
-				if (tex_cache_)
-				{
-					format = tex_cache_->Format();
-				}
-				else
-				{
-					format = tex_cache_array_[tile_info.z]->Format();
-				}
-
-				TexturePtr target_tex;
-				uint32_t target_array_index;
-				if (tex_cache_)
-				{
-					target_tex = tex_cache_;
-					target_array_index = tile_info.z;
-				}
-				else
-				{
-					target_tex = tex_cache_array_[tile_info.z];
-					target_array_index = 0;
-				}
-
 				if (IsCompressedFormat(format))
 				{
-					uint32_t const block_width = tex_codec_->BlockWidth();
-					uint32_t const block_height = tex_codec_->BlockHeight();
+					BOOST_ASSERT(codec != nullptr);
+					uint32_t const block_width = codec->BlockWidth();
+					uint32_t const block_height = codec->BlockHeight();
 					uint32_t const block_bytes = NumFormatBytes(format) * 4;
 					uint32_t const bc_row_pitch = (mip_tile_with_border_size + block_width - 1) / block_width * block_bytes;
 					uint32_t const bc_slice_pitch = (mip_tile_with_border_size + block_height - 1) / block_height * bc_row_pitch;
@@ -2544,27 +2871,272 @@ namespace KlayGE
 							break;
 						}
 
-						tex_codec_->EncodeMem(mip_tile_with_border_size, mip_tile_with_border_size,
+						codec->EncodeMem(mip_tile_with_border_size, mip_tile_with_border_size,
 							&bc[0], bc_row_pitch, bc_slice_pitch, p_argb, row_pitch, slice_pitch, TCM_Quality);
 					}
 
-					target_tex->UpdateSubresource2D(target_array_index, l,
-						tile_info.x * mip_tile_with_border_size, tile_info.y * mip_tile_with_border_size,
-						mip_tile_with_border_size, mip_tile_with_border_size,
-						&bc[0], bc_row_pitch);
+					levels[i / 9 * mipmaps + l].swap(bc);
 				}
 				else
 				{
-					target_tex->UpdateSubresource2D(target_array_index, l,
-						tile_info.x * mip_tile_with_border_size, tile_info.y * mip_tile_with_border_size,
-						mip_tile_with_border_size, mip_tile_with_border_size,
-						&tex_a_tile_data[0], mip_tile_with_border_size * texel_size_);
+					levels[i / 9 * mipmaps + l].swap(tex_a_tile_data);
 				}
 
 				mip_tile_size /= 2;
 				mip_tile_with_border_size /= 2;
 				mip_border_size /= 2;
 			}
+		}
+	}
+
+	void JudaTexture::UpdateCache(std::vector<uint32_t> const & tile_ids)
+	{
+		BOOST_ASSERT(tex_cache_ || !tex_cache_array_.empty());
+
+		this->CollectStreamedBlocks();
+
+		++ tile_tick_;
+
+		uint32_t const tex_width = tex_cache_ ? tex_cache_->Width(0) : tex_cache_array_[0]->Width(0);
+		uint32_t const tex_height = tex_cache_ ? tex_cache_->Height(0) : tex_cache_array_[0]->Height(0);
+		uint32_t const tex_layer = tex_cache_ ? tex_cache_->ArraySize() : static_cast<uint32_t>(tex_cache_array_.size());
+		uint32_t const tile_with_border_size = cache_tile_size_ + cache_tile_border_size_ * 2;
+
+		uint32_t const num_cache_tiles_a_row = tex_width / tile_with_border_size;
+		uint32_t const num_cache_tiles_a_layer = num_cache_tiles_a_row * tex_height / tile_with_border_size;
+		uint32_t const num_cache_total_tiles = num_cache_tiles_a_layer * tex_layer;
+
+		std::unordered_map<uint32_t, uint32_t> neighbor_id_map;
+		std::vector<uint32_t> all_neighbor_ids;
+		std::vector<uint32_t> neighbor_ids;
+		std::vector<uint32_t> tile_attrs;
+		std::vector<bool> in_same_image;
+		std::vector<bool> refining;
+		std::vector<std::shared_ptr<std::vector<uint8_t>>> baked_tiles;
+		auto queue_upload = [&](uint32_t tile_id, bool refine)
+		{
+			refining.push_back(refine);
+
+			// A baked tile is uploaded as it is, without decoding it and its neighbors
+			std::shared_ptr<std::vector<uint8_t>> baked = this->TryRetriveBakedTile(tile_id);
+			baked_tiles.push_back(baked);
+
+			std::array<uint32_t, 9> new_tile_id_with_neighbors;
+			std::array<bool, 9> new_in_same_image;
+			uint32_t attr = this->TileNeighbors(new_tile_id_with_neighbors, new_in_same_image, tile_id, !baked);
+			tile_attrs.push_back(attr);
+
+			for (size_t j = 0; j < new_tile_id_with_neighbors.size(); ++ j)
+			{
+				if (!baked && (new_tile_id_with_neighbors[j] != 0xFFFFFFFF))
+				{
+					if (neighbor_id_map.find(new_tile_id_with_neighbors[j]) == neighbor_id_map.end())
+					{
+						neighbor_id_map.emplace(new_tile_id_with_neighbors[j], static_cast<uint32_t>(neighbor_ids.size()));
+						neighbor_ids.push_back(new_tile_id_with_neighbors[j]);
+					}
+				}
+				all_neighbor_ids.push_back(new_tile_id_with_neighbors[j]);
+				in_same_image.push_back(new_in_same_image[j]);
+			}
+		};
+
+		// The root tile stays in the cache, outside of the LRU, so a tile over the budget always has a coarser tile to
+		//  show. It's the first upload, and doesn't count against the budget.
+		bool const uploading_root = !has_root_tile_;
+		if (uploading_root)
+		{
+			queue_upload(this->EncodeTileID(0, 0, 0), false);
+		}
+
+		// Every tile decoded and uploaded, new or refined, counts against the budget
+		uint32_t num_uploads = 0;
+		std::vector<uint32_t> over_budget_ids;
+		auto& tim = tile_info_map_;
+		for (size_t i = 0; i < tile_ids.size(); ++ i)
+		{
+			uint32_t level, tile_x, tile_y;
+			this->DecodeTileID(level, tile_x, tile_y, tile_ids[i]);
+
+			auto tmiter = tim.find(tile_ids[i]);
+			if (tmiter != tim.end())
+			{
+				// Exists in cache
+
+				tmiter->second.tick = tile_tick_;
+
+				// Decoded without some of its blocks. Uploads it again when all of them arrive.
+				if (!tmiter->second.complete && (num_uploads < upload_budget_)
+					&& (this->TryRetriveBakedTile(tile_ids[i]) || this->TileBlocksReady(this->Pos2Shuff(level, tile_x, tile_y))))
+				{
+					queue_upload(tile_ids[i], true);
+					++ num_uploads;
+				}
+			}
+			else if (num_uploads < upload_budget_)
+			{
+				queue_upload(tile_ids[i], false);
+				++ num_uploads;
+			}
+			else
+			{
+				over_budget_ids.push_back(tile_ids[i]);
+			}
+		}
+
+		ElementFormat const format = tex_cache_ ? tex_cache_->Format() : tex_cache_array_[0]->Format();
+		uint32_t mipmaps = tex_cache_ ? tex_cache_->NumMipMaps() : tex_cache_array_[0]->NumMipMaps();
+		std::vector<std::vector<uint8_t>> neighbor_data;
+		std::vector<bool> neighbor_complete;
+		this->DecodeTiles(neighbor_data, neighbor_ids, mipmaps, &neighbor_complete);
+
+		// Baked tiles are uploaded as they are, so they are skipped here
+		std::vector<uint32_t> index_with_neighbors(all_neighbor_ids.size());
+		for (size_t i = 0; i < all_neighbor_ids.size(); ++ i)
+		{
+			auto iter = neighbor_id_map.find(all_neighbor_ids[i]);
+			index_with_neighbors[i] = (!baked_tiles[i / 9] && (iter != neighbor_id_map.end())) ? iter->second : 0xFFFFFFFF;
+		}
+		std::vector<std::vector<uint8_t>> levels;
+		this->BuildCacheTiles(levels, format, tex_codec_.get(), mipmaps, neighbor_data, index_with_neighbors, in_same_image,
+			tile_attrs);
+
+		TileInfo tile_info;
+		tile_info.tick = tile_tick_;
+		for (size_t i = 0; i < all_neighbor_ids.size(); i += 9)
+		{
+			tile_info.attr = tile_attrs[i / 9];
+			tile_info.complete = baked_tiles[i / 9] ? true : neighbor_complete[neighbor_id_map[all_neighbor_ids[i]]];
+
+			auto refine_iter = refining[i / 9] ? tim.find(all_neighbor_ids[i]) : tim.end();
+			if (refine_iter != tim.end())
+			{
+				// Overwrites the tile in place
+
+				tile_info.x = refine_iter->second.x;
+				tile_info.y = refine_iter->second.y;
+				tile_info.z = refine_iter->second.z;
+			}
+			else if (tile_info_map_.size() + (has_root_tile_ ? 1 : 0) < num_cache_total_tiles)
+			{
+				// Still has space in cache
+
+				uint32_t const s = tile_free_list_.front().first;
+				tile_info.z = s / num_cache_tiles_a_layer;
+				tile_info.y = (s - tile_info.z * num_cache_tiles_a_layer) / num_cache_tiles_a_row;
+				tile_info.x = s - tile_info.z * num_cache_tiles_a_layer - tile_info.y * num_cache_tiles_a_row;
+
+				++ tile_free_list_.front().first;
+				if (tile_free_list_.front().first == tile_free_list_.front().second)
+				{
+					tile_free_list_.pop_front();
+				}
+			}
+			else
+			{
+				// Find tiles that are not used for the longest time
+
+				BOOST_ASSERT(!tim.empty());
+				uint64_t min_tick = tim.begin()->second.tick;
+				auto min_tileiter = tim.begin();
+				for (auto tileiter = tim.begin(); tileiter != tim.end(); ++ tileiter)
+				{
+					if (tileiter->second.tick < min_tick)
+					{
+						min_tick = tileiter->second.tick;
+						min_tileiter = tileiter;
+					}
+				}
+
+				tile_info.x = min_tileiter->second.x;
+				tile_info.y = min_tileiter->second.y;
+				tile_info.z = min_tileiter->second.z;
+
+				for (auto tileiter = tim.begin(); tileiter != tim.end();)
+				{
+					if (tileiter->second.tick == min_tick)
+					{
+						uint32_t const id = tileiter->second.z * num_cache_tiles_a_layer + tileiter->second.y * num_cache_tiles_a_row + tileiter->second.x;
+						auto freeiter = tile_free_list_.begin();
+						while ((freeiter != tile_free_list_.end()) && (freeiter->second <= id))
+						{
+							++ freeiter;
+						}
+						tile_free_list_.emplace(freeiter, id, id + 1);
+
+						tileiter = tim.erase(tileiter);
+					}
+					else
+					{
+						 ++ tileiter;
+					}
+				}
+				for (auto freeiter = tile_free_list_.begin(); freeiter != tile_free_list_.end() - 1;)
+				{
+					auto nextiter = freeiter;
+					++ nextiter;
+
+					if (freeiter->second == nextiter->first)
+					{
+						freeiter->second = nextiter->second;
+						freeiter = tile_free_list_.erase(nextiter);
+						-- freeiter;
+					}
+					else
+					{
+						++ freeiter;
+					}
+				}
+			}
+
+			if (baked_tiles[i / 9])
+			{
+				std::vector<uint8_t> const & baked = *baked_tiles[i / 9];
+				uint32_t offset = 0;
+				uint32_t mip_tile_with_border_size = tile_with_border_size;
+				for (uint32_t l = 0; l < mipmaps; ++ l)
+				{
+					uint32_t row_pitch, slice_pitch;
+					this->CacheTileLevelPitch(row_pitch, slice_pitch, format, mip_tile_with_border_size);
+					levels[i / 9 * mipmaps + l].assign(baked.begin() + offset, baked.begin() + offset + slice_pitch);
+					offset += slice_pitch;
+					mip_tile_with_border_size /= 2;
+				}
+			}
+
+			TexturePtr target_tex;
+			uint32_t target_array_index;
+			if (tex_cache_)
+			{
+				target_tex = tex_cache_;
+				target_array_index = tile_info.z;
+			}
+			else
+			{
+				target_tex = tex_cache_array_[tile_info.z];
+				target_array_index = 0;
+			}
+
+			uint32_t mip_tile_with_border_size = tile_with_border_size;
+			for (uint32_t l = 0; l < mipmaps; ++ l)
+			{
+				uint32_t row_pitch, slice_pitch;
+				this->CacheTileLevelPitch(row_pitch, slice_pitch, format, mip_tile_with_border_size);
+				target_tex->UpdateSubresource2D(target_array_index, l,
+					tile_info.x * mip_tile_with_border_size, tile_info.y * mip_tile_with_border_size,
+					mip_tile_with_border_size, mip_tile_with_border_size,
+					&levels[i / 9 * mipmaps + l][0], row_pitch);
+
+				mip_tile_with_border_size /= 2;
+			}
+
+			if (uploading_root && (0 == i))
+			{
+				// Only a fallback, it has no indirect entry of its own
+				root_tile_info_ = tile_info;
+				has_root_tile_ = true;
+				continue;
+			}
 
 			uint8_t const a_tile_indirect[] =
 			{
@@ -2577,7 +3149,37 @@ namespace KlayGE
 			this->DecodeTileID(level, tile_x, tile_y, all_neighbor_ids[i]);
 			tex_indirect_->UpdateSubresource2D(0, 0, tile_x, tile_y, 1, 1, a_tile_indirect, sizeof(a_tile_indirect));
 
-			tim.emplace(all_neighbor_ids[i], tile_info);
+			tim[all_neighbor_ids[i]] = tile_info;
+		}
+
+		// The tiles over the budget show a quadrant of their closest ancestor in the cache for this frame. The alpha of
+		//  the indirect entry is the number of levels up. They are uploaded in the next calls, as the budget allows.
+		for (auto const tile_id : over_budget_ids)
+		{
+			uint32_t level, tile_x, tile_y;
+			this->DecodeTileID(level, tile_x, tile_y, tile_id);
+
+			TileInfo const * ancestor = &root_tile_info_;
+			uint32_t levels_up = level;
+			for (uint32_t l = 1; l <= level; ++ l)
+			{
+				auto iter = tim.find(this->EncodeTileID(level - l, tile_x >> l, tile_y >> l));
+				if (iter != tim.end())
+				{
+					ancestor = &iter->second;
+					levels_up = l;
+					break;
+				}
+			}
+
+			uint8_t const a_tile_indirect[] =
+			{
+				static_cast<uint8_t>(ancestor->x),
+				static_cast<uint8_t>(ancestor->y),
+				static_cast<uint8_t>(ancestor->z),
+				static_cast<uint8_t>(levels_up)
+			};
+			tex_indirect_->UpdateSubresource2D(0, 0, tile_x, tile_y, 1, 1, a_tile_indirect, sizeof(a_tile_indirect));
 		}
 	}
 }
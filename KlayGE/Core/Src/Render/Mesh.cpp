@@ -32,6 +32,7 @@
 #include <KlayGE/LZMACodec.hpp>
 #include <KlayGE/Light.hpp>
 #include <KlayGE/RenderMaterial.hpp>
+#include <KlayGE/MeshMLJIT.hpp>
 #include <KFL/Hash.hpp>
 
 #include <algorithm>
@@ -942,33 +943,14 @@ namespace KlayGE
 #if KLAYGE_IS_DEV_PLATFORM
 		if (jit)
 		{
-			std::string meshmljit_name = "MeshMLJIT" KLAYGE_DBG_SUFFIX;
-#ifdef KLAYGE_PLATFORM_WINDOWS_DESKTOP
-			meshmljit_name += ".exe";
-#endif
-			meshmljit_name = ResLoader::Instance().Locate(meshmljit_name);
-			bool failed = false;
-			if (meshmljit_name.empty())
+			// In process, so that it runs on the loading thread and uses the thread pool for the meshes
+			try
 			{
-				failed = true;
-			}
-			else
-			{
-#ifndef KLAYGE_PLATFORM_WINDOWS
-				if (std::string::npos == meshmljit_name.find("/"))
-				{
-					meshmljit_name = "./" + meshmljit_name;
-				}
-#endif
-				if (system((meshmljit_name + " -I \"" + meshml_name + "\" -T \"" + folder_name + "\" -q").c_str()) != 0)
-				{
-					failed = true;
-				}
+				MeshMLJIT(meshml_name, folder_name, "");
 			}
-
-			if (failed)
+			catch (std::exception& ex)
 			{
-				LogError("MeshMLJIT failed. Forgot to build Tools?");
+				LogError("MeshMLJIT failed on %s: %s", meshml_name.c_str(), ex.what());
 			}
 		}
 #else
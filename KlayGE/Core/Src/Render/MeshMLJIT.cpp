@@ -0,0 +1,2404 @@
+/**
+ * @file MeshMLJIT.cpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Math.hpp>
+#include <KFL/Util.hpp>
+#include <KFL/XMLDom.hpp>
+#include <KFL/XMLReader.hpp>
+#include <KFL/ThrowErr.hpp>
+#include <KFL/Thread.hpp>
+#include <KlayGE/Context.hpp>
+#include <KlayGE/ResLoader.hpp>
+#include <KlayGE/RenderLayout.hpp>
+#include <KlayGE/LZMACodec.hpp>
+#include <KlayGE/RenderMaterial.hpp>
+#include <KlayGE/Renderable.hpp>
+#include <KlayGE/Mesh.hpp>
+#include <KFL/Hash.hpp>
+#include <KFL/CXX17/filesystem.hpp>
+
+#include <cstdlib>
+#include <exception>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <vector>
+#include <cstring>
+
+#if defined(KLAYGE_COMPILER_GCC)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations" // Ignore auto_ptr declaration
+#endif
+#include <boost/algorithm/string/split.hpp>
+#if defined(KLAYGE_COMPILER_GCC)
+#pragma GCC diagnostic pop
+#endif
+#include <boost/algorithm/string/trim.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include <KlayGE/MeshMLJIT.hpp>
+
+#if KLAYGE_IS_DEV_PLATFORM
+
+using namespace std;
+using namespace KlayGE;
+
+namespace
+{
+	struct OfflineRenderMaterial
+	{
+		RenderMaterial material;
+		std::vector<std::pair<std::string, std::string>> texture_slots;
+	};
+
+	// Return path when appended to a_From will resolve to same as a_To
+	filesystem::path make_relative(filesystem::path from_path, filesystem::path to_path)
+	{
+#ifdef KLAYGE_TS_LIBRARY_FILESYSTEM_V2_SUPPORT
+		from_path = filesystem::complete(from_path);
+		to_path = filesystem::complete(to_path);
+#else
+		from_path = filesystem::absolute(from_path);
+		to_path = filesystem::absolute(to_path);
+#endif
+
+		filesystem::path::const_iterator iter_from(from_path.begin());
+		filesystem::path::const_iterator iter_to(to_path.begin());
+		for (filesystem::path::const_iterator to_end(to_path.end()), from_end(from_path.end());
+			(iter_from != from_end) && (iter_to != to_end) && (*iter_from == *iter_to);
+			++ iter_from, ++ iter_to);
+
+		filesystem::path ret;
+		for (filesystem::path::const_iterator from_end(from_path.end()); iter_from != from_end; ++ iter_from)
+		{
+			if (*iter_from != ".")
+			{
+				ret /= "..";
+			}
+		}
+
+		for (; iter_to != to_path.end(); ++ iter_to)
+		{
+			ret /= *iter_to;
+		}
+		return ret;
+	}
+
+	std::string const JIT_EXT_NAME = ".model_bin";
+	uint32_t const MODEL_BIN_VERSION = 13;
+
+	template <int N>
+	void ExtractFVector(std::string const & value_str, float* v)
+	{
+		std::vector<std::string> strs;
+		boost::algorithm::split(strs, value_str, boost::is_any_of(" "));
+		for (size_t i = 0; i < N; ++ i)
+		{
+			if (i < strs.size())
+			{
+				boost::algorithm::trim(strs[i]);
+				v[i] = static_cast<float>(atof(strs[i].c_str()));
+			}
+			else
+			{
+				v[i] = 0;
+			}
+		}
+	}
+
+	XMLNodePtr ParseElement(KlayGE::XMLDocument& doc, std::string const & xml)
+	{
+		return doc.Parse(MakeSharedPtr<ResIdentifier>("", 0, MakeSharedPtr<std::istringstream>(xml)));
+	}
+
+	// Small chunks keep using the DOM. Only their own text is held in memory.
+	XMLNodePtr ParseElement(KlayGE::XMLDocument& doc, XMLReader& reader)
+	{
+		return ParseElement(doc, reader.ReadElementXML());
+	}
+
+	void CompileMaterialsChunk(XMLNodePtr const & materials_chunk, std::vector<OfflineRenderMaterial>& mtls)
+	{
+		uint32_t mtl_index = 0;
+		for (XMLNodePtr mtl_node = materials_chunk->FirstNode("material"); mtl_node; mtl_node = mtl_node->NextSibling("material"), ++ mtl_index)
+		{
+			OfflineRenderMaterial offline_mtl;
+			auto& mtl = offline_mtl.material;
+
+			mtl.name = "Material " + boost::lexical_cast<std::string>(mtl_index);
+
+			mtl.albedo = float4(0, 0, 0, 1);
+			mtl.metalness = 0;
+			mtl.glossiness = 0;
+			mtl.emissive = float3(0, 0, 0);
+			mtl.transparent = false;
+			mtl.alpha_test = 0;
+			mtl.sss = false;
+
+			mtl.detail_mode = RenderMaterial::SDM_Parallax;
+			mtl.height_offset_scale = float2(-0.5f, 0.06f);
+			mtl.tess_factors = float4(5, 5, 1, 9);
+
+			{
+				XMLAttributePtr attr = mtl_node->Attrib("name");
+				if (attr)
+				{
+					mtl.name = attr->ValueString();
+				}
+			}
+
+			XMLNodePtr albedo_node = mtl_node->FirstNode("albedo");
+			if (albedo_node)
+			{
+				XMLAttributePtr attr = albedo_node->Attrib("color");
+				if (attr)
+				{
+					ExtractFVector<4>(attr->ValueString(), &mtl.albedo[0]);
+				}
+				attr = albedo_node->Attrib("texture");
+				if (attr)
+				{
+					offline_mtl.texture_slots.emplace_back("Albedo", attr->ValueString());
+				}
+			}
+			else
+			{
+				XMLAttributePtr attr = mtl_node->Attrib("diffuse");
+				if (attr)
+				{
+					ExtractFVector<3>(attr->ValueString(), &mtl.albedo[0]);
+				}
+				else
+				{
+					attr = mtl_node->Attrib("diffuse_r");
+					if (attr)
+					{
+						mtl.albedo.x() = attr->ValueFloat();
+					}
+					attr = mtl_node->Attrib("diffuse_g");
+					if (attr)
+					{
+						mtl.albedo.y() = attr->ValueFloat();
+					}
+					attr = mtl_node->Attrib("diffuse_b");
+					if (attr)
+					{
+						mtl.albedo.z() = attr->ValueFloat();
+					}
+				}
+
+				attr = mtl_node->Attrib("opacity");
+				if (attr)
+				{
+					mtl.albedo.w() = mtl_node->Attrib("opacity")->ValueFloat();
+				}
+			}
+
+			XMLNodePtr metalness_node = mtl_node->FirstNode("metalness");
+			if (metalness_node)
+			{
+				XMLAttributePtr attr = metalness_node->Attrib("value");
+				if (attr)
+				{
+					mtl.metalness = attr->ValueFloat();
+				}
+				attr = metalness_node->Attrib("texture");
+				if (attr)
+				{
+					offline_mtl.texture_slots.emplace_back("Metalness", attr->ValueString());
+				}
+			}
+
+			XMLNodePtr glossiness_node = mtl_node->FirstNode("glossiness");
+			if (glossiness_node)
+			{
+				XMLAttributePtr attr = glossiness_node->Attrib("value");
+				if (attr)
+				{
+					mtl.glossiness = attr->ValueFloat();
+				}
+				attr = glossiness_node->Attrib("texture");
+				if (attr)
+				{
+					offline_mtl.texture_slots.emplace_back("Glossiness", attr->ValueString());
+				}
+			}
+			else
+			{
+				XMLAttributePtr attr = mtl_node->Attrib("shininess");
+				if (attr)
+				{
+					float shininess = mtl_node->Attrib("shininess")->ValueFloat();
+					shininess = MathLib::clamp(shininess, 1.0f, MAX_SHININESS);
+					mtl.glossiness = Shininess2Glossiness(shininess);
+				}
+			}
+
+			XMLNodePtr emissive_node = mtl_node->FirstNode("emissive");
+			if (emissive_node)
+			{
+				XMLAttributePtr attr = emissive_node->Attrib("color");
+				if (attr)
+				{
+					ExtractFVector<3>(attr->ValueString(), &mtl.emissive[0]);
+				}
+				attr = emissive_node->Attrib("texture");
+				if (attr)
+				{
+					offline_mtl.texture_slots.emplace_back("Emissive", attr->ValueString());
+				}
+			}
+			else
+			{
+				XMLAttributePtr attr = mtl_node->Attrib("emit");
+				if (attr)
+				{
+					ExtractFVector<3>(attr->ValueString(), &mtl.emissive[0]);
+				}
+				else
+				{
+					attr = mtl_node->Attrib("emit_r");
+					if (attr)
+					{
+						mtl.emissive.x() = attr->ValueFloat();
+					}
+					attr = mtl_node->Attrib("emit_g");
+					if (attr)
+					{
+						mtl.emissive.y() = attr->ValueFloat();
+					}
+					attr = mtl_node->Attrib("emit_b");
+					if (attr)
+					{
+						mtl.emissive.z() = attr->ValueFloat();
+					}
+				}
+			}
+
+			XMLNodePtr bump_node = mtl_node->FirstNode("bump");
+			if (bump_node)
+			{
+				XMLAttributePtr attr = bump_node->Attrib("texture");
+				if (attr)
+				{
+					offline_mtl.texture_slots.emplace_back("Bump", attr->ValueString());
+				}
+			}
+			
+			XMLNodePtr normal_node = mtl_node->FirstNode("normal");
+			if (normal_node)
+			{
+				XMLAttributePtr attr = normal_node->Attrib("texture");
+				if (attr)
+				{
+					offline_mtl.texture_slots.emplace_back("Normal", attr->ValueString());
+				}
+			}
+
+			XMLNodePtr height_node = mtl_node->FirstNode("height");
+			if (height_node)
+			{
+				XMLAttributePtr attr = height_node->Attrib("texture");
+				if (attr)
+				{
+					offline_mtl.texture_slots.emplace_back("Height", attr->ValueString());
+				}
+
+				attr = height_node->Attrib("offset");
+				if (attr)
+				{
+					mtl.height_offset_scale.x() = attr->ValueFloat();
+				}
+
+				attr = height_node->Attrib("scale");
+				if (attr)
+				{
+					mtl.height_offset_scale.y() = attr->ValueFloat();
+				}
+			}
+
+			XMLNodePtr detail_node = mtl_node->FirstNode("detail");
+			if (detail_node)
+			{
+				XMLAttributePtr attr = detail_node->Attrib("mode");
+				if (attr)
+				{
+					std::string const & mode_str = attr->ValueString();
+					size_t const mode_hash = RT_HASH(mode_str.c_str());
+					if (CT_HASH("Flat Tessellation") == mode_hash)
+					{
+						mtl.detail_mode = RenderMaterial::SDM_FlatTessellation;
+					}
+					else if (CT_HASH("Smooth Tessellation") == mode_hash)
+					{
+						mtl.detail_mode = RenderMaterial::SDM_SmoothTessellation;
+					}
+				}
+
+				attr = detail_node->Attrib("height_offset");
+				if (attr)
+				{
+					mtl.height_offset_scale.x() = attr->ValueFloat();
+				}
+
+				attr = detail_node->Attrib("height_scale");
+				if (attr)
+				{
+					mtl.height_offset_scale.y() = attr->ValueFloat();
+				}
+
+				XMLNodePtr tess_node = detail_node->FirstNode("tess");
+				if (tess_node)
+				{
+					attr = tess_node->Attrib("edge_hint");
+					if (attr)
+					{
+						mtl.tess_factors.x() = attr->ValueFloat();
+					}
+					attr = tess_node->Attrib("inside_hint");
+					if (attr)
+					{
+						mtl.tess_factors.y() = attr->ValueFloat();
+					}
+					attr = tess_node->Attrib("min");
+					if (attr)
+					{
+						mtl.tess_factors.z() = attr->ValueFloat();
+					}
+					attr = tess_node->Attrib("max");
+					if (attr)
+					{
+						mtl.tess_factors.w() = attr->ValueFloat();
+					}
+				}
+				else
+				{
+					attr = detail_node->Attrib("edge_tess_hint");
+					if (attr)
+					{
+						mtl.tess_factors.x() = attr->ValueFloat();
+					}
+					attr = detail_node->Attrib("inside_tess_hint");
+					if (attr)
+					{
+						mtl.tess_factors.y() = attr->ValueFloat();
+					}
+					attr = detail_node->Attrib("min_tess");
+					if (attr)
+					{
+						mtl.tess_factors.z() = attr->ValueFloat();
+					}
+					attr = detail_node->Attrib("max_tess");
+					if (attr)
+					{
+						mtl.tess_factors.w() = attr->ValueFloat();
+					}
+				}
+			}
+
+			XMLNodePtr transparent_node = mtl_node->FirstNode("transparent");
+			if (transparent_node)
+			{
+				XMLAttributePtr attr = transparent_node->Attrib("value");
+				if (attr)
+				{
+					mtl.transparent = attr->ValueInt() ? true : false;
+				}
+			}
+
+			XMLNodePtr alpha_test_node = mtl_node->FirstNode("alpha_test");
+			if (alpha_test_node)
+			{
+				XMLAttributePtr attr = alpha_test_node->Attrib("value");
+				if (attr)
+				{
+					mtl.alpha_test = attr->ValueFloat();
+				}
+			}
+
+			XMLNodePtr sss_node = mtl_node->FirstNode("sss");
+			if (sss_node)
+			{
+				XMLAttributePtr attr = sss_node->Attrib("value");
+				if (attr)
+				{
+					mtl.sss = attr->ValueInt() ? true : false;
+				}
+			}
+			else
+			{
+				XMLAttributePtr attr = mtl_node->Attrib("sss");
+				if (attr)
+				{
+					mtl.sss = attr->ValueInt() ? true : false;
+				}
+			}
+
+			XMLNodePtr tex_node = mtl_node->FirstNode("texture");
+			if (!tex_node)
+			{
+				XMLNodePtr textures_chunk = mtl_node->FirstNode("textures_chunk");
+				if (textures_chunk)
+				{
+					tex_node = textures_chunk->FirstNode("texture");
+				}
+			}
+			if (tex_node)
+			{
+				for (; tex_node; tex_node = tex_node->NextSibling("texture"))
+				{
+					offline_mtl.texture_slots.emplace_back(tex_node->Attrib("type")->ValueString(),
+						tex_node->Attrib("name")->ValueString());
+				}
+			}
+
+			mtls.push_back(offline_mtl);
+		}
+	}
+
+	template <int N>
+	bool ExtractFVector(XMLReader const & reader, std::string_view name, float* v)
+	{
+		if (!reader.HasAttrib(name))
+		{
+			return false;
+		}
+
+		uint32_t const n = reader.AttribFloats(name, v, N);
+		for (uint32_t i = n; i < N; ++ i)
+		{
+			v[i] = 0;
+		}
+		return true;
+	}
+
+	void ExtractQuaternion(XMLReader const & reader, Quaternion& quat)
+	{
+		if (!ExtractFVector<4>(reader, "v", &quat[0]))
+		{
+			quat.x() = reader.AttribFloat("x", 0);
+			quat.y() = reader.AttribFloat("y", 0);
+			quat.z() = reader.AttribFloat("z", 0);
+			quat.w() = reader.AttribFloat("w", 0);
+		}
+	}
+
+	// A box is either "min" and "max" vector attributes, or <min> and <max> children with one attribute per component
+	template <int N>
+	void ReadBBox(XMLReader& reader, float3& min_bb, float3& max_bb)
+	{
+		bool const has_min = ExtractFVector<N>(reader, "min", &min_bb[0]);
+		bool const has_max = ExtractFVector<N>(reader, "max", &max_bb[0]);
+		if (!has_min || !has_max)
+		{
+			uint32_t const depth = reader.Depth();
+			while (reader.NextChildElement(depth))
+			{
+				float3* bb = nullptr;
+				if (!has_min && ("min" == reader.Name()))
+				{
+					bb = &min_bb;
+				}
+				else if (!has_max && ("max" == reader.Name()))
+				{
+					bb = &max_bb;
+				}
+				if (bb)
+				{
+					bb->x() = reader.AttribFloat("x", 0);
+					bb->y() = reader.AttribFloat("y", 0);
+					if (N > 2)
+					{
+						bb->z() = reader.AttribFloat("z", 0);
+					}
+				}
+			}
+		}
+	}
+
+	struct MeshVerticesSource
+	{
+		std::vector<float3> positions;
+		std::vector<float3> normals;
+		std::vector<float4> tangents;
+		std::vector<float3> binormals;
+		std::vector<Quaternion> tangent_quats;
+		std::vector<float4> diffuses;
+		std::vector<float3> speculars;
+		std::vector<float2> tex_coords;
+		std::vector<uint32_t> bone_indices;
+		std::vector<uint32_t> bone_weights;
+
+		bool has_normal = false;
+		bool has_diffuse = false;
+		bool has_specular = false;
+		bool has_weight = false;
+		bool has_tex_coord = false;
+		bool has_tangent = false;
+		bool has_binormal = false;
+		bool has_tangent_quat = false;
+
+		bool recompute_pos_bb = true;
+		bool recompute_tc_bb = true;
+	};
+
+	void ReadMeshesVertex(XMLReader& reader, MeshVerticesSource& src)
+	{
+		bool const has_uv = reader.HasAttrib("u");
+		{
+			float3 pos;
+			if (reader.HasAttrib("x"))
+			{
+				pos.x() = reader.AttribFloat("x", 0);
+				pos.y() = reader.AttribFloat("y", 0);
+				pos.z() = reader.AttribFloat("z", 0);
+
+				if (has_uv)
+				{
+					float2 tex_coord;
+					tex_coord.x() = reader.AttribFloat("u", 0);
+					tex_coord.y() = reader.AttribFloat("v", 0);
+					src.tex_coords.push_back(tex_coord);
+				}
+			}
+			else
+			{
+				ExtractFVector<3>(reader, "v", &pos[0]);
+			}
+			src.positions.push_back(pos);
+		}
+
+		bool has_weight = false;
+		uint32_t const depth = reader.Depth();
+		while (reader.NextChildElement(depth))
+		{
+			std::string_view const name = reader.Name();
+			if ("diffuse" == name)
+			{
+				src.has_diffuse = true;
+
+				float4 diffuse;
+				if (!ExtractFVector<4>(reader, "v", &diffuse[0]))
+				{
+					diffuse.x() = reader.AttribFloat("r", 0);
+					diffuse.y() = reader.AttribFloat("g", 0);
+					diffuse.z() = reader.AttribFloat("b", 0);
+					diffuse.w() = reader.AttribFloat("a", 0);
+				}
+				src.diffuses.push_back(diffuse);
+			}
+			else if ("specular" == name)
+			{
+				src.has_specular = true;
+
+				float3 specular;
+				if (!ExtractFVector<3>(reader, "v", &specular[0]))
+				{
+					specular.x() = reader.AttribFloat("r", 0);
+					specular.y() = reader.AttribFloat("g", 0);
+					specular.z() = reader.AttribFloat("b", 0);
+				}
+				src.speculars.push_back(specular);
+			}
+			else if ("tex_coord" == name)
+			{
+				if (!has_uv)
+				{
+					src.has_tex_coord = true;
+
+					float2 tex_coord;
+					if (reader.HasAttrib("u"))
+					{
+						tex_coord.x() = reader.AttribFloat("u", 0);
+						tex_coord.y() = reader.AttribFloat("v", 0);
+					}
+					else
+					{
+						ExtractFVector<2>(reader, "v", &tex_coord[0]);
+					}
+					src.tex_coords.push_back(tex_coord);
+				}
+			}
+			else if ("weight" == name)
+			{
+				// Only the first weight element counts, it carries all the influences
+				if (!has_weight)
+				{
+					has_weight = true;
+					src.has_weight = true;
+
+					uint32_t bone_index32[4] = { 0, 0, 0, 0 };
+					float bone_weight32[4] = { 0, 0, 0, 0 };
+
+					std::string_view const index_name = reader.HasAttrib("joint") ? "joint" : "bone_index";
+					uint32_t const num_indices = reader.AttribUInts(index_name, bone_index32, 4);
+					uint32_t const num_weights = reader.AttribFloats("weight", bone_weight32, 4);
+					for (uint32_t num_blend = std::min(num_indices, num_weights); num_blend < 4; ++ num_blend)
+					{
+						bone_index32[num_blend] = 0;
+						bone_weight32[num_blend] = 0;
+					}
+
+					uint32_t index32 = 0;
+					uint32_t weight32 = 0;
+					for (size_t j = 0; j < 4; ++ j)
+					{
+						uint8_t bone_index = static_cast<uint8_t>(bone_index32[j]);
+						uint8_t bone_weight = static_cast<uint8_t>(MathLib::clamp(static_cast<int>(bone_weight32[j] * 255), 0, 255));
+
+						index32 |= (bone_index << (j * 8));
+						weight32 |= (bone_weight << (j * 8));
+					}
+					src.bone_indices.push_back(index32);
+					src.bone_weights.push_back(weight32);
+				}
+			}
+			else if ("normal" == name)
+			{
+				src.has_normal = true;
+
+				float3 normal;
+				if (!ExtractFVector<3>(reader, "v", &normal[0]))
+				{
+					normal.x() = reader.AttribFloat("x", 0);
+					normal.y() = reader.AttribFloat("y", 0);
+					normal.z() = reader.AttribFloat("z", 0);
+				}
+				src.normals.push_back(normal);
+			}
+			else if ("tangent" == name)
+			{
+				src.has_tangent = true;
+
+				float4 tangent;
+				if (!ExtractFVector<4>(reader, "v", &tangent[0]))
+				{
+					tangent.x() = reader.AttribFloat("x", 0);
+					tangent.y() = reader.AttribFloat("y", 0);
+					tangent.z() = reader.AttribFloat("z", 0);
+					tangent.w() = reader.AttribFloat("w", 1);
+				}
+				src.tangents.push_back(tangent);
+			}
+			else if ("binormal" == name)
+			{
+				src.has_binormal = true;
+
+				float3 binormal;
+				if (!ExtractFVector<3>(reader, "v", &binormal[0]))
+				{
+					binormal.x() = reader.AttribFloat("x", 0);
+					binormal.y() = reader.AttribFloat("y", 0);
+					binormal.z() = reader.AttribFloat("z", 0);
+				}
+				src.binormals.push_back(binormal);
+			}
+			else if ("tangent_quat" == name)
+			{
+				src.has_tangent_quat = true;
+
+				Quaternion tangent_quat;
+				ExtractQuaternion(reader, tangent_quat);
+				src.tangent_quats.push_back(tangent_quat);
+			}
+		}
+	}
+
+	void ReadMeshesVerticesChunk(XMLReader& reader, MeshVerticesSource& src, AABBox& pos_bb, AABBox& tc_bb)
+	{
+		uint32_t const depth = reader.Depth();
+		while (reader.NextChildElement(depth))
+		{
+			std::string_view const name = reader.Name();
+			if ("vertex" == name)
+			{
+				ReadMeshesVertex(reader, src);
+			}
+			else if ("pos_bb" == name)
+			{
+				float3 pos_min_bb, pos_max_bb;
+				ReadBBox<3>(reader, pos_min_bb, pos_max_bb);
+				pos_bb = AABBox(pos_min_bb, pos_max_bb);
+
+				src.recompute_pos_bb = false;
+			}
+			else if ("tc_bb" == name)
+			{
+				float3 tc_min_bb, tc_max_bb;
+				ReadBBox<2>(reader, tc_min_bb, tc_max_bb);
+				tc_min_bb.z() = 0;
+				tc_max_bb.z() = 0;
+				tc_bb = AABBox(tc_min_bb, tc_max_bb);
+
+				src.recompute_tc_bb = false;
+			}
+		}
+	}
+
+	void CompileMeshesVerticesChunk(MeshVerticesSource& src,
+		AABBox& pos_bb, AABBox& tc_bb, std::vector<vertex_element>& vertex_elements,
+		std::vector<int16_t>& positions, std::vector<uint32_t>& normals,
+		std::vector<uint32_t>& tangent_quats, 
+		std::vector<uint32_t>& diffuses, std::vector<uint32_t>& speculars,
+		std::vector<int16_t>& tex_coords, 
+		std::vector<uint32_t>& bone_indices, std::vector<uint32_t>& bone_weights)
+	{
+		std::vector<float3> const & mesh_positions = src.positions;
+		std::vector<float3> const & mesh_normals = src.normals;
+		std::vector<float4> const & mesh_tangents = src.tangents;
+		std::vector<float3> const & mesh_binormals = src.binormals;
+		std::vector<Quaternion>& mesh_tangent_quats = src.tangent_quats;
+		std::vector<float4> const & mesh_diffuses = src.diffuses;
+		std::vector<float3> const & mesh_speculars = src.speculars;
+		std::vector<float2> const & mesh_tex_coords = src.tex_coords;
+
+		bool const has_normal = src.has_normal;
+		bool const has_diffuse = src.has_diffuse;
+		bool const has_specular = src.has_specular;
+		bool const has_weight = src.has_weight;
+		bool const has_tex_coord = src.has_tex_coord;
+		bool const has_tangent = src.has_tangent;
+		bool const has_binormal = src.has_binormal;
+		bool const has_tangent_quat = src.has_tangent_quat;
+
+		bool const recompute_pos_bb = src.recompute_pos_bb;
+		bool const recompute_tc_bb = src.recompute_tc_bb;
+		bool recompute_tangent_quat = false;
+
+		{
+			vertex_element ve;
+
+			{
+				ve.usage = VEU_Position;
+				ve.usage_index = 0;
+				ve.format = EF_SIGNED_ABGR16;
+				vertex_elements.push_back(ve);
+			}
+
+			if (has_diffuse)
+			{
+				ve.usage = VEU_Diffuse;
+				ve.usage_index = 0;
+				ve.format = EF_ABGR8;
+				vertex_elements.push_back(ve);
+			}
+
+			if (has_specular)
+			{
+				ve.usage = VEU_Specular;
+				ve.usage_index = 0;
+				ve.format = EF_ABGR8;
+				vertex_elements.push_back(ve);
+			}
+
+			if (has_weight)
+			{
+				ve.usage = VEU_BlendWeight;
+				ve.usage_index = 0;
+				ve.format = EF_ABGR8;
+				vertex_elements.push_back(ve);
+
+				ve.usage = VEU_BlendIndex;
+				ve.usage_index = 0;
+				ve.format = EF_ABGR8UI;
+				vertex_elements.push_back(ve);
+			}
+
+			if (has_tex_coord)
+			{
+				ve.usage = VEU_TextureCoord;
+				ve.usage_index = 0;
+				ve.format = EF_SIGNED_GR16;
+				vertex_elements.push_back(ve);
+			}
+
+			if (has_tangent_quat)
+			{
+				ve.usage = VEU_Tangent;
+				ve.usage_index = 0;
+				ve.format = EF_ABGR8;
+				vertex_elements.push_back(ve);
+			}
+			else
+			{
+				if (has_normal && !has_tangent && !has_binormal)
+				{
+					ve.usage = VEU_Normal;
+					ve.usage_index = 0;
+					ve.format = EF_ABGR8;
+					vertex_elements.push_back(ve);
+				}
+				else
+				{
+					if ((has_normal && has_tangent) || (has_normal && has_binormal)
+						|| (has_tangent && has_binormal))
+					{
+						ve.usage = VEU_Tangent;
+						ve.usage_index = 0;
+						ve.format = EF_ABGR8;
+						vertex_elements.push_back(ve);
+
+						if (!has_tangent_quat)
+						{
+							recompute_tangent_quat = true;
+						}
+					}
+				}
+			}
+		}
+
+		if (recompute_pos_bb)
+		{
+			for (uint32_t index = 0; index < mesh_positions.size(); ++ index)
+			{
+				float3 pos_min_bb, pos_max_bb;
+				float3 const & pos = mesh_positions[index];
+				if (0 == index)
+				{
+					pos_min_bb = pos_max_bb = pos;
+				}
+				else
+				{
+					pos_min_bb = MathLib::minimize(pos_min_bb, pos);
+					pos_max_bb = MathLib::maximize(pos_max_bb, pos);
+				}
+
+				pos_bb = AABBox(pos_min_bb, pos_max_bb);
+			}
+		}
+		if (recompute_tc_bb)
+		{
+			for (uint32_t index = 0; index < mesh_tex_coords.size(); ++ index)
+			{
+				float3 tc_min_bb, tc_max_bb;
+				float3 tex_coord = float3(mesh_tex_coords[index].x(), mesh_tex_coords[index].y(), 0.0f);
+				if (0 == index)
+				{
+					tc_min_bb = tc_max_bb = tex_coord;
+				}
+				else
+				{
+					tc_min_bb = MathLib::minimize(tc_min_bb, tex_coord);
+					tc_max_bb = MathLib::maximize(tc_max_bb, tex_coord);
+				}
+
+				tc_bb = AABBox(tc_min_bb, tc_max_bb);
+			}
+		}
+		if (recompute_tangent_quat)
+		{
+			mesh_tangent_quats.resize(mesh_positions.size());
+			for (uint32_t index = 0; index < mesh_positions.size(); ++ index)
+			{
+				float3 tangent, binormal, normal;
+				if (has_tangent)
+				{
+					tangent = float3(mesh_tangents[index].x(), mesh_tangents[index].y(),
+						mesh_tangents[index].z());
+				}
+				if (has_binormal)
+				{
+					binormal = mesh_binormals[index];
+				}
+				if (has_normal)
+				{
+					normal = mesh_normals[index];
+				}
+
+				if (!has_tangent)
+				{
+					BOOST_ASSERT(has_binormal && has_normal);
+
+					tangent = MathLib::cross(binormal, normal);
+				}
+				if (!has_binormal)
+				{
+					BOOST_ASSERT(has_tangent && has_normal);
+
+					binormal = MathLib::cross(normal, tangent) * mesh_tangents[index].w();
+				}
+				if (!has_normal)
+				{
+					BOOST_ASSERT(has_tangent && has_binormal);
+
+					normal = MathLib::cross(tangent, binormal);
+				}
+
+				mesh_tangent_quats[index] = MathLib::to_quaternion(tangent, binormal, normal, 8);
+			}
+		}
+
+		float3 const pos_center = pos_bb.Center();
+		float3 const pos_extent = pos_bb.HalfSize();
+		float3 const tc_center = tc_bb.Center();
+		float3 const tc_extent = tc_bb.HalfSize();
+
+		for (uint32_t index = 0; index < mesh_positions.size(); ++ index)
+		{
+			float3 pos = mesh_positions[index];
+			pos = (pos - pos_center) / pos_extent * 0.5f + 0.5f;
+			int16_t s_pos[4] = 
+			{
+				static_cast<int16_t>(MathLib::clamp<int32_t>(static_cast<int32_t>(pos.x() * 65535 - 32768), -32768, 32767)),
+				static_cast<int16_t>(MathLib::clamp<int32_t>(static_cast<int32_t>(pos.y() * 65535 - 32768), -32768, 32767)),
+				static_cast<int16_t>(MathLib::clamp<int32_t>(static_cast<int32_t>(pos.z() * 65535 - 32768), -32768, 32767)),
+				32767
+			};
+
+			positions.push_back(s_pos[0]);
+			positions.push_back(s_pos[1]);
+			positions.push_back(s_pos[2]);
+			positions.push_back(s_pos[3]);
+		}
+		for (uint32_t index = 0; index < mesh_diffuses.size(); ++ index)
+		{
+			float4 const & diffuse = mesh_diffuses[index];
+			uint32_t compact = (MathLib::clamp<uint32_t>(static_cast<uint32_t>((diffuse.x() * 0.5f + 0.5f) * 255), 0, 255) << 0)
+				| (MathLib::clamp<uint32_t>(static_cast<uint32_t>((diffuse.y() * 0.5f + 0.5f) * 255), 0, 255) << 8)
+				| (MathLib::clamp<uint32_t>(static_cast<uint32_t>((diffuse.z() * 0.5f + 0.5f) * 255), 0, 255) << 16)
+				| (MathLib::clamp<uint32_t>(static_cast<uint32_t>((diffuse.w() * 0.5f + 0.5f) * 255), 0, 255) << 24);
+			diffuses.push_back(compact);
+		}
+		for (uint32_t index = 0; index < mesh_speculars.size(); ++ index)
+		{
+			float3 const & specular = mesh_speculars[index];
+			uint32_t compact = (MathLib::clamp<uint32_t>(static_cast<uint32_t>((specular.x() * 0.5f + 0.5f) * 255), 0, 255) << 0)
+				| (MathLib::clamp<uint32_t>(static_cast<uint32_t>((specular.y() * 0.5f + 0.5f) * 255), 0, 255) << 8)
+				| (MathLib::clamp<uint32_t>(static_cast<uint32_t>((specular.z() * 0.5f + 0.5f) * 255), 0, 255) << 16)
+				| 0xFF000000;
+			speculars.push_back(compact);
+		}
+		for (uint32_t index = 0; index < mesh_tex_coords.size(); ++ index)
+		{
+			float3 tex_coord = float3(mesh_tex_coords[index].x(), mesh_tex_coords[index].y(), 0.0f);
+			tex_coord = (tex_coord - tc_center) / tc_extent * 0.5f + 0.5f;
+			int16_t s_tc[2] = 
+			{
+				static_cast<int16_t>(MathLib::clamp<int32_t>(static_cast<int32_t>(tex_coord.x() * 65535 - 32768), -32768, 32767)),
+				static_cast<int16_t>(MathLib::clamp<int32_t>(static_cast<int32_t>(tex_coord.y() * 65535 - 32768), -32768, 32767)),
+			};
+
+			tex_coords.push_back(s_tc[0]);
+			tex_coords.push_back(s_tc[1]);
+		}
+		for (uint32_t index = 0; index < mesh_tangent_quats.size(); ++ index)
+		{
+			Quaternion const & tangent_quat = mesh_tangent_quats[index];
+			uint32_t compact = (MathLib::clamp<uint32_t>(static_cast<uint32_t>((tangent_quat.x() * 0.5f + 0.5f) * 255), 0, 255) << 0)
+				| (MathLib::clamp<uint32_t>(static_cast<uint32_t>((tangent_quat.y() * 0.5f + 0.5f) * 255), 0, 255) << 8)
+				| (MathLib::clamp<uint32_t>(static_cast<uint32_t>((tangent_quat.z() * 0.5f + 0.5f) * 255), 0, 255) << 16)
+				| (MathLib::clamp<uint32_t>(static_cast<uint32_t>((tangent_quat.w() * 0.5f + 0.5f) * 255), 0, 255) << 24);
+			tangent_quats.push_back(compact);
+		}
+		for (uint32_t index = 0; index < mesh_normals.size(); ++ index)
+		{
+			float3 const normal = MathLib::normalize(mesh_normals[index]) * 0.5f + 0.5f;
+			uint32_t compact = MathLib::clamp<uint32_t>(static_cast<uint32_t>(normal.x() * 255), 0, 255)
+				| (MathLib::clamp<uint32_t>(static_cast<uint32_t>(normal.y() * 255), 0, 255) << 8)
+				| (MathLib::clamp<uint32_t>(static_cast<uint32_t>(normal.z() * 255), 0, 255) << 16);
+			normals.push_back(compact);					
+		}
+		bone_indices = src.bone_indices;
+		bone_weights = src.bone_weights;
+	}
+
+	void CompileMeshesTrianglesChunk(XMLReader& reader,
+		std::vector<uint8_t>& triangle_indices, char& is_index_16)
+	{
+		std::vector<uint32_t> mesh_triangle_indices;
+
+		is_index_16 = true;
+		uint32_t const depth = reader.Depth();
+		while (reader.NextChildElement(depth))
+		{
+			if (reader.Name() != "triangle")
+			{
+				continue;
+			}
+
+			uint32_t ind[3] = { 0, 0, 0 };
+			if (reader.HasAttrib("index"))
+			{
+				reader.AttribUInts("index", ind, 3);
+			}
+			else
+			{
+				ind[0] = reader.AttribUInt("a", 0);
+				ind[1] = reader.AttribUInt("b", 0);
+				ind[2] = reader.AttribUInt("c", 0);
+			}
+			mesh_triangle_indices.push_back(ind[0]);
+			mesh_triangle_indices.push_back(ind[1]);
+			mesh_triangle_indices.push_back(ind[2]);
+
+			if ((ind[0] > 0xFFFF) || (ind[1] > 0xFFFF) || (ind[2] > 0xFFFF))
+			{
+				is_index_16 = false;
+			}
+		}
+
+		if (is_index_16)
+		{
+			triangle_indices.resize(mesh_triangle_indices.size() * 2);
+			for (uint32_t index = 0; index < mesh_triangle_indices.size(); ++ index)
+			{
+				*reinterpret_cast<uint16_t*>(&triangle_indices[index * 2])
+					= static_cast<uint16_t>(mesh_triangle_indices[index]);
+			}
+		}
+		else
+		{
+			triangle_indices.resize(mesh_triangle_indices.size() * 4);
+			std::memcpy(&triangle_indices[0], &mesh_triangle_indices[0], triangle_indices.size());
+		}
+	}
+
+	void AppendMeshVertices(std::vector<vertex_element> const & ves,
+		std::vector<int16_t> const & positions, std::vector<uint32_t> const & normals,
+		std::vector<uint32_t> const & tangent_quats, 
+		std::vector<uint32_t> const & diffuses, std::vector<uint32_t> const & speculars,
+		std::vector<int16_t> const & tex_coords, 
+		std::vector<uint32_t> const & bone_indices, std::vector<uint32_t> const & bone_weights,
+		std::vector<uint32_t>& mesh_num_vertices,
+		std::vector<uint32_t>& mesh_base_vertices,
+		std::vector<vertex_element>& merged_ves,
+		std::vector<std::vector<uint8_t>>& merged_vertices)
+	{
+		uint32_t num_vertices = static_cast<uint32_t>(positions.size() / 4);
+		uint32_t base_vertices = mesh_base_vertices.back();
+		mesh_num_vertices.push_back(num_vertices);
+		mesh_base_vertices.push_back(base_vertices + num_vertices);
+
+		std::vector<uint32_t> ves_mapping(ves.size());
+		for (uint32_t ve_index = 0; ve_index < ves.size(); ++ ve_index)
+		{
+			bool found = false;
+			for (uint32_t mve_index = 0; mve_index < merged_ves.size(); ++ mve_index)
+			{
+				if (ves[ve_index] == merged_ves[mve_index])
+				{
+					ves_mapping[ve_index] = mve_index;
+					found = true;
+					break;
+				}
+			}
+			if (!found)
+			{
+				ves_mapping[ve_index] = static_cast<uint32_t>(merged_ves.size());
+				merged_ves.push_back(ves[ve_index]);
+				merged_vertices.resize(merged_vertices.size() + 1);
+				merged_vertices.back().resize(base_vertices * ves[ve_index].element_size(), 0);
+			}
+		}
+
+		for (size_t i = 0; i < merged_vertices.size(); ++ i)
+		{
+			merged_vertices[i].resize(merged_vertices[i].size() + num_vertices * merged_ves[i].element_size(), 0);
+		}
+
+		{
+			for (uint32_t vert_index = 0; vert_index < num_vertices; ++ vert_index)
+			{
+				{
+					for (size_t i = 0; i < ves.size(); ++ i)
+					{
+						if (VEU_Position == ves[i].usage)
+						{
+							uint32_t buf_index = ves_mapping[i];
+							int16_t s_pos[4] = 
+							{
+								Native2LE(positions[vert_index * 4 + 0]),
+								Native2LE(positions[vert_index * 4 + 1]),
+								Native2LE(positions[vert_index * 4 + 2]),
+								Native2LE(positions[vert_index * 4 + 3])
+							};
+							std::memcpy(&merged_vertices[buf_index][(base_vertices + vert_index) * merged_ves[buf_index].element_size()],
+								s_pos, sizeof(s_pos));
+							break;
+						}
+					}
+				}
+
+				if (!diffuses.empty())
+				{
+					for (size_t i = 0; i < ves.size(); ++ i)
+					{
+						if (VEU_Diffuse == ves[i].usage)
+						{
+							uint32_t buf_index = ves_mapping[i];
+							uint32_t compact = Native2LE(diffuses[vert_index]);
+							std::memcpy(&merged_vertices[buf_index][(base_vertices + vert_index) * merged_ves[buf_index].element_size()],
+								&compact, sizeof(compact));
+							break;
+						}
+					}
+				}
+
+				if (!speculars.empty())
+				{
+					for (size_t i = 0; i < ves.size(); ++ i)
+					{
+						if (VEU_Specular == ves[i].usage)
+						{
+							uint32_t buf_index = ves_mapping[i];
+							uint32_t compact = Native2LE(speculars[vert_index]);
+							std::memcpy(&merged_vertices[buf_index][(base_vertices + vert_index) * merged_ves[buf_index].element_size()],
+								&compact, sizeof(compact));
+							break;
+						}
+					}
+				}
+
+				if (!bone_indices.empty())
+				{
+					for (size_t i = 0; i < ves.size(); ++ i)
+					{
+						if (VEU_BlendIndex == ves[i].usage)
+						{
+							uint32_t buf_index = ves_mapping[i];
+							uint32_t compact = Native2LE(bone_indices[vert_index]);
+							std::memcpy(&merged_vertices[buf_index][(base_vertices + vert_index) * merged_ves[buf_index].element_size()],
+								&compact, sizeof(compact));
+							break;
+						}
+					}
+					for (size_t i = 0; i < ves.size(); ++ i)
+					{
+						if (VEU_BlendWeight == ves[i].usage)
+						{
+							uint32_t buf_index = ves_mapping[i];
+							uint32_t compact = Native2LE(bone_weights[vert_index]);
+							std::memcpy(&merged_vertices[buf_index][(base_vertices + vert_index) * merged_ves[buf_index].element_size()],
+								&compact, sizeof(compact));
+							break;
+						}
+					}
+				}
+
+				if (!tex_coords.empty())
+				{
+					for (size_t i = 0; i < ves.size(); ++ i)
+					{
+						if (VEU_TextureCoord == ves[i].usage)
+						{
+							uint32_t buf_index = ves_mapping[i];
+							int16_t s_tc[2] = 
+							{
+								Native2LE(tex_coords[vert_index * 2 + 0]),
+								Native2LE(tex_coords[vert_index * 2 + 1])
+							};
+							std::memcpy(&merged_vertices[buf_index][(base_vertices + vert_index) * merged_ves[buf_index].element_size()],
+								&s_tc, sizeof(s_tc));
+							break;
+						}
+					}
+				}
+
+				if (tangent_quats.empty())
+				{
+					if (!normals.empty())
+					{
+						for (size_t i = 0; i < ves.size(); ++ i)
+						{
+							if (VEU_Normal == ves[i].usage)
+							{
+								uint32_t buf_index = ves_mapping[i];
+								uint32_t compact = Native2LE(normals[vert_index]);
+								std::memcpy(&merged_vertices[buf_index][(base_vertices + vert_index) * merged_ves[buf_index].element_size()],
+									&compact, sizeof(compact));
+								break;
+							}
+						}
+					}
+				}
+				else
+				{
+					for (size_t i = 0; i < ves.size(); ++ i)
+					{
+						if (VEU_Tangent == ves[i].usage)
+						{
+							uint32_t buf_index = ves_mapping[i];
+							uint32_t compact = Native2LE(tangent_quats[vert_index]);
+							std::memcpy(&merged_vertices[buf_index][(base_vertices + vert_index) * merged_ves[buf_index].element_size()],
+								&compact, sizeof(compact));
+							break;
+						}
+					}
+				}
+			}
+		}
+	}
+
+	void AppendMeshIndices(std::vector<uint8_t> const & triangle_indices, char is_index_16s,
+		std::vector<uint32_t>& mesh_num_indices,
+		std::vector<uint32_t>& mesh_start_indices,
+		std::vector<uint8_t>& merged_indices,
+		char& is_index_16_bit)
+	{
+		is_index_16_bit &= is_index_16s;
+
+		uint32_t num_indices = static_cast<uint32_t>(triangle_indices.size() / (is_index_16s ? 2 : 4));
+		uint32_t start_indicees = mesh_start_indices.back();
+		mesh_num_indices.push_back(num_indices);
+		mesh_start_indices.push_back(start_indicees + num_indices);
+
+		merged_indices.resize(merged_indices.size() + num_indices * 4);
+
+		for (uint32_t ind_index = 0; ind_index < num_indices; ++ ind_index)
+		{
+			if (is_index_16s)
+			{
+				uint32_t ind32 = *reinterpret_cast<uint16_t const *>(&triangle_indices[ind_index * sizeof(uint16_t)]);
+				std::memcpy(&merged_indices[(start_indicees + ind_index) * 4],
+					&ind32, sizeof(ind32));
+			}
+			else
+			{
+				std::memcpy(&merged_indices[(start_indicees + ind_index) * 4],
+					&triangle_indices[ind_index * sizeof(uint32_t)], sizeof(uint32_t));
+			}
+		}
+	}
+
+	struct CompiledMesh
+	{
+		std::string name;
+		int32_t mtl_id = 0;
+		AABBox pos_bb;
+		AABBox tc_bb;
+		MeshVerticesSource source;
+
+		std::vector<vertex_element> ves;
+		std::vector<int16_t> positions;
+		std::vector<uint32_t> normals;
+		std::vector<uint32_t> tangent_quats;
+		std::vector<uint32_t> diffuses;
+		std::vector<uint32_t> speculars;
+		std::vector<int16_t> tex_coords;
+		std::vector<uint32_t> bone_indices;
+		std::vector<uint32_t> bone_weights;
+		std::vector<uint8_t> triangle_indices;
+		char is_index_16s = true;
+		bool has_vertices = false;
+		bool has_triangles = false;
+	};
+
+	// Waits for every task, even after one of them failed. Rethrows the first failure if asked to.
+	void JoinAll(std::vector<joiner<void>>& joiners, bool rethrow)
+	{
+		std::exception_ptr error;
+		for (auto& joiner : joiners)
+		{
+			try
+			{
+				joiner();
+			}
+			catch (...)
+			{
+				if (!error)
+				{
+					error = std::current_exception();
+				}
+			}
+		}
+		if (rethrow && error)
+		{
+			std::rethrow_exception(error);
+		}
+	}
+
+	void CompileMeshesChunk(XMLReader& reader,
+		std::vector<std::string>& mesh_names, std::vector<int32_t>& mtl_ids,
+		std::vector<AABBox>& pos_bbs, std::vector<AABBox>& tc_bbs, 
+		std::vector<uint32_t>& mesh_num_vertices, std::vector<uint32_t>& mesh_base_vertices,
+		std::vector<uint32_t>& mesh_num_indices, std::vector<uint32_t>& mesh_start_indices,
+		std::vector<vertex_element>& merged_ves, std::vector<std::vector<uint8_t>>& merged_vertices,
+		std::vector<uint8_t>& merged_indices, char& is_index_16_bit)
+	{
+		mesh_names.clear();
+		mtl_ids.clear();
+		pos_bbs.clear();
+		tc_bbs.clear();
+
+		mesh_num_vertices.clear();
+		mesh_num_indices.clear();
+		mesh_base_vertices.assign(1, 0);
+		mesh_start_indices.assign(1, 0);
+		merged_ves.clear();
+		merged_vertices.clear();
+		merged_indices.clear();
+		is_index_16_bit = true;
+
+		// Reading the file is sequential, but once a mesh is read its vertices are quantized in a task while the
+		//  next mesh is being read. Merging stays serial to keep the output identical.
+		std::vector<std::unique_ptr<CompiledMesh>> meshes;
+		thread_pool& tp = Context::Instance().ThreadPool();
+		std::vector<joiner<void>> joiners;
+		try
+		{
+			uint32_t const chunk_depth = reader.Depth();
+			while (reader.NextChildElement(chunk_depth))
+			{
+				if (reader.Name() != "mesh")
+				{
+					continue;
+				}
+
+				meshes.push_back(MakeUniquePtr<CompiledMesh>());
+				CompiledMesh& mesh = *meshes.back();
+				mesh.name = reader.AttribString("name", "");
+				mesh.mtl_id = reader.AttribInt("mtl_id", 0);
+
+				uint32_t const mesh_depth = reader.Depth();
+				while (reader.NextChildElement(mesh_depth))
+				{
+					if ("vertices_chunk" == reader.Name())
+					{
+						mesh.has_vertices = true;
+						ReadMeshesVerticesChunk(reader, mesh.source, mesh.pos_bb, mesh.tc_bb);
+					}
+					else if ("triangles_chunk" == reader.Name())
+					{
+						mesh.has_triangles = true;
+						CompileMeshesTrianglesChunk(reader, mesh.triangle_indices, mesh.is_index_16s);
+					}
+				}
+
+				if (mesh.has_vertices)
+				{
+					joiners.push_back(tp([&mesh]
+						{
+							CompileMeshesVerticesChunk(mesh.source,
+								mesh.pos_bb, mesh.tc_bb, mesh.ves,
+								mesh.positions, mesh.normals, mesh.tangent_quats,
+								mesh.diffuses, mesh.speculars, mesh.tex_coords,
+								mesh.bone_indices, mesh.bone_weights);
+							mesh.source = MeshVerticesSource();
+						}));
+				}
+			}
+		}
+		catch (...)
+		{
+			// The tasks write into meshes, so they have to finish before it's destroyed
+			JoinAll(joiners, false);
+			throw;
+		}
+		JoinAll(joiners, true);
+
+		for (size_t mesh_index = 0; mesh_index < meshes.size(); ++ mesh_index)
+		{
+			CompiledMesh const & mesh = *meshes[mesh_index];
+			mesh_names.push_back(mesh.name);
+			mtl_ids.push_back(mesh.mtl_id);
+			pos_bbs.push_back(mesh.pos_bb);
+			tc_bbs.push_back(mesh.tc_bb);
+
+			if (mesh.has_vertices)
+			{
+				AppendMeshVertices(mesh.ves,
+					mesh.positions, mesh.normals, mesh.tangent_quats,
+					mesh.diffuses, mesh.speculars, mesh.tex_coords,
+					mesh.bone_indices, mesh.bone_weights,
+					mesh_num_vertices, mesh_base_vertices,
+					merged_ves, merged_vertices);
+			}
+			if (mesh.has_triangles)
+			{
+				AppendMeshIndices(mesh.triangle_indices, mesh.is_index_16s,
+					mesh_num_indices, mesh_start_indices, merged_indices,
+					is_index_16_bit);
+			}
+		}
+
+		if (is_index_16_bit)
+		{
+			std::vector<uint8_t> merged_indices_16(merged_indices.size() / 2);
+			for (uint32_t ind_index = 0; ind_index < mesh_start_indices.back(); ++ ind_index)
+			{
+				uint16_t ind16 = Native2LE(static_cast<uint16_t>(*reinterpret_cast<uint32_t*>(&merged_indices[ind_index * sizeof(uint32_t)])));
+				std::memcpy(&merged_indices_16[ind_index * sizeof(uint16_t)], &ind16, sizeof(ind16));
+			}
+
+			merged_indices.swap(merged_indices_16);
+		}
+	}
+
+	void CompileBonesChunk(XMLNodePtr const & bones_chunk,
+		std::vector<Joint>& joints)
+	{
+		Joint joint;
+		for (XMLNodePtr bone_node = bones_chunk->FirstNode("bone"); bone_node; bone_node = bone_node->NextSibling("bone"))
+		{
+			joint.name = bone_node->Attrib("name")->ValueString();
+			joint.parent = static_cast<int16_t>(bone_node->Attrib("parent")->ValueInt());
+
+			XMLNodePtr bind_pos_node = bone_node->FirstNode("bind_pos");
+			if (bind_pos_node)
+			{
+				float3 bind_pos(bind_pos_node->Attrib("x")->ValueFloat(), bind_pos_node->Attrib("y")->ValueFloat(),
+					bind_pos_node->Attrib("z")->ValueFloat());
+
+				XMLNodePtr bind_quat_node = bone_node->FirstNode("bind_quat");
+				Quaternion bind_quat(bind_quat_node->Attrib("x")->ValueFloat(), bind_quat_node->Attrib("y")->ValueFloat(),
+					bind_quat_node->Attrib("z")->ValueFloat(), bind_quat_node->Attrib("w")->ValueFloat());
+
+				float scale = MathLib::length(bind_quat);
+				bind_quat /= scale;
+
+				joint.bind_dual = MathLib::quat_trans_to_udq(bind_quat, bind_pos);
+				joint.bind_real = bind_quat * scale;
+			}
+			else
+			{
+				XMLNodePtr bind_real_node = bone_node->FirstNode("real");
+				if (!bind_real_node)
+				{
+					bind_real_node = bone_node->FirstNode("bind_real");
+				}
+				XMLAttributePtr attr = bind_real_node->Attrib("v");
+				if (attr)
+				{
+					ExtractFVector<4>(attr->ValueString(), &joint.bind_real[0]);
+				}
+				else
+				{
+					joint.bind_real.x() = bind_real_node->Attrib("x")->ValueFloat();
+					joint.bind_real.y() = bind_real_node->Attrib("y")->ValueFloat();
+					joint.bind_real.z() = bind_real_node->Attrib("z")->ValueFloat();
+					joint.bind_real.w() = bind_real_node->Attrib("w")->ValueFloat();
+				}
+
+				XMLNodePtr bind_dual_node = bone_node->FirstNode("dual");
+				if (!bind_dual_node)
+				{
+					bind_dual_node = bone_node->FirstNode("bind_dual");
+				}
+				attr = bind_dual_node->Attrib("v");
+				if (attr)
+				{
+					ExtractFVector<4>(attr->ValueString(), &joint.bind_dual[0]);
+				}
+				else
+				{
+					joint.bind_dual.x() = bind_dual_node->Attrib("x")->ValueFloat();
+					joint.bind_dual.y() = bind_dual_node->Attrib("y")->ValueFloat();
+					joint.bind_dual.z() = bind_dual_node->Attrib("z")->ValueFloat();
+					joint.bind_dual.w() = bind_dual_node->Attrib("w")->ValueFloat();
+				}
+			}
+
+			joints.push_back(joint);
+		}
+	}
+
+	void CompileKeyFramesChunk(XMLReader& reader,
+		uint32_t& num_frames, uint32_t& frame_rate,
+		std::vector<KeyFrames>& kfss)
+	{
+		if (reader.HasAttrib("num_frames"))
+		{
+			num_frames = reader.AttribUInt("num_frames", 0);
+		}
+		else
+		{
+			int32_t start_frame = reader.AttribInt("start_frame", 0);
+			int32_t end_frame = reader.AttribInt("end_frame", 0);
+			num_frames = end_frame - start_frame;
+		}
+		frame_rate = reader.AttribUInt("frame_rate", 0);
+
+		KeyFrames kfs;
+		uint32_t const chunk_depth = reader.Depth();
+		while (reader.NextChildElement(chunk_depth))
+		{
+			if (reader.Name() != "key_frame")
+			{
+				continue;
+			}
+
+			kfs.frame_id.clear();
+			kfs.bind_real.clear();
+			kfs.bind_dual.clear();
+			kfs.bind_scale.clear();
+
+			int32_t frame_id = -1;
+			uint32_t const kf_depth = reader.Depth();
+			while (reader.NextChildElement(kf_depth))
+			{
+				if (reader.Name() != "key")
+				{
+					continue;
+				}
+
+				frame_id = reader.AttribInt("id", frame_id + 1);
+				kfs.frame_id.push_back(frame_id);
+
+				bool has_pos = false;
+				float3 bind_pos(0, 0, 0);
+				Quaternion quat(0, 0, 0, 1);
+				Quaternion bind_real(0, 0, 0, 1);
+				Quaternion bind_dual(0, 0, 0, 0);
+				uint32_t const key_depth = reader.Depth();
+				while (reader.NextChildElement(key_depth))
+				{
+					std::string_view const name = reader.Name();
+					if ("pos" == name)
+					{
+						has_pos = true;
+						bind_pos = float3(reader.AttribFloat("x", 0), reader.AttribFloat("y", 0),
+							reader.AttribFloat("z", 0));
+					}
+					else if ("quat" == name)
+					{
+						quat = Quaternion(reader.AttribFloat("x", 0), reader.AttribFloat("y", 0),
+							reader.AttribFloat("z", 0), reader.AttribFloat("w", 0));
+					}
+					else if (("real" == name) || ("bind_real" == name))
+					{
+						ExtractQuaternion(reader, bind_real);
+					}
+					else if (("dual" == name) || ("bind_dual" == name))
+					{
+						ExtractQuaternion(reader, bind_dual);
+					}
+				}
+
+				float bind_scale;
+				if (has_pos)
+				{
+					bind_real = quat;
+					bind_scale = MathLib::length(bind_real);
+					bind_real /= bind_scale;
+
+					bind_dual = MathLib::quat_trans_to_udq(bind_real, bind_pos);
+				}
+				else
+				{
+					bind_scale = MathLib::length(bind_real);
+					bind_real /= bind_scale;
+					if (bind_real.w() < 0)
+					{
+						bind_real = -bind_real;
+						bind_scale = -bind_scale;
+					}
+				}
+
+				kfs.bind_real.push_back(bind_real);
+				kfs.bind_dual.push_back(bind_dual);
+				kfs.bind_scale.push_back(bind_scale);
+			}
+
+			kfss.push_back(kfs);
+		}
+	}
+
+	void CompileBBKeyFramesChunk(XMLReader& reader,
+		std::vector<AABBKeyFrames>& bb_kfss)
+	{
+		AABBKeyFrames bb_kfs;
+		uint32_t const chunk_depth = reader.Depth();
+		while (reader.NextChildElement(chunk_depth))
+		{
+			if (reader.Name() != "bb_key_frame")
+			{
+				continue;
+			}
+
+			bb_kfs.frame_id.clear();
+			bb_kfs.bb.clear();
+
+			int32_t frame_id = -1;
+			uint32_t const kf_depth = reader.Depth();
+			while (reader.NextChildElement(kf_depth))
+			{
+				if (reader.Name() != "key")
+				{
+					continue;
+				}
+
+				frame_id = reader.AttribInt("id", frame_id + 1);
+				bb_kfs.frame_id.push_back(frame_id);
+
+				float3 bb_min, bb_max;
+				ReadBBox<3>(reader, bb_min, bb_max);
+				bb_kfs.bb.push_back(AABBox(bb_min, bb_max));
+			}
+
+			bb_kfss.push_back(bb_kfs);
+		}
+	}
+
+	void DefaultBBKeyFrames(std::vector<AABBox> const & pos_bbs, uint32_t num_frames,
+		std::vector<AABBKeyFrames>& bb_kfss)
+	{
+		AABBKeyFrames bb_kfs;
+		bb_kfs.frame_id.resize(2);
+		bb_kfs.bb.resize(2);
+
+		bb_kfs.frame_id[0] = 0;
+		bb_kfs.frame_id[1] = num_frames - 1;
+
+		for (uint32_t mesh_index = 0; mesh_index < pos_bbs.size(); ++ mesh_index)
+		{
+			bb_kfs.bb[0] = pos_bbs[mesh_index];
+			bb_kfs.bb[1] = pos_bbs[mesh_index];
+
+			bb_kfss.push_back(bb_kfs);
+		}
+	}
+
+	void CompileActionsChunk(XMLNodePtr const & actions_chunk,
+		uint32_t num_frames,
+		std::vector<AnimationAction>& actions)
+	{
+		XMLNodePtr action_node;
+		if (actions_chunk)
+		{
+			action_node = actions_chunk->FirstNode("action");
+		}
+
+		AnimationAction action;
+		if (action_node)
+		{
+			for (; action_node; action_node = action_node->NextSibling("action"))
+			{
+				action.name = action_node->Attrib("name")->ValueString();
+
+				action.start_frame = action_node->Attrib("start")->ValueUInt();
+				action.end_frame = action_node->Attrib("end")->ValueUInt();
+
+				actions.push_back(action);
+			}
+		}
+		else
+		{
+			action.name = "root";
+			action.start_frame = 0;
+			action.end_frame = num_frames;
+
+			actions.push_back(action);
+		}
+	}
+
+	void WriteMaterialsChunk(std::vector<OfflineRenderMaterial> const & mtls, std::ostream& os)
+	{
+		for (size_t i = 0; i < mtls.size(); ++ i)
+		{
+			auto& offline_mtl = mtls[i];
+			auto& mtl = offline_mtl.material;
+
+			WriteShortString(os, mtl.name);
+
+			for (uint32_t j = 0; j < 4; ++ j)
+			{
+				float const value = Native2LE(mtl.albedo[j]);
+				os.write(reinterpret_cast<char const *>(&value), sizeof(value));
+			}
+
+			float metalness = Native2LE(mtl.metalness);
+			os.write(reinterpret_cast<char*>(&metalness), sizeof(metalness));
+
+			float glossiness = Native2LE(mtl.glossiness);
+			os.write(reinterpret_cast<char*>(&glossiness), sizeof(glossiness));
+
+			for (uint32_t j = 0; j < 3; ++ j)
+			{
+				float const value = Native2LE(mtl.emissive[j]);
+				os.write(reinterpret_cast<char const *>(&value), sizeof(value));
+			}
+
+			uint8_t transparent = mtl.transparent;
+			os.write(reinterpret_cast<char*>(&transparent), sizeof(transparent));
+
+			uint8_t alpha_test = static_cast<uint8_t>(MathLib::clamp(static_cast<int>(mtl.alpha_test * 255.0f + 0.5f), 0, 255));
+			os.write(reinterpret_cast<char*>(&alpha_test), sizeof(alpha_test));
+
+			uint8_t sss = mtl.sss;
+			os.write(reinterpret_cast<char*>(&sss), sizeof(sss));
+
+			for (size_t j = 0; j < RenderMaterial::TS_NumTextureSlots; ++ j)
+			{
+				WriteShortString(os, mtl.tex_names[j]);
+			}
+			if (!mtl.tex_names[RenderMaterial::TS_Height].empty())
+			{
+				float height_offset = Native2LE(mtl.height_offset_scale.x());
+				os.write(reinterpret_cast<char*>(&height_offset), sizeof(height_offset));
+				float height_scale = Native2LE(mtl.height_offset_scale.y());
+				os.write(reinterpret_cast<char*>(&height_scale), sizeof(height_scale));
+			}
+
+			uint8_t detail_mode = static_cast<uint8_t>(mtl.detail_mode);
+			os.write(reinterpret_cast<char*>(&detail_mode), sizeof(detail_mode));
+			if (mtl.detail_mode != RenderMaterial::SDM_Parallax)
+			{
+				float tess_factor = Native2LE(mtl.tess_factors.x());
+				os.write(reinterpret_cast<char*>(&tess_factor), sizeof(tess_factor));
+				tess_factor = Native2LE(mtl.tess_factors.y());
+				os.write(reinterpret_cast<char*>(&tess_factor), sizeof(tess_factor));
+				tess_factor = Native2LE(mtl.tess_factors.z());
+				os.write(reinterpret_cast<char*>(&tess_factor), sizeof(tess_factor));
+				tess_factor = Native2LE(mtl.tess_factors.w());
+				os.write(reinterpret_cast<char*>(&tess_factor), sizeof(tess_factor));
+			}
+		}
+	}
+
+	void WriteMeshesChunk(std::vector<std::string> const & mesh_names, std::vector<int32_t> const & mtl_ids,
+		std::vector<AABBox> const & pos_bbs, std::vector<AABBox> const & tc_bbs,
+		std::vector<uint32_t> const & mesh_num_vertices, std::vector<uint32_t> const & mesh_base_vertices,
+		std::vector<uint32_t> const & mesh_num_indices, std::vector<uint32_t> const & mesh_start_indices,
+		std::vector<vertex_element> const & merged_ves,
+		std::vector<std::vector<uint8_t>> const & merged_vertices, std::vector<uint8_t> const & merged_indices,
+		char is_index_16_bit, std::ostream& os)
+	{
+		uint32_t num_merged_ves = Native2LE(static_cast<uint32_t>(merged_ves.size()));
+		os.write(reinterpret_cast<char*>(&num_merged_ves), sizeof(num_merged_ves));
+		for (size_t i = 0; i < merged_ves.size(); ++ i)
+		{
+			vertex_element ve = merged_ves[i];
+			ve.usage = Native2LE(ve.usage);
+			ve.format = Native2LE(ve.format);
+			os.write(reinterpret_cast<char*>(&ve), sizeof(ve));
+		}
+
+		uint32_t num_vertices = Native2LE(mesh_base_vertices.back());
+		os.write(reinterpret_cast<char*>(&num_vertices), sizeof(num_vertices));
+		uint32_t num_indices = Native2LE(mesh_start_indices.back());
+		os.write(reinterpret_cast<char*>(&num_indices), sizeof(num_indices));
+		os.write(&is_index_16_bit, sizeof(is_index_16_bit));
+
+		for (size_t i = 0; i < merged_vertices.size(); ++ i)
+		{
+			os.write(reinterpret_cast<char const *>(&merged_vertices[i][0]), merged_vertices[i].size() * sizeof(merged_vertices[i][0]));
+		}
+		os.write(reinterpret_cast<char const *>(&merged_indices[0]), merged_indices.size() * sizeof(merged_indices[0]));
+
+		for (uint32_t mesh_index = 0; mesh_index < mesh_num_vertices.size(); ++ mesh_index)
+		{
+			WriteShortString(os, mesh_names[mesh_index]);
+
+			int32_t mtl_id = Native2LE(mtl_ids[mesh_index]);
+			os.write(reinterpret_cast<char*>(&mtl_id), sizeof(mtl_id));
+
+			float3 min_bb;
+			min_bb.x() = Native2LE(pos_bbs[mesh_index].Min().x());
+			min_bb.y() = Native2LE(pos_bbs[mesh_index].Min().y());
+			min_bb.z() = Native2LE(pos_bbs[mesh_index].Min().z());
+			os.write(reinterpret_cast<char*>(&min_bb), sizeof(min_bb));
+			float3 max_bb;
+			max_bb.x() = Native2LE(pos_bbs[mesh_index].Max().x());
+			max_bb.y() = Native2LE(pos_bbs[mesh_index].Max().y());
+			max_bb.z() = Native2LE(pos_bbs[mesh_index].Max().z());
+			os.write(reinterpret_cast<char*>(&max_bb), sizeof(max_bb));
+
+			min_bb.x() = Native2LE(tc_bbs[mesh_index].Min().x());
+			min_bb.y() = Native2LE(tc_bbs[mesh_index].Min().y());
+			os.write(reinterpret_cast<char*>(&min_bb[0]), sizeof(min_bb[0]));
+			os.write(reinterpret_cast<char*>(&min_bb[1]), sizeof(min_bb[1]));
+			max_bb.x() = Native2LE(tc_bbs[mesh_index].Max().x());
+			max_bb.y() = Native2LE(tc_bbs[mesh_index].Max().y());
+			os.write(reinterpret_cast<char*>(&max_bb[0]), sizeof(max_bb[0]));
+			os.write(reinterpret_cast<char*>(&max_bb[1]), sizeof(max_bb[1]));
+
+			uint32_t nv = Native2LE(mesh_num_vertices[mesh_index]);
+			os.write(reinterpret_cast<char*>(&nv), sizeof(nv));
+			uint32_t bv = Native2LE(mesh_base_vertices[mesh_index]);
+			os.write(reinterpret_cast<char*>(&bv), sizeof(bv));
+			uint32_t ni = Native2LE(mesh_num_indices[mesh_index]);
+			os.write(reinterpret_cast<char*>(&ni), sizeof(ni));
+			uint32_t si = Native2LE(mesh_start_indices[mesh_index]);
+			os.write(reinterpret_cast<char*>(&si), sizeof(si));
+		}
+	}
+
+	void WriteBonesChunk(std::vector<Joint> const & joints, std::ostream& os)
+	{
+		for (size_t i = 0; i < joints.size(); ++ i)
+		{
+			WriteShortString(os, joints[i].name);
+
+			int16_t joint_parent = Native2LE(joints[i].parent);
+			os.write(reinterpret_cast<char*>(&joint_parent), sizeof(joint_parent));
+
+			Quaternion bind_real;
+			bind_real.x() = Native2LE(joints[i].bind_real.x());
+			bind_real.y() = Native2LE(joints[i].bind_real.y());
+			bind_real.z() = Native2LE(joints[i].bind_real.z());
+			bind_real.w() = Native2LE(joints[i].bind_real.w());
+			os.write(reinterpret_cast<char*>(&bind_real), sizeof(bind_real));
+			Quaternion bind_dual;
+			bind_dual.x() = Native2LE(joints[i].bind_dual.x());
+			bind_dual.y() = Native2LE(joints[i].bind_dual.y());
+			bind_dual.z() = Native2LE(joints[i].bind_dual.z());
+			bind_dual.w() = Native2LE(joints[i].bind_dual.w());
+			os.write(reinterpret_cast<char*>(&bind_dual), sizeof(bind_dual));
+		}
+	}
+
+	void WriteKeyFramesChunk(uint32_t num_frames, uint32_t frame_rate, std::vector<KeyFrames>& kfs,
+		std::ostream& os)
+	{
+		num_frames = Native2LE(num_frames);
+		os.write(reinterpret_cast<char*>(&num_frames), sizeof(num_frames));
+		frame_rate = Native2LE(frame_rate);
+		os.write(reinterpret_cast<char*>(&frame_rate), sizeof(frame_rate));
+
+		for (size_t i = 0; i < kfs.size(); ++ i)
+		{
+			uint32_t num_kf = Native2LE(static_cast<uint32_t>(kfs[i].frame_id.size()));
+			os.write(reinterpret_cast<char*>(&num_kf), sizeof(num_kf));
+
+			for (size_t j = 0; j < kfs[i].frame_id.size(); ++ j)
+			{
+				Quaternion bind_real = kfs[i].bind_real[j];
+				Quaternion bind_dual = kfs[i].bind_dual[j];
+				float bind_scale = kfs[i].bind_scale[j];
+
+				uint32_t frame_id = Native2LE(kfs[i].frame_id[j]);
+				os.write(reinterpret_cast<char*>(&frame_id), sizeof(frame_id));
+				bind_real *= bind_scale;
+				bind_real.x() = Native2LE(bind_real.x());
+				bind_real.y() = Native2LE(bind_real.y());
+				bind_real.z() = Native2LE(bind_real.z());
+				bind_real.w() = Native2LE(bind_real.w());
+				os.write(reinterpret_cast<char*>(&bind_real), sizeof(bind_real));
+				bind_dual.x() = Native2LE(bind_dual.x());
+				bind_dual.y() = Native2LE(bind_dual.y());
+				bind_dual.z() = Native2LE(bind_dual.z());
+				bind_dual.w() = Native2LE(bind_dual.w());
+				os.write(reinterpret_cast<char*>(&bind_dual), sizeof(bind_dual));
+			}
+		}
+	}
+
+	void WriteBBKeyFramesChunk(std::vector<AABBKeyFrames> const & bb_kfs, std::ostream& os)
+	{
+		for (size_t i = 0; i < bb_kfs.size(); ++ i)
+		{
+			uint32_t num_bb_kf = Native2LE(static_cast<uint32_t>(bb_kfs[i].frame_id.size()));
+			os.write(reinterpret_cast<char*>(&num_bb_kf), sizeof(num_bb_kf));
+
+			for (uint32_t j = 0; j < bb_kfs[i].frame_id.size(); ++ j)
+			{
+				uint32_t frame_id = Native2LE(bb_kfs[i].frame_id[j]);
+				os.write(reinterpret_cast<char*>(&frame_id), sizeof(frame_id));
+				float3 bb_min;
+				bb_min.x() = Native2LE(bb_kfs[i].bb[j].Min().x());
+				bb_min.y() = Native2LE(bb_kfs[i].bb[j].Min().y());
+				bb_min.z() = Native2LE(bb_kfs[i].bb[j].Min().z());
+				os.write(reinterpret_cast<char*>(&bb_min), sizeof(bb_min));
+				float3 bb_max = bb_kfs[i].bb[j].Max();
+				bb_max.x() = Native2LE(bb_kfs[i].bb[j].Max().x());
+				bb_max.y() = Native2LE(bb_kfs[i].bb[j].Max().y());
+				bb_max.z() = Native2LE(bb_kfs[i].bb[j].Max().z());
+				os.write(reinterpret_cast<char*>(&bb_max), sizeof(bb_max));
+			}
+		}
+	}
+
+	void WriteActionsChunk(std::vector<AnimationAction> const & actions, std::ostream& os)
+	{
+		for (size_t i = 0; i < actions.size(); ++ i)
+		{
+			WriteShortString(os, actions[i].name);
+
+			uint32_t sf = Native2LE(actions[i].start_frame);
+			os.write(reinterpret_cast<char*>(&sf), sizeof(sf));
+
+			uint32_t ef = Native2LE(actions[i].end_frame);
+			os.write(reinterpret_cast<char*>(&ef), sizeof(ef));
+		}
+	}
+
+	// Runs the external tool commands in parallel. They work on different files.
+	void RunCommands(std::vector<std::string> const & cmds)
+	{
+		thread_pool& tp = Context::Instance().ThreadPool();
+		std::vector<joiner<void>> joiners;
+		joiners.reserve(cmds.size());
+		for (auto const & cmd : cmds)
+		{
+			joiners.push_back(tp([&cmd]
+				{
+					if (system(cmd.c_str()) != 0)
+					{
+						LogWarn("Command failed: %s", cmd.c_str());
+					}
+				}));
+		}
+		for (auto& joiner : joiners)
+		{
+			joiner();
+		}
+	}
+
+	void ConvertTextures(std::string const & output_name, std::vector<OfflineRenderMaterial>& mtls, std::string const & platform)
+	{
+		std::map<filesystem::path, std::vector<std::pair<size_t, size_t>>> all_texture_slots;
+		for (size_t i = 0; i < mtls.size(); ++ i)
+		{
+			for (size_t j = 0; j < mtls[i].texture_slots.size(); ++ j)
+			{
+				all_texture_slots[filesystem::path(mtls[i].texture_slots[j].second)].emplace_back(i, j);
+			}
+		}
+
+		std::vector<std::pair<filesystem::path, std::string>> deploy_files;
+		std::vector<std::string> texconv_cmds;
+		for (auto const & slot : all_texture_slots)
+		{
+#ifdef KLAYGE_TS_LIBRARY_FILESYSTEM_V2_SUPPORT
+			std::string ext_name = slot.first.extension();
+#else
+			std::string ext_name = slot.first.extension().string();
+#endif
+			if (ext_name != ".dds")
+			{
+				texconv_cmds.push_back("texconv -f A8B8G8R8 -ft DDS -m 1 \"" + slot.first.string() + "\"");
+
+#ifdef KLAYGE_TS_LIBRARY_FILESYSTEM_V2_SUPPORT
+				std::string tex_base = (slot.first.parent_path() / filesystem::path(slot.first.stem())).string();
+#else
+				std::string tex_base = (slot.first.parent_path() / slot.first.stem()).string();
+#endif
+				deploy_files.emplace_back(filesystem::path(tex_base + ".dds"),
+					mtls[slot.second[0].first].texture_slots[slot.second[0].second].first);
+			}
+		}
+
+		RunCommands(texconv_cmds);
+
+		std::vector<std::pair<filesystem::path, filesystem::path>> dup_files;
+		std::map<filesystem::path, std::vector<std::pair<size_t, size_t>>> augmented_texture_slots;
+		for (auto const & slot : all_texture_slots)
+		{
+#ifdef KLAYGE_TS_LIBRARY_FILESYSTEM_V2_SUPPORT
+			std::string tex_base = (slot.first.parent_path() / filesystem::path(slot.first.stem())).string();
+#else
+			std::string tex_base = (slot.first.parent_path() / slot.first.stem()).string();
+#endif
+			augmented_texture_slots[filesystem::path(tex_base + ".dds")].push_back(slot.second[0]);
+
+			for (size_t i = 1; i < slot.second.size(); ++ i)
+			{
+				std::pair<size_t, size_t> const & slot_index = slot.second[i];
+				std::string const & type = mtls[slot_index.first].texture_slots[slot_index.second].first;
+				if (type != mtls[slot.second[0].first].texture_slots[slot.second[0].second].first)
+				{
+					filesystem::path new_name(filesystem::path(tex_base + "_" + type + ".dds"));
+					if (filesystem::exists(new_name))
+					{
+						size_t j = 0;
+						do
+						{
+							std::stringstream ss;
+							ss << tex_base << "_" << type << "_" << j << ".dds";
+							new_name = filesystem::path(ss.str());
+							++ j;
+						} while (filesystem::exists(new_name));
+					}
+
+					if (augmented_texture_slots.find(new_name) == augmented_texture_slots.end())
+					{
+						dup_files.emplace_back(filesystem::path(tex_base + ".dds"), new_name);
+						deploy_files.emplace_back(new_name, type);
+					}
+					augmented_texture_slots[new_name].push_back(slot_index);
+				}
+			}
+		}
+
+		for (auto const & dup : dup_files)
+		{
+			filesystem::copy_file(std::get<0>(dup), std::get<1>(dup));
+		}
+
+		std::vector<std::string> deploy_cmds;
+		for (auto const & df : deploy_files)
+		{
+			std::string deploy_type;
+			size_t const type_hash = RT_HASH(df.second.c_str());
+			if ((CT_HASH("Color") == type_hash) || (CT_HASH("Diffuse Color") == type_hash)
+				|| (CT_HASH("Diffuse Color Map") == type_hash)
+				|| (CT_HASH("Albedo") == type_hash))
+			{
+				deploy_type = "albedo";
+			}
+			else if (CT_HASH("Metalness") == type_hash)
+			{
+				deploy_type = "metalness";
+			}
+			else if ((CT_HASH("Glossiness") == type_hash) || (CT_HASH("Reflection Glossiness Map") == type_hash))
+			{
+				deploy_type = "glossiness";
+			}
+			else if ((CT_HASH("Self-Illumination") == type_hash) || (CT_HASH("Emissive") == type_hash))
+			{
+				deploy_type = "emissive";
+			}
+			else if ((CT_HASH("Bump") == type_hash) || (CT_HASH("Bump Map") == type_hash))
+			{
+				deploy_type = "bump";
+			}
+			else if ((CT_HASH("Normal") == type_hash) || (CT_HASH("Normal Map") == type_hash))
+			{
+				deploy_type = "normal";
+			}
+			else if ((CT_HASH("Height") == type_hash) || (CT_HASH("Height Map") == type_hash))
+			{
+				deploy_type = "height";
+			}
+			else
+			{
+				// TODO
+				deploy_type = df.second;
+			}
+
+			LogInfo("Processing %s", df.first.string().c_str());
+
+			deploy_cmds.push_back("platformdeployer -P " + platform + " -I \"" + df.first.string() + "\" -T " + deploy_type);
+		}
+		RunCommands(deploy_cmds);
+
+		filesystem::path output_folder = filesystem::path(output_name).parent_path();
+		for (auto const & slot : augmented_texture_slots)
+		{
+			std::string rel_path = make_relative(output_folder, slot.first).string();
+
+			for (auto const & slot_index : slot.second)
+			{
+				mtls[slot_index.first].texture_slots[slot_index.second].second = rel_path;
+			}
+		}
+	}
+
+	std::string ReplaceExtToDDS(std::string const & name)
+	{
+		std::string ret;
+		size_t dot_pos = name.find_last_of('.');
+		if (dot_pos != std::string::npos)
+		{
+			std::string base_name = name.substr(0, dot_pos);
+			ret = base_name + ".dds";
+		}
+		else
+		{
+			ret = name;
+		}
+		return ret;
+	}
+
+	void CompileMeshML(std::string const & meshml_name, std::string const & output_name, std::string const & platform)
+	{
+		std::ostringstream ss;
+
+		ResIdentifierPtr file = ResLoader::Instance().Open(meshml_name);
+		if (!file)
+		{
+			THR(std::errc::no_such_file_or_directory);
+		}
+
+		// Exports can be hundreds of megabytes, so the file is streamed. Only the small chunks are handed to the DOM.
+		XMLReader reader(file);
+		while (reader.Next() != XRE_StartElement)
+		{
+			if (XRE_EndOfDocument == reader.Event())
+			{
+				THR(std::errc::invalid_argument);
+			}
+		}
+
+		BOOST_ASSERT(reader.AttribInt("version", 0) >= 1);
+
+		bool has_materials = false;
+		std::vector<OfflineRenderMaterial> mtls;
+
+		bool has_meshes = false;
+		std::vector<std::string> mesh_names;
+		std::vector<int32_t> mtl_ids;
+		std::vector<AABBox> pos_bbs;
+		std::vector<AABBox> tc_bbs;
+		std::vector<uint32_t> mesh_num_vertices;
+		std::vector<uint32_t> mesh_base_vertices;
+		std::vector<uint32_t> mesh_num_indices;
+		std::vector<uint32_t> mesh_start_indices;
+		std::vector<vertex_element> merged_ves;
+		std::vector<std::vector<uint8_t>> merged_vertices;
+		std::vector<uint8_t> merged_indices;
+		char is_index_16_bit = true;
+
+		bool has_bones = false;
+		std::vector<Joint> joints;
+
+		bool has_key_frames = false;
+		bool has_bb_key_frames = false;
+		uint32_t num_frames = 0;
+		uint32_t frame_rate = 0;
+		std::vector<KeyFrames> kfs;
+		std::vector<AABBKeyFrames> bb_kfs;
+
+		bool has_actions = false;
+		std::string actions_xml;
+
+		uint32_t const root_depth = reader.Depth();
+		while (reader.NextChildElement(root_depth))
+		{
+			std::string_view const name = reader.Name();
+			if ("materials_chunk" == name)
+			{
+				has_materials = true;
+				KlayGE::XMLDocument doc;
+				CompileMaterialsChunk(ParseElement(doc, reader), mtls);
+			}
+			else if ("meshes_chunk" == name)
+			{
+				has_meshes = true;
+				CompileMeshesChunk(reader, mesh_names, mtl_ids, pos_bbs, tc_bbs,
+					mesh_num_vertices, mesh_base_vertices,
+					mesh_num_indices, mesh_start_indices,
+					merged_ves, merged_vertices, merged_indices,
+					is_index_16_bit);
+			}
+			else if ("bones_chunk" == name)
+			{
+				has_bones = true;
+				KlayGE::XMLDocument doc;
+				CompileBonesChunk(ParseElement(doc, reader), joints);
+			}
+			else if ("key_frames_chunk" == name)
+			{
+				has_key_frames = true;
+				CompileKeyFramesChunk(reader, num_frames, frame_rate, kfs);
+			}
+			else if ("bb_key_frames_chunk" == name)
+			{
+				has_bb_key_frames = true;
+				CompileBBKeyFramesChunk(reader, bb_kfs);
+			}
+			else if ("actions_chunk" == name)
+			{
+				// The default action needs num_frames, which may come later in the file
+				has_actions = true;
+				actions_xml = reader.ReadElementXML();
+			}
+		}
+
+		if (has_materials)
+		{
+			if (!platform.empty())
+			{
+				ConvertTextures(output_name, mtls, platform);
+			}
+
+			for (size_t i = 0; i < mtls.size(); ++ i)
+			{
+				for (size_t j = 0; j < mtls[i].texture_slots.size(); ++ j)
+				{
+					size_t const type_hash = RT_HASH(mtls[i].texture_slots[j].first.c_str());
+					if ((CT_HASH("Color") == type_hash) || (CT_HASH("Diffuse Color") == type_hash)
+						|| (CT_HASH("Diffuse Color Map") == type_hash)
+						|| (CT_HASH("Albedo") == type_hash))
+					{
+						mtls[i].material.tex_names[RenderMaterial::TS_Albedo] = ReplaceExtToDDS(mtls[i].texture_slots[j].second);
+					}
+					else if (CT_HASH("Metalness") == type_hash)
+					{
+						mtls[i].material.tex_names[RenderMaterial::TS_Metalness] = ReplaceExtToDDS(mtls[i].texture_slots[j].second);
+					}
+					else if ((CT_HASH("Glossiness") == type_hash) || (CT_HASH("Reflection Glossiness Map") == type_hash))
+					{
+						mtls[i].material.tex_names[RenderMaterial::TS_Glossiness] = ReplaceExtToDDS(mtls[i].texture_slots[j].second);
+					}
+					else if ((CT_HASH("Self-Illumination") == type_hash) || (CT_HASH("Emissive") == type_hash))
+					{
+						mtls[i].material.tex_names[RenderMaterial::TS_Emissive] = ReplaceExtToDDS(mtls[i].texture_slots[j].second);
+					}
+					else if ((CT_HASH("Bump") == type_hash) || (CT_HASH("Bump Map") == type_hash)
+						|| (CT_HASH("Normal") == type_hash) || (CT_HASH("Normal Map") == type_hash))
+					{
+						mtls[i].material.tex_names[RenderMaterial::TS_Normal] = ReplaceExtToDDS(mtls[i].texture_slots[j].second);
+					}
+					else if ((CT_HASH("Height") == type_hash) || (CT_HASH("Height Map") == type_hash))
+					{
+						mtls[i].material.tex_names[RenderMaterial::TS_Height] = ReplaceExtToDDS(mtls[i].texture_slots[j].second);
+					}
+				}
+			}
+		}
+		{
+			uint32_t num_mtls = Native2LE(static_cast<uint32_t>(mtls.size()));
+			ss.write(reinterpret_cast<char*>(&num_mtls), sizeof(num_mtls));
+		}
+
+		{
+			uint32_t num_meshes = Native2LE(static_cast<uint32_t>(pos_bbs.size()));
+			ss.write(reinterpret_cast<char*>(&num_meshes), sizeof(num_meshes));
+		}
+
+		{
+			uint32_t num_joints = Native2LE(static_cast<uint32_t>(joints.size()));
+			ss.write(reinterpret_cast<char*>(&num_joints), sizeof(num_joints));
+		}
+
+		if (has_key_frames)
+		{
+			if (!has_bb_key_frames)
+			{
+				DefaultBBKeyFrames(pos_bbs, num_frames, bb_kfs);
+			}
+		}
+		{
+			uint32_t num_kfs = Native2LE(static_cast<uint32_t>(kfs.size()));
+			ss.write(reinterpret_cast<char*>(&num_kfs), sizeof(num_kfs));
+		}
+
+		std::vector<AnimationAction> actions;
+		if (has_actions)
+		{
+			KlayGE::XMLDocument doc;
+			CompileActionsChunk(ParseElement(doc, actions_xml), num_frames, actions);
+		}
+		{
+			uint32_t num_actions = Native2LE(has_key_frames ? std::max(static_cast<uint32_t>(actions.size()), 1U) : 0);
+			ss.write(reinterpret_cast<char*>(&num_actions), sizeof(num_actions));
+		}
+
+		if (has_materials)
+		{
+			WriteMaterialsChunk(mtls, ss);
+		}
+
+		if (has_meshes)
+		{
+			WriteMeshesChunk(mesh_names, mtl_ids, pos_bbs, tc_bbs,
+				mesh_num_vertices, mesh_base_vertices, mesh_num_indices, mesh_start_indices,
+				merged_ves, merged_vertices, merged_indices, is_index_16_bit, ss);
+		}
+
+		if (has_bones)
+		{
+			WriteBonesChunk(joints, ss);
+		}
+
+		if (has_key_frames)
+		{
+			WriteKeyFramesChunk(num_frames, frame_rate, kfs, ss);
+			WriteBBKeyFramesChunk(bb_kfs, ss);
+			WriteActionsChunk(actions, ss);
+		}
+
+		std::ofstream ofs(output_name.c_str(), std::ios_base::binary);
+		if (!ofs)
+		{
+			THR(std::errc::permission_denied);
+		}
+		uint32_t fourcc = Native2LE(MakeFourCC<'K', 'L', 'M', ' '>::value);
+		ofs.write(reinterpret_cast<char*>(&fourcc), sizeof(fourcc));
+
+		uint32_t ver = Native2LE(MODEL_BIN_VERSION);
+		ofs.write(reinterpret_cast<char*>(&ver), sizeof(ver));
+
+		uint64_t original_len = Native2LE(static_cast<uint64_t>(ss.str().size()));
+		ofs.write(reinterpret_cast<char*>(&original_len), sizeof(original_len));
+
+		std::ofstream::pos_type p = ofs.tellp();
+		uint64_t len = 0;
+		ofs.write(reinterpret_cast<char*>(&len), sizeof(len));
+
+		LZMACodec lzma;
+		len = lzma.Encode(ofs, ss.str().c_str(), ss.str().size());
+
+		ofs.seekp(p, std::ios_base::beg);
+		len = Native2LE(len);
+		ofs.write(reinterpret_cast<char*>(&len), sizeof(len));
+	}
+}
+
+namespace KlayGE
+{
+	std::string MeshMLJIT(std::string const & input_name, std::string const & target_folder,
+		std::string const & platform)
+	{
+		std::string meshml_name = ResLoader::Instance().Locate(input_name);
+		if (meshml_name.empty())
+		{
+			filesystem::path input_path(input_name);
+#ifdef KLAYGE_TS_LIBRARY_FILESYSTEM_V2_SUPPORT
+			std::string base_name = input_path.stem();
+#else
+			std::string base_name = input_path.stem().string();
+#endif
+			filesystem::path folder = input_path.parent_path();
+			meshml_name = (folder / filesystem::path(base_name)).string() + ".7z//" + base_name + ".meshml";
+		}
+
+		filesystem::path target_path(target_folder);
+		std::string::size_type const pkt_offset(meshml_name.find("//"));
+		std::string file_name;
+		if (pkt_offset != std::string::npos)
+		{
+			std::string pkt_name = meshml_name.substr(0, pkt_offset);
+			std::string::size_type const password_offset = pkt_name.find("|");
+			if (password_offset != std::string::npos)
+			{
+				pkt_name = pkt_name.substr(0, password_offset - 1);
+			}
+
+			if (target_path.empty())
+			{
+				target_path = filesystem::path(pkt_name).parent_path();
+			}
+
+			file_name = meshml_name.substr(pkt_offset + 2);
+		}
+		else
+		{
+			filesystem::path meshml_path(meshml_name);
+			if (target_path.empty())
+			{
+				target_path = meshml_path.parent_path();
+			}
+#ifdef KLAYGE_TS_LIBRARY_FILESYSTEM_V2_SUPPORT
+			file_name = meshml_path.filename();
+#else
+			file_name = meshml_path.filename().string();
+#endif
+		}
+
+		std::string const output_name = (target_path / filesystem::path(file_name)).string() + JIT_EXT_NAME;
+		CompileMeshML(meshml_name, output_name, platform);
+		return output_name;
+	}
+}
+
+#endif
@@ -38,9 +38,12 @@
 #include <KlayGE/Camera.hpp>
 #include <KlayGE/ResLoader.hpp>
 #include <KFL/XMLDom.hpp>
+#include <KFL/SIMDMath.hpp>
 #include <KlayGE/DeferredRenderingLayer.hpp>
 #include <KFL/Hash.hpp>
 
+#include <algorithm>
+#include <cstring>
 #include <fstream>
 
 #if defined(KLAYGE_COMPILER_GCC)
@@ -56,12 +59,198 @@
 
 #include <KlayGE/ParticleSystem.hpp>
 
+#if defined(KLAYGE_SSE_SUPPORT)
+#include <xmmintrin.h>
+#endif
+
 namespace
 {
 	using namespace KlayGE;
 
 	uint32_t const NUM_PARTICLES = 4096;
 
+	// 4-wide float operations for the batch particle updates
+#if defined(KLAYGE_SSE_SUPPORT)
+	typedef __m128 FloatX4;
+
+	inline FloatX4 LoadX4(float const * p)
+	{
+		return _mm_loadu_ps(p);
+	}
+	inline void StoreX4(float* p, FloatX4 v)
+	{
+		_mm_storeu_ps(p, v);
+	}
+	inline FloatX4 SetX4(float v)
+	{
+		return _mm_set1_ps(v);
+	}
+	inline FloatX4 AddX4(FloatX4 lhs, FloatX4 rhs)
+	{
+		return _mm_add_ps(lhs, rhs);
+	}
+	inline FloatX4 SubX4(FloatX4 lhs, FloatX4 rhs)
+	{
+		return _mm_sub_ps(lhs, rhs);
+	}
+	inline FloatX4 MulX4(FloatX4 lhs, FloatX4 rhs)
+	{
+		return _mm_mul_ps(lhs, rhs);
+	}
+	inline FloatX4 DivX4(FloatX4 lhs, FloatX4 rhs)
+	{
+		return _mm_div_ps(lhs, rhs);
+	}
+	inline FloatX4 MinX4(FloatX4 lhs, FloatX4 rhs)
+	{
+		return _mm_min_ps(lhs, rhs);
+	}
+	inline FloatX4 MaxX4(FloatX4 lhs, FloatX4 rhs)
+	{
+		return _mm_max_ps(lhs, rhs);
+	}
+#else
+	struct FloatX4
+	{
+		float v[4];
+	};
+
+	inline FloatX4 LoadX4(float const * p)
+	{
+		FloatX4 ret;
+		std::memcpy(ret.v, p, sizeof(ret.v));
+		return ret;
+	}
+	inline void StoreX4(float* p, FloatX4 const & v)
+	{
+		std::memcpy(p, v.v, sizeof(v.v));
+	}
+	inline FloatX4 SetX4(float v)
+	{
+		FloatX4 ret = { { v, v, v, v } };
+		return ret;
+	}
+	inline FloatX4 AddX4(FloatX4 const & lhs, FloatX4 const & rhs)
+	{
+		FloatX4 ret = { { lhs.v[0] + rhs.v[0], lhs.v[1] + rhs.v[1], lhs.v[2] + rhs.v[2], lhs.v[3] + rhs.v[3] } };
+		return ret;
+	}
+	inline FloatX4 SubX4(FloatX4 const & lhs, FloatX4 const & rhs)
+	{
+		FloatX4 ret = { { lhs.v[0] - rhs.v[0], lhs.v[1] - rhs.v[1], lhs.v[2] - rhs.v[2], lhs.v[3] - rhs.v[3] } };
+		return ret;
+	}
+	inline FloatX4 MulX4(FloatX4 const & lhs, FloatX4 const & rhs)
+	{
+		FloatX4 ret = { { lhs.v[0] * rhs.v[0], lhs.v[1] * rhs.v[1], lhs.v[2] * rhs.v[2], lhs.v[3] * rhs.v[3] } };
+		return ret;
+	}
+	inline FloatX4 DivX4(FloatX4 const & lhs, FloatX4 const & rhs)
+	{
+		FloatX4 ret = { { lhs.v[0] / rhs.v[0], lhs.v[1] / rhs.v[1], lhs.v[2] / rhs.v[2], lhs.v[3] / rhs.v[3] } };
+		return ret;
+	}
+	inline FloatX4 MinX4(FloatX4 const & lhs, FloatX4 const & rhs)
+	{
+		FloatX4 ret = { { std::min(lhs.v[0], rhs.v[0]), std::min(lhs.v[1], rhs.v[1]),
+			std::min(lhs.v[2], rhs.v[2]), std::min(lhs.v[3], rhs.v[3]) } };
+		return ret;
+	}
+	inline FloatX4 MaxX4(FloatX4 const & lhs, FloatX4 const & rhs)
+	{
+		FloatX4 ret = { { std::max(lhs.v[0], rhs.v[0]), std::max(lhs.v[1], rhs.v[1]),
+			std::max(lhs.v[2], rhs.v[2]), std::max(lhs.v[3], rhs.v[3]) } };
+		return ret;
+	}
+#endif
+
+	inline FloatX4 MulAddX4(FloatX4 const & a, FloatX4 const & b, FloatX4 const & c)
+	{
+		return AddX4(MulX4(a, b), c);
+	}
+
+	// Evaluates y0 + sum(dy * saturate((t - x_start) * inv_width)) for 4 particles
+	FloatX4 EvalRampsX4(float y0, float const * x_start, float const * inv_width, float const * dy, size_t num_ramps,
+		FloatX4 const & t)
+	{
+		FloatX4 const zero = SetX4(0);
+		FloatX4 const one = SetX4(1);
+
+		FloatX4 ret = SetX4(y0);
+		for (size_t i = 0; i < num_ramps; ++ i)
+		{
+			FloatX4 const s = MinX4(MaxX4(MulX4(SubX4(t, SetX4(x_start[i])), SetX4(inv_width[i])), zero), one);
+			ret = MulAddX4(s, SetX4(dy[i]), ret);
+		}
+		return ret;
+	}
+
+	// Maps a float to a uint32_t that keeps the order, and then inverts it for a descending sort
+	inline uint32_t DescendingSortKey(float f)
+	{
+		uint32_t u;
+		std::memcpy(&u, &f, sizeof(u));
+		uint32_t const mask = static_cast<uint32_t>(-static_cast<int32_t>(u >> 31)) | 0x80000000U;
+		return ~(u ^ mask);
+	}
+
+	// LSD radix sort of values by keys with 11-bit digits. Digits that are equal on all keys are skipped.
+	//  The results are in keys and values. tmp_keys and tmp_values are scratch buffers of at least num elements.
+	void RadixSort(uint32_t* keys, uint32_t* values, uint32_t* tmp_keys, uint32_t* tmp_values, uint32_t num)
+	{
+		uint32_t* const out_keys = keys;
+		uint32_t* const out_values = values;
+
+		uint32_t const DIGIT_BITS = 11;
+		uint32_t const NUM_BUCKETS = 1UL << DIGIT_BITS;
+		uint32_t const NUM_PASSES = 3;
+
+		std::vector<uint32_t> hist(NUM_BUCKETS * NUM_PASSES, 0);
+		for (uint32_t i = 0; i < num; ++ i)
+		{
+			uint32_t const key = keys[i];
+			++ hist[0 * NUM_BUCKETS + (key & (NUM_BUCKETS - 1))];
+			++ hist[1 * NUM_BUCKETS + ((key >> DIGIT_BITS) & (NUM_BUCKETS - 1))];
+			++ hist[2 * NUM_BUCKETS + (key >> (DIGIT_BITS * 2))];
+		}
+
+		for (uint32_t pass = 0; pass < NUM_PASSES; ++ pass)
+		{
+			uint32_t* offsets = &hist[pass * NUM_BUCKETS];
+			uint32_t const shift = pass * DIGIT_BITS;
+			if (offsets[(keys[0] >> shift) & (NUM_BUCKETS - 1)] == num)
+			{
+				continue;
+			}
+
+			uint32_t sum = 0;
+			for (uint32_t i = 0; i < NUM_BUCKETS; ++ i)
+			{
+				uint32_t const count = offsets[i];
+				offsets[i] = sum;
+				sum += count;
+			}
+
+			for (uint32_t i = 0; i < num; ++ i)
+			{
+				uint32_t const key = keys[i];
+				uint32_t const dst = offsets[(key >> shift) & (NUM_BUCKETS - 1)] ++;
+				tmp_keys[dst] = key;
+				tmp_values[dst] = values[i];
+			}
+
+			std::swap(keys, tmp_keys);
+			std::swap(values, tmp_values);
+		}
+
+		// After an odd number of passes the results are in the scratch buffers
+		if (keys != out_keys)
+		{
+			std::copy(keys, keys + num, out_keys);
+			std::copy(values, values + num, out_values);
+		}
+	}
+
 	class ParticleSystemLoadingDesc : public ResLoadingDesc
 	{
 	private:
@@ -538,19 +727,61 @@ namespace
 
 		using RenderableHelper::PosBound;
 	};
+}
 
-	class ParticleCmp
+namespace KlayGE
+{
+	ParticleStore::ParticleStore(uint32_t capacity)
+		: capacity_(capacity), stride_((capacity + 3 + 3) & ~3U),
+			data_(PA_NumAttribs * stride_, 0.0f)
 	{
-	public:
-		bool operator()(std::pair<uint32_t, float> const & lhs, std::pair<uint32_t, float> const & rhs) const
+		// The free particles are processed in batches too. Keep them away from dividing by 0.
+		std::fill_n(this->Data(PA_InitLife), stride_, 1.0f);
+	}
+
+	Particle ParticleStore::Get(uint32_t i) const
+	{
+		BOOST_ASSERT(i < capacity_);
+
+		Particle par;
+		par.pos = float3(this->Data(PA_PosX)[i], this->Data(PA_PosY)[i], this->Data(PA_PosZ)[i]);
+		par.vel = float3(this->Data(PA_VelX)[i], this->Data(PA_VelY)[i], this->Data(PA_VelZ)[i]);
+		par.life = this->Data(PA_Life)[i];
+		par.spin = this->Data(PA_Spin)[i];
+		par.size = this->Data(PA_Size)[i];
+		par.alpha = this->Data(PA_Alpha)[i];
+		par.init_life = this->Data(PA_InitLife)[i];
+		return par;
+	}
+
+	void ParticleStore::Set(uint32_t i, Particle const & par)
+	{
+		BOOST_ASSERT(i < capacity_);
+
+		this->Data(PA_PosX)[i] = par.pos.x();
+		this->Data(PA_PosY)[i] = par.pos.y();
+		this->Data(PA_PosZ)[i] = par.pos.z();
+		this->Data(PA_VelX)[i] = par.vel.x();
+		this->Data(PA_VelY)[i] = par.vel.y();
+		this->Data(PA_VelZ)[i] = par.vel.z();
+		this->Data(PA_Life)[i] = par.life;
+		this->Data(PA_Spin)[i] = par.spin;
+		this->Data(PA_Size)[i] = par.size;
+		this->Data(PA_Alpha)[i] = par.alpha;
+		this->Data(PA_InitLife)[i] = par.init_life;
+	}
+
+	void ParticleStore::Move(uint32_t dst, uint32_t src)
+	{
+		BOOST_ASSERT((dst < capacity_) && (src < capacity_));
+
+		for (uint32_t attrib = 0; attrib < PA_NumAttribs; ++ attrib)
 		{
-			return lhs.second > rhs.second;
+			data_[attrib * stride_ + dst] = data_[attrib * stride_ + src];
 		}
-	};
-}
+	}
+
 
-namespace KlayGE
-{
 	ParticleEmitter::ParticleEmitter(SceneObjectPtr const & ps)
 			: ps_(checked_pointer_cast<ParticleSystem>(ps)),
 				model_mat_(float4x4::Identity()),
@@ -563,6 +794,17 @@ namespace KlayGE
 		return static_cast<uint32_t>(elapsed_time * emit_freq_ + 0.5f);
 	}
 
+	void ParticleEmitter::EmitBatch(ParticleStore& store, uint32_t begin, uint32_t end)
+	{
+		Particle par;
+		par.alpha = 0;
+		for (uint32_t i = begin; i < end; ++ i)
+		{
+			this->Emit(par);
+			store.Set(i, par);
+		}
+	}
+
 	void ParticleEmitter::DoClone(ParticleEmitterPtr const & rhs)
 	{
 		rhs->ps_ = ps_;
@@ -590,6 +832,16 @@ namespace KlayGE
 	{
 	}
 
+	void ParticleUpdater::UpdateBatch(ParticleStore& store, uint32_t begin, uint32_t end, float elapse_time)
+	{
+		for (uint32_t i = begin; i < end; ++ i)
+		{
+			Particle par = store.Get(i);
+			this->Update(par, elapse_time);
+			store.Set(i, par);
+		}
+	}
+
 	void ParticleUpdater::DoClone(ParticleUpdaterPtr const & rhs)
 	{
 		rhs->ps_ = ps_;
@@ -597,12 +849,22 @@ namespace KlayGE
 
 
 	ParticleSystem::ParticleSystem(uint32_t max_num_particles)
-		: SceneObjectHelper(SOA_Moveable | SOA_NotCastShadow),
-			particles_(max_num_particles),
+		: SceneObjectHelper(SOA_Moveable | SOA_NotCastShadow | SOA_ParallelUpdate),
+			particles_(max_num_particles), num_alive_(0),
+			write_snapshot_(0), read_snapshot_(1), ready_snapshot_(2), num_active_particles_(0),
 			gravity_(0.5f), force_(0, 0, 0), media_density_(0.0f)
 	{
 		this->ClearParticles();
 
+		depths_.resize(particles_.Stride());
+		sort_keys_.resize(max_num_particles);
+		sort_tmp_keys_.resize(max_num_particles);
+		sort_tmp_indices_.resize(max_num_particles);
+		for (auto& snapshot : snapshots_)
+		{
+			snapshot.data.reserve(max_num_particles * sizeof(ParticleInstance));
+		}
+
 		RenderFactory& rf = Context::Instance().RenderFactoryInstance();
 		gs_support_ = rf.RenderEngineInstance().DeviceCaps().gs_support;
 		renderable_ = MakeSharedPtr<RenderParticles>(gs_support_);
@@ -610,7 +872,7 @@ namespace KlayGE
 
 	ParticleSystemPtr ParticleSystem::Clone()
 	{
-		ParticleSystemPtr ret = MakeSharedPtr<ParticleSystem>(NUM_PARTICLES);
+		ParticleSystemPtr ret = MakeSharedPtr<ParticleSystem>(particles_.Capacity());
 
 		ret->emitters_.resize(emitters_.size());
 		for (size_t i = 0; i < emitters_.size(); ++ i)
@@ -706,80 +968,127 @@ namespace KlayGE
 
 	void ParticleSystem::ClearParticles()
 	{
-		for (auto& particle : particles_)
-		{
-			particle.life = 0;
-		}
+		num_alive_ = 0;
 	}
 
 	void ParticleSystem::SubThreadUpdate(float /*app_time*/, float elapsed_time)
 	{
-		auto emitter_iter = emitters_.begin();
-		uint32_t new_particle = (*emitter_iter)->Update(elapsed_time);
+		if (num_alive_ > 0)
+		{
+			for (auto const & updater : updaters_)
+			{
+				updater->UpdateBatch(particles_, 0, num_alive_, elapsed_time);
+			}
+			this->KillDeadParticles(0);
+		}
+
+		uint32_t const first_new = num_alive_;
+		for (auto const & emitter : emitters_)
+		{
+			uint32_t const num_new = std::min(emitter->Update(elapsed_time), particles_.Capacity() - num_alive_);
+			if (num_new > 0)
+			{
+				emitter->EmitBatch(particles_, num_alive_, num_alive_ + num_new);
+				num_alive_ += num_new;
+			}
+		}
+		if (num_alive_ > first_new)
+		{
+			for (auto const & updater : updaters_)
+			{
+				updater->UpdateBatch(particles_, first_new, num_alive_, 0);
+			}
+			this->KillDeadParticles(first_new);
+		}
 
 		float4x4 const & view_mat = Context::Instance().AppInstance().ActiveCamera().ViewMatrix();
-		std::vector<std::pair<uint32_t, float>> active_particles;
+		this->SortActiveParticles(view_mat);
+		this->FillInstanceData();
+	}
 
-		float3 min_bb(+1e10f, +1e10f, +1e10f);
-		float3 max_bb(-1e10f, -1e10f, -1e10f);
-		
-		for (uint32_t i = 0; i < particles_.size(); ++ i)
+	void ParticleSystem::KillDeadParticles(uint32_t begin)
+	{
+		float const * life = particles_.Data(ParticleStore::PA_Life);
+		uint32_t i = begin;
+		while (i < num_alive_)
 		{
-			Particle& particle = particles_[i];
-
-			if (particle.life > 0)
+			if (life[i] > 0)
 			{
-				for (auto const & updater : updaters_)
-				{
-					updater->Update(particle, elapsed_time);
-				}
+				++ i;
 			}
 			else
 			{
-				if (new_particle > 0)
-				{
-					(*emitter_iter)->Emit(particle);
-					for (auto const & updater : updaters_)
-					{
-						updater->Update(particle, 0);
-					}
-					-- new_particle;
-				}
-				else
-				{
-					if (emitter_iter != emitters_.end())
-					{
-						++ emitter_iter;
-						if (emitter_iter != emitters_.end())
-						{
-							new_particle = (*emitter_iter)->Update(elapsed_time);
-						}
-					}
-				}
+				-- num_alive_;
+				particles_.Move(i, num_alive_);
 			}
+		}
+	}
 
-			if (particle.life > 0)
-			{
-				float3 const & pos = particle.pos;
-				float p_to_v = (pos.x() * view_mat(0, 2) + pos.y() * view_mat(1, 2) + pos.z() * view_mat(2, 2) + view_mat(3, 2))
-					/ (pos.x() * view_mat(0, 3) + pos.y() * view_mat(1, 3) + pos.z() * view_mat(2, 3) + view_mat(3, 3));
+	void ParticleSystem::SortActiveParticles(float4x4 const & view_mat)
+	{
+		uint32_t const num = num_alive_;
+		active_particles_.resize(num);
+		if (0 == num)
+		{
+			return;
+		}
 
-				active_particles.emplace_back(i, p_to_v);
+		float const * pos_x = particles_.Data(ParticleStore::PA_PosX);
+		float const * pos_y = particles_.Data(ParticleStore::PA_PosY);
+		float const * pos_z = particles_.Data(ParticleStore::PA_PosZ);
 
-				min_bb = MathLib::minimize(min_bb, pos);
-				max_bb = MathLib::maximize(min_bb, pos);
-			}
-		}
+		SIMDMathLib::TransformDepthBatch(&depths_[0], pos_x, pos_y, pos_z, num, view_mat);
 
-		if (!active_particles.empty())
+		float3 min_bb(+1e10f, +1e10f, +1e10f);
+		float3 max_bb(-1e10f, -1e10f, -1e10f);
+		for (uint32_t i = 0; i < num; ++ i)
 		{
-			std::sort(active_particles.begin(), active_particles.end(), ParticleCmp());
+			float3 const pos(pos_x[i], pos_y[i], pos_z[i]);
+			min_bb = MathLib::minimize(min_bb, pos);
+			max_bb = MathLib::maximize(max_bb, pos);
 
-			checked_pointer_cast<RenderParticles>(renderable_)->PosBound(AABBox(min_bb, max_bb));
+			sort_keys_[i] = DescendingSortKey(depths_[i]);
+			active_particles_[i] = i;
 		}
 
-		std::lock_guard<std::mutex> lock(update_mutex_);
-		active_particles_ = active_particles;
+		RadixSort(&sort_keys_[0], &active_particles_[0], &sort_tmp_keys_[0], &sort_tmp_indices_[0], num);
+
+		snapshots_[write_snapshot_].pos_bound = AABBox(min_bb, max_bb);
+	}
+
+	void ParticleSystem::FillInstanceData()
+	{
+		uint32_t const num = static_cast<uint32_t>(active_particles_.size());
+
+		InstanceSnapshot& snapshot = snapshots_[write_snapshot_];
+		snapshot.data.resize(num * sizeof(ParticleInstance));
+		if (num > 0)
+		{
+			float const * pos_x = particles_.Data(ParticleStore::PA_PosX);
+			float const * pos_y = particles_.Data(ParticleStore::PA_PosY);
+			float const * pos_z = particles_.Data(ParticleStore::PA_PosZ);
+			float const * life = particles_.Data(ParticleStore::PA_Life);
+			float const * spin = particles_.Data(ParticleStore::PA_Spin);
+			float const * size = particles_.Data(ParticleStore::PA_Size);
+			float const * alpha = particles_.Data(ParticleStore::PA_Alpha);
+			float const * init_life = particles_.Data(ParticleStore::PA_InitLife);
+
+			ParticleInstance* instance_data = reinterpret_cast<ParticleInstance*>(&snapshot.data[0]);
+			for (uint32_t i = 0; i < num; ++ i, ++ instance_data)
+			{
+				uint32_t const index = active_particles_[i];
+				instance_data->pos = float3(pos_x[index], pos_y[index], pos_z[index]);
+				instance_data->life = life[index];
+				instance_data->spin = spin[index];
+				instance_data->size = size[index];
+				instance_data->life_factor = (init_life[index] - life[index]) / init_life[index];
+				instance_data->alpha = alpha[index];
+			}
+		}
+
+		// Publishes the snapshot, and takes back the stale one
+		write_snapshot_ = ready_snapshot_.exchange(write_snapshot_ | SNAPSHOT_FRESH, std::memory_order_acq_rel) & ~SNAPSHOT_FRESH;
+		num_active_particles_ = num;
 	}
 
 	bool ParticleSystem::MainThreadUpdate(float app_time, float elapsed_time)
@@ -787,13 +1096,20 @@ namespace KlayGE
 		KFL_UNUSED(app_time);
 		KFL_UNUSED(elapsed_time);
 
-		std::lock_guard<std::mutex> lock(update_mutex_);
+		if (!(ready_snapshot_.load(std::memory_order_relaxed) & SNAPSHOT_FRESH))
+		{
+			return false;
+		}
+		read_snapshot_ = ready_snapshot_.exchange(read_snapshot_, std::memory_order_acq_rel) & ~SNAPSHOT_FRESH;
+		InstanceSnapshot const & snapshot = snapshots_[read_snapshot_];
 
-		uint32_t const num_active_particles = static_cast<uint32_t>(active_particles_.size());
+		uint32_t const num_active_particles = static_cast<uint32_t>(snapshot.data.size() / sizeof(ParticleInstance));
 
 		RenderLayout& rl = renderable_->GetRenderLayout();
-		if (!active_particles_.empty())
+		if (num_active_particles > 0)
 		{
+			checked_pointer_cast<RenderParticles>(renderable_)->PosBound(snapshot.pos_bound);
+
 			GraphicsBufferPtr instance_gb;
 			if (gs_support_)
 			{
@@ -835,17 +1151,7 @@ namespace KlayGE
 
 			{
 				GraphicsBuffer::Mapper mapper(*instance_gb, BA_Write_Only);
-				ParticleInstance* instance_data = mapper.Pointer<ParticleInstance>();
-				for (uint32_t i = 0; i < num_active_particles; ++ i, ++ instance_data)
-				{
-					Particle const & par = particles_[active_particles_[i].first];
-					instance_data->pos = par.pos;
-					instance_data->life = par.life;
-					instance_data->spin = par.spin;
-					instance_data->size = par.size;
-					instance_data->life_factor = (par.init_life - par.life) / par.init_life;
-					instance_data->alpha = par.alpha;
-				}
+				std::memcpy(mapper.Pointer<uint8_t>(), &snapshot.data[0], new_instance_size);
 			}
 		}
 
@@ -1097,6 +1403,9 @@ namespace KlayGE
 	PolylineParticleUpdater::PolylineParticleUpdater(SceneObjectPtr const & ps)
 		: ParticleUpdater(ps)
 	{
+		size_ramps_.y0 = 0;
+		mass_ramps_.y0 = 0;
+		opacity_ramps_.y0 = 0;
 	}
 
 	std::string const & PolylineParticleUpdater::Type() const
@@ -1112,6 +1421,9 @@ namespace KlayGE
 		ret->size_over_life_ = size_over_life_;
 		ret->mass_over_life_ = mass_over_life_;
 		ret->opacity_over_life_ = opacity_over_life_;
+		ret->size_ramps_ = size_ramps_;
+		ret->mass_ramps_ = mass_ramps_;
+		ret->opacity_ramps_ = opacity_ramps_;
 		return ret;
 	}
 
@@ -1168,4 +1480,87 @@ namespace KlayGE
 		par.size = cur_size;
 		par.alpha = cur_alpha;
 	}
+
+	void PolylineParticleUpdater::UpdateBatch(ParticleStore& store, uint32_t begin, uint32_t end, float elapse_time)
+	{
+		std::lock_guard<std::mutex> lock(update_mutex_);
+
+		BOOST_ASSERT(!size_over_life_.empty());
+		BOOST_ASSERT(!mass_over_life_.empty());
+		BOOST_ASSERT(!opacity_over_life_.empty());
+
+		ParticleSystemPtr ps = ps_.lock();
+		float3 const & force = ps->Force();
+		FloatX4 const gravity = SetX4(ps->Gravity());
+		FloatX4 const buoyancy_scale = SetX4(4.0f / 3 * PI * ps->MediaDensity() * ps->Gravity());
+		FloatX4 const force_x = SetX4(force.x());
+		FloatX4 const force_y = SetX4(force.y());
+		FloatX4 const force_z = SetX4(force.z());
+		FloatX4 const dt = SetX4(elapse_time);
+		FloatX4 const one = SetX4(1);
+		FloatX4 const spin_step = SetX4(0.001f);
+
+		float* pos_x = store.Data(ParticleStore::PA_PosX);
+		float* pos_y = store.Data(ParticleStore::PA_PosY);
+		float* pos_z = store.Data(ParticleStore::PA_PosZ);
+		float* vel_x = store.Data(ParticleStore::PA_VelX);
+		float* vel_y = store.Data(ParticleStore::PA_VelY);
+		float* vel_z = store.Data(ParticleStore::PA_VelZ);
+		float* life = store.Data(ParticleStore::PA_Life);
+		float* spin = store.Data(ParticleStore::PA_Spin);
+		float* size = store.Data(ParticleStore::PA_Size);
+		float* alpha = store.Data(ParticleStore::PA_Alpha);
+		float const * init_life = store.Data(ParticleStore::PA_InitLife);
+
+		for (uint32_t i = begin; i < end; i += 4)
+		{
+			FloatX4 const cur_life = LoadX4(life + i);
+			FloatX4 const cur_init_life = LoadX4(init_life + i);
+			FloatX4 const t = DivX4(SubX4(cur_init_life, cur_life), cur_init_life);
+
+			FloatX4 const cur_size = EvalRampsX4(size_ramps_.y0, size_ramps_.x_start.data(), size_ramps_.inv_width.data(),
+				size_ramps_.dy.data(), size_ramps_.dy.size(), t);
+			FloatX4 const cur_mass = EvalRampsX4(mass_ramps_.y0, mass_ramps_.x_start.data(), mass_ramps_.inv_width.data(),
+				mass_ramps_.dy.data(), mass_ramps_.dy.size(), t);
+			FloatX4 const cur_alpha = EvalRampsX4(opacity_ramps_.y0, opacity_ramps_.x_start.data(), opacity_ramps_.inv_width.data(),
+				opacity_ramps_.dy.data(), opacity_ramps_.dy.size(), t);
+
+			FloatX4 const inv_mass = DivX4(one, cur_mass);
+			FloatX4 const buoyancy = MulX4(buoyancy_scale, MulX4(cur_size, MulX4(cur_size, cur_size)));
+			FloatX4 const accel_x = MulX4(force_x, inv_mass);
+			FloatX4 const accel_y = SubX4(MulX4(AddX4(force_y, buoyancy), inv_mass), gravity);
+			FloatX4 const accel_z = MulX4(force_z, inv_mass);
+
+			FloatX4 const new_vel_x = MulAddX4(accel_x, dt, LoadX4(vel_x + i));
+			FloatX4 const new_vel_y = MulAddX4(accel_y, dt, LoadX4(vel_y + i));
+			FloatX4 const new_vel_z = MulAddX4(accel_z, dt, LoadX4(vel_z + i));
+			StoreX4(vel_x + i, new_vel_x);
+			StoreX4(vel_y + i, new_vel_y);
+			StoreX4(vel_z + i, new_vel_z);
+			StoreX4(pos_x + i, MulAddX4(new_vel_x, dt, LoadX4(pos_x + i)));
+			StoreX4(pos_y + i, MulAddX4(new_vel_y, dt, LoadX4(pos_y + i)));
+			StoreX4(pos_z + i, MulAddX4(new_vel_z, dt, LoadX4(pos_z + i)));
+
+			StoreX4(life + i, SubX4(cur_life, dt));
+			StoreX4(spin + i, AddX4(LoadX4(spin + i), spin_step));
+			StoreX4(size + i, cur_size);
+			StoreX4(alpha + i, cur_alpha);
+		}
+	}
+
+	void PolylineParticleUpdater::BuildRamps(PolylineRamps& ramps, std::vector<float2> const & polyline)
+	{
+		ramps.y0 = polyline.empty() ? 0.0f : polyline[0].y();
+		ramps.x_start.clear();
+		ramps.inv_width.clear();
+		ramps.dy.clear();
+		for (size_t i = 1; i < polyline.size(); ++ i)
+		{
+			float const width = polyline[i].x() - polyline[i - 1].x();
+			ramps.x_start.push_back(polyline[i - 1].x());
+			// A vertical segment is a step
+			ramps.inv_width.push_back(width > 0 ? 1 / width : 1e30f);
+			ramps.dy.push_back(polyline[i].y() - polyline[i - 1].y());
+		}
+	}
 }
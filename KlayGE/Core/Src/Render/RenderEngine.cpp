@@ -968,7 +968,8 @@ namespace KlayGE
 
 	void RenderEngine::Refresh()
 	{
-		if (Context::Instance().AppInstance().MainWnd()->Active())
+		WindowPtr const & main_wnd = Context::Instance().AppInstance().MainWnd();
+		if (!main_wnd || main_wnd->Active())
 		{
 			Context::Instance().SceneManagerInstance().Update();
 
@@ -0,0 +1,568 @@
+/**
+ * @file OcclusionBuffer.cpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Thread.hpp>
+#include <KlayGE/Context.hpp>
+#include <KlayGE/RenderFactory.hpp>
+#include <KlayGE/Texture.hpp>
+#include <KlayGE/PerfProfiler.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(KLAYGE_SSE_SUPPORT)
+#include <xmmintrin.h>
+#endif
+
+#include <KlayGE/OcclusionBuffer.hpp>
+
+namespace
+{
+	using namespace KlayGE;
+
+	// Rows rasterized by one task
+	uint32_t const ROWS_PER_BAND = 16;
+
+	// Corners of the faces of AABBox, in the bit order of AABBox::Corner. Counter-clockwise around the outward normal.
+	int const BOX_FACES[6][4] =
+	{
+		{ 0, 4, 6, 2 },
+		{ 1, 3, 7, 5 },
+		{ 0, 1, 5, 4 },
+		{ 2, 6, 7, 3 },
+		{ 0, 2, 3, 1 },
+		{ 4, 5, 7, 6 }
+	};
+
+	float const MIN_W = 1e-5f;
+
+	// Pixel bounds of a screen space extent, clamped to [0, size]
+	inline int32_t FloorPixel(float v, uint32_t size)
+	{
+		return static_cast<int32_t>(std::floor(KlayGE::MathLib::clamp(v, 0.0f, static_cast<float>(size))));
+	}
+	inline int32_t CeilPixel(float v, uint32_t size)
+	{
+		return static_cast<int32_t>(std::ceil(KlayGE::MathLib::clamp(v, 0.0f, static_cast<float>(size))));
+	}
+
+#if defined(KLAYGE_SSE_SUPPORT)
+	typedef __m128 FloatX4;
+	typedef __m128 MaskX4;
+
+	inline FloatX4 LoadX4(float const * p)
+	{
+		return _mm_loadu_ps(p);
+	}
+	inline void StoreX4(float* p, FloatX4 v)
+	{
+		_mm_storeu_ps(p, v);
+	}
+	inline FloatX4 SetX4(float v)
+	{
+		return _mm_set1_ps(v);
+	}
+	inline FloatX4 SetX4(float x, float y, float z, float w)
+	{
+		return _mm_setr_ps(x, y, z, w);
+	}
+	inline FloatX4 AddX4(FloatX4 lhs, FloatX4 rhs)
+	{
+		return _mm_add_ps(lhs, rhs);
+	}
+	inline FloatX4 MulX4(FloatX4 lhs, FloatX4 rhs)
+	{
+		return _mm_mul_ps(lhs, rhs);
+	}
+	inline FloatX4 MinX4(FloatX4 lhs, FloatX4 rhs)
+	{
+		return _mm_min_ps(lhs, rhs);
+	}
+	inline FloatX4 MaxX4(FloatX4 lhs, FloatX4 rhs)
+	{
+		return _mm_max_ps(lhs, rhs);
+	}
+	inline MaskX4 NonNegativeX4(FloatX4 v)
+	{
+		return _mm_cmpge_ps(v, _mm_setzero_ps());
+	}
+	inline MaskX4 AndX4(MaskX4 lhs, MaskX4 rhs)
+	{
+		return _mm_and_ps(lhs, rhs);
+	}
+	inline bool AnyX4(MaskX4 mask)
+	{
+		return _mm_movemask_ps(mask) != 0;
+	}
+	inline FloatX4 SelectX4(MaskX4 mask, FloatX4 if_true, FloatX4 if_false)
+	{
+		return _mm_or_ps(_mm_and_ps(mask, if_true), _mm_andnot_ps(mask, if_false));
+	}
+	inline bool AnyGreaterEqualX4(FloatX4 lhs, FloatX4 rhs)
+	{
+		return _mm_movemask_ps(_mm_cmpge_ps(lhs, rhs)) != 0;
+	}
+#else
+	struct FloatX4
+	{
+		float v[4];
+	};
+	struct MaskX4
+	{
+		bool v[4];
+	};
+
+	inline FloatX4 LoadX4(float const * p)
+	{
+		FloatX4 ret;
+		std::memcpy(ret.v, p, sizeof(ret.v));
+		return ret;
+	}
+	inline void StoreX4(float* p, FloatX4 const & v)
+	{
+		std::memcpy(p, v.v, sizeof(v.v));
+	}
+	inline FloatX4 SetX4(float v)
+	{
+		FloatX4 ret = { { v, v, v, v } };
+		return ret;
+	}
+	inline FloatX4 SetX4(float x, float y, float z, float w)
+	{
+		FloatX4 ret = { { x, y, z, w } };
+		return ret;
+	}
+	inline FloatX4 AddX4(FloatX4 const & lhs, FloatX4 const & rhs)
+	{
+		FloatX4 ret = { { lhs.v[0] + rhs.v[0], lhs.v[1] + rhs.v[1], lhs.v[2] + rhs.v[2], lhs.v[3] + rhs.v[3] } };
+		return ret;
+	}
+	inline FloatX4 MulX4(FloatX4 const & lhs, FloatX4 const & rhs)
+	{
+		FloatX4 ret = { { lhs.v[0] * rhs.v[0], lhs.v[1] * rhs.v[1], lhs.v[2] * rhs.v[2], lhs.v[3] * rhs.v[3] } };
+		return ret;
+	}
+	inline FloatX4 MinX4(FloatX4 const & lhs, FloatX4 const & rhs)
+	{
+		FloatX4 ret = { { std::min(lhs.v[0], rhs.v[0]), std::min(lhs.v[1], rhs.v[1]),
+			std::min(lhs.v[2], rhs.v[2]), std::min(lhs.v[3], rhs.v[3]) } };
+		return ret;
+	}
+	inline FloatX4 MaxX4(FloatX4 const & lhs, FloatX4 const & rhs)
+	{
+		FloatX4 ret = { { std::max(lhs.v[0], rhs.v[0]), std::max(lhs.v[1], rhs.v[1]),
+			std::max(lhs.v[2], rhs.v[2]), std::max(lhs.v[3], rhs.v[3]) } };
+		return ret;
+	}
+	inline MaskX4 NonNegativeX4(FloatX4 const & v)
+	{
+		MaskX4 ret = { { v.v[0] >= 0, v.v[1] >= 0, v.v[2] >= 0, v.v[3] >= 0 } };
+		return ret;
+	}
+	inline MaskX4 AndX4(MaskX4 const & lhs, MaskX4 const & rhs)
+	{
+		MaskX4 ret = { { lhs.v[0] && rhs.v[0], lhs.v[1] && rhs.v[1], lhs.v[2] && rhs.v[2], lhs.v[3] && rhs.v[3] } };
+		return ret;
+	}
+	inline bool AnyX4(MaskX4 const & mask)
+	{
+		return mask.v[0] || mask.v[1] || mask.v[2] || mask.v[3];
+	}
+	inline FloatX4 SelectX4(MaskX4 const & mask, FloatX4 const & if_true, FloatX4 const & if_false)
+	{
+		FloatX4 ret;
+		for (int i = 0; i < 4; ++ i)
+		{
+			ret.v[i] = mask.v[i] ? if_true.v[i] : if_false.v[i];
+		}
+		return ret;
+	}
+	inline bool AnyGreaterEqualX4(FloatX4 const & lhs, FloatX4 const & rhs)
+	{
+		return (lhs.v[0] >= rhs.v[0]) || (lhs.v[1] >= rhs.v[1]) || (lhs.v[2] >= rhs.v[2]) || (lhs.v[3] >= rhs.v[3]);
+	}
+#endif
+
+	// Twice the signed screen space area of a, b, c. Positive for front faces, given the winding of BOX_FACES.
+	inline float Cross(float3 const & a, float3 const & b, float3 const & c)
+	{
+		return (b.x() - a.x()) * (c.y() - a.y()) - (b.y() - a.y()) * (c.x() - a.x());
+	}
+}
+
+namespace KlayGE
+{
+	OcclusionBuffer::OcclusionBuffer(uint32_t width, uint32_t height)
+		: width_((width + 3) & ~3U), height_(height),
+			view_proj_(float4x4::Identity()),
+			depth_(width_ * height_, 1.0f)
+	{
+	}
+
+	void OcclusionBuffer::BeginFrame(float4x4 const & view_proj)
+	{
+		view_proj_ = view_proj;
+		std::fill(depth_.begin(), depth_.end(), 1.0f);
+		occluders_.clear();
+	}
+
+	void OcclusionBuffer::AddOccluder(AABBox const & box, float4x4 const & model)
+	{
+		float4x4 const mvp = model * view_proj_;
+
+		float3 verts[8];
+		float max_z = 0;
+		for (int i = 0; i < 8; ++ i)
+		{
+			float3 const corner = box.Corner(i);
+			float4 const v = MathLib::transform(float4(corner.x(), corner.y(), corner.z(), 1), mvp);
+			if (v.w() < MIN_W)
+			{
+				return;
+			}
+
+			float const inv_w = 1 / v.w();
+			float const z = v.z() * inv_w;
+			if (z < 0)
+			{
+				return;
+			}
+
+			verts[i] = float3((v.x() * inv_w * 0.5f + 0.5f) * width_, (0.5f - v.y() * inv_w * 0.5f) * height_, z);
+			max_z = std::max(max_z, z);
+		}
+
+		Occluder occluder;
+
+		// After the projection, view rays are parallel to z, so the front surface of a convex solid is the max of
+		//  its front face planes. Each plane is pushed back by its largest change inside half a pixel.
+		bool const mirrored = MathLib::determinant(model) < 0;
+		occluder.num_planes = 0;
+		for (auto const & face : BOX_FACES)
+		{
+			float3 const & p0 = verts[face[0]];
+			float3 const & p1 = verts[face[1]];
+			float3 const & p2 = verts[face[2]];
+			float const area = Cross(p0, p1, p2) + Cross(p0, p2, verts[face[3]]);
+			if ((mirrored ? -area : area) > 1e-4f)
+			{
+				float const tri_area = Cross(p0, p1, p2);
+				if (std::abs(tri_area) > 1e-6f)
+				{
+					float const inv_area = 1 / tri_area;
+					float const dz_dx = ((p1.z() - p0.z()) * (p2.y() - p0.y()) - (p2.z() - p0.z()) * (p1.y() - p0.y()))
+						* inv_area;
+					float const dz_dy = ((p1.x() - p0.x()) * (p2.z() - p0.z()) - (p2.x() - p0.x()) * (p1.z() - p0.z()))
+						* inv_area;
+
+					uint32_t const index = occluder.num_planes;
+					occluder.dz_dx[index] = dz_dx;
+					occluder.dz_dy[index] = dz_dy;
+					occluder.z_c[index] = p0.z() - dz_dx * p0.x() - dz_dy * p0.y()
+						+ 0.5f * (std::abs(dz_dx) + std::abs(dz_dy));
+					++ occluder.num_planes;
+					if (occluder.num_planes == 3)
+					{
+						break;
+					}
+				}
+			}
+		}
+		if ((0 == occluder.num_planes) || (max_z <= 0))
+		{
+			return;
+		}
+		occluder.max_z = std::min(max_z, 1.0f);
+
+		// Convex hull by monotone chain, in the winding that keeps the inside on the positive side of the edges
+		float3 sorted[8];
+		std::copy(verts, verts + 8, sorted);
+		std::sort(sorted, sorted + 8,
+			[](float3 const & lhs, float3 const & rhs)
+			{
+				return (lhs.x() < rhs.x()) || ((lhs.x() == rhs.x()) && (lhs.y() < rhs.y()));
+			});
+		float3 hull[16];
+		uint32_t num_hull = 0;
+		for (int i = 0; i < 8; ++ i)
+		{
+			while ((num_hull >= 2) && (Cross(hull[num_hull - 2], hull[num_hull - 1], sorted[i]) <= 0))
+			{
+				-- num_hull;
+			}
+			hull[num_hull] = sorted[i];
+			++ num_hull;
+		}
+		for (int i = 6, lower = num_hull + 1; i >= 0; -- i)
+		{
+			while ((static_cast<int>(num_hull) >= lower) && (Cross(hull[num_hull - 2], hull[num_hull - 1], sorted[i]) <= 0))
+			{
+				-- num_hull;
+			}
+			hull[num_hull] = sorted[i];
+			++ num_hull;
+		}
+		-- num_hull;
+		if (num_hull < 3)
+		{
+			return;
+		}
+
+		float min_x = hull[0].x();
+		float max_x = min_x;
+		float min_y = hull[0].y();
+		float max_y = min_y;
+		for (uint32_t i = 1; i < num_hull; ++ i)
+		{
+			min_x = std::min(min_x, hull[i].x());
+			max_x = std::max(max_x, hull[i].x());
+			min_y = std::min(min_y, hull[i].y());
+			max_y = std::max(max_y, hull[i].y());
+		}
+		occluder.min_x = FloorPixel(min_x, width_);
+		occluder.max_x = CeilPixel(max_x, width_);
+		occluder.min_y = FloorPixel(min_y, height_);
+		occluder.max_y = CeilPixel(max_y, height_);
+		if ((occluder.min_x >= occluder.max_x) || (occluder.min_y >= occluder.max_y))
+		{
+			return;
+		}
+
+		// E(x, y) = a * x + b * y + c is positive inside. c is moved in by half a pixel's extent along the normal,
+		//  so a pixel passes only if it's fully covered, and an occluder never covers what it doesn't hide.
+		occluder.num_edges = std::min(num_hull, 8U);
+		for (uint32_t i = 0; i < occluder.num_edges; ++ i)
+		{
+			float3 const & a = hull[i];
+			float3 const & b = hull[(i + 1) % num_hull];
+			float const ea = a.y() - b.y();
+			float const eb = b.x() - a.x();
+			occluder.edge_a[i] = ea;
+			occluder.edge_b[i] = eb;
+			occluder.edge_c[i] = -(ea * a.x() + eb * a.y()) - 0.5f * (std::abs(ea) + std::abs(eb));
+		}
+
+		occluders_.push_back(occluder);
+	}
+
+	void OcclusionBuffer::Rasterize()
+	{
+		if (occluders_.empty())
+		{
+			return;
+		}
+
+		KLAYGE_PERF_ZONE("OcclusionBuffer::Rasterize");
+
+		uint32_t const num_bands = (height_ + ROWS_PER_BAND - 1) / ROWS_PER_BAND;
+
+		thread_pool& tp = Context::Instance().ThreadPool();
+		std::vector<joiner<void>> joiners;
+		joiners.reserve(num_bands);
+		for (uint32_t i = 1; i < num_bands; ++ i)
+		{
+			joiners.push_back(tp([this, i]
+				{
+					this->RasterizeRows(i * ROWS_PER_BAND, std::min((i + 1) * ROWS_PER_BAND, height_));
+				}));
+		}
+
+		this->RasterizeRows(0, std::min(ROWS_PER_BAND, height_));
+
+		for (auto& joiner : joiners)
+		{
+			joiner();
+		}
+	}
+
+	void OcclusionBuffer::RasterizeRows(uint32_t row_begin, uint32_t row_end)
+	{
+		FloatX4 edges[8];
+		FloatX4 edge_steps[8];
+		FloatX4 zs[3];
+		FloatX4 z_steps[3];
+
+		for (auto const & occluder : occluders_)
+		{
+			int32_t const y_begin = std::max(occluder.min_y, static_cast<int32_t>(row_begin));
+			int32_t const y_end = std::min(occluder.max_y, static_cast<int32_t>(row_end));
+			if (y_begin >= y_end)
+			{
+				continue;
+			}
+
+			int32_t const x_begin = occluder.min_x & ~3;
+			int32_t const x_end = occluder.max_x;
+
+			float const fx = x_begin + 0.5f;
+			FloatX4 const px = SetX4(fx, fx + 1, fx + 2, fx + 3);
+			FloatX4 const max_z = SetX4(occluder.max_z);
+
+			for (uint32_t i = 0; i < occluder.num_edges; ++ i)
+			{
+				edge_steps[i] = SetX4(occluder.edge_a[i] * 4);
+			}
+			for (uint32_t i = 0; i < occluder.num_planes; ++ i)
+			{
+				z_steps[i] = SetX4(occluder.dz_dx[i] * 4);
+			}
+
+			for (int32_t y = y_begin; y < y_end; ++ y)
+			{
+				float const fy = y + 0.5f;
+				for (uint32_t i = 0; i < occluder.num_edges; ++ i)
+				{
+					edges[i] = AddX4(MulX4(SetX4(occluder.edge_a[i]), px),
+						SetX4(occluder.edge_b[i] * fy + occluder.edge_c[i]));
+				}
+				for (uint32_t i = 0; i < occluder.num_planes; ++ i)
+				{
+					zs[i] = AddX4(MulX4(SetX4(occluder.dz_dx[i]), px), SetX4(occluder.dz_dy[i] * fy + occluder.z_c[i]));
+				}
+
+				float* row = &depth_[y * width_];
+				for (int32_t x = x_begin; x < x_end; x += 4)
+				{
+					MaskX4 inside = NonNegativeX4(edges[0]);
+					edges[0] = AddX4(edges[0], edge_steps[0]);
+					for (uint32_t i = 1; i < occluder.num_edges; ++ i)
+					{
+						inside = AndX4(inside, NonNegativeX4(edges[i]));
+						edges[i] = AddX4(edges[i], edge_steps[i]);
+					}
+
+					FloatX4 z = zs[0];
+					zs[0] = AddX4(zs[0], z_steps[0]);
+					for (uint32_t i = 1; i < occluder.num_planes; ++ i)
+					{
+						z = MaxX4(z, zs[i]);
+						zs[i] = AddX4(zs[i], z_steps[i]);
+					}
+
+					if (AnyX4(inside))
+					{
+						FloatX4 const d = LoadX4(row + x);
+						StoreX4(row + x, SelectX4(inside, MinX4(d, MinX4(z, max_z)), d));
+					}
+				}
+			}
+		}
+	}
+
+	bool OcclusionBuffer::Occluded(AABBox const & box_ws) const
+	{
+		if (occluders_.empty())
+		{
+			return false;
+		}
+
+		float min_x = 1e10f;
+		float max_x = -1e10f;
+		float min_y = 1e10f;
+		float max_y = -1e10f;
+		float min_z = 1e10f;
+		for (int i = 0; i < 8; ++ i)
+		{
+			float3 const corner = box_ws.Corner(i);
+			float4 const v = MathLib::transform(float4(corner.x(), corner.y(), corner.z(), 1), view_proj_);
+			if (v.w() < MIN_W)
+			{
+				return false;
+			}
+
+			float const inv_w = 1 / v.w();
+			float const x = (v.x() * inv_w * 0.5f + 0.5f) * width_;
+			float const y = (0.5f - v.y() * inv_w * 0.5f) * height_;
+			min_x = std::min(min_x, x);
+			max_x = std::max(max_x, x);
+			min_y = std::min(min_y, y);
+			max_y = std::max(max_y, y);
+			min_z = std::min(min_z, v.z() * inv_w);
+		}
+		if (min_z < 0)
+		{
+			return false;
+		}
+
+		int32_t const x_begin = FloorPixel(min_x, width_) & ~3;
+		int32_t const x_end = CeilPixel(max_x, width_);
+		int32_t const y_begin = FloorPixel(min_y, height_);
+		int32_t const y_end = CeilPixel(max_y, height_);
+		if ((x_begin >= x_end) || (y_begin >= y_end))
+		{
+			return false;
+		}
+
+		FloatX4 const z = SetX4(min_z);
+		for (int32_t y = y_begin; y < y_end; ++ y)
+		{
+			float const * row = &depth_[y * width_];
+			for (int32_t x = x_begin; x < x_end; x += 4)
+			{
+				if (AnyGreaterEqualX4(LoadX4(row + x), z))
+				{
+					return false;
+				}
+			}
+		}
+
+		return true;
+	}
+
+	TexturePtr const & OcclusionBuffer::DebugTexture()
+	{
+		if (!debug_tex_)
+		{
+			RenderFactory& rf = Context::Instance().RenderFactoryInstance();
+			debug_tex_ = rf.MakeTexture2D(width_, height_, 1, 1, EF_ABGR8, 1, 0, EAH_GPU_Read | EAH_CPU_Write, nullptr);
+		}
+
+		{
+			Texture::Mapper mapper(*debug_tex_, 0, 0, TMA_Write_Only, 0, 0, width_, height_);
+			uint8_t* dst = mapper.Pointer<uint8_t>();
+			for (uint32_t y = 0; y < height_; ++ y)
+			{
+				uint32_t* row = reinterpret_cast<uint32_t*>(dst + y * mapper.RowPitch());
+				float const * src = &depth_[y * width_];
+				for (uint32_t x = 0; x < width_; ++ x)
+				{
+					// Perspective depth crowds near 1, so the distance to the far plane is stretched before display
+					float const l = std::sqrt(MathLib::clamp(1 - src[x], 0.0f, 1.0f));
+					uint32_t const grey = static_cast<uint32_t>(l * 255 + 0.5f);
+					row[x] = 0xFF000000 | (grey << 16) | (grey << 8) | grey;
+				}
+			}
+		}
+
+		return debug_tex_;
+	}
+}
@@ -54,12 +54,24 @@
 #include <KlayGE/FrameBuffer.hpp>
 #include <KlayGE/DeferredRenderingLayer.hpp>
 #include <KFL/Hash.hpp>
+#include <KlayGE/PerfProfiler.hpp>
+#include <KlayGE/OcclusionBuffer.hpp>
 
 #include <map>
 #include <algorithm>
 
 #include <KlayGE/SceneManager.hpp>
 
+namespace
+{
+	// Cheap enough to rasterize every frame, fine enough for wall sized occluders
+	uint32_t const OCCLUSION_BUFFER_WIDTH = 256;
+	uint32_t const OCCLUSION_BUFFER_HEIGHT = 128;
+	// Fraction of the screen. Smaller occluders hide too little to pay for their rasterization.
+	float const MIN_OCCLUDER_AREA = 0.005f;
+	uint32_t const MAX_OCCLUDERS = 64;
+}
+
 namespace KlayGE
 {
 	// 캯
@@ -68,9 +80,10 @@ namespace KlayGE
 		: frustum_(nullptr),
 			small_obj_threshold_(0),
 			update_elapse_(1.0f / 60),
+			occlusion_culling_(false), occlusion_active_(false),
 			num_objects_rendered_(0), num_renderables_rendered_(0),
 			num_primitives_rendered_(0), num_vertices_rendered_(0),
-			num_draw_calls_(0), num_dispatch_calls_(0),
+			num_draw_calls_(0), num_dispatch_calls_(0), num_objects_occluded_(0),
 			quit_(false), deferred_mode_(false)
 	{
 	}
@@ -107,12 +120,32 @@ namespace KlayGE
 		update_elapse_ = elapse;
 	}
 
+	void SceneManager::OcclusionCulling(bool enable)
+	{
+		occlusion_culling_ = enable;
+	}
+
+	bool SceneManager::OcclusionCulling() const
+	{
+		return occlusion_culling_;
+	}
+
+	OcclusionBuffer& SceneManager::GetOcclusionBuffer()
+	{
+		if (!occlusion_buffer_)
+		{
+			occlusion_buffer_ = MakeUniquePtr<OcclusionBuffer>(OCCLUSION_BUFFER_WIDTH, OCCLUSION_BUFFER_HEIGHT);
+		}
+		return *occlusion_buffer_;
+	}
+
 	// ü
 	/////////////////////////////////////////////////////////////////////////////////
 	void SceneManager::ClipScene()
 	{
-		App3DFramework& app = Context::Instance().AppInstance();
-		Camera& camera = app.ActiveCamera();
+		// The camera of the current frame buffer, like App3DFramework::ActiveCamera, but without needing an application
+		RenderEngine& re = Context::Instance().RenderFactoryInstance().RenderEngineInstance();
+		Camera& camera = *re.CurFrameBuffer()->GetViewport()->camera;
 
 		float4x4 view_proj = camera.ViewProjMatrix();
 		auto drl = Context::Instance().DeferredRenderingLayerInstance();
@@ -125,6 +158,8 @@ namespace KlayGE
 			}
 		}
 
+		this->PrepareOcclusion(camera, view_proj);
+
 		for (auto const & obj : scene_objs_)
 		{
 			auto so = obj.get();
@@ -170,7 +205,7 @@ namespace KlayGE
 				visible = BO_No;
 			}
 
-			so->VisibleMark(visible);
+			so->VisibleMark(this->OcclusionTest(*so, visible));
 		}
 	}
 
@@ -248,9 +283,14 @@ namespace KlayGE
 
 	void SceneManager::AddSceneObjectLocked(SceneObjectPtr const & obj)
 	{
-		App3DFramework& app = Context::Instance().AppInstance();
-		float const app_time = app.AppTime();
-		float const frame_time = app.FrameTime();
+		float app_time = 0;
+		float frame_time = 0;
+		if (Context::Instance().AppValid())
+		{
+			App3DFramework& app = Context::Instance().AppInstance();
+			app_time = app.AppTime();
+			frame_time = app.FrameTime();
+		}
 		obj->MainThreadUpdate(app_time, frame_time);
 
 		uint32_t const attr = obj->Attrib();
@@ -459,6 +499,8 @@ namespace KlayGE
 	/////////////////////////////////////////////////////////////////////////////////
 	void SceneManager::Update()
 	{
+		KLAYGE_PERF_ZONE("SceneManager::Update");
+
 		deferred_mode_ = !!Context::Instance().DeferredRenderingLayerInstance();
 
 		App3DFramework& app = Context::Instance().AppInstance();
@@ -536,6 +578,8 @@ namespace KlayGE
 	/////////////////////////////////////////////////////////////////////////////////
 	void SceneManager::Flush(uint32_t urt)
 	{
+		KLAYGE_PERF_ZONE("SceneManager::Flush");
+
 		std::lock_guard<std::mutex> lock(update_mutex_);
 
 		urt_ = urt;
@@ -735,11 +779,17 @@ namespace KlayGE
 		return num_dispatch_calls_;
 	}
 
+	uint32_t SceneManager::NumObjectsOccluded() const
+	{
+		return num_objects_occluded_;
+	}
+
 	void SceneManager::FlushScene()
 	{
 		RenderEngine& re = Context::Instance().RenderFactoryInstance().RenderEngineInstance();
 
 		visible_marks_map_.clear();
+		num_objects_occluded_ = 0;
 
 		uint32_t urt;
 		App3DFramework& app = Context::Instance().AppInstance();
@@ -779,6 +829,10 @@ namespace KlayGE
 
 	void SceneManager::UpdateThreadFunc()
 	{
+#ifndef KLAYGE_SHIP
+		PerfProfiler::Instance().ThreadName("Update");
+#endif
+
 		Timer timer;
 		float app_time = 0;
 		while (!quit_)
@@ -790,18 +844,43 @@ namespace KlayGE
 			if (Context::Instance().AppValid())
 			{
 				WindowPtr const & win = Context::Instance().AppInstance().MainWnd();
-				if (win && win->Active())
+				if (!win || win->Active())
 				{
 					std::lock_guard<std::mutex> lock(update_mutex_);
+					KLAYGE_PERF_ZONE("SceneManager::UpdateThreadFunc");
 
+					// Independent objects are updated on the thread pool, while the rest are updated here in order
+					thread_pool& tp = Context::Instance().ThreadPool();
+					parallel_update_joiners_.clear();
 					for (auto const & scene_obj : scene_objs_)
 					{
-						scene_obj->SubThreadUpdate(app_time, frame_time);
+						if (scene_obj->Attrib() & SceneObject::SOA_ParallelUpdate)
+						{
+							SceneObject* so = scene_obj.get();
+							parallel_update_joiners_.push_back(tp([so, app_time, frame_time]
+								{
+									KLAYGE_PERF_ZONE("SceneObject::SubThreadUpdate");
+									so->SubThreadUpdate(app_time, frame_time);
+								}));
+						}
+					}
+
+					for (auto const & scene_obj : scene_objs_)
+					{
+						if (!(scene_obj->Attrib() & SceneObject::SOA_ParallelUpdate))
+						{
+							scene_obj->SubThreadUpdate(app_time, frame_time);
+						}
 					}
 					for (auto const & scene_obj : overlay_scene_objs_)
 					{
 						scene_obj->SubThreadUpdate(app_time, frame_time);
 					}
+
+					for (auto& joiner : parallel_update_joiners_)
+					{
+						joiner();
+					}
 				}
 
 				if (frame_time < update_elapse_)
@@ -857,4 +936,69 @@ namespace KlayGE
 
 		return visible;
 	}
+
+	void SceneManager::PrepareOcclusion(Camera const & camera, float4x4 const & view_proj)
+	{
+		occlusion_active_ = occlusion_culling_ && !camera.OmniDirectionalMode();
+		if (!occlusion_active_)
+		{
+			return;
+		}
+
+		KLAYGE_PERF_ZONE("SceneManager::PrepareOcclusion");
+
+		OcclusionBuffer& ob = this->GetOcclusionBuffer();
+		ob.BeginFrame(view_proj);
+
+		std::vector<std::pair<float, SceneObject*>> occluders;
+		for (auto const & obj : scene_objs_)
+		{
+			auto so = obj.get();
+			uint32_t const attr = so->Attrib();
+			if ((attr & SceneObject::SOA_Occluder) && so->Visible() && so->GetRenderable())
+			{
+				if (attr & SceneObject::SOA_Moveable)
+				{
+					so->UpdateAbsModelMatrix();
+				}
+
+				AABBox const & aabb_ws = so->PosBoundWS();
+				if (this->AABBVisible(aabb_ws) != BO_No)
+				{
+					float const area = MathLib::perspective_area(camera.EyePos(), view_proj, aabb_ws);
+					if (area > MIN_OCCLUDER_AREA)
+					{
+						occluders.emplace_back(area, so);
+					}
+				}
+			}
+		}
+
+		if (occluders.size() > MAX_OCCLUDERS)
+		{
+			std::nth_element(occluders.begin(), occluders.begin() + MAX_OCCLUDERS, occluders.end(),
+				[](std::pair<float, SceneObject*> const & lhs, std::pair<float, SceneObject*> const & rhs)
+				{
+					return lhs.first > rhs.first;
+				});
+			occluders.resize(MAX_OCCLUDERS);
+		}
+
+		for (auto const & occluder : occluders)
+		{
+			ob.AddOccluder(occluder.second->GetRenderable()->PosBound(), occluder.second->AbsModelMatrix());
+		}
+		ob.Rasterize();
+	}
+
+	BoundOverlap SceneManager::OcclusionTest(SceneObject const & obj, BoundOverlap visible)
+	{
+		if (occlusion_active_ && (visible != BO_No) && (obj.Attrib() & SceneObject::SOA_Cullable)
+			&& occlusion_buffer_->Occluded(obj.PosBoundWS()))
+		{
+			++ num_objects_occluded_;
+			return BO_No;
+		}
+		return visible;
+	}
 }
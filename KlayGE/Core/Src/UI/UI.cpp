@@ -30,7 +30,9 @@
 #include <KFL/XMLDom.hpp>
 #include <KlayGE/Font.hpp>
 #include <KFL/Thread.hpp>
-#include <KlayGE/TransientBuffer.hpp>
+#include <KlayGE/GraphicsBuffer.hpp>
+#include <KlayGE/RenderLayout.hpp>
+#include <KlayGE/Texture.hpp>
 #include <KFL/Hash.hpp>
 
 #ifdef Bool
@@ -39,6 +41,8 @@
 
 #include <cstring>
 #include <fstream>
+#include <map>
+#include <memory>
 
 #include <KlayGE/UI.hpp>
 
@@ -76,6 +80,11 @@ namespace
 		Click,
 		Touch
 	};
+
+	// 16-bit indices of UI quads are relative to the first vertex of a draw
+	uint32_t const UI_MAX_QUADS_PER_DRAW = 0x10000 / 4;
+	uint32_t const UI_ATLAS_SIZE = 2048;
+	uint32_t const UI_ATLAS_MAX_ITEM_SIZE = 512;
 }
 
 namespace KlayGE
@@ -83,165 +92,498 @@ namespace KlayGE
 	std::unique_ptr<UIManager> UIManager::ui_mgr_instance_;
 
 
-	class UIRectRenderable : public RenderableHelper
+	// Retained batcher of all the UI quads. Quads are recorded per dialog and compared with the ones of the last
+	//  frame, so the vertex buffer is only rewritten when something on screen changed. Small static textures are
+	//  copied into an atlas, so a frame usually takes one draw for the textured quads and one for the untextured.
+	class UIBatchRenderable : public RenderableHelper
 	{
+		struct AtlasEntry
+		{
+			bool atlased;
+			uint32_t x, y;
+			// Maps a texcoord of the texture into the atlas, xy is the scale and zw is the offset
+			float4 uv_scale_offset;
+		};
+
+		// Quads of a dialog, grouped by texture in the order of first use
+		struct Segment
+		{
+			void const * owner;
+			std::vector<TexturePtr> textures;
+			std::vector<std::vector<UIManager::VertexFormat>> vertices;
+		};
+
+		struct Draw
+		{
+			TexturePtr texture;
+			uint32_t first_vertex;
+			uint32_t num_quads;
+		};
+
 	public:
-		UIRectRenderable(TexturePtr const & texture, RenderEffectPtr const & effect)
-			: RenderableHelper(L"UIRect"),
-				texture_(texture)
+		explicit UIBatchRenderable(RenderEffectPtr const & effect)
+			: RenderableHelper(L"UIBatch"),
+				recording_(false), num_segments_(0), changed_(false),
+				vb_size_(0),
+				atlas_pending_(false), atlas_holes_(false), atlas_x_(0), atlas_y_(0), atlas_shelf_height_(0)
 		{
 			RenderFactory& rf = Context::Instance().RenderFactoryInstance();
 
-			restart_ = rf.RenderEngineInstance().DeviceCaps().primitive_restart_support;
-
 			rl_ = rf.MakeRenderLayout();
-			if (restart_)
-			{
-				rl_->TopologyType(RenderLayout::TT_TriangleStrip);
-			}
-			else
+			rl_->TopologyType(RenderLayout::TT_TriangleList);
+
+			std::vector<uint16_t> indices(UI_MAX_QUADS_PER_DRAW * 6);
+			for (uint32_t i = 0; i < UI_MAX_QUADS_PER_DRAW; ++ i)
 			{
-				rl_->TopologyType(RenderLayout::TT_TriangleList);
+				uint16_t const base = static_cast<uint16_t>(i * 4);
+				indices[i * 6 + 0] = base + 0;
+				indices[i * 6 + 1] = base + 1;
+				indices[i * 6 + 2] = base + 2;
+				indices[i * 6 + 3] = base + 2;
+				indices[i * 6 + 4] = base + 3;
+				indices[i * 6 + 5] = base + 0;
 			}
+			GraphicsBufferPtr ib = rf.MakeIndexBuffer(BU_Static, EAH_GPU_Read | EAH_Immutable,
+				static_cast<uint32_t>(indices.size() * sizeof(indices[0])), &indices[0]);
+			rl_->BindIndexStream(ib, EF_R16UI);
 
-			uint32_t const INDEX_PER_QUAD = restart_ ? 5 : 6;
-			uint32_t const INIT_NUM_QUAD = 1024;
-			tb_vb_ = MakeUniquePtr<TransientBuffer>(static_cast<uint32_t>(INIT_NUM_QUAD * 4 * sizeof(UIManager::VertexFormat)), TransientBuffer::BF_Vertex);
-			tb_ib_ = MakeUniquePtr<TransientBuffer>(static_cast<uint32_t>(INIT_NUM_QUAD * INDEX_PER_QUAD * sizeof(uint16_t)), TransientBuffer::BF_Index);
+			effect_ = effect;
+			technique_ = effect->TechniqueByName("UITec");
+			no_tex_technique_ = effect->TechniqueByName("UITecNoTex");
+
+			ui_tex_ep_ = effect->ParameterByName("ui_tex");
+			half_width_height_ep_ = effect->ParameterByName("half_width_height");
+		}
 
-			rl_->BindVertexStream(tb_vb_->GetBuffer(), std::make_tuple(vertex_element(VEU_Position, 0, EF_BGR32F),
-												vertex_element(VEU_Diffuse, 0, EF_ABGR32F),
-												vertex_element(VEU_TextureCoord, 0, EF_GR32F)));
-			rl_->BindIndexStream(tb_ib_->GetBuffer(), EF_R16UI);
+		bool Empty() const
+		{
+			return draws_.empty();
+		}
 
-			effect_ = effect;
-			if (texture)
+		void BeginFrame()
+		{
+			num_segments_ = 0;
+			changed_ = false;
+			this->BeginSegment(nullptr);
+		}
+
+		// Quads added from now on belong to owner, until the next BeginSegment or EndFrame
+		void BeginSegment(void const * owner)
+		{
+			this->EndSegment();
+
+			recording_ = true;
+			scratch_.owner = owner;
+			scratch_.textures.clear();
+			for (auto& vertices : scratch_.vertices)
 			{
-				technique_ = effect->TechniqueByName("UITec");
+				vertices.clear();
 			}
-			else
+		}
+
+		void EndFrame()
+		{
+			this->EndSegment();
+
+			if (num_segments_ != segments_.size())
 			{
-				technique_ = effect->TechniqueByName("UITecNoTex");
+				segments_.resize(num_segments_);
+				changed_ = true;
 			}
 
-			ui_tex_ep_ = effect->ParameterByName("ui_tex");
-			half_width_height_ep_ = effect->ParameterByName("half_width_height");
+			// Textures that weren't ready last time are tried again
+			if (changed_ || atlas_pending_)
+			{
+				this->UpdateDraws();
+			}
 		}
 
-		bool Empty() const
+		// vertices are in screen space, and texcoords are in texture. They're moved into the atlas in UpdateDraws.
+		void AddQuad(TexturePtr const & texture, UIManager::VertexFormat const * vertices)
 		{
-			return tb_ib_sub_allocs_.empty();
+			if (!recording_)
+			{
+				this->BeginSegment(nullptr);
+			}
+
+			size_t index = 0;
+			while ((index < scratch_.textures.size()) && (scratch_.textures[index] != texture))
+			{
+				++ index;
+			}
+			if (index == scratch_.textures.size())
+			{
+				scratch_.textures.push_back(texture);
+				if (scratch_.vertices.size() < scratch_.textures.size())
+				{
+					scratch_.vertices.resize(scratch_.textures.size());
+				}
+			}
+
+			scratch_.vertices[index].insert(scratch_.vertices[index].end(), vertices, vertices + 4);
 		}
 
 		void OnRenderBegin()
 		{
-			RenderFactory& rf = Context::Instance().RenderFactoryInstance();
-
-			*ui_tex_ep_ = texture_;
-
-			RenderEngine& re = rf.RenderEngineInstance();
+			RenderEngine& re = Context::Instance().RenderFactoryInstance().RenderEngineInstance();
 			float const half_width = re.CurFrameBuffer()->Width() / 2.0f;
 			float const half_height = re.CurFrameBuffer()->Height() / 2.0f;
 
 			*half_width_height_ep_ = float2(half_width, half_height);
+		}
+
+		void Render()
+		{
+			RenderEngine& re = Context::Instance().RenderFactoryInstance().RenderEngineInstance();
+
+			this->OnRenderBegin();
+
+			for (auto const & draw : draws_)
+			{
+				*ui_tex_ep_ = draw.texture;
+				RenderTechnique const & tech = draw.texture ? *technique_ : *no_tex_technique_;
 
-			tb_vb_->EnsureDataReady();
-			tb_ib_->EnsureDataReady();
+				for (uint32_t quad = 0; quad < draw.num_quads; quad += UI_MAX_QUADS_PER_DRAW)
+				{
+					uint32_t const num_quads = std::min(draw.num_quads - quad, UI_MAX_QUADS_PER_DRAW);
+					rl_->StartVertexLocation(draw.first_vertex + quad * 4);
+					rl_->NumVertices(num_quads * 4);
+					rl_->StartIndexLocation(0);
+					rl_->NumIndices(num_quads * 6);
+
+					re.Render(*effect_, tech, *rl_);
+				}
+			}
 
-			rl_->SetVertexStream(0, tb_vb_->GetBuffer());
-			rl_->BindIndexStream(tb_ib_->GetBuffer(), EF_R16UI);
+			this->OnRenderEnd();
 		}
-		
-		void OnRenderEnd()
+
+	private:
+		void EndSegment()
 		{
-			tb_vb_->OnPresent();
-			tb_ib_->OnPresent();
+			if (!recording_)
+			{
+				return;
+			}
+			recording_ = false;
+
+			if (scratch_.textures.empty())
+			{
+				return;
+			}
 
-			tb_vb_sub_allocs_.clear();
-			tb_ib_sub_allocs_.clear();
+			if (num_segments_ == segments_.size())
+			{
+				segments_.emplace_back();
+				segments_.back().owner = nullptr;
+			}
+
+			Segment& seg = segments_[num_segments_];
+			++ num_segments_;
+
+			bool same = (seg.owner == scratch_.owner) && (seg.textures == scratch_.textures);
+			for (size_t i = 0; same && (i < scratch_.textures.size()); ++ i)
+			{
+				auto const & lhs = seg.vertices[i];
+				auto const & rhs = scratch_.vertices[i];
+				same = (lhs.size() == rhs.size())
+					&& (0 == std::memcmp(&lhs[0], &rhs[0], lhs.size() * sizeof(lhs[0])));
+			}
+
+			if (!same)
+			{
+				// The old content goes to scratch_ to be cleared, so the capacities are kept around
+				std::swap(seg, scratch_);
+				changed_ = true;
+			}
 		}
 
-		void Render()
+		void UpdateDraws()
 		{
-			RenderEngine& re = Context::Instance().RenderFactoryInstance().RenderEngineInstance();
+			draws_.clear();
+			vertices_.clear();
 
-			this->OnRenderBegin();
+			std::vector<TexturePtr> textures;
+			for (auto const & seg : segments_)
+			{
+				for (auto const & tex : seg.textures)
+				{
+					if (std::find(textures.begin(), textures.end(), tex) == textures.end())
+					{
+						textures.push_back(tex);
+					}
+				}
+			}
 
-			BOOST_ASSERT(tb_vb_sub_allocs_.size() == tb_ib_sub_allocs_.size());
+			// All the textures are placed before any texcoord is moved, since making room in the atlas can move the
+			//  textures already in it
+			this->ReleaseStaleAtlasEntries();
+			atlas_pending_ = false;
+			for (auto const & tex : textures)
+			{
+				if (tex)
+				{
+					this->AtlasTexture(tex);
+				}
+			}
 
-			for (size_t i = 0; i < tb_vb_sub_allocs_.size(); ++ i)
+			std::vector<TexturePtr> draw_textures;
+			for (auto const & tex : textures)
 			{
-				uint32_t vert_length = tb_vb_sub_allocs_[i].length_;
-				uint32_t const ind_offset = tb_ib_sub_allocs_[i].offset_;
-				uint32_t ind_length = tb_ib_sub_allocs_[i].length_;
+				TexturePtr const & draw_tex = this->DrawTexture(tex);
+				if (std::find(draw_textures.begin(), draw_textures.end(), draw_tex) == draw_textures.end())
+				{
+					draw_textures.push_back(draw_tex);
+				}
+			}
 
-				while ((i + 1 < tb_vb_sub_allocs_.size())
-					&& (tb_vb_sub_allocs_[i].offset_ + tb_vb_sub_allocs_[i].length_ == tb_vb_sub_allocs_[i + 1].offset_)
-					&& (tb_ib_sub_allocs_[i].offset_ + tb_ib_sub_allocs_[i].length_ == tb_ib_sub_allocs_[i + 1].offset_))
+			for (auto const & draw_tex : draw_textures)
+			{
+				Draw draw;
+				draw.texture = draw_tex;
+				draw.first_vertex = static_cast<uint32_t>(vertices_.size());
+				for (auto const & seg : segments_)
 				{
-					vert_length += tb_vb_sub_allocs_[i + 1].length_;
-					ind_length += tb_ib_sub_allocs_[i + 1].length_;
-					++ i;
+					for (size_t i = 0; i < seg.textures.size(); ++ i)
+					{
+						TexturePtr const & tex = seg.textures[i];
+						if (this->DrawTexture(tex) == draw_tex)
+						{
+							size_t const first = vertices_.size();
+							vertices_.insert(vertices_.end(), seg.vertices[i].begin(), seg.vertices[i].end());
+							if (tex && (draw_tex != tex))
+							{
+								float4 const & uv_scale_offset = this->AtlasTexture(tex).uv_scale_offset;
+								for (size_t v = first; v < vertices_.size(); ++ v)
+								{
+									float2& uv = vertices_[v].tex;
+									uv = float2(uv.x() * uv_scale_offset.x() + uv_scale_offset.z(),
+										uv.y() * uv_scale_offset.y() + uv_scale_offset.w());
+								}
+							}
+						}
+					}
 				}
+				draw.num_quads = (static_cast<uint32_t>(vertices_.size()) - draw.first_vertex) / 4;
+				draws_.push_back(draw);
+			}
 
-				rl_->NumVertices(vert_length / sizeof(UIManager::VertexFormat));
-				rl_->StartIndexLocation(ind_offset / sizeof(uint16_t));
-				rl_->NumIndices(ind_length / sizeof(uint16_t));
+			if (vertices_.empty())
+			{
+				return;
+			}
 
-				re.Render(*this->GetRenderEffect(), *this->GetRenderTechnique(), *rl_);
+			uint32_t const size = static_cast<uint32_t>(vertices_.size() * sizeof(vertices_[0]));
+			if (size > vb_size_)
+			{
+				vb_size_ = std::max(size, vb_size_ * 2);
+
+				RenderFactory& rf = Context::Instance().RenderFactoryInstance();
+				vb_ = rf.MakeVertexBuffer(BU_Dynamic, EAH_CPU_Write | EAH_GPU_Read, vb_size_, nullptr);
+				if (0 == rl_->NumVertexStreams())
+				{
+					rl_->BindVertexStream(vb_, std::make_tuple(vertex_element(VEU_Position, 0, EF_BGR32F),
+						vertex_element(VEU_Diffuse, 0, EF_ABGR32F),
+						vertex_element(VEU_TextureCoord, 0, EF_GR32F)));
+				}
+				else
+				{
+					rl_->SetVertexStream(0, vb_);
+				}
 			}
 
-			for (size_t i = 0; i < tb_vb_sub_allocs_.size(); ++ i)
+			GraphicsBuffer::Mapper mapper(*vb_, BA_Write_Only);
+			std::memcpy(mapper.Pointer<void>(), &vertices_[0], size);
+		}
+
+		// The texture a quad is drawn with, the atlas if the texture is in it
+		TexturePtr const & DrawTexture(TexturePtr const & texture)
+		{
+			if (texture && this->AtlasTexture(texture).atlased)
 			{
-				tb_vb_->Dealloc(tb_vb_sub_allocs_[i]);
-				tb_ib_->Dealloc(tb_ib_sub_allocs_[i]);
+				return atlas_tex_;
 			}
+			return texture;
+		}
 
-			this->OnRenderEnd();
+		// Entries hold weak references, so a texture released by the UI is released for real. Its region stays
+		//  a hole until the atlas is repacked.
+		void ReleaseStaleAtlasEntries()
+		{
+			for (auto iter = atlas_entries_.begin(); iter != atlas_entries_.end();)
+			{
+				if (iter->first.expired())
+				{
+					atlas_holes_ |= iter->second.atlased;
+					iter = atlas_entries_.erase(iter);
+				}
+				else
+				{
+					++ iter;
+				}
+			}
 		}
 
-		void AddQuad(std::vector<UIManager::VertexFormat> const & vertices)
+		AtlasEntry const & AtlasTexture(TexturePtr const & texture)
 		{
-			tb_vb_sub_allocs_.push_back(tb_vb_->Alloc(static_cast<uint32_t>(vertices.size() * sizeof(vertices[0])), &vertices[0]));
-			
-			uint16_t const last_index = static_cast<uint16_t>(tb_vb_sub_allocs_.back().offset_ / sizeof(UIManager::VertexFormat));
-			std::vector<uint16_t> indices;
-			indices.resize(restart_ ? 5 : 6);
-			indices[0] = last_index + 0;
-			indices[1] = last_index + 1;
-			if (restart_)
+			auto iter = atlas_entries_.find(texture);
+			if (iter != atlas_entries_.end())
 			{
-				indices[2] = last_index + 3;
-				indices[3] = last_index + 2;
-				indices[4] = 0xFFFF;
+				return iter->second;
 			}
-			else
+
+			static AtlasEntry const not_atlased = { false, 0, 0, float4(1, 1, 0, 0) };
+
+			// Decided once the content is there
+			if (!texture->HWResourceReady())
+			{
+				atlas_pending_ = true;
+				return not_atlased;
+			}
+
+			AtlasEntry entry = not_atlased;
+
+			uint32_t const width = texture->Width(0);
+			uint32_t const height = texture->Height(0);
+			ElementFormat const fmt = texture->Format();
+
+			// Render targets and CPU updated textures change after they're copied, so they stay on their own
+			bool fits = (Texture::TT_2D == texture->Type()) && (1 == texture->NumMipMaps()) && (1 == texture->ArraySize())
+				&& !(texture->AccessHint() & (EAH_CPU_Write | EAH_GPU_Write))
+				&& (width <= UI_ATLAS_MAX_ITEM_SIZE) && (height <= UI_ATLAS_MAX_ITEM_SIZE)
+				&& ((EF_ABGR8 == fmt) || (EF_ARGB8 == fmt));
+			if (fits && !atlas_tex_)
+			{
+				RenderFactory& rf = Context::Instance().RenderFactoryInstance();
+				atlas_tex_ = rf.MakeTexture2D(UI_ATLAS_SIZE, UI_ATLAS_SIZE, 1, 1, fmt, 1, 0,
+					EAH_GPU_Read | EAH_GPU_Write, nullptr);
+			}
+			fits = fits && (atlas_tex_->Format() == fmt);
+
+			if (fits)
 			{
-				indices[2] = last_index + 2;
-				indices[3] = last_index + 2;
-				indices[4] = last_index + 3;
-				indices[5] = last_index + 0;
+				if (!this->PlaceInAtlas(*texture, entry) && this->RepackAtlas())
+				{
+					this->PlaceInAtlas(*texture, entry);
+				}
 			}
-			BOOST_ASSERT(last_index + 3 <= 0xFFFF);
 
-			tb_ib_sub_allocs_.push_back(tb_ib_->Alloc(static_cast<uint32_t>(indices.size() * sizeof(indices[0])), &indices[0]));
+			return atlas_entries_.emplace(texture, entry).first->second;
 		}
 
-	private:
-		bool restart_;
+		// Shelf packing. Each texture gets a border of 1 texel copied from its edges, so sampling at the borders
+		//  behaves like clamp addressing.
+		bool PlaceInAtlas(Texture& texture, AtlasEntry& entry)
+		{
+			uint32_t const width = texture.Width(0);
+			uint32_t const height = texture.Height(0);
+			uint32_t const item_width = width + 2;
+			uint32_t const item_height = height + 2;
+			if (atlas_x_ + item_width > UI_ATLAS_SIZE)
+			{
+				atlas_x_ = 0;
+				atlas_y_ += atlas_shelf_height_;
+				atlas_shelf_height_ = 0;
+			}
+			if (atlas_y_ + item_height > UI_ATLAS_SIZE)
+			{
+				entry = { false, 0, 0, float4(1, 1, 0, 0) };
+				return false;
+			}
+
+			uint32_t const x = atlas_x_ + 1;
+			uint32_t const y = atlas_y_ + 1;
+			auto copy = [this, &texture](uint32_t src_x, uint32_t src_y, uint32_t w, uint32_t h,
+				uint32_t dst_x, uint32_t dst_y)
+			{
+				texture.CopyToSubTexture2D(*atlas_tex_, 0, 0, dst_x, dst_y, w, h, 0, 0, src_x, src_y, w, h);
+			};
+			copy(0, 0, width, height, x, y);
+			copy(0, 0, 1, height, x - 1, y);
+			copy(width - 1, 0, 1, height, x + width, y);
+			copy(0, 0, width, 1, x, y - 1);
+			copy(0, height - 1, width, 1, x, y + height);
+			copy(0, 0, 1, 1, x - 1, y - 1);
+			copy(width - 1, 0, 1, 1, x + width, y - 1);
+			copy(0, height - 1, 1, 1, x - 1, y + height);
+			copy(width - 1, height - 1, 1, 1, x + width, y + height);
+
+			atlas_x_ += item_width;
+			atlas_shelf_height_ = std::max(atlas_shelf_height_, item_height);
+
+			float const inv_size = 1.0f / UI_ATLAS_SIZE;
+			entry.atlased = true;
+			entry.x = x;
+			entry.y = y;
+			entry.uv_scale_offset = float4(width * inv_size, height * inv_size, x * inv_size, y * inv_size);
+			return true;
+		}
+
+		// Packs the live textures again from the top left, closing the holes left by released ones. Returns false
+		//  if there were no holes to close.
+		bool RepackAtlas()
+		{
+			this->ReleaseStaleAtlasEntries();
+			if (!atlas_holes_)
+			{
+				return false;
+			}
+			atlas_holes_ = false;
 
+			// In the order they were placed, so the layout stays as tight as it was
+			std::vector<std::pair<std::shared_ptr<Texture>, AtlasEntry*>> live;
+			for (auto& item : atlas_entries_)
+			{
+				if (item.second.atlased)
+				{
+					live.emplace_back(item.first.lock(), &item.second);
+				}
+			}
+			std::sort(live.begin(), live.end(),
+				[](std::pair<std::shared_ptr<Texture>, AtlasEntry*> const & lhs,
+					std::pair<std::shared_ptr<Texture>, AtlasEntry*> const & rhs)
+				{
+					AtlasEntry const & l = *lhs.second;
+					AtlasEntry const & r = *rhs.second;
+					return (l.y < r.y) || ((l.y == r.y) && (l.x < r.x));
+				});
+
+			atlas_x_ = 0;
+			atlas_y_ = 0;
+			atlas_shelf_height_ = 0;
+			for (auto& item : live)
+			{
+				// A texture that doesn't fit any more is drawn on its own
+				this->PlaceInAtlas(*item.first, *item.second);
+			}
+			return true;
+		}
+
+	private:
+		RenderTechnique* no_tex_technique_;
 		RenderEffectParameter* ui_tex_ep_;
 		RenderEffectParameter* half_width_height_ep_;
 
-		TexturePtr texture_;
-
-		std::unique_ptr<TransientBuffer> tb_vb_;
-		std::unique_ptr<TransientBuffer> tb_ib_;
-		std::vector<SubAlloc> tb_vb_sub_allocs_;
-		std::vector<SubAlloc> tb_ib_sub_allocs_;
+		bool recording_;
+		Segment scratch_;
+		std::vector<Segment> segments_;
+		size_t num_segments_;
+		bool changed_;
+
+		std::vector<UIManager::VertexFormat> vertices_;
+		std::vector<Draw> draws_;
+		GraphicsBufferPtr vb_;
+		uint32_t vb_size_;
+
+		TexturePtr atlas_tex_;
+		std::map<std::weak_ptr<Texture>, AtlasEntry, std::owner_less<std::weak_ptr<Texture>>> atlas_entries_;
+		bool atlas_pending_;
+		bool atlas_holes_;
+		uint32_t atlas_x_;
+		uint32_t atlas_y_;
+		uint32_t atlas_shelf_height_;
 	};
 
-
 	void UIStatesColor::Init(Color const & default_color,
 			Color const & disabled_color,
 			Color const & hidden_color)
@@ -335,6 +677,8 @@ namespace KlayGE
 	void UIManager::Init()
 	{
 		effect_ = SyncLoadRenderEffect("UI.fxml");
+		ui_batch_ = MakeSharedPtr<UIBatchRenderable>(effect_);
+		ui_batch_obj_ = MakeSharedPtr<SceneObjectHelper>(ui_batch_, SceneObject::SOA_Overlay);
 
 		elem_texture_rcs_[UICT_Button].push_back(IRect(0, 0, 136, 54));
 		elem_texture_rcs_[UICT_Button].push_back(IRect(136, 0, 252, 54));
@@ -927,18 +1271,20 @@ namespace KlayGE
 			str.second.clear();
 		}
 
-		for (auto const & dialog : dialogs_)
+		if (ui_batch_)
 		{
-			dialog->Render();
-		}
+			auto& batch = *checked_pointer_cast<UIBatchRenderable>(ui_batch_);
+			batch.BeginFrame();
+			for (auto const & dialog : dialogs_)
+			{
+				batch.BeginSegment(dialog.get());
+				dialog->Render();
+			}
+			batch.EndFrame();
 
-		for (auto const & rect : rects_)
-		{
-			if (!checked_pointer_cast<UIRectRenderable>(rect.second)->Empty())
+			if (!batch.Empty())
 			{
-				SceneObjectHelperPtr ui_rect_obj
-					= MakeSharedPtr<SceneObjectHelper>(rect.second, SceneObject::SOA_Overlay);
-				ui_rect_obj->AddToSceneManager();
+				checked_pointer_cast<SceneObjectHelper>(ui_batch_obj_)->AddToSceneManager();
 			}
 		}
 		for (auto const & str : strings_)
@@ -967,56 +1313,28 @@ namespace KlayGE
 			texcoord = Rect(0, 0, 0, 0);
 		}
 
-		std::shared_ptr<UIRectRenderable> renderable;
-		if (rects_.find(texture) == rects_.end())
+		VertexFormat const vertices[] =
 		{
-			renderable = MakeSharedPtr<UIRectRenderable>(texture, effect_);
-			rects_[texture] = renderable;
-		}
-		else
-		{
-			renderable = checked_pointer_cast<UIRectRenderable>(rects_[texture]);
-		}
-		BOOST_ASSERT(renderable);
-
-		std::vector<VertexFormat> vertices(4);
-		vertices[0] = VertexFormat(pos + float3(0, 0, 0),
-			clrs[0], float2(texcoord.left(), texcoord.top()));
-		vertices[1] = VertexFormat(pos + float3(width, 0, 0),
-			clrs[1], float2(texcoord.right(), texcoord.top()));
-		vertices[2] = VertexFormat(pos + float3(width, height, 0),
-			clrs[2], float2(texcoord.right(), texcoord.bottom()));
-		vertices[3] = VertexFormat(pos + float3(0, height, 0),
-			clrs[3], float2(texcoord.left(), texcoord.bottom()));
+			VertexFormat(pos + float3(0, 0, 0), clrs[0], float2(texcoord.left(), texcoord.top())),
+			VertexFormat(pos + float3(width, 0, 0), clrs[1], float2(texcoord.right(), texcoord.top())),
+			VertexFormat(pos + float3(width, height, 0), clrs[2], float2(texcoord.right(), texcoord.bottom())),
+			VertexFormat(pos + float3(0, height, 0), clrs[3], float2(texcoord.left(), texcoord.bottom()))
+		};
 
-		renderable->AddQuad(vertices);
+		checked_pointer_cast<UIBatchRenderable>(ui_batch_)->AddQuad(texture, vertices);
 	}
 
 	void UIManager::DrawQuad(float3 const & offset, VertexFormat const * vertices, TexturePtr const & texture)
 	{
-		std::shared_ptr<UIRectRenderable> renderable;
-		if (rects_.find(texture) == rects_.end())
+		VertexFormat const verts[] =
 		{
-			renderable = MakeSharedPtr<UIRectRenderable>(texture, effect_);
-			rects_[texture] = renderable;
-		}
-		else
-		{
-			renderable = checked_pointer_cast<UIRectRenderable>(rects_[texture]);
-		}
-		BOOST_ASSERT(renderable);
-
-		std::vector<VertexFormat> verts(4);
-		verts[0] = VertexFormat(offset + vertices[0].pos,
-			vertices[0].clr, vertices[0].tex);
-		verts[1] = VertexFormat(offset + vertices[1].pos,
-			vertices[1].clr, vertices[1].tex);
-		verts[2] = VertexFormat(offset + vertices[2].pos,
-			vertices[2].clr, vertices[2].tex);
-		verts[3] = VertexFormat(offset + vertices[3].pos,
-			vertices[3].clr, vertices[3].tex);
+			VertexFormat(offset + vertices[0].pos, vertices[0].clr, vertices[0].tex),
+			VertexFormat(offset + vertices[1].pos, vertices[1].clr, vertices[1].tex),
+			VertexFormat(offset + vertices[2].pos, vertices[2].clr, vertices[2].tex),
+			VertexFormat(offset + vertices[3].pos, vertices[3].clr, vertices[3].tex)
+		};
 
-		renderable->AddQuad(verts);
+		checked_pointer_cast<UIBatchRenderable>(ui_batch_)->AddQuad(texture, verts);
 	}
 
 	void UIManager::DrawString(std::wstring const & strText, uint32_t font_index,
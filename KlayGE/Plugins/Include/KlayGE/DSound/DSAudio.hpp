@@ -93,28 +93,20 @@ namespace KlayGE
 		void Direction(float3 const & v);
 
 	private:
-		void LoopUpdateBuffer();
-
 		void DoReset();
 		void DoPlay(bool loop);
 		void DoStop();
 
+		bool FeedDevice(uint32_t& next_service_ms);
 		bool FillData(uint32_t size);
 
 	private:
 		IDSBufferPtr	buffer_;
 		uint32_t		fillSize_;
 		uint32_t		fillCount_;
+		std::vector<uint8_t> fill_buffer_;
 
 		std::shared_ptr<IDirectSound3DBuffer> ds3DBuffer_;
-
-		bool		loop_;
-
-		bool played_;
-		bool stopped_;
-		std::condition_variable play_cond_;
-		std::mutex play_mutex_;
-		joiner<void> play_thread_;
 	};
 
 	// Ƶ
@@ -0,0 +1,77 @@
+/**
+ * @file NullGraphicsBuffer.hpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#ifndef _NULLGRAPHICSBUFFER_HPP
+#define _NULLGRAPHICSBUFFER_HPP
+
+#pragma once
+
+#include <KlayGE/PreDeclare.hpp>
+
+#include <vector>
+
+#include <KlayGE/GraphicsBuffer.hpp>
+
+namespace KlayGE
+{
+	class NullGraphicsBuffer : public GraphicsBuffer
+	{
+	public:
+		NullGraphicsBuffer(BufferUsage usage, uint32_t access_hint, uint32_t size_in_byte, ElementFormat fmt);
+
+		void CopyToBuffer(GraphicsBuffer& rhs);
+
+		void CreateHWResource(void const * init_data);
+		void DeleteHWResource();
+
+		void UpdateSubresource(uint32_t offset, uint32_t size, void const * data);
+
+		ElementFormat Format() const
+		{
+			return fmt_as_shader_res_;
+		}
+
+		uint8_t const * Data() const
+		{
+			return buf_data_.data();
+		}
+
+	private:
+		void* Map(BufferAccess ba);
+		void Unmap();
+
+	private:
+		ElementFormat fmt_as_shader_res_;
+		std::vector<uint8_t> buf_data_;
+		BufferAccess last_ba_;
+	};
+}
+
+#endif			// _NULLGRAPHICSBUFFER_HPP
@@ -0,0 +1,90 @@
+/**
+ * @file NullQuery.hpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#ifndef _NULLQUERY_HPP
+#define _NULLQUERY_HPP
+
+#pragma once
+
+#include <KFL/Timer.hpp>
+#include <KlayGE/Query.hpp>
+
+namespace KlayGE
+{
+	// Nothing is rasterized, so everything is treated as visible
+	class NullOcclusionQuery : public OcclusionQuery
+	{
+	public:
+		void Begin();
+		void End();
+
+		uint64_t SamplesPassed();
+	};
+
+	class NullConditionalRender : public ConditionalRender
+	{
+	public:
+		void Begin();
+		void End();
+
+		void BeginConditionalRender();
+		void EndConditionalRender();
+
+		bool AnySamplesPassed();
+	};
+
+	// Measures the CPU time between Begin and End
+	class NullTimerQuery : public TimerQuery
+	{
+	public:
+		NullTimerQuery();
+
+		void Begin();
+		void End();
+
+		double TimeElapsed();
+
+	private:
+		Timer timer_;
+		double elapsed_;
+	};
+
+	class NullSOStatisticsQuery : public SOStatisticsQuery
+	{
+	public:
+		void Begin();
+		void End();
+
+		uint64_t NumPrimitivesWritten() override;
+		uint64_t PrimitivesGenerated() override;
+	};
+}
+
+#endif		// _NULLQUERY_HPP
@@ -0,0 +1,130 @@
+/**
+ * @file NullRenderEngine.hpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#ifndef _NULLRENDERENGINE_HPP
+#define _NULLRENDERENGINE_HPP
+
+#pragma once
+
+#include <KlayGE/PreDeclare.hpp>
+
+#include <atomic>
+
+#include <KlayGE/RenderEngine.hpp>
+
+namespace KlayGE
+{
+	// A render engine without a device. Resources live in CPU memory, and nothing is drawn. Everything the engine would
+	//  send to a GPU is counted instead, so that culling, loading and submission can be measured without a GPU.
+	//  The counters are totals since the creation or the last reset, and are read through GetCustomAttrib:
+	//    "NUM_DRAWS", "NUM_DISPATCHES", "NUM_PRIMITIVES", "NUM_VERTICES", "NUM_BYTES_UPLOADED",
+	//    "NUM_STATE_CHANGES", "NUM_SHADER_BINDS", "NUM_FRAME_BUFFER_BINDS", "NUM_TEXTURES", "NUM_BUFFERS" (uint64_t)
+	//  SetCustomAttrib("RESET_STATISTICS", nullptr) sets them all back to 0.
+	class NullRenderEngine : public RenderEngine
+	{
+	public:
+		enum StatisticsCounter
+		{
+			SC_Draws = 0,
+			SC_Dispatches,
+			SC_Primitives,
+			SC_Vertices,
+			SC_BytesUploaded,
+			SC_StateChanges,
+			SC_ShaderBinds,
+			SC_FrameBufferBinds,
+			SC_Textures,
+			SC_Buffers,
+
+			SC_NumCounters
+		};
+
+	public:
+		NullRenderEngine();
+		~NullRenderEngine();
+
+		std::wstring const & Name() const;
+
+		bool RequiresFlipping() const
+		{
+			return false;
+		}
+
+		void ForceFlush();
+
+		virtual TexturePtr const & ScreenDepthStencilTexture() const override;
+
+		void ScissorRect(uint32_t x, uint32_t y, uint32_t width, uint32_t height);
+
+		bool FullScreen() const;
+		void FullScreen(bool fs);
+
+		virtual void GetCustomAttrib(std::string const & name, void* value) override;
+		virtual void SetCustomAttrib(std::string const & name, void* value) override;
+
+		// Thread safe, since resources can be created in loading threads
+		void AddStatistics(StatisticsCounter counter, uint64_t value)
+		{
+			statistics_[counter] += value;
+		}
+		uint64_t Statistics(StatisticsCounter counter) const
+		{
+			return statistics_[counter];
+		}
+		void ResetStatistics();
+
+	private:
+		virtual void CheckConfig(RenderSettings& settings) override;
+
+		virtual void DoCreateRenderWindow(std::string const & name, RenderSettings const & settings) override;
+		virtual void DoBindFrameBuffer(FrameBufferPtr const & fb) override;
+		virtual void DoBindSOBuffers(RenderLayoutPtr const & rl) override;
+		virtual void DoRender(RenderEffect const & effect, RenderTechnique const & tech, RenderLayout const & rl) override;
+		virtual void DoDispatch(RenderEffect const & effect, RenderTechnique const & tech,
+			uint32_t tgx, uint32_t tgy, uint32_t tgz) override;
+		virtual void DoDispatchIndirect(RenderEffect const & effect, RenderTechnique const & tech,
+			GraphicsBufferPtr const & buff_args, uint32_t offset) override;
+		virtual void DoResize(uint32_t width, uint32_t height) override;
+		virtual void DoDestroy() override;
+		virtual void DoSuspend() override;
+		virtual void DoResume() override;
+
+		void FillRenderDeviceCaps();
+		void RunPasses(RenderEffect const & effect, RenderTechnique const & tech);
+
+	private:
+		std::atomic<uint64_t> statistics_[SC_NumCounters];
+
+		TexturePtr screen_ds_tex_;
+		bool full_screen_;
+	};
+}
+
+#endif			// _NULLRENDERENGINE_HPP
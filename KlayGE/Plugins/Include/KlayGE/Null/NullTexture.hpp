@@ -0,0 +1,140 @@
+/**
+ * @file NullTexture.hpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#ifndef _NULLTEXTURE_HPP
+#define _NULLTEXTURE_HPP
+
+#pragma once
+
+#include <KlayGE/PreDeclare.hpp>
+
+#include <vector>
+
+#include <KlayGE/Texture.hpp>
+
+namespace KlayGE
+{
+	// One class for all the texture types. Every subresource is a tightly packed block of CPU memory, so maps are
+	//  just pointers into it. Multisample textures keep only one sample.
+	class NullTexture : public Texture
+	{
+	public:
+		NullTexture(TextureType type, uint32_t width, uint32_t height, uint32_t depth, uint32_t numMipMaps, uint32_t array_size,
+			ElementFormat format, uint32_t sample_count, uint32_t sample_quality, uint32_t access_hint);
+
+		std::wstring const & Name() const;
+
+		uint32_t Width(uint32_t level) const;
+		uint32_t Height(uint32_t level) const;
+		uint32_t Depth(uint32_t level) const;
+
+		void CopyToTexture(Texture& target);
+		void CopyToSubTexture1D(Texture& target,
+			uint32_t dst_array_index, uint32_t dst_level, uint32_t dst_x_offset, uint32_t dst_width,
+			uint32_t src_array_index, uint32_t src_level, uint32_t src_x_offset, uint32_t src_width);
+		void CopyToSubTexture2D(Texture& target,
+			uint32_t dst_array_index, uint32_t dst_level, uint32_t dst_x_offset, uint32_t dst_y_offset, uint32_t dst_width, uint32_t dst_height,
+			uint32_t src_array_index, uint32_t src_level, uint32_t src_x_offset, uint32_t src_y_offset, uint32_t src_width, uint32_t src_height);
+		void CopyToSubTexture3D(Texture& target,
+			uint32_t dst_array_index, uint32_t dst_level, uint32_t dst_x_offset, uint32_t dst_y_offset, uint32_t dst_z_offset, uint32_t dst_width, uint32_t dst_height, uint32_t dst_depth,
+			uint32_t src_array_index, uint32_t src_level, uint32_t src_x_offset, uint32_t src_y_offset, uint32_t src_z_offset, uint32_t src_width, uint32_t src_height, uint32_t src_depth);
+		void CopyToSubTextureCube(Texture& target,
+			uint32_t dst_array_index, CubeFaces dst_face, uint32_t dst_level, uint32_t dst_x_offset, uint32_t dst_y_offset, uint32_t dst_width, uint32_t dst_height,
+			uint32_t src_array_index, CubeFaces src_face, uint32_t src_level, uint32_t src_x_offset, uint32_t src_y_offset, uint32_t src_width, uint32_t src_height);
+
+		void BuildMipSubLevels();
+
+		void Map1D(uint32_t array_index, uint32_t level, TextureMapAccess tma,
+			uint32_t x_offset, uint32_t width,
+			void*& data);
+		void Map2D(uint32_t array_index, uint32_t level, TextureMapAccess tma,
+			uint32_t x_offset, uint32_t y_offset, uint32_t width, uint32_t height,
+			void*& data, uint32_t& row_pitch);
+		void Map3D(uint32_t array_index, uint32_t level, TextureMapAccess tma,
+			uint32_t x_offset, uint32_t y_offset, uint32_t z_offset,
+			uint32_t width, uint32_t height, uint32_t depth,
+			void*& data, uint32_t& row_pitch, uint32_t& slice_pitch);
+		void MapCube(uint32_t array_index, CubeFaces face, uint32_t level, TextureMapAccess tma,
+			uint32_t x_offset, uint32_t y_offset, uint32_t width, uint32_t height,
+			void*& data, uint32_t& row_pitch);
+
+		void Unmap1D(uint32_t array_index, uint32_t level);
+		void Unmap2D(uint32_t array_index, uint32_t level);
+		void Unmap3D(uint32_t array_index, uint32_t level);
+		void UnmapCube(uint32_t array_index, CubeFaces face, uint32_t level);
+
+		void CreateHWResource(ElementInitData const * init_data);
+		void DeleteHWResource();
+		bool HWResourceReady() const;
+
+		void UpdateSubresource1D(uint32_t array_index, uint32_t level,
+			uint32_t x_offset, uint32_t width,
+			void const * data);
+		void UpdateSubresource2D(uint32_t array_index, uint32_t level,
+			uint32_t x_offset, uint32_t y_offset, uint32_t width, uint32_t height,
+			void const * data, uint32_t row_pitch);
+		void UpdateSubresource3D(uint32_t array_index, uint32_t level,
+			uint32_t x_offset, uint32_t y_offset, uint32_t z_offset,
+			uint32_t width, uint32_t height, uint32_t depth,
+			void const * data, uint32_t row_pitch, uint32_t slice_pitch);
+		void UpdateSubresourceCube(uint32_t array_index, CubeFaces face, uint32_t level,
+			uint32_t x_offset, uint32_t y_offset, uint32_t width, uint32_t height,
+			void const * data, uint32_t row_pitch);
+
+	private:
+		uint32_t NumFaces() const;
+		uint32_t RowPitch(uint32_t level) const;
+		uint32_t SlicePitch(uint32_t level) const;
+		// Bytes and rows covered by a region. Compressed formats count in 4x4 blocks.
+		uint32_t RegionRowBytes(uint32_t width) const;
+		uint32_t RegionNumRows(uint32_t height) const;
+
+		uint8_t* Subresource(uint32_t array_index, uint32_t face, uint32_t level,
+			uint32_t x_offset, uint32_t y_offset, uint32_t z_offset);
+		// Writable maps count as uploads of the whole region when they are made
+		void DoMap(uint32_t array_index, uint32_t face, uint32_t level, TextureMapAccess tma,
+			uint32_t x_offset, uint32_t y_offset, uint32_t z_offset,
+			uint32_t width, uint32_t height, uint32_t depth,
+			void*& data, uint32_t& row_pitch, uint32_t& slice_pitch);
+		void DoUpdateSubresource(uint32_t array_index, uint32_t face, uint32_t level,
+			uint32_t x_offset, uint32_t y_offset, uint32_t z_offset,
+			uint32_t width, uint32_t height, uint32_t depth,
+			void const * data, uint32_t row_pitch, uint32_t slice_pitch);
+
+	private:
+		uint32_t width_;
+		uint32_t height_;
+		uint32_t depth_;
+
+		std::vector<std::vector<uint8_t>> subres_data_;
+	};
+}
+
+#endif			// _NULLTEXTURE_HPP
@@ -21,8 +21,13 @@
 #include <KlayGE/PreDeclare.hpp>
 
 #include <KlayGE/AudioDataSource.hpp>
+#include <KFL/Thread.hpp>
 
+#include <array>
+#include <condition_variable>
 #include <istream>
+#include <mutex>
+#include <vector>
 #include <vorbis/codec.h>
 #if defined(KLAYGE_COMPILER_GCC)
 #pragma GCC diagnostic push
@@ -35,8 +40,16 @@
 
 namespace KlayGE
 {
+	// Decodes in chunks of CHUNK_FRAMES frames, and keeps the last MAX_CACHED_CHUNKS decoded ones, so replaying or
+	//  seeking back is free. The chunk after the one being read is decoded ahead on the thread pool. Files up to
+	//  PRESERVE_COMPRESSED_SIZE bytes are kept compressed in memory, and the file is released.
 	class OggVorbisSource : public AudioDataSource
 	{
+	public:
+		static uint32_t const CHUNK_FRAMES = 16384;
+		static uint32_t const MAX_CACHED_CHUNKS = 4;
+		static uint32_t const PRESERVE_COMPRESSED_SIZE = 256 * 1024;
+
 	public:
 		OggVorbisSource();
 		~OggVorbisSource();
@@ -48,8 +61,26 @@ namespace KlayGE
 
 		size_t Read(void* data, size_t size);
 		void Reset();
+		void SeekFrame(uint64_t frame);
 
 	private:
+		struct Chunk
+		{
+			uint64_t index;
+			uint32_t num_frames;
+			uint64_t last_use;
+			bool valid;
+			bool decoding;
+			std::vector<uint8_t> pcm;
+		};
+
+		Chunk const & AcquireChunk(uint64_t index, std::unique_lock<std::mutex>& lock);
+		Chunk* FindChunk(uint64_t index);
+		Chunk* ClaimChunk(uint64_t index);
+		void DecodeChunk(Chunk& chunk);
+		void Prefetch(uint64_t index);
+		void WaitForPrefetch();
+
 		static size_t VorbisRead(void* ptr, size_t byteSize, size_t sizeToRead, void* datasource);
 		static int VorbisSeek(void* datasource, ogg_int64_t offset, int whence);
 		static int VorbisClose(void* datasource);
@@ -59,7 +90,27 @@ namespace KlayGE
 		ResIdentifierPtr oggFile_;
 		int64_t length_;
 
+		// The whole file, if it's kept in memory
+		std::vector<char> compressed_;
+		int64_t compressed_pos_;
+
 		OggVorbis_File vf_;
+		bool opened_;
+
+		uint32_t bytes_per_frame_;
+		uint64_t total_frames_;
+		uint64_t cursor_;
+
+		// Guards vf_ and decode_pos_
+		std::mutex decode_mutex_;
+		uint64_t decode_pos_;
+
+		std::mutex cache_mutex_;
+		std::condition_variable chunk_ready_;
+		std::array<Chunk, MAX_CACHED_CHUNKS> chunks_;
+		uint64_t use_tick_;
+		bool prefetching_;
+		std::unique_ptr<joiner<void>> prefetch_;
 	};
 }
 
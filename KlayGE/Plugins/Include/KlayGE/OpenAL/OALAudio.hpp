@@ -98,24 +98,18 @@ namespace KlayGE
 		float3 Direction() const;
 		void Direction(float3 const & v);
 
-		void LoopUpdateBuffer();
-
 	private:
 		void DoReset();
 		void DoPlay(bool loop);
 		void DoStop();
 
+		bool FeedDevice(uint32_t& next_service_ms);
+
 	private:
 		ALuint					source_;
 		std::vector<ALuint>		bufferQueue_;
 
-		bool		loop_;
-
-		bool played_;
-		bool stopped_;
-		std::condition_variable play_cond_;
-		std::mutex play_mutex_;
-		joiner<void> play_thread_;
+		std::vector<uint8_t>	feed_buffer_;
 	};
 
 	// Ƶ
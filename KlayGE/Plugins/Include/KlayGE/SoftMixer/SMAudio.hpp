@@ -0,0 +1,312 @@
+/**
+ * @file SMAudio.hpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#ifndef _SMAUDIO_HPP
+#define _SMAUDIO_HPP
+
+#pragma once
+
+#include <KlayGE/PreDeclare.hpp>
+#include <KFL/Thread.hpp>
+
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+#include <KlayGE/Audio.hpp>
+
+namespace KlayGE
+{
+	class SMAudioEngine;
+
+	uint32_t NumChannels(AudioFormat format);
+	uint32_t BytesPerSample(AudioFormat format);
+	// Converts 8-bit unsigned or 16-bit signed samples to floats in [-1, 1]
+	void ConvertToFloat(AudioFormat format, uint8_t const * data, size_t num_samples, float* samples);
+
+	// Where the mixed output goes. samples are interleaved stereo frames.
+	class SMAudioSink : boost::noncopyable
+	{
+	public:
+		virtual ~SMAudioSink()
+		{
+		}
+
+		virtual void Write(float const * samples, uint32_t num_frames) = 0;
+	};
+	typedef std::shared_ptr<SMAudioSink> SMAudioSinkPtr;
+
+	// Drops the output
+	class SMNullAudioSink : public SMAudioSink
+	{
+	public:
+		void Write(float const * samples, uint32_t num_frames);
+	};
+
+	// Writes the output to a 16-bit stereo wave file
+	class SMWaveFileAudioSink : public SMAudioSink
+	{
+	public:
+		SMWaveFileAudioSink(std::string const & file_name, uint32_t freq);
+		~SMWaveFileAudioSink();
+
+		void Write(float const * samples, uint32_t num_frames);
+
+	private:
+		void WriteHeader();
+
+	private:
+		std::ofstream file_;
+		uint32_t freq_;
+		uint32_t data_size_;
+		std::vector<int16_t> pcm_;
+	};
+
+	// Decodes the whole source once. Every Play takes one of the numSource voices.
+	class SMSoundBuffer : boost::noncopyable, public SoundBuffer
+	{
+	public:
+		SMSoundBuffer(AudioDataSourcePtr const & dataSource, uint32_t numSource, float volume);
+		~SMSoundBuffer();
+
+		void Play(bool loop = false);
+		void Stop();
+
+		void Volume(float vol);
+
+		bool IsPlaying() const;
+
+		float3 Position() const;
+		void Position(float3 const & v);
+		float3 Velocity() const;
+		void Velocity(float3 const & v);
+		float3 Direction() const;
+		void Direction(float3 const & v);
+
+	private:
+		void DoReset();
+
+	private:
+		SMAudioEngine* engine_;
+
+		// Decoded once, and shared by all the voices
+		std::shared_ptr<std::vector<float>> pcm_;
+		uint32_t channels_;
+
+		std::vector<uint64_t> voices_;
+		uint32_t next_steal_;
+
+		float volume_;
+		float3 pos_;
+		float3 vel_;
+		float3 dir_;
+	};
+
+	// Converts the decoded stream into a FIFO that the mixer pulls from
+	class SMMusicBuffer : boost::noncopyable, public MusicBuffer
+	{
+	public:
+		SMMusicBuffer(AudioDataSourcePtr const & dataSource, uint32_t bufferSeconds, float volume);
+		~SMMusicBuffer();
+
+		void Volume(float vol);
+
+		bool IsPlaying() const;
+
+		float3 Position() const;
+		void Position(float3 const & v);
+		float3 Velocity() const;
+		void Velocity(float3 const & v);
+		float3 Direction() const;
+		void Direction(float3 const & v);
+
+		// Called by the mixer. Appends up to num_frames frames to frames, and returns the number of frames appended.
+		uint32_t PullFrames(std::vector<float>& frames, uint32_t num_frames);
+		// True if the stream has ended and all the frames are pulled
+		bool Drained() const;
+		// True if the mixer services the stream itself, instead of the streaming service
+		bool FedByMixer() const;
+
+	private:
+		void DoReset();
+		void DoPlay(bool loop);
+		void DoStop();
+
+		bool FeedDevice(uint32_t& next_service_ms);
+
+	private:
+		SMAudioEngine* engine_;
+		uint32_t channels_;
+		uint32_t bytes_per_sample_;
+
+		uint64_t voice_;
+		bool fed_by_mixer_;
+
+		std::vector<uint8_t> feed_buffer_;
+
+		// Samples [fifo_read_, fifo_read_ + fifo_size_) of fifo_, wrapped around, are converted and not pulled yet
+		mutable std::mutex fifo_mutex_;
+		std::vector<float> fifo_;
+		size_t fifo_read_;
+		size_t fifo_size_;
+		bool end_of_stream_;
+
+		float volume_;
+		float3 pos_;
+		float3 vel_;
+		float3 dir_;
+	};
+
+	// Mixes all the voices in software, and writes the result to a sink. In real time mode a thread mixes one block
+	//  every BLOCK_FRAMES / MIX_FREQ seconds. In offline mode the mixing only happens in Render, as fast as possible.
+	//  Only the loudest voices are mixed, the others are virtual and just keep their position.
+	class SMAudioEngine : boost::noncopyable, public AudioEngine
+	{
+	public:
+		static uint32_t const MIX_FREQ = 44100;
+		static uint32_t const BLOCK_FRAMES = 512;
+		static uint64_t const INVALID_VOICE = 0;
+
+		struct VoiceDesc
+		{
+			// Either pcm or music is set
+			std::shared_ptr<std::vector<float>> pcm;
+			SMMusicBuffer* music;
+
+			uint32_t channels;
+			uint32_t freq;
+			bool loop;
+			float volume;
+			float3 pos;
+		};
+
+	public:
+		SMAudioEngine();
+		~SMAudioEngine();
+
+		std::wstring const & Name() const;
+
+		float3 GetListenerPos() const;
+		void SetListenerPos(float3 const & v);
+		float3 GetListenerVel() const;
+		void SetListenerVel(float3 const & v);
+		void GetListenerOri(float3& face, float3& up) const;
+		void SetListenerOri(float3 const & face, float3 const & up);
+
+		void Sink(SMAudioSinkPtr const & sink);
+		void OfflineMode(bool offline);
+		bool OfflineMode() const;
+		// Mixes num_frames frames to the sink. Only in offline mode.
+		void Render(uint32_t num_frames);
+		uint64_t FramesRendered() const;
+
+		void MaxRealVoices(uint32_t num);
+		uint32_t MaxRealVoices() const;
+		uint32_t NumVoices() const;
+		uint32_t NumRealVoices() const;
+
+		uint64_t StartVoice(VoiceDesc const & desc);
+		void StopVoice(uint64_t voice);
+		void RewindVoice(uint64_t voice);
+		bool IsVoicePlaying(uint64_t voice) const;
+		void VoiceVolume(uint64_t voice, float volume);
+		void VoicePosition(uint64_t voice, float3 const & pos);
+
+	private:
+		struct Voice
+		{
+			VoiceDesc desc;
+
+			// Position in source frames, 32.32 fixed point
+			uint64_t pos;
+			uint64_t step;
+
+			// Frames pulled from the music buffer and not consumed yet
+			std::vector<float> stream;
+			bool drained_padded;
+
+			float gain_l;
+			float gain_r;
+			float audibility;
+
+			uint32_t generation;
+			uint32_t active_index;
+			bool active;
+		};
+
+		virtual void DoSuspend() override;
+		virtual void DoResume() override;
+
+		void MixThreadFunc();
+		void MixBlock(uint32_t num_frames);
+		void UpdateGains(Voice& voice, float3 const & right) const;
+		bool RenderVoice(Voice& voice, uint32_t num_frames, bool audible);
+		void FreeVoice(uint32_t index);
+		Voice* FindVoice(uint64_t voice);
+		Voice const * FindVoice(uint64_t voice) const;
+
+		void StartMixThread();
+		void StopMixThread();
+
+	private:
+		mutable std::mutex mix_mutex_;
+
+		float3 listener_pos_;
+		float3 listener_vel_;
+		float3 listener_face_;
+		float3 listener_up_;
+
+		std::vector<Voice> voices_;
+		std::vector<uint32_t> free_voices_;
+		std::vector<uint32_t> active_voices_;
+		std::vector<uint32_t> sorted_voices_;
+		std::vector<uint32_t> finished_voices_;
+		uint32_t max_real_voices_;
+		uint32_t num_real_voices_;
+
+		std::vector<float> mix_l_;
+		std::vector<float> mix_r_;
+		std::vector<float> interleaved_;
+
+		SMAudioSinkPtr sink_;
+		uint64_t frames_rendered_;
+
+		bool offline_;
+		bool paused_;
+		bool quit_;
+		std::condition_variable quit_cond_;
+		std::unique_ptr<joiner<void>> mix_thread_;
+	};
+}
+
+#endif		// _SMAUDIO_HPP
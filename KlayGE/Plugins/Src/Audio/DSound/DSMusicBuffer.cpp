@@ -32,12 +32,12 @@ namespace KlayGE
 	// 캯һʽŵĻ
 	/////////////////////////////////////////////////////////////////////////////////
 	DSMusicBuffer::DSMusicBuffer(AudioDataSourcePtr const & dataSource, uint32_t bufferSeconds, float volume)
-					: MusicBuffer(dataSource),
-						played_(false), stopped_(true)
+					: MusicBuffer(dataSource)
 	{
 		WAVEFORMATEX wfx(WaveFormatEx(dataSource));
 		fillSize_	= wfx.nAvgBytesPerSec / PreSecond;
 		fillCount_	= bufferSeconds * PreSecond;
+		fill_buffer_.resize(fillSize_);
 
 		bool const mono(1 == wfx.nChannels);
 
@@ -86,47 +86,31 @@ namespace KlayGE
 		this->Stop();
 	}
 
-	void DSMusicBuffer::LoopUpdateBuffer()
+	bool DSMusicBuffer::FeedDevice(uint32_t& next_service_ms)
 	{
-		std::unique_lock<std::mutex> lock(play_mutex_);
-		while (!played_)
-		{
-			play_cond_.wait(lock);
-		}
-		played_ = false;
+		DWORD play_cursor, write_cursor;
+		buffer_->GetCurrentPosition(&play_cursor, &write_cursor);
 
-		while (!stopped_)
+		uint32_t const next_cursor = play_cursor + fillSize_;
+		if (next_cursor >= write_cursor)
 		{
-			DWORD play_cursor, write_cursor;
-			buffer_->GetCurrentPosition(&play_cursor, &write_cursor);
-
-			uint32_t const next_cursor = play_cursor + fillSize_;
-			if (next_cursor >= write_cursor)
+			// Looping is handled by the decoder, so running out of data means the end
+			if (this->FillData(fillSize_))
 			{
-				if (this->FillData(fillSize_))
-				{
-					if (loop_)
-					{
-						stopped_ = false;
-						this->DoReset();
-					}
-					else
-					{
-						stopped_ = true;
-						buffer_->Stop();
-					}
-				}
+				buffer_->Stop();
+				return false;
 			}
-
-			Sleep(1000 / PreSecond);
 		}
+
+		next_service_ms = 1000 / PreSecond;
+		return true;
 	}
 
 	// λԱڴͷ
 	/////////////////////////////////////////////////////////////////////////////////
 	void DSMusicBuffer::DoReset()
 	{
-		dataSource_->Reset();
+		this->ResetDecoder();
 
 		buffer_->SetCurrentPosition(0);
 	}
@@ -135,37 +119,27 @@ namespace KlayGE
 	/////////////////////////////////////////////////////////////////////////////////
 	void DSMusicBuffer::DoPlay(bool loop)
 	{
-		play_thread_ = Context::Instance().ThreadPool()(std::bind(&DSMusicBuffer::LoopUpdateBuffer, this));
-
 		loop_ = loop;
 
-		stopped_ = false;
-		{
-			std::lock_guard<std::mutex> lock(play_mutex_);
-			played_ = true;
-		}
-		play_cond_.notify_one();
-
 		buffer_->Play(0, 0, DSBPLAY_LOOPING);
+
+		streaming_service_->Add(this);
 	}
 
 	// ֹͣƵ
 	////////////////////////////////////////////////////////////////////////////////
 	void DSMusicBuffer::DoStop()
 	{
-		if (!stopped_)
-		{
-			stopped_ = true;
-			play_thread_();
-		}
+		streaming_service_->Remove(this);
 
 		buffer_->Stop();
 	}
 
 	bool DSMusicBuffer::FillData(uint32_t size)
 	{
-		std::vector<uint8_t> data(size);
-		data.resize(dataSource_->Read(&data[0], size));
+		std::vector<uint8_t>& data = fill_buffer_;
+		data.resize(size);
+		data.resize(this->ReadDecoded(&data[0], size));
 
 		uint8_t* locked_buff[2];
 		DWORD locked_buff_size[2];
@@ -24,6 +24,8 @@
 #include <KFL/Util.hpp>
 #include <KlayGE/AudioDataSource.hpp>
 
+#include <algorithm>
+
 #include <boost/assert.hpp>
 
 #include <KlayGE/OpenAL/OALAudio.hpp>
@@ -37,7 +39,7 @@ namespace KlayGE
 	OALMusicBuffer::OALMusicBuffer(AudioDataSourcePtr const & dataSource, uint32_t bufferSeconds, float volume)
 							: MusicBuffer(dataSource),
 								bufferQueue_(bufferSeconds * PreSecond),
-								played_(false), stopped_(true)
+								feed_buffer_(READSIZE)
 	{
 		alGenBuffers(static_cast<ALsizei>(bufferQueue_.size()), &bufferQueue_[0]);
 
@@ -63,61 +65,6 @@ namespace KlayGE
 		alDeleteSources(1, &source_);
 	}
 
-	// »
-	/////////////////////////////////////////////////////////////////////////////////
-	void OALMusicBuffer::LoopUpdateBuffer()
-	{
-		std::unique_lock<std::mutex> lock(play_mutex_);
-		while (!played_)
-		{
-			play_cond_.wait(lock);
-		}
-		played_ = false;
-
-		while (!stopped_)
-		{
-			ALint processed;
-			alGetSourcei(source_, AL_BUFFERS_PROCESSED, &processed);
-			if (processed > 0)
-			{
-				while (processed > 0)
-				{
-					-- processed;
-
-					ALuint buf;
-					alSourceUnqueueBuffers(source_, 1, &buf);
-
-					std::vector<uint8_t> data(READSIZE);
-					data.resize(dataSource_->Read(&data[0], data.size()));
-					if (data.empty())
-					{
-						if (loop_)
-						{
-							stopped_ = false;
-							alSourceStopv(1, &source_);
-							this->DoReset();
-							alSourcePlay(source_);
-						}
-						else
-						{
-							stopped_ = true;
-						}
-					}
-					else
-					{
-						alBufferData(buf, Convert(format_), &data[0],
-							static_cast<ALsizei>(data.size()), freq_);
-						alSourceQueueBuffers(source_, 1, &buf);
-					}
-				}
-			}
-			else
-			{
-				Sleep(1000 / PreSecond);
-			}
-		}
-	}
-
 	// λԱڴͷ
 	/////////////////////////////////////////////////////////////////////////////////
 	void OALMusicBuffer::DoReset()
@@ -131,24 +78,23 @@ namespace KlayGE
 		}
 
 		ALenum const format(Convert(format_));
-		std::vector<uint8_t> data(READSIZE);
 
-		dataSource_->Reset();
+		this->ResetDecoder();
 
 		ALsizei non_empty_buf = 0;
 		// ÿװ1 / PreSecond
 		for (auto const & buf : bufferQueue_)
 		{
-			data.resize(dataSource_->Read(&data[0], data.size()));
-			if (data.empty())
+			size_t const size = this->ReadDecoded(&feed_buffer_[0], feed_buffer_.size());
+			if (0 == size)
 			{
 				break;
 			}
 			else
 			{
 				++ non_empty_buf;
-				alBufferData(buf, format, &data[0],
-					static_cast<ALuint>(data.size()), static_cast<ALuint>(freq_));
+				alBufferData(buf, format, &feed_buffer_[0],
+					static_cast<ALuint>(size), static_cast<ALuint>(freq_));
 			}
 		}
 
@@ -161,32 +107,73 @@ namespace KlayGE
 	/////////////////////////////////////////////////////////////////////////////////
 	void OALMusicBuffer::DoPlay(bool loop)
 	{
-		play_thread_ = Context::Instance().ThreadPool()(std::bind(&OALMusicBuffer::LoopUpdateBuffer, this));
-
 		loop_ = loop;
 
-		stopped_ = false;
-		{
-			std::lock_guard<std::mutex> lock(play_mutex_);
-			played_ = true;
-		}
-		play_cond_.notify_one();
-
 		alSourcei(source_, AL_LOOPING, false);
 		alSourcePlay(source_);
+
+		streaming_service_->Add(this);
 	}
 
 	// ֹͣƵ
 	////////////////////////////////////////////////////////////////////////////////
 	void OALMusicBuffer::DoStop()
 	{
-		if (!stopped_)
+		streaming_service_->Remove(this);
+
+		alSourceStopv(1, &source_);
+	}
+
+	// Refills the processed buffers, and wakes up again when the current one is played
+	/////////////////////////////////////////////////////////////////////////////////
+	bool OALMusicBuffer::FeedDevice(uint32_t& next_service_ms)
+	{
+		bool end_of_stream = false;
+
+		ALint processed;
+		alGetSourcei(source_, AL_BUFFERS_PROCESSED, &processed);
+		while (processed > 0)
 		{
-			stopped_ = true;
-			play_thread_();
+			-- processed;
+
+			ALuint buf;
+			alSourceUnqueueBuffers(source_, 1, &buf);
+
+			size_t const size = this->ReadDecoded(&feed_buffer_[0], feed_buffer_.size());
+			if (0 == size)
+			{
+				end_of_stream = true;
+			}
+			else
+			{
+				alBufferData(buf, Convert(format_), &feed_buffer_[0],
+					static_cast<ALsizei>(size), freq_);
+				alSourceQueueBuffers(source_, 1, &buf);
+			}
 		}
 
-		alSourceStopv(1, &source_);
+		if (end_of_stream)
+		{
+			// The source plays out the queued buffers by itself
+			return false;
+		}
+
+		ALint queued;
+		alGetSourcei(source_, AL_BUFFERS_QUEUED, &queued);
+		ALint state;
+		alGetSourcei(source_, AL_SOURCE_STATE, &state);
+		if ((queued > 0) && (state != AL_PLAYING))
+		{
+			// Starved, all the queued buffers ran out before being refilled
+			alSourcePlay(source_);
+		}
+
+		ALint offset;
+		alGetSourcei(source_, AL_BYTE_OFFSET, &offset);
+		uint32_t const remain = static_cast<uint32_t>(std::max<int32_t>(static_cast<int32_t>(READSIZE) - offset, 0));
+		next_service_ms = std::max(static_cast<uint32_t>(static_cast<uint64_t>(remain) * 1000 / this->BytesPerSecond()), 1U);
+
+		return true;
 	}
 
 	// 黺Ƿڲ
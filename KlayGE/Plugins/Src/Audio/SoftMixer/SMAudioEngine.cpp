@@ -0,0 +1,792 @@
+/**
+ * @file SMAudioEngine.cpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Util.hpp>
+#include <KFL/Math.hpp>
+#include <KFL/ThrowErr.hpp>
+#include <KlayGE/Context.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+#include <boost/assert.hpp>
+
+#if defined(KLAYGE_SSE_SUPPORT)
+#include <xmmintrin.h>
+#endif
+
+#include <KlayGE/SoftMixer/SMAudio.hpp>
+
+namespace
+{
+	using namespace KlayGE;
+
+	uint32_t const DEFAULT_MAX_REAL_VOICES = 64;
+
+	// Fraction of a 32.32 fixed point position. Only the top 24 bits are kept, since that is all a float can hold.
+	float Frac(uint64_t pos)
+	{
+		return (static_cast<uint32_t>(pos) >> 8) * (1.0f / (1U << 24));
+	}
+
+	// Resamples a mono source with linear interpolation, and adds it to the mix. The frames up to
+	//  floor(pos + step * (num_frames - 1)) + 1 must be readable.
+	void MixMono(float* mix_l, float* mix_r, uint32_t num_frames, float const * src, uint64_t pos, uint64_t step,
+		float gain_l, float gain_r)
+	{
+		uint32_t i = 0;
+#if defined(KLAYGE_SSE_SUPPORT)
+		__m128 const gl = _mm_set1_ps(gain_l);
+		__m128 const gr = _mm_set1_ps(gain_r);
+		if ((step == (1ULL << 32)) && (0 == (pos & 0xFFFFFFFF)))
+		{
+			// Same rate and no fraction, no interpolation
+			float const * s = src + (pos >> 32);
+			for (; i + 4 <= num_frames; i += 4)
+			{
+				__m128 const v = _mm_loadu_ps(s + i);
+				_mm_storeu_ps(mix_l + i, _mm_add_ps(_mm_loadu_ps(mix_l + i), _mm_mul_ps(v, gl)));
+				_mm_storeu_ps(mix_r + i, _mm_add_ps(_mm_loadu_ps(mix_r + i), _mm_mul_ps(v, gr)));
+			}
+			pos += step * i;
+		}
+		else
+		{
+			for (; i + 4 <= num_frames; i += 4)
+			{
+				uint64_t const p0 = pos;
+				uint64_t const p1 = p0 + step;
+				uint64_t const p2 = p1 + step;
+				uint64_t const p3 = p2 + step;
+				pos = p3 + step;
+
+				float const * s0 = src + (p0 >> 32);
+				float const * s1 = src + (p1 >> 32);
+				float const * s2 = src + (p2 >> 32);
+				float const * s3 = src + (p3 >> 32);
+				__m128 const a = _mm_setr_ps(s0[0], s1[0], s2[0], s3[0]);
+				__m128 const b = _mm_setr_ps(s0[1], s1[1], s2[1], s3[1]);
+				__m128 const t = _mm_setr_ps(Frac(p0), Frac(p1), Frac(p2), Frac(p3));
+				__m128 const v = _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), t));
+				_mm_storeu_ps(mix_l + i, _mm_add_ps(_mm_loadu_ps(mix_l + i), _mm_mul_ps(v, gl)));
+				_mm_storeu_ps(mix_r + i, _mm_add_ps(_mm_loadu_ps(mix_r + i), _mm_mul_ps(v, gr)));
+			}
+		}
+#endif
+		for (; i < num_frames; ++ i)
+		{
+			uint64_t const index = pos >> 32;
+			float const v = MathLib::lerp(src[index], src[index + 1], Frac(pos));
+			mix_l[i] += v * gain_l;
+			mix_r[i] += v * gain_r;
+			pos += step;
+		}
+	}
+
+	// Same as MixMono, for an interleaved stereo source
+	void MixStereo(float* mix_l, float* mix_r, uint32_t num_frames, float const * src, uint64_t pos, uint64_t step,
+		float gain_l, float gain_r)
+	{
+		uint32_t i = 0;
+#if defined(KLAYGE_SSE_SUPPORT)
+		__m128 const gl = _mm_set1_ps(gain_l);
+		__m128 const gr = _mm_set1_ps(gain_r);
+		for (; i + 4 <= num_frames; i += 4)
+		{
+			uint64_t const p0 = pos;
+			uint64_t const p1 = p0 + step;
+			uint64_t const p2 = p1 + step;
+			uint64_t const p3 = p2 + step;
+			pos = p3 + step;
+
+			float const * s0 = src + (p0 >> 32) * 2;
+			float const * s1 = src + (p1 >> 32) * 2;
+			float const * s2 = src + (p2 >> 32) * 2;
+			float const * s3 = src + (p3 >> 32) * 2;
+			__m128 const t = _mm_setr_ps(Frac(p0), Frac(p1), Frac(p2), Frac(p3));
+			__m128 const l = _mm_setr_ps(s0[0], s1[0], s2[0], s3[0]);
+			__m128 const r = _mm_setr_ps(s0[1], s1[1], s2[1], s3[1]);
+			__m128 const nl = _mm_setr_ps(s0[2], s1[2], s2[2], s3[2]);
+			__m128 const nr = _mm_setr_ps(s0[3], s1[3], s2[3], s3[3]);
+			__m128 const vl = _mm_add_ps(l, _mm_mul_ps(_mm_sub_ps(nl, l), t));
+			__m128 const vr = _mm_add_ps(r, _mm_mul_ps(_mm_sub_ps(nr, r), t));
+			_mm_storeu_ps(mix_l + i, _mm_add_ps(_mm_loadu_ps(mix_l + i), _mm_mul_ps(vl, gl)));
+			_mm_storeu_ps(mix_r + i, _mm_add_ps(_mm_loadu_ps(mix_r + i), _mm_mul_ps(vr, gr)));
+		}
+#endif
+		for (; i < num_frames; ++ i)
+		{
+			uint64_t const index = (pos >> 32) * 2;
+			float const t = Frac(pos);
+			mix_l[i] += MathLib::lerp(src[index + 0], src[index + 2], t) * gain_l;
+			mix_r[i] += MathLib::lerp(src[index + 1], src[index + 3], t) * gain_r;
+			pos += step;
+		}
+	}
+}
+
+namespace KlayGE
+{
+	uint32_t NumChannels(AudioFormat format)
+	{
+		switch (format)
+		{
+		case AF_Mono8:
+		case AF_Mono16:
+			return 1;
+
+		case AF_Stereo8:
+		case AF_Stereo16:
+			return 2;
+
+		default:
+			THR(errc::function_not_supported);
+		}
+	}
+
+	uint32_t BytesPerSample(AudioFormat format)
+	{
+		switch (format)
+		{
+		case AF_Mono8:
+		case AF_Stereo8:
+			return 1;
+
+		case AF_Mono16:
+		case AF_Stereo16:
+			return 2;
+
+		default:
+			THR(errc::function_not_supported);
+		}
+	}
+
+	void ConvertToFloat(AudioFormat format, uint8_t const * data, size_t num_samples, float* samples)
+	{
+		if (1 == BytesPerSample(format))
+		{
+			for (size_t i = 0; i < num_samples; ++ i)
+			{
+				samples[i] = (static_cast<int>(data[i]) - 128) * (1.0f / 128);
+			}
+		}
+		else
+		{
+			for (size_t i = 0; i < num_samples; ++ i)
+			{
+				int16_t s;
+				std::memcpy(&s, data + i * sizeof(s), sizeof(s));
+				samples[i] = LE2Native(s) * (1.0f / 32768);
+			}
+		}
+	}
+
+
+	void SMNullAudioSink::Write(float const * samples, uint32_t num_frames)
+	{
+		KFL_UNUSED(samples);
+		KFL_UNUSED(num_frames);
+	}
+
+
+	SMWaveFileAudioSink::SMWaveFileAudioSink(std::string const & file_name, uint32_t freq)
+		: file_(file_name.c_str(), std::ios_base::binary | std::ios_base::out),
+			freq_(freq), data_size_(0)
+	{
+		if (!file_)
+		{
+			THR(errc::no_such_file_or_directory);
+		}
+
+		this->WriteHeader();
+	}
+
+	SMWaveFileAudioSink::~SMWaveFileAudioSink()
+	{
+		// Patches the sizes now that they are known
+		file_.seekp(0);
+		this->WriteHeader();
+	}
+
+	void SMWaveFileAudioSink::Write(float const * samples, uint32_t num_frames)
+	{
+		pcm_.resize(num_frames * 2);
+		for (size_t i = 0; i < pcm_.size(); ++ i)
+		{
+			float const s = MathLib::clamp(samples[i], -1.0f, 1.0f);
+			pcm_[i] = Native2LE(static_cast<int16_t>(s * 32767));
+		}
+
+		file_.write(reinterpret_cast<char const *>(&pcm_[0]), pcm_.size() * sizeof(pcm_[0]));
+		data_size_ += static_cast<uint32_t>(pcm_.size() * sizeof(pcm_[0]));
+	}
+
+	void SMWaveFileAudioSink::WriteHeader()
+	{
+		auto write_u32 = [this](uint32_t v)
+			{
+				v = Native2LE(v);
+				file_.write(reinterpret_cast<char const *>(&v), sizeof(v));
+			};
+		auto write_u16 = [this](uint16_t v)
+			{
+				v = Native2LE(v);
+				file_.write(reinterpret_cast<char const *>(&v), sizeof(v));
+			};
+
+		uint16_t const channels = 2;
+		uint16_t const bits = 16;
+		uint16_t const block_align = channels * bits / 8;
+
+		file_.write("RIFF", 4);
+		write_u32(36 + data_size_);
+		file_.write("WAVE", 4);
+
+		file_.write("fmt ", 4);
+		write_u32(16);
+		write_u16(1);
+		write_u16(channels);
+		write_u32(freq_);
+		write_u32(freq_ * block_align);
+		write_u16(block_align);
+		write_u16(bits);
+
+		file_.write("data", 4);
+		write_u32(data_size_);
+	}
+
+
+	uint32_t const SMAudioEngine::MIX_FREQ;
+	uint32_t const SMAudioEngine::BLOCK_FRAMES;
+	uint64_t const SMAudioEngine::INVALID_VOICE;
+
+	SMAudioEngine::SMAudioEngine()
+		: listener_pos_(0, 0, 0), listener_vel_(0, 0, 0), listener_face_(0, 0, 1), listener_up_(0, 1, 0),
+			max_real_voices_(DEFAULT_MAX_REAL_VOICES), num_real_voices_(0),
+			mix_l_(BLOCK_FRAMES), mix_r_(BLOCK_FRAMES), interleaved_(BLOCK_FRAMES * 2),
+			sink_(MakeSharedPtr<SMNullAudioSink>()), frames_rendered_(0),
+			offline_(false), paused_(false), quit_(false)
+	{
+		this->StartMixThread();
+	}
+
+	SMAudioEngine::~SMAudioEngine()
+	{
+		this->StopMixThread();
+
+		audioBufs_.clear();
+	}
+
+	std::wstring const & SMAudioEngine::Name() const
+	{
+		static std::wstring const name(L"Software Mixer Audio Engine");
+		return name;
+	}
+
+	float3 SMAudioEngine::GetListenerPos() const
+	{
+		std::lock_guard<std::mutex> lock(mix_mutex_);
+		return listener_pos_;
+	}
+
+	void SMAudioEngine::SetListenerPos(float3 const & v)
+	{
+		std::lock_guard<std::mutex> lock(mix_mutex_);
+		listener_pos_ = v;
+	}
+
+	float3 SMAudioEngine::GetListenerVel() const
+	{
+		std::lock_guard<std::mutex> lock(mix_mutex_);
+		return listener_vel_;
+	}
+
+	void SMAudioEngine::SetListenerVel(float3 const & v)
+	{
+		std::lock_guard<std::mutex> lock(mix_mutex_);
+		listener_vel_ = v;
+	}
+
+	void SMAudioEngine::GetListenerOri(float3& face, float3& up) const
+	{
+		std::lock_guard<std::mutex> lock(mix_mutex_);
+		face = listener_face_;
+		up = listener_up_;
+	}
+
+	void SMAudioEngine::SetListenerOri(float3 const & face, float3 const & up)
+	{
+		std::lock_guard<std::mutex> lock(mix_mutex_);
+		listener_face_ = face;
+		listener_up_ = up;
+	}
+
+	void SMAudioEngine::Sink(SMAudioSinkPtr const & sink)
+	{
+		std::lock_guard<std::mutex> lock(mix_mutex_);
+		if (sink)
+		{
+			sink_ = sink;
+		}
+		else
+		{
+			sink_ = MakeSharedPtr<SMNullAudioSink>();
+		}
+	}
+
+	void SMAudioEngine::OfflineMode(bool offline)
+	{
+		if (offline != offline_)
+		{
+			if (offline)
+			{
+				this->StopMixThread();
+				offline_ = true;
+			}
+			else
+			{
+				offline_ = false;
+				this->StartMixThread();
+			}
+		}
+	}
+
+	bool SMAudioEngine::OfflineMode() const
+	{
+		return offline_;
+	}
+
+	void SMAudioEngine::Render(uint32_t num_frames)
+	{
+		BOOST_ASSERT(offline_);
+
+		std::lock_guard<std::mutex> lock(mix_mutex_);
+		while (num_frames > 0)
+		{
+			uint32_t const n = std::min(num_frames, BLOCK_FRAMES);
+			this->MixBlock(n);
+			num_frames -= n;
+		}
+	}
+
+	uint64_t SMAudioEngine::FramesRendered() const
+	{
+		std::lock_guard<std::mutex> lock(mix_mutex_);
+		return frames_rendered_;
+	}
+
+	void SMAudioEngine::MaxRealVoices(uint32_t num)
+	{
+		std::lock_guard<std::mutex> lock(mix_mutex_);
+		max_real_voices_ = num;
+	}
+
+	uint32_t SMAudioEngine::MaxRealVoices() const
+	{
+		std::lock_guard<std::mutex> lock(mix_mutex_);
+		return max_real_voices_;
+	}
+
+	uint32_t SMAudioEngine::NumVoices() const
+	{
+		std::lock_guard<std::mutex> lock(mix_mutex_);
+		return static_cast<uint32_t>(active_voices_.size());
+	}
+
+	uint32_t SMAudioEngine::NumRealVoices() const
+	{
+		std::lock_guard<std::mutex> lock(mix_mutex_);
+		return num_real_voices_;
+	}
+
+	uint64_t SMAudioEngine::StartVoice(VoiceDesc const & desc)
+	{
+		BOOST_ASSERT(desc.pcm || desc.music);
+		BOOST_ASSERT((1 == desc.channels) || (2 == desc.channels));
+
+		std::lock_guard<std::mutex> lock(mix_mutex_);
+
+		uint32_t index;
+		if (free_voices_.empty())
+		{
+			index = static_cast<uint32_t>(voices_.size());
+			voices_.emplace_back();
+			voices_.back().generation = 1;
+		}
+		else
+		{
+			index = free_voices_.back();
+			free_voices_.pop_back();
+		}
+
+		Voice& voice = voices_[index];
+		voice.desc = desc;
+		voice.pos = 0;
+		voice.step = (static_cast<uint64_t>(desc.freq) << 32) / MIX_FREQ;
+		voice.stream.clear();
+		voice.drained_padded = false;
+		voice.gain_l = 0;
+		voice.gain_r = 0;
+		voice.audibility = 0;
+		voice.active_index = static_cast<uint32_t>(active_voices_.size());
+		voice.active = true;
+		active_voices_.push_back(index);
+
+		return (static_cast<uint64_t>(voice.generation) << 32) | (index + 1);
+	}
+
+	void SMAudioEngine::StopVoice(uint64_t voice)
+	{
+		std::lock_guard<std::mutex> lock(mix_mutex_);
+		if (this->FindVoice(voice) != nullptr)
+		{
+			this->FreeVoice(static_cast<uint32_t>(voice & 0xFFFFFFFF) - 1);
+		}
+	}
+
+	void SMAudioEngine::RewindVoice(uint64_t voice)
+	{
+		std::lock_guard<std::mutex> lock(mix_mutex_);
+		Voice* v = this->FindVoice(voice);
+		if (v != nullptr)
+		{
+			v->pos = 0;
+		}
+	}
+
+	bool SMAudioEngine::IsVoicePlaying(uint64_t voice) const
+	{
+		std::lock_guard<std::mutex> lock(mix_mutex_);
+		return this->FindVoice(voice) != nullptr;
+	}
+
+	void SMAudioEngine::VoiceVolume(uint64_t voice, float volume)
+	{
+		std::lock_guard<std::mutex> lock(mix_mutex_);
+		Voice* v = this->FindVoice(voice);
+		if (v != nullptr)
+		{
+			v->desc.volume = volume;
+		}
+	}
+
+	void SMAudioEngine::VoicePosition(uint64_t voice, float3 const & pos)
+	{
+		std::lock_guard<std::mutex> lock(mix_mutex_);
+		Voice* v = this->FindVoice(voice);
+		if (v != nullptr)
+		{
+			v->desc.pos = pos;
+		}
+	}
+
+	void SMAudioEngine::DoSuspend()
+	{
+		std::lock_guard<std::mutex> lock(mix_mutex_);
+		paused_ = true;
+	}
+
+	void SMAudioEngine::DoResume()
+	{
+		std::lock_guard<std::mutex> lock(mix_mutex_);
+		paused_ = false;
+	}
+
+	void SMAudioEngine::StartMixThread()
+	{
+		BOOST_ASSERT(!mix_thread_);
+
+		quit_ = false;
+		mix_thread_ = MakeUniquePtr<joiner<void>>(Context::Instance().ThreadPool()(
+			[this]
+			{
+				this->MixThreadFunc();
+			}));
+	}
+
+	void SMAudioEngine::StopMixThread()
+	{
+		if (mix_thread_)
+		{
+			{
+				std::lock_guard<std::mutex> lock(mix_mutex_);
+				quit_ = true;
+			}
+			quit_cond_.notify_one();
+
+			(*mix_thread_)();
+			mix_thread_.reset();
+		}
+	}
+
+	void SMAudioEngine::MixThreadFunc()
+	{
+		auto const block_duration = std::chrono::microseconds(static_cast<uint64_t>(BLOCK_FRAMES) * 1000000 / MIX_FREQ);
+		auto next = std::chrono::steady_clock::now();
+
+		std::unique_lock<std::mutex> lock(mix_mutex_);
+		while (!quit_)
+		{
+			this->MixBlock(BLOCK_FRAMES);
+
+			next += block_duration;
+			auto const now = std::chrono::steady_clock::now();
+			if (next + block_duration * 4 < now)
+			{
+				// Fell far behind, don't try to catch up
+				next = now;
+			}
+
+			quit_cond_.wait_until(lock, next,
+				[this]
+				{
+					return quit_;
+				});
+		}
+	}
+
+	// Called with mix_mutex_ locked
+	void SMAudioEngine::MixBlock(uint32_t num_frames)
+	{
+		BOOST_ASSERT(num_frames <= BLOCK_FRAMES);
+
+		std::fill(mix_l_.begin(), mix_l_.begin() + num_frames, 0.0f);
+		std::fill(mix_r_.begin(), mix_r_.begin() + num_frames, 0.0f);
+
+		num_real_voices_ = 0;
+		if (!paused_)
+		{
+			float3 const right = MathLib::normalize(MathLib::cross(listener_up_, listener_face_));
+			for (auto const index : active_voices_)
+			{
+				this->UpdateGains(voices_[index], right);
+			}
+
+			sorted_voices_ = active_voices_;
+			if (sorted_voices_.size() > max_real_voices_)
+			{
+				std::nth_element(sorted_voices_.begin(), sorted_voices_.begin() + max_real_voices_, sorted_voices_.end(),
+					[this](uint32_t lhs, uint32_t rhs)
+					{
+						return voices_[lhs].audibility > voices_[rhs].audibility;
+					});
+			}
+			uint32_t const num_real = std::min(static_cast<uint32_t>(sorted_voices_.size()), max_real_voices_);
+
+			finished_voices_.clear();
+			for (size_t i = 0; i < sorted_voices_.size(); ++ i)
+			{
+				Voice& voice = voices_[sorted_voices_[i]];
+				bool const audible = (i < num_real) && (voice.audibility > 0);
+				if (audible)
+				{
+					++ num_real_voices_;
+				}
+				if (!this->RenderVoice(voice, num_frames, audible))
+				{
+					finished_voices_.push_back(sorted_voices_[i]);
+				}
+			}
+			for (auto const index : finished_voices_)
+			{
+				this->FreeVoice(index);
+			}
+		}
+
+		for (uint32_t i = 0; i < num_frames; ++ i)
+		{
+			interleaved_[i * 2 + 0] = mix_l_[i];
+			interleaved_[i * 2 + 1] = mix_r_[i];
+		}
+		sink_->Write(&interleaved_[0], num_frames);
+		frames_rendered_ += num_frames;
+	}
+
+	void SMAudioEngine::UpdateGains(Voice& voice, float3 const & right) const
+	{
+		float const volume = voice.desc.volume;
+		if (1 == voice.desc.channels)
+		{
+			float3 const dir = voice.desc.pos - listener_pos_;
+			float const dist = MathLib::length(dir);
+
+			// Inverse distance clamped, reference distance 1, rolloff factor 1
+			float const gain = volume / std::max(dist, 1.0f);
+
+			// Equal power panning
+			float const pan = (dist > 1e-6f) ? MathLib::clamp(MathLib::dot(dir, right) / dist, -1.0f, 1.0f) : 0.0f;
+			float const angle = (pan + 1) * (PI / 4);
+			voice.gain_l = gain * std::cos(angle);
+			voice.gain_r = gain * std::sin(angle);
+		}
+		else
+		{
+			// Like OpenAL, stereo sources are not spatialized
+			voice.gain_l = volume;
+			voice.gain_r = volume;
+		}
+		voice.audibility = std::max(voice.gain_l, voice.gain_r);
+	}
+
+	// Mixes the voice if it's audible, or only moves its position otherwise. Returns false if the voice has finished.
+	bool SMAudioEngine::RenderVoice(Voice& voice, uint32_t num_frames, bool audible)
+	{
+		uint32_t const channels = voice.desc.channels;
+		SMMusicBuffer* music = voice.desc.music;
+
+		uint32_t out = 0;
+		while (out < num_frames)
+		{
+			uint32_t const remain = num_frames - out;
+
+			// Frame avail is the last one that can be read, only for interpolating
+			float const * src;
+			uint64_t avail;
+			if (music != nullptr)
+			{
+				uint64_t const need = ((voice.pos + voice.step * remain) >> 32) + 2;
+				uint64_t have = voice.stream.size() / channels;
+				if (have < need)
+				{
+					have += music->PullFrames(voice.stream, static_cast<uint32_t>(need - have));
+					if ((have < need) && music->FedByMixer())
+					{
+						uint32_t next_service_ms;
+						music->ServiceStream(next_service_ms);
+						have += music->PullFrames(voice.stream, static_cast<uint32_t>(need - have));
+					}
+					if ((have < need) && !voice.drained_padded && music->Drained())
+					{
+						// The last frame fades to silence
+						voice.stream.resize(voice.stream.size() + channels, 0.0f);
+						voice.drained_padded = true;
+						++ have;
+					}
+				}
+
+				src = voice.stream.empty() ? nullptr : &voice.stream[0];
+				avail = (have > 0) ? have - 1 : 0;
+			}
+			else
+			{
+				// One frame of silence is padded after the pcm
+				src = &(*voice.desc.pcm)[0];
+				avail = voice.desc.pcm->size() / channels - 1;
+			}
+
+			uint64_t const end = avail << 32;
+			uint32_t n = 0;
+			if (voice.pos < end)
+			{
+				n = static_cast<uint32_t>(std::min<uint64_t>((end - voice.pos + voice.step - 1) / voice.step, remain));
+			}
+
+			if (0 == n)
+			{
+				if (music != nullptr)
+				{
+					// Starved streams stay silent until fed
+					return !voice.drained_padded;
+				}
+				else if (voice.desc.loop && (avail > 0))
+				{
+					voice.pos -= end;
+					continue;
+				}
+				else
+				{
+					return false;
+				}
+			}
+
+			if (audible)
+			{
+				if (1 == channels)
+				{
+					MixMono(&mix_l_[out], &mix_r_[out], n, src, voice.pos, voice.step, voice.gain_l, voice.gain_r);
+				}
+				else
+				{
+					MixStereo(&mix_l_[out], &mix_r_[out], n, src, voice.pos, voice.step, voice.gain_l, voice.gain_r);
+				}
+			}
+			voice.pos += voice.step * n;
+			out += n;
+
+			if (music != nullptr)
+			{
+				uint64_t const consumed = std::min<uint64_t>(voice.pos >> 32, voice.stream.size() / channels);
+				voice.stream.erase(voice.stream.begin(), voice.stream.begin() + static_cast<size_t>(consumed * channels));
+				voice.pos -= consumed << 32;
+			}
+		}
+
+		return true;
+	}
+
+	void SMAudioEngine::FreeVoice(uint32_t index)
+	{
+		Voice& voice = voices_[index];
+		BOOST_ASSERT(voice.active);
+
+		uint32_t const last = active_voices_.back();
+		active_voices_[voice.active_index] = last;
+		voices_[last].active_index = voice.active_index;
+		active_voices_.pop_back();
+
+		voice.active = false;
+		++ voice.generation;
+		voice.desc.pcm.reset();
+		voice.desc.music = nullptr;
+		free_voices_.push_back(index);
+	}
+
+	SMAudioEngine::Voice* SMAudioEngine::FindVoice(uint64_t voice)
+	{
+		return const_cast<Voice*>(static_cast<SMAudioEngine const *>(this)->FindVoice(voice));
+	}
+
+	SMAudioEngine::Voice const * SMAudioEngine::FindVoice(uint64_t voice) const
+	{
+		uint32_t const index = static_cast<uint32_t>(voice & 0xFFFFFFFF) - 1;
+		if (index < voices_.size())
+		{
+			Voice const & v = voices_[index];
+			if (v.active && (v.generation == static_cast<uint32_t>(voice >> 32)))
+			{
+				return &v;
+			}
+		}
+		return nullptr;
+	}
+}
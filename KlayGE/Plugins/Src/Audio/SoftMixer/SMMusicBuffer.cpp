@@ -0,0 +1,226 @@
+/**
+ * @file SMMusicBuffer.cpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Util.hpp>
+#include <KlayGE/Context.hpp>
+#include <KlayGE/AudioFactory.hpp>
+#include <KlayGE/AudioDataSource.hpp>
+
+#include <algorithm>
+
+#include <boost/assert.hpp>
+
+#include <KlayGE/SoftMixer/SMAudio.hpp>
+
+namespace KlayGE
+{
+	SMMusicBuffer::SMMusicBuffer(AudioDataSourcePtr const & dataSource, uint32_t bufferSeconds, float volume)
+			: MusicBuffer(dataSource),
+				engine_(checked_cast<SMAudioEngine*>(&Context::Instance().AudioFactoryInstance().AudioEngineInstance())),
+				channels_(NumChannels(format_)),
+				bytes_per_sample_(BytesPerSample(format_)),
+				voice_(SMAudioEngine::INVALID_VOICE),
+				fed_by_mixer_(false),
+				fifo_read_(0), fifo_size_(0), end_of_stream_(false),
+				volume_(volume),
+				pos_(0, 0, 0.1f), vel_(0, 0, 0), dir_(0, 0, 0)
+	{
+		// The FIFO holds bufferSeconds / PreSecond seconds
+		size_t const num_frames = std::max<size_t>(static_cast<size_t>(freq_) * std::max(bufferSeconds, 1U) / PreSecond, 1);
+		fifo_.resize(num_frames * channels_);
+		feed_buffer_.resize(fifo_.size() * bytes_per_sample_);
+
+		this->Reset();
+	}
+
+	SMMusicBuffer::~SMMusicBuffer()
+	{
+		this->Stop();
+	}
+
+	void SMMusicBuffer::DoReset()
+	{
+		this->ResetDecoder();
+
+		std::lock_guard<std::mutex> lock(fifo_mutex_);
+		fifo_read_ = 0;
+		fifo_size_ = 0;
+		end_of_stream_ = false;
+	}
+
+	void SMMusicBuffer::DoPlay(bool loop)
+	{
+		loop_ = loop;
+
+		{
+			std::lock_guard<std::mutex> lock(fifo_mutex_);
+			end_of_stream_ = false;
+		}
+
+		// In offline mode the stream has to be in step with Render, so the mixer feeds it
+		fed_by_mixer_ = engine_->OfflineMode();
+
+		SMAudioEngine::VoiceDesc desc;
+		desc.music = this;
+		desc.channels = channels_;
+		desc.freq = freq_;
+		desc.loop = false;
+		desc.volume = volume_;
+		desc.pos = pos_;
+		voice_ = engine_->StartVoice(desc);
+
+		if (!fed_by_mixer_)
+		{
+			streaming_service_->Add(this);
+		}
+	}
+
+	void SMMusicBuffer::DoStop()
+	{
+		streaming_service_->Remove(this);
+
+		engine_->StopVoice(voice_);
+		voice_ = SMAudioEngine::INVALID_VOICE;
+
+		// Like a stopped OpenAL source, the queued data is dropped
+		std::lock_guard<std::mutex> lock(fifo_mutex_);
+		fifo_read_ = 0;
+		fifo_size_ = 0;
+	}
+
+	// Tops up the FIFO, and wakes up again when half of it is played
+	bool SMMusicBuffer::FeedDevice(uint32_t& next_service_ms)
+	{
+		size_t space;
+		{
+			std::lock_guard<std::mutex> lock(fifo_mutex_);
+			space = fifo_.size() - fifo_size_;
+		}
+
+		// Only the mixer takes from the FIFO in the meantime, so the space can only grow
+		size_t const num_frames = space / channels_;
+		if (num_frames > 0)
+		{
+			size_t const read = this->ReadDecoded(&feed_buffer_[0], num_frames * channels_ * bytes_per_sample_);
+			size_t const num_samples = read / bytes_per_sample_ / channels_ * channels_;
+
+			std::lock_guard<std::mutex> lock(fifo_mutex_);
+			if (0 == num_samples)
+			{
+				end_of_stream_ = true;
+				return false;
+			}
+
+			size_t const write = (fifo_read_ + fifo_size_) % fifo_.size();
+			size_t const first = std::min(num_samples, fifo_.size() - write);
+			ConvertToFloat(format_, &feed_buffer_[0], first, &fifo_[write]);
+			ConvertToFloat(format_, &feed_buffer_[first * bytes_per_sample_], num_samples - first, &fifo_[0]);
+			fifo_size_ += num_samples;
+		}
+
+		size_t buffered;
+		{
+			std::lock_guard<std::mutex> lock(fifo_mutex_);
+			buffered = fifo_size_ / channels_;
+		}
+		next_service_ms = std::max(static_cast<uint32_t>(buffered * 1000 / freq_ / 2), 1U);
+
+		return true;
+	}
+
+	uint32_t SMMusicBuffer::PullFrames(std::vector<float>& frames, uint32_t num_frames)
+	{
+		std::lock_guard<std::mutex> lock(fifo_mutex_);
+
+		size_t const num_samples = std::min<size_t>(num_frames * channels_, fifo_size_);
+		size_t const first = std::min(num_samples, fifo_.size() - fifo_read_);
+		frames.insert(frames.end(), fifo_.begin() + fifo_read_, fifo_.begin() + fifo_read_ + first);
+		frames.insert(frames.end(), fifo_.begin(), fifo_.begin() + (num_samples - first));
+		fifo_read_ = (fifo_read_ + num_samples) % fifo_.size();
+		fifo_size_ -= num_samples;
+
+		return static_cast<uint32_t>(num_samples / channels_);
+	}
+
+	bool SMMusicBuffer::Drained() const
+	{
+		std::lock_guard<std::mutex> lock(fifo_mutex_);
+		return end_of_stream_ && (0 == fifo_size_);
+	}
+
+	bool SMMusicBuffer::FedByMixer() const
+	{
+		return fed_by_mixer_;
+	}
+
+	bool SMMusicBuffer::IsPlaying() const
+	{
+		return engine_->IsVoicePlaying(voice_);
+	}
+
+	void SMMusicBuffer::Volume(float vol)
+	{
+		volume_ = vol;
+		engine_->VoiceVolume(voice_, vol);
+	}
+
+	float3 SMMusicBuffer::Position() const
+	{
+		return pos_;
+	}
+
+	void SMMusicBuffer::Position(float3 const & v)
+	{
+		pos_ = v;
+		engine_->VoicePosition(voice_, v);
+	}
+
+	float3 SMMusicBuffer::Velocity() const
+	{
+		return vel_;
+	}
+
+	void SMMusicBuffer::Velocity(float3 const & v)
+	{
+		vel_ = v;
+	}
+
+	float3 SMMusicBuffer::Direction() const
+	{
+		return dir_;
+	}
+
+	void SMMusicBuffer::Direction(float3 const & v)
+	{
+		dir_ = v;
+	}
+}
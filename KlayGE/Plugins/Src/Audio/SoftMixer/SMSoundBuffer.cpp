@@ -0,0 +1,174 @@
+/**
+ * @file SMSoundBuffer.cpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Util.hpp>
+#include <KlayGE/Context.hpp>
+#include <KlayGE/AudioFactory.hpp>
+#include <KlayGE/AudioDataSource.hpp>
+
+#include <boost/assert.hpp>
+
+#include <KlayGE/SoftMixer/SMAudio.hpp>
+
+namespace KlayGE
+{
+	SMSoundBuffer::SMSoundBuffer(AudioDataSourcePtr const & dataSource, uint32_t numSource, float volume)
+			: SoundBuffer(dataSource),
+				engine_(checked_cast<SMAudioEngine*>(&Context::Instance().AudioFactoryInstance().AudioEngineInstance())),
+				pcm_(MakeSharedPtr<std::vector<float>>()),
+				channels_(NumChannels(format_)),
+				voices_(numSource, SMAudioEngine::INVALID_VOICE),
+				next_steal_(0),
+				volume_(volume),
+				pos_(0, 0, 0.1f), vel_(0, 0, 0), dir_(0, 0, 0)
+	{
+		BOOST_ASSERT(numSource > 0);
+
+		std::vector<uint8_t> data(dataSource_->Size());
+		size_t const size = data.empty() ? 0 : dataSource_->Read(&data[0], data.size());
+
+		size_t const num_samples = size / BytesPerSample(format_) / channels_ * channels_;
+
+		// One more frame of silence, so the last frame can be interpolated
+		pcm_->resize(num_samples + channels_, 0.0f);
+		ConvertToFloat(format_, data.empty() ? nullptr : &data[0], num_samples, &(*pcm_)[0]);
+	}
+
+	SMSoundBuffer::~SMSoundBuffer()
+	{
+		this->Stop();
+	}
+
+	// Takes a voice that has finished, or the oldest started one if all of them are playing
+	void SMSoundBuffer::Play(bool loop)
+	{
+		uint64_t* slot = nullptr;
+		for (auto& voice : voices_)
+		{
+			if (!engine_->IsVoicePlaying(voice))
+			{
+				slot = &voice;
+				break;
+			}
+		}
+		if (nullptr == slot)
+		{
+			slot = &voices_[next_steal_];
+			next_steal_ = (next_steal_ + 1) % voices_.size();
+			engine_->StopVoice(*slot);
+		}
+
+		SMAudioEngine::VoiceDesc desc;
+		desc.pcm = pcm_;
+		desc.music = nullptr;
+		desc.channels = channels_;
+		desc.freq = freq_;
+		desc.loop = loop;
+		desc.volume = volume_;
+		desc.pos = pos_;
+		*slot = engine_->StartVoice(desc);
+	}
+
+	void SMSoundBuffer::Stop()
+	{
+		for (auto& voice : voices_)
+		{
+			engine_->StopVoice(voice);
+			voice = SMAudioEngine::INVALID_VOICE;
+		}
+	}
+
+	void SMSoundBuffer::DoReset()
+	{
+		for (auto const & voice : voices_)
+		{
+			engine_->RewindVoice(voice);
+		}
+	}
+
+	bool SMSoundBuffer::IsPlaying() const
+	{
+		for (auto const & voice : voices_)
+		{
+			if (engine_->IsVoicePlaying(voice))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void SMSoundBuffer::Volume(float vol)
+	{
+		volume_ = vol;
+		for (auto const & voice : voices_)
+		{
+			engine_->VoiceVolume(voice, vol);
+		}
+	}
+
+	float3 SMSoundBuffer::Position() const
+	{
+		return pos_;
+	}
+
+	void SMSoundBuffer::Position(float3 const & v)
+	{
+		pos_ = v;
+		for (auto const & voice : voices_)
+		{
+			engine_->VoicePosition(voice, v);
+		}
+	}
+
+	// The mixer has no doppler effect, the velocity is only kept
+	float3 SMSoundBuffer::Velocity() const
+	{
+		return vel_;
+	}
+
+	void SMSoundBuffer::Velocity(float3 const & v)
+	{
+		vel_ = v;
+	}
+
+	// Sources are omnidirectional, the direction is only kept
+	float3 SMSoundBuffer::Direction() const
+	{
+		return dir_;
+	}
+
+	void SMSoundBuffer::Direction(float3 const & v)
+	{
+		dir_ = v;
+	}
+}
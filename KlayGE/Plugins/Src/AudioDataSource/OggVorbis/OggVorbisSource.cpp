@@ -16,8 +16,10 @@
 #include <KlayGE/KlayGE.hpp>
 #include <KFL/ThrowErr.hpp>
 #include <KlayGE/ResLoader.hpp>
+#include <KlayGE/Context.hpp>
 #include <KlayGE/AudioDataSource.hpp>
 
+#include <algorithm>
 #include <vector>
 #include <cstring>
 #include <boost/assert.hpp>
@@ -26,17 +28,30 @@
 
 namespace KlayGE
 {
+	uint32_t const OggVorbisSource::CHUNK_FRAMES;
+	uint32_t const OggVorbisSource::MAX_CACHED_CHUNKS;
+	uint32_t const OggVorbisSource::PRESERVE_COMPRESSED_SIZE;
+
 	// 캯
 	/////////////////////////////////////////////////////////////////////////////////
 	OggVorbisSource::OggVorbisSource()
+		: length_(0), compressed_pos_(0), opened_(false),
+			bytes_per_frame_(0), total_frames_(0), cursor_(0), decode_pos_(0),
+			use_tick_(0), prefetching_(false)
 	{
+		for (auto& chunk : chunks_)
+		{
+			chunk.valid = false;
+			chunk.decoding = false;
+			chunk.last_use = 0;
+		}
 	}
 
 	// 
 	/////////////////////////////////////////////////////////////////////////////////
 	OggVorbisSource::~OggVorbisSource()
 	{
-		ov_clear(&vf_);
+		this->Close();
 	}
 
 	void OggVorbisSource::Open(ResIdentifierPtr const & file)
@@ -47,6 +62,15 @@ namespace KlayGE
 		length_ = oggFile_->tellg();
 		oggFile_->seekg(0, std::ios_base::beg);
 
+		if ((length_ > 0) && (length_ <= PRESERVE_COMPRESSED_SIZE))
+		{
+			// Short clips are decoded from memory, and don't hold the file
+			compressed_.resize(static_cast<size_t>(length_));
+			oggFile_->read(&compressed_[0], static_cast<std::streamsize>(length_));
+			compressed_pos_ = 0;
+			oggFile_.reset();
+		}
+
 		ov_callbacks vorbis_callbacks;
 		vorbis_callbacks.read_func = OggVorbisSource::VorbisRead;
 		vorbis_callbacks.close_func = OggVorbisSource::VorbisClose;
@@ -54,18 +78,40 @@ namespace KlayGE
 		vorbis_callbacks.tell_func = OggVorbisSource::VorbisTell;
 
 		Verify(0 == ov_open_callbacks(this, &vf_, nullptr, 0, vorbis_callbacks));
+		opened_ = true;
 
 		vorbis_info* vorbis_info = ov_info(&vf_, -1);
 		format_ = (1 == vorbis_info->channels) ? AF_Mono16 : AF_Stereo16;
 		freq_ = vorbis_info->rate;
 
+		bytes_per_frame_ = vorbis_info->channels * sizeof(ogg_int16_t);
+		total_frames_ = static_cast<uint64_t>(std::max<ogg_int64_t>(ov_pcm_total(&vf_, -1), 0));
+		decode_pos_ = 0;
+
 		this->Reset();
 	}
 
 	void OggVorbisSource::Close()
 	{
+		this->WaitForPrefetch();
+
+		if (opened_)
+		{
+			ov_clear(&vf_);
+			opened_ = false;
+		}
+
 		oggFile_.reset();
-		this->Reset();
+		compressed_.clear();
+		compressed_pos_ = 0;
+
+		for (auto& chunk : chunks_)
+		{
+			chunk.valid = false;
+			chunk.pcm.clear();
+		}
+		total_frames_ = 0;
+		cursor_ = 0;
 	}
 
 	// ȡOgg
@@ -74,25 +120,37 @@ namespace KlayGE
 	{
 		BOOST_ASSERT(data != nullptr);
 
-		char* pcm = static_cast<char*>(data);
+		uint8_t* pcm = static_cast<uint8_t*>(data);
 
 		size_t cur_size = 0;
-		int section;
-		while (cur_size < size)
+		while ((cur_size + bytes_per_frame_ <= size) && (cursor_ < total_frames_))
 		{
-			int result = ov_read(&vf_, pcm + cur_size, static_cast<int>(size - cur_size), 0, 2, 1, &section);
+			uint64_t const index = cursor_ / CHUNK_FRAMES;
+			uint32_t const offset = static_cast<uint32_t>(cursor_ % CHUNK_FRAMES);
 
-			if (result > 0)
-			{
-				cur_size += result;
-			}
-			else
+			uint32_t num_frames;
 			{
-				if (result <= 0)
+				std::unique_lock<std::mutex> lock(cache_mutex_);
+				Chunk const & chunk = this->AcquireChunk(index, lock);
+
+				num_frames = static_cast<uint32_t>(std::min<size_t>(chunk.num_frames - std::min(offset, chunk.num_frames),
+					(size - cur_size) / bytes_per_frame_));
+				if (num_frames > 0)
 				{
-					break;
+					std::memcpy(pcm + cur_size, &chunk.pcm[offset * bytes_per_frame_], num_frames * bytes_per_frame_);
 				}
 			}
+
+			this->Prefetch(index + 1);
+
+			if (0 == num_frames)
+			{
+				// A corrupted chunk ends the stream early
+				break;
+			}
+
+			cur_size += num_frames * bytes_per_frame_;
+			cursor_ += num_frames;
 		}
 
 		return cur_size;
@@ -102,16 +160,183 @@ namespace KlayGE
 	/////////////////////////////////////////////////////////////////////////////////
 	size_t OggVorbisSource::Size()
 	{
-		vorbis_info* vorbis_info = ov_info(&vf_, -1);
-		return static_cast<size_t>(ov_pcm_total(&vf_, -1) * vorbis_info->channels * sizeof(ogg_int16_t));
+		return static_cast<size_t>(total_frames_ * bytes_per_frame_);
 	}
 
 	// Դλ
 	/////////////////////////////////////////////////////////////////////////////////
 	void OggVorbisSource::Reset()
 	{
-		oggFile_->clear();
-		ov_pcm_seek(&vf_, 0);
+		this->SeekFrame(0);
+	}
+
+	void OggVorbisSource::SeekFrame(uint64_t frame)
+	{
+		cursor_ = std::min(frame, total_frames_);
+		this->Prefetch(cursor_ / CHUNK_FRAMES);
+	}
+
+	// Called with cache_mutex_ locked. Waits for the chunk if it's being decoded, or decodes it on this thread if it's
+	//  not in the cache.
+	OggVorbisSource::Chunk const & OggVorbisSource::AcquireChunk(uint64_t index, std::unique_lock<std::mutex>& lock)
+	{
+		for (;;)
+		{
+			Chunk* chunk = this->FindChunk(index);
+			if (chunk != nullptr)
+			{
+				if (!chunk->decoding)
+				{
+					chunk->last_use = ++ use_tick_;
+					return *chunk;
+				}
+
+				chunk_ready_.wait(lock);
+			}
+			else
+			{
+				chunk = this->ClaimChunk(index);
+				if (nullptr == chunk)
+				{
+					chunk_ready_.wait(lock);
+				}
+				else
+				{
+					lock.unlock();
+					this->DecodeChunk(*chunk);
+					lock.lock();
+
+					chunk->decoding = false;
+					chunk_ready_.notify_all();
+				}
+			}
+		}
+	}
+
+	// Called with cache_mutex_ locked
+	OggVorbisSource::Chunk* OggVorbisSource::FindChunk(uint64_t index)
+	{
+		for (auto& chunk : chunks_)
+		{
+			if (chunk.valid && (chunk.index == index))
+			{
+				return &chunk;
+			}
+		}
+		return nullptr;
+	}
+
+	// Called with cache_mutex_ locked. Takes the least recently used chunk that is not being decoded, and marks it as
+	//  being decoded for index.
+	OggVorbisSource::Chunk* OggVorbisSource::ClaimChunk(uint64_t index)
+	{
+		Chunk* lru = nullptr;
+		for (auto& chunk : chunks_)
+		{
+			if (!chunk.decoding && ((nullptr == lru) || (chunk.last_use < lru->last_use)))
+			{
+				lru = &chunk;
+			}
+		}
+
+		if (lru != nullptr)
+		{
+			lru->index = index;
+			lru->num_frames = 0;
+			lru->last_use = ++ use_tick_;
+			lru->valid = true;
+			lru->decoding = true;
+		}
+		return lru;
+	}
+
+	// The chunk is marked as being decoded, so nothing else touches it
+	void OggVorbisSource::DecodeChunk(Chunk& chunk)
+	{
+		std::lock_guard<std::mutex> lock(decode_mutex_);
+
+		uint64_t const start = chunk.index * CHUNK_FRAMES;
+		uint32_t const num_frames = static_cast<uint32_t>(std::min<uint64_t>(CHUNK_FRAMES, total_frames_ - start));
+		chunk.pcm.resize(CHUNK_FRAMES * bytes_per_frame_);
+
+		if (decode_pos_ != start)
+		{
+			if (oggFile_)
+			{
+				oggFile_->clear();
+			}
+			// Sample accurate
+			ov_pcm_seek(&vf_, static_cast<ogg_int64_t>(start));
+			decode_pos_ = start;
+		}
+
+		char* pcm = reinterpret_cast<char*>(&chunk.pcm[0]);
+		size_t const size = num_frames * bytes_per_frame_;
+		size_t cur_size = 0;
+		int section;
+		while (cur_size < size)
+		{
+			int result = ov_read(&vf_, pcm + cur_size, static_cast<int>(size - cur_size), 0, 2, 1, &section);
+			if (result > 0)
+			{
+				cur_size += result;
+			}
+			else
+			{
+				break;
+			}
+		}
+
+		chunk.num_frames = static_cast<uint32_t>(cur_size / bytes_per_frame_);
+		decode_pos_ += chunk.num_frames;
+	}
+
+	// Decodes the chunk on the thread pool, if it's not cached and no other chunk is being decoded ahead
+	void OggVorbisSource::Prefetch(uint64_t index)
+	{
+		if (index * CHUNK_FRAMES >= total_frames_)
+		{
+			return;
+		}
+
+		Chunk* chunk;
+		{
+			std::lock_guard<std::mutex> lock(cache_mutex_);
+			if (prefetching_ || (this->FindChunk(index) != nullptr))
+			{
+				return;
+			}
+
+			chunk = this->ClaimChunk(index);
+			if (nullptr == chunk)
+			{
+				return;
+			}
+			prefetching_ = true;
+		}
+
+		// The previous job has finished, only need to release it
+		this->WaitForPrefetch();
+
+		prefetch_ = MakeUniquePtr<joiner<void>>(Context::Instance().ThreadPool()(
+			[this, chunk]
+			{
+				this->DecodeChunk(*chunk);
+
+				std::lock_guard<std::mutex> lock(cache_mutex_);
+				chunk->decoding = false;
+				prefetching_ = false;
+				chunk_ready_.notify_all();
+			}));
+	}
+
+	void OggVorbisSource::WaitForPrefetch()
+	{
+		if (prefetch_)
+		{
+			(*prefetch_)();
+			prefetch_.reset();
+		}
 	}
 
 	size_t OggVorbisSource::VorbisRead(void* ptr, size_t byte_size, size_t size_to_read, void* datasource)
@@ -119,9 +344,12 @@ namespace KlayGE
 		// Get the data in the right format
 		OggVorbisSource* vorbis_data = static_cast<OggVorbisSource*>(datasource);
 
+		int64_t const cur_pos = vorbis_data->compressed_.empty()
+			? static_cast<int64_t>(vorbis_data->oggFile_->tellg()) : vorbis_data->compressed_pos_;
+
 		size_t actual_size_to_read;	// How much data we are actually going to read from memory
 		// Calculate how much we need to read.  This can be sizeToRead*byteSize or less depending on how near the EOF marker we are
-		size_t space_to_eof = static_cast<size_t>(vorbis_data->length_ - vorbis_data->oggFile_->tellg());
+		size_t space_to_eof = static_cast<size_t>(vorbis_data->length_ - cur_pos);
 		if (size_to_read * byte_size < space_to_eof)
 		{
 			actual_size_to_read = size_to_read * byte_size;
@@ -134,7 +362,15 @@ namespace KlayGE
 		// A simple copy of the data from memory to the datastruct that the vorbis libs will use
 		if (actual_size_to_read > 0)
 		{
-			vorbis_data->oggFile_->read(ptr, static_cast<std::streamsize>(actual_size_to_read));
+			if (vorbis_data->compressed_.empty())
+			{
+				vorbis_data->oggFile_->read(ptr, static_cast<std::streamsize>(actual_size_to_read));
+			}
+			else
+			{
+				std::memcpy(ptr, &vorbis_data->compressed_[static_cast<size_t>(cur_pos)], actual_size_to_read);
+				vorbis_data->compressed_pos_ += actual_size_to_read;
+			}
 		}
 
 		// Return how much we read (in the same way fread would)
@@ -166,7 +402,27 @@ namespace KlayGE
 			break;
 		};
 
-		vorbis_data->oggFile_->seekg(static_cast<long>(offset), dir);
+		if (vorbis_data->compressed_.empty())
+		{
+			vorbis_data->oggFile_->seekg(static_cast<long>(offset), dir);
+		}
+		else
+		{
+			int64_t base;
+			if (std::ios_base::beg == dir)
+			{
+				base = 0;
+			}
+			else if (std::ios_base::cur == dir)
+			{
+				base = vorbis_data->compressed_pos_;
+			}
+			else
+			{
+				base = vorbis_data->length_;
+			}
+			vorbis_data->compressed_pos_ = std::min(std::max<int64_t>(base + offset, 0), vorbis_data->length_);
+		}
 
 		return 0;
 	}
@@ -181,6 +437,13 @@ namespace KlayGE
 	long OggVorbisSource::VorbisTell(void* datasource)
 	{
 		OggVorbisSource* vorbis_data = static_cast<OggVorbisSource*>(datasource);
-		return static_cast<long>(vorbis_data->oggFile_->tellg());
+		if (vorbis_data->compressed_.empty())
+		{
+			return static_cast<long>(vorbis_data->oggFile_->tellg());
+		}
+		else
+		{
+			return static_cast<long>(vorbis_data->compressed_pos_);
+		}
 	}
 }
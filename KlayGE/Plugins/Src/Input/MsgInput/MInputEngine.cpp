@@ -119,6 +119,11 @@ namespace KlayGE
 	void MsgInputEngine::EnumDevices()
 	{
 		WindowPtr const & main_wnd = Context::Instance().AppInstance().MainWnd();
+		if (!main_wnd)
+		{
+			return;
+		}
+
 #if defined KLAYGE_PLATFORM_WINDOWS_DESKTOP
 		HWND hwnd = main_wnd->HWnd();
 			
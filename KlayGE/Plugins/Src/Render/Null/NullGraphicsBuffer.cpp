@@ -0,0 +1,111 @@
+/**
+ * @file NullGraphicsBuffer.cpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Util.hpp>
+#include <KlayGE/Context.hpp>
+#include <KlayGE/RenderFactory.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+#include <boost/assert.hpp>
+
+#include <KlayGE/Null/NullRenderEngine.hpp>
+#include <KlayGE/Null/NullGraphicsBuffer.hpp>
+
+namespace KlayGE
+{
+	NullGraphicsBuffer::NullGraphicsBuffer(BufferUsage usage, uint32_t access_hint, uint32_t size_in_byte, ElementFormat fmt)
+			: GraphicsBuffer(usage, access_hint, size_in_byte),
+				fmt_as_shader_res_(fmt), last_ba_(BA_Read_Only)
+	{
+	}
+
+	void NullGraphicsBuffer::CreateHWResource(void const * init_data)
+	{
+		NullRenderEngine& re = *checked_cast<NullRenderEngine*>(&Context::Instance().RenderFactoryInstance().RenderEngineInstance());
+		re.AddStatistics(NullRenderEngine::SC_Buffers, 1);
+
+		if (init_data != nullptr)
+		{
+			buf_data_.assign(static_cast<uint8_t const *>(init_data),
+				static_cast<uint8_t const *>(init_data) + size_in_byte_);
+
+			re.AddStatistics(NullRenderEngine::SC_BytesUploaded, size_in_byte_);
+		}
+		else
+		{
+			buf_data_.assign(size_in_byte_, 0);
+		}
+	}
+
+	void NullGraphicsBuffer::DeleteHWResource()
+	{
+		buf_data_.clear();
+		buf_data_.shrink_to_fit();
+	}
+
+	void* NullGraphicsBuffer::Map(BufferAccess ba)
+	{
+		BOOST_ASSERT(buf_data_.size() == size_in_byte_);
+
+		last_ba_ = ba;
+		return buf_data_.data();
+	}
+
+	// Written maps count as uploading the whole buffer, as a driver would do for a discarded buffer
+	void NullGraphicsBuffer::Unmap()
+	{
+		if (last_ba_ != BA_Read_Only)
+		{
+			NullRenderEngine& re = *checked_cast<NullRenderEngine*>(&Context::Instance().RenderFactoryInstance().RenderEngineInstance());
+			re.AddStatistics(NullRenderEngine::SC_BytesUploaded, size_in_byte_);
+		}
+	}
+
+	void NullGraphicsBuffer::CopyToBuffer(GraphicsBuffer& rhs)
+	{
+		BOOST_ASSERT(size_in_byte_ <= rhs.Size());
+
+		NullGraphicsBuffer& dst = *checked_cast<NullGraphicsBuffer*>(&rhs);
+		std::memcpy(dst.buf_data_.data(), buf_data_.data(), size_in_byte_);
+	}
+
+	void NullGraphicsBuffer::UpdateSubresource(uint32_t offset, uint32_t size, void const * data)
+	{
+		BOOST_ASSERT(offset + size <= size_in_byte_);
+
+		std::memcpy(buf_data_.data() + offset, data, size);
+
+		NullRenderEngine& re = *checked_cast<NullRenderEngine*>(&Context::Instance().RenderFactoryInstance().RenderEngineInstance());
+		re.AddStatistics(NullRenderEngine::SC_BytesUploaded, size);
+	}
+}
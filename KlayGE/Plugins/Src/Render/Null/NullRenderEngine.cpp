@@ -0,0 +1,337 @@
+/**
+ * @file NullRenderEngine.cpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Util.hpp>
+#include <KFL/Hash.hpp>
+#include <KlayGE/Context.hpp>
+#include <KlayGE/RenderFactory.hpp>
+#include <KlayGE/RenderEffect.hpp>
+#include <KlayGE/RenderLayout.hpp>
+#include <KlayGE/RenderSettings.hpp>
+
+#include <algorithm>
+
+#include <boost/assert.hpp>
+
+#include <KlayGE/Null/NullFrameBuffer.hpp>
+#include <KlayGE/Null/NullRenderEngine.hpp>
+
+namespace
+{
+	using namespace KlayGE;
+
+	uint32_t NumPrimitives(RenderLayout::topology_type tt, uint32_t vertex_count)
+	{
+		switch (tt)
+		{
+		case RenderLayout::TT_PointList:
+			return vertex_count;
+
+		case RenderLayout::TT_LineList:
+			return vertex_count / 2;
+
+		case RenderLayout::TT_LineStrip:
+			return std::max(vertex_count, 1U) - 1;
+
+		case RenderLayout::TT_TriangleList:
+			return vertex_count / 3;
+
+		case RenderLayout::TT_TriangleStrip:
+			return std::max(vertex_count, 2U) - 2;
+
+		case RenderLayout::TT_LineList_Adj:
+			return vertex_count / 4;
+
+		case RenderLayout::TT_LineStrip_Adj:
+			return std::max(vertex_count, 3U) - 3;
+
+		case RenderLayout::TT_TriangleList_Adj:
+			return vertex_count / 6;
+
+		case RenderLayout::TT_TriangleStrip_Adj:
+			return std::max(vertex_count, 4U) / 2 - 2;
+
+		default:
+			return vertex_count / (tt - RenderLayout::TT_1_Ctrl_Pt_PatchList + 1);
+		}
+	}
+
+	char const * const statistics_names[] =
+	{
+		"NUM_DRAWS",
+		"NUM_DISPATCHES",
+		"NUM_PRIMITIVES",
+		"NUM_VERTICES",
+		"NUM_BYTES_UPLOADED",
+		"NUM_STATE_CHANGES",
+		"NUM_SHADER_BINDS",
+		"NUM_FRAME_BUFFER_BINDS",
+		"NUM_TEXTURES",
+		"NUM_BUFFERS"
+	};
+	static_assert(sizeof(statistics_names) / sizeof(statistics_names[0]) == NullRenderEngine::SC_NumCounters, "Wrong number of statistics names.");
+}
+
+namespace KlayGE
+{
+	NullRenderEngine::NullRenderEngine()
+		: full_screen_(false)
+	{
+		this->ResetStatistics();
+
+		native_shader_fourcc_ = MakeFourCC<'N', 'U', 'L', 'L'>::value;
+		native_shader_version_ = 1;
+		native_shader_platform_name_ = "null";
+	}
+
+	NullRenderEngine::~NullRenderEngine()
+	{
+		this->Destroy();
+	}
+
+	std::wstring const & NullRenderEngine::Name() const
+	{
+		static const std::wstring name(L"Null Render Engine");
+		return name;
+	}
+
+	void NullRenderEngine::ForceFlush()
+	{
+	}
+
+	TexturePtr const & NullRenderEngine::ScreenDepthStencilTexture() const
+	{
+		return screen_ds_tex_;
+	}
+
+	void NullRenderEngine::ScissorRect(uint32_t /*x*/, uint32_t /*y*/, uint32_t /*width*/, uint32_t /*height*/)
+	{
+	}
+
+	bool NullRenderEngine::FullScreen() const
+	{
+		return full_screen_;
+	}
+
+	void NullRenderEngine::FullScreen(bool fs)
+	{
+		full_screen_ = fs;
+	}
+
+	void NullRenderEngine::GetCustomAttrib(std::string const & name, void* value)
+	{
+		size_t const name_hash = RT_HASH(name.c_str());
+		for (uint32_t i = 0; i < SC_NumCounters; ++ i)
+		{
+			if (RT_HASH(statistics_names[i]) == name_hash)
+			{
+				*static_cast<uint64_t*>(value) = statistics_[i];
+				break;
+			}
+		}
+	}
+
+	void NullRenderEngine::SetCustomAttrib(std::string const & name, void* /*value*/)
+	{
+		size_t const name_hash = RT_HASH(name.c_str());
+		if (CT_HASH("RESET_STATISTICS") == name_hash)
+		{
+			this->ResetStatistics();
+		}
+	}
+
+	void NullRenderEngine::ResetStatistics()
+	{
+		for (auto& stat : statistics_)
+		{
+			stat = 0;
+		}
+	}
+
+	// Nothing can be presented, so all the post processes, which would only cost time and memory, are turned off
+	void NullRenderEngine::CheckConfig(RenderSettings& settings)
+	{
+		settings.hide_win = true;
+		settings.hdr = false;
+		settings.ppaa = false;
+		settings.gamma = false;
+		settings.color_grading = false;
+		settings.stereo_method = STM_None;
+	}
+
+	void NullRenderEngine::DoCreateRenderWindow(std::string const & /*name*/, RenderSettings const & settings)
+	{
+		motion_frames_ = settings.motion_frames;
+
+		this->FillRenderDeviceCaps();
+
+		FrameBufferPtr win = MakeSharedPtr<NullFrameBuffer>(settings.width, settings.height);
+		this->BindFrameBuffer(win);
+	}
+
+	void NullRenderEngine::DoBindFrameBuffer(FrameBufferPtr const & fb)
+	{
+		BOOST_ASSERT(fb);
+		KFL_UNUSED(fb);
+
+		this->AddStatistics(SC_FrameBufferBinds, 1);
+	}
+
+	void NullRenderEngine::DoBindSOBuffers(RenderLayoutPtr const & /*rl*/)
+	{
+	}
+
+	void NullRenderEngine::DoRender(RenderEffect const & effect, RenderTechnique const & tech, RenderLayout const & rl)
+	{
+		uint32_t const num_instances = std::max(rl.NumInstances(), 1U);
+		uint32_t const vertex_count = rl.UseIndices() ? rl.NumIndices() : rl.NumVertices();
+		uint32_t const prim_count = NumPrimitives(rl.TopologyType(), vertex_count);
+		uint32_t const num_passes = tech.NumPasses();
+
+		this->RunPasses(effect, tech);
+
+		num_primitives_just_rendered_ += num_instances * prim_count * num_passes;
+		num_vertices_just_rendered_ += num_instances * vertex_count * num_passes;
+		num_draws_just_called_ += num_passes;
+
+		this->AddStatistics(SC_Draws, num_passes);
+		this->AddStatistics(SC_Primitives, static_cast<uint64_t>(num_instances) * prim_count * num_passes);
+		this->AddStatistics(SC_Vertices, static_cast<uint64_t>(num_instances) * vertex_count * num_passes);
+	}
+
+	void NullRenderEngine::DoDispatch(RenderEffect const & effect, RenderTechnique const & tech,
+		uint32_t /*tgx*/, uint32_t /*tgy*/, uint32_t /*tgz*/)
+	{
+		uint32_t const num_passes = tech.NumPasses();
+
+		this->RunPasses(effect, tech);
+
+		num_dispatches_just_called_ += num_passes;
+		this->AddStatistics(SC_Dispatches, num_passes);
+	}
+
+	void NullRenderEngine::DoDispatchIndirect(RenderEffect const & effect, RenderTechnique const & tech,
+		GraphicsBufferPtr const & /*buff_args*/, uint32_t /*offset*/)
+	{
+		this->DoDispatch(effect, tech, 0, 0, 0);
+	}
+
+	// Binding the passes applies the states and updates the shader parameters, which is the CPU side cost of a draw
+	void NullRenderEngine::RunPasses(RenderEffect const & effect, RenderTechnique const & tech)
+	{
+		uint32_t const num_passes = tech.NumPasses();
+		for (uint32_t i = 0; i < num_passes; ++ i)
+		{
+			auto& pass = tech.Pass(i);
+
+			pass.Bind(effect);
+			pass.Unbind(effect);
+		}
+	}
+
+	void NullRenderEngine::DoResize(uint32_t width, uint32_t height)
+	{
+		checked_cast<NullFrameBuffer*>(screen_frame_buffer_.get())->Resize(width, height);
+	}
+
+	void NullRenderEngine::DoDestroy()
+	{
+		screen_ds_tex_.reset();
+	}
+
+	void NullRenderEngine::DoSuspend()
+	{
+	}
+
+	void NullRenderEngine::DoResume()
+	{
+	}
+
+	void NullRenderEngine::FillRenderDeviceCaps()
+	{
+		caps_.max_shader_model = ShaderModel(5, 0);
+
+		caps_.max_texture_width = caps_.max_texture_height = 16384;
+		caps_.max_texture_depth = 2048;
+		caps_.max_texture_cube_size = 16384;
+		caps_.max_texture_array_length = 2048;
+		caps_.max_vertex_texture_units = 16;
+		caps_.max_pixel_texture_units = 16;
+		caps_.max_geometry_texture_units = 16;
+		caps_.max_simultaneous_rts = 8;
+		caps_.max_simultaneous_uavs = 8;
+		caps_.max_vertex_streams = 16;
+		caps_.max_texture_anisotropy = 16;
+
+		caps_.is_tbdr = false;
+
+		caps_.hw_instancing_support = true;
+		caps_.instance_id_support = true;
+		caps_.stream_output_support = true;
+		caps_.alpha_to_coverage_support = true;
+		caps_.primitive_restart_support = true;
+		caps_.multithread_rendering_support = false;
+		caps_.multithread_res_creating_support = true;
+		caps_.mrt_independent_bit_depths_support = true;
+		caps_.standard_derivatives_support = true;
+		caps_.shader_texture_lod_support = true;
+		caps_.logic_op_support = true;
+		caps_.independent_blend_support = true;
+		caps_.depth_texture_support = true;
+		caps_.fp_color_support = true;
+		caps_.pack_to_rgba_required = false;
+		caps_.draw_indirect_support = true;
+		caps_.no_overwrite_support = true;
+		caps_.full_npot_texture_support = true;
+		caps_.render_to_texture_array_support = true;
+		caps_.load_from_buffer_support = true;
+
+		caps_.gs_support = true;
+		caps_.cs_support = true;
+		caps_.hs_support = true;
+		caps_.ds_support = true;
+		caps_.tess_method = TM_Hardware;
+
+		// Every format is kept as plain bytes, so all of them are supported
+		caps_.vertex_format_support = [](ElementFormat /*elem_fmt*/)
+			{
+				return true;
+			};
+		caps_.texture_format_support = [](ElementFormat /*elem_fmt*/)
+			{
+				return true;
+			};
+		caps_.rendertarget_format_support = [](ElementFormat /*elem_fmt*/, uint32_t /*sample_count*/, uint32_t /*sample_quality*/)
+			{
+				return true;
+			};
+	}
+}
@@ -0,0 +1,119 @@
+/**
+ * @file NullShaderObject.cpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Util.hpp>
+#include <KFL/ResIdentifier.hpp>
+#include <KlayGE/Context.hpp>
+#include <KlayGE/RenderFactory.hpp>
+
+#include <ostream>
+
+#include <KlayGE/Null/NullRenderEngine.hpp>
+#include <KlayGE/Null/NullShaderObject.hpp>
+
+namespace KlayGE
+{
+	NullShaderObject::NullShaderObject()
+	{
+		is_shader_validate_.fill(false);
+		is_validate_ = false;
+	}
+
+	bool NullShaderObject::AttachNativeShader(ShaderType type, RenderEffect const & /*effect*/,
+		std::array<uint32_t, ST_NumShaderTypes> const & /*shader_desc_ids*/, std::vector<uint8_t> const & /*native_shader_block*/)
+	{
+		is_shader_validate_[type] = true;
+		return true;
+	}
+
+	bool NullShaderObject::StreamIn(ResIdentifierPtr const & res, ShaderType type, RenderEffect const & effect,
+		std::array<uint32_t, ST_NumShaderTypes> const & shader_desc_ids)
+	{
+		uint32_t len;
+		res->read(&len, sizeof(len));
+		len = LE2Native(len);
+		std::vector<uint8_t> native_shader_block(len);
+		if (len > 0)
+		{
+			res->read(&native_shader_block[0], len * sizeof(native_shader_block[0]));
+		}
+
+		return this->AttachNativeShader(type, effect, shader_desc_ids, native_shader_block);
+	}
+
+	void NullShaderObject::StreamOut(std::ostream& os, ShaderType /*type*/)
+	{
+		uint32_t const len = Native2LE(0U);
+		os.write(reinterpret_cast<char const *>(&len), sizeof(len));
+	}
+
+	void NullShaderObject::AttachShader(ShaderType type, RenderEffect const & /*effect*/,
+		RenderTechnique const & /*tech*/, RenderPass const & /*pass*/,
+		std::array<uint32_t, ST_NumShaderTypes> const & /*shader_desc_ids*/)
+	{
+		is_shader_validate_[type] = true;
+	}
+
+	void NullShaderObject::AttachShader(ShaderType type, RenderEffect const & /*effect*/,
+		RenderTechnique const & /*tech*/, RenderPass const & /*pass*/, ShaderObjectPtr const & shared_so)
+	{
+		is_shader_validate_[type] = shared_so->ShaderValidate(type);
+	}
+
+	// Only the attached stages are validated, and all of them are
+	void NullShaderObject::LinkShaders(RenderEffect const & /*effect*/)
+	{
+		is_validate_ = true;
+	}
+
+	ShaderObjectPtr NullShaderObject::Clone(RenderEffect const & /*effect*/)
+	{
+		auto ret = MakeSharedPtr<NullShaderObject>();
+		ret->is_shader_validate_ = is_shader_validate_;
+		ret->is_validate_ = is_validate_;
+		ret->has_discard_ = has_discard_;
+		ret->has_tessellation_ = has_tessellation_;
+		ret->cs_block_size_x_ = cs_block_size_x_;
+		ret->cs_block_size_y_ = cs_block_size_y_;
+		ret->cs_block_size_z_ = cs_block_size_z_;
+		return ret;
+	}
+
+	void NullShaderObject::Bind()
+	{
+		NullRenderEngine& re = *checked_cast<NullRenderEngine*>(&Context::Instance().RenderFactoryInstance().RenderEngineInstance());
+		re.AddStatistics(NullRenderEngine::SC_ShaderBinds, 1);
+	}
+
+	void NullShaderObject::Unbind()
+	{
+	}
+}
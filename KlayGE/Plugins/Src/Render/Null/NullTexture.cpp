@@ -0,0 +1,549 @@
+/**
+ * @file NullTexture.cpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Util.hpp>
+#include <KlayGE/Context.hpp>
+#include <KlayGE/RenderFactory.hpp>
+#include <KlayGE/Texture.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+#include <boost/assert.hpp>
+
+#include <KlayGE/Null/NullRenderEngine.hpp>
+#include <KlayGE/Null/NullTexture.hpp>
+
+namespace KlayGE
+{
+	NullTexture::NullTexture(TextureType type, uint32_t width, uint32_t height, uint32_t depth, uint32_t numMipMaps, uint32_t array_size,
+			ElementFormat format, uint32_t sample_count, uint32_t sample_quality, uint32_t access_hint)
+		: Texture(type, sample_count, sample_quality, access_hint),
+			width_(width), height_(height), depth_(depth)
+	{
+		format_ = format;
+		array_size_ = array_size;
+
+		if (0 == numMipMaps)
+		{
+			num_mip_maps_ = 1;
+			uint32_t w = width;
+			uint32_t h = height;
+			uint32_t d = depth;
+			while ((w != 1) || (h != 1) || (d != 1))
+			{
+				++ num_mip_maps_;
+
+				w = std::max<uint32_t>(1U, w / 2);
+				h = std::max<uint32_t>(1U, h / 2);
+				d = std::max<uint32_t>(1U, d / 2);
+			}
+		}
+		else
+		{
+			num_mip_maps_ = numMipMaps;
+		}
+	}
+
+	std::wstring const & NullTexture::Name() const
+	{
+		static const std::wstring name(L"Null Texture");
+		return name;
+	}
+
+	uint32_t NullTexture::Width(uint32_t level) const
+	{
+		BOOST_ASSERT(level < num_mip_maps_);
+
+		return std::max<uint32_t>(1U, width_ >> level);
+	}
+
+	uint32_t NullTexture::Height(uint32_t level) const
+	{
+		BOOST_ASSERT(level < num_mip_maps_);
+
+		return std::max<uint32_t>(1U, height_ >> level);
+	}
+
+	uint32_t NullTexture::Depth(uint32_t level) const
+	{
+		BOOST_ASSERT(level < num_mip_maps_);
+
+		return std::max<uint32_t>(1U, depth_ >> level);
+	}
+
+	void NullTexture::CopyToTexture(Texture& target)
+	{
+		BOOST_ASSERT(type_ == target.Type());
+
+		for (uint32_t array_index = 0; array_index < array_size_; ++ array_index)
+		{
+			for (uint32_t level = 0; level < num_mip_maps_; ++ level)
+			{
+				switch (type_)
+				{
+				case TT_1D:
+					this->CopyToSubTexture1D(target,
+						array_index, level, 0, target.Width(level),
+						array_index, level, 0, this->Width(level));
+					break;
+
+				case TT_2D:
+					this->CopyToSubTexture2D(target,
+						array_index, level, 0, 0, target.Width(level), target.Height(level),
+						array_index, level, 0, 0, this->Width(level), this->Height(level));
+					break;
+
+				case TT_3D:
+					this->CopyToSubTexture3D(target,
+						array_index, level, 0, 0, 0, target.Width(level), target.Height(level), target.Depth(level),
+						array_index, level, 0, 0, 0, this->Width(level), this->Height(level), this->Depth(level));
+					break;
+
+				case TT_Cube:
+					for (int face = 0; face < 6; ++ face)
+					{
+						this->CopyToSubTextureCube(target,
+							array_index, static_cast<CubeFaces>(face), level, 0, 0, target.Width(level), target.Height(level),
+							array_index, static_cast<CubeFaces>(face), level, 0, 0, this->Width(level), this->Height(level));
+					}
+					break;
+
+				default:
+					BOOST_ASSERT(false);
+					break;
+				}
+			}
+		}
+	}
+
+	void NullTexture::CopyToSubTexture1D(Texture& target,
+			uint32_t dst_array_index, uint32_t dst_level, uint32_t dst_x_offset, uint32_t dst_width,
+			uint32_t src_array_index, uint32_t src_level, uint32_t src_x_offset, uint32_t src_width)
+	{
+		BOOST_ASSERT(type_ == target.Type());
+
+		if ((format_ == target.Format()) && (src_width == dst_width))
+		{
+			Texture::Mapper mapper_src(*this, src_array_index, src_level, TMA_Read_Only, src_x_offset, src_width);
+			Texture::Mapper mapper_dst(target, dst_array_index, dst_level, TMA_Write_Only, dst_x_offset, dst_width);
+			std::memcpy(mapper_dst.Pointer<uint8_t>(), mapper_src.Pointer<uint8_t>(), this->RegionRowBytes(src_width));
+		}
+		else
+		{
+			this->ResizeTexture1D(target, dst_array_index, dst_level, dst_x_offset, dst_width,
+				src_array_index, src_level, src_x_offset, src_width, true);
+		}
+	}
+
+	void NullTexture::CopyToSubTexture2D(Texture& target,
+			uint32_t dst_array_index, uint32_t dst_level, uint32_t dst_x_offset, uint32_t dst_y_offset, uint32_t dst_width, uint32_t dst_height,
+			uint32_t src_array_index, uint32_t src_level, uint32_t src_x_offset, uint32_t src_y_offset, uint32_t src_width, uint32_t src_height)
+	{
+		BOOST_ASSERT(type_ == target.Type());
+
+		if ((format_ == target.Format()) && (src_width == dst_width) && (src_height == dst_height))
+		{
+			Texture::Mapper mapper_src(*this, src_array_index, src_level, TMA_Read_Only,
+				src_x_offset, src_y_offset, src_width, src_height);
+			Texture::Mapper mapper_dst(target, dst_array_index, dst_level, TMA_Write_Only,
+				dst_x_offset, dst_y_offset, dst_width, dst_height);
+
+			uint32_t const row_bytes = this->RegionRowBytes(src_width);
+			uint8_t const * s = mapper_src.Pointer<uint8_t>();
+			uint8_t* d = mapper_dst.Pointer<uint8_t>();
+			for (uint32_t y = 0; y < this->RegionNumRows(src_height); ++ y)
+			{
+				std::memcpy(d, s, row_bytes);
+
+				s += mapper_src.RowPitch();
+				d += mapper_dst.RowPitch();
+			}
+		}
+		else
+		{
+			this->ResizeTexture2D(target, dst_array_index, dst_level, dst_x_offset, dst_y_offset, dst_width, dst_height,
+				src_array_index, src_level, src_x_offset, src_y_offset, src_width, src_height, true);
+		}
+	}
+
+	void NullTexture::CopyToSubTexture3D(Texture& target,
+			uint32_t dst_array_index, uint32_t dst_level, uint32_t dst_x_offset, uint32_t dst_y_offset, uint32_t dst_z_offset, uint32_t dst_width, uint32_t dst_height, uint32_t dst_depth,
+			uint32_t src_array_index, uint32_t src_level, uint32_t src_x_offset, uint32_t src_y_offset, uint32_t src_z_offset, uint32_t src_width, uint32_t src_height, uint32_t src_depth)
+	{
+		BOOST_ASSERT(type_ == target.Type());
+
+		if ((format_ == target.Format()) && (src_width == dst_width) && (src_height == dst_height) && (src_depth == dst_depth))
+		{
+			Texture::Mapper mapper_src(*this, src_array_index, src_level, TMA_Read_Only,
+				src_x_offset, src_y_offset, src_z_offset, src_width, src_height, src_depth);
+			Texture::Mapper mapper_dst(target, dst_array_index, dst_level, TMA_Write_Only,
+				dst_x_offset, dst_y_offset, dst_z_offset, dst_width, dst_height, dst_depth);
+
+			uint32_t const row_bytes = this->RegionRowBytes(src_width);
+			uint32_t const num_rows = this->RegionNumRows(src_height);
+			for (uint32_t z = 0; z < src_depth; ++ z)
+			{
+				uint8_t const * s = mapper_src.Pointer<uint8_t>() + z * mapper_src.SlicePitch();
+				uint8_t* d = mapper_dst.Pointer<uint8_t>() + z * mapper_dst.SlicePitch();
+				for (uint32_t y = 0; y < num_rows; ++ y)
+				{
+					std::memcpy(d, s, row_bytes);
+
+					s += mapper_src.RowPitch();
+					d += mapper_dst.RowPitch();
+				}
+			}
+		}
+		else
+		{
+			this->ResizeTexture3D(target, dst_array_index, dst_level, dst_x_offset, dst_y_offset, dst_z_offset, dst_width, dst_height, dst_depth,
+				src_array_index, src_level, src_x_offset, src_y_offset, src_z_offset, src_width, src_height, src_depth, true);
+		}
+	}
+
+	void NullTexture::CopyToSubTextureCube(Texture& target,
+			uint32_t dst_array_index, CubeFaces dst_face, uint32_t dst_level, uint32_t dst_x_offset, uint32_t dst_y_offset, uint32_t dst_width, uint32_t dst_height,
+			uint32_t src_array_index, CubeFaces src_face, uint32_t src_level, uint32_t src_x_offset, uint32_t src_y_offset, uint32_t src_width, uint32_t src_height)
+	{
+		BOOST_ASSERT((TT_2D == type_) || (TT_Cube == type_));
+		BOOST_ASSERT(TT_Cube == target.Type());
+
+		if ((format_ == target.Format()) && (src_width == dst_width) && (src_height == dst_height))
+		{
+			void* src_data;
+			uint32_t src_row_pitch;
+			uint32_t src_slice_pitch;
+			this->DoMap(src_array_index, (TT_Cube == type_) ? src_face : 0, src_level, TMA_Read_Only,
+				src_x_offset, src_y_offset, 0, src_width, src_height, 1, src_data, src_row_pitch, src_slice_pitch);
+			Texture::Mapper mapper_dst(target, dst_array_index, dst_face, dst_level, TMA_Write_Only,
+				dst_x_offset, dst_y_offset, dst_width, dst_height);
+
+			uint32_t const row_bytes = this->RegionRowBytes(src_width);
+			uint8_t const * s = static_cast<uint8_t const *>(src_data);
+			uint8_t* d = mapper_dst.Pointer<uint8_t>();
+			for (uint32_t y = 0; y < this->RegionNumRows(src_height); ++ y)
+			{
+				std::memcpy(d, s, row_bytes);
+
+				s += src_row_pitch;
+				d += mapper_dst.RowPitch();
+			}
+		}
+		else
+		{
+			this->ResizeTextureCube(target, dst_array_index, dst_face, dst_level, dst_x_offset, dst_y_offset, dst_width, dst_height,
+				src_array_index, src_face, src_level, src_x_offset, src_y_offset, src_width, src_height, true);
+		}
+	}
+
+	void NullTexture::BuildMipSubLevels()
+	{
+		if (IsCompressedFormat(format_) || IsDepthFormat(format_))
+		{
+			return;
+		}
+
+		for (uint32_t array_index = 0; array_index < array_size_; ++ array_index)
+		{
+			for (uint32_t level = 1; level < num_mip_maps_; ++ level)
+			{
+				switch (type_)
+				{
+				case TT_1D:
+					this->ResizeTexture1D(*this, array_index, level, 0, this->Width(level),
+						array_index, level - 1, 0, this->Width(level - 1), true);
+					break;
+
+				case TT_2D:
+					this->ResizeTexture2D(*this, array_index, level, 0, 0, this->Width(level), this->Height(level),
+						array_index, level - 1, 0, 0, this->Width(level - 1), this->Height(level - 1), true);
+					break;
+
+				case TT_3D:
+					this->ResizeTexture3D(*this, array_index, level, 0, 0, 0, this->Width(level), this->Height(level), this->Depth(level),
+						array_index, level - 1, 0, 0, 0, this->Width(level - 1), this->Height(level - 1), this->Depth(level - 1), true);
+					break;
+
+				case TT_Cube:
+					for (int face = 0; face < 6; ++ face)
+					{
+						this->ResizeTextureCube(*this, array_index, static_cast<CubeFaces>(face), level, 0, 0,
+							this->Width(level), this->Height(level),
+							array_index, static_cast<CubeFaces>(face), level - 1, 0, 0,
+							this->Width(level - 1), this->Height(level - 1), true);
+					}
+					break;
+
+				default:
+					BOOST_ASSERT(false);
+					break;
+				}
+			}
+		}
+	}
+
+	void NullTexture::Map1D(uint32_t array_index, uint32_t level, TextureMapAccess tma,
+			uint32_t x_offset, uint32_t width,
+			void*& data)
+	{
+		uint32_t row_pitch;
+		uint32_t slice_pitch;
+		this->DoMap(array_index, 0, level, tma, x_offset, 0, 0, width, 1, 1, data, row_pitch, slice_pitch);
+	}
+
+	void NullTexture::Map2D(uint32_t array_index, uint32_t level, TextureMapAccess tma,
+			uint32_t x_offset, uint32_t y_offset, uint32_t width, uint32_t height,
+			void*& data, uint32_t& row_pitch)
+	{
+		uint32_t slice_pitch;
+		this->DoMap(array_index, 0, level, tma, x_offset, y_offset, 0, width, height, 1, data, row_pitch, slice_pitch);
+	}
+
+	void NullTexture::Map3D(uint32_t array_index, uint32_t level, TextureMapAccess tma,
+			uint32_t x_offset, uint32_t y_offset, uint32_t z_offset,
+			uint32_t width, uint32_t height, uint32_t depth,
+			void*& data, uint32_t& row_pitch, uint32_t& slice_pitch)
+	{
+		this->DoMap(array_index, 0, level, tma, x_offset, y_offset, z_offset, width, height, depth, data, row_pitch, slice_pitch);
+	}
+
+	void NullTexture::MapCube(uint32_t array_index, CubeFaces face, uint32_t level, TextureMapAccess tma,
+			uint32_t x_offset, uint32_t y_offset, uint32_t width, uint32_t height,
+			void*& data, uint32_t& row_pitch)
+	{
+		uint32_t slice_pitch;
+		this->DoMap(array_index, (TT_Cube == type_) ? face : 0, level, tma, x_offset, y_offset, 0, width, height, 1,
+			data, row_pitch, slice_pitch);
+	}
+
+	void NullTexture::Unmap1D(uint32_t /*array_index*/, uint32_t /*level*/)
+	{
+	}
+
+	void NullTexture::Unmap2D(uint32_t /*array_index*/, uint32_t /*level*/)
+	{
+	}
+
+	void NullTexture::Unmap3D(uint32_t /*array_index*/, uint32_t /*level*/)
+	{
+	}
+
+	void NullTexture::UnmapCube(uint32_t /*array_index*/, CubeFaces /*face*/, uint32_t /*level*/)
+	{
+	}
+
+	void NullTexture::CreateHWResource(ElementInitData const * init_data)
+	{
+		uint32_t const num_faces = this->NumFaces();
+
+		uint64_t total_size = 0;
+		subres_data_.resize(array_size_ * num_faces * num_mip_maps_);
+		for (uint32_t array_index = 0; array_index < array_size_; ++ array_index)
+		{
+			for (uint32_t face = 0; face < num_faces; ++ face)
+			{
+				for (uint32_t level = 0; level < num_mip_maps_; ++ level)
+				{
+					uint32_t const subres = (array_index * num_faces + face) * num_mip_maps_ + level;
+					uint32_t const depth = this->Depth(level);
+					uint32_t const slice_pitch = this->SlicePitch(level);
+					subres_data_[subres].assign(slice_pitch * depth, 0);
+					total_size += slice_pitch * depth;
+
+					if (init_data != nullptr)
+					{
+						uint32_t const row_pitch = this->RowPitch(level);
+						uint32_t const num_rows = this->RegionNumRows(this->Height(level));
+						uint8_t const * src = static_cast<uint8_t const *>(init_data[subres].data);
+						uint8_t* dst = &subres_data_[subres][0];
+						for (uint32_t z = 0; z < depth; ++ z)
+						{
+							for (uint32_t y = 0; y < num_rows; ++ y)
+							{
+								std::memcpy(dst + z * slice_pitch + y * row_pitch,
+									src + z * init_data[subres].slice_pitch + y * init_data[subres].row_pitch, row_pitch);
+							}
+						}
+					}
+				}
+			}
+		}
+
+		NullRenderEngine& re = *checked_cast<NullRenderEngine*>(&Context::Instance().RenderFactoryInstance().RenderEngineInstance());
+		re.AddStatistics(NullRenderEngine::SC_Textures, 1);
+		if (init_data != nullptr)
+		{
+			re.AddStatistics(NullRenderEngine::SC_BytesUploaded, total_size);
+		}
+	}
+
+	void NullTexture::DeleteHWResource()
+	{
+		subres_data_.clear();
+	}
+
+	bool NullTexture::HWResourceReady() const
+	{
+		return !subres_data_.empty();
+	}
+
+	void NullTexture::UpdateSubresource1D(uint32_t array_index, uint32_t level,
+			uint32_t x_offset, uint32_t width,
+			void const * data)
+	{
+		this->DoUpdateSubresource(array_index, 0, level, x_offset, 0, 0, width, 1, 1,
+			data, this->RegionRowBytes(width), this->RegionRowBytes(width));
+	}
+
+	void NullTexture::UpdateSubresource2D(uint32_t array_index, uint32_t level,
+			uint32_t x_offset, uint32_t y_offset, uint32_t width, uint32_t height,
+			void const * data, uint32_t row_pitch)
+	{
+		this->DoUpdateSubresource(array_index, 0, level, x_offset, y_offset, 0, width, height, 1,
+			data, row_pitch, row_pitch * this->RegionNumRows(height));
+	}
+
+	void NullTexture::UpdateSubresource3D(uint32_t array_index, uint32_t level,
+			uint32_t x_offset, uint32_t y_offset, uint32_t z_offset,
+			uint32_t width, uint32_t height, uint32_t depth,
+			void const * data, uint32_t row_pitch, uint32_t slice_pitch)
+	{
+		this->DoUpdateSubresource(array_index, 0, level, x_offset, y_offset, z_offset, width, height, depth,
+			data, row_pitch, slice_pitch);
+	}
+
+	void NullTexture::UpdateSubresourceCube(uint32_t array_index, CubeFaces face, uint32_t level,
+			uint32_t x_offset, uint32_t y_offset, uint32_t width, uint32_t height,
+			void const * data, uint32_t row_pitch)
+	{
+		this->DoUpdateSubresource(array_index, (TT_Cube == type_) ? face : 0, level, x_offset, y_offset, 0, width, height, 1,
+			data, row_pitch, row_pitch * this->RegionNumRows(height));
+	}
+
+	uint32_t NullTexture::NumFaces() const
+	{
+		return (TT_Cube == type_) ? 6 : 1;
+	}
+
+	uint32_t NullTexture::RowPitch(uint32_t level) const
+	{
+		return this->RegionRowBytes(this->Width(level));
+	}
+
+	uint32_t NullTexture::SlicePitch(uint32_t level) const
+	{
+		return this->RowPitch(level) * this->RegionNumRows(this->Height(level));
+	}
+
+	uint32_t NullTexture::RegionRowBytes(uint32_t width) const
+	{
+		if (IsCompressedFormat(format_))
+		{
+			uint32_t const block_size = NumFormatBytes(format_) * 4;
+			return (width + 3) / 4 * block_size;
+		}
+		else
+		{
+			return width * NumFormatBytes(format_);
+		}
+	}
+
+	uint32_t NullTexture::RegionNumRows(uint32_t height) const
+	{
+		if (IsCompressedFormat(format_))
+		{
+			return (height + 3) / 4;
+		}
+		else
+		{
+			return height;
+		}
+	}
+
+	uint8_t* NullTexture::Subresource(uint32_t array_index, uint32_t face, uint32_t level,
+			uint32_t x_offset, uint32_t y_offset, uint32_t z_offset)
+	{
+		BOOST_ASSERT(this->HWResourceReady());
+
+		uint32_t const subres = (array_index * this->NumFaces() + face) * num_mip_maps_ + level;
+		uint8_t* p = &subres_data_[subres][0] + z_offset * this->SlicePitch(level);
+		if (IsCompressedFormat(format_))
+		{
+			uint32_t const block_size = NumFormatBytes(format_) * 4;
+			return p + (y_offset / 4) * this->RowPitch(level) + (x_offset / 4) * block_size;
+		}
+		else
+		{
+			return p + y_offset * this->RowPitch(level) + x_offset * NumFormatBytes(format_);
+		}
+	}
+
+	void NullTexture::DoMap(uint32_t array_index, uint32_t face, uint32_t level, TextureMapAccess tma,
+			uint32_t x_offset, uint32_t y_offset, uint32_t z_offset,
+			uint32_t width, uint32_t height, uint32_t depth,
+			void*& data, uint32_t& row_pitch, uint32_t& slice_pitch)
+	{
+		data = this->Subresource(array_index, face, level, x_offset, y_offset, z_offset);
+		row_pitch = this->RowPitch(level);
+		slice_pitch = this->SlicePitch(level);
+
+		if (tma != TMA_Read_Only)
+		{
+			NullRenderEngine& re = *checked_cast<NullRenderEngine*>(&Context::Instance().RenderFactoryInstance().RenderEngineInstance());
+			re.AddStatistics(NullRenderEngine::SC_BytesUploaded,
+				static_cast<uint64_t>(this->RegionRowBytes(width)) * this->RegionNumRows(height) * depth);
+		}
+	}
+
+	void NullTexture::DoUpdateSubresource(uint32_t array_index, uint32_t face, uint32_t level,
+			uint32_t x_offset, uint32_t y_offset, uint32_t z_offset,
+			uint32_t width, uint32_t height, uint32_t depth,
+			void const * data, uint32_t row_pitch, uint32_t slice_pitch)
+	{
+		uint8_t* dst = this->Subresource(array_index, face, level, x_offset, y_offset, z_offset);
+		uint8_t const * src = static_cast<uint8_t const *>(data);
+		uint32_t const dst_row_pitch = this->RowPitch(level);
+		uint32_t const dst_slice_pitch = this->SlicePitch(level);
+		uint32_t const row_bytes = this->RegionRowBytes(width);
+		uint32_t const num_rows = this->RegionNumRows(height);
+		for (uint32_t z = 0; z < depth; ++ z)
+		{
+			for (uint32_t y = 0; y < num_rows; ++ y)
+			{
+				std::memcpy(dst + z * dst_slice_pitch + y * dst_row_pitch, src + z * slice_pitch + y * row_pitch, row_bytes);
+			}
+		}
+
+		NullRenderEngine& re = *checked_cast<NullRenderEngine*>(&Context::Instance().RenderFactoryInstance().RenderEngineInstance());
+		re.AddStatistics(NullRenderEngine::SC_BytesUploaded, static_cast<uint64_t>(row_bytes) * num_rows * depth);
+	}
+}
@@ -51,6 +51,8 @@
 #include <KlayGE/RenderFactory.hpp>
 #include <KlayGE/PostProcess.hpp>
 #include <KFL/Hash.hpp>
+#include <KFL/CXX17/filesystem.hpp>
+#include <KlayGE/ResLoader.hpp>
 
 #include <glloader/glloader.h>
 
@@ -59,6 +61,8 @@
 #include <boost/assert.hpp>
 #include <boost/lexical_cast.hpp>
 
+#include <DXBC2GLSL/DXBC2GLSLCache.hpp>
+
 #include <KlayGE/OpenGL/OGLMapping.hpp>
 #include <KlayGE/OpenGL/OGLRenderWindow.hpp>
 #include <KlayGE/OpenGL/OGLFrameBuffer.hpp>
@@ -185,11 +189,11 @@ namespace
 			+ "message: " + message;
 		if (GL_DEBUG_TYPE_ERROR == type)
 		{
-			KlayGE::LogError(dbg.c_str());
+			KLAYGE_LOG(KlayGE::LL_Error, KlayGE::LC_Render, "%s", dbg.c_str());
 		}
 		else
 		{
-			KlayGE::LogInfo(dbg.c_str());
+			KLAYGE_LOG(KlayGE::LL_Info, KlayGE::LC_Render, "%s", dbg.c_str());
 		}
 	}
 #endif
@@ -218,6 +222,21 @@ namespace KlayGE
 		DynamicWglDeleteContext_ = (wglDeleteContextFUNC)::GetProcAddress(mod_opengl32_, "wglDeleteContext");
 		DynamicWglMakeCurrent_ = (wglMakeCurrentFUNC)::GetProcAddress(mod_opengl32_, "wglMakeCurrent");
 #endif
+
+		// Keeps DXBC2GLSL translations across runs, for the effects whose GLSL isn't in a .kfx yet
+		try
+		{
+			std::filesystem::path const cache_dir = std::filesystem::path(ResLoader::Instance().LocalFolder()) / "DXBC2GLSLCache";
+			if (!std::filesystem::exists(cache_dir))
+			{
+				std::filesystem::create_directories(cache_dir);
+			}
+			DXBC2GLSL::DXBC2GLSLCache::Instance().Directory(cache_dir.string());
+		}
+		catch (std::exception& ex)
+		{
+			KLAYGE_LOG(LL_Warn, LC_Render, "DXBC2GLSL translations are cached in memory only: %s", ex.what());
+		}
 	}
 
 	// 
@@ -26,6 +26,8 @@
 #include <KFL/Util.hpp>
 #include <KlayGE/RenderFactory.hpp>
 #include <KFL/Hash.hpp>
+#include <KFL/CXX17/filesystem.hpp>
+#include <KlayGE/ResLoader.hpp>
 
 #include <glloader/glloader.h>
 
@@ -34,6 +36,8 @@
 #include <boost/assert.hpp>
 #include <boost/lexical_cast.hpp>
 
+#include <DXBC2GLSL/DXBC2GLSLCache.hpp>
+
 #include <KlayGE/OpenGLES/OGLESMapping.hpp>
 #include <KlayGE/OpenGLES/OGLESRenderWindow.hpp>
 #include <KlayGE/OpenGLES/OGLESFrameBuffer.hpp>
@@ -160,11 +164,11 @@ namespace
 			+ "message: " + message;
 		if (GL_DEBUG_TYPE_ERROR == type)
 		{
-			KlayGE::LogError(dbg.c_str());
+			KLAYGE_LOG(KlayGE::LL_Error, KlayGE::LC_Render, "%s", dbg.c_str());
 		}
 		else
 		{
-			KlayGE::LogInfo(dbg.c_str());
+			KLAYGE_LOG(KlayGE::LL_Info, KlayGE::LC_Render, "%s", dbg.c_str());
 		}
 	}
 #endif
@@ -185,6 +189,21 @@ namespace KlayGE
 		native_shader_version_ = 3;
 
 		clear_clr_.fill(0);
+
+		// Keeps DXBC2GLSL translations across runs, for the effects whose GLSL isn't in a .kfx yet
+		try
+		{
+			std::filesystem::path const cache_dir = std::filesystem::path(ResLoader::Instance().LocalFolder()) / "DXBC2GLSLCache";
+			if (!std::filesystem::exists(cache_dir))
+			{
+				std::filesystem::create_directories(cache_dir);
+			}
+			DXBC2GLSL::DXBC2GLSLCache::Instance().Directory(cache_dir.string());
+		}
+		catch (std::exception& ex)
+		{
+			KLAYGE_LOG(LL_Warn, LC_Render, "DXBC2GLSL translations are cached in memory only: %s", ex.what());
+		}
 	}
 
 	// 
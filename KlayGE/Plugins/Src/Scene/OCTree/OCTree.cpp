@@ -32,6 +32,11 @@
 #include <KlayGE/RenderableHelper.hpp>
 #include <KlayGE/Camera.hpp>
 #include <KlayGE/App3D.hpp>
+#include <KlayGE/Context.hpp>
+#include <KlayGE/RenderFactory.hpp>
+#include <KlayGE/RenderEngine.hpp>
+#include <KlayGE/FrameBuffer.hpp>
+#include <KlayGE/Viewport.hpp>
 #include <KlayGE/DeferredRenderingLayer.hpp>
 
 #include <algorithm>
@@ -39,8 +44,6 @@
 #include <boost/assert.hpp>
 
 #ifdef KLAYGE_DRAW_NODES
-#include <KlayGE/Context.hpp>
-#include <KlayGE/RenderFactory.hpp>
 #include <KlayGE/RenderEffect.hpp>
 #endif
 
@@ -155,8 +158,9 @@ namespace KlayGE
 			this->NodeVisible(0);
 		}
 
-		App3DFramework& app = Context::Instance().AppInstance();
-		Camera& camera = app.ActiveCamera();
+		// The camera of the current frame buffer, like App3DFramework::ActiveCamera, but without needing an application
+		RenderEngine& re = Context::Instance().RenderFactoryInstance().RenderEngineInstance();
+		Camera& camera = *re.CurFrameBuffer()->GetViewport()->camera;
 
 		float4x4 view_proj = camera.ViewProjMatrix();
 		auto drl = Context::Instance().DeferredRenderingLayerInstance();
@@ -206,6 +210,8 @@ namespace KlayGE
 		}
 		else
 		{
+			this->PrepareOcclusion(camera, view_proj);
+
 			if (!octree_.empty())
 			{
 				this->MarkNodeObjs(0, false);
@@ -244,6 +250,8 @@ namespace KlayGE
 					{
 						obj->VisibleMark(visible);
 					}
+
+					obj->VisibleMark(this->OcclusionTest(*obj, obj->VisibleMark()));
 				}
 			}
 		}
@@ -351,8 +359,9 @@ namespace KlayGE
 	{
 		BOOST_ASSERT(index < octree_.size());
 
-		App3DFramework& app = Context::Instance().AppInstance();
-		Camera& camera = app.ActiveCamera();
+		// The camera of the current frame buffer, like App3DFramework::ActiveCamera, but without needing an application
+		RenderEngine& re = Context::Instance().RenderFactoryInstance().RenderEngineInstance();
+		Camera& camera = *re.CurFrameBuffer()->GetViewport()->camera;
 
 		float4x4 view_proj = camera.ViewProjMatrix();
 		auto drl = Context::Instance().DeferredRenderingLayerInstance();
@@ -400,8 +409,9 @@ namespace KlayGE
 	{
 		BOOST_ASSERT(index < octree_.size());
 
-		App3DFramework& app = Context::Instance().AppInstance();
-		Camera& camera = app.ActiveCamera();
+		// The camera of the current frame buffer, like App3DFramework::ActiveCamera, but without needing an application
+		RenderEngine& re = Context::Instance().RenderFactoryInstance().RenderEngineInstance();
+		Camera& camera = *re.CurFrameBuffer()->GetViewport()->camera;
 
 		float4x4 view_proj = camera.ViewProjMatrix();
 		auto drl = Context::Instance().DeferredRenderingLayerInstance();
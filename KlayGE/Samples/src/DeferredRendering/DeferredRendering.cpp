@@ -278,6 +278,7 @@ void DeferredRenderingApp::InputHandler(InputEngine const & /*sender*/, InputAct
 	case Profile:
 #ifndef KLAYGE_SHIP
 		PerfProfiler::Instance().ExportToCSV("profile.csv");
+		PerfProfiler::Instance().ExportToChromeTrace("profile.json");
 #endif
 		break;
 	}
@@ -288,6 +289,9 @@ void DeferredRenderingApp::BufferChangedHandler(UIComboBox const & sender)
 	buffer_type_ = sender.GetSelectedIndex();
 	deferred_rendering_->Display(static_cast<DeferredRenderingLayer::DisplayType>(buffer_type_));
 
+	// The occlusion buffer is only filled while occlusion culling is on
+	Context::Instance().SceneManagerInstance().OcclusionCulling(DeferredRenderingLayer::DT_OcclusionBuffer == buffer_type_);
+
 	if (dialog_->Control<UICheckBox>(id_aa_)->GetChecked())
 	{
 		anti_alias_enabled_ = 1 + (DeferredRenderingLayer::DT_Edge == buffer_type_);
@@ -22,6 +22,15 @@
 using namespace std;
 using namespace KlayGE;
 
+namespace
+{
+	// Blitter draws with shaders, which the null render engine doesn't execute
+	boost::test_tools::assertion_result ExecutesShaders(boost::unit_test::test_unit_id)
+	{
+		return Context::Instance().Config().render_factory_name != "Null";
+	}
+}
+
 bool Compare2D(std::string const & test_name,
 	Texture& tex0, uint32_t tex0_array_index, uint32_t tex0_level, uint32_t tex0_x_offset, uint32_t tex0_y_offset,
 	Texture& tex1, uint32_t tex1_array_index, uint32_t tex1_level, uint32_t tex1_x_offset, uint32_t tex1_y_offset,
@@ -334,27 +343,27 @@ void TestBlitterBuffTo2D(std::string const & test_name, uint32_t array_size, uin
 	}
 }
 
-BOOST_AUTO_TEST_CASE(Blit2D)
+BOOST_AUTO_TEST_CASE(Blit2D, *boost::unit_test::precondition(ExecutesShaders))
 {
 	TestBlitter2D("Blit2D", 1, 3, false);
 }
 
-BOOST_AUTO_TEST_CASE(Blit2DArray)
+BOOST_AUTO_TEST_CASE(Blit2DArray, *boost::unit_test::precondition(ExecutesShaders))
 {
 	TestBlitter2D("Blit2DArray", 5, 4, false);
 }
 
-BOOST_AUTO_TEST_CASE(Blit2DToBuff)
+BOOST_AUTO_TEST_CASE(Blit2DToBuff, *boost::unit_test::precondition(ExecutesShaders))
 {
 	TestBlitter2DToBuff("Blit2DToBuff", 1, 3);
 }
 
-BOOST_AUTO_TEST_CASE(Blit2DArrayToBuff)
+BOOST_AUTO_TEST_CASE(Blit2DArrayToBuff, *boost::unit_test::precondition(ExecutesShaders))
 {
 	TestBlitter2DToBuff("Blit2DArrayToBuff", 5, 4);
 }
 
-BOOST_AUTO_TEST_CASE(BlitBuffTo2D)
+BOOST_AUTO_TEST_CASE(BlitBuffTo2D, *boost::unit_test::precondition(ExecutesShaders))
 {
 	TestBlitterBuffTo2D("BlitBuffTo2D", 5, 4);
 }
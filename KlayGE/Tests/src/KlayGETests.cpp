@@ -2,6 +2,8 @@
 #include <KlayGE/App3D.hpp>
 #include <KlayGE/ResLoader.hpp>
 
+#include <cstring>
+
 #if defined(KLAYGE_COMPILER_CLANG)
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wunused-parameter" // Ignore unused parameter in boost
@@ -42,6 +44,17 @@ namespace KlayGE
 		{
 			Context::Instance().LoadCfg("KlayGE.cfg");
 			ContextCfg context_cfg = Context::Instance().Config();
+			// Runs on the null render engine, with no window or GPU, unless another factory is given after "--",
+			// like "KlayGETests -- --render_factory OpenGL"
+			context_cfg.render_factory_name = "Null";
+			auto const & master = boost::unit_test::framework::master_test_suite();
+			for (int i = 1; i < master.argc - 1; ++ i)
+			{
+				if (0 == std::strcmp(master.argv[i], "--render_factory"))
+				{
+					context_cfg.render_factory_name = master.argv[i + 1];
+				}
+			}
 			context_cfg.graphics_cfg.hide_win = true;
 			context_cfg.graphics_cfg.hdr = false;
 			context_cfg.graphics_cfg.color_grading = false;
@@ -0,0 +1,215 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KlayGE/NetTransport.hpp>
+
+#include <boost/assert.hpp>
+#ifdef KLAYGE_COMPILER_CLANG
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wunused-parameter" // Ignore unused parameter in boost
+#endif
+#include <boost/test/unit_test.hpp>
+#ifdef KLAYGE_COMPILER_CLANG
+#pragma clang diagnostic pop
+#endif
+
+#include <cstring>
+#include <vector>
+
+using namespace std;
+using namespace KlayGE;
+
+#ifndef KLAYGE_PLATFORM_WINDOWS_RUNTIME
+BOOST_AUTO_TEST_CASE(NetTransportLoopbackReliableInOrder)
+{
+	NetTransport server;
+	server.Bind(0);
+
+	uint32_t const NUM_MSGS = 2000;
+
+	vector<uint32_t> received;
+	uint32_t server_peer = NetTransport::INVALID_PEER;
+	server.OnMessage([&received, &server_peer](uint32_t peer, uint8_t const * data, uint32_t size)
+		{
+			BOOST_CHECK_EQUAL(size, sizeof(uint32_t));
+			uint32_t v;
+			memcpy(&v, data, sizeof(v));
+			received.push_back(v);
+			server_peer = peer;
+		});
+
+	NetTransport client;
+	uint32_t const peer = client.Connect(TransAddr("127.0.0.1", server.Port()));
+	BOOST_CHECK(peer != NetTransport::INVALID_PEER);
+
+	for (uint32_t i = 0; i < NUM_MSGS; ++ i)
+	{
+		BOOST_CHECK(client.Send(peer, &i, sizeof(i)));
+	}
+
+	for (uint32_t iter = 0; (iter < 1000) && (received.size() < NUM_MSGS); ++ iter)
+	{
+		client.Update(1);
+		server.Update(1);
+	}
+
+	BOOST_CHECK_EQUAL(received.size(), NUM_MSGS);
+	for (uint32_t i = 0; i < received.size(); ++ i)
+	{
+		BOOST_CHECK_EQUAL(received[i], i);
+	}
+	BOOST_CHECK_EQUAL(server.NumPeers(), 1U);
+
+	// Messages are batched, so far fewer datagrams than messages go out
+	BOOST_CHECK(client.Statistics().datagrams_sent < NUM_MSGS / 10);
+
+	// The reply goes back to the same peer
+	uint32_t reply_count = 0;
+	client.OnMessage([&reply_count](uint32_t /*peer*/, uint8_t const * /*data*/, uint32_t /*size*/)
+		{
+			++ reply_count;
+		});
+	char const reply = 42;
+	BOOST_CHECK(server.Send(server_peer, &reply, sizeof(reply), false));
+	for (uint32_t iter = 0; (iter < 100) && (0 == reply_count); ++ iter)
+	{
+		server.Update(1);
+		client.Update(1);
+	}
+	BOOST_CHECK_EQUAL(reply_count, 1U);
+}
+
+BOOST_AUTO_TEST_CASE(NetTransportPeerTimeout)
+{
+	NetTransport::Settings settings;
+	settings.peer_timeout_ms = 50;
+	settings.keep_alive_ms = 1000;
+
+	NetTransport server(settings);
+	server.Bind(0);
+
+	uint32_t disconnected = 0;
+	server.OnPeerDisconnected([&disconnected](uint32_t /*peer*/)
+		{
+			++ disconnected;
+		});
+
+	{
+		NetTransport client;
+		uint32_t const peer = client.Connect(TransAddr("127.0.0.1", server.Port()));
+		char const msg = 1;
+		client.Send(peer, &msg, sizeof(msg));
+		client.Update(0);
+	}
+
+	for (uint32_t iter = 0; (iter < 200) && (0 == disconnected); ++ iter)
+	{
+		server.Update(5);
+	}
+
+	BOOST_CHECK_EQUAL(disconnected, 1U);
+	BOOST_CHECK_EQUAL(server.NumPeers(), 0U);
+}
+
+BOOST_AUTO_TEST_CASE(NetTransportFlushAndMessageSize)
+{
+	NetTransport::Settings settings;
+	settings.mtu = 0x10000;
+
+	NetTransport server(settings);
+	server.Bind(0);
+
+	uint32_t received = 0;
+	server.OnMessage([&received](uint32_t /*peer*/, uint8_t const * /*data*/, uint32_t /*size*/)
+		{
+			++ received;
+		});
+
+	NetTransport client(settings);
+	uint32_t const peer = client.Connect(TransAddr("127.0.0.1", server.Port()));
+
+	// Fits in a datagram, but not in the size field of a message
+	vector<uint8_t> const big(0x8000);
+	BOOST_CHECK(!client.Send(peer, &big[0], static_cast<uint32_t>(big.size())));
+	BOOST_CHECK(client.Send(peer, &big[0], static_cast<uint32_t>(big.size() - 1)));
+
+	// The server is started, the client is updated by Flush
+	server.Start();
+	BOOST_CHECK(client.Flush(peer, 2000));
+	server.Stop();
+
+	BOOST_CHECK_EQUAL(received, 1U);
+	BOOST_CHECK_EQUAL(client.Statistics().messages_sent, 1U);
+	BOOST_CHECK(!client.Flush(NetTransport::INVALID_PEER, 0));
+}
+
+namespace
+{
+	// A datagram carrying one unreliable 1-byte message, built by hand to bypass the sender side of NetTransport
+	void SendRawDatagram(Socket& socket, sockaddr_in const & addr, uint16_t protocol_id, uint16_t seq, uint8_t payload)
+	{
+		uint8_t const datagram[] =
+		{
+			static_cast<uint8_t>(protocol_id & 0xFF), static_cast<uint8_t>(protocol_id >> 8),
+			static_cast<uint8_t>(seq & 0xFF), static_cast<uint8_t>(seq >> 8),
+			0xFF, 0xFF,
+			0, 0, 0, 0,
+			1, 0,
+			payload
+		};
+		socket.SendTo(datagram, static_cast<int>(sizeof(datagram)), addr);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(NetTransportJoinAndDuplicates)
+{
+	NetTransport server;
+	server.Bind(0);
+
+	vector<uint8_t> received;
+	server.OnMessage([&received](uint32_t /*peer*/, uint8_t const * data, uint32_t size)
+		{
+			BOOST_CHECK_EQUAL(size, 1U);
+			received.push_back(data[0]);
+		});
+
+	Socket socket;
+	socket.Create(SOCK_DGRAM);
+	sockaddr_in const server_addr = TransAddr("127.0.0.1", server.Port());
+
+	auto const pump = [&server]
+	{
+		for (uint32_t iter = 0; iter < 10; ++ iter)
+		{
+			server.Update(1);
+		}
+	};
+
+	// A regular datagram from an unknown address doesn't create a peer
+	SendRawDatagram(socket, server_addr, 0x4B47, 0, 1);
+	pump();
+	BOOST_CHECK_EQUAL(server.NumPeers(), 0U);
+	BOOST_CHECK(received.empty());
+
+	SendRawDatagram(socket, server_addr, 0x4B48, 0, 2);
+	pump();
+	BOOST_CHECK_EQUAL(server.NumPeers(), 1U);
+
+	SendRawDatagram(socket, server_addr, 0x4B47, 100, 3);
+	pump();
+
+	// Out of the 32 ack bits, but still a duplicate
+	SendRawDatagram(socket, server_addr, 0x4B47, 0, 4);
+	pump();
+
+	// Too old to tell from a duplicate
+	SendRawDatagram(socket, server_addr, 0x4B47, 2000, 5);
+	pump();
+	SendRawDatagram(socket, server_addr, 0x4B47, 900, 6);
+	pump();
+
+	BOOST_REQUIRE_EQUAL(received.size(), 3U);
+	BOOST_CHECK_EQUAL(received[0], 2);
+	BOOST_CHECK_EQUAL(received[1], 3);
+	BOOST_CHECK_EQUAL(received[2], 5);
+	BOOST_CHECK_EQUAL(server.Statistics().duplicates, 2U);
+}
+#endif
@@ -0,0 +1,195 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Math.hpp>
+#include <KFL/Noise.hpp>
+
+#include <boost/assert.hpp>
+#ifdef KLAYGE_COMPILER_CLANG
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wunused-parameter" // Ignore unused parameter in boost
+#endif
+#include <boost/test/unit_test.hpp>
+#ifdef KLAYGE_COMPILER_CLANG
+#pragma clang diagnostic pop
+#endif
+
+#include <vector>
+#include <random>
+
+using namespace std;
+using namespace KlayGE;
+
+namespace
+{
+	// The bound documented in Noise.hpp. Noise values are in [-1, 1], so it's absolute.
+	float const NOISE_TOLERANCE = 1e-5f;
+
+	int const OCTAVES = 6;
+
+	struct NoisePoints
+	{
+		vector<float> x;
+		vector<float> y;
+		vector<float> z;
+	};
+
+	// Random points at several scales, and a grid of multiples of 0.5 around 0. The grid puts points exactly on the
+	//  boundaries of simplex cells, including negative ones. The total isn't a multiple of 4, so the tail is tested too.
+	NoisePoints MakeNoisePoints(bool positive)
+	{
+		NoisePoints ret;
+
+		ranlux24_base gen;
+		for (float range : { 1.0f, 10.0f, 100.0f, 1000.0f })
+		{
+			uniform_real_distribution<float> dis(positive ? 0 : -range, range);
+			for (int i = 0; i < 1001; ++ i)
+			{
+				ret.x.push_back(dis(gen));
+				ret.y.push_back(dis(gen));
+				ret.z.push_back(dis(gen));
+			}
+		}
+
+		int const begin = positive ? 0 : -8;
+		for (int i = begin; i <= 8; ++ i)
+		{
+			for (int j = begin; j <= 8; ++ j)
+			{
+				for (int k = begin; k <= 8; ++ k)
+				{
+					ret.x.push_back(i * 0.5f);
+					ret.y.push_back(j * 0.5f);
+					ret.z.push_back(k * 0.5f);
+				}
+			}
+		}
+
+		BOOST_ASSERT(ret.x.size() % 4 != 0);
+		return ret;
+	}
+
+	void CheckNoise(vector<float> const & batch, vector<float> const & scalar)
+	{
+		BOOST_REQUIRE_EQUAL(batch.size(), scalar.size());
+		for (size_t i = 0; i < batch.size(); ++ i)
+		{
+			BOOST_CHECK_SMALL(batch[i] - scalar[i], NOISE_TOLERANCE);
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE(NoiseBatch2D)
+{
+	auto& sn = MathLib::SimplexNoise<float>::Instance();
+	NoisePoints const pts = MakeNoisePoints(false);
+	size_t const n = pts.x.size();
+
+	vector<float> batch(n);
+	vector<float> scalar(n);
+
+	sn.noise(&pts.x[0], &pts.y[0], &batch[0], n);
+	for (size_t i = 0; i < n; ++ i)
+	{
+		scalar[i] = sn.noise(pts.x[i], pts.y[i]);
+	}
+	CheckNoise(batch, scalar);
+
+	sn.fBm(&pts.x[0], &pts.y[0], &batch[0], n, OCTAVES);
+	for (size_t i = 0; i < n; ++ i)
+	{
+		scalar[i] = sn.fBm(pts.x[i], pts.y[i], OCTAVES);
+	}
+	CheckNoise(batch, scalar);
+
+	sn.turbulence(&pts.x[0], &pts.y[0], &batch[0], n, OCTAVES);
+	for (size_t i = 0; i < n; ++ i)
+	{
+		scalar[i] = sn.turbulence(pts.x[i], pts.y[i], OCTAVES);
+	}
+	CheckNoise(batch, scalar);
+
+	// A short batch has only the tail
+	sn.noise(&pts.x[0], &pts.y[0], &batch[0], 3);
+	for (size_t i = 0; i < 3; ++ i)
+	{
+		BOOST_CHECK_SMALL(batch[i] - sn.noise(pts.x[i], pts.y[i]), NOISE_TOLERANCE);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(NoiseBatch3D)
+{
+	auto& sn = MathLib::SimplexNoise<float>::Instance();
+	NoisePoints const pts = MakeNoisePoints(false);
+	size_t const n = pts.x.size();
+
+	vector<float> batch(n);
+	vector<float> scalar(n);
+
+	sn.noise(&pts.x[0], &pts.y[0], &pts.z[0], &batch[0], n);
+	for (size_t i = 0; i < n; ++ i)
+	{
+		scalar[i] = sn.noise(pts.x[i], pts.y[i], pts.z[i]);
+	}
+	CheckNoise(batch, scalar);
+
+	sn.fBm(&pts.x[0], &pts.y[0], &pts.z[0], &batch[0], n, OCTAVES);
+	for (size_t i = 0; i < n; ++ i)
+	{
+		scalar[i] = sn.fBm(pts.x[i], pts.y[i], pts.z[i], OCTAVES);
+	}
+	CheckNoise(batch, scalar);
+
+	sn.turbulence(&pts.x[0], &pts.y[0], &pts.z[0], &batch[0], n, OCTAVES);
+	for (size_t i = 0; i < n; ++ i)
+	{
+		scalar[i] = sn.turbulence(pts.x[i], pts.y[i], pts.z[i], OCTAVES);
+	}
+	CheckNoise(batch, scalar);
+
+	sn.noise(&pts.x[0], &pts.y[0], &pts.z[0], &batch[0], 3);
+	for (size_t i = 0; i < 3; ++ i)
+	{
+		BOOST_CHECK_SMALL(batch[i] - sn.noise(pts.x[i], pts.y[i], pts.z[i]), NOISE_TOLERANCE);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(NoiseBatchTileable)
+{
+	auto& sn = MathLib::SimplexNoise<float>::Instance();
+	NoisePoints const pts = MakeNoisePoints(true);
+	size_t const n = pts.x.size();
+
+	vector<float> batch(n);
+	vector<float> scalar(n);
+
+	for (float size : { 4.0f, 1000.0f })
+	{
+		sn.tileable_fBm(&pts.x[0], &pts.y[0], &batch[0], n, size, size, OCTAVES);
+		for (size_t i = 0; i < n; ++ i)
+		{
+			scalar[i] = sn.tileable_fBm(pts.x[i], pts.y[i], size, size, OCTAVES);
+		}
+		CheckNoise(batch, scalar);
+
+		sn.tileable_turbulence(&pts.x[0], &pts.y[0], &batch[0], n, size, size, OCTAVES);
+		for (size_t i = 0; i < n; ++ i)
+		{
+			scalar[i] = sn.tileable_turbulence(pts.x[i], pts.y[i], size, size, OCTAVES);
+		}
+		CheckNoise(batch, scalar);
+
+		sn.tileable_fBm(&pts.x[0], &pts.y[0], &pts.z[0], &batch[0], n, size, size, size, OCTAVES);
+		for (size_t i = 0; i < n; ++ i)
+		{
+			scalar[i] = sn.tileable_fBm(pts.x[i], pts.y[i], pts.z[i], size, size, size, OCTAVES);
+		}
+		CheckNoise(batch, scalar);
+
+		sn.tileable_turbulence(&pts.x[0], &pts.y[0], &pts.z[0], &batch[0], n, size, size, size, OCTAVES);
+		for (size_t i = 0; i < n; ++ i)
+		{
+			scalar[i] = sn.tileable_turbulence(pts.x[i], pts.y[i], pts.z[i], size, size, size, OCTAVES);
+		}
+		CheckNoise(batch, scalar);
+	}
+}
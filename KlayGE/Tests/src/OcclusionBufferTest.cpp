@@ -0,0 +1,80 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Math.hpp>
+#include <KlayGE/OcclusionBuffer.hpp>
+
+#include <boost/assert.hpp>
+#ifdef KLAYGE_COMPILER_CLANG
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wunused-parameter" // Ignore unused parameter in boost
+#endif
+#include <boost/test/unit_test.hpp>
+#ifdef KLAYGE_COMPILER_CLANG
+#pragma clang diagnostic pop
+#endif
+
+using namespace std;
+using namespace KlayGE;
+
+namespace
+{
+	// Looking down +z from the origin. The near plane is at 1.
+	float4x4 TestViewProj()
+	{
+		float4x4 const view = MathLib::look_at_lh(float3(0, 0, 0), float3(0, 0, 1), float3(0, 1, 0));
+		float4x4 const proj = MathLib::perspective_fov_lh(PI / 4, 2.0f, 1.0f, 100.0f);
+		return view * proj;
+	}
+
+	// A 4x4 wall from z = 10 to 11, covering the middle of the screen
+	void RasterizeWall(OcclusionBuffer& buffer)
+	{
+		buffer.BeginFrame(TestViewProj());
+		buffer.AddOccluder(AABBox(float3(-2, -2, 10), float3(2, 2, 11)), float4x4::Identity());
+		BOOST_REQUIRE_EQUAL(buffer.NumOccluders(), 1U);
+		buffer.Rasterize();
+	}
+}
+
+BOOST_AUTO_TEST_CASE(OcclusionBufferFullyOccluded)
+{
+	OcclusionBuffer buffer(256, 128);
+	RasterizeWall(buffer);
+
+	BOOST_CHECK(buffer.Occluded(AABBox(float3(-0.5f, -0.5f, 20), float3(0.5f, 0.5f, 21))));
+	BOOST_CHECK(buffer.Occluded(AABBox(float3(-3, -3, 40), float3(3, 3, 45))));
+
+	// The same boxes with nothing in front
+	BOOST_CHECK(!buffer.Occluded(AABBox(float3(-0.5f, -0.5f, 5), float3(0.5f, 0.5f, 6))));
+	buffer.BeginFrame(TestViewProj());
+	buffer.Rasterize();
+	BOOST_CHECK(!buffer.Occluded(AABBox(float3(-0.5f, -0.5f, 20), float3(0.5f, 0.5f, 21))));
+}
+
+BOOST_AUTO_TEST_CASE(OcclusionBufferPartiallyVisible)
+{
+	OcclusionBuffer buffer(256, 128);
+	RasterizeWall(buffer);
+
+	// Sticks out past the right edge of the wall
+	BOOST_CHECK(!buffer.Occluded(AABBox(float3(3, -0.5f, 20), float3(5, 0.5f, 21))));
+	// Sticks out past the top edge
+	BOOST_CHECK(!buffer.Occluded(AABBox(float3(-0.5f, 3, 20), float3(0.5f, 5, 21))));
+	// Goes through the wall
+	BOOST_CHECK(!buffer.Occluded(AABBox(float3(-0.5f, -0.5f, 9), float3(0.5f, 0.5f, 20))));
+}
+
+BOOST_AUTO_TEST_CASE(OcclusionBufferNearPlane)
+{
+	OcclusionBuffer buffer(256, 128);
+	RasterizeWall(buffer);
+
+	// An occludee crossing the near plane is always visible, even if its far part is behind the wall
+	BOOST_CHECK(!buffer.Occluded(AABBox(float3(-0.5f, -0.5f, 0.5f), float3(0.5f, 0.5f, 30))));
+
+	// An occluder crossing the near plane is skipped
+	buffer.BeginFrame(TestViewProj());
+	buffer.AddOccluder(AABBox(float3(-2, -2, 0.5f), float3(2, 2, 11)), float4x4::Identity());
+	BOOST_CHECK_EQUAL(buffer.NumOccluders(), 0U);
+	buffer.Rasterize();
+	BOOST_CHECK(!buffer.Occluded(AABBox(float3(-0.5f, -0.5f, 20), float3(0.5f, 0.5f, 21))));
+}
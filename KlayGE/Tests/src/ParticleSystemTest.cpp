@@ -0,0 +1,100 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KlayGE/App3D.hpp>
+#include <KlayGE/Camera.hpp>
+#include <KlayGE/Context.hpp>
+#include <KlayGE/ParticleSystem.hpp>
+
+#include <boost/assert.hpp>
+#ifdef KLAYGE_COMPILER_CLANG
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wunused-parameter" // Ignore unused parameter in boost
+#endif
+#include <boost/test/unit_test.hpp>
+#ifdef KLAYGE_COMPILER_CLANG
+#pragma clang diagnostic pop
+#endif
+
+#include <algorithm>
+#include <vector>
+
+using namespace std;
+using namespace KlayGE;
+
+namespace
+{
+	// Fills the store directly, so the sort can be tested without emitters
+	class TestParticleSystem : public ParticleSystem
+	{
+	public:
+		explicit TestParticleSystem(uint32_t max_num_particles)
+			: ParticleSystem(max_num_particles)
+		{
+		}
+
+		void SetDepths(vector<float> const & depths)
+		{
+			for (uint32_t i = 0; i < depths.size(); ++ i)
+			{
+				Particle par;
+				par.pos = float3(0, 0, depths[i]);
+				par.vel = float3(0, 0, 0);
+				par.life = 1;
+				par.spin = 0;
+				par.size = 1;
+				par.alpha = 1;
+				par.init_life = 1;
+				this->SetParticle(i, par);
+			}
+			num_alive_ = static_cast<uint32_t>(depths.size());
+		}
+	};
+
+	void CheckSorted(TestParticleSystem const & ps, vector<float> const & depths)
+	{
+		uint32_t const num = static_cast<uint32_t>(depths.size());
+		BOOST_REQUIRE_EQUAL(ps.NumActiveParticles(), num);
+
+		vector<uint32_t> indices(num);
+		for (uint32_t i = 0; i < num; ++ i)
+		{
+			indices[i] = ps.GetActiveParticleIndex(i);
+			BOOST_CHECK(indices[i] < num);
+			if (i > 0)
+			{
+				// Back to front
+				BOOST_CHECK(depths[indices[i - 1]] >= depths[indices[i]]);
+			}
+		}
+
+		sort(indices.begin(), indices.end());
+		for (uint32_t i = 0; i < num; ++ i)
+		{
+			BOOST_CHECK_EQUAL(indices[i], i);
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE(ParticleSystemSortAcrossFrames)
+{
+	Camera& camera = Context::Instance().AppInstance().ActiveCamera();
+	camera.ViewParams(float3(0, 0, 0), float3(0, 0, 1), float3(0, 1, 0));
+
+	uint32_t const MAX_NUM_PARTICLES = 64;
+	TestParticleSystem ps(MAX_NUM_PARTICLES);
+
+	// The keys of 1, 2 and 3 only differ in the highest digit, so the sort takes a single pass. The next frames have
+	//  more, then fewer particles, with keys that take 2 and 3 passes.
+	vector<vector<float>> const frames =
+	{
+		{ 2, 1, 3 },
+		{ 1.5f, 1.25f, 1.75f, 1.125f, 1.0625f },
+		{ 0.5f, 700.0f, 3.0001f, 0.01f, 64.0f, 1e4f, 0.75f, 2.0f },
+		{ 10, 20 }
+	};
+	for (auto const & depths : frames)
+	{
+		ps.SetDepths(depths);
+		ps.SubThreadUpdate(0, 0);
+		CheckSorted(ps, depths);
+	}
+}
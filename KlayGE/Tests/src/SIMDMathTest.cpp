@@ -15,6 +15,7 @@
 #include <vector>
 #include <string>
 #include <iostream>
+#include <random>
 
 using namespace std;
 using namespace KlayGE;
@@ -39,3 +40,107 @@ BOOST_AUTO_TEST_CASE(NormalizeVector4)
 	v = SIMDMathLib::NormalizeVector4(v);
 	BOOST_CHECK(MathLib::abs(SIMDMathLib::GetX(SIMDMathLib::LengthVector4(v)) - 1.0f) < 1e-3f);
 }
+
+namespace
+{
+	// Not a multiple of any SIMD width, so the tails are tested too
+	size_t const BATCH_SIZE = 1027;
+
+	bool NearlyEqual(float lhs, float rhs)
+	{
+		return MathLib::abs(lhs - rhs) <= 1e-4f * std::max(1.0f, MathLib::abs(rhs));
+	}
+
+	std::vector<float> RandomFloats(std::ranlux24_base& gen, size_t num, float range)
+	{
+		std::uniform_real_distribution<float> dis(-range, range);
+		std::vector<float> ret(num);
+		for (auto& f : ret)
+		{
+			f = dis(gen);
+		}
+		return ret;
+	}
+}
+
+BOOST_AUTO_TEST_CASE(TransformCoordBatch)
+{
+	std::ranlux24_base gen(1);
+	std::vector<float> const x = RandomFloats(gen, BATCH_SIZE, 100);
+	std::vector<float> const y = RandomFloats(gen, BATCH_SIZE, 100);
+	std::vector<float> const z = RandomFloats(gen, BATCH_SIZE, 100);
+	float4x4 const mat = MathLib::look_at_lh(float3(10, 20, -300), float3(0, 0, 0))
+		* MathLib::perspective_fov_lh(PI / 4, 1.5f, 1.0f, 1000.0f);
+
+	std::vector<float> out_x(BATCH_SIZE), out_y(BATCH_SIZE), out_z(BATCH_SIZE), depth(BATCH_SIZE);
+	SIMDMathLib::TransformCoordBatch(&out_x[0], &out_y[0], &out_z[0], &x[0], &y[0], &z[0], BATCH_SIZE, mat);
+	SIMDMathLib::TransformDepthBatch(&depth[0], &x[0], &y[0], &z[0], BATCH_SIZE, mat);
+	for (size_t i = 0; i < BATCH_SIZE; ++ i)
+	{
+		float3 const v = MathLib::transform_coord(float3(x[i], y[i], z[i]), mat);
+		BOOST_CHECK(NearlyEqual(out_x[i], v.x()));
+		BOOST_CHECK(NearlyEqual(out_y[i], v.y()));
+		BOOST_CHECK(NearlyEqual(out_z[i], v.z()));
+		BOOST_CHECK(NearlyEqual(depth[i], v.z()));
+	}
+}
+
+BOOST_AUTO_TEST_CASE(TransformAABBBatch)
+{
+	std::ranlux24_base gen(2);
+	std::vector<float> const center = RandomFloats(gen, BATCH_SIZE * 3, 100);
+	std::vector<float> const extent = RandomFloats(gen, BATCH_SIZE * 3, 10);
+	std::vector<AABBox> boxes;
+	for (size_t i = 0; i < BATCH_SIZE; ++ i)
+	{
+		float3 const c(&center[i * 3]);
+		float3 const e = MathLib::abs(float3(&extent[i * 3]));
+		boxes.emplace_back(c - e, c + e);
+	}
+	float4x4 const mat = MathLib::scaling(1.5f, 2.0f, 0.5f) * MathLib::rotation_y(0.7f) * MathLib::rotation_x(-0.3f)
+		* MathLib::translation(5.0f, -10.0f, 20.0f);
+
+	std::vector<AABBox> out(BATCH_SIZE);
+	SIMDMathLib::TransformAABBBatch(&out[0], &boxes[0], BATCH_SIZE, mat);
+	for (size_t i = 0; i < BATCH_SIZE; ++ i)
+	{
+		// The box of the transformed corners. transform_aabb goes through decompose, which loses more precision.
+		float3 expected_min = MathLib::transform_coord(boxes[i].Corner(0), mat);
+		float3 expected_max = expected_min;
+		for (size_t k = 1; k < 8; ++ k)
+		{
+			float3 const corner = MathLib::transform_coord(boxes[i].Corner(k), mat);
+			expected_min = MathLib::minimize(expected_min, corner);
+			expected_max = MathLib::maximize(expected_max, corner);
+		}
+		AABBox const expected(expected_min, expected_max);
+		for (int j = 0; j < 3; ++ j)
+		{
+			BOOST_CHECK(NearlyEqual(out[i].Min()[j], expected.Min()[j]));
+			BOOST_CHECK(NearlyEqual(out[i].Max()[j], expected.Max()[j]));
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE(MultiplyBatch)
+{
+	std::ranlux24_base gen(3);
+	std::vector<float> const elems = RandomFloats(gen, (BATCH_SIZE + 1) * 16, 10);
+	std::vector<float4x4> lhs;
+	for (size_t i = 0; i < BATCH_SIZE; ++ i)
+	{
+		lhs.emplace_back(&elems[i * 16]);
+	}
+	float4x4 const rhs(&elems[BATCH_SIZE * 16]);
+
+	std::vector<float4x4> out = lhs;
+	SIMDMathLib::MultiplyBatch(&out[0], &out[0], BATCH_SIZE, rhs);
+	for (size_t i = 0; i < BATCH_SIZE; ++ i)
+	{
+		float4x4 const expected = MathLib::mul(lhs[i], rhs);
+		for (int j = 0; j < 16; ++ j)
+		{
+			BOOST_CHECK(NearlyEqual(out[i][j], expected[j]));
+		}
+	}
+}
@@ -0,0 +1,142 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Util.hpp>
+#include <KFL/ResIdentifier.hpp>
+#include <KFL/XMLReader.hpp>
+
+#include <boost/assert.hpp>
+#ifdef KLAYGE_COMPILER_CLANG
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wunused-parameter" // Ignore unused parameter in boost
+#endif
+#include <boost/test/unit_test.hpp>
+#ifdef KLAYGE_COMPILER_CLANG
+#pragma clang diagnostic pop
+#endif
+
+#include <clocale>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <system_error>
+
+using namespace std;
+using namespace KlayGE;
+
+namespace
+{
+	ResIdentifierPtr MakeSource(string const & xml)
+	{
+		return MakeSharedPtr<ResIdentifier>("", 0, MakeSharedPtr<istringstream>(xml));
+	}
+}
+
+BOOST_AUTO_TEST_CASE(XMLReaderEvents)
+{
+	// A tiny window forces every tag across a refill
+	XMLReader reader(MakeSource("<?xml version=\"1.0\"?>\n<!-- comment -->\n"
+		"<root version=\"2\">\n"
+		"\t<item name=\"a &amp; b\" v=\"1 -2.5 3e2\"/>\n"
+		"\t<skipped><deep x='1'/></skipped>\n"
+		"\t<item name='c'>text</item>\n"
+		"</root>\n"), 16);
+
+	BOOST_CHECK(reader.Next() == XRE_StartElement);
+	BOOST_CHECK(reader.Name() == "root");
+	BOOST_CHECK_EQUAL(reader.AttribInt("version", 0), 2);
+	uint32_t const root_depth = reader.Depth();
+
+	BOOST_CHECK(reader.NextChildElement(root_depth));
+	BOOST_CHECK(reader.Name() == "item");
+	BOOST_CHECK(reader.IsEmptyElement());
+	BOOST_CHECK_EQUAL(reader.AttribString("name", ""), "a & b");
+	float v[4] = { 0, 0, 0, 0 };
+	BOOST_CHECK_EQUAL(reader.AttribFloats("v", v, 4), 3U);
+	BOOST_CHECK_EQUAL(v[0], 1.0f);
+	BOOST_CHECK_EQUAL(v[1], -2.5f);
+	BOOST_CHECK_EQUAL(v[2], 300.0f);
+
+	BOOST_CHECK(reader.NextChildElement(root_depth));
+	BOOST_CHECK(reader.Name() == "skipped");
+	BOOST_CHECK_EQUAL(reader.ReadElementXML(), "<skipped><deep x='1'/></skipped>");
+
+	BOOST_CHECK(reader.NextChildElement(root_depth));
+	BOOST_CHECK_EQUAL(reader.AttribString("name", ""), "c");
+	BOOST_CHECK(reader.Next() == XRE_Text);
+	BOOST_CHECK_EQUAL(reader.ValueString(), "text");
+	BOOST_CHECK(reader.Next() == XRE_EndElement);
+	BOOST_CHECK(reader.Name() == "item");
+
+	BOOST_CHECK(!reader.NextChildElement(root_depth));
+	BOOST_CHECK(reader.Name() == "root");
+	BOOST_CHECK(reader.Next() == XRE_EndOfDocument);
+}
+
+BOOST_AUTO_TEST_CASE(XMLReaderNumbers)
+{
+	char const * floats[] = { "0", "-0.5", "3.14159274", "0.1", "1e-7", "16777217", "123456.789", "1.17549435e-38", "3.4e38" };
+	for (auto str : floats)
+	{
+		float val = 0;
+		BOOST_CHECK(XMLReader::ParseFloat(str, val));
+		BOOST_CHECK_EQUAL(val, strtof(str, nullptr));
+	}
+
+	float f;
+	BOOST_CHECK(!XMLReader::ParseFloat("1.0x", f));
+	BOOST_CHECK(!XMLReader::ParseFloat("", f));
+
+	int32_t i;
+	BOOST_CHECK(XMLReader::ParseInt("-2147483648", i));
+	BOOST_CHECK_EQUAL(i, INT32_MIN);
+	BOOST_CHECK(!XMLReader::ParseInt("2147483648", i));
+
+	uint32_t u;
+	BOOST_CHECK(XMLReader::ParseUInt(" 4294967295 ", u));
+	BOOST_CHECK_EQUAL(u, 4294967295U);
+	BOOST_CHECK(!XMLReader::ParseUInt("-1", u));
+}
+
+BOOST_AUTO_TEST_CASE(XMLReaderCDATA)
+{
+	XMLReader reader(MakeSource("<a><![CDATA[x &amp; <y>]]></a>"), 16);
+
+	BOOST_CHECK(reader.Next() == XRE_StartElement);
+	BOOST_CHECK(reader.Next() == XRE_Text);
+	BOOST_CHECK_EQUAL(reader.ValueString(), "x &amp; <y>");
+	BOOST_CHECK(reader.Next() == XRE_EndElement);
+	BOOST_CHECK(reader.Next() == XRE_EndOfDocument);
+}
+
+BOOST_AUTO_TEST_CASE(XMLReaderMismatchedEndTag)
+{
+	XMLReader reader(MakeSource("<a><b></a></b>"));
+
+	BOOST_CHECK(reader.Next() == XRE_StartElement);
+	BOOST_CHECK(reader.Next() == XRE_StartElement);
+	BOOST_CHECK_THROW(reader.Next(), std::system_error);
+}
+
+BOOST_AUTO_TEST_CASE(XMLReaderFloatLocale)
+{
+	// Long mantissas take the strtof fallback, which must not follow a decimal comma locale
+	char const * long_float = "3.14159265358979323846264338327950288";
+	float const expected = 3.14159274f;
+
+	float val = 0;
+	BOOST_CHECK(XMLReader::ParseFloat(long_float, val));
+	BOOST_CHECK_EQUAL(val, expected);
+
+	std::string const old_locale = setlocale(LC_NUMERIC, nullptr);
+	char const * comma_locales[] = { "de_DE.UTF-8", "de_DE", "fr_FR.UTF-8", "German" };
+	for (auto name : comma_locales)
+	{
+		if (setlocale(LC_NUMERIC, name))
+		{
+			val = 0;
+			BOOST_CHECK(XMLReader::ParseFloat(long_float, val));
+			BOOST_CHECK_EQUAL(val, expected);
+			break;
+		}
+	}
+	setlocale(LC_NUMERIC, old_locale.c_str());
+}
@@ -8,209 +8,183 @@
 #include <KlayGE/RenderFactory.hpp>
 #include <KlayGE/Context.hpp>
 #include <KlayGE/RenderSettings.hpp>
+#include <KlayGE/ResLoader.hpp>
+#include <KlayGE/Texture.hpp>
+#include <KFL/Thread.hpp>
+#include <KFL/Timer.hpp>
 
+#include <algorithm>
 #include <cmath>
+#include <fstream>
+#include <functional>
 #include <iostream>
 #include <sstream>
 #include <string>
 #include <vector>
-#include <ctime>
 #include <cstring>
 #include <boost/assert.hpp>
 
 using namespace std;
 using namespace KlayGE;
 
-// A type to hold the distance map while it's being constructed
-template <typename DistanceType>
-class DistanceMap
-{
-public:
-	DistanceMap(int width, int height, int depth)
-		: data_(width * height * depth * 3),
-			width_(width), height_(height), depth_(depth)
-	{
-	}
+// Fills the occupancy of rows [y_begin, y_end) of all the slices. slab is laid out as depth x (y_end - y_begin) x width.
+typedef std::function<void(int y_begin, int y_end, uint8_t* slab)> VolumeSource;
+// Takes the distances of rows [y_begin, y_end) of all the slices, in the same layout.
+typedef std::function<void(int y_begin, int y_end, uint8_t const * slab)> VolumeSink;
 
-	DistanceType& operator()(int x, int y, int z, int i)
-	{
-		return data_[((z * height_ + y) * width_ + x) * 3 + i];
-	}
+float const EDT_INF = 1e20f;
 
-	DistanceType const & operator()(int x, int y, int z, int i) const
-	{
-		return data_[((z * height_ + y) * width_ + x) * 3 + i];
-	}
-
-	bool inside(int x, int y, int z) const
-	{
-		return (0 <= x) && (x < width_)
-			&& (0 <= y) && (y < height_)
-			&& (0 <= z) && (z < depth_);
-	}
-
-	// Do a single pass over the data.
-	// Start at (x,y,z) and walk in the direction (cx,cy,cz)
-	// Combine each pixel (x,y,z) with the value at (x+dx,y+dy,z+dz)
-	void combine(int dx, int dy, int dz,
-		int cx, int cy, int cz,
-		int x, int y, int z)
+// 1D squared Euclidean distance transform of sampled function (Felzenszwalb and Huttenlocher). f is read and written
+//  with stride. v, z and d are scratch buffers of n, n + 1 and n elements.
+void DistanceTransform1D(float* f, int n, ptrdiff_t stride, int* v, float* z, float* d)
+{
+	int k = 0;
+	v[0] = 0;
+	z[0] = -EDT_INF;
+	z[1] = +EDT_INF;
+	for (int q = 1; q < n; ++ q)
 	{
-		while (inside(x, y, z) && inside(x + dx, y + dy, z + dz))
+		float const fq = f[q * stride] + static_cast<float>(q * q);
+		float s;
+		for (;;)
 		{
-			int d[3] =
-			{
-				abs(dx),
-				abs(dy),
-				abs(dz)
-			};
-
-			uint32_t v1[3], v2[3];
-			for (int i = 0; i < 3; ++ i)
-			{
-				v1[i] = operator()(x, y, z, i);
-				v2[i] = operator()(x + dx, y + dy, z + dz, i) + d[i];
-			}
-
-			if (v1[0] * v1[0] + v1[1] * v1[1] + v1[2] * v1[2] > v2[0] * v2[0] + v2[1] * v2[1] + v2[2] * v2[2])
+			int const p = v[k];
+			s = (fq - (f[p * stride] + static_cast<float>(p * p))) / (2 * (q - p));
+			if ((s > z[k]) || (0 == k))
 			{
-				for (int i = 0; i < 3; ++ i)
-				{
-					operator()(x, y, z, i) = static_cast<DistanceType>(v2[i]);
-				}
+				break;
 			}
-
-			x += cx;
-			y += cy;
-			z += cz;
+			-- k;
 		}
+		++ k;
+		v[k] = q;
+		z[k] = s;
+		z[k + 1] = +EDT_INF;
 	}
 
-private:
-	std::vector<DistanceType> data_;
-	int width_, height_, depth_;
-};
-
-void ComputeDistanceField(std::vector<uint8_t>& distances, int width, int height, int depth,
-						std::vector<uint8_t> const & volume)
-{
-	// and +infinity above
-	DistanceMap<uint16_t> dmap(width, height, depth);
-	for (int z = 0; z < depth; ++ z)
+	k = 0;
+	for (int q = 0; q < n; ++ q)
 	{
-		for (int y = 0; y < height; ++ y)
+		while (z[k + 1] < q)
 		{
-			for (int x = 0; x < width; ++ x)
-			{
-				for (int i = 0; i < 3; ++ i)
-				{
-					if (volume[(z * height + y) * width + x] != 0)
-					{
-						dmap(x, y, z, i) = 0;
-					}
-					else
-					{
-						dmap(x, y, z, i) = std::numeric_limits<uint16_t>::max();
-					}
-				}
-			}
+			++ k;
 		}
+		int const p = v[k];
+		d[q] = static_cast<float>((q - p) * (q - p)) + f[p * stride];
 	}
-
-
-	// Compute the rest of dmap by sequential sweeps over the data
-	// using a 3d variant of Danielsson's algorithm
-
-	for (int z = 1; z < depth; ++ z)
+	for (int q = 0; q < n; ++ q)
 	{
-		// combine with everything with dz = -1
-		for (int y = 0; y < height; ++ y)
-		{
-			dmap.combine(0, 0, -1,
-				1, 0, 0,
-				0, y, z);
-		}
-
-		for (int y = 1; y < height; ++ y)
-		{
-			dmap.combine(0, -1, 0,
-				1, 0, 0,
-				0, y, z);
-			dmap.combine(-1, 0, 0,
-				1, 0, 0,
-				1, y, z);
-			dmap.combine(+1, 0, 0,
-				-1, 0, 0,
-				width - 2, y, z);
-		}
+		f[q * stride] = d[q];
+	}
+}
 
-		for (int y = height - 1; y >= 0; -- y)
-		{
-			dmap.combine(0, +1, 0,
-				1, 0, 0,
-				0, y, z);
-			dmap.combine(-1, 0, 0,
-				1, 0, 0,
-				1, y, z);
-			dmap.combine(+1, 0, 0,
-				-1, 0, 0,
-				width - 1, y, z);
-		}
+// Exact Euclidean distance field, in separable passes along x, y and z. Each pass runs on the thread pool.
+//  Distances are normalized by depth and saturate at 1, so features further than depth voxels don't matter. That
+//  makes it possible to stream the volume in slabs of slab_rows rows, each with a halo of depth rows on both sides.
+//  Only one slab and its halo live in memory at a time, and each one goes to sink when it's done. 0 slab_rows
+//  processes the whole volume at once.
+void ComputeDistanceField(int width, int height, int depth, VolumeSource const & source, VolumeSink const & sink,
+						int slab_rows)
+{
+	if (slab_rows <= 0)
+	{
+		slab_rows = height;
 	}
+	int const halo = depth;
+	int const max_dim = std::max(std::max(width, height), depth);
 
-	for (int z = depth - 1; z >= 0; -- z)
+	auto& tp = Context::Instance().ThreadPool();
+
+	std::vector<uint8_t> volume;
+	std::vector<float> field;
+	std::vector<uint8_t> distances;
+	for (int slab_begin = 0; slab_begin < height; slab_begin += slab_rows)
 	{
 		cout << ".";
 
-		// combine with everything with dz = +1
-		for (int y = 0; y < height; ++ y)
-		{
-			dmap.combine(0, 0, +1,
-				1, 0, 0,
-				0, y, z);
-		}
+		int const slab_end = std::min(slab_begin + slab_rows, height);
+		int const y_begin = std::max(slab_begin - halo, 0);
+		int const y_end = std::min(slab_end + halo, height);
+		int const rows = y_end - y_begin;
+		size_t const slice_size = static_cast<size_t>(rows) * width;
+
+		volume.resize(depth * slice_size);
+		source(y_begin, y_end, &volume[0]);
 
-		for (int y = 1; y < height; ++ y)
+		field.resize(volume.size());
+		for (size_t i = 0; i < volume.size(); ++ i)
 		{
-			dmap.combine(0, -1, 0,
-				1, 0, 0,
-				0, y, z);
-			dmap.combine(-1, 0, 0,
-				1, 0, 0,
-				1, y, z);
-			dmap.combine(+1, 0, 0,
-				-1, 0, 0,
-				width - 2, y, z);
+			field[i] = (volume[i] != 0) ? 0 : EDT_INF;
 		}
-		for (int y = height - 1; y >= 0; -- y)
+
+		// Passes along x and y are independent among slices
 		{
-			dmap.combine(0, +1, 0,
-				1, 0, 0,
-				0, y, z);
-			dmap.combine(-1, 0, 0,
-				1, 0, 0,
-				1, y, z);
-			dmap.combine(+1, 0, 0,
-				-1, 0, 0,
-				width - 1, y, z);
+			std::vector<joiner<void>> joiners;
+			for (int z = 0; z < depth; ++ z)
+			{
+				joiners.push_back(tp([&field, width, rows, slice_size, max_dim, z]
+					{
+						std::vector<int> v(max_dim);
+						std::vector<float> zs(max_dim + 1);
+						std::vector<float> d(max_dim);
+
+						float* slice = &field[z * slice_size];
+						for (int y = 0; y < rows; ++ y)
+						{
+							DistanceTransform1D(slice + y * width, width, 1, &v[0], &zs[0], &d[0]);
+						}
+						for (int x = 0; x < width; ++ x)
+						{
+							DistanceTransform1D(slice + x, rows, width, &v[0], &zs[0], &d[0]);
+						}
+					}));
+			}
+			for (auto& j : joiners)
+			{
+				j();
+			}
 		}
-	}
 
-	for (int z = 0; z < depth; ++ z)
-	{
-		for (int y = 0; y < height; ++ y)
+		// Pass along z, split by rows. Only the rows of the slab itself are needed from now on.
+		int const slab_height = slab_end - slab_begin;
+		distances.resize(static_cast<size_t>(depth) * slab_height * width);
 		{
-			for (int x = 0; x < width; ++ x)
+			int const ROWS_PER_TASK = 16;
+
+			std::vector<joiner<void>> joiners;
+			for (int y_start = slab_begin; y_start < slab_end; y_start += ROWS_PER_TASK)
 			{
-				float value = 0;
-				for (int i = 0; i < 3; ++ i)
-				{
-					value += dmap(x, y, z, i) * dmap(x, y, z, i);
-				}
-				distances[(z * height + y) * width + x]
-					= static_cast<uint8_t>(MathLib::clamp(sqrt(value) / depth, 0.0f, 1.0f) * 255);
+				joiners.push_back(tp([&field, &distances, width, depth, y_begin, slab_begin, slab_end, slab_height, slice_size,
+					max_dim, y_start]
+					{
+						std::vector<int> v(max_dim);
+						std::vector<float> zs(max_dim + 1);
+						std::vector<float> d(max_dim);
+
+						float const inv_depth = 1.0f / depth;
+						int const y_stop = std::min(y_start + ROWS_PER_TASK, slab_end);
+						for (int y = y_start; y < y_stop; ++ y)
+						{
+							for (int x = 0; x < width; ++ x)
+							{
+								float* column = &field[(y - y_begin) * width + x];
+								DistanceTransform1D(column, depth, slice_size, &v[0], &zs[0], &d[0]);
+								for (int z = 0; z < depth; ++ z)
+								{
+									distances[(z * slab_height + y - slab_begin) * width + x] = static_cast<uint8_t>(
+										MathLib::clamp(sqrt(column[z * slice_size]) * inv_depth, 0.0f, 1.0f) * 255);
+								}
+							}
+						}
+					}));
+			}
+			for (auto& j : joiners)
+			{
+				j();
 			}
 		}
+
+		sink(slab_begin, slab_end, &distances[0]);
 	}
 }
 
@@ -262,6 +236,12 @@ int main(int argc, char* argv[])
 		std::stringstream ss(argv[5]);
 		ss >> depth;
 	}
+	int slab_rows = 0;
+	if (argc > 6)
+	{
+		std::stringstream ss(argv[6]);
+		ss >> slab_rows;
+	}
 
 	Context::Instance().LoadCfg("KlayGE.cfg");
 	ContextCfg context_cfg = Context::Instance().Config();
@@ -274,92 +254,166 @@ int main(int argc, char* argv[])
 	DistanceMapCreatorApp app;
 	app.Create();
 
-	std::vector<uint8_t> volume(width * height * depth);
-	TexturePtr src_texture = SyncLoadTexture(src_name, EAH_CPU_Read | EAH_CPU_Write);
-	if (Texture::TT_2D == src_texture->Type())
+	Texture::TextureType src_type;
+	uint32_t src_width, src_height, src_depth, src_num_mipmaps, src_array_size;
+	ElementFormat src_format;
+	uint32_t src_row_pitch, src_slice_pitch;
+	GetImageInfo(src_name, src_type, src_width, src_height, src_depth, src_num_mipmaps, src_array_size, src_format,
+		src_row_pitch, src_slice_pitch);
+
+	std::vector<uint8_t> volume;
+	std::vector<uint8_t> height_map;
+	ResIdentifierPtr src_file;
+	VolumeSource source;
+	if ((Texture::TT_3D == src_type) && (EF_R8 == src_format) && (static_cast<int>(src_width) == width)
+		&& (static_cast<int>(src_height) == height) && (static_cast<int>(src_depth) == depth))
 	{
-		TexturePtr height_map_texture = render_factory.MakeTexture2D(width, height, 1, 1, EF_R8, 1, 0, EAH_CPU_Read | EAH_CPU_Write, nullptr);
-		src_texture->CopyToTexture(*height_map_texture);
-
-		uint32_t texel_size = NumFormatBytes(height_map_texture->Format());
+		// Already in the right size and format. The slabs are read from the file directly, so the volume is never in
+		//  memory as a whole. The first level of the DDS is followed by its mipmaps, all of them end the file.
+		src_file = ResLoader::Instance().Open(src_name);
 
-		std::vector<uint8_t> height_map(height * width);
+		uint64_t mip_chain_size = 0;
+		for (uint32_t l = 0; l < src_num_mipmaps; ++ l)
 		{
-			Texture::Mapper mapper(*height_map_texture, 0, 0, TMA_Read_Only, 0, 0, width, height);
-			uint8_t* data = mapper.Pointer<uint8_t>();
-			for (int y = 0; y < height; ++ y)
-			{
-				std::memcpy(&height_map[y * width], data, width * texel_size);
-				data += mapper.RowPitch();
-			}
+			mip_chain_size += static_cast<uint64_t>(std::max(width >> l, 1)) * std::max(height >> l, 1)
+				* std::max(depth >> l, 1);
 		}
+		src_file->seekg(0, std::ios_base::end);
+		int64_t const data_offset = src_file->tellg() - static_cast<int64_t>(mip_chain_size);
 
-		for (int z = 0; z < depth; ++ z)
+		source = [&src_file, data_offset, width, height, depth](int y_begin, int y_end, uint8_t* slab)
 		{
-			for (int y = 0; y < height; ++ y)
+			int const rows = y_end - y_begin;
+			for (int z = 0; z < depth; ++ z)
 			{
-				for (int x = 0; x < width; ++ x)
-				{
-					if (height_map[y * width + x] >= z * (256 / depth))
-					{
-						volume[z * width * height + y * width + x] = 255;
-					}
-					else
-					{
-						volume[z * width * height + y * width + x] = 0;
-					}
-				}
+				src_file->seekg(data_offset + (static_cast<int64_t>(z) * height + y_begin) * width, std::ios_base::beg);
+				src_file->read(&slab[z * width * rows], width * rows);
 			}
-		}
+		};
 	}
 	else
 	{
-		BOOST_ASSERT(Texture::TT_3D == src_texture->Type());
-
-		TexturePtr vol_map_texture = render_factory.MakeTexture3D(width, height, depth, 1, 1, EF_R8, 1, 0, EAH_CPU_Read | EAH_CPU_Write, nullptr);
-		src_texture->CopyToTexture(*vol_map_texture);
+		// Converted to the size and format on the GPU. A height map is small, but a volume is loaded as a whole here.
+		TexturePtr src_texture = SyncLoadTexture(src_name, EAH_CPU_Read | EAH_CPU_Write);
+		if (Texture::TT_2D == src_texture->Type())
+		{
+			TexturePtr height_map_texture = render_factory.MakeTexture2D(width, height, 1, 1, EF_R8, 1, 0, EAH_CPU_Read | EAH_CPU_Write, nullptr);
+			src_texture->CopyToTexture(*height_map_texture);
 
-		uint32_t texel_size = NumFormatBytes(vol_map_texture->Format());
+			uint32_t texel_size = NumFormatBytes(height_map_texture->Format());
 
-		Texture::Mapper mapper(*vol_map_texture, 0, 0, TMA_Read_Only, 0, 0, 0, width, height, depth);
-		uint8_t* data = mapper.Pointer<uint8_t>();
-		for (int z = 0; z < depth; ++ z)
-		{
-			for (int y = 0; y < height; ++ y)
+			height_map.resize(height * width);
 			{
-				std::memcpy(&volume[z * width * height + y * width], data, width * texel_size);
-				data += mapper.RowPitch();
+				Texture::Mapper mapper(*height_map_texture, 0, 0, TMA_Read_Only, 0, 0, width, height);
+				uint8_t* data = mapper.Pointer<uint8_t>();
+				for (int y = 0; y < height; ++ y)
+				{
+					std::memcpy(&height_map[y * width], data, width * texel_size);
+					data += mapper.RowPitch();
+				}
 			}
-			data += mapper.SlicePitch() - mapper.RowPitch() * height;
+
+			// The volume is generated slab by slab, so it never has to be in memory as a whole
+			source = [&height_map, width, depth](int y_begin, int y_end, uint8_t* slab)
+			{
+				int const rows = y_end - y_begin;
+				for (int z = 0; z < depth; ++ z)
+				{
+					for (int y = y_begin; y < y_end; ++ y)
+					{
+						for (int x = 0; x < width; ++ x)
+						{
+							if (height_map[y * width + x] >= z * (256 / depth))
+							{
+								slab[z * width * rows + (y - y_begin) * width + x] = 255;
+							}
+							else
+							{
+								slab[z * width * rows + (y - y_begin) * width + x] = 0;
+							}
+						}
+					}
+				}
+			};
 		}
-	}
+		else
+		{
+			BOOST_ASSERT(Texture::TT_3D == src_texture->Type());
 
-	clock_t start = clock();
+			TexturePtr vol_map_texture = render_factory.MakeTexture3D(width, height, depth, 1, 1, EF_R8, 1, 0, EAH_CPU_Read | EAH_CPU_Write, nullptr);
+			src_texture->CopyToTexture(*vol_map_texture);
 
-	std::vector<uint8_t> distances(width * height * depth);
-	ComputeDistanceField(distances, width, height, depth, volume);
+			uint32_t texel_size = NumFormatBytes(vol_map_texture->Format());
 
-	cout << endl << "Computing time: " << clock() - start << " ms" << endl;
+			volume.resize(width * height * depth);
+			Texture::Mapper mapper(*vol_map_texture, 0, 0, TMA_Read_Only, 0, 0, 0, width, height, depth);
+			uint8_t* data = mapper.Pointer<uint8_t>();
+			for (int z = 0; z < depth; ++ z)
+			{
+				for (int y = 0; y < height; ++ y)
+				{
+					std::memcpy(&volume[z * width * height + y * width], data, width * texel_size);
+					data += mapper.RowPitch();
+				}
+				data += mapper.SlicePitch() - mapper.RowPitch() * height;
+			}
 
-	TexturePtr distance_map_texture = render_factory.MakeTexture3D(width, height, depth, 1, 1, EF_R8, 1, 0, EAH_CPU_Read | EAH_CPU_Write, nullptr);
+			source = [&volume, width, height, depth](int y_begin, int y_end, uint8_t* slab)
+			{
+				int const rows = y_end - y_begin;
+				for (int z = 0; z < depth; ++ z)
+				{
+					std::memcpy(&slab[z * width * rows], &volume[(z * height + y_begin) * width], width * rows);
+				}
+			};
+		}
+	}
 
+	// SaveTexture takes the whole volume, so it only writes the header and one slice here. The depth in the header is
+	//  patched, and each slab is written to its place in every slice as soon as it's done.
+	{
+		std::vector<uint8_t> slice(width * height, 0);
+		std::vector<ElementInitData> init_data(1);
+		init_data[0].data = &slice[0];
+		init_data[0].row_pitch = width;
+		init_data[0].slice_pitch = width * height;
+		SaveTexture(distance_name, Texture::TT_3D, width, height, 1, 1, 1, EF_R8, init_data);
+	}
+	std::fstream distance_file(distance_name.c_str(), std::ios_base::in | std::ios_base::out | std::ios_base::binary);
+	if (!distance_file)
+	{
+		cout << "Couldn't open " << distance_name << endl;
+		Context::Destroy();
+		return 1;
+	}
 	{
-		uint32_t texel_size = NumFormatBytes(distance_map_texture->Format());
+		// After the magic number, and the size, flags, height, width and pitch of DDSSURFACEDESC2
+		uint32_t const DDS_DEPTH_OFFSET = 24;
+		uint32_t const depth_le = Native2LE(static_cast<uint32_t>(depth));
+		distance_file.seekp(DDS_DEPTH_OFFSET, std::ios_base::beg);
+		distance_file.write(reinterpret_cast<char const *>(&depth_le), sizeof(depth_le));
+	}
+	distance_file.seekp(0, std::ios_base::end);
+	int64_t const distance_data_offset = static_cast<int64_t>(distance_file.tellp()) - width * height;
 
-		Texture::Mapper mapper(*distance_map_texture, 0, 0, TMA_Write_Only, 0, 0, 0, width, height, depth);
-		uint8_t* data = mapper.Pointer<uint8_t>();
+	VolumeSink sink = [&distance_file, distance_data_offset, width, height, depth](int y_begin, int y_end,
+		uint8_t const * slab)
+	{
+		int const rows = y_end - y_begin;
 		for (int z = 0; z < depth; ++ z)
 		{
-			for (int y = 0; y < height; ++ y)
-			{
-				std::memcpy(data, &distances[z * width * height + y * width], width * texel_size);
-				data += mapper.RowPitch();
-			}
-			data += mapper.SlicePitch() - mapper.RowPitch() * height;
+			distance_file.seekp(distance_data_offset + (static_cast<int64_t>(z) * height + y_begin) * width,
+				std::ios_base::beg);
+			distance_file.write(reinterpret_cast<char const *>(&slab[z * width * rows]), width * rows);
 		}
-	}
+	};
+
+	Timer timer;
+
+	ComputeDistanceField(width, height, depth, source, sink, slab_rows);
+	distance_file.close();
 
-	SaveTexture(distance_map_texture, distance_name);
+	cout << endl << "Computing time: " << static_cast<int>(timer.elapsed() * 1000) << " ms" << endl;
 
 	cout << "Distance map is saved to " << distance_name << endl;
 
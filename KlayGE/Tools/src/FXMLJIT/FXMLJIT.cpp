@@ -38,6 +38,8 @@
 
 #include <boost/algorithm/string/case_conv.hpp>
 
+#include <DXBC2GLSL/DXBC2GLSLCache.hpp>
+
 #include "OfflineRenderEffect.hpp"
 
 using namespace std;
@@ -145,6 +147,14 @@ int main(int argc, char* argv[])
 
 	ResLoader::Instance().AddPath("../../Tools/media/PlatformDeployer");
 
+	// The same cache as the runtime's. FXMLJIT runs once per effect, so translations are only shared through the files.
+	filesystem::path const dxbc2glsl_cache_dir = filesystem::path(ResLoader::Instance().LocalFolder()) / "DXBC2GLSLCache";
+	if (!filesystem::exists(dxbc2glsl_cache_dir))
+	{
+		filesystem::create_directories(dxbc2glsl_cache_dir);
+	}
+	DXBC2GLSL::DXBC2GLSLCache::Instance().Directory(dxbc2glsl_cache_dir.string());
+
 	std::string platform = argv[1];
 
 	if (("pc_dx11" == platform) || ("pc_dx10" == platform) || ("pc_dx9" == platform) || ("win_tegra3" == platform)
@@ -8,11 +8,13 @@
 #include <KFL/XMLDom.hpp>
 #include <KlayGE/App3D.hpp>
 #include <KlayGE/RenderFactory.hpp>
+#include <KFL/Thread.hpp>
 
 #include <iostream>
 #include <vector>
 #include <list>
 #include <map>
+#include <algorithm>
 #include <cstring>
 
 #include <KlayGE/JudaTexture.hpp>
@@ -117,6 +119,19 @@ void PackJTML(std::string const & jtml_name)
 	}
 	uint32_t pixel_size = NumFormatBytes(format);
 
+	// Optional tiles baked for a BC cache, so that the runtime can upload them as they are
+	std::string bake_fmt_str = root->AttribString("bake_format", "");
+	ElementFormat bake_format = EF_Unknown;
+	if ("BC1" == bake_fmt_str)
+	{
+		bake_format = EF_BC1;
+	}
+	else if ("BC3" == bake_fmt_str)
+	{
+		bake_format = EF_BC3;
+	}
+	uint32_t bake_border = root->AttribInt("bake_border", 4);
+
 	JudaTexturePtr juda_tex = MakeSharedPtr<JudaTexture>(num_tiles, tile_size, format);
 
 	uint32_t level = juda_tex->TreeLevels() - 1;
@@ -224,53 +239,82 @@ void PackJTML(std::string const & jtml_name)
 
 		juda_tex->AddImageEntry(name, x, y, in_num_tiles_x, in_num_tiles_y, addr_u, addr_v, border_clr);
 
+		// Several rows of tiles are cut on all the cores, and committed together. The tiles keep the row-major order,
+		//  so the output doesn't depend on the number of threads.
+		uint32_t const BATCH_TILES = 1024;
+		int32_t const tiles_a_row = end_tile_x - beg_tile_x;
+		int32_t const rows_a_batch = std::max(1, static_cast<int32_t>(BATCH_TILES) / std::max(1, tiles_a_row));
+
 		std::vector<std::vector<uint8_t>> tiles;
 		std::vector<uint32_t> tile_ids;
 		std::vector<uint32_t> tile_attrs;
-		for (int32_t by = beg_tile_y; by < end_tile_y; ++ by)
+		std::vector<joiner<void>> joiners;
+		for (int32_t batch_y = beg_tile_y; batch_y < end_tile_y; batch_y += rows_a_batch)
 		{
+			int32_t const batch_end_y = std::min(batch_y + rows_a_batch, end_tile_y);
+
 			tiles.clear();
 			tile_ids.clear();
 			tile_attrs.clear();
-			for (int32_t bx = beg_tile_x; bx < end_tile_x; ++ bx)
+			for (int32_t by = batch_y; by < batch_end_y; ++ by)
 			{
-				uint32_t xindex = bx - beg_tile_x;
-
-				tiles.push_back(std::vector<uint8_t>(tile_size * tile_size * pixel_size, 0));
-				tile_ids.push_back(juda_tex->EncodeTileID(level, bx + x, by + y));
-				tile_attrs.push_back(attr);
-				for (size_t dy = 0; dy < tile_size; ++ dy)
+				for (int32_t bx = beg_tile_x; bx < end_tile_x; ++ bx)
 				{
-					int32_t tex_y = (*calc_v)(static_cast<int32_t>(by * tile_size + dy), in_height);
-					if (tex_y >= 0)
+					tiles.push_back(std::vector<uint8_t>(tile_size * tile_size * pixel_size, 0));
+					tile_ids.push_back(juda_tex->EncodeTileID(level, bx + x, by + y));
+					tile_attrs.push_back(attr);
+				}
+			}
+
+			joiners.clear();
+			for (int32_t by = batch_y; by < batch_end_y; ++ by)
+			{
+				joiners.push_back(Context::Instance().ThreadPool()(
+					[by, batch_y, beg_tile_x, end_tile_x, tiles_a_row, tile_size, pixel_size, in_width, in_height,
+						in_data_p, border_clr_u8, &calc_u, &calc_v, &mapper, &tiles]
 					{
-						for (size_t dx = 0; dx < tile_size; ++ dx)
+						for (int32_t bx = beg_tile_x; bx < end_tile_x; ++ bx)
 						{
-							int32_t tex_x = (*calc_u)(static_cast<int32_t>(bx * tile_size + dx), in_width);
-							if (tex_x >= 0)
-							{
-								std::memcpy(&tiles[xindex][(dy * tile_size + dx) * pixel_size],
-									&in_data_p[tex_y * mapper.RowPitch() + tex_x * pixel_size],
-									pixel_size);
-							}
-							else
+							uint32_t const index = (by - batch_y) * tiles_a_row + (bx - beg_tile_x);
+
+							for (size_t dy = 0; dy < tile_size; ++ dy)
 							{
-								std::memcpy(&tiles[xindex][(dy * tile_size + dx) * pixel_size],
-									&border_clr_u8,
-									pixel_size);
+								int32_t tex_y = (*calc_v)(static_cast<int32_t>(by * tile_size + dy), in_height);
+								if (tex_y >= 0)
+								{
+									for (size_t dx = 0; dx < tile_size; ++ dx)
+									{
+										int32_t tex_x = (*calc_u)(static_cast<int32_t>(bx * tile_size + dx), in_width);
+										if (tex_x >= 0)
+										{
+											std::memcpy(&tiles[index][(dy * tile_size + dx) * pixel_size],
+												&in_data_p[tex_y * mapper.RowPitch() + tex_x * pixel_size],
+												pixel_size);
+										}
+										else
+										{
+											std::memcpy(&tiles[index][(dy * tile_size + dx) * pixel_size],
+												&border_clr_u8,
+												pixel_size);
+										}
+									}
+								}
+								else
+								{
+									for (size_t dx = 0; dx < tile_size; ++ dx)
+									{
+										std::memcpy(&tiles[index][(dy * tile_size + dx) * pixel_size],
+											&border_clr_u8,
+											pixel_size);
+									}
+								}
 							}
 						}
-					}
-					else
-					{
-						for (size_t dx = 0; dx < tile_size; ++ dx)
-						{
-							std::memcpy(&tiles[xindex][(dy * tile_size + dx) * pixel_size],
-								&border_clr_u8,
-								pixel_size);
-						}
-					}
-				}
+					}));
+			}
+			for (auto& j : joiners)
+			{
+				j();
 			}
 
 			juda_tex->CommitTiles(tiles, tile_ids, tile_attrs);
@@ -283,6 +327,12 @@ void PackJTML(std::string const & jtml_name)
 	cout << "Non empty tiles: " << juda_tex->NumNonEmptyNodes() << endl;
 	cout << "Tree depth: " << juda_tex->TreeLevels() << endl;
 
+	if (bake_format != EF_Unknown)
+	{
+		cout << "Baking " << bake_fmt_str << " tiles with " << bake_border << " texel borders" << endl;
+		juda_tex->BakeCacheTiles(bake_format, bake_border);
+	}
+
 	std::string base_name = jtml_name.substr(0, jtml_name.find_last_of('.'));
 
 	cout << "Saving... ";
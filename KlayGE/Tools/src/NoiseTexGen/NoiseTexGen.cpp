@@ -1,4 +1,6 @@
 #include <KlayGE/KlayGE.hpp>
+#include <KFL/Thread.hpp>
+#include <KlayGE/Context.hpp>
 #include <KlayGE/Texture.hpp>
 #include <KFL/Noise.hpp>
 
@@ -218,25 +220,55 @@ void GenSimplexPerm()
 		256, 256, 1, 1, 1, EF_ABGR8, init_data);
 }
 
+// Tileable fBm of every texel, shifted by (dx, dy) texels. A row is evaluated in one batch, and the rows are spread
+//  across the thread pool.
+void GenTileablefBm(std::vector<float>& fdata, uint32_t tex_size, float stride, float dx, float dy)
+{
+	uint32_t const ROWS_PER_TASK = 16;
+
+	MathLib::SimplexNoise<float>& noiser = MathLib::SimplexNoise<float>::Instance();
+
+	fdata.resize(tex_size * tex_size);
+	std::vector<joiner<void>> joiners;
+	for (uint32_t y_start = 0; y_start < tex_size; y_start += ROWS_PER_TASK)
+	{
+		joiners.push_back(Context::Instance().ThreadPool()(
+			[&noiser, &fdata, tex_size, stride, dx, dy, y_start]
+			{
+				std::vector<float> xs(tex_size);
+				std::vector<float> ys(tex_size);
+				for (uint32_t x = 0; x < tex_size; ++ x)
+				{
+					xs[x] = (x + dx + 0.5f) / tex_size * stride;
+				}
+
+				uint32_t const y_end = std::min(y_start + ROWS_PER_TASK, tex_size);
+				for (uint32_t y = y_start; y < y_end; ++ y)
+				{
+					std::fill(ys.begin(), ys.end(), (y + dy + 0.5f) / tex_size * stride);
+					noiser.tileable_fBm(&xs[0], &ys[0], &fdata[y * tex_size], tex_size, stride, stride, 5, 2, 0.5f);
+				}
+			}));
+	}
+	for (auto& j : joiners)
+	{
+		j();
+	}
+}
+
 void GenfBmTexs()
 {
 	uint32_t const TEX_SIZE = 512;
 	float const STRIDE = 8;
 
-	MathLib::SimplexNoise<float> noiser = MathLib::SimplexNoise<float>::Instance();
-
-	std::vector<float> fdata(TEX_SIZE * TEX_SIZE);
+	std::vector<float> fdata;
+	GenTileablefBm(fdata, TEX_SIZE, STRIDE, 0, 0);
 	float min_v = +1e10f;
 	float max_v = -1e10f;
-	for (uint32_t y = 0; y < TEX_SIZE; ++ y)
+	for (uint32_t i = 0; i < fdata.size(); ++ i)
 	{
-		for (uint32_t x = 0; x < TEX_SIZE; ++ x)
-		{
-			float v = noiser.tileable_fBm((x + 0.5f) / TEX_SIZE * STRIDE, (y + 0.5f) / TEX_SIZE * STRIDE, STRIDE, STRIDE, 5, 2, 0.5f);
-			fdata[y * TEX_SIZE + x] = v;
-			min_v = std::min(min_v, v);
-			max_v = std::max(max_v, v);
-		}
+		min_v = std::min(min_v, fdata[i]);
+		max_v = std::max(max_v, fdata[i]);
 	}
 	float inv_range = 1 / (max_v - min_v);
 	std::vector<uint8_t> data(TEX_SIZE * TEX_SIZE);
@@ -255,17 +287,19 @@ void GenfBmTexs()
 	system("Mipmapper " OUTPUT_PATH "fBm5_tex.dds");
 	system("TexCompressor BC4 " OUTPUT_PATH "fBm5_tex.dds");
 
+	float const d = 2;
+	std::vector<float> fdata_x;
+	std::vector<float> fdata_y;
+	GenTileablefBm(fdata_x, TEX_SIZE, STRIDE, d, 0);
+	GenTileablefBm(fdata_y, TEX_SIZE, STRIDE, 0, d);
+
 	std::vector<float3> fdata3(TEX_SIZE * TEX_SIZE);
-	for (uint32_t y = 0; y < TEX_SIZE; ++ y)
+	for (uint32_t i = 0; i < fdata3.size(); ++ i)
 	{
-		for (uint32_t x = 0; x < TEX_SIZE; ++ x)
-		{
-			float f0 = fdata[y * TEX_SIZE + x];
-			float d = 2;
-			float fx = noiser.tileable_fBm((x + d + 0.5f) / TEX_SIZE * STRIDE, (y + 0.5f) / TEX_SIZE * STRIDE, STRIDE, STRIDE, 5, 2, 0.5f);
-			float fy = noiser.tileable_fBm((x + 0.5f) / TEX_SIZE * STRIDE, (y + d + 0.5f) / TEX_SIZE * STRIDE, STRIDE, STRIDE, 5, 2, 0.5f);
-			fdata3[y * TEX_SIZE + x] = MathLib::normalize(float3(fx - f0, fy - f0, STRIDE * 16 / TEX_SIZE)) * 0.5f + 0.5f;
-		}
+		float f0 = fdata[i];
+		float fx = fdata_x[i];
+		float fy = fdata_y[i];
+		fdata3[i] = MathLib::normalize(float3(fx - f0, fy - f0, STRIDE * 16 / TEX_SIZE)) * 0.5f + 0.5f;
 	}
 	std::vector<uint32_t> data3(TEX_SIZE * TEX_SIZE);
 	for (uint32_t i = 0; i < fdata3.size(); ++ i)
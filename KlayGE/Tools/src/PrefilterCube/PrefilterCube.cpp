@@ -2,6 +2,8 @@
 #include <KFL/Half.hpp>
 #include <KFL/Math.hpp>
 #include <KFL/Timer.hpp>
+#include <KFL/CpuInfo.hpp>
+#include <KFL/Thread.hpp>
 #include <KlayGE/Texture.hpp>
 #include <KlayGE/ResLoader.hpp>
 #include <KlayGE/RenderFactory.hpp>
@@ -11,6 +13,7 @@
 #include <KlayGE/RenderMaterial.hpp>
 #include <KFL/CXX17/filesystem.hpp>
 
+#include <cmath>
 #include <iostream>
 #include <fstream>
 #include <vector>
@@ -192,123 +195,246 @@ namespace
 		return tangent * h.x() + binormal * h.y() + normal * h.z();
 	}
 
-	Color PrefilterEnvMapDiffuse(float3 const & normal, Color* env_map[6], uint32_t size)
+	uint32_t const NUM_SPECULAR_SAMPLES = 256;
+	uint32_t const NUM_DIFFUSE_SAMPLES = 256;
+	uint32_t const NUM_SH_COEFFS = 9;
+	uint32_t const TEXELS_PER_ITEM = 4096;
+
+	// The source cube with its box filtered mipmaps. Every sample reads the level whose texels match the solid angle the
+	//  sample covers, so far fewer samples are needed than reading the top level only.
+	class FilteredCube
 	{
-		Color prefiltered_clr(0.0f, 0.0f, 0.0f, 0.0f);
+	public:
+		FilteredCube(std::vector<std::vector<Color>> const & faces, uint32_t width)
+			: width_(width), num_mipmaps_(1)
+		{
+			for (uint32_t w = width; w > 1; w /= 2)
+			{
+				++ num_mipmaps_;
+			}
+
+			levels_.resize(6 * num_mipmaps_);
+			for (uint32_t face = 0; face < 6; ++ face)
+			{
+				levels_[face * num_mipmaps_] = faces[face];
+
+				uint32_t src_w = width;
+				for (uint32_t mip = 1; mip < num_mipmaps_; ++ mip)
+				{
+					uint32_t const w = std::max<uint32_t>(1U, src_w / 2);
+					std::vector<Color> const & src = levels_[face * num_mipmaps_ + mip - 1];
+					std::vector<Color>& dst = levels_[face * num_mipmaps_ + mip];
+					dst.resize(w * w);
+					for (uint32_t y = 0; y < w; ++ y)
+					{
+						uint32_t const y0 = std::min(y * 2 + 0, src_w - 1);
+						uint32_t const y1 = std::min(y * 2 + 1, src_w - 1);
+						for (uint32_t x = 0; x < w; ++ x)
+						{
+							uint32_t const x0 = std::min(x * 2 + 0, src_w - 1);
+							uint32_t const x1 = std::min(x * 2 + 1, src_w - 1);
+							dst[y * w + x] = (src[y0 * src_w + x0] + src[y0 * src_w + x1]
+								+ src[y1 * src_w + x0] + src[y1 * src_w + x1]) * 0.25f;
+						}
+					}
+
+					src_w = w;
+				}
+			}
+		}
 
-		uint32_t const NUM_SAMPLES = 1024;
-		for (uint32_t i = 0; i < NUM_SAMPLES; ++ i)
+		Color const & Sample(float3 const & dir, float lod) const
 		{
-			float2 xi = Hammersley2D(i, NUM_SAMPLES);
-			float3 l = ImportanceSampleLambert(xi, normal);
+			uint32_t const mip = std::min(static_cast<uint32_t>(lod + 0.5f), num_mipmaps_ - 1);
+			uint32_t const size = std::max<uint32_t>(1U, width_ >> mip);
 			uint32_t face, x, y;
-			ToAddress(face, x, y, l, size);
-			prefiltered_clr += env_map[face][y * size + x];
+			ToAddress(face, x, y, dir, size);
+			return levels_[face * num_mipmaps_ + mip][y * size + x];
 		}
 
-		return prefiltered_clr / static_cast<float>(NUM_SAMPLES);
-	}
+		float TexelSolidAngle() const
+		{
+			return 4 * PI / (6 * width_ * width_);
+		}
+
+	private:
+		uint32_t width_;
+		uint32_t num_mipmaps_;
+		std::vector<std::vector<Color>> levels_;
+	};
 
-	Color PrefilterEnvMapSpecular(float shininess, float3 const & r, Color* env_map[6], uint32_t size)
+	// A sample direction in tangent space, with z being the normal. The same samples are used by all texels of a level.
+	struct PrefilterSample
 	{
-		float3 normal = r;
-		float3 view = r;
-		Color prefiltered_clr(0.0f, 0.0f, 0.0f, 0.0f);
-		float total_weight = 0;
+		float3 l;
+		float weight;
+		float lod;
+	};
 
-		uint32_t const NUM_SAMPLES = 1024;
-		for (uint32_t i = 0; i < NUM_SAMPLES; ++ i)
+	// Level of the filtered cube covering the solid angle of a sample, with the bias of Krivanek and Colbert
+	float SampleLod(float pdf, uint32_t num_samples, float texel_solid_angle)
+	{
+		float const sample_solid_angle = 1 / (num_samples * pdf + 1e-6f);
+		return std::max(0.5f * std::log2(sample_solid_angle / texel_solid_angle) + 1, 0.0f);
+	}
+
+	void GenSpecularSamples(std::vector<PrefilterSample>& samples, float shininess, float texel_solid_angle)
+	{
+		samples.clear();
+		for (uint32_t i = 0; i < NUM_SPECULAR_SAMPLES; ++ i)
 		{
-			float2 xi = Hammersley2D(i, NUM_SAMPLES);
-			float3 h = ImportanceSampleBP(xi, shininess, normal);
-			float3 l = -MathLib::reflect(view, h);
-			float n_dot_l = MathLib::clamp(MathLib::dot(normal, l), 0.0f, 1.0f);
-			if (n_dot_l > 0)
+			float3 const h = ImportanceSampleBP(Hammersley2D(i, NUM_SPECULAR_SAMPLES), shininess);
+			// Reflects view = normal = (0, 0, 1) around h
+			float3 const l = h * (2 * h.z()) - float3(0, 0, 1);
+			if (l.z() > 0)
 			{
-				uint32_t face, x, y;
-				ToAddress(face, x, y, l, size);
-				prefiltered_clr += env_map[face][y * size + x] * n_dot_l;
-				total_weight += n_dot_l;
+				float const pdf_h = (shininess + 1) * pow(h.z(), shininess) / (2 * PI);
+				PrefilterSample sample;
+				sample.l = l;
+				sample.weight = l.z();
+				sample.lod = SampleLod(pdf_h / (4 * h.z()), NUM_SPECULAR_SAMPLES, texel_solid_angle);
+				samples.push_back(sample);
 			}
 		}
+	}
+
+	void GenDiffuseSamples(std::vector<PrefilterSample>& samples, float texel_solid_angle)
+	{
+		samples.clear();
+		for (uint32_t i = 0; i < NUM_DIFFUSE_SAMPLES; ++ i)
+		{
+			PrefilterSample sample;
+			sample.l = ImportanceSampleLambert(Hammersley2D(i, NUM_DIFFUSE_SAMPLES));
+			sample.weight = 1;
+			sample.lod = SampleLod(sample.l.z() / PI, NUM_DIFFUSE_SAMPLES, texel_solid_angle);
+			samples.push_back(sample);
+		}
+	}
+
+	Color PrefilterTexel(float3 const & normal, std::vector<PrefilterSample> const & samples, FilteredCube const & env_map)
+	{
+		float3 up_vec = abs(normal.z()) < 0.999f ? float3(0, 0, 1) : float3(1, 0, 0);
+		float3 tangent = MathLib::normalize(MathLib::cross(up_vec, normal));
+		float3 binormal = MathLib::cross(normal, tangent);
+
+		Color prefiltered_clr(0.0f, 0.0f, 0.0f, 0.0f);
+		float total_weight = 0;
+		for (auto const & sample : samples)
+		{
+			float3 const l = tangent * sample.l.x() + binormal * sample.l.y() + normal * sample.l.z();
+			prefiltered_clr += env_map.Sample(l, sample.lod) * sample.weight;
+			total_weight += sample.weight;
+		}
 
 		return prefiltered_clr / max(1e-6f, total_weight);
 	}
 
-	struct PrefilterCubeFaceParam
+	float AreaElement(float x, float y)
+	{
+		return atan2(x * y, sqrt(x * x + y * y + 1));
+	}
+
+	float TexelSolidAngle(uint32_t x, uint32_t y, uint32_t size)
+	{
+		float const inv_size = 1.0f / size;
+		float const u = (x + 0.5f) * inv_size * 2 - 1;
+		float const v = (y + 0.5f) * inv_size * 2 - 1;
+		float const x0 = u - inv_size;
+		float const y0 = v - inv_size;
+		float const x1 = u + inv_size;
+		float const y1 = v + inv_size;
+		return AreaElement(x0, y0) - AreaElement(x0, y1) - AreaElement(x1, y0) + AreaElement(x1, y1);
+	}
+
+	// Real spherical harmonics basis of the first 3 bands
+	void SHBasis(float basis[NUM_SH_COEFFS], float3 const & dir)
+	{
+		float const x = dir.x();
+		float const y = dir.y();
+		float const z = dir.z();
+		basis[0] = 0.282095f;
+		basis[1] = 0.488603f * y;
+		basis[2] = 0.488603f * z;
+		basis[3] = 0.488603f * x;
+		basis[4] = 1.092548f * x * y;
+		basis[5] = 1.092548f * y * z;
+		basis[6] = 0.315392f * (3 * z * z - 1);
+		basis[7] = 1.092548f * x * z;
+		basis[8] = 0.546274f * (x * x - y * y);
+	}
+
+	// A range of rows of a face in a level. The SH items project the rows of the source instead of filtering.
+	struct PrefilterWorkItem
 	{
-		std::vector<std::vector<Color>>* prefilted_data;
-		std::vector<ElementInitData>* out_data;
-		std::vector<std::vector<half>>* out_data_block;
+		uint32_t face;
+		uint32_t mip;
 		uint32_t width;
-		uint32_t num_mipmaps;
-		atomic<uint32_t>* processed_texels;
+		uint32_t y_begin;
+		uint32_t y_end;
+		bool sh_projection;
+		Color sh[NUM_SH_COEFFS];
 	};
 
-	void PrefilterCubeFace(PrefilterCubeFaceParam& param, uint32_t face)
+	void AddWorkItems(std::vector<PrefilterWorkItem>& items, uint32_t mip, uint32_t width, bool sh_projection)
 	{
-		std::vector<std::vector<Color>>& prefilted_data = *param.prefilted_data;
-		std::vector<ElementInitData>& out_data = *param.out_data;
-		std::vector<std::vector<half>>& out_data_block = *param.out_data_block;
-		uint32_t width = param.width;
-		uint32_t num_mipmaps = param.num_mipmaps;
-		atomic<uint32_t>& processed_texels = *param.processed_texels;
-
-		Color* env_map[6];
-		for (uint32_t f = 0; f < 6; ++ f)
+		uint32_t const rows = std::max(1U, TEXELS_PER_ITEM / width);
+		for (uint32_t face = 0; face < 6; ++ face)
 		{
-			env_map[f] = &prefilted_data[f * num_mipmaps][0];
+			for (uint32_t y = 0; y < width; y += rows)
+			{
+				PrefilterWorkItem item;
+				item.face = face;
+				item.mip = mip;
+				item.width = width;
+				item.y_begin = y;
+				item.y_end = std::min(y + rows, width);
+				item.sh_projection = sh_projection;
+				items.push_back(item);
+			}
 		}
+	}
 
-		uint32_t w = std::max<uint32_t>(1U, width / 2);
-
-		for (uint32_t mip = 1; mip < num_mipmaps - 1; ++ mip)
+	void ProcessWorkItem(PrefilterWorkItem& item, std::vector<std::vector<Color>>& prefilted_data, uint32_t num_mipmaps,
+		FilteredCube const & env_map, std::vector<std::vector<PrefilterSample>> const & samples)
+	{
+		uint32_t const w = item.width;
+		std::vector<Color>& level = prefilted_data[item.face * num_mipmaps + item.mip];
+		if (item.sh_projection)
 		{
-			prefilted_data[face * num_mipmaps + mip].resize(w * w);
-			float shininess = Glossiness2Shininess(static_cast<float>(num_mipmaps - 2 - mip) / (num_mipmaps - 2));
+			for (uint32_t i = 0; i < NUM_SH_COEFFS; ++ i)
+			{
+				item.sh[i] = Color(0.0f, 0.0f, 0.0f, 0.0f);
+			}
 
-			for (uint32_t y = 0; y < w; ++ y)
+			float basis[NUM_SH_COEFFS];
+			for (uint32_t y = item.y_begin; y < item.y_end; ++ y)
 			{
 				for (uint32_t x = 0; x < w; ++ x)
 				{
-					prefilted_data[face * num_mipmaps + mip][y * w + x]
-						= PrefilterEnvMapSpecular(shininess, ToDir(face, x, y, w), env_map, width);
-					++ processed_texels;
+					SHBasis(basis, ToDir(item.face, x, y, w));
+					Color const clr = level[y * w + x] * TexelSolidAngle(x, y, w);
+					for (uint32_t i = 0; i < NUM_SH_COEFFS; ++ i)
+					{
+						item.sh[i] += clr * basis[i];
+					}
 				}
 			}
-
-			w = std::max<uint32_t>(1U, w / 2);
 		}
-
+		else
 		{
-			prefilted_data[face * num_mipmaps + num_mipmaps - 1].resize(w * w);
-			for (uint32_t y = 0; y < w; ++ y)
+			for (uint32_t y = item.y_begin; y < item.y_end; ++ y)
 			{
 				for (uint32_t x = 0; x < w; ++ x)
 				{
-					prefilted_data[face * num_mipmaps + num_mipmaps - 1][y * w + x]
-						= PrefilterEnvMapDiffuse(ToDir(face, x, y, w), env_map, width);
-					++ processed_texels;
+					level[y * w + x] = PrefilterTexel(ToDir(item.face, x, y, w), samples[item.mip], env_map);
 				}
 			}
 		}
-
-		w = width;
-		for (uint32_t mip = 0; mip < num_mipmaps; ++ mip)
-		{
-			out_data_block[face * num_mipmaps + mip].resize(w * w * sizeof(half) * 4);
-			out_data[face * num_mipmaps + mip].data = &out_data_block[face * num_mipmaps + mip][0];
-			out_data[face * num_mipmaps + mip].row_pitch = w * sizeof(half) * 4;
-			out_data[face * num_mipmaps + mip].slice_pitch = w * out_data[face * num_mipmaps + mip].row_pitch;
-
-			ConvertFromABGR32F(EF_ABGR16F, &prefilted_data[face * num_mipmaps + mip][0], w * w,
-				&out_data_block[face * num_mipmaps + mip][0]);
-
-			w = std::max<uint32_t>(1U, w / 2);
-		}
 	}
 
-	void PrefilterCube(std::string const & in_file, std::string const & out_file)
+	// All the texels of all faces and levels, and the SH projection, are split into small work items. Every thread
+	//  keeps taking the next unprocessed item until none is left, so the threads finish almost at the same time.
+	void PrefilterCube(std::string const & in_file, std::string const & out_file, std::string const & sh_file)
 	{
 		Texture::TextureType in_type;
 		uint32_t in_width, in_height, in_depth;
@@ -319,7 +445,6 @@ namespace
 		std::vector<uint8_t> in_data_block;
 		LoadTexture(in_file, in_type, in_width, in_height, in_depth, in_num_mipmaps, in_array_size, in_format, in_data, in_data_block);
 
-		uint32_t total_texels = 0;
 		uint32_t out_num_mipmaps = 1;
 		{
 			uint32_t w = in_width;
@@ -328,14 +453,13 @@ namespace
 				++ out_num_mipmaps;
 
 				w = std::max<uint32_t>(1U, w / 2);
-				total_texels += w * w * 6;
 			}
 		}
 
-		uint32_t w = in_width;
 		std::vector<std::vector<Color>> prefilted_data(out_num_mipmaps * 6);
 		for (uint32_t face = 0; face < 6; ++ face)
 		{
+			uint32_t w = in_width;
 			prefilted_data[face * out_num_mipmaps].resize(w * w);
 			
 			uint8_t const * src = static_cast<uint8_t const *>(in_data[face * in_num_mipmaps].data);
@@ -344,25 +468,69 @@ namespace
 				ConvertToABGR32F(in_format, src, w, &prefilted_data[face * out_num_mipmaps][y * w]);
 				src += in_data[face * in_num_mipmaps].row_pitch;
 			}
+
+			for (uint32_t mip = 1; mip < out_num_mipmaps; ++ mip)
+			{
+				w = std::max<uint32_t>(1U, w / 2);
+				prefilted_data[face * out_num_mipmaps + mip].resize(w * w);
+			}
 		}
 
-		std::vector<ElementInitData> out_data(out_num_mipmaps * 6);
-		std::vector<std::vector<half>> out_data_block(out_num_mipmaps * 6);
+		FilteredCube env_map(
+			{
+				prefilted_data[0 * out_num_mipmaps], prefilted_data[1 * out_num_mipmaps], prefilted_data[2 * out_num_mipmaps],
+				prefilted_data[3 * out_num_mipmaps], prefilted_data[4 * out_num_mipmaps], prefilted_data[5 * out_num_mipmaps]
+			}, in_width);
+
+		std::vector<std::vector<PrefilterSample>> samples(out_num_mipmaps);
+		std::vector<PrefilterWorkItem> items;
+		{
+			uint32_t w = std::max<uint32_t>(1U, in_width / 2);
+			for (uint32_t mip = 1; mip < out_num_mipmaps - 1; ++ mip)
+			{
+				float shininess = Glossiness2Shininess(static_cast<float>(out_num_mipmaps - 2 - mip) / (out_num_mipmaps - 2));
+				GenSpecularSamples(samples[mip], shininess, env_map.TexelSolidAngle());
+				AddWorkItems(items, mip, w, false);
 
+				w = std::max<uint32_t>(1U, w / 2);
+			}
+
+			GenDiffuseSamples(samples[out_num_mipmaps - 1], env_map.TexelSolidAngle());
+			AddWorkItems(items, out_num_mipmaps - 1, w, false);
+
+			AddWorkItems(items, 0, in_width, true);
+		}
+
+		uint32_t total_texels = 0;
+		for (auto const & item : items)
+		{
+			total_texels += (item.y_end - item.y_begin) * item.width;
+		}
+
+		atomic<uint32_t> next_item(0);
 		atomic<uint32_t> processed_texels(0);
 
-		thread_pool tp(1, 6);
-		std::vector<joiner<void>> joiners(6);
-		PrefilterCubeFaceParam param;
-		param.prefilted_data = &prefilted_data;
-		param.out_data = &out_data;
-		param.out_data_block = &out_data_block;
-		param.width = in_width;
-		param.num_mipmaps = out_num_mipmaps;
-		param.processed_texels = &processed_texels;
-		for (size_t face = 0; face < joiners.size(); ++ face)
+		CPUInfo cpu;
+		uint32_t const num_threads = cpu.NumHWThreads();
+		thread_pool tp(1, num_threads);
+		std::vector<joiner<void>> joiners(num_threads);
+		for (uint32_t i = 0; i < num_threads; ++ i)
 		{
-			joiners[face] = tp(std::bind(PrefilterCubeFace, std::ref(param), static_cast<uint32_t>(face)));
+			joiners[i] = tp([&items, &prefilted_data, out_num_mipmaps, &env_map, &samples, &next_item, &processed_texels]
+				{
+					for (;;)
+					{
+						uint32_t const index = next_item ++;
+						if (index >= items.size())
+						{
+							break;
+						}
+
+						PrefilterWorkItem& item = items[index];
+						ProcessWorkItem(item, prefilted_data, out_num_mipmaps, env_map, samples);
+						processed_texels += (item.y_end - item.y_begin) * item.width;
+					}
+				});
 		}
 
 		for (;;)
@@ -379,9 +547,53 @@ namespace
 		}
 		cout << endl;
 
-		for (size_t face = 0; face < joiners.size(); ++ face)
+		for (size_t i = 0; i < joiners.size(); ++ i)
+		{
+			joiners[i]();
+		}
+
+		// Sums up in the order of the items, so the result doesn't depend on the scheduling
+		Color sh[NUM_SH_COEFFS];
+		for (uint32_t i = 0; i < NUM_SH_COEFFS; ++ i)
+		{
+			sh[i] = Color(0.0f, 0.0f, 0.0f, 0.0f);
+		}
+		for (auto const & item : items)
+		{
+			if (item.sh_projection)
+			{
+				for (uint32_t i = 0; i < NUM_SH_COEFFS; ++ i)
+				{
+					sh[i] += item.sh[i];
+				}
+			}
+		}
+		{
+			std::ofstream ofs(sh_file.c_str());
+			ofs << "// Coefficients of the first 3 bands of spherical harmonics, in RGB" << endl;
+			for (uint32_t i = 0; i < NUM_SH_COEFFS; ++ i)
+			{
+				ofs << sh[i].r() << ' ' << sh[i].g() << ' ' << sh[i].b() << endl;
+			}
+		}
+
+		std::vector<ElementInitData> out_data(out_num_mipmaps * 6);
+		std::vector<std::vector<half>> out_data_block(out_num_mipmaps * 6);
+		for (uint32_t face = 0; face < 6; ++ face)
 		{
-			joiners[face]();
+			uint32_t w = in_width;
+			for (uint32_t mip = 0; mip < out_num_mipmaps; ++ mip)
+			{
+				out_data_block[face * out_num_mipmaps + mip].resize(w * w * sizeof(half) * 4);
+				out_data[face * out_num_mipmaps + mip].data = &out_data_block[face * out_num_mipmaps + mip][0];
+				out_data[face * out_num_mipmaps + mip].row_pitch = w * sizeof(half) * 4;
+				out_data[face * out_num_mipmaps + mip].slice_pitch = w * out_data[face * out_num_mipmaps + mip].row_pitch;
+
+				ConvertFromABGR32F(EF_ABGR16F, &prefilted_data[face * out_num_mipmaps + mip][0], w * w,
+					&out_data_block[face * out_num_mipmaps + mip][0]);
+
+				w = std::max<uint32_t>(1U, w / 2);
+			}
 		}
 
 		SaveTexture(out_file, in_type, in_width, in_height, in_depth, out_num_mipmaps, in_array_size, EF_ABGR16F, out_data);
@@ -459,34 +671,36 @@ public:
 
 int main(int argc, char* argv[])
 {
-	Context::Instance().LoadCfg("KlayGE.cfg");
-	ContextCfg context_cfg = Context::Instance().Config();
-	context_cfg.graphics_cfg.hide_win = true;
-	context_cfg.graphics_cfg.hdr = false;
-	context_cfg.graphics_cfg.color_grading = false;
-	context_cfg.graphics_cfg.gamma = false;
-	Context::Instance().Config(context_cfg);
-
-	PrefilterCubeApp app;
-	app.Create();
-
-	using namespace KlayGE;
+	// -cpu filters on the CPU without creating a render device
+	bool force_cpu = false;
+	std::vector<std::string> args;
+	for (int i = 1; i < argc; ++ i)
+	{
+		if (std::string("-cpu") == argv[i])
+		{
+			force_cpu = true;
+		}
+		else
+		{
+			args.push_back(argv[i]);
+		}
+	}
 
-	if (argc < 2)
+	if (args.empty())
 	{
-		cout << "Usage: PrefilterCube xxx.dds [xxx_filtered.dds]" << endl;
+		cout << "Usage: PrefilterCube xxx.dds [xxx_filtered.dds] [-cpu]" << endl;
 		return 1;
 	}
 
-	std::string input(argv[1]);
+	std::string input(args[0]);
 	std::string output;
-	if (argc >= 3)
+	if (args.size() >= 2)
 	{
-		output = argv[2];
+		output = args[1];
 	}
 	else
 	{
-		filesystem::path output_path(argv[1]);
+		filesystem::path output_path(args[0]);
 #ifdef KLAYGE_TS_LIBRARY_FILESYSTEM_V2_SUPPORT
 		output = output_path.stem() + "_filtered.dds";
 #else
@@ -494,12 +708,32 @@ int main(int argc, char* argv[])
 #endif
 	}
 
+	std::unique_ptr<PrefilterCubeApp> app;
+	bool use_cpu = force_cpu;
+	if (!force_cpu)
+	{
+		Context::Instance().LoadCfg("KlayGE.cfg");
+		ContextCfg context_cfg = Context::Instance().Config();
+		context_cfg.graphics_cfg.hide_win = true;
+		context_cfg.graphics_cfg.hdr = false;
+		context_cfg.graphics_cfg.color_grading = false;
+		context_cfg.graphics_cfg.gamma = false;
+		Context::Instance().Config(context_cfg);
+
+		app = MakeUniquePtr<PrefilterCubeApp>();
+		app->Create();
+
+		RenderDeviceCaps const & caps = Context::Instance().RenderFactoryInstance().RenderEngineInstance().DeviceCaps();
+		use_cpu = (caps.max_shader_model < ShaderModel(4, 0));
+	}
+
 	Timer timer;
 
-	RenderDeviceCaps const & caps = Context::Instance().RenderFactoryInstance().RenderEngineInstance().DeviceCaps();
-	if (caps.max_shader_model < ShaderModel(4, 0))
+	if (use_cpu)
 	{
-		PrefilterCube(input, output);
+		std::string const sh_file = output.substr(0, output.rfind('.')) + "_sh.txt";
+		PrefilterCube(input, output, sh_file);
+		cout << "SH coefficients are saved into " << sh_file << endl;
 	}
 	else
 	{
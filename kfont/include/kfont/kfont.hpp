@@ -35,6 +35,7 @@
 
 #include <vector>
 #include <istream>
+#include <mutex>
 #include <unordered_map>
 
 #ifndef KFONT_SOURCE
@@ -106,6 +107,9 @@ namespace KlayGE
 
 		font_info const & CharInfo(int32_t index) const;
 		void GetDistanceData(uint8_t* p, uint32_t pitch, int32_t index) const;
+		// Decompresses a batch of characters. Glyph i is stored at p + i * CharSize() * CharSize() with no padding.
+		//  The compressed data is read serially, LZMA decoding is spread over the thread pool.
+		void GetDistanceData(uint8_t* p, int32_t const * indices, uint32_t num_indices, thread_pool& tp) const;
 		void GetLZMADistanceData(uint8_t* p, uint32_t& size, int32_t index) const;
 
 		void CharSize(uint32_t size);
@@ -115,6 +119,9 @@ namespace KlayGE
 		void SetLZMADistanceData(wchar_t ch, uint8_t const * p, uint32_t size, uint32_t adv, font_info const & fi);
 		void Compact();
 
+	private:
+		void DecodeDistanceData(uint8_t* p, uint32_t pitch, uint8_t const * lzma_data, uint32_t size) const;
+
 	private:
 		uint32_t char_size_;
 		int16_t dist_base_;
@@ -125,6 +132,7 @@ namespace KlayGE
 		std::vector<uint8_t> distances_lzma_;
 		ResIdentifierPtr kfont_input_;
 		int64_t distances_lzma_start_;
+		mutable std::mutex input_mutex_;
 	};
 }
 
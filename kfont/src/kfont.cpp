@@ -341,26 +341,101 @@ namespace KlayGE
 
 	void KFont::GetDistanceData(uint8_t* p, uint32_t pitch, int32_t index) const
 	{
-		std::vector<uint8_t> decoded(char_size_ * char_size_);
-
 		uint32_t size;
 		this->GetLZMADistanceData(nullptr, size, index);
 
 		std::vector<uint8_t> in_data(size);
 		this->GetLZMADistanceData(&in_data[0], size, index);
 
-		SizeT s_out_len = static_cast<SizeT>(decoded.size());
+		this->DecodeDistanceData(p, pitch, &in_data[0], size);
+	}
+
+	void KFont::GetDistanceData(uint8_t* p, int32_t const * indices, uint32_t num_indices, thread_pool& tp) const
+	{
+		if (0 == num_indices)
+		{
+			return;
+		}
+
+		std::vector<size_t> in_offsets(num_indices + 1);
+		in_offsets[0] = 0;
+		for (uint32_t i = 0; i < num_indices; ++ i)
+		{
+			int32_t const index = indices[i];
+			in_offsets[i + 1] = in_offsets[i] + distances_addr_[index + 1] - distances_addr_[index];
+		}
+
+		std::vector<uint8_t> in_data(in_offsets.back());
+		for (uint32_t i = 0; i < num_indices; ++ i)
+		{
+			uint32_t size;
+			this->GetLZMADistanceData(&in_data[in_offsets[i]], size, indices[i]);
+		}
 
-		SizeT s_src_len = static_cast<SizeT>(in_data.size() - LZMA_PROPS_SIZE);
-		LZMALoader::Instance().LzmaUncompress(static_cast<Byte*>(&decoded[0]), &s_out_len, &in_data[LZMA_PROPS_SIZE], &s_src_len,
-			&in_data[0], LZMA_PROPS_SIZE);
+		uint32_t const glyph_size = char_size_ * char_size_;
+		auto decode_range = [this, p, glyph_size, &in_data, &in_offsets](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t i = begin; i < end; ++ i)
+			{
+				this->DecodeDistanceData(p + i * glyph_size, char_size_, &in_data[in_offsets[i]],
+					static_cast<uint32_t>(in_offsets[i + 1] - in_offsets[i]));
+			}
+		};
+
+		// Small batches are cheaper to decode on the calling thread than to dispatch
+		uint32_t const MIN_GLYPHS_PER_TASK = 16;
+		uint32_t const num_tasks = std::max(1U, std::min(std::max(1U, std::thread::hardware_concurrency()),
+			num_indices / MIN_GLYPHS_PER_TASK));
+		uint32_t const glyphs_per_task = (num_indices + num_tasks - 1) / num_tasks;
 
-		uint8_t const * char_data = &decoded[0];
-		for (uint32_t y = 0; y < char_size_; ++ y)
+		std::vector<joiner<void>> joiners;
+		joiners.reserve(num_tasks - 1);
+		for (uint32_t t = 1; t < num_tasks; ++ t)
 		{
-			std::memcpy(p, char_data, char_size_);
-			p += pitch;
-			char_data += char_size_;
+			uint32_t const begin = t * glyphs_per_task;
+			uint32_t const end = std::min(begin + glyphs_per_task, num_indices);
+			joiners.push_back(tp([&decode_range, begin, end]
+				{
+					decode_range(begin, end);
+				}));
+		}
+		decode_range(0, std::min(glyphs_per_task, num_indices));
+
+		for (auto& j : joiners)
+		{
+			j();
+		}
+	}
+
+	void KFont::DecodeDistanceData(uint8_t* p, uint32_t pitch, uint8_t const * lzma_data, uint32_t size) const
+	{
+		std::vector<uint8_t> decoded;
+		uint8_t* dst;
+		if (pitch == char_size_)
+		{
+			dst = p;
+		}
+		else
+		{
+			decoded.resize(char_size_ * char_size_);
+			dst = &decoded[0];
+		}
+
+		SizeT s_out_len = static_cast<SizeT>(char_size_ * char_size_);
+
+		SizeT s_src_len = static_cast<SizeT>(size - LZMA_PROPS_SIZE);
+		LZMALoader::Instance().LzmaUncompress(static_cast<Byte*>(dst), &s_out_len, &lzma_data[LZMA_PROPS_SIZE], &s_src_len,
+			&lzma_data[0], LZMA_PROPS_SIZE);
+
+		if (dst != p)
+		{
+			uint8_t const * char_data = &decoded[0];
+			for (uint32_t y = 0; y < char_size_; ++ y)
+			{
+				std::memcpy(p, char_data, char_size_);
+				p += pitch;
+				char_data += char_size_;
+			}
 		}
 	}
 
@@ -371,6 +446,7 @@ namespace KlayGE
 		{
 			if (kfont_input_)
 			{
+				std::lock_guard<std::mutex> lock(input_mutex_);
 				kfont_input_->seekg(distances_lzma_start_ + (index + 1) * sizeof(uint64_t) + distances_addr_[index],
 					std::ios_base::beg);
 				kfont_input_->read(p, size);